@@ -0,0 +1,859 @@
+/* ========================================================================= */
+/**
+ * @file alloc_stats.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alloc_stats.h"
+
+#include "atomic.h"
+#include "def.h"
+#include "log_wrappers.h"
+#include "thread.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Memory of this module is allocated through plain calloc(3) and free(3):
+// The `logged_*` allocators would account it, and recurse into here.
+
+/* == Declarations ========================================================= */
+
+/** Assumed size of a cache line. */
+#define _BS_ALLOC_STATS_CACHELINE 64
+/** Number of shards of the counters. */
+#define _BS_ALLOC_STATS_SHARDS 16
+/** Maximum number of call sites. Further sites are accounted as one. */
+#define _BS_ALLOC_STATS_MAX_SITES 4096
+/** Number of entries in the per-thread cache of call sites. */
+#define _BS_ALLOC_STATS_CACHE_SIZE 64
+/** Number of stripes of the table of live allocations. */
+#define _BS_ALLOC_STATS_STRIPES 64
+/** Initial capacity of a stripe of the live table. Must be a power of 2. */
+#define _BS_ALLOC_STATS_STRIPE_CAPACITY 64
+
+/** Counters of a site, in one shard. */
+enum {
+    _BS_ALLOC_STATS_ALLOCS = 0,
+    _BS_ALLOC_STATS_BYTES,
+    _BS_ALLOC_STATS_FREES,
+    _BS_ALLOC_STATS_FREED_BYTES,
+    _BS_ALLOC_STATS_SIZE_CLASS_0,
+    /** Number of counters, rounded up to fill cache lines. */
+    _BS_ALLOC_STATS_STRIDE =
+    (_BS_ALLOC_STATS_SIZE_CLASS_0 + BS_ALLOC_STATS_SIZE_CLASSES + 7) / 8 * 8
+};
+
+/** A call site. Allocated cache-line aligned, and never released. */
+typedef struct {
+    /** One row of counters per shard. */
+    bs_atomic_int64_t         counters[_BS_ALLOC_STATS_SHARDS][
+        _BS_ALLOC_STATS_STRIDE];
+    /** File name of the call site. */
+    const char                *file_ptr;
+    /** Line of the call site. */
+    int                       line;
+} bs_alloc_stats_site_state_t;
+
+/** An entry of the per-thread cache of call sites. */
+typedef struct {
+    /** File name, as passed to the allocator. Compared by address. */
+    const char                *file_ptr;
+    /** Line. */
+    int                       line;
+    /** The site. */
+    bs_alloc_stats_site_state_t *site_ptr;
+} bs_alloc_stats_cache_entry_t;
+
+/** A live allocation. */
+typedef struct {
+    /** Address of the allocation. 0 if the entry is unused. */
+    uintptr_t                 address;
+    /** Size of the allocation. */
+    size_t                    size;
+    /** Site of the allocation. */
+    bs_alloc_stats_site_state_t *site_ptr;
+} bs_alloc_stats_live_t;
+
+/** A stripe of the table of live allocations: An open-addressing table. */
+typedef struct {
+    /** Protects the stripe. */
+    pthread_mutex_t           mutex;
+    /** The entries, with linear probing. */
+    bs_alloc_stats_live_t     *entries_ptr;
+    /** Number of entries at `entries_ptr`. A power of 2, or 0. */
+    size_t                    capacity;
+    /** Number of used entries. */
+    size_t                    size;
+    /** Padding: Keeps stripes on separate cache lines. */
+    uint8_t                   padding[_BS_ALLOC_STATS_CACHELINE];
+} bs_alloc_stats_stripe_t;
+
+static unsigned _bs_alloc_stats_shard(void);
+static uint64_t _bs_alloc_stats_hash(uintptr_t value);
+static bs_alloc_stats_site_state_t *_bs_alloc_stats_site(const char *file_ptr,
+                                                         int line);
+static bs_alloc_stats_site_state_t *_bs_alloc_stats_site_lookup(
+    const char *file_ptr, int line);
+static bs_alloc_stats_site_state_t *_bs_alloc_stats_site_create(
+    const char *file_ptr, int line);
+static unsigned _bs_alloc_stats_size_class(size_t size);
+static void _bs_alloc_stats_count(bs_alloc_stats_site_state_t *site_ptr,
+                                  int counter,
+                                  int64_t value);
+static void _bs_alloc_stats_stripes_init(void);
+static bs_alloc_stats_stripe_t *_bs_alloc_stats_stripe(uintptr_t address);
+static bool _bs_alloc_stats_stripe_grow(bs_alloc_stats_stripe_t *stripe_ptr);
+static bool _bs_alloc_stats_stripe_insert(bs_alloc_stats_stripe_t *stripe_ptr,
+                                          const bs_alloc_stats_live_t *l_ptr);
+static bool _bs_alloc_stats_stripe_remove(bs_alloc_stats_stripe_t *stripe_ptr,
+                                          uintptr_t address,
+                                          bs_alloc_stats_live_t *l_ptr);
+static void _bs_alloc_stats_account_free(const bs_alloc_stats_live_t *l_ptr);
+static void _bs_alloc_stats_snapshot(bs_alloc_stats_site_state_t *state_ptr,
+                                     bs_alloc_stats_site_t *site_ptr);
+static uint64_t _bs_alloc_stats_key(const bs_alloc_stats_site_t *site_ptr,
+                                    bs_alloc_stats_order_t order);
+
+int                           _bs_alloc_stats_on = 0;
+int64_t                       _bs_alloc_stats_live = 0;
+
+/** Call sites, by hash of file name and line. Lock-free lookup. */
+static bs_atomic_ptr_t        _bs_alloc_stats_sites[_BS_ALLOC_STATS_MAX_SITES];
+/** Site for allocations beyond @ref _BS_ALLOC_STATS_MAX_SITES. */
+static bs_alloc_stats_site_state_t *_bs_alloc_stats_overflow_site_ptr;
+/** Serializes the creation of sites. */
+static pthread_mutex_t        _bs_alloc_stats_sites_mutex =
+    PTHREAD_MUTEX_INITIALIZER;
+
+/** Stripes of the table of live allocations. */
+static bs_alloc_stats_stripe_t _bs_alloc_stats_stripes[
+    _BS_ALLOC_STATS_STRIPES];
+/** Guards the one-time initialization of the stripes' mutexes. */
+static pthread_once_t         _bs_alloc_stats_stripes_once = PTHREAD_ONCE_INIT;
+
+/** Number of threads that got assigned a shard so far. */
+static bs_atomic_int32_t      _bs_alloc_stats_threads =
+    BS_ATOMIC_INT32_INIT(0);
+/** Shard of the calling thread, plus one. 0 if not assigned yet. */
+static _Thread_local unsigned _bs_alloc_stats_thread_shard;
+/** Per-thread cache of recently used call sites, by address of file name. */
+static _Thread_local bs_alloc_stats_cache_entry_t _bs_alloc_stats_cache[
+    _BS_ALLOC_STATS_CACHE_SIZE];
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+void bs_alloc_stats_enable(bool enabled)
+{
+    __atomic_store_n(&_bs_alloc_stats_on, enabled ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_alloc_stats_enabled(void)
+{
+    return 0 != __atomic_load_n(&_bs_alloc_stats_on, __ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_alloc_stats_reset(void)
+{
+    for (size_t i = 0; i < _BS_ALLOC_STATS_STRIPES; ++i) {
+        bs_alloc_stats_stripe_t *stripe_ptr = &_bs_alloc_stats_stripes[i];
+        if (NULL == stripe_ptr->entries_ptr) continue;
+        bs_mutex_lock(&stripe_ptr->mutex);
+        __atomic_fetch_sub(&_bs_alloc_stats_live, stripe_ptr->size,
+                           __ATOMIC_RELAXED);
+        memset(stripe_ptr->entries_ptr, 0,
+               stripe_ptr->capacity * sizeof(bs_alloc_stats_live_t));
+        stripe_ptr->size = 0;
+        bs_mutex_unlock(&stripe_ptr->mutex);
+    }
+
+    for (size_t i = 0; i <= _BS_ALLOC_STATS_MAX_SITES; ++i) {
+        bs_alloc_stats_site_state_t *site_ptr =
+            i < _BS_ALLOC_STATS_MAX_SITES ?
+            bs_atomic_ptr_get(&_bs_alloc_stats_sites[i]) :
+            _bs_alloc_stats_overflow_site_ptr;
+        if (NULL == site_ptr) continue;
+        for (unsigned s = 0; s < _BS_ALLOC_STATS_SHARDS; ++s) {
+            for (unsigned c = 0; c < _BS_ALLOC_STATS_STRIDE; ++c) {
+                bs_atomic_int64_set_explicit(&site_ptr->counters[s][c], 0,
+                                             BS_ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_alloc_stats_sites(bs_alloc_stats_site_t *sites_ptr,
+                            size_t max_sites,
+                            bs_alloc_stats_order_t order)
+{
+    size_t sites = 0;
+    if (0 == max_sites) return 0;
+
+    for (size_t i = 0; i <= _BS_ALLOC_STATS_MAX_SITES; ++i) {
+        bs_alloc_stats_site_state_t *state_ptr =
+            i < _BS_ALLOC_STATS_MAX_SITES ?
+            bs_atomic_ptr_get(&_bs_alloc_stats_sites[i]) :
+            _bs_alloc_stats_overflow_site_ptr;
+        if (NULL == state_ptr) continue;
+
+        bs_alloc_stats_site_t site;
+        _bs_alloc_stats_snapshot(state_ptr, &site);
+        if (0 == site.allocs && 0 == site.live_allocs) continue;
+
+        // Insertion into the top `max_sites`, kept sorted by descending key.
+        uint64_t key = _bs_alloc_stats_key(&site, order);
+        size_t pos = sites;
+        while (0 < pos &&
+               _bs_alloc_stats_key(&sites_ptr[pos - 1], order) < key) --pos;
+        if (pos >= max_sites) continue;
+        size_t move = BS_MIN(sites, max_sites - 1) - pos;
+        memmove(&sites_ptr[pos + 1], &sites_ptr[pos],
+                move * sizeof(bs_alloc_stats_site_t));
+        sites_ptr[pos] = site;
+        if (sites < max_sites) ++sites;
+    }
+    return sites;
+}
+
+/* ------------------------------------------------------------------------- */
+int bs_alloc_stats_dump(FILE *stream_ptr,
+                        size_t top_n,
+                        bs_alloc_stats_order_t order)
+{
+    static const char *order_names[] = {
+        [BS_ALLOC_STATS_BY_LIVE_BYTES] = "live bytes",
+        [BS_ALLOC_STATS_BY_BYTES] = "bytes",
+        [BS_ALLOC_STATS_BY_ALLOCS] = "allocations"
+    };
+
+    bs_alloc_stats_site_t *sites_ptr = calloc(
+        BS_MAX(top_n, (size_t)1), sizeof(bs_alloc_stats_site_t));
+    if (NULL == sites_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed calloc(%zu, %zu)",
+               top_n, sizeof(bs_alloc_stats_site_t));
+        return -1;
+    }
+    size_t sites = bs_alloc_stats_sites(sites_ptr, top_n, order);
+
+    int total = 0, rv;
+    rv = fprintf(stream_ptr, "# Top %zu allocation sites by %s.\n"
+                 "# %12s %12s %14s %12s  site: size classes\n",
+                 sites, order_names[order],
+                 "live_bytes", "live_allocs", "bytes", "allocs");
+    if (0 > rv) goto error;
+    total += rv;
+
+    for (size_t i = 0; i < sites; ++i) {
+        const bs_alloc_stats_site_t *site_ptr = &sites_ptr[i];
+        rv = fprintf(stream_ptr, "%14"PRId64" %12"PRId64" %14"PRIu64
+                     " %12"PRIu64"  %s:%d:",
+                     site_ptr->live_bytes, site_ptr->live_allocs,
+                     site_ptr->bytes, site_ptr->allocs,
+                     site_ptr->file_ptr, site_ptr->line);
+        if (0 > rv) goto error;
+        total += rv;
+
+        for (unsigned c = 0; c < BS_ALLOC_STATS_SIZE_CLASSES; ++c) {
+            if (0 == site_ptr->size_classes[c]) continue;
+            if (c + 1 < BS_ALLOC_STATS_SIZE_CLASSES) {
+                rv = fprintf(stream_ptr, " <=%"PRIu64":%"PRIu64,
+                             UINT64_C(1) << c, site_ptr->size_classes[c]);
+            } else {
+                rv = fprintf(stream_ptr, " >%"PRIu64":%"PRIu64,
+                             UINT64_C(1) << (c - 1),
+                             site_ptr->size_classes[c]);
+            }
+            if (0 > rv) goto error;
+            total += rv;
+        }
+        if (0 > fputc('\n', stream_ptr)) goto error;
+        ++total;
+    }
+    free(sites_ptr);
+    return total;
+
+error:
+    bs_log(BS_ERROR | BS_ERRNO, "Failed to write to stream %p", stream_ptr);
+    free(sites_ptr);
+    return -1;
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_alloc_stats_record_alloc(const char *file_ptr,
+                                  int line,
+                                  void *ptr,
+                                  size_t size)
+{
+    bs_alloc_stats_site_state_t *site_ptr = _bs_alloc_stats_site(
+        file_ptr, line);
+    if (NULL == site_ptr) return;
+
+    _bs_alloc_stats_count(site_ptr, _BS_ALLOC_STATS_ALLOCS, 1);
+    _bs_alloc_stats_count(site_ptr, _BS_ALLOC_STATS_BYTES, size);
+    _bs_alloc_stats_count(
+        site_ptr,
+        _BS_ALLOC_STATS_SIZE_CLASS_0 + _bs_alloc_stats_size_class(size), 1);
+
+    bs_alloc_stats_live_t live = {
+        .address = (uintptr_t)ptr, .size = size, .site_ptr = site_ptr };
+    bs_alloc_stats_live_t stale;
+    bs_alloc_stats_stripe_t *stripe_ptr = _bs_alloc_stats_stripe(
+        live.address);
+    bs_mutex_lock(&stripe_ptr->mutex);
+    // An entry at the same address was released without logged_free().
+    bool had_stale = _bs_alloc_stats_stripe_remove(
+        stripe_ptr, live.address, &stale);
+    bool inserted = _bs_alloc_stats_stripe_insert(stripe_ptr, &live);
+    bs_mutex_unlock(&stripe_ptr->mutex);
+
+    if (had_stale) _bs_alloc_stats_account_free(&stale);
+    if (had_stale != inserted) {
+        __atomic_fetch_add(&_bs_alloc_stats_live, inserted ? 1 : -1,
+                           __ATOMIC_RELAXED);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_alloc_stats_record_free(const void *ptr)
+{
+    bs_alloc_stats_live_t live;
+    bs_alloc_stats_stripe_t *stripe_ptr = _bs_alloc_stats_stripe(
+        (uintptr_t)ptr);
+    if (NULL == stripe_ptr->entries_ptr) return;
+
+    bs_mutex_lock(&stripe_ptr->mutex);
+    bool found = _bs_alloc_stats_stripe_remove(
+        stripe_ptr, (uintptr_t)ptr, &live);
+    bs_mutex_unlock(&stripe_ptr->mutex);
+    if (!found) return;
+
+    __atomic_fetch_sub(&_bs_alloc_stats_live, 1, __ATOMIC_RELAXED);
+    _bs_alloc_stats_account_free(&live);
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Returns the shard of the calling thread. */
+unsigned _bs_alloc_stats_shard(void)
+{
+    if (0 == _bs_alloc_stats_thread_shard) {
+        uint32_t thread = bs_atomic_int32_add(&_bs_alloc_stats_threads, 1);
+        _bs_alloc_stats_thread_shard = 1 + thread % _BS_ALLOC_STATS_SHARDS;
+    }
+    return _bs_alloc_stats_thread_shard - 1;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Mixes the bits of `value`. The finalizer of MurmurHash3. */
+uint64_t _bs_alloc_stats_hash(uintptr_t value)
+{
+    uint64_t h = value;
+    h ^= h >> 33;
+    h *= UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+    return h;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns the site for `file_ptr` and `line`, creating it if needed. Looks
+ * up the per-thread cache first, by address of `file_ptr`.
+ */
+bs_alloc_stats_site_state_t *_bs_alloc_stats_site(const char *file_ptr,
+                                                  int line)
+{
+    bs_alloc_stats_cache_entry_t *entry_ptr = &_bs_alloc_stats_cache[
+        _bs_alloc_stats_hash((uintptr_t)file_ptr ^ (uintptr_t)line) %
+        _BS_ALLOC_STATS_CACHE_SIZE];
+    if (entry_ptr->file_ptr == file_ptr && entry_ptr->line == line) {
+        return entry_ptr->site_ptr;
+    }
+
+    bs_alloc_stats_site_state_t *site_ptr = _bs_alloc_stats_site_lookup(
+        file_ptr, line);
+    if (NULL != site_ptr) {
+        entry_ptr->file_ptr = file_ptr;
+        entry_ptr->line = line;
+        entry_ptr->site_ptr = site_ptr;
+    }
+    return site_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Looks up the site in the global table, by file name and line, and creates
+ * it if not found. The same file name may come at different addresses from
+ * different translation units.
+ */
+bs_alloc_stats_site_state_t *_bs_alloc_stats_site_lookup(
+    const char *file_ptr, int line)
+{
+    uint64_t h = line;
+    for (const char *c_ptr = file_ptr; '\0' != *c_ptr; ++c_ptr) {
+        h = h * 31 + (unsigned char)*c_ptr;
+    }
+    h = _bs_alloc_stats_hash(h);
+
+    bool locked = false;
+    bs_alloc_stats_site_state_t *site_ptr = NULL;
+    for (size_t i = 0; i < _BS_ALLOC_STATS_MAX_SITES; ++i) {
+        bs_atomic_ptr_t *slot_ptr = &_bs_alloc_stats_sites[
+            (h + i) % _BS_ALLOC_STATS_MAX_SITES];
+        bs_alloc_stats_site_state_t *s_ptr = bs_atomic_ptr_get(slot_ptr);
+        if (NULL != s_ptr) {
+            if (s_ptr->line == line && 0 == strcmp(s_ptr->file_ptr, file_ptr)) {
+                site_ptr = s_ptr;
+                break;
+            }
+            continue;
+        }
+
+        // An empty slot: The site does not exist yet. Re-probe under the
+        // lock, in case another thread just created it.
+        if (!locked) {
+            bs_mutex_lock(&_bs_alloc_stats_sites_mutex);
+            locked = true;
+            i = (size_t)-1;
+            continue;
+        }
+        site_ptr = _bs_alloc_stats_site_create(file_ptr, line);
+        if (NULL != site_ptr) bs_atomic_ptr_set(slot_ptr, site_ptr);
+        break;
+    }
+
+    if (NULL == site_ptr && locked) {
+        // The table is full.
+        if (NULL == _bs_alloc_stats_overflow_site_ptr) {
+            _bs_alloc_stats_overflow_site_ptr = _bs_alloc_stats_site_create(
+                "(other)", 0);
+        }
+        site_ptr = _bs_alloc_stats_overflow_site_ptr;
+    }
+    if (locked) bs_mutex_unlock(&_bs_alloc_stats_sites_mutex);
+    return site_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Creates a site, in zeroed and cache-line aligned memory. */
+bs_alloc_stats_site_state_t *_bs_alloc_stats_site_create(
+    const char *file_ptr, int line)
+{
+    // aligned_alloc(3) wants a multiple of the alignment.
+    size_t size = (sizeof(bs_alloc_stats_site_state_t) +
+                   _BS_ALLOC_STATS_CACHELINE - 1) &
+        ~(size_t)(_BS_ALLOC_STATS_CACHELINE - 1);
+    bs_alloc_stats_site_state_t *site_ptr = aligned_alloc(
+        _BS_ALLOC_STATS_CACHELINE, size);
+    if (NULL == site_ptr) return NULL;
+    memset(site_ptr, 0, size);
+    site_ptr->file_ptr = file_ptr;
+    site_ptr->line = line;
+    return site_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the size class for `size`. */
+unsigned _bs_alloc_stats_size_class(size_t size)
+{
+    if (1 >= size) return 0;
+    unsigned size_class = 64 - __builtin_clzll((unsigned long long)size - 1);
+    return BS_MIN(size_class, (unsigned)BS_ALLOC_STATS_SIZE_CLASSES - 1);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Adds `value` to the `counter` of the site, in the thread's shard. */
+void _bs_alloc_stats_count(bs_alloc_stats_site_state_t *site_ptr,
+                           int counter,
+                           int64_t value)
+{
+    bs_atomic_int64_add_explicit(
+        &site_ptr->counters[_bs_alloc_stats_shard()][counter], value,
+        BS_ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Initializes the mutexes of all stripes. */
+void _bs_alloc_stats_stripes_init(void)
+{
+    for (size_t i = 0; i < _BS_ALLOC_STATS_STRIPES; ++i) {
+        bs_mutex_init(&_bs_alloc_stats_stripes[i].mutex);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the stripe of the live table that holds `address`. */
+bs_alloc_stats_stripe_t *_bs_alloc_stats_stripe(uintptr_t address)
+{
+    pthread_once(&_bs_alloc_stats_stripes_once, _bs_alloc_stats_stripes_init);
+    return &_bs_alloc_stats_stripes[
+        (_bs_alloc_stats_hash(address) >> 32) % _BS_ALLOC_STATS_STRIPES];
+}
+
+/* ------------------------------------------------------------------------- */
+/** Doubles the capacity of the stripe. Must hold the stripe's mutex. */
+bool _bs_alloc_stats_stripe_grow(bs_alloc_stats_stripe_t *stripe_ptr)
+{
+    size_t capacity = BS_MAX(2 * stripe_ptr->capacity,
+                             (size_t)_BS_ALLOC_STATS_STRIPE_CAPACITY);
+    bs_alloc_stats_live_t *entries_ptr = calloc(
+        capacity, sizeof(bs_alloc_stats_live_t));
+    if (NULL == entries_ptr) return false;
+
+    for (size_t i = 0; i < stripe_ptr->capacity; ++i) {
+        const bs_alloc_stats_live_t *l_ptr = &stripe_ptr->entries_ptr[i];
+        if (0 == l_ptr->address) continue;
+        size_t pos = _bs_alloc_stats_hash(l_ptr->address) & (capacity - 1);
+        while (0 != entries_ptr[pos].address) pos = (pos + 1) & (capacity - 1);
+        entries_ptr[pos] = *l_ptr;
+    }
+    free(stripe_ptr->entries_ptr);
+    stripe_ptr->entries_ptr = entries_ptr;
+    stripe_ptr->capacity = capacity;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Inserts `l_ptr` into the stripe. Must hold the stripe's mutex, and the
+ * address must not be in the stripe.
+ *
+ * @return false if the stripe could not grow. The allocation is then not
+ *     tracked as live.
+ */
+bool _bs_alloc_stats_stripe_insert(bs_alloc_stats_stripe_t *stripe_ptr,
+                                   const bs_alloc_stats_live_t *l_ptr)
+{
+    // Keeps the load factor at or below 1/2.
+    if (2 * (stripe_ptr->size + 1) > stripe_ptr->capacity &&
+        !_bs_alloc_stats_stripe_grow(stripe_ptr)) return false;
+
+    size_t mask = stripe_ptr->capacity - 1;
+    size_t pos = _bs_alloc_stats_hash(l_ptr->address) & mask;
+    while (0 != stripe_ptr->entries_ptr[pos].address) pos = (pos + 1) & mask;
+    stripe_ptr->entries_ptr[pos] = *l_ptr;
+    stripe_ptr->size++;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Removes `address` from the stripe, and stores its entry at `l_ptr`. Must
+ * hold the stripe's mutex. Shifts back the following entries of the probe
+ * sequence, so that no tombstones are needed.
+ *
+ * @return true if `address` was found.
+ */
+bool _bs_alloc_stats_stripe_remove(bs_alloc_stats_stripe_t *stripe_ptr,
+                                   uintptr_t address,
+                                   bs_alloc_stats_live_t *l_ptr)
+{
+    if (0 == stripe_ptr->size) return false;
+
+    bs_alloc_stats_live_t *entries_ptr = stripe_ptr->entries_ptr;
+    size_t mask = stripe_ptr->capacity - 1;
+    size_t pos = _bs_alloc_stats_hash(address) & mask;
+    while (entries_ptr[pos].address != address) {
+        if (0 == entries_ptr[pos].address) return false;
+        pos = (pos + 1) & mask;
+    }
+    *l_ptr = entries_ptr[pos];
+
+    for (size_t next = (pos + 1) & mask;
+         0 != entries_ptr[next].address;
+         next = (next + 1) & mask) {
+        size_t home = _bs_alloc_stats_hash(entries_ptr[next].address) & mask;
+        // Moves the entry into the gap, unless its home lies after the gap.
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            entries_ptr[pos] = entries_ptr[next];
+            pos = next;
+        }
+    }
+    entries_ptr[pos].address = 0;
+    stripe_ptr->size--;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Accounts the release of the live allocation `l_ptr` at its site. */
+void _bs_alloc_stats_account_free(const bs_alloc_stats_live_t *l_ptr)
+{
+    _bs_alloc_stats_count(l_ptr->site_ptr, _BS_ALLOC_STATS_FREES, 1);
+    _bs_alloc_stats_count(l_ptr->site_ptr, _BS_ALLOC_STATS_FREED_BYTES,
+                          l_ptr->size);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Sums up the shards of `state_ptr` into `site_ptr`. */
+void _bs_alloc_stats_snapshot(bs_alloc_stats_site_state_t *state_ptr,
+                              bs_alloc_stats_site_t *site_ptr)
+{
+    int64_t sums[_BS_ALLOC_STATS_STRIDE] = { 0 };
+    for (unsigned s = 0; s < _BS_ALLOC_STATS_SHARDS; ++s) {
+        for (unsigned c = 0; c < _BS_ALLOC_STATS_STRIDE; ++c) {
+            sums[c] += bs_atomic_int64_get_explicit(
+                &state_ptr->counters[s][c], BS_ATOMIC_RELAXED);
+        }
+    }
+
+    memset(site_ptr, 0, sizeof(bs_alloc_stats_site_t));
+    site_ptr->file_ptr = state_ptr->file_ptr;
+    site_ptr->line = state_ptr->line;
+    site_ptr->allocs = sums[_BS_ALLOC_STATS_ALLOCS];
+    site_ptr->bytes = sums[_BS_ALLOC_STATS_BYTES];
+    site_ptr->live_allocs =
+        sums[_BS_ALLOC_STATS_ALLOCS] - sums[_BS_ALLOC_STATS_FREES];
+    site_ptr->live_bytes =
+        sums[_BS_ALLOC_STATS_BYTES] - sums[_BS_ALLOC_STATS_FREED_BYTES];
+    for (unsigned c = 0; c < BS_ALLOC_STATS_SIZE_CLASSES; ++c) {
+        site_ptr->size_classes[c] = sums[_BS_ALLOC_STATS_SIZE_CLASS_0 + c];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the key to sort `site_ptr` by, in descending order. */
+uint64_t _bs_alloc_stats_key(const bs_alloc_stats_site_t *site_ptr,
+                             bs_alloc_stats_order_t order)
+{
+    switch (order) {
+    case BS_ALLOC_STATS_BY_LIVE_BYTES:
+        return 0 < site_ptr->live_bytes ? (uint64_t)site_ptr->live_bytes : 0;
+    case BS_ALLOC_STATS_BY_BYTES:
+        return site_ptr->bytes;
+    case BS_ALLOC_STATS_BY_ALLOCS:
+    default:
+        return site_ptr->allocs;
+    }
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_account(bs_test_t *test_ptr);
+static void test_toggle(bs_test_t *test_ptr);
+static void test_top_n(bs_test_t *test_ptr);
+static void test_dump(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_alloc_stats_test_cases[] = {
+    { 1, "account", test_account },
+    { 1, "toggle", test_toggle },
+    { 1, "top_n", test_top_n },
+    { 1, "dump", test_dump },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Returns the snapshot of the site for this file at `line`. */
+static bool _test_find_site(int line, bs_alloc_stats_site_t *site_ptr)
+{
+    bs_alloc_stats_site_t sites[64];
+    size_t n = bs_alloc_stats_sites(sites, 64, BS_ALLOC_STATS_BY_ALLOCS);
+    for (size_t i = 0; i < n; ++i) {
+        if (sites[i].line == line &&
+            0 == strcmp(sites[i].file_ptr, __FILE__)) {
+            *site_ptr = sites[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies counts, bytes, live bytes and size classes of a site. */
+void test_account(bs_test_t *test_ptr)
+{
+    bs_alloc_stats_site_t     site;
+    void                      *ptrs[10];
+    int                       line = 0;
+
+    bs_alloc_stats_reset();
+    bs_alloc_stats_enable(true);
+    for (int i = 0; i < 10; ++i) {
+        line = __LINE__; ptrs[i] = logged_malloc(i < 5 ? 24 : 100);
+    }
+    bs_alloc_stats_enable(false);
+    for (int i = 0; i < 10; ++i) BS_TEST_VERIFY_NEQ(test_ptr, NULL, ptrs[i]);
+
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, _test_find_site(line, &site));
+    BS_TEST_VERIFY_EQ(test_ptr, 10, site.allocs);
+    BS_TEST_VERIFY_EQ(test_ptr, 620, site.bytes);
+    BS_TEST_VERIFY_EQ(test_ptr, 10, site.live_allocs);
+    BS_TEST_VERIFY_EQ(test_ptr, 620, site.live_bytes);
+    BS_TEST_VERIFY_EQ(test_ptr, 5, site.size_classes[5]);  // (16, 32]
+    BS_TEST_VERIFY_EQ(test_ptr, 5, site.size_classes[7]);  // (64, 128]
+
+    // Releases are accounted also while disabled.
+    for (int i = 0; i < 5; ++i) logged_free(ptrs[i]);
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, _test_find_site(line, &site));
+    BS_TEST_VERIFY_EQ(test_ptr, 10, site.allocs);
+    BS_TEST_VERIFY_EQ(test_ptr, 5, site.live_allocs);
+    BS_TEST_VERIFY_EQ(test_ptr, 500, site.live_bytes);
+    for (int i = 5; i < 10; ++i) logged_free(ptrs[i]);
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, _test_find_site(line, &site));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, site.live_allocs);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, site.live_bytes);
+
+    BS_TEST_VERIFY_EQ(test_ptr, 0, _bs_alloc_stats_size_class(0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, _bs_alloc_stats_size_class(1));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, _bs_alloc_stats_size_class(2));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, _bs_alloc_stats_size_class(3));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, _bs_alloc_stats_size_class(4));
+    BS_TEST_VERIFY_EQ(test_ptr, BS_ALLOC_STATS_SIZE_CLASSES - 1,
+                      _bs_alloc_stats_size_class(SIZE_MAX));
+    bs_alloc_stats_reset();
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies that nothing is accounted while disabled. */
+void test_toggle(bs_test_t *test_ptr)
+{
+    bs_alloc_stats_site_t     site;
+
+    bs_alloc_stats_reset();
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_alloc_stats_enabled());
+    int line = __LINE__; char *s_ptr = logged_strdup("untracked");
+    BS_TEST_VERIFY_FALSE(test_ptr, _test_find_site(line, &site));
+    logged_free(s_ptr);
+
+    bs_alloc_stats_enable(true);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_alloc_stats_enabled());
+    line = __LINE__; s_ptr = logged_strdup("tracked");
+    bs_alloc_stats_enable(false);
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, _test_find_site(line, &site));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, site.allocs);
+    BS_TEST_VERIFY_EQ(test_ptr, 8, site.live_bytes);
+
+    bs_alloc_stats_reset();
+    BS_TEST_VERIFY_FALSE(test_ptr, _test_find_site(line, &site));
+    logged_free(s_ptr);
+    BS_TEST_VERIFY_FALSE(test_ptr, _test_find_site(line, &site));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies ordering and truncation of the top sites. */
+void test_top_n(bs_test_t *test_ptr)
+{
+    bs_alloc_stats_site_t     sites[2];
+    void                      *a_ptr[3], *b_ptr;
+
+    bs_alloc_stats_reset();
+    bs_alloc_stats_enable(true);
+    for (int i = 0; i < 3; ++i) a_ptr[i] = logged_calloc(1, 16);
+    b_ptr = logged_calloc(4, 1000);
+    bs_alloc_stats_enable(false);
+
+    BS_TEST_VERIFY_EQ(test_ptr, 2, bs_alloc_stats_sites(
+                          sites, 2, BS_ALLOC_STATS_BY_ALLOCS));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, sites[0].allocs);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, sites[1].allocs);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, bs_alloc_stats_sites(
+                          sites, 2, BS_ALLOC_STATS_BY_BYTES));
+    BS_TEST_VERIFY_EQ(test_ptr, 4000, sites[0].bytes);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_alloc_stats_sites(
+                          sites, 1, BS_ALLOC_STATS_BY_LIVE_BYTES));
+    BS_TEST_VERIFY_EQ(test_ptr, 4000, sites[0].live_bytes);
+
+    logged_free(b_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_alloc_stats_sites(
+                          sites, 1, BS_ALLOC_STATS_BY_LIVE_BYTES));
+    BS_TEST_VERIFY_EQ(test_ptr, 48, sites[0].live_bytes);
+    for (int i = 0; i < 3; ++i) logged_free(a_ptr[i]);
+    bs_alloc_stats_reset();
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the report. */
+void test_dump(bs_test_t *test_ptr)
+{
+    char                      buf[1024];
+
+    bs_alloc_stats_reset();
+    bs_alloc_stats_enable(true);
+    void *ptr = logged_malloc(300);
+    bs_alloc_stats_enable(false);
+
+    FILE *stream_ptr = tmpfile();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, stream_ptr);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        0 < bs_alloc_stats_dump(stream_ptr, 10, BS_ALLOC_STATS_BY_LIVE_BYTES));
+    rewind(stream_ptr);
+    size_t len = fread(buf, 1, sizeof(buf) - 1, stream_ptr);
+    buf[len] = '\0';
+    fclose(stream_ptr);
+    logged_free(ptr);
+    bs_alloc_stats_reset();
+
+    BS_TEST_VERIFY_STRMATCH(
+        test_ptr, buf,
+        "^# Top 1 allocation sites by live bytes\\.\n#.*\n"
+        " +300 +1 +300 +1  .*alloc_stats\\.c:[0-9]+: <=512:1\n$");
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_malloc_free_disabled(bs_test_t *test_ptr);
+static void benchmark_malloc_free_enabled(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_alloc_stats_benchmarks[] = {
+    { 1, "benchmark-malloc_free-disabled", benchmark_malloc_free_disabled },
+    { 1, "benchmark-malloc_free-enabled", benchmark_malloc_free_enabled },
+    { 0, NULL, NULL }
+};
+
+/** Benchmark function: Allocates and releases through the wrappers. */
+static void _benchmark_malloc_free_fn(__UNUSED__ void *arg_ptr,
+                                      uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; ++i) {
+        void *ptr = logged_malloc(64);
+        BS_TEST_DO_NOT_OPTIMIZE(ptr);
+        logged_free(ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks logged_malloc() and logged_free(), without accounting. */
+void benchmark_malloc_free_disabled(bs_test_t *test_ptr)
+{
+    if (!bs_test_bench(test_ptr, "logged_malloc+free",
+                       _benchmark_malloc_free_fn, NULL, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(logged_malloc+free)");
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks logged_malloc() and logged_free(), with accounting. */
+void benchmark_malloc_free_enabled(bs_test_t *test_ptr)
+{
+    bs_alloc_stats_reset();
+    bs_alloc_stats_enable(true);
+    bool rv = bs_test_bench(test_ptr, "logged_malloc+free",
+                            _benchmark_malloc_free_fn, NULL, NULL);
+    bs_alloc_stats_enable(false);
+    bs_alloc_stats_reset();
+    if (!rv) BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(logged_malloc+free)");
+}
+
+/* == End of alloc_stats.c ================================================= */
@@ -0,0 +1,156 @@
+/* ========================================================================= */
+/**
+ * @file alloc_stats.h
+ * Allocation accounting per call site, for the `logged_*` allocators.
+ *
+ * When enabled, every allocation through @ref logged_calloc,
+ * @ref logged_malloc and @ref logged_strdup is attributed to its call site,
+ * by file and line. Each site counts allocations and bytes, keeps a
+ * histogram of the allocation sizes, and tracks the bytes that are still
+ * live: Memory released through @ref logged_free is subtracted from the site
+ * it was allocated at. @ref bs_alloc_stats_dump reports the top sites, eg.
+ * by live bytes to find leaks and the bulk of the footprint, or by number of
+ * allocations to find the hot paths.
+ *
+ * Counters are sharded per thread, as in @ref bs_metrics_counter_t. Live
+ * allocations are kept in a striped table, keyed by address. Memory released
+ * through plain free(3) or realloc(3) is not seen, and remains accounted as
+ * live.
+ *
+ * Accounting is off by default, and costs one relaxed load per allocation
+ * and per release then. It can be toggled at any time: Releases of
+ * allocations that were accounted are matched also while disabled.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_ALLOC_STATS_H__
+#define __LIBBASE_ALLOC_STATS_H__
+
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/**
+ * Number of size classes in the histogram. Class 0 holds sizes up to 1
+ * byte, class `k` holds sizes in (2^(k-1), 2^k], and the last class holds
+ * everything larger than 2^(k-1).
+ */
+#define BS_ALLOC_STATS_SIZE_CLASSES 33
+
+/** Orders for @ref bs_alloc_stats_sites and @ref bs_alloc_stats_dump. */
+typedef enum {
+    /** By bytes allocated and not yet released. */
+    BS_ALLOC_STATS_BY_LIVE_BYTES,
+    /** By bytes allocated in total. */
+    BS_ALLOC_STATS_BY_BYTES,
+    /** By number of allocations. */
+    BS_ALLOC_STATS_BY_ALLOCS
+} bs_alloc_stats_order_t;
+
+/** Statistics of a call site. */
+typedef struct {
+    /** File name of the call site, as per `__FILE__`. */
+    const char                *file_ptr;
+    /** Line number of the call site. */
+    int                       line;
+    /** Number of allocations. */
+    uint64_t                  allocs;
+    /** Bytes allocated, in total. */
+    uint64_t                  bytes;
+    /** Number of allocations not yet released. */
+    int64_t                   live_allocs;
+    /** Bytes allocated and not yet released. */
+    int64_t                   live_bytes;
+    /** Number of allocations, per size class. */
+    uint64_t                  size_classes[BS_ALLOC_STATS_SIZE_CLASSES];
+} bs_alloc_stats_site_t;
+
+/**
+ * Enables or disables accounting. Thread-safe.
+ *
+ * @param enabled
+ */
+void bs_alloc_stats_enable(bool enabled);
+
+/** Returns whether accounting is enabled. */
+bool bs_alloc_stats_enabled(void);
+
+/**
+ * Clears all statistics, and forgets about live allocations. Allocations
+ * that run concurrently may or may not be accounted.
+ */
+void bs_alloc_stats_reset(void);
+
+/**
+ * Takes a snapshot of the top call sites. Thread-safe.
+ *
+ * @param sites_ptr           Array of at least `max_sites` elements.
+ * @param max_sites
+ * @param order               Which sites to report first.
+ *
+ * @return Number of sites stored at `sites_ptr`.
+ */
+size_t bs_alloc_stats_sites(bs_alloc_stats_site_t *sites_ptr,
+                            size_t max_sites,
+                            bs_alloc_stats_order_t order);
+
+/**
+ * Writes a report of the top `top_n` call sites to `stream_ptr`: One line
+ * per site, with its totals and the non-empty size classes.
+ *
+ * @param stream_ptr
+ * @param top_n
+ * @param order
+ *
+ * @return Number of bytes written, or a negative value on error.
+ */
+int bs_alloc_stats_dump(FILE *stream_ptr,
+                        size_t top_n,
+                        bs_alloc_stats_order_t order);
+
+/** @private Non-zero while accounting is enabled. */
+extern int                    _bs_alloc_stats_on;
+/** @private Number of live allocations that are accounted. */
+extern int64_t                _bs_alloc_stats_live;
+
+/** @private Accounts the allocation of `size` bytes at `ptr`. */
+void _bs_alloc_stats_record_alloc(const char *file_ptr,
+                                  int line,
+                                  void *ptr,
+                                  size_t size);
+
+/** @private Accounts the release of `ptr`, if it was accounted. */
+void _bs_alloc_stats_record_free(const void *ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_alloc_stats_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_alloc_stats_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_ALLOC_STATS_H__ */
+/* == End of alloc_stats.h ================================================= */
@@ -0,0 +1,356 @@
+/* ========================================================================= */
+/**
+ * @file arena.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "arena.h"
+
+#include "def.h"
+#include "log_wrappers.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* == Declarations ========================================================= */
+
+/** Default size of a chunk, including the header. */
+#define _BS_ARENA_DEFAULT_CHUNK_SIZE 4096
+
+/** Alignment of all allocations. */
+#define _BS_ARENA_ALIGNMENT   alignof(max_align_t)
+
+/** Rounds `_size` up to a multiple of @ref _BS_ARENA_ALIGNMENT. */
+#define _BS_ARENA_ALIGN(_size)                                          \
+    (((_size) + _BS_ARENA_ALIGNMENT - 1) & ~(_BS_ARENA_ALIGNMENT - 1))
+
+/** A chunk. Its data follows after the (aligned) header. */
+typedef struct _bs_arena_chunk_t bs_arena_chunk_t;
+/** Actual struct of the chunk. */
+struct _bs_arena_chunk_t {
+    /** Next chunk, or NULL if this is the last. */
+    bs_arena_chunk_t          *next_ptr;
+    /** Size of the chunk's data. */
+    size_t                    size;
+};
+
+/** @private State of the arena. */
+struct _bs_arena_t {
+    /** Size of a regular chunk's data. */
+    size_t                    chunk_size;
+    /** The current chunk for bump allocations, first of all chunks. */
+    bs_arena_chunk_t          *chunk_ptr;
+    /** Position of the next allocation in the current chunk's data. */
+    size_t                    pos;
+    /** The most recent allocation, if from the current chunk. Or NULL. */
+    uint8_t                   *last_ptr;
+};
+
+static uint8_t *_bs_arena_chunk_data(bs_arena_chunk_t *chunk_ptr);
+static bs_arena_chunk_t *_bs_arena_chunk_create(size_t size);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_arena_t *bs_arena_create(size_t chunk_size)
+{
+    if (0 == chunk_size) chunk_size = _BS_ARENA_DEFAULT_CHUNK_SIZE;
+    if (chunk_size > SIZE_MAX / 2) {
+        bs_log(BS_ERROR, "Chunk size %zu too large", chunk_size);
+        return NULL;
+    }
+
+    bs_arena_t *arena_ptr = logged_calloc(1, sizeof(bs_arena_t));
+    if (NULL == arena_ptr) return NULL;
+    size_t header_size = _BS_ARENA_ALIGN(sizeof(bs_arena_chunk_t));
+    chunk_size = _BS_ARENA_ALIGN(chunk_size);
+    arena_ptr->chunk_size = chunk_size > header_size ?
+        chunk_size - header_size : _BS_ARENA_ALIGNMENT;
+    return arena_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_arena_destroy(bs_arena_t *arena_ptr)
+{
+    while (NULL != arena_ptr->chunk_ptr) {
+        bs_arena_chunk_t *chunk_ptr = arena_ptr->chunk_ptr;
+        arena_ptr->chunk_ptr = chunk_ptr->next_ptr;
+        logged_free(chunk_ptr);
+    }
+    logged_free(arena_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_arena_reset(bs_arena_t *arena_ptr)
+{
+    // The first chunk is always a regular one. Keep it, free the others.
+    if (NULL != arena_ptr->chunk_ptr) {
+        while (NULL != arena_ptr->chunk_ptr->next_ptr) {
+            bs_arena_chunk_t *chunk_ptr = arena_ptr->chunk_ptr->next_ptr;
+            arena_ptr->chunk_ptr->next_ptr = chunk_ptr->next_ptr;
+            logged_free(chunk_ptr);
+        }
+    }
+    arena_ptr->pos = 0;
+    arena_ptr->last_ptr = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+void *bs_arena_alloc(bs_arena_t *arena_ptr, size_t size)
+{
+    bs_arena_chunk_t          *chunk_ptr;
+
+    if (size > SIZE_MAX - _BS_ARENA_ALIGNMENT) {
+        bs_log(BS_ERROR, "Size %zu too large", size);
+        return NULL;
+    }
+    size = _BS_ARENA_ALIGN(BS_MAX(size, (size_t)1));
+
+    chunk_ptr = arena_ptr->chunk_ptr;
+    if (NULL != chunk_ptr && arena_ptr->pos + size <= chunk_ptr->size) {
+        arena_ptr->last_ptr = _bs_arena_chunk_data(chunk_ptr) +
+            arena_ptr->pos;
+        arena_ptr->pos += size;
+        return arena_ptr->last_ptr;
+    }
+
+    if (size > arena_ptr->chunk_size / 4) {
+        // Large allocation: Gets a chunk of its own. Keep it behind the
+        // current chunk, which may still have space for more.
+        chunk_ptr = _bs_arena_chunk_create(size);
+        if (NULL == chunk_ptr) return NULL;
+        if (NULL == arena_ptr->chunk_ptr) {
+            // Keep a regular chunk at the front, as the reset expects.
+            arena_ptr->chunk_ptr = _bs_arena_chunk_create(
+                arena_ptr->chunk_size);
+            if (NULL == arena_ptr->chunk_ptr) {
+                logged_free(chunk_ptr);
+                return NULL;
+            }
+            arena_ptr->pos = 0;
+        }
+        chunk_ptr->next_ptr = arena_ptr->chunk_ptr->next_ptr;
+        arena_ptr->chunk_ptr->next_ptr = chunk_ptr;
+        return _bs_arena_chunk_data(chunk_ptr);
+    }
+
+    chunk_ptr = _bs_arena_chunk_create(arena_ptr->chunk_size);
+    if (NULL == chunk_ptr) return NULL;
+    chunk_ptr->next_ptr = arena_ptr->chunk_ptr;
+    arena_ptr->chunk_ptr = chunk_ptr;
+    arena_ptr->last_ptr = _bs_arena_chunk_data(chunk_ptr);
+    arena_ptr->pos = size;
+    return arena_ptr->last_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void *bs_arena_calloc(bs_arena_t *arena_ptr, size_t nmemb, size_t size)
+{
+    if (0 != size && nmemb > SIZE_MAX / size) {
+        bs_log(BS_ERROR, "Size %zu * %zu too large", nmemb, size);
+        return NULL;
+    }
+    void *ptr = bs_arena_alloc(arena_ptr, nmemb * size);
+    if (NULL != ptr) memset(ptr, 0, nmemb * size);
+    return ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void *bs_arena_realloc(bs_arena_t *arena_ptr,
+                       void *ptr,
+                       size_t old_size,
+                       size_t new_size)
+{
+    if (NULL == ptr) return bs_arena_alloc(arena_ptr, new_size);
+
+    if (ptr == arena_ptr->last_ptr && new_size <= SIZE_MAX / 2) {
+        size_t offset = arena_ptr->last_ptr - _bs_arena_chunk_data(
+            arena_ptr->chunk_ptr);
+        size_t size = _BS_ARENA_ALIGN(BS_MAX(new_size, (size_t)1));
+        if (offset + size <= arena_ptr->chunk_ptr->size) {
+            arena_ptr->pos = offset + size;
+            return ptr;
+        }
+    }
+
+    void *new_ptr = bs_arena_alloc(arena_ptr, new_size);
+    if (NULL == new_ptr) return NULL;
+    memcpy(new_ptr, ptr, BS_MIN(old_size, new_size));
+    return new_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+char *bs_arena_strdup(bs_arena_t *arena_ptr, const char *str_ptr)
+{
+    size_t len = strlen(str_ptr);
+    char *new_str_ptr = bs_arena_alloc(arena_ptr, len + 1);
+    if (NULL == new_str_ptr) return NULL;
+    memcpy(new_str_ptr, str_ptr, len + 1);
+    return new_str_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+char *bs_arena_strndup(bs_arena_t *arena_ptr,
+                       const char *str_ptr,
+                       size_t len)
+{
+    len = strnlen(str_ptr, len);
+    char *new_str_ptr = bs_arena_alloc(arena_ptr, len + 1);
+    if (NULL == new_str_ptr) return NULL;
+    memcpy(new_str_ptr, str_ptr, len);
+    new_str_ptr[len] = '\0';
+    return new_str_ptr;
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Returns a pointer to the chunk's data. */
+uint8_t *_bs_arena_chunk_data(bs_arena_chunk_t *chunk_ptr)
+{
+    return (uint8_t*)chunk_ptr + _BS_ARENA_ALIGN(sizeof(bs_arena_chunk_t));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Allocates a chunk with `size` bytes of data. */
+bs_arena_chunk_t *_bs_arena_chunk_create(size_t size)
+{
+    size_t header_size = _BS_ARENA_ALIGN(sizeof(bs_arena_chunk_t));
+    if (size > SIZE_MAX - header_size) return NULL;
+    bs_arena_chunk_t *chunk_ptr = logged_malloc(header_size + size);
+    if (NULL == chunk_ptr) return NULL;
+    chunk_ptr->next_ptr = NULL;
+    chunk_ptr->size = size;
+    return chunk_ptr;
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_alloc(bs_test_t *test_ptr);
+static void test_realloc(bs_test_t *test_ptr);
+static void test_reset(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_arena_test_cases[] = {
+    { 1, "alloc", test_alloc },
+    { 1, "realloc", test_realloc },
+    { 1, "reset", test_reset },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Verifies allocations are aligned, distinct and span chunks. */
+void test_alloc(bs_test_t *test_ptr)
+{
+    size_t                    *ptrs[100];
+
+    bs_arena_t *arena_ptr = bs_arena_create(256);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, arena_ptr);
+
+    for (size_t i = 0; i < 100; ++i) {
+        ptrs[i] = bs_arena_alloc(arena_ptr, (i % 3 + 1) * sizeof(size_t));
+        BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, ptrs[i]);
+        BS_TEST_VERIFY_EQ(test_ptr, 0,
+                          (uintptr_t)ptrs[i] % _BS_ARENA_ALIGNMENT);
+        *ptrs[i] = i;
+    }
+    for (size_t i = 0; i < 100; ++i) {
+        BS_TEST_VERIFY_EQ(test_ptr, i, *ptrs[i]);
+    }
+
+    // Larger than the chunk, and zero-initialized.
+    uint8_t *large_ptr = bs_arena_calloc(arena_ptr, 1000, 1);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, large_ptr);
+    for (size_t i = 0; i < 1000; ++i) {
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 0, large_ptr[i]);
+    }
+
+    char *s_ptr = bs_arena_strdup(arena_ptr, "a string");
+    BS_TEST_VERIFY_STREQ(test_ptr, "a string", s_ptr);
+    s_ptr = bs_arena_strndup(arena_ptr, "a string", 3);
+    BS_TEST_VERIFY_STREQ(test_ptr, "a s", s_ptr);
+    s_ptr = bs_arena_strndup(arena_ptr, "ab", 3);
+    BS_TEST_VERIFY_STREQ(test_ptr, "ab", s_ptr);
+
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_arena_calloc(arena_ptr, SIZE_MAX, 2));
+    bs_arena_destroy(arena_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies in-place growth and shrinking, and copying otherwise. */
+void test_realloc(bs_test_t *test_ptr)
+{
+    bs_arena_t *arena_ptr = bs_arena_create(256);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, arena_ptr);
+
+    char *a_ptr = bs_arena_realloc(arena_ptr, NULL, 0, 4);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, a_ptr);
+    strcpy(a_ptr, "abc");
+    BS_TEST_VERIFY_EQ(test_ptr, a_ptr,
+                      bs_arena_realloc(arena_ptr, a_ptr, 4, 64));
+    BS_TEST_VERIFY_EQ(test_ptr, a_ptr,
+                      bs_arena_realloc(arena_ptr, a_ptr, 64, 2));
+
+    // After a shrink, the next allocation re-uses the space.
+    char *b_ptr = bs_arena_alloc(arena_ptr, 1);
+    BS_TEST_VERIFY_EQ(test_ptr, a_ptr + _BS_ARENA_ALIGNMENT, b_ptr);
+
+    // Not the most recent allocation anymore: Gets copied.
+    char *n_ptr = bs_arena_realloc(arena_ptr, a_ptr, 4, 8);
+    BS_TEST_VERIFY_NEQ(test_ptr, a_ptr, n_ptr);
+    BS_TEST_VERIFY_STREQ(test_ptr, "abc", n_ptr);
+
+    // Beyond the chunk: Gets copied.
+    char *m_ptr = bs_arena_realloc(arena_ptr, n_ptr, 8, 1024);
+    BS_TEST_VERIFY_NEQ(test_ptr, n_ptr, m_ptr);
+    BS_TEST_VERIFY_STREQ(test_ptr, "abc", m_ptr);
+
+    bs_arena_destroy(arena_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies reset frees all but one chunk, and memory gets re-used. */
+void test_reset(bs_test_t *test_ptr)
+{
+    bs_arena_t *arena_ptr = bs_arena_create(256);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, arena_ptr);
+
+    bs_arena_reset(arena_ptr);
+    for (int i = 0; i < 100; ++i) bs_arena_alloc(arena_ptr, 8);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, bs_arena_alloc(arena_ptr, 4096));
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, arena_ptr->chunk_ptr->next_ptr);
+
+    bs_arena_reset(arena_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, arena_ptr->chunk_ptr->next_ptr);
+    void *ptr = bs_arena_alloc(arena_ptr, 8);
+    BS_TEST_VERIFY_EQ(test_ptr, _bs_arena_chunk_data(arena_ptr->chunk_ptr),
+                      ptr);
+
+    // A large allocation into an empty arena keeps a regular chunk first.
+    bs_arena_destroy(arena_ptr);
+    arena_ptr = bs_arena_create(256);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, arena_ptr);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, bs_arena_alloc(arena_ptr, 4096));
+    BS_TEST_VERIFY_EQ(test_ptr, arena_ptr->chunk_size,
+                      arena_ptr->chunk_ptr->size);
+    bs_arena_reset(arena_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, arena_ptr->chunk_ptr->next_ptr);
+    bs_arena_destroy(arena_ptr);
+}
+
+/* == End of arena.c ======================================================= */
@@ -0,0 +1,109 @@
+/* ========================================================================= */
+/**
+ * @file arena.h
+ * An arena allocator: Bump-allocates from chunks, and frees all at once.
+ * For short-lived allocations that all die together, eg. when parsing.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_ARENA_H__
+#define __LIBBASE_ARENA_H__
+
+#include "test.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Forward declaration: The arena. Not thread-safe. */
+typedef struct _bs_arena_t bs_arena_t;
+
+/**
+ * Creates an arena.
+ *
+ * @param chunk_size          Size of each chunk to allocate from. 0 picks a
+ *                            default. Larger allocations get their own chunk.
+ *
+ * @return A pointer to the arena, or NULL on error. Must be destroyed by
+ *     calling @ref bs_arena_destroy.
+ */
+bs_arena_t *bs_arena_create(size_t chunk_size);
+
+/**
+ * Destroys the arena, and frees all memory allocated from it.
+ *
+ * @param arena_ptr
+ */
+void bs_arena_destroy(bs_arena_t *arena_ptr);
+
+/**
+ * Frees all memory allocated from the arena. Keeps one chunk, for re-use.
+ *
+ * @param arena_ptr
+ */
+void bs_arena_reset(bs_arena_t *arena_ptr);
+
+/**
+ * Allocates `size` bytes. Aligned as for malloc(3).
+ *
+ * @param arena_ptr
+ * @param size
+ *
+ * @return A pointer to the memory, or NULL on error. Uninitialized. Valid
+ *     until the arena is reset or destroyed.
+ */
+void *bs_arena_alloc(bs_arena_t *arena_ptr, size_t size);
+
+/** Allocates `nmemb` * `size` bytes, zero-initialized. NULL on error. */
+void *bs_arena_calloc(bs_arena_t *arena_ptr, size_t nmemb, size_t size);
+
+/**
+ * Re-sizes the allocation at `ptr`. Grows or shrinks in place if `ptr` is
+ * the most recent allocation and the chunk has space. Otherwise, allocates
+ * and copies, leaving the old allocation unused until reset.
+ *
+ * @param arena_ptr
+ * @param ptr                 An allocation from `arena_ptr`, or NULL.
+ * @param old_size            The size that `ptr` was allocated with.
+ * @param new_size
+ *
+ * @return A pointer to the re-sized memory, or NULL on error. On error, the
+ *     allocation at `ptr` remains valid.
+ */
+void *bs_arena_realloc(bs_arena_t *arena_ptr,
+                       void *ptr,
+                       size_t old_size,
+                       size_t new_size);
+
+/** Returns a copy of the NUL-terminated `str_ptr`, or NULL on error. */
+char *bs_arena_strdup(bs_arena_t *arena_ptr, const char *str_ptr);
+
+/** Returns a NUL-terminated copy of at most `len` chars, or NULL. */
+char *bs_arena_strndup(bs_arena_t *arena_ptr,
+                       const char *str_ptr,
+                       size_t len);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_arena_test_cases[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_ARENA_H__ */
+/* == End of arena.h ======================================================= */
@@ -18,11 +18,14 @@
  * limitations under the License.
  */
 
+#include "arena.h"
 #include "arg.h"
 #include "assert.h"
-#include "avltree.h"
 #include "c2x_compat.h"
+#include "file.h"
+#include "hashmap.h"
 #include "log.h"
+#include "log_wrappers.h"
 #include "strutil.h"
 
 #include <ctype.h>
@@ -30,7 +33,9 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 /* == Declarations ========================================================= */
 
@@ -48,13 +53,50 @@ typedef enum {
     _BS_ARG_MATCH_BOOL_OVERRIDE_WITH_NO = 4
 } bs_arg_match_t;
 
+/**
+ * Index of the arg names, for lookup in constant time. Holds each name, and
+ * the "no"-prefixed name of each bool. All from an arena.
+ */
+typedef struct {
+    /** The arena, holding the index itself and all names. */
+    bs_arena_t                *arena_ptr;
+    /** Maps the names to @ref arg_name_t. */
+    bs_hashmap_t              *hashmap_ptr;
+} arg_index_t;
+
+/** An arg name in the index. From the index' arena. */
+typedef struct {
+    /** Hash map node. */
+    bs_hashmap_node_t         node;
+    /** Argument name. */
+    char                      *name_ptr;
+    /** Length of the name. */
+    size_t                    name_len;
+    /** Whether this is the "no"-prefixed name of a bool. */
+    bool                      negated;
+    /** The arg. */
+    const bs_arg_t            *arg_ptr;
+} arg_name_t;
+
+/** Key for the index: A name, not necessarily NUL-terminated. */
+typedef struct {
+    /** The name. */
+    const char                *name_ptr;
+    /** Length of the name. */
+    size_t                    name_len;
+} arg_name_key_t;
+
 static bs_arg_match_t get_match_type(const bs_arg_t *arg_ptr,
                                      const char *argv, const char *next_argv,
                                      const char **arg_value_ptr);
-static bool find_matching_arg(const bs_arg_t *arg_ptr,
+static bool find_matching_arg(const arg_index_t *index_ptr,
                               const char *argv, const char *next_argv,
                               const bs_arg_t **matching_arg_ptr,
                               const char **arg_value_ptr);
+static bool load_config(const arg_index_t *index_ptr,
+                        const char *fname_ptr,
+                        const char *data_ptr,
+                        size_t size);
 static bool parse_arg(const bs_arg_t *arg_ptr, const char *value_ptr);
 static bool parse_bool(const bs_arg_bool_t *arg_bool_ptr,
                        const char *value_ptr);
@@ -66,20 +108,21 @@ static bool parse_uint32(const bs_arg_uint32_t *arg_uint32_ptr,
                          const char *value_ptr);
 
 static void set_all_defaults(const bs_arg_t *arg_ptr);
-static bool check_arg(const bs_arg_t *arg_ptr);
-
-/**  Store an arg name in a tree, to identify duplicates. */
-typedef struct {
-    /** Tree node. */
-    bs_avltree_node_t         node;
-    /** Argument name. */
-    char                      *name_ptr;
-} arg_name_t;
-
-static int node_cmp(const bs_avltree_node_t *node_ptr, const void *key_ptr);
-static arg_name_t *node_create(const char *prefix_ptr, const char *name_ptr);
-static void node_destroy(bs_avltree_node_t *node_ptr);
+static arg_index_t *check_arg(const bs_arg_t *arg_ptr);
+
+static arg_index_t *index_create(void);
+static void index_destroy(arg_index_t *index_ptr);
+static bool index_insert(arg_index_t *index_ptr,
+                         const char *prefix_ptr,
+                         const bs_arg_t *arg_ptr);
+static const arg_name_t *index_lookup(const arg_index_t *index_ptr,
+                                      const char *name_ptr,
+                                      size_t name_len);
+static uint64_t node_hash(const void *key_ptr);
+static bool node_equals(const bs_hashmap_node_t *node_ptr,
+                        const void *key_ptr);
 static bool is_name_valid(const char *name_ptr);
+static bool is_space(char c);
 
 static bool lookup_enum(const bs_arg_enum_table_t *lookup_table,
                         const char *name_ptr,
@@ -96,7 +139,17 @@ static const char             *bs_arg_bool_value_false = "false";
 bool bs_arg_parse(const bs_arg_t *arg_ptr, const bs_arg_mode_t mode,
                   int *argc_ptr, const char **argv_ptr)
 {
-    if (!check_arg(arg_ptr)) {
+    return bs_arg_parse_with_config(arg_ptr, NULL, mode, argc_ptr, argv_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_arg_parse_with_config(const bs_arg_t *arg_ptr,
+                              const char *config_fname_ptr,
+                              const bs_arg_mode_t mode,
+                              int *argc_ptr, const char **argv_ptr)
+{
+    arg_index_t *index_ptr = check_arg(arg_ptr);
+    if (NULL == index_ptr) {
         return false;
     }
 
@@ -106,12 +159,30 @@ bool bs_arg_parse(const bs_arg_t *arg_ptr, const bs_arg_mode_t mode,
 
     set_all_defaults(arg_ptr);
 
+    if (NULL != config_fname_ptr) {
+        bs_file_mapping_t mapping;
+        if (!bs_file_map(config_fname_ptr, &mapping)) {
+            index_destroy(index_ptr);
+            bs_arg_cleanup(arg_ptr);
+            return false;
+        }
+        bool loaded = load_config(index_ptr, config_fname_ptr,
+                                  mapping.data_ptr, mapping.size);
+        bs_file_unmap(&mapping);
+        if (!loaded) {
+            index_destroy(index_ptr);
+            bs_arg_cleanup(arg_ptr);
+            return false;
+        }
+    }
+
     // Start at 1 -- argv_ptr[0] is the program's name.
     for (int i = 1; i < *argc_ptr; ++i) {
         next_argv_ptr = i + 1 >= *argc_ptr ? NULL : argv_ptr[i+1];
 
-        if (!find_matching_arg(arg_ptr, argv_ptr[i], next_argv_ptr,
+        if (!find_matching_arg(index_ptr, argv_ptr[i], next_argv_ptr,
                                &matching_arg_ptr, &arg_value_ptr)) {
+            index_destroy(index_ptr);
             bs_arg_cleanup(arg_ptr);
             return false;
         }
@@ -121,6 +192,7 @@ bool bs_arg_parse(const bs_arg_t *arg_ptr, const bs_arg_mode_t mode,
         }
 
         if (!parse_arg(matching_arg_ptr, arg_value_ptr)) {
+            index_destroy(index_ptr);
             bs_arg_cleanup(arg_ptr);
             return false;
         }
@@ -128,6 +200,7 @@ bool bs_arg_parse(const bs_arg_t *arg_ptr, const bs_arg_mode_t mode,
         // Move by two args, if the next arg was actually used.
         if (arg_value_ptr == next_argv_ptr) ++i;
     }
+    index_destroy(index_ptr);
 
     // Cleanup rest of argv.
     for (int i = not_consumed; i < *argc_ptr; ++i) {
@@ -169,6 +242,24 @@ bool bs_arg_parse(const bs_arg_t *arg_ptr, const bs_arg_mode_t mode,
     return retval;
 }
 
+/* ------------------------------------------------------------------------- */
+bool bs_arg_load_config(const bs_arg_t *arg_ptr, const char *fname_ptr)
+{
+    bs_file_mapping_t         mapping;
+
+    arg_index_t *index_ptr = check_arg(arg_ptr);
+    if (NULL == index_ptr) return false;
+    if (!bs_file_map(fname_ptr, &mapping)) {
+        index_destroy(index_ptr);
+        return false;
+    }
+    bool retval = load_config(index_ptr, fname_ptr,
+                              mapping.data_ptr, mapping.size);
+    bs_file_unmap(&mapping);
+    index_destroy(index_ptr);
+    return retval;
+}
+
 /* ------------------------------------------------------------------------- */
 void bs_arg_cleanup(const bs_arg_t *arg_ptr)
 {
@@ -273,8 +364,13 @@ bs_arg_match_t get_match_type(const bs_arg_t *arg_ptr,
 }
 
 /* ------------------------------------------------------------------------- */
-/** Finds the arg matching |argv|. Updates arg_value_ptr to the value. */
-bool find_matching_arg(const bs_arg_t *arg_ptr,
+/**
+ * Finds the arg matching |argv|. Updates arg_value_ptr to the value.
+ *
+ * Looks up the name, up to any '=', in the index. The only candidate is then
+ * matched by @ref get_match_type.
+ */
+bool find_matching_arg(const arg_index_t *index_ptr,
                        const char *argv, const char *next_argv,
                        const bs_arg_t **matching_arg_ptr,
                        const char **arg_value_ptr)
@@ -283,7 +379,13 @@ bool find_matching_arg(const bs_arg_t *arg_ptr,
 
     *matching_arg_ptr = NULL;
     *arg_value_ptr = NULL;
-    for (; BS_ARG_TYPE_UNDEFINED != arg_ptr->type; ++arg_ptr) {
+    if (0 != strncmp(argv, "--", 2)) return true;
+
+    const char *name_ptr = argv + 2;
+    const arg_name_t *arg_name_ptr = index_lookup(
+        index_ptr, name_ptr, strcspn(name_ptr, "="));
+    if (NULL != arg_name_ptr) {
+        const bs_arg_t *arg_ptr = arg_name_ptr->arg_ptr;
 
         match_type = get_match_type(arg_ptr, argv, next_argv, arg_value_ptr);
         switch (match_type) {
@@ -321,6 +423,108 @@ bool find_matching_arg(const bs_arg_t *arg_ptr,
     return true;
 }
 
+/* ------------------------------------------------------------------------- */
+/**
+ * Parses the configuration at `data_ptr` and applies each option.
+ *
+ * @param index_ptr
+ * @param fname_ptr           Name of the file, for reporting errors.
+ * @param data_ptr            Contents of the file. Need not be NUL-terminated.
+ * @param size
+ *
+ * @return true on success.
+ */
+bool load_config(const arg_index_t *index_ptr,
+                 const char *fname_ptr,
+                 const char *data_ptr,
+                 size_t size)
+{
+    const char                *end_ptr = data_ptr + size;
+    const char                *line_end_ptr;
+    char                      *value_ptr = NULL;
+    size_t                    value_capacity = 0;
+    bool                      retval = true;
+
+    for (size_t line = 1; retval && data_ptr < end_ptr;
+         ++line, data_ptr = line_end_ptr + 1) {
+        line_end_ptr = memchr(data_ptr, '\n', end_ptr - data_ptr);
+        if (NULL == line_end_ptr) line_end_ptr = end_ptr;
+
+        // Trim whitespace, and skip empty lines and comments.
+        const char *begin_ptr = data_ptr, *last_ptr = line_end_ptr;
+        while (begin_ptr < last_ptr && is_space(*begin_ptr)) ++begin_ptr;
+        while (begin_ptr < last_ptr && is_space(last_ptr[-1])) --last_ptr;
+        if (begin_ptr == last_ptr || '#' == *begin_ptr) continue;
+
+        const char *name_end_ptr = memchr(begin_ptr, '=', last_ptr - begin_ptr);
+        const char *v_ptr = NULL;
+        size_t v_len = 0;
+        if (NULL != name_end_ptr) {
+            v_ptr = name_end_ptr + 1;
+            while (v_ptr < last_ptr && is_space(*v_ptr)) ++v_ptr;
+            v_len = last_ptr - v_ptr;
+        } else {
+            name_end_ptr = last_ptr;
+        }
+        while (begin_ptr < name_end_ptr && is_space(name_end_ptr[-1])) {
+            --name_end_ptr;
+        }
+
+        size_t name_len = name_end_ptr - begin_ptr;
+        const arg_name_t *arg_name_ptr = index_lookup(
+            index_ptr, begin_ptr, name_len);
+        if (NULL == arg_name_ptr) {
+            bs_log(BS_ERROR, "%s:%zu: Unknown option \"%.*s\"",
+                   fname_ptr, line, (int)name_len, begin_ptr);
+            retval = false;
+            continue;
+        }
+
+        // Booleans may come without value. Their "no" name must.
+        if (arg_name_ptr->negated || (
+                BS_ARG_TYPE_BOOL == arg_name_ptr->arg_ptr->type &&
+                NULL == v_ptr)) {
+            if (NULL != v_ptr) {
+                bs_log(BS_ERROR, "%s:%zu: Unexpected value for \"%.*s\"",
+                       fname_ptr, line, (int)name_len, begin_ptr);
+                retval = false;
+                continue;
+            }
+            v_ptr = arg_name_ptr->negated ?
+                bs_arg_bool_value_false : bs_arg_bool_value_true;
+            v_len = strlen(v_ptr);
+        } else if (NULL == v_ptr) {
+            bs_log(BS_ERROR, "%s:%zu: Missing value for \"%.*s\"",
+                   fname_ptr, line, (int)name_len, begin_ptr);
+            retval = false;
+            continue;
+        }
+
+        // The handlers expect a NUL-terminated value.
+        if (v_len + 1 > value_capacity) {
+            // The prior value is consumed, no need to keep it.
+            logged_free(value_ptr);
+            value_capacity = 0;
+            value_ptr = logged_malloc(v_len + 1);
+            if (NULL == value_ptr) {
+                retval = false;
+                continue;
+            }
+            value_capacity = v_len + 1;
+        }
+        memcpy(value_ptr, v_ptr, v_len);
+        value_ptr[v_len] = '\0';
+
+        if (!parse_arg(arg_name_ptr->arg_ptr, value_ptr)) {
+            bs_log(BS_ERROR, "%s:%zu: Invalid option", fname_ptr, line);
+            retval = false;
+        }
+    }
+
+    logged_free(value_ptr);
+    return retval;
+}
+
 /* ------------------------------------------------------------------------- */
 /** Parses |value_ptr| for |arg_ptr|. */
 bool parse_arg(const bs_arg_t *arg_ptr, const char *value_ptr)
@@ -485,13 +689,19 @@ void set_all_defaults(const bs_arg_t *arg_ptr)
 }
 
 /* ------------------------------------------------------------------------- */
-bool check_arg(const bs_arg_t *arg_ptr)
+/**
+ * Checks the args, and indexes their names. Duplicate names are an error.
+ *
+ * @return The index, or NULL on error. Must be destroyed by
+ *     @ref index_destroy.
+ */
+arg_index_t *check_arg(const bs_arg_t *arg_ptr)
 {
     bool                      retval = true;
-    bs_avltree_t              *tree_ptr;
-    arg_name_t                *arg_name_ptr;
+    arg_index_t               *index_ptr;
 
-    tree_ptr = bs_avltree_create(node_cmp, node_destroy);
+    index_ptr = index_create();
+    if (NULL == index_ptr) return NULL;
 
     for (; BS_ARG_TYPE_UNDEFINED != arg_ptr->type; ++arg_ptr) {
 
@@ -506,12 +716,7 @@ bool check_arg(const bs_arg_t *arg_ptr)
             continue;
         }
 
-        arg_name_ptr = node_create("", arg_ptr->name_ptr);
-        if (!bs_avltree_insert(tree_ptr, arg_name_ptr->name_ptr,
-                               &arg_name_ptr->node, false)) {
-            bs_log(BS_ERROR, "Duplicate argument name \"%s\"",
-                   arg_name_ptr->name_ptr);
-            node_destroy(&arg_name_ptr->node);
+        if (!index_insert(index_ptr, "", arg_ptr)) {
             retval = false;
             continue;
         }
@@ -525,12 +730,7 @@ bool check_arg(const bs_arg_t *arg_ptr)
                 retval = false;
             }
 
-            arg_name_ptr = node_create("no", arg_ptr->name_ptr);
-            if (!bs_avltree_insert(tree_ptr, arg_name_ptr->name_ptr,
-                                   &arg_name_ptr->node, false)) {
-                bs_log(BS_ERROR, "Duplicate argument name \"%s\"",
-                       arg_name_ptr->name_ptr);
-                node_destroy(&arg_name_ptr->node);
+            if (!index_insert(index_ptr, "no", arg_ptr)) {
                 retval = false;
                 continue;
             }
@@ -576,53 +776,118 @@ bool check_arg(const bs_arg_t *arg_ptr)
 
     }
 
-    bs_avltree_destroy(tree_ptr);
-    return retval;
+    if (!retval) {
+        index_destroy(index_ptr);
+        return NULL;
+    }
+    return index_ptr;
 }
 
-/* == Helpers for storing the names in a tree ============================== */
+/* == Helpers for the index of names ======================================= */
+
+/* ------------------------------------------------------------------------- */
+/** Creates an empty index. */
+arg_index_t *index_create(void)
+{
+    // All names die together with the index: Keep them in an arena.
+    bs_arena_t *arena_ptr = bs_arena_create(0);
+    if (NULL == arena_ptr) return NULL;
+
+    arg_index_t *index_ptr = bs_arena_calloc(arena_ptr, 1, sizeof(arg_index_t));
+    if (NULL == index_ptr) {
+        bs_arena_destroy(arena_ptr);
+        return NULL;
+    }
+    index_ptr->arena_ptr = arena_ptr;
+    index_ptr->hashmap_ptr = bs_hashmap_create(node_hash, node_equals, NULL);
+    if (NULL == index_ptr->hashmap_ptr) {
+        bs_arena_destroy(arena_ptr);
+        return NULL;
+    }
+    return index_ptr;
+}
 
 /* ------------------------------------------------------------------------- */
-int node_cmp(const bs_avltree_node_t *node_ptr, const void *key_ptr)
+/** Destroys the index. The nodes are released with the arena. */
+void index_destroy(arg_index_t *index_ptr)
 {
-    arg_name_t *arg_name_ptr = BS_CONTAINER_OF(node_ptr, arg_name_t, node);
-    return strcmp(arg_name_ptr->name_ptr, (const char*)key_ptr);
+    bs_hashmap_destroy(index_ptr->hashmap_ptr);
+    bs_arena_destroy(index_ptr->arena_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
-arg_name_t *node_create(const char *prefix_ptr, const char *name_ptr)
+/** Indexes `arg_ptr` by the name `prefix_ptr``name_ptr`. */
+bool index_insert(arg_index_t *index_ptr,
+                  const char *prefix_ptr,
+                  const bs_arg_t *arg_ptr)
 {
-    size_t                    len;
+    size_t                    prefix_len, name_len;
     arg_name_t                *arg_name_ptr;
 
-    arg_name_ptr = (arg_name_t*)calloc(1, sizeof(arg_name_t));
-    if (NULL == arg_name_ptr) {
-        bs_log(BS_ERROR | BS_ERRNO, "Failed calloc(1, %zu)",
-               sizeof(arg_name_t));
-        return NULL;
-    }
+    arg_name_ptr = bs_arena_calloc(index_ptr->arena_ptr, 1, sizeof(arg_name_t));
+    if (NULL == arg_name_ptr) return false;
 
-    len = strlen(prefix_ptr) + strlen(name_ptr) + 1;
-    arg_name_ptr->name_ptr = malloc(len);
-    if (NULL == arg_name_ptr->name_ptr) {
-        bs_log(BS_ERROR | BS_ERRNO, "Failed malloc(%zu)", len);
-        node_destroy(&arg_name_ptr->node);
+    prefix_len = strlen(prefix_ptr);
+    name_len = strlen(arg_ptr->name_ptr);
+    arg_name_ptr->name_ptr = bs_arena_alloc(
+        index_ptr->arena_ptr, prefix_len + name_len + 1);
+    if (NULL == arg_name_ptr->name_ptr) return false;
+    memcpy(arg_name_ptr->name_ptr, prefix_ptr, prefix_len);
+    memcpy(arg_name_ptr->name_ptr + prefix_len, arg_ptr->name_ptr,
+           name_len + 1);
+    arg_name_ptr->name_len = prefix_len + name_len;
+    arg_name_ptr->negated = 0 < prefix_len;
+    arg_name_ptr->arg_ptr = arg_ptr;
+
+    arg_name_key_t key = {
+        .name_ptr = arg_name_ptr->name_ptr,
+        .name_len = arg_name_ptr->name_len
+    };
+    if (!bs_hashmap_insert(index_ptr->hashmap_ptr, &key,
+                           &arg_name_ptr->node, false)) {
+        bs_log(BS_ERROR, "Duplicate argument name \"%s\"",
+               arg_name_ptr->name_ptr);
+        return false;
     }
-    strcpy(arg_name_ptr->name_ptr, prefix_ptr);
-    strcpy(arg_name_ptr->name_ptr + strlen(prefix_ptr), name_ptr);
-    return arg_name_ptr;
+    return true;
 }
 
 /* ------------------------------------------------------------------------- */
-void node_destroy(bs_avltree_node_t *node_ptr)
+/** Looks up the first `name_len` characters of `name_ptr`. */
+const arg_name_t *index_lookup(const arg_index_t *index_ptr,
+                               const char *name_ptr,
+                               size_t name_len)
 {
-    arg_name_t *arg_name_ptr = BS_CONTAINER_OF(node_ptr, arg_name_t, node);
-    if (NULL != arg_name_ptr->name_ptr) {
-        free(arg_name_ptr->name_ptr);
-        arg_name_ptr->name_ptr = NULL;
+    arg_name_key_t key = { .name_ptr = name_ptr, .name_len = name_len };
+    bs_hashmap_node_t *node_ptr = bs_hashmap_lookup(
+        index_ptr->hashmap_ptr, &key);
+    if (NULL == node_ptr) return NULL;
+    return BS_CONTAINER_OF(node_ptr, arg_name_t, node);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Hashes the @ref arg_name_key_t at `key_ptr`. FNV-1a, as for strings. */
+uint64_t node_hash(const void *key_ptr)
+{
+    const arg_name_key_t *k_ptr = key_ptr;
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < k_ptr->name_len; ++i) {
+        hash = (hash ^ (unsigned char)k_ptr->name_ptr[i]) *
+            UINT64_C(0x100000001b3);
     }
+    return hash;
+}
 
-    free(arg_name_ptr);
+/* ------------------------------------------------------------------------- */
+/** Returns whether the node's name equals the @ref arg_name_key_t. */
+bool node_equals(const bs_hashmap_node_t *node_ptr, const void *key_ptr)
+{
+    const arg_name_t *arg_name_ptr = BS_CONTAINER_OF(
+        node_ptr, arg_name_t, node);
+    const arg_name_key_t *k_ptr = key_ptr;
+    return (arg_name_ptr->name_len == k_ptr->name_len &&
+            0 == memcmp(arg_name_ptr->name_ptr, k_ptr->name_ptr,
+                        k_ptr->name_len));
 }
 
 /* ------------------------------------------------------------------------- */
@@ -646,6 +911,13 @@ bool is_name_valid(const char *name_ptr)
     return true;
 }
 
+/* ------------------------------------------------------------------------- */
+/** Returns whether `c` is whitespace. Safe for any char, unlike isspace(3). */
+bool is_space(char c)
+{
+    return isspace((unsigned char)c);
+}
+
 /* ------------------------------------------------------------------------- */
 bool lookup_enum(const bs_arg_enum_table_t *lookup_table,
                  const char *name_ptr,
@@ -673,6 +945,9 @@ static void bs_arg_test_parse_arg_for_enum(bs_test_t *test_ptr);
 static void bs_arg_test_set_defaults(bs_test_t *test_ptr);
 static void bs_arg_test_parse(bs_test_t *test_ptr);
 static void bs_arg_test_check_arg(bs_test_t *test_ptr);
+static void bs_arg_test_many(bs_test_t *test_ptr);
+static void bs_arg_test_load_config(bs_test_t *test_ptr);
+static void bs_arg_test_parse_with_config(bs_test_t *test_ptr);
 
 const bs_test_case_t          bs_arg_test_cases[] = {
     { 1, "get_match_type for bool values", bs_arg_test_get_match_type_bool },
@@ -684,6 +959,9 @@ const bs_test_case_t          bs_arg_test_cases[] = {
     { 1, "set_defaults", bs_arg_test_set_defaults },
     { 1, "parse", bs_arg_test_parse },
     { 1, "check_arg", bs_arg_test_check_arg },
+    { 1, "many", bs_arg_test_many },
+    { 1, "load_config", bs_arg_test_load_config },
+    { 1, "parse_with_config", bs_arg_test_parse_with_config },
     { 0, NULL, NULL }
 };
 
@@ -763,35 +1041,39 @@ void bs_arg_test_get_match_type_nonbool(bs_test_t *test_ptr) {
 
 /* ------------------------------------------------------------------------- */
 void bs_arg_test_find_matching_arg(bs_test_t *test_ptr) {
-    static const bs_arg_t     args[] = {
-        BS_ARG_BOOL("b", "d", true, NULL),
-        BS_ARG_UINT32("u32", "d", 42, 0, UINT32_MAX, NULL),
+    static bool               value_bool;
+    static uint32_t           value_uint32;
+    static const bs_arg_t     args_table[] = {
+        BS_ARG_BOOL("b", "d", true, &value_bool),
+        BS_ARG_UINT32("u32", "d", 42, 0, UINT32_MAX, &value_uint32),
         BS_ARG_SENTINEL(),
     };
     const bs_arg_t            *matching_arg;
     const char                *av_ptr;
 
+    arg_index_t *args = check_arg(args_table);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, args);
     BS_TEST_VERIFY_TRUE(
         test_ptr,
         find_matching_arg(args, "--b", NULL, &matching_arg, &av_ptr));
-    BS_TEST_VERIFY_EQ(test_ptr, &args[0], matching_arg);
+    BS_TEST_VERIFY_EQ(test_ptr, &args_table[0], matching_arg);
     BS_TEST_VERIFY_STREQ(test_ptr, "true", av_ptr);
 
     BS_TEST_VERIFY_TRUE(
         test_ptr,
         find_matching_arg(args, "--nob", NULL, &matching_arg, &av_ptr));
-    BS_TEST_VERIFY_EQ(test_ptr, &args[0], matching_arg);
+    BS_TEST_VERIFY_EQ(test_ptr, &args_table[0], matching_arg);
     BS_TEST_VERIFY_STREQ(test_ptr, "false", av_ptr);
 
     BS_TEST_VERIFY_TRUE(
         test_ptr,
         find_matching_arg(args, "--u32=123", NULL, &matching_arg, &av_ptr));
-    BS_TEST_VERIFY_EQ(test_ptr, &args[1], matching_arg);
+    BS_TEST_VERIFY_EQ(test_ptr, &args_table[1], matching_arg);
 
     BS_TEST_VERIFY_TRUE(
         test_ptr,
         find_matching_arg(args, "--u32", "456", &matching_arg, &av_ptr));
-    BS_TEST_VERIFY_EQ(test_ptr, &args[1], matching_arg);
+    BS_TEST_VERIFY_EQ(test_ptr, &args_table[1], matching_arg);
     BS_TEST_VERIFY_STREQ(test_ptr, "456", av_ptr);
 
     BS_TEST_VERIFY_FALSE(
@@ -803,6 +1085,17 @@ void bs_arg_test_find_matching_arg(bs_test_t *test_ptr) {
         find_matching_arg(args, "--unknown", NULL, &matching_arg, &av_ptr));
     BS_TEST_VERIFY_EQ(test_ptr, NULL, matching_arg);
     BS_TEST_VERIFY_EQ(test_ptr, NULL, av_ptr);
+
+    // A bool does not take a value, and a non-bool has no "no" name.
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        find_matching_arg(args, "--b=true", NULL, &matching_arg, &av_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, matching_arg);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        find_matching_arg(args, "--nou32=1", NULL, &matching_arg, &av_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, matching_arg);
+    index_destroy(args);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -980,21 +1273,21 @@ static void bs_arg_test_check_arg(bs_test_t *test_ptr)
         BS_ARG_BOOL(NULL, "d", true, &value_bool),
         BS_ARG_SENTINEL(),
     };
-    BS_TEST_VERIFY_FALSE(test_ptr, check_arg(args1));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, check_arg(args1));
 
     // Not starting with a-zA-Z.
     static const bs_arg_t     args2[] = {
         BS_ARG_BOOL(NULL, "9", true, &value_bool),
         BS_ARG_SENTINEL(),
     };
-    BS_TEST_VERIFY_FALSE(test_ptr, check_arg(args2));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, check_arg(args2));
 
     // Invalid characters.
     static const bs_arg_t     args3[] = {
         BS_ARG_BOOL(NULL, "a-b.", true, &value_bool),
         BS_ARG_SENTINEL(),
     };
-    BS_TEST_VERIFY_FALSE(test_ptr, check_arg(args3));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, check_arg(args3));
 
     // Duplicate names.
     static const bs_arg_t     args4[] = {
@@ -1002,7 +1295,7 @@ static void bs_arg_test_check_arg(bs_test_t *test_ptr)
         BS_ARG_BOOL("b", "e", false, &value_bool),
         BS_ARG_SENTINEL(),
     };
-    BS_TEST_VERIFY_FALSE(test_ptr, check_arg(args4));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, check_arg(args4));
 
     // Duplicate names, with the boolean extension.
     static const bs_arg_t     args5[] = {
@@ -1010,7 +1303,7 @@ static void bs_arg_test_check_arg(bs_test_t *test_ptr)
         BS_ARG_BOOL("nob", "e", false, &value_bool),
         BS_ARG_SENTINEL(),
     };
-    BS_TEST_VERIFY_FALSE(test_ptr, check_arg(args5));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, check_arg(args5));
 
     // All valid.
     value_string = NULL;
@@ -1021,7 +1314,241 @@ static void bs_arg_test_check_arg(bs_test_t *test_ptr)
         BS_ARG_UINT32("u32", "d", 42, 0, UINT32_MAX, &value_uint32),
         BS_ARG_SENTINEL(),
     };
-    BS_TEST_VERIFY_TRUE(test_ptr, check_arg(valid_args));
+    arg_index_t *index_ptr = check_arg(valid_args);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, index_ptr);
+    index_destroy(index_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Helper: Writes `data_ptr` into a new temporary file at `fname_ptr`. */
+static bool test_write_config(bs_test_t *test_ptr,
+                              char *fname_ptr,
+                              const char *data_ptr)
+{
+    strcpy(fname_ptr, "/tmp/libbase_arg_test_XXXXXX");
+    int fd = mkstemp(fname_ptr);
+    if (0 > fd) {
+        BS_TEST_FAIL(test_ptr, "Failed mkstemp(%s)", fname_ptr);
+        return false;
+    }
+    size_t len = strlen(data_ptr);
+    if ((ssize_t)len != write(fd, data_ptr, len)) {
+        BS_TEST_FAIL(test_ptr, "Failed write(%d, %p, %zu)", fd, data_ptr, len);
+    }
+    close(fd);
+    return !bs_test_failed(test_ptr);
+}
+
+/** Number of args for the "many" test and the benchmark. */
+#define _TEST_MANY_ARGS 1024
+
+/** Args, with storage for names and values. */
+typedef struct {
+    /** The args, and a sentinel. */
+    bs_arg_t                  args[_TEST_MANY_ARGS + 1];
+    /** The names. */
+    char                      names[_TEST_MANY_ARGS][24];
+    /** The values. */
+    uint32_t                  values[_TEST_MANY_ARGS];
+    /** A commandline, setting each arg. */
+    const char                *argv[_TEST_MANY_ARGS + 1];
+    /** Storage for the commandline. */
+    char                      argv_storage[_TEST_MANY_ARGS][40];
+} test_many_args_t;
+
+/* ------------------------------------------------------------------------- */
+/** Helper: Creates @ref _TEST_MANY_ARGS args, and a commandline for them. */
+static test_many_args_t *test_many_args_create(void)
+{
+    test_many_args_t *many_ptr = calloc(1, sizeof(test_many_args_t));
+    if (NULL == many_ptr) return NULL;
+
+    many_ptr->argv[0] = "program";
+    for (int i = 0; i < _TEST_MANY_ARGS; ++i) {
+        snprintf(many_ptr->names[i], sizeof(many_ptr->names[i]),
+                 "option_%d", i);
+        bs_arg_t arg = BS_ARG_UINT32(
+            many_ptr->names[i], "d", 0, 0, UINT32_MAX, &many_ptr->values[i]);
+        memcpy(&many_ptr->args[i], &arg, sizeof(bs_arg_t));
+
+        snprintf(many_ptr->argv_storage[i], sizeof(many_ptr->argv_storage[i]),
+                 "--option_%d=%d", _TEST_MANY_ARGS - 1 - i,
+                 _TEST_MANY_ARGS - 1 - i);
+        many_ptr->argv[i + 1] = many_ptr->argv_storage[i];
+    }
+    // The sentinel is zeroed by calloc(3).
+    return many_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_arg_test_many(bs_test_t *test_ptr)
+{
+    test_many_args_t *many_ptr = test_many_args_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, many_ptr);
+
+    int argc = _TEST_MANY_ARGS + 1;
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_arg_parse(many_ptr->args, BS_ARG_MODE_NO_EXTRA, &argc,
+                     many_ptr->argv));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, argc);
+    for (int i = 0; i < _TEST_MANY_ARGS; ++i) {
+        BS_TEST_VERIFY_EQ(test_ptr, (uint32_t)i, many_ptr->values[i]);
+    }
+    bs_arg_cleanup(many_ptr->args);
+    free(many_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_arg_test_load_config(bs_test_t *test_ptr)
+{
+    static bool               value_bool, value_bool2;
+    static uint32_t           value_uint32;
+    static int                value_enum;
+    static char               *value_string = NULL;
+    static const bs_arg_t     args[] = {
+        BS_ARG_BOOL("b", "d", true, &value_bool),
+        BS_ARG_BOOL("b2", "d", false, &value_bool2),
+        BS_ARG_ENUM("e", "d", "alpha", enum_test_table, &value_enum),
+        BS_ARG_UINT32("u32", "d", 42, 0, UINT32_MAX, &value_uint32),
+        BS_ARG_STRING("str", "d", "bravo", &value_string),
+        BS_ARG_SENTINEL(),
+    };
+    char                      fname[64];
+
+    // Comments, blanks, and whitespace around names and values.
+    BS_TEST_VERIFY_TRUE_OR_RETURN(
+        test_ptr,
+        test_write_config(test_ptr, fname,
+                          "# A comment.\n"
+                          "\n"
+                          "  u32 = 1234  \r\n"
+                          "e=charlie\n"
+                          "nob\n"
+                          "b2\n"
+                          "str= a value = with = signs\n"
+                          "\t# Indented comment.\n"
+                          "u32=4321"));
+    value_bool = true;
+    value_bool2 = false;
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_arg_load_config(args, fname));
+    BS_TEST_VERIFY_EQ(test_ptr, 4321, value_uint32);
+    BS_TEST_VERIFY_EQ(test_ptr, 7, value_enum);
+    BS_TEST_VERIFY_EQ(test_ptr, false, value_bool);
+    BS_TEST_VERIFY_EQ(test_ptr, true, value_bool2);
+    BS_TEST_VERIFY_STREQ(test_ptr, "a value = with = signs", value_string);
+    unlink(fname);
+    bs_arg_cleanup(args);
+
+    // Bools, with values.
+    BS_TEST_VERIFY_TRUE_OR_RETURN(
+        test_ptr, test_write_config(test_ptr, fname, "b=false\nb2=true\n"));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_arg_load_config(args, fname));
+    BS_TEST_VERIFY_EQ(test_ptr, false, value_bool);
+    BS_TEST_VERIFY_EQ(test_ptr, true, value_bool2);
+    unlink(fname);
+
+    // Errors: Unknown names, missing or unexpected values, invalid values.
+    static const char *invalid_configs[] = {
+        "u32=1\nunknown=2\n",
+        "u32\n",
+        "nob=true\n",
+        "nou32=1\n",
+        "u32=abc\n",
+        "e=delta\n",
+        "=1\n",
+        NULL
+    };
+    for (const char **c_ptr = invalid_configs; NULL != *c_ptr; ++c_ptr) {
+        BS_TEST_VERIFY_TRUE_OR_RETURN(
+            test_ptr, test_write_config(test_ptr, fname, *c_ptr));
+        BS_TEST_VERIFY_FALSE(test_ptr, bs_arg_load_config(args, fname));
+        unlink(fname);
+    }
+
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_arg_load_config(args, "/nonexistent/config"));
+    bs_arg_cleanup(args);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_arg_test_parse_with_config(bs_test_t *test_ptr)
+{
+    static bool               value_bool;
+    static uint32_t           value_uint32;
+    static char               *value_string = NULL;
+    static const bs_arg_t     args[] = {
+        BS_ARG_BOOL("b", "d", true, &value_bool),
+        BS_ARG_UINT32("u32", "d", 42, 0, UINT32_MAX, &value_uint32),
+        BS_ARG_STRING("str", "d", "bravo", &value_string),
+        BS_ARG_SENTINEL(),
+    };
+    char                      fname[64];
+
+    BS_TEST_VERIFY_TRUE_OR_RETURN(
+        test_ptr,
+        test_write_config(test_ptr, fname, "u32=100\nstr=from_config\n"));
+
+    // Defaults, overridden by the config, overridden by the commandline.
+    const char *argv[] = { "program", "--u32=200" };
+    int argc = sizeof(argv) / sizeof(const char*);
+    value_bool = false;
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_arg_parse_with_config(args, fname, BS_ARG_MODE_NO_EXTRA,
+                                 &argc, argv));
+    BS_TEST_VERIFY_EQ(test_ptr, true, value_bool);
+    BS_TEST_VERIFY_EQ(test_ptr, 200, value_uint32);
+    BS_TEST_VERIFY_STREQ(test_ptr, "from_config", value_string);
+    bs_arg_cleanup(args);
+    unlink(fname);
+
+    // A failing config fails the parse, and releases the strings.
+    BS_TEST_VERIFY_TRUE_OR_RETURN(
+        test_ptr,
+        test_write_config(test_ptr, fname, "str=from_config\nu32=x\n"));
+    argc = 1;
+    BS_TEST_VERIFY_FALSE(
+        test_ptr,
+        bs_arg_parse_with_config(args, fname, BS_ARG_MODE_NO_EXTRA,
+                                 &argc, argv));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, value_string);
+    unlink(fname);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void bs_arg_benchmark_parse(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_arg_benchmarks[] = {
+    { 1, "benchmark-parse", bs_arg_benchmark_parse },
+    { 0, NULL, NULL }
+};
+
+/** Benchmark function: Parses @ref _TEST_MANY_ARGS options. */
+static void _benchmark_parse_fn(void *arg_ptr, uint64_t iterations)
+{
+    test_many_args_t *many_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        const char *argv[_TEST_MANY_ARGS + 1];
+        memcpy(argv, many_ptr->argv, sizeof(argv));
+        int argc = _TEST_MANY_ARGS + 1;
+        bs_arg_parse(many_ptr->args, BS_ARG_MODE_NO_EXTRA, &argc, argv);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks parsing a commandline that sets each of many options. */
+void bs_arg_benchmark_parse(bs_test_t *test_ptr)
+{
+    test_many_args_t *many_ptr = test_many_args_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, many_ptr);
+    if (!bs_test_bench(test_ptr, "parse 1024 options",
+                       _benchmark_parse_fn, many_ptr, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(parse 1024 options)");
+    }
+    bs_arg_cleanup(many_ptr->args);
+    free(many_ptr);
 }
 
 /* == End of arg.c ========================================================= */
@@ -190,6 +190,47 @@ typedef struct {
 bool bs_arg_parse(const bs_arg_t *arg_ptr, const bs_arg_mode_t mode,
                   int *argc_ptr, const char **argv_ptr);
 
+/**
+ * Parses a configuration file, and then the commandline.
+ *
+ * Sets all defaults, applies the options from `config_fname_ptr`, and then
+ * those from the commandline: The commandline overrides the file. See
+ * @ref bs_arg_load_config for the file's format.
+ *
+ * @param arg_ptr Specifies the array of arguments, ending in a sentinel.
+ * @param config_fname_ptr Path to the configuration file, or NULL to parse
+ *     only the commandline.
+ * @param mode How to treat extra arguments.
+ * @param argc_ptr Pointer to the number of arguments.
+ * @param argv_ptr Pointer to the list of argument values. It is assumed that
+ *     argv_ptr[0] holds the program's name. It will be skipped for parsing.
+ *
+ * @return true if the parsing succeeded.
+ */
+bool bs_arg_parse_with_config(const bs_arg_t *arg_ptr,
+                              const char *config_fname_ptr,
+                              const bs_arg_mode_t mode,
+                              int *argc_ptr, const char **argv_ptr);
+
+/**
+ * Loads options from the configuration file `fname_ptr`.
+ *
+ * The file is mapped, and parsed in a single pass. Each line holds one
+ * option as `name=value`, named as on the commandline but without the "--"
+ * prefix. Whitespace around name and value is ignored, as are empty lines
+ * and lines starting with '#'. Booleans may also be given as just `name` or
+ * `noname`. Unknown names are an error.
+ *
+ * The options are applied on top of the current values, defaults are not
+ * set. Strings must be released by @ref bs_arg_cleanup, also on failure.
+ *
+ * @param arg_ptr Specifies the array of arguments, ending in a sentinel.
+ * @param fname_ptr
+ *
+ * @return true on success. Errors are logged, with file name and line.
+ */
+bool bs_arg_load_config(const bs_arg_t *arg_ptr, const char *fname_ptr);
+
 /**
  * Cleanup any allocated resources during parsing by |bs_arg_parse|.
  *
@@ -208,6 +249,9 @@ int bs_arg_print_usage(FILE *stream_ptr, const bs_arg_t *arg_ptr);
 /** Unit tests. */
 extern const bs_test_case_t   bs_arg_test_cases[];
 
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_arg_benchmarks[];
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
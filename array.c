@@ -0,0 +1,460 @@
+/* ========================================================================= */
+/**
+ * @file array.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "array.h"
+
+#include "assert.h"
+#include "def.h"
+#include "log.h"
+#include "ptr_vector.h"
+#include "time.h"
+#include "vector.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* == Declarations ========================================================= */
+
+/** Capacity when first allocating, in elements. */
+#define INITIAL_CAPACITY 16
+
+static bool _bs_array_grow(bs_array_t *array_ptr, size_t min_capacity);
+static bool _bs_array_realloc(bs_array_t *array_ptr, size_t capacity);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bool bs_array_init(bs_array_t *array_ptr, size_t element_size)
+{
+    if (0 == element_size) {
+        bs_log(BS_ERROR, "Invalid element size 0 for array %p", array_ptr);
+        return false;
+    }
+    array_ptr->element_size = element_size;
+    array_ptr->capacity = 0;
+    array_ptr->consumed = 0;
+    array_ptr->elements_ptr = NULL;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_array_fini(bs_array_t *array_ptr)
+{
+    if (NULL != array_ptr->elements_ptr) {
+        free(array_ptr->elements_ptr);
+        array_ptr->elements_ptr = NULL;
+    }
+    array_ptr->capacity = 0;
+    array_ptr->consumed = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_array_size(const bs_array_t *array_ptr)
+{
+    return array_ptr->consumed;
+}
+
+/* ------------------------------------------------------------------------- */
+void *bs_array_at(bs_array_t *array_ptr, size_t pos)
+{
+    BS_ASSERT(pos < array_ptr->consumed);
+    return array_ptr->elements_ptr + pos * array_ptr->element_size;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_array_push_back(bs_array_t *array_ptr, const void *element_ptr)
+{
+    return bs_array_append(array_ptr, element_ptr, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_array_pop_back(bs_array_t *array_ptr, void *element_ptr)
+{
+    if (0 == array_ptr->consumed) return false;
+    --array_ptr->consumed;
+    if (NULL != element_ptr) {
+        memcpy(element_ptr,
+               array_ptr->elements_ptr +
+               array_ptr->consumed * array_ptr->element_size,
+               array_ptr->element_size);
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_array_insert(bs_array_t *array_ptr,
+                     size_t pos,
+                     const void *element_ptr)
+{
+    if (pos > array_ptr->consumed) return false;
+    if (array_ptr->consumed >= array_ptr->capacity &&
+        !_bs_array_grow(array_ptr, array_ptr->consumed + 1)) return false;
+
+    uint8_t *pos_ptr = array_ptr->elements_ptr + pos * array_ptr->element_size;
+    memmove(pos_ptr + array_ptr->element_size, pos_ptr,
+            (array_ptr->consumed - pos) * array_ptr->element_size);
+    memcpy(pos_ptr, element_ptr, array_ptr->element_size);
+    ++array_ptr->consumed;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_array_erase(bs_array_t *array_ptr, size_t pos)
+{
+    if (pos >= array_ptr->consumed) return false;
+
+    uint8_t *pos_ptr = array_ptr->elements_ptr + pos * array_ptr->element_size;
+    memmove(pos_ptr, pos_ptr + array_ptr->element_size,
+            (array_ptr->consumed - pos - 1) * array_ptr->element_size);
+    --array_ptr->consumed;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_array_swap_erase(bs_array_t *array_ptr, size_t pos)
+{
+    if (pos >= array_ptr->consumed) return false;
+
+    --array_ptr->consumed;
+    if (pos < array_ptr->consumed) {
+        memcpy(array_ptr->elements_ptr + pos * array_ptr->element_size,
+               array_ptr->elements_ptr +
+               array_ptr->consumed * array_ptr->element_size,
+               array_ptr->element_size);
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_array_append(bs_array_t *array_ptr,
+                     const void *elements_ptr,
+                     size_t num)
+{
+    if (0 == num) return true;
+    if (num > SIZE_MAX - array_ptr->consumed) return false;
+    if (array_ptr->consumed + num > array_ptr->capacity &&
+        !_bs_array_grow(array_ptr, array_ptr->consumed + num)) return false;
+
+    memcpy(array_ptr->elements_ptr +
+           array_ptr->consumed * array_ptr->element_size,
+           elements_ptr, num * array_ptr->element_size);
+    array_ptr->consumed += num;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_array_clear(bs_array_t *array_ptr)
+{
+    array_ptr->consumed = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_array_reserve(bs_array_t *array_ptr, size_t capacity)
+{
+    if (capacity <= array_ptr->capacity) return true;
+    return _bs_array_realloc(array_ptr, capacity);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_array_shrink_to_fit(bs_array_t *array_ptr)
+{
+    if (array_ptr->consumed == array_ptr->capacity) return true;
+    if (0 == array_ptr->consumed) {
+        free(array_ptr->elements_ptr);
+        array_ptr->elements_ptr = NULL;
+        array_ptr->capacity = 0;
+        return true;
+    }
+    return _bs_array_realloc(array_ptr, array_ptr->consumed);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_array_sort(bs_array_t *array_ptr,
+                   int (*cmp)(const void *a_ptr, const void *b_ptr))
+{
+    if (1 >= array_ptr->consumed) return;
+    qsort(array_ptr->elements_ptr, array_ptr->consumed,
+          array_ptr->element_size, cmp);
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Grows the array geometrically, doubling the capacity until it holds at
+ * least `min_capacity` elements.
+ *
+ * @param array_ptr
+ * @param min_capacity
+ *
+ * @return true on success.
+ */
+bool _bs_array_grow(bs_array_t *array_ptr, size_t min_capacity)
+{
+    size_t capacity = BS_MAX(array_ptr->capacity, (size_t)INITIAL_CAPACITY);
+    while (capacity < min_capacity) {
+        if (capacity > SIZE_MAX / 2) {
+            capacity = min_capacity;
+            break;
+        }
+        capacity *= 2;
+    }
+    return _bs_array_realloc(array_ptr, capacity);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Re-allocates the array's storage to hold exactly `capacity` elements.
+ * `capacity` must be at least the array's size, and not 0.
+ *
+ * @param array_ptr
+ * @param capacity
+ *
+ * @return true on success.
+ */
+bool _bs_array_realloc(bs_array_t *array_ptr, size_t capacity)
+{
+    if (capacity > SIZE_MAX / array_ptr->element_size) {
+        bs_log(BS_ERROR, "Capacity %zu of array %p too large.",
+               capacity, array_ptr);
+        return false;
+    }
+    void *new_elements_ptr = realloc(
+        array_ptr->elements_ptr, capacity * array_ptr->element_size);
+    if (NULL == new_elements_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed realloc(%p, %zu)",
+               array_ptr->elements_ptr, capacity * array_ptr->element_size);
+        return false;
+    }
+    array_ptr->capacity = capacity;
+    array_ptr->elements_ptr = new_elements_ptr;
+    return true;
+}
+
+/* == Unit tests =========================================================== */
+
+static void basic_test(bs_test_t *test_ptr);
+static void insert_erase_test(bs_test_t *test_ptr);
+static void bulk_sort_test(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_array_test_cases[] = {
+    { 1, "basic", basic_test },
+    { 1, "insert_erase", insert_erase_test },
+    { 1, "bulk_sort", bulk_sort_test },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Tests push, pop and access, with elements larger than a pointer. */
+void basic_test(bs_test_t *test_ptr)
+{
+    bs_array_t array;
+    bs_vector_2f_t v;
+
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_array_init(&array, 0));
+    BS_TEST_VERIFY_TRUE(test_ptr,
+                        bs_array_init(&array, sizeof(bs_vector_2f_t)));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_array_size(&array));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_array_pop_back(&array, &v));
+
+    for (int i = 0; i < 100; ++i) {
+        v = BS_VECTOR_2F(i, -i);
+        BS_TEST_VERIFY_TRUE(test_ptr, bs_array_push_back(&array, &v));
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 100, bs_array_size(&array));
+    BS_TEST_VERIFY_EQ(test_ptr, 128, array.capacity);
+    BS_TEST_VERIFY_EQ(test_ptr, 42,
+                      BS_ARRAY_AT(&array, bs_vector_2f_t, 42)->x);
+    BS_TEST_VERIFY_EQ(test_ptr, -42,
+                      BS_ARRAY_AT(&array, bs_vector_2f_t, 42)->y);
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_pop_back(&array, &v));
+    BS_TEST_VERIFY_EQ(test_ptr, 99, v.x);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_pop_back(&array, NULL));
+    BS_TEST_VERIFY_EQ(test_ptr, 98, bs_array_size(&array));
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_shrink_to_fit(&array));
+    BS_TEST_VERIFY_EQ(test_ptr, 98, array.capacity);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_reserve(&array, 1000));
+    BS_TEST_VERIFY_EQ(test_ptr, 1000, array.capacity);
+    BS_TEST_VERIFY_EQ(test_ptr, 97,
+                      BS_ARRAY_AT(&array, bs_vector_2f_t, 97)->x);
+
+    bs_array_clear(&array);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_array_size(&array));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_shrink_to_fit(&array));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, array.elements_ptr);
+
+    bs_array_fini(&array);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Tests insert, erase and swap-erase. */
+void insert_erase_test(bs_test_t *test_ptr)
+{
+    bs_array_t array;
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, bs_array_init(&array, sizeof(int)));
+
+    int v = 1;
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_insert(&array, 0, &v));
+    v = 3;
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_insert(&array, 1, &v));
+    v = 0;
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_insert(&array, 0, &v));
+    v = 2;
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_insert(&array, 2, &v));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_array_insert(&array, 5, &v));
+    BS_TEST_VERIFY_EQ(test_ptr, 4, bs_array_size(&array));
+    for (int i = 0; i < 4; ++i) {
+        BS_TEST_VERIFY_EQ(test_ptr, i, *BS_ARRAY_AT(&array, int, i));
+    }
+
+    // [0, 1, 2, 3] -> [0, 2, 3] -> [3, 2] -> [3].
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_erase(&array, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, *BS_ARRAY_AT(&array, int, 1));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_swap_erase(&array, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, *BS_ARRAY_AT(&array, int, 0));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_swap_erase(&array, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_array_size(&array));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_array_erase(&array, 1));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_array_swap_erase(&array, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, *BS_ARRAY_AT(&array, int, 0));
+
+    bs_array_fini(&array);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Comparator for sorting ints. */
+static int _int_cmp(const void *a_ptr, const void *b_ptr)
+{
+    int a = *(const int*)a_ptr, b = *(const int*)b_ptr;
+    return (a > b) - (a < b);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Tests bulk append and sorting. */
+void bulk_sort_test(bs_test_t *test_ptr)
+{
+    bs_array_t array;
+    int values[1000];
+    for (int i = 0; i < 1000; ++i) values[i] = (i * 7919) % 1000;
+
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, bs_array_init(&array, sizeof(int)));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_append(&array, values, 10));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_array_append(&array, values + 10, 990));
+    BS_TEST_VERIFY_EQ(test_ptr, 1000, bs_array_size(&array));
+    BS_TEST_VERIFY_EQ(test_ptr, values[500], *BS_ARRAY_AT(&array, int, 500));
+
+    bs_array_sort(&array, _int_cmp);
+    for (int i = 0; i < 1000; ++i) {
+        if (i != *BS_ARRAY_AT(&array, int, i)) {
+            BS_TEST_FAIL(test_ptr, "Unexpected %d at %d",
+                         *BS_ARRAY_AT(&array, int, i), i);
+            break;
+        }
+    }
+
+    bs_array_fini(&array);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_array(bs_test_t *test_ptr);
+static void benchmark_ptr_vector(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t bs_array_benchmarks[] = {
+    { 1, "benchmark-iterate-array", benchmark_array },
+    { 1, "benchmark-iterate-ptr_vector", benchmark_ptr_vector },
+    { 0, NULL, NULL }
+};
+
+/** Number of vectors to sum up, per benchmark iteration. */
+#define _BENCHMARK_ELEMENTS   65536
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks summing up vectors, stored inline in a @ref bs_array_t. */
+void benchmark_array(bs_test_t *test_ptr)
+{
+    bs_array_t array;
+    BS_TEST_VERIFY_TRUE_OR_RETURN(
+        test_ptr, bs_array_init(&array, sizeof(bs_vector_2f_t)));
+    for (int i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+        bs_vector_2f_t v = BS_VECTOR_2F(i, 1);
+        bs_array_push_back(&array, &v);
+    }
+
+    uint64_t iterations = 0;
+    bs_vector_2f_t sum = BS_VECTOR_2F(0, 0);
+    uint64_t usec = bs_usec();
+    while (usec + benchmark_duration >= bs_usec()) {
+        const bs_vector_2f_t *v_ptr = (bs_vector_2f_t*)array.elements_ptr;
+        for (size_t i = 0; i < bs_array_size(&array); ++i) {
+            sum = bs_vec_add_2f(sum, v_ptr[i]);
+        }
+        iterations++;
+    }
+    usec = bs_usec() - usec;
+    BS_TEST_VERIFY_EQ(test_ptr, (double)iterations * _BENCHMARK_ELEMENTS,
+                      sum.y);
+
+    bs_test_succeed(test_ptr, "%.3e elements/sec",
+                    (double)iterations * _BENCHMARK_ELEMENTS / (usec * 1e-6));
+    bs_array_fini(&array);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks summing up vectors, each allocated, in a @ref bs_ptr_vector_t. */
+void benchmark_ptr_vector(bs_test_t *test_ptr)
+{
+    bs_ptr_vector_t ptr_vector;
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, bs_ptr_vector_init(&ptr_vector));
+    for (int i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+        bs_vector_2f_t *v_ptr = malloc(sizeof(bs_vector_2f_t));
+        if (NULL == v_ptr) break;
+        *v_ptr = BS_VECTOR_2F(i, 1);
+        bs_ptr_vector_push_back(&ptr_vector, v_ptr);
+    }
+
+    uint64_t iterations = 0;
+    bs_vector_2f_t sum = BS_VECTOR_2F(0, 0);
+    uint64_t usec = bs_usec();
+    while (usec + benchmark_duration >= bs_usec()) {
+        for (size_t i = 0; i < bs_ptr_vector_size(&ptr_vector); ++i) {
+            sum = bs_vec_add_2f(
+                sum, *(bs_vector_2f_t*)bs_ptr_vector_at(&ptr_vector, i));
+        }
+        iterations++;
+    }
+    usec = bs_usec() - usec;
+    BS_TEST_VERIFY_EQ(test_ptr, (double)iterations * _BENCHMARK_ELEMENTS,
+                      sum.y);
+
+    bs_test_succeed(test_ptr, "%.3e elements/sec",
+                    (double)iterations * _BENCHMARK_ELEMENTS / (usec * 1e-6));
+    while (0 < bs_ptr_vector_size(&ptr_vector)) {
+        free(bs_ptr_vector_at(&ptr_vector, 0));
+        bs_ptr_vector_swap_erase(&ptr_vector, 0);
+    }
+    bs_ptr_vector_fini(&ptr_vector);
+}
+
+/* == End of array.c ======================================================= */
@@ -0,0 +1,189 @@
+/* ========================================================================= */
+/**
+ * @file array.h
+ * A contiguous, growable array that stores elements of a given size inline.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_ARRAY_H__
+#define __LIBBASE_ARRAY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "test.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/**
+ * State of an array of elements, each `element_size` bytes. Unlike
+ * @ref bs_ptr_vector_t, the elements are copied into the array.
+ *
+ * Pointers to elements are invalidated when the array grows.
+ */
+typedef struct {
+    /** Size of each element, in bytes. */
+    size_t                    element_size;
+    /** Current capacity of the array, in elements. */
+    size_t                    capacity;
+    /** Number of elements in the array. */
+    size_t                    consumed;
+    /** The elements. NULL if `capacity` is 0. */
+    uint8_t                   *elements_ptr;
+} bs_array_t;
+
+/**
+ * Initializes the array. Does not allocate, until elements are added.
+ *
+ * @param array_ptr
+ * @param element_size        Size of each element, in bytes. Must be > 0.
+ *
+ * @return true on success.
+ */
+bool bs_array_init(bs_array_t *array_ptr, size_t element_size);
+
+/**
+ * Un-initializes the array, and frees the storage for the elements.
+ *
+ * @param array_ptr
+ */
+void bs_array_fini(bs_array_t *array_ptr);
+
+/** @return the number of elements in the array. */
+size_t bs_array_size(const bs_array_t *array_ptr);
+
+/** @return a pointer to the element at `pos`. It must be `pos` < size. */
+void *bs_array_at(bs_array_t *array_ptr, size_t pos);
+
+/** Typed access to the element at `_pos`, as a pointer to `_type`. */
+#define BS_ARRAY_AT(_array_ptr, _type, _pos)            \
+    ((_type*)bs_array_at((_array_ptr), (_pos)))
+
+/**
+ * Copies the element at `element_ptr` to the end of the array.
+ *
+ * @param array_ptr
+ * @param element_ptr         Points to `element_size` bytes. Must not point
+ *                            into the array.
+ *
+ * @return true on success.
+ */
+bool bs_array_push_back(bs_array_t *array_ptr, const void *element_ptr);
+
+/**
+ * Removes the last element. Copies it to `element_ptr`, unless NULL.
+ *
+ * @param array_ptr
+ * @param element_ptr         Output: `element_size` bytes, or NULL.
+ *
+ * @return false if the array was empty.
+ */
+bool bs_array_pop_back(bs_array_t *array_ptr, void *element_ptr);
+
+/**
+ * Inserts a copy of the element at `element_ptr` before `pos`.
+ *
+ * @param array_ptr
+ * @param pos                 Must be <= size. Size inserts at the end.
+ * @param element_ptr         Must not point into the array.
+ *
+ * @return true on success.
+ */
+bool bs_array_insert(bs_array_t *array_ptr,
+                     size_t pos,
+                     const void *element_ptr);
+
+/**
+ * Erases the element at `pos`, moving all subsequent elements.
+ *
+ * @param array_ptr
+ * @param pos
+ *
+ * @return true if `pos` was valid.
+ */
+bool bs_array_erase(bs_array_t *array_ptr, size_t pos);
+
+/**
+ * Erases the element at `pos`, by moving the last element into its place.
+ * Does not retain the order of elements.
+ *
+ * @param array_ptr
+ * @param pos
+ *
+ * @return true if `pos` was valid.
+ */
+bool bs_array_swap_erase(bs_array_t *array_ptr, size_t pos);
+
+/**
+ * Copies `num` elements from `elements_ptr` to the end of the array.
+ *
+ * @param array_ptr
+ * @param elements_ptr        Points to `num` * `element_size` bytes. Must not
+ *                            point into the array.
+ * @param num
+ *
+ * @return true on success.
+ */
+bool bs_array_append(bs_array_t *array_ptr,
+                     const void *elements_ptr,
+                     size_t num);
+
+/** Removes all elements. Keeps the capacity. */
+void bs_array_clear(bs_array_t *array_ptr);
+
+/**
+ * Ensures the array has capacity for at least `capacity` elements.
+ *
+ * @param array_ptr
+ * @param capacity
+ *
+ * @return true on success.
+ */
+bool bs_array_reserve(bs_array_t *array_ptr, size_t capacity);
+
+/**
+ * Reduces the capacity to the array's size. Frees the storage, if empty.
+ *
+ * @param array_ptr
+ *
+ * @return true on success.
+ */
+bool bs_array_shrink_to_fit(bs_array_t *array_ptr);
+
+/**
+ * Sorts the elements.
+ *
+ * @param array_ptr
+ * @param cmp                 Comparator, as for qsort(3).
+ */
+void bs_array_sort(bs_array_t *array_ptr,
+                   int (*cmp)(const void *a_ptr, const void *b_ptr));
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_array_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_array_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_ARRAY_H__ */
+/* == End of array.h ======================================================= */
@@ -22,6 +22,25 @@
 #include "atomic.h"
 #include "test.h"
 
+#include <pthread.h>
+
+#if defined(__BS_ATOMIC_INT64_MUTEX)
+/** Initializer for one stripe. */
+#define _BS_ATOMIC_STRIPE { PTHREAD_MUTEX_INITIALIZER }
+/** Initializer for four stripes. */
+#define _BS_ATOMIC_STRIPES_4                                            \
+    _BS_ATOMIC_STRIPE, _BS_ATOMIC_STRIPE, _BS_ATOMIC_STRIPE, _BS_ATOMIC_STRIPE
+/** Initializer for 16 stripes. */
+#define _BS_ATOMIC_STRIPES_16                                           \
+    _BS_ATOMIC_STRIPES_4, _BS_ATOMIC_STRIPES_4,                         \
+    _BS_ATOMIC_STRIPES_4, _BS_ATOMIC_STRIPES_4
+
+_bs_atomic_stripe_t           _bs_atomic_stripes[_BS_ATOMIC_MUTEX_STRIPES] = {
+    _BS_ATOMIC_STRIPES_16, _BS_ATOMIC_STRIPES_16,
+    _BS_ATOMIC_STRIPES_16, _BS_ATOMIC_STRIPES_16
+};
+#endif  // defined(__BS_ATOMIC_INT64_MUTEX)
+
 #if defined(__cplusplus) || defined(__clang__)
 
 const bs_test_case_t          bs_atomic_test_cases[] = {
@@ -34,10 +53,18 @@ const bs_test_case_t          bs_atomic_test_cases[] = {
 
 static void bs_atomic_test_int32(bs_test_t *test_ptr);
 static void bs_atomic_test_int64(bs_test_t *test_ptr);
+static void bs_atomic_test_explicit(bs_test_t *test_ptr);
+static void bs_atomic_test_bitwise(bs_test_t *test_ptr);
+static void bs_atomic_test_ptr(bs_test_t *test_ptr);
+static void bs_atomic_test_threads(bs_test_t *test_ptr);
 
 const bs_test_case_t          bs_atomic_test_cases[] = {
     { 1, "int32 unit tests", bs_atomic_test_int32 },
     { 1, "int64 unit tests", bs_atomic_test_int64 },
+    { 1, "explicit order unit tests", bs_atomic_test_explicit },
+    { 1, "bitwise unit tests", bs_atomic_test_bitwise },
+    { 1, "pointer unit tests", bs_atomic_test_ptr },
+    { 1, "concurrent unit tests", bs_atomic_test_threads },
     { 0, NULL, NULL }
 };
 
@@ -95,6 +122,134 @@ void bs_atomic_test_int64(bs_test_t *test_ptr)
                                           0x0807060504030201));
     BS_TEST_VERIFY_EQ(test_ptr, 0x1122334455667788, bs_atomic_int64_get(&a));
 }
+
+/* ------------------------------------------------------------------------- */
+void bs_atomic_test_explicit(bs_test_t *test_ptr)
+{
+    bs_atomic_int32_t         a32 = BS_ATOMIC_INT32_INIT(0);
+    bs_atomic_int64_t         a64 = BS_ATOMIC_INT64_INIT(0);
+
+    bs_atomic_int32_set_explicit(&a32, 42, BS_ATOMIC_RELEASE);
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 42, bs_atomic_int32_get_explicit(&a32, BS_ATOMIC_ACQUIRE));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 43, bs_atomic_int32_add_explicit(&a32, 1, BS_ATOMIC_RELAXED));
+    // Orders that do not apply get strengthened.
+    bs_atomic_int32_set_explicit(&a32, 44, BS_ATOMIC_ACQUIRE);
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 44, bs_atomic_int32_get_explicit(&a32, BS_ATOMIC_RELEASE));
+
+    bs_atomic_int64_set_explicit(&a64, 0x0102030405060708, BS_ATOMIC_RELEASE);
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 0x0102030405060708,
+        bs_atomic_int64_get_explicit(&a64, BS_ATOMIC_ACQUIRE));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 0x0102030405060709,
+        bs_atomic_int64_add_explicit(&a64, 1, BS_ATOMIC_ACQ_REL));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 0x0102030405060709,
+        bs_atomic_int64_get_explicit(&a64, BS_ATOMIC_RELAXED));
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_atomic_test_bitwise(bs_test_t *test_ptr)
+{
+    bs_atomic_int32_t         a32 = BS_ATOMIC_INT32_INIT(0x0f);
+    bs_atomic_int64_t         a64 = BS_ATOMIC_INT64_INIT(0x0f);
+
+    BS_TEST_VERIFY_EQ(test_ptr, 0x0f, bs_atomic_int32_fetch_or(&a32, 0xf0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff, bs_atomic_int32_fetch_and(&a32, 0x3c));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x3c, bs_atomic_int32_get(&a32));
+
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 0x0f, bs_atomic_int64_fetch_or(&a64, 0x0100000000000000));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 0x010000000000000f,
+        bs_atomic_int64_fetch_and(&a64, 0x0100000000000003));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x0100000000000003, bs_atomic_int64_get(&a64));
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_atomic_test_ptr(bs_test_t *test_ptr)
+{
+    int                       x, y;
+    bs_atomic_ptr_t           a = BS_ATOMIC_PTR_INIT(NULL);
+    void                      *b;
+
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_atomic_ptr_get(&a));
+    bs_atomic_ptr_set(&a, &x);
+    BS_TEST_VERIFY_EQ(test_ptr, &x, bs_atomic_ptr_get(&a));
+    bs_atomic_ptr_set_explicit(&a, &y, BS_ATOMIC_RELEASE);
+    BS_TEST_VERIFY_EQ(
+        test_ptr, &y, bs_atomic_ptr_get_explicit(&a, BS_ATOMIC_ACQUIRE));
+
+    b = &x;
+    bs_atomic_ptr_xchg(&a, &b);
+    BS_TEST_VERIFY_EQ(test_ptr, &x, bs_atomic_ptr_get(&a));
+    BS_TEST_VERIFY_EQ(test_ptr, &y, b);
+
+    // CAS, but with non-matching old_val. Must not swap.
+    BS_TEST_VERIFY_EQ(test_ptr, &x, bs_atomic_ptr_cas(&a, NULL, &y));
+    BS_TEST_VERIFY_EQ(test_ptr, &x, bs_atomic_ptr_get(&a));
+
+    // CAS, with matching old_val. Must swap.
+    BS_TEST_VERIFY_EQ(test_ptr, &x, bs_atomic_ptr_cas(&a, NULL, &x));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_atomic_ptr_get(&a));
+}
+
+/** Number of threads in @ref bs_atomic_test_threads. */
+#define _TEST_THREADS 4
+/** Number of iterations of each thread. */
+#define _TEST_ITERATIONS 100000
+
+/** Argument to @ref _bs_atomic_test_thread. */
+typedef struct {
+    /** Counter to increment. */
+    bs_atomic_int64_t         *counter_ptr;
+    /** Bit field, to set one bit in. */
+    bs_atomic_int64_t         *bits_ptr;
+    /** Index of the thread. */
+    int                       index;
+} bs_atomic_test_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Increments the counter and sets its own bit. */
+static void *_bs_atomic_test_thread(void *arg_ptr)
+{
+    bs_atomic_test_arg_t *targ_ptr = arg_ptr;
+    for (int i = 0; i < _TEST_ITERATIONS; ++i) {
+        bs_atomic_int64_add(targ_ptr->counter_ptr, 1);
+        bs_atomic_int64_add_explicit(targ_ptr->counter_ptr, 1,
+                                     BS_ATOMIC_RELAXED);
+        bs_atomic_int64_fetch_or(targ_ptr->bits_ptr,
+                                 (int64_t)1 << (32 + targ_ptr->index));
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Concurrent read-modify-write operations must not get lost. */
+void bs_atomic_test_threads(bs_test_t *test_ptr)
+{
+    bs_atomic_int64_t         counter = BS_ATOMIC_INT64_INIT(0);
+    bs_atomic_int64_t         bits = BS_ATOMIC_INT64_INIT(0);
+    bs_atomic_test_arg_t      targs[_TEST_THREADS];
+    pthread_t                 threads[_TEST_THREADS];
+
+    for (int t = 0; t < _TEST_THREADS; ++t) {
+        targs[t] = (bs_atomic_test_arg_t){
+            .counter_ptr = &counter, .bits_ptr = &bits, .index = t };
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, 0,
+            pthread_create(&threads[t], NULL, _bs_atomic_test_thread,
+                           &targs[t]));
+    }
+    for (int t = 0; t < _TEST_THREADS; ++t) pthread_join(threads[t], NULL);
+
+    BS_TEST_VERIFY_EQ(test_ptr, 2 * _TEST_THREADS * _TEST_ITERATIONS,
+                      bs_atomic_int64_get(&counter));
+    BS_TEST_VERIFY_EQ(test_ptr, (int64_t)0xf << 32, bs_atomic_int64_get(&bits));
+}
 #endif
 
 /* == End of atomic.c ===================================================== */
@@ -41,26 +41,53 @@
 #elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
 #define __BS_ATOMIC_GCC_ASM_x86_64
 
+#elif (defined(__GNUC__) || defined(__clang__)) &&                     \
+    2 == __GCC_ATOMIC_INT_LOCK_FREE && 2 == __GCC_ATOMIC_LLONG_LOCK_FREE
+/** The __atomic builtins, lock-free for 64 bit: arm64, riscv64 and more. */
+#define __BS_ATOMIC_GCC_BUILTIN
+
 #else
 
 /** C11 supports atomics. We expect support for at least 32-bit atomics. */
 #define __BS_ATOMIC_C11_STDATOMIC
 #include <stdatomic.h>
 
-#if defined(ATOMIC_LLONG_LOCK_FREE)
+#if defined(ATOMIC_LLONG_LOCK_FREE) && 0 < ATOMIC_LLONG_LOCK_FREE
 
 /** We can use C11 definitions for 64-bit atomics. */
 #define __BS_ATOMIC_C11_STDATOMIC_INT64
-#else  // defined(ATOMIC_LLONG_LOCK_FREE)
-/** fall back to use a mutex for 64-bit atomics. */
+#else  // defined(ATOMIC_LLONG_LOCK_FREE) && 0 < ATOMIC_LLONG_LOCK_FREE
+/** Last resort: Fall back to use striped mutexes for 64-bit atomics. */
 #define __BS_ATOMIC_INT64_MUTEX
-#endif  // defined(ATOMIC_LLONG_LOCK_FREE)
+#endif  // defined(ATOMIC_LLONG_LOCK_FREE) && 0 < ATOMIC_LLONG_LOCK_FREE
 
 #endif  //  (defined(__GNUC__) || defined(__clang__)) && (i386 || __x86_64__).
 
 #if defined(__BS_ATOMIC_INT64_MUTEX)
 #include <pthread.h>
-static pthread_mutex_t        _bs_atomic_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Number of mutexes that the 64-bit atomics are spread over. */
+#define _BS_ATOMIC_MUTEX_STRIPES 64
+
+/** A mutex, aligned to own a cache line. */
+typedef struct {
+    /** The mutex. */
+    _Alignas(64) pthread_mutex_t mutex;
+} _bs_atomic_stripe_t;
+
+/** Mutexes for the 64-bit atomics. Defined in atomic.c. */
+extern _bs_atomic_stripe_t    _bs_atomic_stripes[_BS_ATOMIC_MUTEX_STRIPES];
+
+/**
+ * Returns the mutex guarding the atomic at `ptr`: Picked by address, so that
+ * unrelated atomics rarely contend on the same mutex.
+ */
+static inline pthread_mutex_t *_bs_atomic_mutex(const volatile void *ptr)
+{
+    uintptr_t a = (uintptr_t)ptr >> 3;
+    return &_bs_atomic_stripes[
+        (a ^ (a >> 6) ^ (a >> 12)) % _BS_ATOMIC_MUTEX_STRIPES].mutex;
+}
 #endif  // defined(__BS_ATOMIC_INT64_MUTEX)
 
 /**
@@ -106,6 +133,10 @@ static inline void bs_atomic_int32_set(bs_atomic_int32_t *a_ptr, int32_t v)
     // A 32-bit assignment is atomic on i386 */
     a_ptr->v = v;
 
+#elif defined(__BS_ATOMIC_GCC_BUILTIN)
+
+    __atomic_store_n(&a_ptr->v, v, __ATOMIC_SEQ_CST);
+
 #elif defined(__BS_ATOMIC_C11_STDATOMIC)
 
     atomic_store(&a_ptr->v, v);
@@ -124,6 +155,10 @@ static inline int32_t bs_atomic_int32_get(bs_atomic_int32_t *a_ptr)
     /* A 32-bit read is atomic on i386 */
     return a_ptr->v;
 
+#elif defined(__BS_ATOMIC_GCC_BUILTIN)
+
+    return __atomic_load_n(&a_ptr->v, __ATOMIC_SEQ_CST);
+
 #elif defined(__BS_ATOMIC_C11_STDATOMIC)
 
     return atomic_load(&a_ptr->v);
@@ -148,6 +183,10 @@ static inline int32_t bs_atomic_int32_add(bs_atomic_int32_t *a_ptr, int32_t v)
         : "memory"
         );
     return v + old_v;
+#elif defined(__BS_ATOMIC_GCC_BUILTIN)
+
+    return __atomic_add_fetch(&a_ptr->v, v, __ATOMIC_SEQ_CST);
+
 #elif defined(__BS_ATOMIC_C11_STDATOMIC)
 
     return atomic_fetch_add(&a_ptr->v, v) + v;
@@ -179,8 +218,15 @@ static inline int32_t bs_atomic_int32_cas(bs_atomic_int32_t *a_ptr,
         "cmpxchgl %2, %1; \n"
         : "=a" (curr_val), "=m" (a_ptr->v)
         : "r" (new_val), "m" (a_ptr->v), "0" (old_val)
+        : "memory"
         );
     return curr_val;
+#elif defined(__BS_ATOMIC_GCC_BUILTIN)
+
+    __atomic_compare_exchange_n(&a_ptr->v, &old_val, new_val, 0,
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return old_val;
+
 #elif defined(__BS_ATOMIC_C11_STDATOMIC)
 
     if (atomic_compare_exchange_strong(&a_ptr->v, &old_val, new_val)) {
@@ -205,7 +251,12 @@ static inline void bs_atomic_int32_xchg(bs_atomic_int32_t *a_ptr,
         "xchgl %0, %%eax; \n"
         : "+m" (a_ptr->v), "=a" (*v_ptr)
         : "m" (a_ptr->v), "a" (*v_ptr)
+        : "memory"
         );
+#elif defined(__BS_ATOMIC_GCC_BUILTIN)
+
+    *v_ptr = __atomic_exchange_n(&a_ptr->v, *v_ptr, __ATOMIC_SEQ_CST);
+
 #elif defined(__BS_ATOMIC_C11_STDATOMIC)
 
     *v_ptr = atomic_exchange(&a_ptr->v, *v_ptr);
@@ -243,15 +294,19 @@ static inline void bs_atomic_int64_set(bs_atomic_int64_t *a_ptr, int64_t v)
         : "r" (v)
         : "memory"
         );
+#elif defined(__BS_ATOMIC_GCC_BUILTIN)
+
+    __atomic_store_n(&a_ptr->v, v, __ATOMIC_SEQ_CST);
+
 #elif defined(__BS_ATOMIC_C11_STDATOMIC_INT64)
 
     atomic_store(&a_ptr->v, v);
 
 #elif defined(__BS_ATOMIC_INT64_MUTEX)
 
-    pthread_mutex_lock(&_bs_atomic_mutex);
+    pthread_mutex_lock(_bs_atomic_mutex(a_ptr));
     a_ptr->v = v;
-    pthread_mutex_unlock(&_bs_atomic_mutex);
+    pthread_mutex_unlock(_bs_atomic_mutex(a_ptr));
 
 #else
 #error "Unsupported compiler or architecture."
@@ -287,6 +342,10 @@ static inline int64_t bs_atomic_int64_get(bs_atomic_int64_t *a_ptr)
         : "m" (a_ptr->v)
         );
     return rv;
+#elif defined(__BS_ATOMIC_GCC_BUILTIN)
+
+    return __atomic_load_n(&a_ptr->v, __ATOMIC_SEQ_CST);
+
 #elif defined(__BS_ATOMIC_C11_STDATOMIC_INT64)
 
     return atomic_load(&a_ptr->v);
@@ -294,9 +353,9 @@ static inline int64_t bs_atomic_int64_get(bs_atomic_int64_t *a_ptr)
 #elif defined(__BS_ATOMIC_INT64_MUTEX)
 
     int64_t rv;
-    pthread_mutex_lock(&_bs_atomic_mutex);
+    pthread_mutex_lock(_bs_atomic_mutex(a_ptr));
     rv = a_ptr->v;
-    pthread_mutex_unlock(&_bs_atomic_mutex);
+    pthread_mutex_unlock(_bs_atomic_mutex(a_ptr));
     return rv;
 
 #else
@@ -342,6 +401,10 @@ static inline int64_t bs_atomic_int64_add(bs_atomic_int64_t *a_ptr, int64_t v)
         : "memory"
         );
     return v + old_v;
+#elif defined(__BS_ATOMIC_GCC_BUILTIN)
+
+    return __atomic_add_fetch(&a_ptr->v, v, __ATOMIC_SEQ_CST);
+
 #elif defined(__BS_ATOMIC_C11_STDATOMIC_INT64)
 
     return atomic_fetch_add(&a_ptr->v, v) + v;
@@ -349,10 +412,10 @@ static inline int64_t bs_atomic_int64_add(bs_atomic_int64_t *a_ptr, int64_t v)
 #elif defined(__BS_ATOMIC_INT64_MUTEX)
 
     int64_t rv;
-    pthread_mutex_lock(&_bs_atomic_mutex);
+    pthread_mutex_lock(_bs_atomic_mutex(a_ptr));
     a_ptr->v +=v;
     rv = a_ptr->v;
-    pthread_mutex_unlock(&_bs_atomic_mutex);
+    pthread_mutex_unlock(_bs_atomic_mutex(a_ptr));
     return rv;
 
 #else
@@ -398,6 +461,12 @@ static inline int64_t bs_atomic_int64_cas(bs_atomic_int64_t *a_ptr,
         : "memory"
         );
     return curr_val;
+#elif defined(__BS_ATOMIC_GCC_BUILTIN)
+
+    __atomic_compare_exchange_n(&a_ptr->v, &old_val, new_val, 0,
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return old_val;
+
 #elif defined(__BS_ATOMIC_C11_STDATOMIC_INT64)
 
     if (atomic_compare_exchange_strong(&a_ptr->v, &old_val, new_val)) {
@@ -409,14 +478,14 @@ static inline int64_t bs_atomic_int64_cas(bs_atomic_int64_t *a_ptr,
 #elif defined(__BS_ATOMIC_INT64_MUTEX)
 
     int64_t rv;
-    pthread_mutex_lock(&_bs_atomic_mutex);
+    pthread_mutex_lock(_bs_atomic_mutex(a_ptr));
     if (a_ptr->v == old_val) {
         a_ptr->v = new_val;
         rv = old_val;
     } else {
         rv = a_ptr->v;
     }
-    pthread_mutex_unlock(&_bs_atomic_mutex);
+    pthread_mutex_unlock(_bs_atomic_mutex(a_ptr));
     return rv;
 
 #else
@@ -442,24 +511,346 @@ static inline void bs_atomic_int64_xchg(bs_atomic_int64_t *a_ptr,
         "xchgq %0, %%rax; \n"
         : "+m" (a_ptr->v), "=a" (*v_ptr)
         : "m" (a_ptr->v), "a" (*v_ptr)
+        : "memory"
         );
+#elif defined(__BS_ATOMIC_GCC_BUILTIN)
+
+    *v_ptr = __atomic_exchange_n(&a_ptr->v, *v_ptr, __ATOMIC_SEQ_CST);
+
 #elif defined(__BS_ATOMIC_C11_STDATOMIC_INT64)
 
     *v_ptr = atomic_exchange(&a_ptr->v, *v_ptr);
 
 #elif defined(__BS_ATOMIC_INT64_MUTEX)
 
-    pthread_mutex_lock(&_bs_atomic_mutex);
+    pthread_mutex_lock(_bs_atomic_mutex(a_ptr));
     int64_t tmp = a_ptr->v;
     a_ptr->v = *v_ptr;
     *v_ptr = tmp;
-    pthread_mutex_unlock(&_bs_atomic_mutex);
+    pthread_mutex_unlock(_bs_atomic_mutex(a_ptr));
 
 #else
 #error "Unsupported compiler or architecture."
 #endif
 }
 
+/* == Memory orders ======================================================== */
+
+/**
+ * Memory orders for the `_explicit` methods, as defined for C11. The methods
+ * without `_explicit` are sequentially consistent.
+ *
+ * Orders that do not apply to a load or store are strengthened: A load with
+ * BS_ATOMIC_RELEASE is sequentially consistent, a store with
+ * BS_ATOMIC_ACQUIRE likewise.
+ */
+typedef enum {
+    BS_ATOMIC_RELAXED,
+    BS_ATOMIC_ACQUIRE,
+    BS_ATOMIC_RELEASE,
+    BS_ATOMIC_ACQ_REL,
+    BS_ATOMIC_SEQ_CST
+} bs_atomic_order_t;
+
+/* ------------------------------------------------------------------------- */
+/** Returns the order to use for a load. */
+static inline bs_atomic_order_t _bs_atomic_load_order(bs_atomic_order_t order)
+{
+    if (BS_ATOMIC_ACQ_REL == order) return BS_ATOMIC_ACQUIRE;
+    if (BS_ATOMIC_RELEASE == order) return BS_ATOMIC_SEQ_CST;
+    return order;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the order to use for a store. */
+static inline bs_atomic_order_t _bs_atomic_store_order(bs_atomic_order_t order)
+{
+    if (BS_ATOMIC_ACQ_REL == order) return BS_ATOMIC_RELEASE;
+    if (BS_ATOMIC_ACQUIRE == order) return BS_ATOMIC_SEQ_CST;
+    return order;
+}
+
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+/* ------------------------------------------------------------------------- */
+/** Translates to the C11 memory order. */
+static inline memory_order _bs_atomic_order(bs_atomic_order_t order)
+{
+    switch (order) {
+    case BS_ATOMIC_RELAXED: return memory_order_relaxed;
+    case BS_ATOMIC_ACQUIRE: return memory_order_acquire;
+    case BS_ATOMIC_RELEASE: return memory_order_release;
+    case BS_ATOMIC_ACQ_REL: return memory_order_acq_rel;
+    default: return memory_order_seq_cst;
+    }
+}
+#else  // defined(__BS_ATOMIC_C11_STDATOMIC)
+/* ------------------------------------------------------------------------- */
+/** Translates to the memory order of the __atomic builtins. */
+static inline int _bs_atomic_order(bs_atomic_order_t order)
+{
+    switch (order) {
+    case BS_ATOMIC_RELAXED: return __ATOMIC_RELAXED;
+    case BS_ATOMIC_ACQUIRE: return __ATOMIC_ACQUIRE;
+    case BS_ATOMIC_RELEASE: return __ATOMIC_RELEASE;
+    case BS_ATOMIC_ACQ_REL: return __ATOMIC_ACQ_REL;
+    default: return __ATOMIC_SEQ_CST;
+    }
+}
+#endif  // defined(__BS_ATOMIC_C11_STDATOMIC)
+
+/* == 32-bit integer, explicit orders and bitwise ========================== */
+
+/* ------------------------------------------------------------------------- */
+/** Get value of atomic, with the given memory order. */
+static inline int32_t bs_atomic_int32_get_explicit(bs_atomic_int32_t *a_ptr,
+                                                   bs_atomic_order_t order)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+    return atomic_load_explicit(
+        &a_ptr->v, _bs_atomic_order(_bs_atomic_load_order(order)));
+#else
+    return __atomic_load_n(
+        &a_ptr->v, _bs_atomic_order(_bs_atomic_load_order(order)));
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Set atomic value to v, with the given memory order. */
+static inline void bs_atomic_int32_set_explicit(bs_atomic_int32_t *a_ptr,
+                                                int32_t v,
+                                                bs_atomic_order_t order)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+    atomic_store_explicit(
+        &a_ptr->v, v, _bs_atomic_order(_bs_atomic_store_order(order)));
+#else
+    __atomic_store_n(
+        &a_ptr->v, v, _bs_atomic_order(_bs_atomic_store_order(order)));
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Add value to atomic, with the given memory order. Returns the sum. */
+static inline int32_t bs_atomic_int32_add_explicit(bs_atomic_int32_t *a_ptr,
+                                                   int32_t v,
+                                                   bs_atomic_order_t order)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+    return atomic_fetch_add_explicit(&a_ptr->v, v, _bs_atomic_order(order)) + v;
+#else
+    return __atomic_add_fetch(&a_ptr->v, v, _bs_atomic_order(order));
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Bitwise-or v into atomic. Returns the value from before. */
+static inline int32_t bs_atomic_int32_fetch_or(bs_atomic_int32_t *a_ptr,
+                                               int32_t v)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+    return atomic_fetch_or(&a_ptr->v, v);
+#else
+    return __atomic_fetch_or(&a_ptr->v, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Bitwise-and v into atomic. Returns the value from before. */
+static inline int32_t bs_atomic_int32_fetch_and(bs_atomic_int32_t *a_ptr,
+                                                int32_t v)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+    return atomic_fetch_and(&a_ptr->v, v);
+#else
+    return __atomic_fetch_and(&a_ptr->v, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* == 64-bit integer, explicit orders and bitwise ========================== */
+
+/* ------------------------------------------------------------------------- */
+/** Get value of atomic, with the given memory order. */
+static inline int64_t bs_atomic_int64_get_explicit(bs_atomic_int64_t *a_ptr,
+                                                   bs_atomic_order_t order)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC_INT64)
+    return atomic_load_explicit(
+        &a_ptr->v, _bs_atomic_order(_bs_atomic_load_order(order)));
+#elif defined(__BS_ATOMIC_INT64_MUTEX)
+    (void)order;
+    return bs_atomic_int64_get(a_ptr);
+#else
+    return __atomic_load_n(
+        &a_ptr->v, _bs_atomic_order(_bs_atomic_load_order(order)));
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Set atomic value to v, with the given memory order. */
+static inline void bs_atomic_int64_set_explicit(bs_atomic_int64_t *a_ptr,
+                                                int64_t v,
+                                                bs_atomic_order_t order)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC_INT64)
+    atomic_store_explicit(
+        &a_ptr->v, v, _bs_atomic_order(_bs_atomic_store_order(order)));
+#elif defined(__BS_ATOMIC_INT64_MUTEX)
+    (void)order;
+    bs_atomic_int64_set(a_ptr, v);
+#else
+    __atomic_store_n(
+        &a_ptr->v, v, _bs_atomic_order(_bs_atomic_store_order(order)));
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Add value to atomic, with the given memory order. Returns the sum. */
+static inline int64_t bs_atomic_int64_add_explicit(bs_atomic_int64_t *a_ptr,
+                                                   int64_t v,
+                                                   bs_atomic_order_t order)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC_INT64)
+    return atomic_fetch_add_explicit(&a_ptr->v, v, _bs_atomic_order(order)) + v;
+#elif defined(__BS_ATOMIC_INT64_MUTEX)
+    (void)order;
+    return bs_atomic_int64_add(a_ptr, v);
+#else
+    return __atomic_add_fetch(&a_ptr->v, v, _bs_atomic_order(order));
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Bitwise-or v into atomic. Returns the value from before. */
+static inline int64_t bs_atomic_int64_fetch_or(bs_atomic_int64_t *a_ptr,
+                                               int64_t v)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC_INT64)
+    return atomic_fetch_or(&a_ptr->v, v);
+#elif defined(__BS_ATOMIC_INT64_MUTEX)
+    pthread_mutex_lock(_bs_atomic_mutex(a_ptr));
+    int64_t rv = a_ptr->v;
+    a_ptr->v |= v;
+    pthread_mutex_unlock(_bs_atomic_mutex(a_ptr));
+    return rv;
+#else
+    return __atomic_fetch_or(&a_ptr->v, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Bitwise-and v into atomic. Returns the value from before. */
+static inline int64_t bs_atomic_int64_fetch_and(bs_atomic_int64_t *a_ptr,
+                                                int64_t v)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC_INT64)
+    return atomic_fetch_and(&a_ptr->v, v);
+#elif defined(__BS_ATOMIC_INT64_MUTEX)
+    pthread_mutex_lock(_bs_atomic_mutex(a_ptr));
+    int64_t rv = a_ptr->v;
+    a_ptr->v &= v;
+    pthread_mutex_unlock(_bs_atomic_mutex(a_ptr));
+    return rv;
+#else
+    return __atomic_fetch_and(&a_ptr->v, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* == Pointer ============================================================== */
+
+/**
+ * Initializes a bs_atomic_ptr_t to pointer p.
+ */
+#define BS_ATOMIC_PTR_INIT(p)  { (p) }
+
+/** An atomically accessible pointer. */
+typedef struct {
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+    /** The actual value. */
+    _Atomic(void *)           v;
+#else  // defined (__BS_ATOMIC_C11_STDATOMIC)
+    /** The actual value. */
+    void                      *v;
+#endif  // defined (__BS_ATOMIC_C11_STDATOMIC)
+} bs_atomic_ptr_t;
+
+/* ------------------------------------------------------------------------- */
+/** Get value of atomic, with the given memory order. */
+static inline void *bs_atomic_ptr_get_explicit(bs_atomic_ptr_t *a_ptr,
+                                               bs_atomic_order_t order)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+    return atomic_load_explicit(
+        &a_ptr->v, _bs_atomic_order(_bs_atomic_load_order(order)));
+#else
+    return __atomic_load_n(
+        &a_ptr->v, _bs_atomic_order(_bs_atomic_load_order(order)));
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Set atomic value to v, with the given memory order. */
+static inline void bs_atomic_ptr_set_explicit(bs_atomic_ptr_t *a_ptr,
+                                              void *v,
+                                              bs_atomic_order_t order)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+    atomic_store_explicit(
+        &a_ptr->v, v, _bs_atomic_order(_bs_atomic_store_order(order)));
+#else
+    __atomic_store_n(
+        &a_ptr->v, v, _bs_atomic_order(_bs_atomic_store_order(order)));
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Get value of atomic. */
+static inline void *bs_atomic_ptr_get(bs_atomic_ptr_t *a_ptr)
+{
+    return bs_atomic_ptr_get_explicit(a_ptr, BS_ATOMIC_SEQ_CST);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Set atomic value to v. */
+static inline void bs_atomic_ptr_set(bs_atomic_ptr_t *a_ptr, void *v)
+{
+    bs_atomic_ptr_set_explicit(a_ptr, v, BS_ATOMIC_SEQ_CST);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Compare-And-Swap value with atomic.
+ *
+ * If the returned value is not equal to old_val, no exchange was done.
+ *
+ * @param a_ptr
+ * @param new_val             Value to assign to atomic.
+ * @param old_val             Value to compare for.
+ *
+ * @return value of atomic.
+ */
+static inline void *bs_atomic_ptr_cas(bs_atomic_ptr_t *a_ptr,
+                                      void *new_val, void *old_val)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+    atomic_compare_exchange_strong(&a_ptr->v, &old_val, new_val);
+#else
+    __atomic_compare_exchange_n(&a_ptr->v, &old_val, new_val, 0,
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+    return old_val;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Exchange value with atomic. */
+static inline void bs_atomic_ptr_xchg(bs_atomic_ptr_t *a_ptr, void **v_ptr)
+{
+#if defined(__BS_ATOMIC_C11_STDATOMIC)
+    *v_ptr = atomic_exchange(&a_ptr->v, *v_ptr);
+#else
+    *v_ptr = __atomic_exchange_n(&a_ptr->v, *v_ptr, __ATOMIC_SEQ_CST);
+#endif
+}
+
 #endif  // defined(__cplusplus)
 
 /** Unit tests. */
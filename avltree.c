@@ -39,7 +39,6 @@ struct _bs_avltree_t {
     bs_avltree_node_destroy_t destroy;
 };
 
-static void bs_avltree_flush(bs_avltree_t *tree_ptr);
 static void bs_avltree_node_replace(bs_avltree_t *tree_ptr,
                                     bs_avltree_node_t *old_node_ptr,
                                     bs_avltree_node_t *new_node_ptr);
@@ -67,6 +66,21 @@ static void bs_avltree_verify_node(
 static bs_avltree_node_t *bs_avltree_node_min(bs_avltree_node_t *node_ptr);
 static bs_avltree_node_t *bs_avltree_node_max(bs_avltree_node_t *node_ptr);
 
+static void bs_avltree_build(bs_avltree_t *tree_ptr,
+                             bs_avltree_node_t **nodes_ptr,
+                             size_t count);
+static bs_avltree_node_t *bs_avltree_node_build(
+    bs_avltree_node_t **nodes_ptr,
+    size_t count,
+    bs_avltree_node_t *parent_ptr,
+    int *height_ptr);
+static void bs_avltree_collect(bs_avltree_t *tree_ptr,
+                               bs_avltree_node_t **nodes_ptr);
+static void bs_avltree_merge_insert(bs_avltree_t *tree_ptr,
+                                    bs_avltree_t *src_tree_ptr,
+                                    bs_avltree_node_key_t key_from_node,
+                                    bool do_overwrite);
+
 /* == Exported Functions =================================================== */
 
 /* ------------------------------------------------------------------------- */
@@ -91,6 +105,113 @@ void bs_avltree_destroy(bs_avltree_t *tree_ptr)
     free(tree_ptr);
 }
 
+/* ------------------------------------------------------------------------- */
+void bs_avltree_flush(bs_avltree_t *tree_ptr)
+{
+    bs_avltree_node_t         *node_ptr;
+    bs_avltree_node_t         *parent_ptr;
+
+    node_ptr = tree_ptr->root_ptr;
+    while (NULL != node_ptr) {
+
+        /* walk tree downwards as far as possible */
+        if (NULL != node_ptr->left_ptr) {
+            node_ptr = node_ptr->left_ptr;
+            continue;
+        }
+        if (NULL != node_ptr->right_ptr) {
+            node_ptr = node_ptr->right_ptr;
+            continue;
+        }
+
+        /* store parent node, then clear bottom-most node */
+        parent_ptr = node_ptr->parent_ptr;
+        memset(node_ptr, 0, sizeof(bs_avltree_node_t));
+        if (NULL != tree_ptr->destroy) {
+            tree_ptr->destroy(node_ptr);
+        }
+        tree_ptr->nodes--;
+
+        /* if the parent is NULL, we just flushed the root node. all done. */
+        if (NULL == parent_ptr) break;
+
+        /* in parent: mark the just-deleted node as gone */
+        if (parent_ptr->left_ptr == node_ptr) {
+            parent_ptr->left_ptr = NULL;
+        } else {
+            parent_ptr->right_ptr = NULL;
+        }
+
+        node_ptr = parent_ptr;
+    }
+
+    tree_ptr->root_ptr = NULL;
+    BS_ASSERT(0 == tree_ptr->nodes);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_avltree_build_from_sorted(bs_avltree_t *tree_ptr,
+                                  bs_avltree_node_t **nodes_ptr,
+                                  size_t count)
+{
+    if (NULL != tree_ptr->root_ptr) return false;
+    bs_avltree_build(tree_ptr, nodes_ptr, count);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_avltree_merge(bs_avltree_t *tree_ptr,
+                      bs_avltree_t *src_tree_ptr,
+                      bs_avltree_node_key_t key_from_node,
+                      bool do_overwrite)
+{
+    size_t n = tree_ptr->nodes, m = src_tree_ptr->nodes, log2 = 1;
+    if (0 == m) return true;
+
+    /* a few nodes into a large tree: individual inserts are cheaper. */
+    for (size_t v = n + m; v > 1; v >>= 1) ++log2;
+    if (m * log2 < n) {
+        bs_avltree_merge_insert(tree_ptr, src_tree_ptr, key_from_node,
+                                do_overwrite);
+        return true;
+    }
+
+    bs_avltree_node_t **nodes_ptr = calloc(2 * (n + m),
+                                           sizeof(bs_avltree_node_t*));
+    if (NULL == nodes_ptr) return false;
+    bs_avltree_node_t **a_ptr = nodes_ptr;
+    bs_avltree_node_t **b_ptr = nodes_ptr + n;
+    bs_avltree_node_t **merged_ptr = nodes_ptr + n + m;
+    bs_avltree_collect(tree_ptr, a_ptr);
+    bs_avltree_collect(src_tree_ptr, b_ptr);
+
+    /* merge. rejected nodes are compacted at the front of b_ptr. */
+    size_t i = 0, j = 0, merged = 0, rejected = 0;
+    while (i < n && j < m) {
+        int cmp_rv = tree_ptr->cmp(a_ptr[i], key_from_node(b_ptr[j]));
+        if (0 > cmp_rv) {
+            merged_ptr[merged++] = a_ptr[i++];
+        } else if (0 < cmp_rv) {
+            merged_ptr[merged++] = b_ptr[j++];
+        } else if (do_overwrite) {
+            memset(a_ptr[i], 0, sizeof(bs_avltree_node_t));
+            if (NULL != tree_ptr->destroy) tree_ptr->destroy(a_ptr[i]);
+            i++;
+            merged_ptr[merged++] = b_ptr[j++];
+        } else {
+            merged_ptr[merged++] = a_ptr[i++];
+            b_ptr[rejected++] = b_ptr[j++];
+        }
+    }
+    while (i < n) merged_ptr[merged++] = a_ptr[i++];
+    while (j < m) merged_ptr[merged++] = b_ptr[j++];
+
+    bs_avltree_build(tree_ptr, merged_ptr, merged);
+    bs_avltree_build(src_tree_ptr, b_ptr, rejected);
+    free(nodes_ptr);
+    return true;
+}
+
 /* ------------------------------------------------------------------------- */
 bs_avltree_node_t *bs_avltree_lookup(bs_avltree_t *tree_ptr,
                                      const void *key_ptr)
@@ -221,6 +342,44 @@ bs_avltree_node_t *bs_avltree_delete(bs_avltree_t *tree_ptr,
     return node_ptr;
 }
 
+/* ------------------------------------------------------------------------- */
+bs_avltree_node_t *bs_avltree_lower_bound(bs_avltree_t *tree_ptr,
+                                          const void *key_ptr)
+{
+    bs_avltree_node_t         *node_ptr = tree_ptr->root_ptr;
+    bs_avltree_node_t         *bound_ptr = NULL;
+
+    while (NULL != node_ptr) {
+        if (0 <= tree_ptr->cmp(node_ptr, key_ptr)) {
+            /* node not less than key: candidate. look for smaller ones. */
+            bound_ptr = node_ptr;
+            node_ptr = node_ptr->left_ptr;
+        } else {
+            node_ptr = node_ptr->right_ptr;
+        }
+    }
+    return bound_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+bs_avltree_node_t *bs_avltree_upper_bound(bs_avltree_t *tree_ptr,
+                                          const void *key_ptr)
+{
+    bs_avltree_node_t         *node_ptr = tree_ptr->root_ptr;
+    bs_avltree_node_t         *bound_ptr = NULL;
+
+    while (NULL != node_ptr) {
+        if (0 < tree_ptr->cmp(node_ptr, key_ptr)) {
+            /* node greater than key: candidate. look for smaller ones. */
+            bound_ptr = node_ptr;
+            node_ptr = node_ptr->left_ptr;
+        } else {
+            node_ptr = node_ptr->right_ptr;
+        }
+    }
+    return bound_ptr;
+}
+
 /* ------------------------------------------------------------------------- */
 size_t bs_avltree_size(const bs_avltree_t *tree_ptr)
 {
@@ -308,51 +467,6 @@ int bs_avltree_cmp_ptr(const void *node_key_ptr,
 
 /* == Local methods ======================================================== */
 
-/* ------------------------------------------------------------------------- */
-/** Will destroy (if given) each of the nodes. */
-void bs_avltree_flush(bs_avltree_t *tree_ptr)
-{
-    bs_avltree_node_t         *node_ptr;
-    bs_avltree_node_t         *parent_ptr;
-
-    node_ptr = tree_ptr->root_ptr;
-    while (NULL != node_ptr) {
-
-        /* walk tree downwards as far as possible */
-        if (NULL != node_ptr->left_ptr) {
-            node_ptr = node_ptr->left_ptr;
-            continue;
-        }
-        if (NULL != node_ptr->right_ptr) {
-            node_ptr = node_ptr->right_ptr;
-            continue;
-        }
-
-        /* store parent node, then clear bottom-most node */
-        parent_ptr = node_ptr->parent_ptr;
-        memset(node_ptr, 0, sizeof(bs_avltree_node_t));
-        if (NULL != tree_ptr->destroy) {
-            tree_ptr->destroy(node_ptr);
-        }
-        tree_ptr->nodes--;
-
-        /* if the parent is NULL, we just flushed the root node. all done. */
-        if (NULL == parent_ptr) break;
-
-        /* in parent: mark the just-deleted node as gone */
-        if (parent_ptr->left_ptr == node_ptr) {
-            parent_ptr->left_ptr = NULL;
-        } else {
-            parent_ptr->right_ptr = NULL;
-        }
-
-        node_ptr = parent_ptr;
-    }
-
-    tree_ptr->root_ptr = NULL;
-    BS_ASSERT(0 == tree_ptr->nodes);
-}
-
 /* ------------------------------------------------------------------------- */
 /**
  * Replaces the node at |old_node_ptr| with |new_node_ptr| in the |tree_ptr|.
@@ -798,6 +912,98 @@ bs_avltree_node_t *bs_avltree_node_max(bs_avltree_node_t *node_ptr)
     return bs_avltree_node_max(node_ptr->right_ptr);
 }
 
+/* ------------------------------------------------------------------------- */
+/**
+ * (Re)builds the tree from the sorted |nodes_ptr|, dropping the references
+ * to any nodes it held before.
+ */
+void bs_avltree_build(bs_avltree_t *tree_ptr,
+                      bs_avltree_node_t **nodes_ptr,
+                      size_t count)
+{
+    int                       height;
+
+    tree_ptr->root_ptr = bs_avltree_node_build(
+        nodes_ptr, count, NULL, &height);
+    tree_ptr->nodes = count;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Builds a balanced subtree from the sorted |nodes_ptr|, by picking the
+ * median as root. Both sides then differ by at most one node, and hence in
+ * height by at most one. Recursion depth is logarithmic in |count|.
+ *
+ * @param nodes_ptr
+ * @param count
+ * @param parent_ptr
+ * @param height_ptr          Output: The height of the subtree.
+ *
+ * @return The subtree's root node, or NULL if |count| is 0.
+ */
+bs_avltree_node_t *bs_avltree_node_build(
+    bs_avltree_node_t **nodes_ptr,
+    size_t count,
+    bs_avltree_node_t *parent_ptr,
+    int *height_ptr)
+{
+    int                       height_left, height_right;
+
+    if (0 == count) {
+        *height_ptr = 0;
+        return NULL;
+    }
+
+    size_t median = count / 2;
+    bs_avltree_node_t *node_ptr = nodes_ptr[median];
+    node_ptr->parent_ptr = parent_ptr;
+    node_ptr->left_ptr = bs_avltree_node_build(
+        nodes_ptr, median, node_ptr, &height_left);
+    node_ptr->right_ptr = bs_avltree_node_build(
+        nodes_ptr + median + 1, count - median - 1, node_ptr, &height_right);
+    node_ptr->balance = height_right - height_left;
+
+    *height_ptr = 1 + BS_MAX(height_left, height_right);
+    return node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Stores all nodes of |tree_ptr|, in order, into |nodes_ptr|. */
+void bs_avltree_collect(bs_avltree_t *tree_ptr,
+                        bs_avltree_node_t **nodes_ptr)
+{
+    for (bs_avltree_node_t *node_ptr = bs_avltree_min(tree_ptr);
+         NULL != node_ptr;
+         node_ptr = bs_avltree_node_next(tree_ptr, node_ptr)) {
+        *nodes_ptr++ = node_ptr;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Merges by moving nodes individually. See @ref bs_avltree_merge. Rejected
+ * nodes are re-inserted into |src_tree_ptr|. They are smaller than the
+ * remaining nodes, so the walk will not visit them again.
+ */
+void bs_avltree_merge_insert(bs_avltree_t *tree_ptr,
+                             bs_avltree_t *src_tree_ptr,
+                             bs_avltree_node_key_t key_from_node,
+                             bool do_overwrite)
+{
+    bs_avltree_node_t *node_ptr = bs_avltree_min(src_tree_ptr);
+    while (NULL != node_ptr) {
+        bs_avltree_node_t *next_node_ptr = bs_avltree_node_next(
+            src_tree_ptr, node_ptr);
+        bs_avltree_node_delete(src_tree_ptr, node_ptr);
+        if (!bs_avltree_insert(tree_ptr, key_from_node(node_ptr), node_ptr,
+                               do_overwrite)) {
+            bs_avltree_insert(src_tree_ptr, key_from_node(node_ptr),
+                              node_ptr, false);
+        }
+        node_ptr = next_node_ptr;
+    }
+}
+
 /* == Test Functions ======================================================= */
 /** @cond TEST */
 
@@ -818,9 +1024,15 @@ static int bs_avltree_test_node_cmp(const bs_avltree_node_t *node_ptr,
 static const void *bs_avltree_test_node_key(const bs_avltree_node_t *node_ptr);
 
 static void bs_avltree_test_random(bs_test_t *test_ptr);
+static void bs_avltree_test_build(bs_test_t *test_ptr);
+static void bs_avltree_test_bounds(bs_test_t *test_ptr);
+static void bs_avltree_test_merge(bs_test_t *test_ptr);
 
 const bs_test_case_t          bs_avltree_test_cases[] = {
     { 1, "random", bs_avltree_test_random },
+    { 1, "build", bs_avltree_test_build },
+    { 1, "bounds", bs_avltree_test_bounds },
+    { 1, "merge", bs_avltree_test_merge },
     { 0, NULL, NULL }
 };
 
@@ -987,6 +1199,184 @@ void bs_avltree_test_random(bs_test_t *test_ptr)
 }
 
 
+/* ------------------------------------------------------------------------- */
+/** Verifies tree consistency and size. */
+static void bs_avltree_test_verify(bs_test_t *test_ptr,
+                                   bs_avltree_t *tree_ptr,
+                                   size_t expected_size)
+{
+    BS_TEST_VERIFY_EQ(test_ptr, expected_size, bs_avltree_size(tree_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, expected_size,
+                      bs_avltree_node_size(tree_ptr, tree_ptr->root_ptr));
+    bs_avltree_verify_node(tree_ptr,
+                           bs_avltree_test_node_key,
+                           tree_ptr->root_ptr,
+                           NULL,
+                           NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Creates a tree with nodes for values `first`, `first + step`, ... up to
+ * values less than `limit`. Uses @ref bs_avltree_build_from_sorted.
+ */
+static bs_avltree_t *bs_avltree_test_create_sorted(bs_test_t *test_ptr,
+                                                   int first,
+                                                   int step,
+                                                   int limit)
+{
+    bs_avltree_node_t         *nodes[BS_AVLTREE_TEST_VALUES];
+    size_t                    count = 0;
+
+    bs_avltree_t *tree_ptr = bs_avltree_create(bs_avltree_test_node_cmp,
+                                               bs_avltree_test_node_destroy);
+    BS_ASSERT(NULL != tree_ptr);
+    for (int v = first; v < limit; v += step) {
+        BS_ASSERT(count < BS_AVLTREE_TEST_VALUES);
+        nodes[count++] = &BS_ASSERT_NOTNULL(
+            bs_avltree_test_node_create(v))->node;
+    }
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_avltree_build_from_sorted(tree_ptr, nodes, count));
+    bs_avltree_test_verify(test_ptr, tree_ptr, count);
+    return tree_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies building from a sorted array, for all sizes up to 100. */
+void bs_avltree_test_build(bs_test_t *test_ptr)
+{
+    bs_avltree_node_t         *node_ptr;
+
+    for (int count = 0; count <= 100; ++count) {
+        bs_avltree_t *tree_ptr = bs_avltree_test_create_sorted(
+            test_ptr, 0, 1, count);
+
+        int value = 0;
+        for (node_ptr = bs_avltree_min(tree_ptr);
+             NULL != node_ptr;
+             node_ptr = bs_avltree_node_next(tree_ptr, node_ptr)) {
+            BS_TEST_VERIFY_EQ(test_ptr, value,
+                              ((bs_avltree_test_node_t*)node_ptr)->value);
+            value++;
+        }
+        BS_TEST_VERIFY_EQ(test_ptr, count, value);
+
+        /* A tree that isn't empty must be rejected. */
+        if (0 < count) {
+            bs_avltree_node_t *n_ptr = &BS_ASSERT_NOTNULL(
+                bs_avltree_test_node_create(count))->node;
+            BS_TEST_VERIFY_FALSE(
+                test_ptr, bs_avltree_build_from_sorted(tree_ptr, &n_ptr, 1));
+            bs_avltree_test_node_destroy(n_ptr);
+        }
+
+        /* It remains a valid AVL tree, under further inserts & deletes. */
+        node_ptr = &BS_ASSERT_NOTNULL(
+            bs_avltree_test_node_create(-1))->node;
+        BS_TEST_VERIFY_TRUE(
+            test_ptr, bs_avltree_insert(tree_ptr, &(int){-1}, node_ptr,
+                                        false));
+        bs_avltree_test_verify(test_ptr, tree_ptr, count + 1);
+        node_ptr = bs_avltree_delete(tree_ptr, &(int){count / 2});
+        if (0 < count) bs_avltree_test_node_destroy(node_ptr);
+        bs_avltree_test_verify(test_ptr, tree_ptr, 0 < count ? count : 1);
+
+        bs_avltree_destroy(tree_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies @ref bs_avltree_lower_bound and @ref bs_avltree_upper_bound. */
+void bs_avltree_test_bounds(bs_test_t *test_ptr)
+{
+    bs_avltree_test_node_t    *node_ptr;
+
+    /* Tree with values 10, 20, ... 90. */
+    bs_avltree_t *tree_ptr = bs_avltree_test_create_sorted(
+        test_ptr, 10, 10, 100);
+
+    for (int key = 0; key <= 100; ++key) {
+        int expected = ((key + 9) / 10) * 10;
+        if (10 > expected) expected = 10;
+        node_ptr = (bs_avltree_test_node_t*)bs_avltree_lower_bound(
+            tree_ptr, &key);
+        if (90 < expected) {
+            BS_TEST_VERIFY_EQ(test_ptr, NULL, node_ptr);
+        } else {
+            BS_TEST_VERIFY_EQ(test_ptr, expected, node_ptr->value);
+        }
+
+        expected = (key / 10 + 1) * 10;
+        if (10 > expected) expected = 10;
+        node_ptr = (bs_avltree_test_node_t*)bs_avltree_upper_bound(
+            tree_ptr, &key);
+        if (90 < expected) {
+            BS_TEST_VERIFY_EQ(test_ptr, NULL, node_ptr);
+        } else {
+            BS_TEST_VERIFY_EQ(test_ptr, expected, node_ptr->value);
+        }
+    }
+
+    /* Range scan over [25, 65). */
+    int sum = 0;
+    int key = 25, limit = 65;
+    for (bs_avltree_node_t *n_ptr = bs_avltree_lower_bound(tree_ptr, &key);
+         NULL != n_ptr && 0 > bs_avltree_test_node_cmp(n_ptr, &limit);
+         n_ptr = bs_avltree_node_next(tree_ptr, n_ptr)) {
+        sum += ((bs_avltree_test_node_t*)n_ptr)->value;
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 30 + 40 + 50 + 60, sum);
+
+    bs_avltree_destroy(tree_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies @ref bs_avltree_merge, for both the linear and insert path. */
+void bs_avltree_test_merge(bs_test_t *test_ptr)
+{
+    bs_avltree_t *tree_ptr, *src_ptr;
+
+    /* Linear path. Evens 0..1998 and multiples of 3, 0..2997: 667 dups. */
+    tree_ptr = bs_avltree_test_create_sorted(test_ptr, 0, 2, 2000);
+    src_ptr = bs_avltree_test_create_sorted(test_ptr, 0, 3, 3000);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_avltree_merge(tree_ptr, src_ptr, bs_avltree_test_node_key, false));
+    bs_avltree_test_verify(test_ptr, tree_ptr, 1000 + 1000 - 334);
+    bs_avltree_test_verify(test_ptr, src_ptr, 334);
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 0,
+        ((bs_avltree_test_node_t*)bs_avltree_min(src_ptr))->value);
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 1998,
+        ((bs_avltree_test_node_t*)bs_avltree_max(src_ptr))->value);
+
+    /* Linear path, with overwrite: Moves all the remaining nodes. */
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_avltree_merge(tree_ptr, src_ptr, bs_avltree_test_node_key, true));
+    bs_avltree_test_verify(test_ptr, tree_ptr, 1000 + 1000 - 334);
+    bs_avltree_test_verify(test_ptr, src_ptr, 0);
+    bs_avltree_destroy(src_ptr);
+
+    /* Insert path: Few nodes into a large tree. 2995 and 2996 are new. */
+    src_ptr = bs_avltree_test_create_sorted(test_ptr, 2994, 1, 2998);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_avltree_merge(tree_ptr, src_ptr, bs_avltree_test_node_key, false));
+    bs_avltree_test_verify(test_ptr, tree_ptr, 1000 + 1000 - 334 + 2);
+    bs_avltree_test_verify(test_ptr, src_ptr, 2);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_avltree_merge(tree_ptr, src_ptr, bs_avltree_test_node_key, true));
+    bs_avltree_test_verify(test_ptr, tree_ptr, 1000 + 1000 - 334 + 2);
+    bs_avltree_test_verify(test_ptr, src_ptr, 0);
+
+    bs_avltree_destroy(src_ptr);
+    bs_avltree_destroy(tree_ptr);
+}
+
 /* ------------------------------------------------------------------------- */
 bs_avltree_test_node_t *bs_avltree_test_node_create(int value)
 {
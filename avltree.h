@@ -69,6 +69,16 @@ typedef int (*bs_avltree_node_cmp_t)(const bs_avltree_node_t *node_ptr,
  */
 typedef void (*bs_avltree_node_destroy_t)(bs_avltree_node_t *node_ptr);
 
+/**
+ * Functor type to obtain the key of an avltree node.
+ *
+ * @param node_ptr
+ *
+ * @return The key, suitable as `key_ptr` for @ref bs_avltree_node_cmp_t.
+ */
+typedef const void *(*bs_avltree_node_key_t)(
+    const bs_avltree_node_t *node_ptr);
+
 /**
  * Creates a tree.
  *
@@ -88,6 +98,51 @@ bs_avltree_t *bs_avltree_create(bs_avltree_node_cmp_t cmp,
  */
 void bs_avltree_destroy(bs_avltree_t *tree_ptr);
 
+/**
+ * Removes all nodes from the tree, and destroys them if a destroy functor was
+ * specified. Walks the tree iteratively, without recursion.
+ *
+ * @param tree_ptr
+ */
+void bs_avltree_flush(bs_avltree_t *tree_ptr);
+
+/**
+ * Builds the tree from an array of nodes, in linear time.
+ *
+ * @param tree_ptr            The tree. Must be empty.
+ * @param nodes_ptr           Array of `count` nodes, strictly ascending
+ *     according to the tree's comparator. This is not verified. The tree
+ *     takes ownership of the nodes, but not of the array.
+ * @param count
+ *
+ * @return false if the tree was not empty.
+ */
+bool bs_avltree_build_from_sorted(bs_avltree_t *tree_ptr,
+                                  bs_avltree_node_t **nodes_ptr,
+                                  size_t count);
+
+/**
+ * Moves all nodes from |src_tree_ptr| into |tree_ptr|.
+ *
+ * If |src_tree_ptr| is large compared to |tree_ptr|, both are flattened,
+ * merged and rebuilt in linear time. Otherwise, nodes are inserted
+ * individually.
+ *
+ * @param tree_ptr
+ * @param src_tree_ptr        Must order nodes just as |tree_ptr|.
+ * @param key_from_node       Obtains the key of a node in |src_tree_ptr|.
+ * @param do_overwrite Whether nodes of |src_tree_ptr| overwrite nodes with
+ *     an equal key in |tree_ptr|. The overwritten nodes will be destroyed, if
+ *     a destroy method was specified. If false, these nodes remain in
+ *     |src_tree_ptr|.
+ *
+ * @return false on allocation failure, with both trees unchanged.
+ */
+bool bs_avltree_merge(bs_avltree_t *tree_ptr,
+                      bs_avltree_t *src_tree_ptr,
+                      bs_avltree_node_key_t key_from_node,
+                      bool do_overwrite);
+
 /** Returns the node matching |key_ptr| in the tree. */
 bs_avltree_node_t *bs_avltree_lookup(bs_avltree_t *tree_ptr,
                                      const void *key_ptr);
@@ -122,6 +177,14 @@ bool bs_avltree_insert(bs_avltree_t *tree_ptr,
 bs_avltree_node_t *bs_avltree_delete(bs_avltree_t *tree_ptr,
                                      const void *key_ptr);
 
+/** Returns the smallest node not less than |key_ptr|, or NULL. */
+bs_avltree_node_t *bs_avltree_lower_bound(bs_avltree_t *tree_ptr,
+                                          const void *key_ptr);
+
+/** Returns the smallest node greater than |key_ptr|, or NULL. */
+bs_avltree_node_t *bs_avltree_upper_bound(bs_avltree_t *tree_ptr,
+                                          const void *key_ptr);
+
 /** Returns the minimum node of the tree. */
 bs_avltree_node_t *bs_avltree_min(bs_avltree_t *tree_ptr);
 
@@ -0,0 +1,1282 @@
+/* ========================================================================= */
+/**
+ * @file btree.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "btree.h"
+
+#include "avltree.h"
+#include "def.h"
+#include "log_wrappers.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* == Declarations ========================================================= */
+
+/**
+ * @private A node of the tree.
+ *
+ * Keys come first, so that a search's comparisons touch the fewest cache
+ * lines. Leaf nodes are allocated without `children_ptr`.
+ */
+struct _bs_btree_node_t {
+    /** Number of keys in this node. */
+    unsigned                  count;
+    /** Whether this is a leaf node. */
+    bool                      leaf;
+    /** The keys, in ascending order. */
+    uint64_t                  keys[BS_BTREE_MAX_KEYS];
+    /** The value for each key. */
+    void                      *values_ptr[BS_BTREE_MAX_KEYS];
+    /** Children, `count` + 1 of them. Only present in internal nodes. */
+    bs_btree_node_t           *children_ptr[];
+};
+
+/** State of the tree. */
+struct _bs_btree_t {
+    /** The root node. NULL if the tree is empty. */
+    bs_btree_node_t           *root_ptr;
+    /** Number of keys in the tree. */
+    size_t                    size;
+    /** Comparator. NULL to compare keys as unsigned integers. */
+    bs_btree_key_cmp_t        cmp;
+    /** Destroys keys and values. May be NULL. */
+    bs_btree_destroy_t        destroy;
+};
+
+static bs_btree_node_t *_bs_btree_node_create(bool leaf);
+static void _bs_btree_node_destroy(bs_btree_t *tree_ptr,
+                                   bs_btree_node_t *node_ptr);
+static int _bs_btree_cmp(const bs_btree_t *tree_ptr,
+                         uint64_t key1,
+                         uint64_t key2);
+static unsigned _bs_btree_node_search(const bs_btree_t *tree_ptr,
+                                      const bs_btree_node_t *node_ptr,
+                                      uint64_t key,
+                                      bool upper,
+                                      bool *found_ptr);
+static bool _bs_btree_split_child(bs_btree_node_t *node_ptr, unsigned pos);
+static void _bs_btree_merge_children(bs_btree_node_t *node_ptr,
+                                     unsigned pos);
+static unsigned _bs_btree_fill_child(bs_btree_node_t *node_ptr,
+                                     unsigned pos);
+static bool _bs_btree_bound(const bs_btree_t *tree_ptr,
+                            uint64_t key,
+                            bool upper,
+                            bs_btree_iterator_t *iter_ptr);
+static bool _bs_btree_iterator_descend(bs_btree_iterator_t *iter_ptr,
+                                       bs_btree_node_t *node_ptr,
+                                       bool rightmost);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_btree_t *bs_btree_create(bs_btree_key_cmp_t cmp,
+                            bs_btree_destroy_t destroy)
+{
+    bs_btree_t *tree_ptr = logged_calloc(1, sizeof(bs_btree_t));
+    if (NULL == tree_ptr) return NULL;
+    tree_ptr->cmp = cmp;
+    tree_ptr->destroy = destroy;
+    return tree_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_btree_destroy(bs_btree_t *tree_ptr)
+{
+    bs_btree_flush(tree_ptr);
+    logged_free(tree_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_btree_flush(bs_btree_t *tree_ptr)
+{
+    if (NULL != tree_ptr->root_ptr) {
+        _bs_btree_node_destroy(tree_ptr, tree_ptr->root_ptr);
+        tree_ptr->root_ptr = NULL;
+    }
+    tree_ptr->size = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_btree_insert(bs_btree_t *tree_ptr,
+                     uint64_t key,
+                     void *value_ptr,
+                     bool do_overwrite)
+{
+    if (NULL == tree_ptr->root_ptr) {
+        tree_ptr->root_ptr = _bs_btree_node_create(true);
+        if (NULL == tree_ptr->root_ptr) return false;
+    }
+
+    // Splits full nodes on the way down, so there's always room for the
+    // median of a split child. A full root grows the tree by one level.
+    if (BS_BTREE_MAX_KEYS == tree_ptr->root_ptr->count) {
+        bs_btree_node_t *root_ptr = _bs_btree_node_create(false);
+        if (NULL == root_ptr) return false;
+        root_ptr->children_ptr[0] = tree_ptr->root_ptr;
+        if (!_bs_btree_split_child(root_ptr, 0)) {
+            logged_free(root_ptr);
+            return false;
+        }
+        tree_ptr->root_ptr = root_ptr;
+    }
+
+    bs_btree_node_t *node_ptr = tree_ptr->root_ptr;
+    for (;;) {
+        bool found;
+        unsigned pos = _bs_btree_node_search(
+            tree_ptr, node_ptr, key, false, &found);
+
+        if (!found && !node_ptr->leaf &&
+            BS_BTREE_MAX_KEYS == node_ptr->children_ptr[pos]->count) {
+            if (!_bs_btree_split_child(node_ptr, pos)) return false;
+            int rv = _bs_btree_cmp(tree_ptr, key, node_ptr->keys[pos]);
+            if (0 == rv) found = true;
+            if (0 < rv) ++pos;
+        }
+
+        if (found) {
+            if (!do_overwrite) return false;
+            if (NULL != tree_ptr->destroy) {
+                tree_ptr->destroy(node_ptr->keys[pos],
+                                  node_ptr->values_ptr[pos]);
+            }
+            node_ptr->keys[pos] = key;
+            node_ptr->values_ptr[pos] = value_ptr;
+            return true;
+        }
+
+        if (node_ptr->leaf) {
+            unsigned tail = node_ptr->count - pos;
+            memmove(&node_ptr->keys[pos + 1], &node_ptr->keys[pos],
+                    tail * sizeof(uint64_t));
+            memmove(&node_ptr->values_ptr[pos + 1], &node_ptr->values_ptr[pos],
+                    tail * sizeof(void*));
+            node_ptr->keys[pos] = key;
+            node_ptr->values_ptr[pos] = value_ptr;
+            node_ptr->count++;
+            tree_ptr->size++;
+            return true;
+        }
+        node_ptr = node_ptr->children_ptr[pos];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_btree_lookup(const bs_btree_t *tree_ptr,
+                     uint64_t key,
+                     void **value_ptr_ptr)
+{
+    const bs_btree_node_t *node_ptr = tree_ptr->root_ptr;
+    while (NULL != node_ptr) {
+        bool found;
+        unsigned pos = _bs_btree_node_search(
+            tree_ptr, node_ptr, key, false, &found);
+        if (found) {
+            if (NULL != value_ptr_ptr) {
+                *value_ptr_ptr = node_ptr->values_ptr[pos];
+            }
+            return true;
+        }
+        if (node_ptr->leaf) break;
+        node_ptr = node_ptr->children_ptr[pos];
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_btree_delete(bs_btree_t *tree_ptr,
+                     uint64_t key,
+                     void **value_ptr_ptr)
+{
+    bs_btree_node_t *node_ptr = tree_ptr->root_ptr;
+    bool deleted = false;
+
+    // Ensures each node descended into has at least BS_BTREE_MIN_DEGREE
+    // keys, so that removing a key never leaves a node under-full.
+    while (NULL != node_ptr) {
+        bool found;
+        unsigned pos = _bs_btree_node_search(
+            tree_ptr, node_ptr, key, false, &found);
+
+        if (found && !deleted) {
+            if (NULL != value_ptr_ptr) {
+                *value_ptr_ptr = node_ptr->values_ptr[pos];
+            }
+            deleted = true;
+        }
+
+        if (node_ptr->leaf) {
+            if (found) {
+                unsigned tail = node_ptr->count - pos - 1;
+                memmove(&node_ptr->keys[pos], &node_ptr->keys[pos + 1],
+                        tail * sizeof(uint64_t));
+                memmove(&node_ptr->values_ptr[pos],
+                        &node_ptr->values_ptr[pos + 1],
+                        tail * sizeof(void*));
+                node_ptr->count--;
+            }
+            break;
+        }
+
+        if (!found) {
+            pos = _bs_btree_fill_child(node_ptr, pos);
+            node_ptr = node_ptr->children_ptr[pos];
+            continue;
+        }
+
+        // Found in an internal node: Replace by the predecessor or the
+        // successor, and continue by deleting that one from its leaf.
+        bs_btree_node_t *left_ptr = node_ptr->children_ptr[pos];
+        bs_btree_node_t *right_ptr = node_ptr->children_ptr[pos + 1];
+        if (BS_BTREE_MIN_DEGREE <= left_ptr->count) {
+            bs_btree_node_t *n_ptr = left_ptr;
+            while (!n_ptr->leaf) n_ptr = n_ptr->children_ptr[n_ptr->count];
+            key = n_ptr->keys[n_ptr->count - 1];
+            node_ptr->keys[pos] = key;
+            node_ptr->values_ptr[pos] = n_ptr->values_ptr[n_ptr->count - 1];
+            node_ptr = left_ptr;
+        } else if (BS_BTREE_MIN_DEGREE <= right_ptr->count) {
+            bs_btree_node_t *n_ptr = right_ptr;
+            while (!n_ptr->leaf) n_ptr = n_ptr->children_ptr[0];
+            key = n_ptr->keys[0];
+            node_ptr->keys[pos] = key;
+            node_ptr->values_ptr[pos] = n_ptr->values_ptr[0];
+            node_ptr = right_ptr;
+        } else {
+            _bs_btree_merge_children(node_ptr, pos);
+            node_ptr = left_ptr;
+        }
+    }
+
+    // A merge may have emptied the root, even if `key` was not found:
+    // Shrinks the tree by one level.
+    bs_btree_node_t *root_ptr = tree_ptr->root_ptr;
+    if (NULL != root_ptr && 0 == root_ptr->count) {
+        tree_ptr->root_ptr = root_ptr->leaf ? NULL : root_ptr->children_ptr[0];
+        logged_free(root_ptr);
+    }
+
+    if (!deleted) return false;
+    tree_ptr->size--;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_btree_size(const bs_btree_t *tree_ptr)
+{
+    return tree_ptr->size;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_btree_min(const bs_btree_t *tree_ptr, bs_btree_iterator_t *iter_ptr)
+{
+    iter_ptr->depth = 0;
+    return _bs_btree_iterator_descend(iter_ptr, tree_ptr->root_ptr, false);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_btree_max(const bs_btree_t *tree_ptr, bs_btree_iterator_t *iter_ptr)
+{
+    iter_ptr->depth = 0;
+    return _bs_btree_iterator_descend(iter_ptr, tree_ptr->root_ptr, true);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_btree_lower_bound(const bs_btree_t *tree_ptr,
+                          uint64_t key,
+                          bs_btree_iterator_t *iter_ptr)
+{
+    return _bs_btree_bound(tree_ptr, key, false, iter_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_btree_upper_bound(const bs_btree_t *tree_ptr,
+                          uint64_t key,
+                          bs_btree_iterator_t *iter_ptr)
+{
+    return _bs_btree_bound(tree_ptr, key, true, iter_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_btree_iterator_next(bs_btree_iterator_t *iter_ptr)
+{
+    if (0 == iter_ptr->depth) return false;
+
+    // In an internal node, the next key is the smallest of the right child.
+    unsigned level = iter_ptr->depth - 1;
+    bs_btree_node_t *node_ptr = iter_ptr->nodes_ptr[level];
+    if (!node_ptr->leaf) {
+        unsigned pos = ++iter_ptr->pos[level];
+        return _bs_btree_iterator_descend(
+            iter_ptr, node_ptr->children_ptr[pos], false);
+    }
+
+    if (iter_ptr->pos[level] + 1 < node_ptr->count) {
+        iter_ptr->pos[level]++;
+        return true;
+    }
+
+    // Past the leaf's end: Ascends to the first ancestor with a key to the
+    // right of the child we came from. Its position is that of the key.
+    while (0 < --iter_ptr->depth) {
+        level = iter_ptr->depth - 1;
+        if (iter_ptr->pos[level] < iter_ptr->nodes_ptr[level]->count) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_btree_iterator_prev(bs_btree_iterator_t *iter_ptr)
+{
+    if (0 == iter_ptr->depth) return false;
+
+    // In an internal node, the previous key is the largest of the left child.
+    unsigned level = iter_ptr->depth - 1;
+    bs_btree_node_t *node_ptr = iter_ptr->nodes_ptr[level];
+    if (!node_ptr->leaf) {
+        return _bs_btree_iterator_descend(
+            iter_ptr, node_ptr->children_ptr[iter_ptr->pos[level]], true);
+    }
+
+    if (0 < iter_ptr->pos[level]) {
+        iter_ptr->pos[level]--;
+        return true;
+    }
+
+    // Before the leaf's start: Ascends to the first ancestor with a key to
+    // the left of the child we came from.
+    while (0 < --iter_ptr->depth) {
+        level = iter_ptr->depth - 1;
+        if (0 < iter_ptr->pos[level]) {
+            iter_ptr->pos[level]--;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t bs_btree_iterator_key(const bs_btree_iterator_t *iter_ptr)
+{
+    unsigned level = iter_ptr->depth - 1;
+    return iter_ptr->nodes_ptr[level]->keys[iter_ptr->pos[level]];
+}
+
+/* ------------------------------------------------------------------------- */
+void *bs_btree_iterator_value(const bs_btree_iterator_t *iter_ptr)
+{
+    unsigned level = iter_ptr->depth - 1;
+    return iter_ptr->nodes_ptr[level]->values_ptr[iter_ptr->pos[level]];
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Allocates a node. Leaf nodes are allocated without children. */
+bs_btree_node_t *_bs_btree_node_create(bool leaf)
+{
+    size_t size = sizeof(bs_btree_node_t);
+    if (!leaf) size += (BS_BTREE_MAX_KEYS + 1) * sizeof(bs_btree_node_t*);
+    bs_btree_node_t *node_ptr = logged_malloc(size);
+    if (NULL == node_ptr) return NULL;
+    node_ptr->count = 0;
+    node_ptr->leaf = leaf;
+    return node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Destroys the node, its subtree and their keys and values. */
+void _bs_btree_node_destroy(bs_btree_t *tree_ptr, bs_btree_node_t *node_ptr)
+{
+    // Recursion is bound by BS_BTREE_MAX_HEIGHT.
+    if (!node_ptr->leaf) {
+        for (unsigned i = 0; i <= node_ptr->count; ++i) {
+            _bs_btree_node_destroy(tree_ptr, node_ptr->children_ptr[i]);
+        }
+    }
+    if (NULL != tree_ptr->destroy) {
+        for (unsigned i = 0; i < node_ptr->count; ++i) {
+            tree_ptr->destroy(node_ptr->keys[i], node_ptr->values_ptr[i]);
+        }
+    }
+    logged_free(node_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Compares two keys, with the tree's comparator or as integers. */
+int _bs_btree_cmp(const bs_btree_t *tree_ptr, uint64_t key1, uint64_t key2)
+{
+    if (NULL != tree_ptr->cmp) return tree_ptr->cmp(key1, key2);
+    return (key1 > key2) - (key1 < key2);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Searches `key` among the keys of `node_ptr`.
+ *
+ * Does a branch-free binary search. Without a comparator, the comparisons
+ * are inline and compile to conditional moves.
+ *
+ * @param tree_ptr
+ * @param node_ptr
+ * @param key
+ * @param upper               Whether to find the first key greater than
+ *                            `key`, rather than the first not less.
+ * @param found_ptr           Set to whether the key at the returned position
+ *                            equals `key`. Always false if `upper`.
+ *
+ * @return Position of the first key not less than (or, if `upper`: greater
+ *     than) `key`. This is `count`, if all keys are less.
+ */
+unsigned _bs_btree_node_search(const bs_btree_t *tree_ptr,
+                               const bs_btree_node_t *node_ptr,
+                               uint64_t key,
+                               bool upper,
+                               bool *found_ptr)
+{
+    const uint64_t *base_ptr = node_ptr->keys;
+    unsigned n = node_ptr->count;
+    unsigned pos;
+    *found_ptr = false;
+    if (0 == n) return 0;
+
+    if (NULL == tree_ptr->cmp) {
+        if (upper) {
+            while (1 < n) {
+                unsigned half = n / 2;
+                base_ptr = (base_ptr[half] <= key) ? base_ptr + half : base_ptr;
+                n -= half;
+            }
+            return (base_ptr - node_ptr->keys) + (*base_ptr <= key);
+        }
+        while (1 < n) {
+            unsigned half = n / 2;
+            base_ptr = (base_ptr[half] < key) ? base_ptr + half : base_ptr;
+            n -= half;
+        }
+        pos = (base_ptr - node_ptr->keys) + (*base_ptr < key);
+        *found_ptr = pos < node_ptr->count && node_ptr->keys[pos] == key;
+        return pos;
+    }
+
+    // With a functor: Sets `limit` such that `cmp <= limit` means "before".
+    const int limit = upper ? 0 : -1;
+    while (1 < n) {
+        unsigned half = n / 2;
+        if (tree_ptr->cmp(base_ptr[half], key) <= limit) base_ptr += half;
+        n -= half;
+    }
+    pos = base_ptr - node_ptr->keys;
+    if (tree_ptr->cmp(*base_ptr, key) <= limit) ++pos;
+    *found_ptr = (!upper && pos < node_ptr->count &&
+                  0 == tree_ptr->cmp(node_ptr->keys[pos], key));
+    return pos;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Splits the full child at `pos` of `node_ptr` into two, and moves its
+ * median key into `node_ptr`. `node_ptr` must not be full.
+ *
+ * @return false on allocation failure, with the tree unchanged.
+ */
+bool _bs_btree_split_child(bs_btree_node_t *node_ptr, unsigned pos)
+{
+    const unsigned t = BS_BTREE_MIN_DEGREE;
+    bs_btree_node_t *child_ptr = node_ptr->children_ptr[pos];
+    bs_btree_node_t *new_ptr = _bs_btree_node_create(child_ptr->leaf);
+    if (NULL == new_ptr) return false;
+
+    // The upper t - 1 keys, and their t children, go to the new node.
+    new_ptr->count = t - 1;
+    memcpy(new_ptr->keys, &child_ptr->keys[t], (t - 1) * sizeof(uint64_t));
+    memcpy(new_ptr->values_ptr, &child_ptr->values_ptr[t],
+           (t - 1) * sizeof(void*));
+    if (!child_ptr->leaf) {
+        memcpy(new_ptr->children_ptr, &child_ptr->children_ptr[t],
+               t * sizeof(bs_btree_node_t*));
+    }
+    child_ptr->count = t - 1;
+
+    unsigned tail = node_ptr->count - pos;
+    memmove(&node_ptr->keys[pos + 1], &node_ptr->keys[pos],
+            tail * sizeof(uint64_t));
+    memmove(&node_ptr->values_ptr[pos + 1], &node_ptr->values_ptr[pos],
+            tail * sizeof(void*));
+    memmove(&node_ptr->children_ptr[pos + 2], &node_ptr->children_ptr[pos + 1],
+            tail * sizeof(bs_btree_node_t*));
+    node_ptr->keys[pos] = child_ptr->keys[t - 1];
+    node_ptr->values_ptr[pos] = child_ptr->values_ptr[t - 1];
+    node_ptr->children_ptr[pos + 1] = new_ptr;
+    node_ptr->count++;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Merges the children at `pos` and `pos + 1` of `node_ptr`, together with
+ * the key at `pos` between them, into the child at `pos`.
+ */
+void _bs_btree_merge_children(bs_btree_node_t *node_ptr, unsigned pos)
+{
+    bs_btree_node_t *left_ptr = node_ptr->children_ptr[pos];
+    bs_btree_node_t *right_ptr = node_ptr->children_ptr[pos + 1];
+    unsigned l = left_ptr->count;
+
+    left_ptr->keys[l] = node_ptr->keys[pos];
+    left_ptr->values_ptr[l] = node_ptr->values_ptr[pos];
+    memcpy(&left_ptr->keys[l + 1], right_ptr->keys,
+           right_ptr->count * sizeof(uint64_t));
+    memcpy(&left_ptr->values_ptr[l + 1], right_ptr->values_ptr,
+           right_ptr->count * sizeof(void*));
+    if (!left_ptr->leaf) {
+        memcpy(&left_ptr->children_ptr[l + 1], right_ptr->children_ptr,
+               (right_ptr->count + 1) * sizeof(bs_btree_node_t*));
+    }
+    left_ptr->count += right_ptr->count + 1;
+    logged_free(right_ptr);
+
+    unsigned tail = node_ptr->count - pos - 1;
+    memmove(&node_ptr->keys[pos], &node_ptr->keys[pos + 1],
+            tail * sizeof(uint64_t));
+    memmove(&node_ptr->values_ptr[pos], &node_ptr->values_ptr[pos + 1],
+            tail * sizeof(void*));
+    memmove(&node_ptr->children_ptr[pos + 1], &node_ptr->children_ptr[pos + 2],
+            tail * sizeof(bs_btree_node_t*));
+    node_ptr->count--;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Ensures the child at `pos` of `node_ptr` has at least
+ * @ref BS_BTREE_MIN_DEGREE keys, by borrowing a key from a sibling, or by
+ * merging with a sibling.
+ *
+ * @return The position of the child holding the keys of the former child
+ *     at `pos`. Differs from `pos` if merged with the left sibling.
+ */
+unsigned _bs_btree_fill_child(bs_btree_node_t *node_ptr, unsigned pos)
+{
+    bs_btree_node_t *child_ptr = node_ptr->children_ptr[pos];
+    if (BS_BTREE_MIN_DEGREE <= child_ptr->count) return pos;
+
+    bs_btree_node_t *left_ptr = NULL, *right_ptr = NULL;
+    if (0 < pos) left_ptr = node_ptr->children_ptr[pos - 1];
+    if (pos < node_ptr->count) right_ptr = node_ptr->children_ptr[pos + 1];
+
+    if (NULL != left_ptr && BS_BTREE_MIN_DEGREE <= left_ptr->count) {
+        // Rotates right: The separator comes down, left's last key goes up.
+        memmove(&child_ptr->keys[1], child_ptr->keys,
+                child_ptr->count * sizeof(uint64_t));
+        memmove(&child_ptr->values_ptr[1], child_ptr->values_ptr,
+                child_ptr->count * sizeof(void*));
+        child_ptr->keys[0] = node_ptr->keys[pos - 1];
+        child_ptr->values_ptr[0] = node_ptr->values_ptr[pos - 1];
+        if (!child_ptr->leaf) {
+            memmove(&child_ptr->children_ptr[1], child_ptr->children_ptr,
+                    (child_ptr->count + 1) * sizeof(bs_btree_node_t*));
+            child_ptr->children_ptr[0] =
+                left_ptr->children_ptr[left_ptr->count];
+        }
+        child_ptr->count++;
+        left_ptr->count--;
+        node_ptr->keys[pos - 1] = left_ptr->keys[left_ptr->count];
+        node_ptr->values_ptr[pos - 1] = left_ptr->values_ptr[left_ptr->count];
+        return pos;
+    }
+
+    if (NULL != right_ptr && BS_BTREE_MIN_DEGREE <= right_ptr->count) {
+        // Rotates left: The separator comes down, right's first key goes up.
+        child_ptr->keys[child_ptr->count] = node_ptr->keys[pos];
+        child_ptr->values_ptr[child_ptr->count] = node_ptr->values_ptr[pos];
+        if (!child_ptr->leaf) {
+            child_ptr->children_ptr[child_ptr->count + 1] =
+                right_ptr->children_ptr[0];
+            memmove(right_ptr->children_ptr, &right_ptr->children_ptr[1],
+                    right_ptr->count * sizeof(bs_btree_node_t*));
+        }
+        child_ptr->count++;
+        node_ptr->keys[pos] = right_ptr->keys[0];
+        node_ptr->values_ptr[pos] = right_ptr->values_ptr[0];
+        right_ptr->count--;
+        memmove(right_ptr->keys, &right_ptr->keys[1],
+                right_ptr->count * sizeof(uint64_t));
+        memmove(right_ptr->values_ptr, &right_ptr->values_ptr[1],
+                right_ptr->count * sizeof(void*));
+        return pos;
+    }
+
+    if (NULL != right_ptr) {
+        _bs_btree_merge_children(node_ptr, pos);
+        return pos;
+    }
+    _bs_btree_merge_children(node_ptr, pos - 1);
+    return pos - 1;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Implements @ref bs_btree_lower_bound and @ref bs_btree_upper_bound. */
+bool _bs_btree_bound(const bs_btree_t *tree_ptr,
+                     uint64_t key,
+                     bool upper,
+                     bs_btree_iterator_t *iter_ptr)
+{
+    iter_ptr->depth = 0;
+    bs_btree_node_t *node_ptr = tree_ptr->root_ptr;
+    while (NULL != node_ptr) {
+        bool found;
+        unsigned pos = _bs_btree_node_search(
+            tree_ptr, node_ptr, key, upper, &found);
+        iter_ptr->nodes_ptr[iter_ptr->depth] = node_ptr;
+        iter_ptr->pos[iter_ptr->depth] = pos;
+        iter_ptr->depth++;
+        if (found) return true;
+
+        if (node_ptr->leaf) {
+            if (pos < node_ptr->count) return true;
+            // All keys of the leaf are less: Continues at the last, to
+            // ascend to the next greater key.
+            iter_ptr->pos[iter_ptr->depth - 1] = pos - 1;
+            return bs_btree_iterator_next(iter_ptr);
+        }
+        node_ptr = node_ptr->children_ptr[pos];
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Descends from `node_ptr` to its smallest or its greatest key, and appends
+ * the path to `iter_ptr`.
+ *
+ * @return false if `node_ptr` is NULL or empty.
+ */
+bool _bs_btree_iterator_descend(bs_btree_iterator_t *iter_ptr,
+                                bs_btree_node_t *node_ptr,
+                                bool rightmost)
+{
+    if (NULL == node_ptr || 0 == node_ptr->count) return false;
+    for (;;) {
+        unsigned pos = rightmost ? node_ptr->count : 0;
+        iter_ptr->nodes_ptr[iter_ptr->depth] = node_ptr;
+        if (node_ptr->leaf) {
+            iter_ptr->pos[iter_ptr->depth++] = rightmost ? pos - 1 : pos;
+            return true;
+        }
+        iter_ptr->pos[iter_ptr->depth++] = pos;
+        node_ptr = node_ptr->children_ptr[pos];
+    }
+}
+
+/* == Unit tests =========================================================== */
+/** @cond TEST */
+
+static void test_basic(bs_test_t *test_ptr);
+static void test_iterate(bs_test_t *test_ptr);
+static void test_random(bs_test_t *test_ptr);
+static void test_cmp(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_btree_test_cases[] = {
+    { 1, "basic", test_basic },
+    { 1, "iterate", test_iterate },
+    { 1, "random", test_random },
+    { 1, "cmp", test_cmp },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Verifies the subtree at `node_ptr`: Ordering, fill and depth.
+ *
+ * @return Number of keys in the subtree.
+ */
+static size_t _test_verify_node(bs_test_t *test_ptr,
+                                const bs_btree_t *tree_ptr,
+                                const bs_btree_node_t *node_ptr,
+                                const uint64_t *min_ptr,
+                                const uint64_t *max_ptr,
+                                unsigned depth,
+                                unsigned *leaf_depth_ptr)
+{
+    if (node_ptr != tree_ptr->root_ptr &&
+        node_ptr->count < BS_BTREE_MIN_DEGREE - 1) {
+        BS_TEST_FAIL(test_ptr, "Node %p under-full: %u keys",
+                     node_ptr, node_ptr->count);
+    }
+    for (unsigned i = 0; i < node_ptr->count; ++i) {
+        uint64_t k = node_ptr->keys[i];
+        if ((0 < i && 0 <= _bs_btree_cmp(tree_ptr, node_ptr->keys[i - 1], k)) ||
+            (NULL != min_ptr && 0 <= _bs_btree_cmp(tree_ptr, *min_ptr, k)) ||
+            (NULL != max_ptr && 0 <= _bs_btree_cmp(tree_ptr, k, *max_ptr))) {
+            BS_TEST_FAIL(test_ptr, "Node %p: Key %u out of order", node_ptr, i);
+        }
+    }
+
+    if (node_ptr->leaf) {
+        if (UINT_MAX == *leaf_depth_ptr) *leaf_depth_ptr = depth;
+        if (depth != *leaf_depth_ptr) {
+            BS_TEST_FAIL(test_ptr, "Leaf %p at depth %u, expected %u",
+                         node_ptr, depth, *leaf_depth_ptr);
+        }
+        return node_ptr->count;
+    }
+
+    size_t size = node_ptr->count;
+    for (unsigned i = 0; i <= node_ptr->count; ++i) {
+        size += _test_verify_node(
+            test_ptr, tree_ptr, node_ptr->children_ptr[i],
+            0 < i ? &node_ptr->keys[i - 1] : min_ptr,
+            i < node_ptr->count ? &node_ptr->keys[i] : max_ptr,
+            depth + 1, leaf_depth_ptr);
+    }
+    return size;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the tree's structure. */
+static void _test_verify(bs_test_t *test_ptr, const bs_btree_t *tree_ptr)
+{
+    size_t size = 0;
+    if (NULL != tree_ptr->root_ptr) {
+        unsigned leaf_depth = UINT_MAX;
+        BS_TEST_VERIFY_NEQ(test_ptr, 0, tree_ptr->root_ptr->count);
+        size = _test_verify_node(test_ptr, tree_ptr, tree_ptr->root_ptr,
+                                 NULL, NULL, 0, &leaf_depth);
+        BS_TEST_VERIFY_TRUE(test_ptr, leaf_depth < BS_BTREE_MAX_HEIGHT);
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, tree_ptr->size, size);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Inserts, looks up, overwrites and deletes a few keys. */
+void test_basic(bs_test_t *test_ptr)
+{
+    bs_btree_t *tree_ptr = bs_btree_create(NULL, NULL);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, tree_ptr);
+
+    void *value_ptr = NULL;
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_btree_lookup(tree_ptr, 1, &value_ptr));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_btree_delete(tree_ptr, 1, NULL));
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_insert(tree_ptr, 1, "one", false));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_insert(tree_ptr, 2, "two", false));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_insert(tree_ptr, 0, NULL, false));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_btree_insert(tree_ptr, 1, "x", false));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_insert(
+                            tree_ptr, UINT64_MAX, "max", false));
+    BS_TEST_VERIFY_EQ(test_ptr, 4, bs_btree_size(tree_ptr));
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_lookup(tree_ptr, 1, &value_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, "one", value_ptr);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_lookup(tree_ptr, 0, NULL));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_lookup(
+                            tree_ptr, UINT64_MAX, &value_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, "max", value_ptr);
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_insert(tree_ptr, 1, "uno", true));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_lookup(tree_ptr, 1, &value_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, "uno", value_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 4, bs_btree_size(tree_ptr));
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_delete(tree_ptr, 2, &value_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, "two", value_ptr);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_btree_lookup(tree_ptr, 2, NULL));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_btree_size(tree_ptr));
+    _test_verify(test_ptr, tree_ptr);
+
+    bs_btree_flush(tree_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_btree_size(tree_ptr));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_btree_lookup(tree_ptr, 0, NULL));
+    bs_btree_destroy(tree_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Walks the tree in both directions, and from bounds. */
+void test_iterate(bs_test_t *test_ptr)
+{
+    bs_btree_t *tree_ptr = bs_btree_create(NULL, NULL);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, tree_ptr);
+    bs_btree_iterator_t iter;
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_btree_min(tree_ptr, &iter));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_btree_iterator_valid(&iter));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_btree_lower_bound(tree_ptr, 0, &iter));
+
+    // Even keys 0, 2, ... 3998: Enough for 3 levels.
+    const uint64_t n = 2000;
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t k = ((i * 7919) % n) * 2;
+        void *value_ptr = (void*)(uintptr_t)(k + 1);
+        BS_TEST_VERIFY_TRUE_OR_RETURN(
+            test_ptr, bs_btree_insert(tree_ptr, k, value_ptr, false));
+    }
+    _test_verify(test_ptr, tree_ptr);
+
+    uint64_t expected = 0;
+    for (bool v = bs_btree_min(tree_ptr, &iter); v;
+         v = bs_btree_iterator_next(&iter)) {
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, expected, bs_btree_iterator_key(&iter));
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, (void*)(uintptr_t)(expected + 1),
+            bs_btree_iterator_value(&iter));
+        expected += 2;
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 2 * n, expected);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_btree_iterator_valid(&iter));
+
+    for (bool v = bs_btree_max(tree_ptr, &iter); v;
+         v = bs_btree_iterator_prev(&iter)) {
+        expected -= 2;
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, expected, bs_btree_iterator_key(&iter));
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 0, expected);
+
+    // Bounds, at every key and between keys, then moving either way.
+    for (uint64_t k = 0; k < 2 * n + 2; ++k) {
+        bool l = bs_btree_lower_bound(tree_ptr, k, &iter);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, k < 2 * n - 1, l);
+        if (l) {
+            uint64_t e = (k + 1) & ~1;
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, e, bs_btree_iterator_key(&iter));
+            if (bs_btree_iterator_prev(&iter)) {
+                BS_TEST_VERIFY_EQ_OR_RETURN(
+                    test_ptr, e - 2, bs_btree_iterator_key(&iter));
+                BS_TEST_VERIFY_TRUE_OR_RETURN(
+                    test_ptr, bs_btree_iterator_next(&iter));
+                BS_TEST_VERIFY_EQ_OR_RETURN(
+                    test_ptr, e, bs_btree_iterator_key(&iter));
+            } else {
+                BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 0, e);
+            }
+        }
+
+        bool u = bs_btree_upper_bound(tree_ptr, k, &iter);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, k < 2 * n - 2, u);
+        if (u) {
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, (k + 2) & ~1, bs_btree_iterator_key(&iter));
+        }
+    }
+    bs_btree_destroy(tree_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Random inserts and deletes, verified against a bitmap. */
+void test_random(bs_test_t *test_ptr)
+{
+    bs_btree_t *tree_ptr = bs_btree_create(NULL, NULL);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, tree_ptr);
+
+    bool present[4096] = {};
+    size_t size = 0;
+    uint32_t seed = 1;
+    for (int i = 0; i < 40000; ++i) {
+        seed = seed * 1664525 + 1013904223;
+        uint64_t k = (seed >> 8) % 4096;
+        // Grows first, then shrinks: Exercises splits, then merges.
+        bool insert = (seed >> 30) < (i < 20000 ? 3u : 1u);
+        if (insert) {
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, !present[k],
+                bs_btree_insert(tree_ptr, k, (void*)(uintptr_t)k, false));
+            if (!present[k]) ++size;
+            present[k] = true;
+        } else {
+            void *value_ptr = NULL;
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, present[k],
+                bs_btree_delete(tree_ptr, k, &value_ptr));
+            if (present[k]) {
+                BS_TEST_VERIFY_EQ_OR_RETURN(
+                    test_ptr, (void*)(uintptr_t)k, value_ptr);
+                --size;
+            }
+            present[k] = false;
+        }
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, size, bs_btree_size(tree_ptr));
+        if (0 == i % 1000) _test_verify(test_ptr, tree_ptr);
+    }
+    _test_verify(test_ptr, tree_ptr);
+
+    bs_btree_iterator_t iter;
+    bool v = bs_btree_min(tree_ptr, &iter);
+    for (uint64_t k = 0; k < 4096; ++k) {
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, present[k], bs_btree_lookup(tree_ptr, k, NULL));
+        if (!present[k]) continue;
+        BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, v);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, k, bs_btree_iterator_key(&iter));
+        v = bs_btree_iterator_next(&iter);
+    }
+    BS_TEST_VERIFY_FALSE(test_ptr, v);
+
+    // Deletes all remaining, down to an empty tree.
+    for (uint64_t k = 0; k < 4096; ++k) {
+        if (present[k]) bs_btree_delete(tree_ptr, k, NULL);
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_btree_size(tree_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, tree_ptr->root_ptr);
+    bs_btree_destroy(tree_ptr);
+}
+
+/** Counts calls to @ref _test_destroy. */
+static int                    _test_destroyed;
+
+/* ------------------------------------------------------------------------- */
+/** Compares keys as pointers to strings. */
+static int _test_strcmp(uint64_t key1, uint64_t key2)
+{
+    return strcmp((const char*)(uintptr_t)key1, (const char*)(uintptr_t)key2);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Destroys the value, which is also the key. */
+static void _test_destroy(__UNUSED__ uint64_t key, void *value_ptr)
+{
+    logged_free(value_ptr);
+    ++_test_destroyed;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Inserts a copy of `str_ptr` into `tree_ptr`, as key and as value. */
+static bool _test_insert_str(bs_btree_t *tree_ptr,
+                             const char *str_ptr,
+                             bool do_overwrite)
+{
+    char *s_ptr = logged_strdup(str_ptr);
+    if (NULL == s_ptr) return false;
+    if (bs_btree_insert(tree_ptr, (uintptr_t)s_ptr, s_ptr, do_overwrite)) {
+        return true;
+    }
+    logged_free(s_ptr);
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the key at `iter_ptr`, as a string. */
+static const char *_test_iterator_str(const bs_btree_iterator_t *iter_ptr)
+{
+    return (const char*)(uintptr_t)bs_btree_iterator_key(iter_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Uses string keys, with a comparator and a destroy functor. */
+void test_cmp(bs_test_t *test_ptr)
+{
+    bs_btree_t *tree_ptr = bs_btree_create(_test_strcmp, _test_destroy);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, tree_ptr);
+    _test_destroyed = 0;
+
+    char buf[16];
+    for (int i = 0; i < 500; ++i) {
+        snprintf(buf, sizeof(buf), "key%03d", (i * 37) % 500);
+        BS_TEST_VERIFY_TRUE_OR_RETURN(
+            test_ptr, _test_insert_str(tree_ptr, buf, false));
+    }
+    _test_verify(test_ptr, tree_ptr);
+    BS_TEST_VERIFY_FALSE(test_ptr, _test_insert_str(tree_ptr, "key123", false));
+
+    // Overwriting destroys the former key and value.
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_insert_str(tree_ptr, "key123", true));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, _test_destroyed);
+    BS_TEST_VERIFY_EQ(test_ptr, 500, bs_btree_size(tree_ptr));
+
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_btree_lookup(tree_ptr, (uintptr_t)"key042", NULL));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_btree_lookup(tree_ptr, (uintptr_t)"key042a", NULL));
+
+    bs_btree_iterator_t iter;
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_btree_upper_bound(tree_ptr, (uintptr_t)"key042", &iter));
+    BS_TEST_VERIFY_STREQ(test_ptr, "key043", _test_iterator_str(&iter));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_btree_lower_bound(tree_ptr, (uintptr_t)"key04", &iter));
+    BS_TEST_VERIFY_STREQ(test_ptr, "key040", _test_iterator_str(&iter));
+
+    // Deleting does not destroy: The value is returned to the caller.
+    void *value_ptr = NULL;
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_btree_delete(tree_ptr, (uintptr_t)"key007", &value_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, "key007", value_ptr);
+    logged_free(value_ptr);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_btree_lower_bound(
+                            tree_ptr, (uintptr_t)"key007", &iter));
+    BS_TEST_VERIFY_STREQ(test_ptr, "key008", _test_iterator_str(&iter));
+    _test_verify(test_ptr, tree_ptr);
+
+    bs_btree_destroy(tree_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 500, _test_destroyed);
+}
+
+/** @endcond */
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_lookup(bs_test_t *test_ptr);
+static void benchmark_iterate(bs_test_t *test_ptr);
+static void benchmark_insert_delete(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_btree_benchmarks[] = {
+    { 1, "benchmark-lookup", benchmark_lookup },
+    { 1, "benchmark-iterate", benchmark_iterate },
+    { 1, "benchmark-insert-delete", benchmark_insert_delete },
+    { 0, NULL, NULL }
+};
+
+/** Number of keys in the benchmarks' trees. */
+#define _BENCHMARK_KEYS       (1 << 20)
+
+/** An element of the AVL tree. */
+typedef struct {
+    /** The tree node. */
+    bs_avltree_node_t         avlnode;
+    /** The key. */
+    uint64_t                  key;
+} _benchmark_elem_t;
+
+/** A B-tree, with and without comparator, and an AVL tree, same keys. */
+typedef struct {
+    /** The keys, in random order. */
+    uint64_t                  *keys_ptr;
+    /** Elements of the AVL tree. */
+    _benchmark_elem_t         *elems_ptr;
+    /** The AVL tree. */
+    bs_avltree_t              *avltree_ptr;
+    /** B-tree, comparing keys inline. */
+    bs_btree_t                *btree_ptr;
+    /** B-tree, comparing keys through a functor. */
+    bs_btree_t                *btree_cmp_ptr;
+    /** Position in `keys_ptr`, for the next operation. */
+    size_t                    pos;
+} _benchmark_trees_t;
+
+/* ------------------------------------------------------------------------- */
+static int _benchmark_avltree_cmp(const bs_avltree_node_t *node_ptr,
+                                  const void *key_ptr)
+{
+    const _benchmark_elem_t *elem_ptr = BS_CONTAINER_OF(
+        node_ptr, const _benchmark_elem_t, avlnode);
+    uint64_t key = *(const uint64_t*)key_ptr;
+    return (elem_ptr->key > key) - (elem_ptr->key < key);
+}
+
+/* ------------------------------------------------------------------------- */
+static int _benchmark_btree_cmp(uint64_t key1, uint64_t key2)
+{
+    return (key1 > key2) - (key1 < key2);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Creates all trees, with @ref _BENCHMARK_KEYS random keys. */
+static bool _benchmark_trees_init(_benchmark_trees_t *t_ptr)
+{
+    *t_ptr = (_benchmark_trees_t){};
+    t_ptr->keys_ptr = logged_calloc(_BENCHMARK_KEYS, sizeof(uint64_t));
+    t_ptr->elems_ptr = logged_calloc(_BENCHMARK_KEYS,
+                                     sizeof(_benchmark_elem_t));
+    t_ptr->avltree_ptr = bs_avltree_create(_benchmark_avltree_cmp, NULL);
+    t_ptr->btree_ptr = bs_btree_create(NULL, NULL);
+    t_ptr->btree_cmp_ptr = bs_btree_create(_benchmark_btree_cmp, NULL);
+    if (NULL == t_ptr->keys_ptr || NULL == t_ptr->elems_ptr ||
+        NULL == t_ptr->avltree_ptr || NULL == t_ptr->btree_ptr ||
+        NULL == t_ptr->btree_cmp_ptr) return false;
+
+    uint64_t seed = 1;
+    for (size_t i = 0; i < _BENCHMARK_KEYS; ++i) {
+        // A full-period 64-bit LCG: The keys are distinct.
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t key = seed;
+        t_ptr->keys_ptr[i] = key;
+        t_ptr->elems_ptr[i].key = key;
+        if (!bs_avltree_insert(t_ptr->avltree_ptr, &t_ptr->elems_ptr[i].key,
+                               &t_ptr->elems_ptr[i].avlnode, false) ||
+            !bs_btree_insert(t_ptr->btree_ptr, key, NULL, false) ||
+            !bs_btree_insert(t_ptr->btree_cmp_ptr, key, NULL, false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Releases what @ref _benchmark_trees_init created. */
+static void _benchmark_trees_fini(_benchmark_trees_t *t_ptr)
+{
+    if (NULL != t_ptr->btree_cmp_ptr) bs_btree_destroy(t_ptr->btree_cmp_ptr);
+    if (NULL != t_ptr->btree_ptr) bs_btree_destroy(t_ptr->btree_ptr);
+    if (NULL != t_ptr->avltree_ptr) bs_avltree_destroy(t_ptr->avltree_ptr);
+    logged_free(t_ptr->elems_ptr);
+    logged_free(t_ptr->keys_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_lookup_btree_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_trees_t *t_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint64_t key = t_ptr->keys_ptr[t_ptr->pos++ & (_BENCHMARK_KEYS - 1)];
+        bool found = bs_btree_lookup(t_ptr->btree_ptr, key, NULL);
+        BS_TEST_DO_NOT_OPTIMIZE(found);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_lookup_btree_cmp_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_trees_t *t_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint64_t key = t_ptr->keys_ptr[t_ptr->pos++ & (_BENCHMARK_KEYS - 1)];
+        bool found = bs_btree_lookup(t_ptr->btree_cmp_ptr, key, NULL);
+        BS_TEST_DO_NOT_OPTIMIZE(found);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_lookup_avltree_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_trees_t *t_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint64_t key = t_ptr->keys_ptr[t_ptr->pos++ & (_BENCHMARK_KEYS - 1)];
+        bs_avltree_node_t *node_ptr = bs_avltree_lookup(
+            t_ptr->avltree_ptr, &key);
+        BS_TEST_DO_NOT_OPTIMIZE(node_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_iterate_btree_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_trees_t *t_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_btree_iterator_t iter;
+        uint64_t sum = 0;
+        for (bool v = bs_btree_min(t_ptr->btree_ptr, &iter); v;
+             v = bs_btree_iterator_next(&iter)) {
+            sum += bs_btree_iterator_key(&iter);
+        }
+        BS_TEST_DO_NOT_OPTIMIZE(sum);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_iterate_avltree_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_trees_t *t_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint64_t sum = 0;
+        for (bs_avltree_node_t *node_ptr = bs_avltree_min(t_ptr->avltree_ptr);
+             NULL != node_ptr;
+             node_ptr = bs_avltree_node_next(t_ptr->avltree_ptr, node_ptr)) {
+            _benchmark_elem_t *elem_ptr = BS_CONTAINER_OF(
+                node_ptr, _benchmark_elem_t, avlnode);
+            sum += elem_ptr->key;
+        }
+        BS_TEST_DO_NOT_OPTIMIZE(sum);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_insert_delete_btree_fn(
+    void *arg_ptr,
+    uint64_t iterations)
+{
+    _benchmark_trees_t *t_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint64_t key = t_ptr->keys_ptr[t_ptr->pos++ & (_BENCHMARK_KEYS - 1)];
+        bs_btree_delete(t_ptr->btree_ptr, key, NULL);
+        bs_btree_insert(t_ptr->btree_ptr, key, NULL, false);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_insert_delete_avltree_fn(
+    void *arg_ptr,
+    uint64_t iterations)
+{
+    _benchmark_trees_t *t_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        _benchmark_elem_t *elem_ptr =
+            &t_ptr->elems_ptr[t_ptr->pos++ & (_BENCHMARK_KEYS - 1)];
+        bs_avltree_delete(t_ptr->avltree_ptr, &elem_ptr->key);
+        bs_avltree_insert(t_ptr->avltree_ptr, &elem_ptr->key,
+                          &elem_ptr->avlnode, false);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Runs the benchmarks `fn1`, `fn2` and, if not NULL, `fn3` on trees. */
+static void _benchmark_run(bs_test_t *test_ptr,
+                           const char *name1_ptr,
+                           bs_test_bench_fn_t fn1,
+                           const char *name2_ptr,
+                           bs_test_bench_fn_t fn2,
+                           const char *name3_ptr,
+                           bs_test_bench_fn_t fn3)
+{
+    _benchmark_trees_t trees;
+    if (!_benchmark_trees_init(&trees)) {
+        BS_TEST_FAIL(test_ptr, "Failed _benchmark_trees_init()");
+    } else if (
+        !bs_test_bench(test_ptr, name1_ptr, fn1, &trees, NULL) ||
+        !bs_test_bench(test_ptr, name2_ptr, fn2, &trees, NULL) ||
+        (NULL != fn3 &&
+         !bs_test_bench(test_ptr, name3_ptr, fn3, &trees, NULL))) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench()");
+    }
+    _benchmark_trees_fini(&trees);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_lookup(bs_test_t *test_ptr)
+{
+    _benchmark_run(test_ptr,
+                   "lookup-1M-btree", _benchmark_lookup_btree_fn,
+                   "lookup-1M-btree-cmp", _benchmark_lookup_btree_cmp_fn,
+                   "lookup-1M-avltree", _benchmark_lookup_avltree_fn);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_iterate(bs_test_t *test_ptr)
+{
+    _benchmark_run(test_ptr,
+                   "iterate-1M-btree", _benchmark_iterate_btree_fn,
+                   "iterate-1M-avltree", _benchmark_iterate_avltree_fn,
+                   NULL, NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_insert_delete(bs_test_t *test_ptr)
+{
+    _benchmark_run(test_ptr,
+                   "insert-delete-1M-btree", _benchmark_insert_delete_btree_fn,
+                   "insert-delete-1M-avltree",
+                   _benchmark_insert_delete_avltree_fn,
+                   NULL, NULL);
+}
+
+/* == End of btree.c ======================================================= */
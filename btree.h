@@ -0,0 +1,221 @@
+/* ========================================================================= */
+/**
+ * @file btree.h
+ * Implements a B-tree, mapping 64-bit keys to values.
+ *
+ * Unlike @ref bs_avltree_t, each node stores up to
+ * @ref BS_BTREE_MAX_KEYS keys contiguously, so that a lookup touches only a
+ * few cache lines per level and the tree is shallow: A million keys fit in
+ * 5 levels. Keys are integers, or pointers cast to uint64_t. Without a
+ * comparator, keys are compared as unsigned integers, inline. With a
+ * comparator, eg. for string keys, it is called for each comparison.
+ *
+ * Iterators of @ref bs_btree_iterator_t walk the keys in order, and are
+ * invalidated by any insert or delete.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_BTREE_H__
+#define __LIBBASE_BTREE_H__
+
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Minimum degree: Each node except the root has at least this - 1 keys. */
+#define BS_BTREE_MIN_DEGREE   16
+/** Maximum number of keys in a node. */
+#define BS_BTREE_MAX_KEYS     (2 * BS_BTREE_MIN_DEGREE - 1)
+/** Maximum height of the tree. Bounds the size to 16^16 keys. */
+#define BS_BTREE_MAX_HEIGHT   16
+
+/** The tree. */
+typedef struct _bs_btree_t bs_btree_t;
+/** A tree node. */
+typedef struct _bs_btree_node_t bs_btree_node_t;
+
+/**
+ * Functor type to compare two keys.
+ *
+ * @param key1
+ * @param key2
+ *
+ * @return
+ * - a negative value if key1 is less than key2
+ * - 0 if key1 equals key2
+ * - a positive value if key1 is greater than key2
+ */
+typedef int (*bs_btree_key_cmp_t)(uint64_t key1, uint64_t key2);
+
+/**
+ * Functor type to destroy a key and value of the tree.
+ *
+ * @param key
+ * @param value_ptr
+ */
+typedef void (*bs_btree_destroy_t)(uint64_t key, void *value_ptr);
+
+/**
+ * Position of a key in the tree, for walking the tree in order.
+ *
+ * Holds the path from the root, so that no node needs a parent pointer.
+ */
+typedef struct {
+    /** Nodes from the root to the current node. */
+    bs_btree_node_t           *nodes_ptr[BS_BTREE_MAX_HEIGHT];
+    /** At each level, the position of the key, or of the child. */
+    unsigned                  pos[BS_BTREE_MAX_HEIGHT];
+    /** Number of levels in `nodes_ptr`. 0 if the iterator is at the end. */
+    unsigned                  depth;
+} bs_btree_iterator_t;
+
+/**
+ * Creates a tree.
+ *
+ * @param cmp                 Optionally, a functor to compare keys. If NULL,
+ *     keys are compared as unsigned integers, without calling a functor.
+ * @param destroy             Optionally, a functor to destroy keys and
+ *     values when overwriting, flushing or destroying the tree.
+ *
+ * @return A pointer to the tree, or NULL on error. Must be destroyed by
+ *     @ref bs_btree_destroy.
+ */
+bs_btree_t *bs_btree_create(bs_btree_key_cmp_t cmp,
+                            bs_btree_destroy_t destroy);
+
+/**
+ * Destroys the tree. Also destroys all remaining keys and values.
+ *
+ * @param tree_ptr
+ */
+void bs_btree_destroy(bs_btree_t *tree_ptr);
+
+/**
+ * Removes all keys from the tree, and destroys them if a destroy functor was
+ * specified.
+ *
+ * @param tree_ptr
+ */
+void bs_btree_flush(bs_btree_t *tree_ptr);
+
+/**
+ * Inserts `key` into the tree, mapped to `value_ptr`.
+ *
+ * @param tree_ptr
+ * @param key
+ * @param value_ptr
+ * @param do_overwrite        Whether to overwrite an already-existing `key`.
+ *     The overwritten key and value will be destroyed, if a destroy functor
+ *     was specified.
+ *
+ * @return Whether the insert succeeded. It fails if `do_overwrite` is false
+ *     and `key` already exists, or on allocation failure.
+ */
+bool bs_btree_insert(bs_btree_t *tree_ptr,
+                     uint64_t key,
+                     void *value_ptr,
+                     bool do_overwrite);
+
+/**
+ * Looks up `key` in the tree.
+ *
+ * @param tree_ptr
+ * @param key
+ * @param value_ptr_ptr       Optional. Stores the value, if found.
+ *
+ * @return Whether `key` was found.
+ */
+bool bs_btree_lookup(const bs_btree_t *tree_ptr,
+                     uint64_t key,
+                     void **value_ptr_ptr);
+
+/**
+ * Deletes `key` from the tree. Does NOT destroy the key and value.
+ *
+ * @param tree_ptr
+ * @param key
+ * @param value_ptr_ptr       Optional. Stores the value, if found.
+ *
+ * @return Whether `key` was found and deleted.
+ */
+bool bs_btree_delete(bs_btree_t *tree_ptr,
+                     uint64_t key,
+                     void **value_ptr_ptr);
+
+/** Returns the number of keys in the tree. */
+size_t bs_btree_size(const bs_btree_t *tree_ptr);
+
+/** Sets `iter_ptr` to the smallest key. Returns false if the tree is empty. */
+bool bs_btree_min(const bs_btree_t *tree_ptr, bs_btree_iterator_t *iter_ptr);
+
+/** Sets `iter_ptr` to the greatest key. Returns false if the tree is empty. */
+bool bs_btree_max(const bs_btree_t *tree_ptr, bs_btree_iterator_t *iter_ptr);
+
+/**
+ * Sets `iter_ptr` to the smallest key not less than `key`.
+ *
+ * @return false if there is no such key.
+ */
+bool bs_btree_lower_bound(const bs_btree_t *tree_ptr,
+                          uint64_t key,
+                          bs_btree_iterator_t *iter_ptr);
+
+/**
+ * Sets `iter_ptr` to the smallest key greater than `key`.
+ *
+ * @return false if there is no such key.
+ */
+bool bs_btree_upper_bound(const bs_btree_t *tree_ptr,
+                          uint64_t key,
+                          bs_btree_iterator_t *iter_ptr);
+
+/** Moves to the next-greater key. Returns false if there is none. */
+bool bs_btree_iterator_next(bs_btree_iterator_t *iter_ptr);
+
+/** Moves to the next-smaller key. Returns false if there is none. */
+bool bs_btree_iterator_prev(bs_btree_iterator_t *iter_ptr);
+
+/** Returns whether `iter_ptr` is at a key; false if past either end. */
+static inline bool bs_btree_iterator_valid(
+    const bs_btree_iterator_t *iter_ptr)
+{
+    return 0 < iter_ptr->depth;
+}
+
+/** Returns the key at `iter_ptr`. The iterator must be valid. */
+uint64_t bs_btree_iterator_key(const bs_btree_iterator_t *iter_ptr);
+
+/** Returns the value at `iter_ptr`. The iterator must be valid. */
+void *bs_btree_iterator_value(const bs_btree_iterator_t *iter_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_btree_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_btree_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_BTREE_H__ */
+/* == End of btree.h ======================================================= */
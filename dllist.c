@@ -34,16 +34,7 @@ static bool node_orphaned(const bs_dllist_node_t *dlnode_ptr);
 /* ------------------------------------------------------------------------- */
 size_t bs_dllist_size(const bs_dllist_t *list_ptr)
 {
-    size_t                    count;
-    bs_dllist_node_t          *node_ptr;
-
-    node_ptr = list_ptr->head_ptr;
-    count = 0;
-    while (NULL != node_ptr) {
-        node_ptr = node_ptr->next_ptr;
-        count++;
-    }
-    return count;
+    return list_ptr->size;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -73,6 +64,7 @@ void bs_dllist_push_back(bs_dllist_t *list_ptr, bs_dllist_node_t *node_ptr)
         list_ptr->head_ptr = node_ptr;
         list_ptr->tail_ptr = node_ptr;
     }
+    list_ptr->size++;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -96,6 +88,7 @@ void bs_dllist_push_front(bs_dllist_t *list_ptr, bs_dllist_node_t *node_ptr)
         list_ptr->head_ptr = node_ptr;
         list_ptr->tail_ptr = node_ptr;
     }
+    list_ptr->size++;
 }
 
 
@@ -119,6 +112,7 @@ bs_dllist_node_t *bs_dllist_pop_back(bs_dllist_t *list_ptr)
         list_ptr->head_ptr = NULL;
     }
     node_ptr->prev_ptr = NULL;
+    list_ptr->size--;
     return node_ptr;
 }
 
@@ -143,17 +137,20 @@ bs_dllist_node_t * bs_dllist_pop_front(bs_dllist_t *list_ptr)
     }
 
     node_ptr->next_ptr =  NULL;
+    list_ptr->size--;
     return node_ptr;
 }
 
 /* ------------------------------------------------------------------------- */
 void bs_dllist_remove(bs_dllist_t *list_ptr, bs_dllist_node_t *node_ptr)
 {
-    BS_ASSERT(bs_dllist_contains(list_ptr, node_ptr));
+    // Checks only the neighbours, to keep this O(1).
+    BS_ASSERT(0 < list_ptr->size);
     if (NULL == node_ptr->prev_ptr) {
         BS_ASSERT(list_ptr->head_ptr == node_ptr);
         list_ptr->head_ptr = node_ptr->next_ptr;
     } else {
+        BS_ASSERT(node_ptr->prev_ptr->next_ptr == node_ptr);
         node_ptr->prev_ptr->next_ptr = node_ptr->next_ptr;
     }
 
@@ -161,11 +158,13 @@ void bs_dllist_remove(bs_dllist_t *list_ptr, bs_dllist_node_t *node_ptr)
         BS_ASSERT(list_ptr->tail_ptr == node_ptr);
         list_ptr->tail_ptr = node_ptr->prev_ptr;
     } else {
+        BS_ASSERT(node_ptr->next_ptr->prev_ptr == node_ptr);
         node_ptr->next_ptr->prev_ptr = node_ptr->prev_ptr;
     }
 
     node_ptr->prev_ptr = NULL;
     node_ptr->next_ptr = NULL;
+    list_ptr->size--;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -174,19 +173,59 @@ void bs_dllist_insert_node_before(
     bs_dllist_node_t *reference_node_ptr,
     bs_dllist_node_t *new_node_ptr)
 {
-    BS_ASSERT(bs_dllist_contains(list_ptr, reference_node_ptr));
     BS_ASSERT(node_orphaned(new_node_ptr));
 
     if (NULL == reference_node_ptr->prev_ptr) {
+        BS_ASSERT(list_ptr->head_ptr == reference_node_ptr);
         bs_dllist_push_front(list_ptr, new_node_ptr);
         return;
     }
+    BS_ASSERT(reference_node_ptr->prev_ptr->next_ptr == reference_node_ptr);
 
     reference_node_ptr->prev_ptr->next_ptr = new_node_ptr;
     new_node_ptr->prev_ptr = reference_node_ptr->prev_ptr;
 
     reference_node_ptr->prev_ptr = new_node_ptr;
     new_node_ptr->next_ptr = reference_node_ptr;
+    list_ptr->size++;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_dllist_splice(
+    bs_dllist_t *list_ptr,
+    bs_dllist_node_t *reference_node_ptr,
+    bs_dllist_t *src_list_ptr)
+{
+    BS_ASSERT(list_ptr != src_list_ptr);
+    if (NULL == src_list_ptr->head_ptr) return;
+
+    bs_dllist_node_t *prev_ptr = list_ptr->tail_ptr;
+    if (NULL != reference_node_ptr) prev_ptr = reference_node_ptr->prev_ptr;
+
+    src_list_ptr->head_ptr->prev_ptr = prev_ptr;
+    if (NULL != prev_ptr) {
+        prev_ptr->next_ptr = src_list_ptr->head_ptr;
+    } else {
+        list_ptr->head_ptr = src_list_ptr->head_ptr;
+    }
+
+    src_list_ptr->tail_ptr->next_ptr = reference_node_ptr;
+    if (NULL != reference_node_ptr) {
+        reference_node_ptr->prev_ptr = src_list_ptr->tail_ptr;
+    } else {
+        list_ptr->tail_ptr = src_list_ptr->tail_ptr;
+    }
+
+    list_ptr->size += src_list_ptr->size;
+    src_list_ptr->head_ptr = NULL;
+    src_list_ptr->tail_ptr = NULL;
+    src_list_ptr->size = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_dllist_concat(bs_dllist_t *list_ptr, bs_dllist_t *src_list_ptr)
+{
+    bs_dllist_splice(list_ptr, NULL, src_list_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -231,11 +270,13 @@ void bs_dllist_for_each(
 void assert_consistency(const bs_dllist_t *list_ptr)
 {
     const bs_dllist_node_t *node_ptr;
+    size_t                 count = 0;
 
     // An empty list is consistent if both head/tail are NULL.
     if (NULL == list_ptr->head_ptr || NULL == list_ptr->tail_ptr) {
         BS_ASSERT(NULL == list_ptr->head_ptr);
         BS_ASSERT(NULL == list_ptr->tail_ptr);
+        BS_ASSERT(0 == list_ptr->size);
         return;
     }
 
@@ -251,7 +292,9 @@ void assert_consistency(const bs_dllist_t *list_ptr)
         } else {
             BS_ASSERT(node_ptr == list_ptr->tail_ptr);
         }
+        count++;
     }
+    BS_ASSERT(count == list_ptr->size);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -284,6 +327,7 @@ static void bs_dllist_test_back(bs_test_t *test_ptr);
 static void bs_dllist_test_front(bs_test_t *test_ptr);
 static void bs_dllist_test_remove(bs_test_t *test_ptr);
 static void bs_dllist_test_insert(bs_test_t *test_ptr);
+static void bs_dllist_test_splice(bs_test_t *test_ptr);
 static void bs_dllist_test_find(bs_test_t *test_ptr);
 static void bs_dllist_test_for_each(bs_test_t *test_ptr);
 static void bs_dllist_test_for_each_dtor(bs_test_t *test_ptr);
@@ -293,6 +337,7 @@ const bs_test_case_t          bs_dllist_test_cases[] = {
     { 1, "push/pop front", bs_dllist_test_front },
     { 1, "remove", bs_dllist_test_remove },
     { 1, "insert", bs_dllist_test_insert },
+    { 1, "splice", bs_dllist_test_splice },
     { 1, "find", bs_dllist_test_find },
     { 1, "for_each", bs_dllist_test_for_each },
     { 1, "for_each_dtor", bs_dllist_test_for_each_dtor },
@@ -462,6 +507,59 @@ void bs_dllist_test_insert(bs_test_t *test_ptr)
     BS_TEST_VERIFY_EQ(test_ptr, list.head_ptr, &node2);
     BS_TEST_VERIFY_EQ(test_ptr, node2.next_ptr, &node3);
     BS_TEST_VERIFY_EQ(test_ptr, node3.next_ptr, &node1);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_dllist_size(&list));
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_dllist_test_splice(bs_test_t *test_ptr)
+{
+    bs_dllist_t               list1 = {}, list2 = {};
+    bs_dllist_node_t          n[6] = {};
+
+    // Splicing an empty list is a no-op, into an empty or non-empty list.
+    bs_dllist_concat(&list1, &list2);
+    assert_consistency(&list1);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_dllist_empty(&list1));
+
+    // Concatenating into an empty list: list1 = 0, 1.
+    bs_dllist_push_back(&list2, &n[0]);
+    bs_dllist_push_back(&list2, &n[1]);
+    bs_dllist_concat(&list1, &list2);
+    assert_consistency(&list1);
+    assert_consistency(&list2);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, bs_dllist_size(&list1));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_dllist_empty(&list2));
+    bs_dllist_concat(&list1, &list2);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, bs_dllist_size(&list1));
+
+    // Concatenating to the back: list1 = 0, 1, 5.
+    bs_dllist_push_back(&list2, &n[5]);
+    bs_dllist_concat(&list1, &list2);
+    assert_consistency(&list1);
+    BS_TEST_VERIFY_EQ(test_ptr, &n[5], list1.tail_ptr);
+
+    // Splicing in the middle: list1 = 0, 1, 2, 3, 5.
+    bs_dllist_push_back(&list2, &n[2]);
+    bs_dllist_push_back(&list2, &n[3]);
+    bs_dllist_splice(&list1, &n[5], &list2);
+    assert_consistency(&list1);
+    assert_consistency(&list2);
+    BS_TEST_VERIFY_EQ(test_ptr, 5, bs_dllist_size(&list1));
+    BS_TEST_VERIFY_EQ(test_ptr, &n[2], n[1].next_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, &n[5], n[3].next_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, &n[3], n[5].prev_ptr);
+
+    // Splicing at the front: list1 = 4, 0, 1, 2, 3, 5.
+    bs_dllist_push_back(&list2, &n[4]);
+    bs_dllist_splice(&list1, &n[0], &list2);
+    assert_consistency(&list1);
+    BS_TEST_VERIFY_EQ(test_ptr, 6, bs_dllist_size(&list1));
+    BS_TEST_VERIFY_EQ(test_ptr, &n[4], list1.head_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, &n[0], n[4].next_ptr);
+
+    bs_dllist_remove(&list1, &n[2]);
+    assert_consistency(&list1);
+    BS_TEST_VERIFY_EQ(test_ptr, 5, bs_dllist_size(&list1));
 }
 
 /* ------------------------------------------------------------------------- */
@@ -38,6 +38,8 @@ struct _bs_dllist_t {
     bs_dllist_node_t          *head_ptr;
     /** Tail of the double-linked list. NULL if empty. */
     bs_dllist_node_t          *tail_ptr;
+    /** Number of nodes in the list. */
+    size_t                    size;
 };
 
 /** Details of said node. */
@@ -48,7 +50,7 @@ struct _bs_dllist_node_t {
     bs_dllist_node_t          *next_ptr;
 };
 
-/** Returns the number of elements in |list_ptr|. */
+/** Returns the number of elements in |list_ptr|. O(1). */
 size_t bs_dllist_size(const bs_dllist_t *list_ptr);
 /** Returns whether the list is empty. */
 bool bs_dllist_empty(const bs_dllist_t *list_ptr);
@@ -72,6 +74,23 @@ void bs_dllist_insert_node_before(
     bs_dllist_node_t *reference_node_ptr,
     bs_dllist_node_t *new_node_ptr);
 
+/**
+ * Moves all nodes of |src_list_ptr| into |list_ptr|, before
+ * |reference_node_ptr|. Appends them, if |reference_node_ptr| is NULL.
+ * |src_list_ptr| will be empty afterwards. O(1).
+ *
+ * @param list_ptr
+ * @param reference_node_ptr  A node of |list_ptr|, or NULL.
+ * @param src_list_ptr        Must be different from |list_ptr|.
+ */
+void bs_dllist_splice(
+    bs_dllist_t *list_ptr,
+    bs_dllist_node_t *reference_node_ptr,
+    bs_dllist_t *src_list_ptr);
+
+/** Moves all nodes of |src_list_ptr| to the back of |list_ptr|. O(1). */
+void bs_dllist_concat(bs_dllist_t *list_ptr, bs_dllist_t *src_list_ptr);
+
 /** Returns whether |list_ptr| contains |dlnode_ptr|. */
 bool bs_dllist_contains(
     const bs_dllist_t *list_ptr,
@@ -0,0 +1,474 @@
+/* ========================================================================= */
+/**
+ * @file epoch.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "epoch.h"
+
+#include "atomic.h"
+#include "def.h"
+#include "log.h"
+#include "log_wrappers.h"
+#include "thread.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* == Declarations ========================================================= */
+
+/** Size of a cache line, to keep participants' states apart. */
+#define _BS_EPOCH_CACHELINE   64
+
+/** Retires between attempts to advance the epoch. */
+#define _BS_EPOCH_ADVANCE_INTERVAL 64
+
+/** Objects retired by a participant, all within the same epoch. */
+typedef struct {
+    /** Singly-linked list of the retired objects. */
+    bs_epoch_retired_t        *head_ptr;
+    /** Epoch the objects were retired in. */
+    int64_t                   epoch;
+} bs_epoch_limbo_t;
+
+/**
+ * @private State of a participant.
+ *
+ * `state` is read by other threads when advancing the epoch, and is kept on
+ * a cache line of its own. All other fields are private to the owner.
+ */
+struct _bs_epoch_participant_t {
+    /** 0 if outside a critical section, else `(epoch << 1) | 1`. */
+    bs_atomic_int64_t         state;
+    /** Padding, up to the next cache line. */
+    uint8_t                   padding[_BS_EPOCH_CACHELINE -
+                                      sizeof(bs_atomic_int64_t)];
+
+    /** Depth of nested critical sections. */
+    unsigned                  nesting;
+    /** Retired objects, by epoch modulo 3. */
+    bs_epoch_limbo_t          limbo[3];
+    /** Number of retired objects not yet reclaimed. */
+    size_t                    pending;
+    /** Objects retired since the last attempt to advance. */
+    unsigned                  retires_since_advance;
+    /** Back-link to the domain. */
+    bs_epoch_t                *epoch_ptr;
+    /** Next participant of the domain. Guarded by the domain's mutex. */
+    bs_epoch_participant_t    *next_ptr;
+};
+
+/** State of the epoch domain. */
+struct _bs_epoch_t {
+    /** The global epoch. Starts at 1, and only grows. */
+    bs_atomic_int64_t         epoch;
+    /** Padding: `epoch` is read often, the rest only when advancing. */
+    uint8_t                   padding[_BS_EPOCH_CACHELINE -
+                                      sizeof(bs_atomic_int64_t)];
+    /** Guards `participants_ptr`, and serializes advancing the epoch. */
+    pthread_mutex_t           mutex;
+    /** Registered participants. */
+    bs_epoch_participant_t    *participants_ptr;
+};
+
+static bool _bs_epoch_try_advance(bs_epoch_t *epoch_ptr);
+static void _bs_epoch_collect(bs_epoch_participant_t *participant_ptr);
+static void _bs_epoch_reclaim_limbo(bs_epoch_participant_t *participant_ptr,
+                                    bs_epoch_limbo_t *limbo_ptr);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_epoch_t *bs_epoch_create(void)
+{
+    bs_epoch_t *epoch_ptr = logged_calloc(1, sizeof(bs_epoch_t));
+    if (NULL == epoch_ptr) return NULL;
+    if (!bs_mutex_init(&epoch_ptr->mutex)) {
+        logged_free(epoch_ptr);
+        return NULL;
+    }
+    bs_atomic_int64_set(&epoch_ptr->epoch, 1);
+    return epoch_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_epoch_destroy(bs_epoch_t *epoch_ptr)
+{
+    if (NULL != epoch_ptr->participants_ptr) {
+        bs_log(BS_ERROR, "Epoch %p destroyed with registered participants.",
+               epoch_ptr);
+    }
+    bs_mutex_destroy(&epoch_ptr->mutex);
+    logged_free(epoch_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bs_epoch_participant_t *bs_epoch_register(bs_epoch_t *epoch_ptr)
+{
+    // aligned_alloc(3) wants a multiple of the alignment.
+    size_t size = (sizeof(bs_epoch_participant_t) + _BS_EPOCH_CACHELINE - 1) &
+        ~(size_t)(_BS_EPOCH_CACHELINE - 1);
+    bs_epoch_participant_t *participant_ptr = aligned_alloc(
+        _BS_EPOCH_CACHELINE, size);
+    if (NULL == participant_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed aligned_alloc(%d, %zu)",
+               _BS_EPOCH_CACHELINE, size);
+        return NULL;
+    }
+    memset(participant_ptr, 0, size);
+    participant_ptr->epoch_ptr = epoch_ptr;
+
+    bs_mutex_lock(&epoch_ptr->mutex);
+    participant_ptr->next_ptr = epoch_ptr->participants_ptr;
+    epoch_ptr->participants_ptr = participant_ptr;
+    bs_mutex_unlock(&epoch_ptr->mutex);
+    return participant_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_epoch_unregister(bs_epoch_participant_t *participant_ptr)
+{
+    bs_epoch_t *epoch_ptr = participant_ptr->epoch_ptr;
+    bs_epoch_synchronize(participant_ptr);
+
+    bs_mutex_lock(&epoch_ptr->mutex);
+    bs_epoch_participant_t **p_ptr_ptr = &epoch_ptr->participants_ptr;
+    while (*p_ptr_ptr != participant_ptr) p_ptr_ptr = &(*p_ptr_ptr)->next_ptr;
+    *p_ptr_ptr = participant_ptr->next_ptr;
+    bs_mutex_unlock(&epoch_ptr->mutex);
+    // From aligned_alloc(3) in bs_epoch_register, not a logged_* allocator.
+    free(participant_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_epoch_enter(bs_epoch_participant_t *participant_ptr)
+{
+    if (0 < participant_ptr->nesting++) return;
+
+    // The exchange is a full barrier: The state is visible to advancing
+    // threads before any load from within the section.
+    int64_t state = bs_atomic_int64_get_explicit(
+        &participant_ptr->epoch_ptr->epoch, BS_ATOMIC_ACQUIRE);
+    state = (state << 1) | 1;
+    bs_atomic_int64_xchg(&participant_ptr->state, &state);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_epoch_leave(bs_epoch_participant_t *participant_ptr)
+{
+    if (0 < --participant_ptr->nesting) return;
+    bs_atomic_int64_set_explicit(&participant_ptr->state, 0,
+                                 BS_ATOMIC_RELEASE);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_epoch_retire(bs_epoch_participant_t *participant_ptr,
+                     bs_epoch_retired_t *retired_ptr,
+                     bs_epoch_reclaim_t reclaim)
+{
+    int64_t epoch = bs_atomic_int64_get_explicit(
+        &participant_ptr->epoch_ptr->epoch, BS_ATOMIC_ACQUIRE);
+
+    // A list of an older epoch in this slot is at least 3 epochs old.
+    bs_epoch_limbo_t *limbo_ptr = &participant_ptr->limbo[epoch % 3];
+    if (limbo_ptr->epoch != epoch) {
+        _bs_epoch_reclaim_limbo(participant_ptr, limbo_ptr);
+        limbo_ptr->epoch = epoch;
+    }
+    retired_ptr->reclaim = reclaim;
+    retired_ptr->next_ptr = limbo_ptr->head_ptr;
+    limbo_ptr->head_ptr = retired_ptr;
+    participant_ptr->pending++;
+
+    if (_BS_EPOCH_ADVANCE_INTERVAL <=
+        ++participant_ptr->retires_since_advance) {
+        participant_ptr->retires_since_advance = 0;
+        _bs_epoch_try_advance(participant_ptr->epoch_ptr);
+        _bs_epoch_collect(participant_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_epoch_synchronize(bs_epoch_participant_t *participant_ptr)
+{
+    bs_epoch_t *epoch_ptr = participant_ptr->epoch_ptr;
+
+    // Objects retired up to now got an epoch no greater than the current,
+    // and can be reclaimed once the epoch advanced twice from it.
+    int64_t target = bs_atomic_int64_get(&epoch_ptr->epoch) + 2;
+    while (bs_atomic_int64_get(&epoch_ptr->epoch) < target) {
+        if (!_bs_epoch_try_advance(epoch_ptr)) sched_yield();
+    }
+    _bs_epoch_collect(participant_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_epoch_pending(const bs_epoch_participant_t *participant_ptr)
+{
+    return participant_ptr->pending;
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Advances the global epoch, if all participants within a critical section
+ * have observed the current epoch.
+ *
+ * @return Whether the epoch was advanced.
+ */
+bool _bs_epoch_try_advance(bs_epoch_t *epoch_ptr)
+{
+    // Whoever holds the mutex is advancing, or (un)registering: No need to
+    // wait for either.
+    if (0 != pthread_mutex_trylock(&epoch_ptr->mutex)) return false;
+
+    int64_t epoch = bs_atomic_int64_get(&epoch_ptr->epoch);
+    for (bs_epoch_participant_t *p_ptr = epoch_ptr->participants_ptr;
+         NULL != p_ptr;
+         p_ptr = p_ptr->next_ptr) {
+        int64_t state = bs_atomic_int64_get_explicit(
+            &p_ptr->state, BS_ATOMIC_ACQUIRE);
+        if ((state & 1) && (state >> 1) != epoch) {
+            bs_mutex_unlock(&epoch_ptr->mutex);
+            return false;
+        }
+    }
+    bs_atomic_int64_set(&epoch_ptr->epoch, epoch + 1);
+    bs_mutex_unlock(&epoch_ptr->mutex);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Reclaims the participant's objects that were retired at least two epochs
+ * ago: Participants active back then have all left their sections.
+ */
+void _bs_epoch_collect(bs_epoch_participant_t *participant_ptr)
+{
+    int64_t epoch = bs_atomic_int64_get_explicit(
+        &participant_ptr->epoch_ptr->epoch, BS_ATOMIC_ACQUIRE);
+    for (int i = 0; i < 3; ++i) {
+        bs_epoch_limbo_t *limbo_ptr = &participant_ptr->limbo[i];
+        if (limbo_ptr->epoch + 2 <= epoch) {
+            _bs_epoch_reclaim_limbo(participant_ptr, limbo_ptr);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Reclaims all objects of `limbo_ptr`. */
+void _bs_epoch_reclaim_limbo(bs_epoch_participant_t *participant_ptr,
+                             bs_epoch_limbo_t *limbo_ptr)
+{
+    while (NULL != limbo_ptr->head_ptr) {
+        bs_epoch_retired_t *retired_ptr = limbo_ptr->head_ptr;
+        limbo_ptr->head_ptr = retired_ptr->next_ptr;
+        retired_ptr->reclaim(retired_ptr);
+        participant_ptr->pending--;
+    }
+}
+
+/* == Unit tests =========================================================== */
+/** @cond TEST */
+
+static void test_grace(bs_test_t *test_ptr);
+static void test_threaded(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_epoch_test_cases[] = {
+    { 1, "grace", test_grace },
+    { 1, "threaded", test_threaded },
+    { 0, NULL, NULL }
+};
+
+/** A retirable object for the tests. */
+typedef struct {
+    /** Header for retiring. */
+    bs_epoch_retired_t        retired;
+    /** Set to @ref _TEST_MAGIC while valid. */
+    uint64_t                  magic;
+    /** Incremented when reclaimed, if not NULL. */
+    int                       *reclaimed_ptr;
+} _test_object_t;
+
+/** Marks a valid @ref _test_object_t. */
+#define _TEST_MAGIC           0x5eedf00dcafe1234ULL
+
+/* ------------------------------------------------------------------------- */
+/** Reclaims a @ref _test_object_t. */
+static void _test_reclaim(bs_epoch_retired_t *retired_ptr)
+{
+    _test_object_t *object_ptr = BS_CONTAINER_OF(
+        retired_ptr, _test_object_t, retired);
+    if (NULL != object_ptr->reclaimed_ptr) ++*object_ptr->reclaimed_ptr;
+    object_ptr->magic = 0;
+    logged_free(object_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Creates a @ref _test_object_t. */
+static _test_object_t *_test_object_create(int *reclaimed_ptr)
+{
+    _test_object_t *object_ptr = logged_calloc(1, sizeof(_test_object_t));
+    if (NULL == object_ptr) return NULL;
+    object_ptr->magic = _TEST_MAGIC;
+    object_ptr->reclaimed_ptr = reclaimed_ptr;
+    return object_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Retired objects are not reclaimed while a reader is in a section. */
+void test_grace(bs_test_t *test_ptr)
+{
+    bs_epoch_t *epoch_ptr = bs_epoch_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, epoch_ptr);
+    bs_epoch_participant_t *reader_ptr = bs_epoch_register(epoch_ptr);
+    bs_epoch_participant_t *writer_ptr = bs_epoch_register(epoch_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, reader_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, writer_ptr);
+
+    // Nested: Leaving the inner section keeps the outer.
+    bs_epoch_enter(reader_ptr);
+    bs_epoch_enter(reader_ptr);
+    bs_epoch_leave(reader_ptr);
+
+    int reclaimed = 0;
+    _test_object_t *object_ptr = _test_object_create(&reclaimed);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, object_ptr);
+    bs_epoch_retire(writer_ptr, &object_ptr->retired, _test_reclaim);
+
+    // Many more retires attempt to advance, but the reader blocks it.
+    int others = 0;
+    for (int i = 0; i < 10 * _BS_EPOCH_ADVANCE_INTERVAL; ++i) {
+        _test_object_t *o_ptr = _test_object_create(&others);
+        BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, o_ptr);
+        bs_epoch_retire(writer_ptr, &o_ptr->retired, _test_reclaim);
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 0, reclaimed);
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_MAGIC, object_ptr->magic);
+    BS_TEST_VERIFY_EQ(test_ptr, 1 + 10 * _BS_EPOCH_ADVANCE_INTERVAL,
+                      bs_epoch_pending(writer_ptr));
+
+    bs_epoch_leave(reader_ptr);
+    bs_epoch_synchronize(writer_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, reclaimed);
+    BS_TEST_VERIFY_EQ(test_ptr, 10 * _BS_EPOCH_ADVANCE_INTERVAL, others);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_epoch_pending(writer_ptr));
+
+    // Without readers, objects get reclaimed as the writer goes.
+    for (int i = 0; i < 10 * _BS_EPOCH_ADVANCE_INTERVAL; ++i) {
+        _test_object_t *o_ptr = _test_object_create(NULL);
+        BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, o_ptr);
+        bs_epoch_retire(writer_ptr, &o_ptr->retired, _test_reclaim);
+    }
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_epoch_pending(writer_ptr) <=
+                        3 * _BS_EPOCH_ADVANCE_INTERVAL);
+
+    bs_epoch_unregister(writer_ptr);
+    bs_epoch_unregister(reader_ptr);
+    bs_epoch_destroy(epoch_ptr);
+}
+
+/** Number of reader threads in the threaded test. */
+#define _TEST_READERS         4
+
+/** State shared by the threads of the threaded test. */
+typedef struct {
+    /** The domain. */
+    bs_epoch_t                *epoch_ptr;
+    /** The shared object: Replaced by the writer, read by the readers. */
+    bs_atomic_ptr_t           object;
+    /** Set to non-zero to terminate the readers. */
+    bs_atomic_int32_t         stop;
+    /** Number of reads that found an invalid object. */
+    bs_atomic_int32_t         failures;
+} _test_shared_t;
+
+/* ------------------------------------------------------------------------- */
+/** Reader thread: Reads the shared object until stopped. */
+static void *_test_reader(void *arg_ptr)
+{
+    _test_shared_t *shared_ptr = arg_ptr;
+    bs_epoch_participant_t *participant_ptr = bs_epoch_register(
+        shared_ptr->epoch_ptr);
+    if (NULL == participant_ptr) {
+        bs_atomic_int32_add(&shared_ptr->failures, 1);
+        return NULL;
+    }
+    while (0 == bs_atomic_int32_get(&shared_ptr->stop)) {
+        bs_epoch_enter(participant_ptr);
+        _test_object_t *object_ptr = bs_atomic_ptr_get_explicit(
+            &shared_ptr->object, BS_ATOMIC_ACQUIRE);
+        for (int i = 0; i < 10; ++i) {
+            if (_TEST_MAGIC != object_ptr->magic) {
+                bs_atomic_int32_add(&shared_ptr->failures, 1);
+            }
+            sched_yield();
+        }
+        bs_epoch_leave(participant_ptr);
+    }
+    bs_epoch_unregister(participant_ptr);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Readers use an object while a writer keeps replacing and retiring it. */
+void test_threaded(bs_test_t *test_ptr)
+{
+    _test_shared_t shared = {
+        .stop = BS_ATOMIC_INT32_INIT(0),
+        .failures = BS_ATOMIC_INT32_INIT(0) };
+    shared.epoch_ptr = bs_epoch_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, shared.epoch_ptr);
+    bs_epoch_participant_t *writer_ptr = bs_epoch_register(shared.epoch_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, writer_ptr);
+    bs_atomic_ptr_set(&shared.object, _test_object_create(NULL));
+
+    pthread_t threads[_TEST_READERS];
+    for (int t = 0; t < _TEST_READERS; ++t) {
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, 0,
+            pthread_create(&threads[t], NULL, _test_reader, &shared));
+    }
+
+    int reclaimed = 0;
+    for (int i = 0; i < 20000; ++i) {
+        void *object_ptr = _test_object_create(&reclaimed);
+        if (NULL == object_ptr) break;
+        bs_atomic_ptr_xchg(&shared.object, &object_ptr);
+        _test_object_t *old_ptr = object_ptr;
+        bs_epoch_retire(writer_ptr, &old_ptr->retired, _test_reclaim);
+        if (0 == i % 64) sched_yield();
+    }
+
+    bs_atomic_int32_set(&shared.stop, 1);
+    for (int t = 0; t < _TEST_READERS; ++t) pthread_join(threads[t], NULL);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_atomic_int32_get(&shared.failures));
+
+    _test_object_t *object_ptr = bs_atomic_ptr_get(&shared.object);
+    bs_epoch_retire(writer_ptr, &object_ptr->retired, _test_reclaim);
+    bs_epoch_unregister(writer_ptr);
+    // All but the first object, which was created without counter.
+    BS_TEST_VERIFY_EQ(test_ptr, 20000, reclaimed);
+    bs_epoch_destroy(shared.epoch_ptr);
+}
+
+/** @endcond */
+
+/* == End of epoch.c ======================================================= */
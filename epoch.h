@@ -0,0 +1,168 @@
+/* ========================================================================= */
+/**
+ * @file epoch.h
+ * Epoch-based reclamation: Defers freeing memory until no reader can still
+ * hold a reference to it.
+ *
+ * Threads register as a @ref bs_epoch_participant_t, and bracket each
+ * traversal of a shared structure by @ref bs_epoch_enter and
+ * @ref bs_epoch_leave. An object that got unlinked from the structure is
+ * handed to @ref bs_epoch_retire, and reclaimed once every participant that
+ * was within a critical section at the time has left it.
+ *
+ * Entering and leaving touch only the participant's own cache line, plus a
+ * read of the global epoch. Retired objects are kept in the retiring
+ * participant's lists, so retiring takes no lock.
+ *
+ * Example:
+ * ```
+ * bs_epoch_enter(participant_ptr);
+ * node_t *node_ptr = bs_atomic_ptr_get(&head);
+ * use(node_ptr);
+ * bs_epoch_leave(participant_ptr);
+ * ...
+ * // In the writer, after unlinking old_ptr.
+ * bs_epoch_retire(participant_ptr, &old_ptr->retired, node_reclaim);
+ * ```
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_EPOCH_H__
+#define __LIBBASE_EPOCH_H__
+
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Forward declaration: The epoch domain. */
+typedef struct _bs_epoch_t bs_epoch_t;
+/** Forward declaration: A participant, eg. a thread, of the domain. */
+typedef struct _bs_epoch_participant_t bs_epoch_participant_t;
+/** Forward declaration: Header of a retired object. */
+typedef struct _bs_epoch_retired_t bs_epoch_retired_t;
+
+/**
+ * Functor type to reclaim a retired object.
+ *
+ * @param retired_ptr         As passed to @ref bs_epoch_retire. Use
+ *     @ref BS_CONTAINER_OF to get the enclosing object.
+ */
+typedef void (*bs_epoch_reclaim_t)(bs_epoch_retired_t *retired_ptr);
+
+/** Header of a retired object. Embed in the object. */
+struct _bs_epoch_retired_t {
+    /** Next retired object, in the same list. */
+    bs_epoch_retired_t        *next_ptr;
+    /** Reclaims the object. */
+    bs_epoch_reclaim_t        reclaim;
+};
+
+/**
+ * Creates an epoch domain.
+ *
+ * @return A pointer to the domain, or NULL on error. Must be destroyed by
+ *     @ref bs_epoch_destroy.
+ */
+bs_epoch_t *bs_epoch_create(void);
+
+/**
+ * Destroys the domain. All participants must be unregistered.
+ *
+ * @param epoch_ptr
+ */
+void bs_epoch_destroy(bs_epoch_t *epoch_ptr);
+
+/**
+ * Registers a participant.
+ *
+ * A participant may be used by one thread at a time only. Typically, each
+ * thread registers its own.
+ *
+ * @param epoch_ptr
+ *
+ * @return A pointer to the participant, or NULL on error. Must be released
+ *     by @ref bs_epoch_unregister.
+ */
+bs_epoch_participant_t *bs_epoch_register(bs_epoch_t *epoch_ptr);
+
+/**
+ * Unregisters the participant. Waits for a grace period, to reclaim all
+ * objects it retired. Must not be within a critical section.
+ *
+ * @param participant_ptr
+ */
+void bs_epoch_unregister(bs_epoch_participant_t *participant_ptr);
+
+/**
+ * Enters a critical section. Objects reachable from within the section
+ * stay valid until @ref bs_epoch_leave. Sections may nest.
+ *
+ * @param participant_ptr
+ */
+void bs_epoch_enter(bs_epoch_participant_t *participant_ptr);
+
+/**
+ * Leaves a critical section.
+ *
+ * @param participant_ptr
+ */
+void bs_epoch_leave(bs_epoch_participant_t *participant_ptr);
+
+/**
+ * Retires an object, to be reclaimed once no participant can hold a
+ * reference to it anymore.
+ *
+ * The object must already be unlinked, ie. unreachable for participants
+ * entering a critical section from now on. May be called from within a
+ * critical section. Reclamation happens at a later call to
+ * @ref bs_epoch_retire, @ref bs_epoch_synchronize or
+ * @ref bs_epoch_unregister of the same participant.
+ *
+ * @param participant_ptr
+ * @param retired_ptr         The header embedded in the object.
+ * @param reclaim             Reclaims the object.
+ */
+void bs_epoch_retire(bs_epoch_participant_t *participant_ptr,
+                     bs_epoch_retired_t *retired_ptr,
+                     bs_epoch_reclaim_t reclaim);
+
+/**
+ * Waits for a grace period: Until all participants that were within a
+ * critical section have left it. Then reclaims all objects retired by
+ * `participant_ptr`. Must not be within a critical section.
+ *
+ * @param participant_ptr
+ */
+void bs_epoch_synchronize(bs_epoch_participant_t *participant_ptr);
+
+/** Returns the number of objects retired and not yet reclaimed. */
+size_t bs_epoch_pending(const bs_epoch_participant_t *participant_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_epoch_test_cases[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_EPOCH_H__ */
+/* == End of epoch.h ======================================================= */
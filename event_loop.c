@@ -0,0 +1,1071 @@
+/* ========================================================================= */
+/**
+ * @file event_loop.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "event_loop.h"
+
+#include "assert.h"
+#include "atomic.h"
+#include "def.h"
+#include "dllist.h"
+#include "log.h"
+#include "log_wrappers.h"
+#include "sock.h"
+#include "subprocess.h"
+#include "time.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+/* == Declarations ========================================================= */
+
+/** State of the event loop. */
+struct _bs_event_loop_t {
+    /** The epoll(7) file descriptor. */
+    int                       epoll_fd;
+    /** The eventfd(2), for @ref bs_event_loop_wakeup. */
+    int                       wakeup_fd;
+    /** Watched file descriptors, of @ref bs_event_loop_fd_t::dlnode. */
+    bs_dllist_t               fds;
+    /**
+     * Watches removed during a dispatch. Their events might still be in the
+     * batch returned by epoll_wait(2), so they are freed after the batch.
+     */
+    bs_dllist_t               released_fds;
+    /** Whether @ref bs_event_loop_dispatch is calling fd callbacks. */
+    bool                      dispatching;
+    /** All timers, armed or not. Of @ref bs_event_loop_timer_t::dlnode. */
+    bs_dllist_t               timers;
+    /** Armed timers: A binary heap, earliest deadline first. */
+    bs_event_loop_timer_t     **heap_ptrs;
+    /** Number of armed timers, in `heap_ptrs`. */
+    size_t                    heap_size;
+    /** Capacity of `heap_ptrs`. */
+    size_t                    heap_capacity;
+    /**
+     * Timers taken off the heap as expired, whose callbacks are pending.
+     * Of @ref bs_event_loop_timer_t::expired_dlnode.
+     */
+    bs_dllist_t               expired_timers;
+    /** Set by @ref bs_event_loop_quit. */
+    bs_atomic_int32_t         quit;
+};
+
+/** A watched file descriptor. */
+struct _bs_event_loop_fd_t {
+    /** Node within @ref bs_event_loop_t::fds, or `released_fds`. */
+    bs_dllist_node_t          dlnode;
+    /** Back-link to the loop. */
+    bs_event_loop_t           *loop_ptr;
+    /** The file descriptor. */
+    int                       fd;
+    /** Callback. NULL once removed. */
+    bs_event_loop_fd_callback_t callback;
+    /** Argument to `callback`. */
+    void                      *ud_ptr;
+};
+
+/** A timer. */
+struct _bs_event_loop_timer_t {
+    /** Node within @ref bs_event_loop_t::timers. */
+    bs_dllist_node_t          dlnode;
+    /** Back-link to the loop. */
+    bs_event_loop_t           *loop_ptr;
+    /** Deadline, in @ref bs_mono_nsec. */
+    uint64_t                  deadline_nsec;
+    /** Period, for re-arming. 0 for a one-shot timer. */
+    uint64_t                  period_nsec;
+    /** Position within @ref bs_event_loop_t::heap_ptrs. SIZE_MAX if not. */
+    size_t                    heap_idx;
+    /** Node within @ref bs_event_loop_t::expired_timers. */
+    bs_dllist_node_t          expired_dlnode;
+    /** Whether the timer is in @ref bs_event_loop_t::expired_timers. */
+    bool                      expired;
+    /** Callback. */
+    bs_event_loop_timer_callback_t callback;
+    /** Argument to `callback`. */
+    void                      *ud_ptr;
+};
+
+static uint32_t bs_event_loop_to_epoll(uint32_t events);
+static uint32_t bs_event_loop_from_epoll(uint32_t epoll_events);
+static int bs_event_loop_timeout_msec(bs_event_loop_t *loop_ptr,
+                                      int timeout_msec);
+static int bs_event_loop_expire_timers(bs_event_loop_t *loop_ptr);
+
+static bool bs_event_loop_heap_reserve(bs_event_loop_t *loop_ptr,
+                                       size_t capacity);
+static void bs_event_loop_heap_push(bs_event_loop_t *loop_ptr,
+                                    bs_event_loop_timer_t *timer_ptr);
+static void bs_event_loop_heap_remove(bs_event_loop_t *loop_ptr,
+                                      size_t idx);
+static void bs_event_loop_heap_place(bs_event_loop_t *loop_ptr,
+                                     size_t idx,
+                                     bs_event_loop_timer_t *timer_ptr);
+static void bs_event_loop_heap_sift_up(bs_event_loop_t *loop_ptr,
+                                       size_t idx);
+static void bs_event_loop_heap_sift_down(bs_event_loop_t *loop_ptr,
+                                         size_t idx);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_event_loop_t *bs_event_loop_create(void)
+{
+    bs_event_loop_t *loop_ptr = logged_calloc(1, sizeof(bs_event_loop_t));
+    if (NULL == loop_ptr) return NULL;
+    loop_ptr->wakeup_fd = -1;
+
+    loop_ptr->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (0 > loop_ptr->epoll_fd) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed epoll_create1(EPOLL_CLOEXEC)");
+        bs_event_loop_destroy(loop_ptr);
+        return NULL;
+    }
+
+    loop_ptr->wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (0 > loop_ptr->wakeup_fd) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed eventfd(0, EFD_CLOEXEC | "
+               "EFD_NONBLOCK)");
+        bs_event_loop_destroy(loop_ptr);
+        return NULL;
+    }
+    // The wakeup is the only event with a NULL pointer.
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    if (0 != epoll_ctl(loop_ptr->epoll_fd, EPOLL_CTL_ADD,
+                       loop_ptr->wakeup_fd, &event)) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed epoll_ctl(%d, EPOLL_CTL_ADD, %d)",
+               loop_ptr->epoll_fd, loop_ptr->wakeup_fd);
+        bs_event_loop_destroy(loop_ptr);
+        return NULL;
+    }
+    return loop_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_event_loop_destroy(bs_event_loop_t *loop_ptr)
+{
+    bs_dllist_node_t *dlnode_ptr;
+    while (NULL != (dlnode_ptr = loop_ptr->fds.head_ptr)) {
+        bs_event_loop_fd_t *fd_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, bs_event_loop_fd_t, dlnode);
+        bs_event_loop_remove_fd(fd_ptr);
+    }
+    while (NULL != (dlnode_ptr = loop_ptr->timers.head_ptr)) {
+        bs_event_loop_timer_t *timer_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, bs_event_loop_timer_t, dlnode);
+        bs_event_loop_timer_destroy(timer_ptr);
+    }
+    if (NULL != loop_ptr->heap_ptrs) logged_free(loop_ptr->heap_ptrs);
+
+    if (0 <= loop_ptr->wakeup_fd) close(loop_ptr->wakeup_fd);
+    if (0 <= loop_ptr->epoll_fd) close(loop_ptr->epoll_fd);
+    logged_free(loop_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bs_event_loop_fd_t *bs_event_loop_add_fd(
+    bs_event_loop_t *loop_ptr,
+    int fd,
+    uint32_t events,
+    bs_event_loop_fd_callback_t callback,
+    void *ud_ptr)
+{
+    bs_event_loop_fd_t *fd_ptr = logged_calloc(1, sizeof(bs_event_loop_fd_t));
+    if (NULL == fd_ptr) return NULL;
+    fd_ptr->loop_ptr = loop_ptr;
+    fd_ptr->fd = fd;
+    fd_ptr->callback = callback;
+    fd_ptr->ud_ptr = ud_ptr;
+
+    struct epoll_event event = {
+        .events = bs_event_loop_to_epoll(events), .data.ptr = fd_ptr };
+    if (0 != epoll_ctl(loop_ptr->epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed epoll_ctl(%d, EPOLL_CTL_ADD, %d)",
+               loop_ptr->epoll_fd, fd);
+        logged_free(fd_ptr);
+        return NULL;
+    }
+    bs_dllist_push_back(&loop_ptr->fds, &fd_ptr->dlnode);
+    return fd_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_event_loop_modify_fd(bs_event_loop_fd_t *fd_ptr, uint32_t events)
+{
+    struct epoll_event event = {
+        .events = bs_event_loop_to_epoll(events), .data.ptr = fd_ptr };
+    if (0 != epoll_ctl(fd_ptr->loop_ptr->epoll_fd, EPOLL_CTL_MOD,
+                       fd_ptr->fd, &event)) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed epoll_ctl(%d, EPOLL_CTL_MOD, %d)",
+               fd_ptr->loop_ptr->epoll_fd, fd_ptr->fd);
+        return false;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_event_loop_remove_fd(bs_event_loop_fd_t *fd_ptr)
+{
+    bs_event_loop_t *loop_ptr = fd_ptr->loop_ptr;
+    if (0 != epoll_ctl(loop_ptr->epoll_fd, EPOLL_CTL_DEL, fd_ptr->fd, NULL)) {
+        bs_log(BS_WARNING | BS_ERRNO,
+               "Failed epoll_ctl(%d, EPOLL_CTL_DEL, %d)",
+               loop_ptr->epoll_fd, fd_ptr->fd);
+    }
+    bs_dllist_remove(&loop_ptr->fds, &fd_ptr->dlnode);
+    if (!loop_ptr->dispatching) {
+        logged_free(fd_ptr);
+        return;
+    }
+    fd_ptr->callback = NULL;
+    bs_dllist_push_back(&loop_ptr->released_fds, &fd_ptr->dlnode);
+}
+
+/* ------------------------------------------------------------------------- */
+bs_event_loop_timer_t *bs_event_loop_timer_create(
+    bs_event_loop_t *loop_ptr,
+    bs_event_loop_timer_callback_t callback,
+    void *ud_ptr)
+{
+    bs_event_loop_timer_t *timer_ptr = logged_calloc(
+        1, sizeof(bs_event_loop_timer_t));
+    if (NULL == timer_ptr) return NULL;
+    timer_ptr->loop_ptr = loop_ptr;
+    timer_ptr->heap_idx = SIZE_MAX;
+    timer_ptr->callback = callback;
+    timer_ptr->ud_ptr = ud_ptr;
+
+    // Reserves room in the heap for all timers, so arming cannot fail.
+    if (!bs_event_loop_heap_reserve(
+            loop_ptr, bs_dllist_size(&loop_ptr->timers) + 1)) {
+        logged_free(timer_ptr);
+        return NULL;
+    }
+    bs_dllist_push_back(&loop_ptr->timers, &timer_ptr->dlnode);
+    return timer_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_event_loop_timer_destroy(bs_event_loop_timer_t *timer_ptr)
+{
+    bs_event_loop_timer_disarm(timer_ptr);
+    bs_dllist_remove(&timer_ptr->loop_ptr->timers, &timer_ptr->dlnode);
+    logged_free(timer_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_event_loop_timer_arm(bs_event_loop_timer_t *timer_ptr,
+                             uint64_t deadline_nsec,
+                             uint64_t period_nsec)
+{
+    bs_event_loop_timer_disarm(timer_ptr);
+    timer_ptr->deadline_nsec = deadline_nsec;
+    timer_ptr->period_nsec = period_nsec;
+    // Room for all timers was reserved in bs_event_loop_timer_create.
+    bs_event_loop_heap_push(timer_ptr->loop_ptr, timer_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_event_loop_timer_disarm(bs_event_loop_timer_t *timer_ptr)
+{
+    // Also cancels a pending callback, when expired in the current dispatch.
+    if (timer_ptr->expired) {
+        bs_dllist_remove(&timer_ptr->loop_ptr->expired_timers,
+                         &timer_ptr->expired_dlnode);
+        timer_ptr->expired = false;
+    }
+    if (SIZE_MAX == timer_ptr->heap_idx) return;
+    bs_event_loop_heap_remove(timer_ptr->loop_ptr, timer_ptr->heap_idx);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_event_loop_timer_armed(const bs_event_loop_timer_t *timer_ptr)
+{
+    return SIZE_MAX != timer_ptr->heap_idx || timer_ptr->expired;
+}
+
+/* ------------------------------------------------------------------------- */
+int bs_event_loop_dispatch(bs_event_loop_t *loop_ptr, int timeout_msec)
+{
+    struct epoll_event        events[64];
+    int                       events_size;
+
+    do {
+        events_size = epoll_wait(
+            loop_ptr->epoll_fd, events, 64,
+            bs_event_loop_timeout_msec(loop_ptr, timeout_msec));
+    } while (0 > events_size && EINTR == errno);
+    if (0 > events_size) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed epoll_wait(%d, %p, 64, %d)",
+               loop_ptr->epoll_fd, events, timeout_msec);
+        return -1;
+    }
+
+    int calls = 0;
+    loop_ptr->dispatching = true;
+    for (int i = 0; i < events_size; ++i) {
+        bs_event_loop_fd_t *fd_ptr = events[i].data.ptr;
+        if (NULL == fd_ptr) {
+            uint64_t value;
+            if (0 > read(loop_ptr->wakeup_fd, &value, sizeof(value)) &&
+                EAGAIN != errno) {
+                bs_log(BS_WARNING | BS_ERRNO, "Failed read(%d, %p, %zu)",
+                       loop_ptr->wakeup_fd, &value, sizeof(value));
+            }
+            continue;
+        }
+        // Removed by an earlier callback of this batch.
+        if (NULL == fd_ptr->callback) continue;
+        fd_ptr->callback(fd_ptr->fd,
+                         bs_event_loop_from_epoll(events[i].events),
+                         fd_ptr->ud_ptr);
+        ++calls;
+    }
+    loop_ptr->dispatching = false;
+
+    bs_dllist_node_t *dlnode_ptr;
+    while (NULL != (dlnode_ptr = bs_dllist_pop_front(
+                        &loop_ptr->released_fds))) {
+        bs_event_loop_fd_t *fd_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, bs_event_loop_fd_t, dlnode);
+        logged_free(fd_ptr);
+    }
+    return calls + bs_event_loop_expire_timers(loop_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_event_loop_run(bs_event_loop_t *loop_ptr)
+{
+    while (!bs_atomic_int32_get(&loop_ptr->quit)) {
+        if (0 > bs_event_loop_dispatch(loop_ptr, -1)) return false;
+    }
+    bs_atomic_int32_set(&loop_ptr->quit, 0);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_event_loop_wakeup(bs_event_loop_t *loop_ptr)
+{
+    uint64_t value = 1;
+    // EAGAIN: The counter is saturated, so a wakeup is pending anyway.
+    if (0 > write(loop_ptr->wakeup_fd, &value, sizeof(value)) &&
+        EAGAIN != errno) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed write(%d, %p, %zu)",
+               loop_ptr->wakeup_fd, &value, sizeof(value));
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_event_loop_quit(bs_event_loop_t *loop_ptr)
+{
+    bs_atomic_int32_set(&loop_ptr->quit, 1);
+    bs_event_loop_wakeup(loop_ptr);
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Translates @ref bs_event_loop_events_t into epoll events. */
+uint32_t bs_event_loop_to_epoll(uint32_t events)
+{
+    uint32_t epoll_events = 0;
+    if (events & BS_EVENT_LOOP_READABLE) epoll_events |= EPOLLIN;
+    if (events & BS_EVENT_LOOP_WRITABLE) epoll_events |= EPOLLOUT;
+    return epoll_events;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Translates epoll events into @ref bs_event_loop_events_t. */
+uint32_t bs_event_loop_from_epoll(uint32_t epoll_events)
+{
+    uint32_t events = 0;
+    if (epoll_events & EPOLLIN) events |= BS_EVENT_LOOP_READABLE;
+    if (epoll_events & EPOLLOUT) events |= BS_EVENT_LOOP_WRITABLE;
+    if (epoll_events & (EPOLLERR | EPOLLHUP)) events |= BS_EVENT_LOOP_ERROR;
+    return events;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the timeout for epoll_wait(2), bounded by the next deadline. */
+int bs_event_loop_timeout_msec(bs_event_loop_t *loop_ptr, int timeout_msec)
+{
+    if (0 == loop_ptr->heap_size) return timeout_msec;
+    uint64_t now_nsec = bs_mono_nsec();
+    uint64_t deadline_nsec = loop_ptr->heap_ptrs[0]->deadline_nsec;
+    if (deadline_nsec <= now_nsec) return 0;
+
+    // Rounds up, to not wake up just before the deadline.
+    uint64_t msec = (deadline_nsec - now_nsec + 999999) / 1000000;
+    msec = BS_MIN(msec, (uint64_t)INT_MAX);
+    if (0 > timeout_msec) return msec;
+    return BS_MIN((int)msec, timeout_msec);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Calls the callbacks of all expired timers. Timers re-armed to a deadline
+ * that already passed are called during the next dispatch, to not starve
+ * the file descriptors.
+ *
+ * @return The number of callbacks called.
+ */
+int bs_event_loop_expire_timers(bs_event_loop_t *loop_ptr)
+{
+    if (0 == loop_ptr->heap_size) return 0;
+    uint64_t now_nsec = bs_mono_nsec();
+
+    // First takes all expired timers off the heap. Callbacks may then re-arm
+    // to any deadline, without getting called again in this pass.
+    while (0 < loop_ptr->heap_size &&
+           loop_ptr->heap_ptrs[0]->deadline_nsec <= now_nsec) {
+        bs_event_loop_timer_t *timer_ptr = loop_ptr->heap_ptrs[0];
+        bs_event_loop_heap_remove(loop_ptr, 0);
+        if (0 < timer_ptr->period_nsec) {
+            timer_ptr->deadline_nsec += timer_ptr->period_nsec;
+            if (timer_ptr->deadline_nsec <= now_nsec) {
+                timer_ptr->deadline_nsec = now_nsec + timer_ptr->period_nsec;
+            }
+            bs_event_loop_heap_push(loop_ptr, timer_ptr);
+        }
+        bs_dllist_push_back(&loop_ptr->expired_timers,
+                            &timer_ptr->expired_dlnode);
+        timer_ptr->expired = true;
+    }
+
+    int calls = 0;
+    bs_dllist_node_t *dlnode_ptr;
+    while (NULL != (dlnode_ptr = bs_dllist_pop_front(
+                        &loop_ptr->expired_timers))) {
+        bs_event_loop_timer_t *timer_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, bs_event_loop_timer_t, expired_dlnode);
+        timer_ptr->expired = false;
+        // May destroy the timer. Must not be accessed afterwards.
+        timer_ptr->callback(timer_ptr, timer_ptr->ud_ptr);
+        ++calls;
+    }
+    return calls;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Grows the heap to hold at least `capacity` timers. */
+bool bs_event_loop_heap_reserve(bs_event_loop_t *loop_ptr, size_t capacity)
+{
+    if (capacity <= loop_ptr->heap_capacity) return true;
+
+    capacity = BS_MAX(capacity, BS_MAX((size_t)16,
+                                       2 * loop_ptr->heap_capacity));
+    bs_event_loop_timer_t **heap_ptrs = realloc(
+        loop_ptr->heap_ptrs, capacity * sizeof(bs_event_loop_timer_t*));
+    if (NULL == heap_ptrs) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed realloc(%p, %zu)",
+               loop_ptr->heap_ptrs,
+               capacity * sizeof(bs_event_loop_timer_t*));
+        return false;
+    }
+    loop_ptr->heap_ptrs = heap_ptrs;
+    loop_ptr->heap_capacity = capacity;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Adds `timer_ptr` to the heap. The heap holds every timer of the loop, as
+ * reserved by @ref bs_event_loop_timer_create, so there is always room.
+ */
+void bs_event_loop_heap_push(bs_event_loop_t *loop_ptr,
+                             bs_event_loop_timer_t *timer_ptr)
+{
+    BS_ASSERT(loop_ptr->heap_size < loop_ptr->heap_capacity);
+    bs_event_loop_heap_place(loop_ptr, loop_ptr->heap_size++, timer_ptr);
+    bs_event_loop_heap_sift_up(loop_ptr, timer_ptr->heap_idx);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Removes the timer at `idx` from the heap. */
+void bs_event_loop_heap_remove(bs_event_loop_t *loop_ptr, size_t idx)
+{
+    loop_ptr->heap_ptrs[idx]->heap_idx = SIZE_MAX;
+    bs_event_loop_timer_t *last_ptr = loop_ptr->heap_ptrs[
+        --loop_ptr->heap_size];
+    if (idx == loop_ptr->heap_size) return;
+
+    // The last element fills the gap, and moves to where it belongs.
+    bs_event_loop_heap_place(loop_ptr, idx, last_ptr);
+    bs_event_loop_heap_sift_up(loop_ptr, idx);
+    bs_event_loop_heap_sift_down(loop_ptr, last_ptr->heap_idx);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Stores `timer_ptr` at `idx` of the heap, and updates its index. */
+void bs_event_loop_heap_place(bs_event_loop_t *loop_ptr,
+                              size_t idx,
+                              bs_event_loop_timer_t *timer_ptr)
+{
+    loop_ptr->heap_ptrs[idx] = timer_ptr;
+    timer_ptr->heap_idx = idx;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Moves the timer at `idx` towards the root, while it is earlier. */
+void bs_event_loop_heap_sift_up(bs_event_loop_t *loop_ptr, size_t idx)
+{
+    bs_event_loop_timer_t *timer_ptr = loop_ptr->heap_ptrs[idx];
+    while (0 < idx) {
+        size_t parent_idx = (idx - 1) / 2;
+        bs_event_loop_timer_t *parent_ptr = loop_ptr->heap_ptrs[parent_idx];
+        if (parent_ptr->deadline_nsec <= timer_ptr->deadline_nsec) break;
+        bs_event_loop_heap_place(loop_ptr, idx, parent_ptr);
+        idx = parent_idx;
+    }
+    bs_event_loop_heap_place(loop_ptr, idx, timer_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Moves the timer at `idx` towards the leaves, while it is later. */
+void bs_event_loop_heap_sift_down(bs_event_loop_t *loop_ptr, size_t idx)
+{
+    bs_event_loop_timer_t *timer_ptr = loop_ptr->heap_ptrs[idx];
+    for (;;) {
+        size_t child_idx = 2 * idx + 1;
+        if (child_idx >= loop_ptr->heap_size) break;
+        if (child_idx + 1 < loop_ptr->heap_size &&
+            loop_ptr->heap_ptrs[child_idx + 1]->deadline_nsec <
+            loop_ptr->heap_ptrs[child_idx]->deadline_nsec) {
+            ++child_idx;
+        }
+        bs_event_loop_timer_t *child_ptr = loop_ptr->heap_ptrs[child_idx];
+        if (timer_ptr->deadline_nsec <= child_ptr->deadline_nsec) break;
+        bs_event_loop_heap_place(loop_ptr, idx, child_ptr);
+        idx = child_idx;
+    }
+    bs_event_loop_heap_place(loop_ptr, idx, timer_ptr);
+}
+
+/* == Unit tests =========================================================== */
+/** @cond TEST */
+
+static void test_fd(bs_test_t *test_ptr);
+static void test_timers(bs_test_t *test_ptr);
+static void test_timers_many(bs_test_t *test_ptr);
+static void test_timers_rearm(bs_test_t *test_ptr);
+static void test_wakeup(bs_test_t *test_ptr);
+static void test_sock_reader(bs_test_t *test_ptr);
+static void test_subprocess_manager(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_event_loop_test_cases[] = {
+    { 1, "fd", test_fd },
+    { 1, "timers", test_timers },
+    { 1, "timers_many", test_timers_many },
+    { 1, "timers_rearm", test_timers_rearm },
+    { 1, "wakeup", test_wakeup },
+    { 1, "sock_reader", test_sock_reader },
+    { 1, "subprocess_manager", test_subprocess_manager },
+    { 0, NULL, NULL }
+};
+
+/** State for the file descriptor tests. */
+struct test_fd_state {
+    /** Number of calls of the callback. */
+    int                       calls;
+    /** Events reported with the last call. */
+    uint32_t                  events;
+    /** If set, the callback removes this watch. */
+    bs_event_loop_fd_t        *remove_fd_ptr;
+};
+
+/* ------------------------------------------------------------------------- */
+/** Callback for @ref test_fd: Records the call. */
+static void test_fd_callback(int fd, uint32_t events, void *ud_ptr)
+{
+    struct test_fd_state *state_ptr = ud_ptr;
+    ++state_ptr->calls;
+    state_ptr->events = events;
+    if (NULL != state_ptr->remove_fd_ptr) {
+        bs_event_loop_remove_fd(state_ptr->remove_fd_ptr);
+        state_ptr->remove_fd_ptr = NULL;
+    }
+
+    char buf[16];
+    if (events & BS_EVENT_LOOP_READABLE) read(fd, buf, sizeof(buf));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Watches pipes, and removes a watch from within a callback. */
+void test_fd(bs_test_t *test_ptr)
+{
+    int fds1[2], fds2[2];
+    struct test_fd_state s1 = {}, s2 = {};
+    bs_event_loop_t *loop_ptr = bs_event_loop_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, loop_ptr);
+    BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 0, pipe(fds1));
+    BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 0, pipe(fds2));
+
+    bs_event_loop_fd_t *fd1_ptr = bs_event_loop_add_fd(
+        loop_ptr, fds1[0], BS_EVENT_LOOP_READABLE, test_fd_callback, &s1);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, fd1_ptr);
+    bs_event_loop_fd_t *fd2_ptr = bs_event_loop_add_fd(
+        loop_ptr, fds2[0], BS_EVENT_LOOP_READABLE, test_fd_callback, &s2);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, fd2_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_event_loop_dispatch(loop_ptr, 0));
+
+    BS_TEST_VERIFY_EQ(test_ptr, 1, write(fds1[1], "a", 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_event_loop_dispatch(loop_ptr, 100));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, s1.calls);
+    BS_TEST_VERIFY_EQ(test_ptr, BS_EVENT_LOOP_READABLE, s1.events);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, s2.calls);
+
+    // Whichever is called first removes the other: Only one call.
+    s1.remove_fd_ptr = fd2_ptr;
+    s2.remove_fd_ptr = fd1_ptr;
+    BS_TEST_VERIFY_EQ(test_ptr, 1, write(fds1[1], "a", 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, write(fds2[1], "b", 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_event_loop_dispatch(loop_ptr, 100));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, s1.calls + s2.calls);
+    bs_event_loop_fd_t *left_fd_ptr = NULL == s1.remove_fd_ptr ?
+        fd1_ptr : fd2_ptr;
+    struct test_fd_state *left_ptr = NULL == s1.remove_fd_ptr ? &s1 : &s2;
+    int left_calls = left_ptr->calls;
+
+    // Hang-up is reported as error. Watching for writable only.
+    close(fds1[1]);
+    close(fds2[1]);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_event_loop_modify_fd(left_fd_ptr, BS_EVENT_LOOP_WRITABLE));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_event_loop_dispatch(loop_ptr, 100));
+    BS_TEST_VERIFY_EQ(test_ptr, left_calls + 1, left_ptr->calls);
+    BS_TEST_VERIFY_EQ(test_ptr, BS_EVENT_LOOP_ERROR, left_ptr->events);
+
+    bs_event_loop_destroy(loop_ptr);
+    close(fds1[0]);
+    close(fds2[0]);
+}
+
+/** State for @ref test_timers. */
+struct test_timers_state {
+    /** Order of calls, as indices of the timers. */
+    int                       order[8];
+    /** Number of calls. */
+    int                       calls;
+    /** Index of this timer. */
+    int                       idx;
+    /** If set: Destroy the timer, once it got called that often. */
+    int                       destroy_after;
+    /** Shared state, for recording the order. */
+    struct test_timers_state  *shared_ptr;
+};
+
+/* ------------------------------------------------------------------------- */
+/** Callback for @ref test_timers. */
+static void test_timers_callback(bs_event_loop_timer_t *timer_ptr,
+                                 void *ud_ptr)
+{
+    struct test_timers_state *state_ptr = ud_ptr;
+    struct test_timers_state *shared_ptr = state_ptr->shared_ptr;
+    if (8 > shared_ptr->calls) {
+        shared_ptr->order[shared_ptr->calls++] = state_ptr->idx;
+    }
+    ++state_ptr->calls;
+    if (state_ptr->destroy_after == state_ptr->calls) {
+        bs_event_loop_timer_destroy(timer_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Timers expire in order of their deadline. Periodic timers re-arm. */
+void test_timers(bs_test_t *test_ptr)
+{
+    struct test_timers_state shared = {}, states[5] = {};
+    bs_event_loop_timer_t *timer_ptrs[5];
+    bs_event_loop_t *loop_ptr = bs_event_loop_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, loop_ptr);
+
+    for (int i = 0; i < 5; ++i) {
+        states[i].idx = i;
+        states[i].shared_ptr = &shared;
+        timer_ptrs[i] = bs_event_loop_timer_create(
+            loop_ptr, test_timers_callback, &states[i]);
+        BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, timer_ptrs[i]);
+    }
+
+    // Armed out of order. Timer 2 gets disarmed, timer 4 is not armed.
+    uint64_t now_nsec = bs_mono_nsec();
+    bs_event_loop_timer_arm(timer_ptrs[0], now_nsec + 3000000, 0);
+    bs_event_loop_timer_arm(timer_ptrs[1], now_nsec + 1000000, 0);
+    bs_event_loop_timer_arm(timer_ptrs[2], now_nsec + 500000, 0);
+    bs_event_loop_timer_arm(timer_ptrs[3], now_nsec + 2000000, 0);
+    bs_event_loop_timer_disarm(timer_ptrs[2]);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_event_loop_timer_armed(timer_ptrs[2]));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_event_loop_timer_armed(timer_ptrs[3]));
+
+    while (3 > shared.calls && !bs_test_failed(test_ptr)) {
+        BS_TEST_VERIFY_TRUE(
+            test_ptr, 0 <= bs_event_loop_dispatch(loop_ptr, -1));
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 3, shared.calls);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, shared.order[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, shared.order[1]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, shared.order[2]);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_mono_nsec() >= now_nsec + 3000000);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_event_loop_timer_armed(timer_ptrs[0]));
+
+    // Periodic: Destroys itself after the third expiry.
+    shared.calls = 0;
+    states[4].destroy_after = 3;
+    bs_event_loop_timer_arm(timer_ptrs[4], bs_mono_nsec(), 1000000);
+    while (3 > shared.calls && !bs_test_failed(test_ptr)) {
+        BS_TEST_VERIFY_TRUE(
+            test_ptr, 0 <= bs_event_loop_dispatch(loop_ptr, -1));
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 3, states[4].calls);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_event_loop_dispatch(loop_ptr, 5));
+
+    bs_event_loop_destroy(loop_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Arms more timers than the heap's initial capacity, all created idle. */
+void test_timers_many(bs_test_t *test_ptr)
+{
+    struct test_timers_state shared = {}, states[40] = {};
+    bs_event_loop_timer_t *timer_ptrs[40];
+    bs_event_loop_t *loop_ptr = bs_event_loop_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, loop_ptr);
+
+    for (int i = 0; i < 40; ++i) {
+        states[i].idx = i;
+        states[i].shared_ptr = &shared;
+        timer_ptrs[i] = bs_event_loop_timer_create(
+            loop_ptr, test_timers_callback, &states[i]);
+        BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, timer_ptrs[i]);
+    }
+
+    // Armed in reverse order of their deadline.
+    uint64_t now_nsec = bs_mono_nsec();
+    for (int i = 0; i < 40; ++i) {
+        bs_event_loop_timer_arm(timer_ptrs[i], now_nsec + 40 - i, 0);
+    }
+    for (int i = 0; i < 40; ++i) {
+        BS_TEST_VERIFY_TRUE(
+            test_ptr, bs_event_loop_timer_armed(timer_ptrs[i]));
+    }
+
+    int calls = 0;
+    while (40 > calls && !bs_test_failed(test_ptr)) {
+        int rv = bs_event_loop_dispatch(loop_ptr, -1);
+        BS_TEST_VERIFY_TRUE(test_ptr, 0 <= rv);
+        calls += rv;
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 40, calls);
+    for (int i = 0; i < 40; ++i) {
+        BS_TEST_VERIFY_EQ(test_ptr, 1, states[i].calls);
+    }
+    // The first 8 expiries are recorded, in order.
+    for (int i = 0; i < 8; ++i) {
+        BS_TEST_VERIFY_EQ(test_ptr, 39 - i, shared.order[i]);
+    }
+
+    bs_event_loop_destroy(loop_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Callback for @ref test_timers_rearm: Re-arms to a passed deadline. */
+static void test_timers_rearm_callback(bs_event_loop_timer_t *timer_ptr,
+                                       void *ud_ptr)
+{
+    int *calls_ptr = ud_ptr;
+    ++*calls_ptr;
+    bs_event_loop_timer_arm(timer_ptr, 0, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+/** A timer re-armed to a passed deadline is called in the next dispatch. */
+void test_timers_rearm(bs_test_t *test_ptr)
+{
+    int calls = 0;
+    bs_event_loop_t *loop_ptr = bs_event_loop_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, loop_ptr);
+    bs_event_loop_timer_t *timer_ptr = bs_event_loop_timer_create(
+        loop_ptr, test_timers_rearm_callback, &calls);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, timer_ptr);
+
+    bs_event_loop_timer_arm(timer_ptr, 0, 0);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_event_loop_dispatch(loop_ptr, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, calls);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_event_loop_timer_armed(timer_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_event_loop_dispatch(loop_ptr, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, calls);
+
+    bs_event_loop_destroy(loop_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Thread for @ref test_wakeup: Quits the loop. */
+static void *test_wakeup_thread(void *ud_ptr)
+{
+    bs_event_loop_t *loop_ptr = ud_ptr;
+    usleep(10000);
+    bs_event_loop_quit(loop_ptr);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Wakes up a waiting loop, from the same thread and from another. */
+void test_wakeup(bs_test_t *test_ptr)
+{
+    pthread_t thread;
+    bs_event_loop_t *loop_ptr = bs_event_loop_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, loop_ptr);
+
+    // A pending wakeup makes dispatch return right away, and is consumed.
+    bs_event_loop_wakeup(loop_ptr);
+    bs_event_loop_wakeup(loop_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_event_loop_dispatch(loop_ptr, -1));
+    uint64_t start_nsec = bs_mono_nsec();
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_event_loop_dispatch(loop_ptr, 10));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_mono_nsec() >= start_nsec + 10000000);
+
+    BS_TEST_VERIFY_EQ_OR_RETURN(
+        test_ptr, 0,
+        pthread_create(&thread, NULL, test_wakeup_thread, loop_ptr));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_event_loop_run(loop_ptr));
+    pthread_join(thread, NULL);
+
+    bs_event_loop_destroy(loop_ptr);
+}
+
+/** State for @ref test_sock_reader. */
+struct test_sock_reader_state {
+    /** The reader. */
+    bs_sock_reader_t          *reader_ptr;
+    /** Lines read. */
+    int                       lines;
+    /** The loop, to quit once the peer closes. */
+    bs_event_loop_t           *loop_ptr;
+};
+
+/* ------------------------------------------------------------------------- */
+/** Callback for @ref test_sock_reader: Reads all buffered lines. */
+static void test_sock_reader_callback(
+    __UNUSED__ int fd,
+    __UNUSED__ uint32_t events,
+    void *ud_ptr)
+{
+    struct test_sock_reader_state *state_ptr = ud_ptr;
+    char line[16];
+    ssize_t rv;
+    while (0 < (rv = bs_sock_reader_read_until(
+                    state_ptr->reader_ptr, '\n', line, sizeof(line), 0))) {
+        ++state_ptr->lines;
+    }
+    if (0 > rv && EPIPE == errno) bs_event_loop_quit(state_ptr->loop_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Plugs a @ref bs_sock_reader_t into the loop. */
+void test_sock_reader(bs_test_t *test_ptr)
+{
+    int fds[2];
+    BS_TEST_VERIFY_EQ_OR_RETURN(
+        test_ptr, 0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    bs_sock_set_blocking(fds[0], false);
+    struct test_sock_reader_state state = {
+        .reader_ptr = bs_sock_reader_create(fds[0], 0),
+        .loop_ptr = bs_event_loop_create()
+    };
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, state.reader_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, state.loop_ptr);
+
+    BS_TEST_VERIFY_NEQ(
+        test_ptr, NULL,
+        bs_event_loop_add_fd(state.loop_ptr, fds[0], BS_EVENT_LOOP_READABLE,
+                             test_sock_reader_callback, &state));
+    BS_TEST_VERIFY_EQ(test_ptr, 11, write(fds[1], "one\ntwo\nthr", 11));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_event_loop_dispatch(state.loop_ptr, 100));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, state.lines);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, write(fds[1], "ee\n", 3));
+    close(fds[1]);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_event_loop_run(state.loop_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, state.lines);
+
+    bs_event_loop_destroy(state.loop_ptr);
+    bs_sock_reader_destroy(state.reader_ptr);
+    close(fds[0]);
+}
+
+/** State for @ref test_subprocess_manager. */
+struct test_subprocess_manager_state {
+    /** The manager. */
+    bs_subprocess_manager_t   *manager_ptr;
+    /** The loop, to quit once the subprocess terminated. */
+    bs_event_loop_t           *loop_ptr;
+    /** Exit status of the subprocess. */
+    int                       exit_status;
+};
+
+/* ------------------------------------------------------------------------- */
+/** Callback for @ref test_subprocess_manager: Dispatches the manager. */
+static void test_subprocess_manager_callback(
+    __UNUSED__ int fd,
+    __UNUSED__ uint32_t events,
+    void *ud_ptr)
+{
+    struct test_subprocess_manager_state *state_ptr = ud_ptr;
+    bs_subprocess_manager_dispatch(state_ptr->manager_ptr, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Terminated callback for @ref test_subprocess_manager. */
+static void test_subprocess_manager_terminated(
+    __UNUSED__ bs_subprocess_t *subprocess_ptr,
+    int exit_status,
+    __UNUSED__ int signal_number,
+    void *ud_ptr)
+{
+    struct test_subprocess_manager_state *state_ptr = ud_ptr;
+    state_ptr->exit_status = exit_status;
+    bs_event_loop_quit(state_ptr->loop_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Plugs a @ref bs_subprocess_manager_t into the loop. */
+void test_subprocess_manager(bs_test_t *test_ptr)
+{
+    struct test_subprocess_manager_state state = {
+        .manager_ptr = bs_subprocess_manager_create(),
+        .loop_ptr = bs_event_loop_create()
+    };
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, state.manager_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, state.loop_ptr);
+    bs_subprocess_t *sp_ptr = bs_subprocess_create_cmdline(
+        "./subprocess_test_failure");
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, sp_ptr);
+
+    BS_TEST_VERIFY_NEQ(
+        test_ptr, NULL,
+        bs_event_loop_add_fd(
+            state.loop_ptr, bs_subprocess_manager_fd(state.manager_ptr),
+            BS_EVENT_LOOP_READABLE, test_subprocess_manager_callback, &state));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_subprocess_start(sp_ptr));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_subprocess_manager_add(state.manager_ptr, sp_ptr,
+                                  test_subprocess_manager_terminated, &state));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_event_loop_run(state.loop_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 42, state.exit_status);
+
+    bs_subprocess_destroy(sp_ptr);
+    bs_event_loop_destroy(state.loop_ptr);
+    bs_subprocess_manager_destroy(state.manager_ptr);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_timers(bs_test_t *test_ptr);
+static void benchmark_wakeup(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_event_loop_benchmarks[] = {
+    { 1, "benchmark-timers-1024", benchmark_timers },
+    { 1, "benchmark-wakeup", benchmark_wakeup },
+    { 0, NULL, NULL }
+};
+
+/** Argument to @ref _benchmark_timers_fn. */
+struct _benchmark_timers_arg {
+    /** The loop. */
+    bs_event_loop_t           *loop_ptr;
+    /** The timers, all armed. */
+    bs_event_loop_timer_t     *timer_ptrs[1024];
+};
+
+/* ------------------------------------------------------------------------- */
+/** Does nothing: Timers of the benchmark never expire. */
+static void _benchmark_timer_callback(
+    __UNUSED__ bs_event_loop_timer_t *timer_ptr,
+    __UNUSED__ void *ud_ptr)
+{
+}
+
+/* ------------------------------------------------------------------------- */
+/** Re-arms timers of a heap of 1024, `iterations` times. */
+static void _benchmark_timers_fn(void *arg_ptr, uint64_t iterations)
+{
+    struct _benchmark_timers_arg *timers_arg_ptr = arg_ptr;
+    uint64_t deadline_nsec = UINT64_MAX / 2;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        // A pseudo-random deadline, to move within the heap.
+        deadline_nsec = deadline_nsec * 6364136223846793005ULL + 1;
+        bs_event_loop_timer_arm(timers_arg_ptr->timer_ptrs[i & 1023],
+                                (deadline_nsec >> 2) + (UINT64_MAX >> 2), 0);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_timers(bs_test_t *test_ptr)
+{
+    struct _benchmark_timers_arg arg = {
+        .loop_ptr = bs_event_loop_create()
+    };
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, arg.loop_ptr);
+    for (int i = 0; i < 1024; ++i) {
+        arg.timer_ptrs[i] = bs_event_loop_timer_create(
+            arg.loop_ptr, _benchmark_timer_callback, NULL);
+        BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, arg.timer_ptrs[i]);
+        bs_event_loop_timer_arm(arg.timer_ptrs[i], UINT64_MAX - i, 0);
+    }
+    if (!bs_test_bench(test_ptr, "bs_event_loop_timer_arm",
+                       _benchmark_timers_fn, &arg, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(timer_arm)");
+    }
+    bs_event_loop_destroy(arg.loop_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Wakes up and dispatches the loop, `iterations` times. */
+static void _benchmark_wakeup_fn(void *arg_ptr, uint64_t iterations)
+{
+    bs_event_loop_t *loop_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_event_loop_wakeup(loop_ptr);
+        bs_event_loop_dispatch(loop_ptr, -1);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_wakeup(bs_test_t *test_ptr)
+{
+    bs_event_loop_t *loop_ptr = bs_event_loop_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, loop_ptr);
+    if (!bs_test_bench(test_ptr, "bs_event_loop_wakeup",
+                       _benchmark_wakeup_fn, loop_ptr, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(wakeup)");
+    }
+    bs_event_loop_destroy(loop_ptr);
+}
+
+/** @endcond */
+/* == End of event_loop.c ================================================== */
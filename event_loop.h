@@ -0,0 +1,207 @@
+/* ========================================================================= */
+/**
+ * @file event_loop.h
+ * An event loop: Multiplexes file descriptors, timers and wakeups.
+ *
+ * File descriptors are watched with epoll(7). Timers are kept in a binary
+ * heap, ordered by their deadline from @ref bs_mono_nsec, and bound the
+ * timeout of epoll_wait(2). Other threads can wake up a waiting loop through
+ * an eventfd(2), with @ref bs_event_loop_wakeup and @ref bs_event_loop_quit.
+ *
+ * Modules with their own file descriptor plug in by watching it: Eg. the
+ * @ref bs_subprocess_manager_fd is readable when
+ * @ref bs_subprocess_manager_dispatch has work, and a @ref bs_sock_reader_t
+ * gets filled when its socket is readable.
+ *
+ * Except for @ref bs_event_loop_wakeup and @ref bs_event_loop_quit, all
+ * methods must be called from the thread running the loop.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_EVENT_LOOP_H__
+#define __LIBBASE_EVENT_LOOP_H__
+
+#include "test.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Forward declaration: The event loop. */
+typedef struct _bs_event_loop_t bs_event_loop_t;
+/** Forward declaration: A file descriptor, watched by the loop. */
+typedef struct _bs_event_loop_fd_t bs_event_loop_fd_t;
+/** Forward declaration: A timer. */
+typedef struct _bs_event_loop_timer_t bs_event_loop_timer_t;
+
+/** Events on a file descriptor. */
+typedef enum {
+    /** The file descriptor is readable. */
+    BS_EVENT_LOOP_READABLE = 1 << 0,
+    /** The file descriptor is writable. */
+    BS_EVENT_LOOP_WRITABLE = 1 << 1,
+    /** Error or hang-up. Reported even if not requested. */
+    BS_EVENT_LOOP_ERROR = 1 << 2
+} bs_event_loop_events_t;
+
+/**
+ * Callback for events on a watched file descriptor.
+ *
+ * The callback may modify or remove any watched file descriptor, including
+ * its own, and may arm, disarm or destroy any timer.
+ *
+ * @param fd
+ * @param events              A bitmask of @ref bs_event_loop_events_t.
+ * @param ud_ptr              As provided to @ref bs_event_loop_add_fd.
+ */
+typedef void (*bs_event_loop_fd_callback_t)(
+    int fd,
+    uint32_t events,
+    void *ud_ptr);
+
+/**
+ * Callback for an expired timer.
+ *
+ * The callback may re-arm, disarm or destroy any timer, including its own.
+ *
+ * @param timer_ptr
+ * @param ud_ptr              As provided to @ref bs_event_loop_timer_create.
+ */
+typedef void (*bs_event_loop_timer_callback_t)(
+    bs_event_loop_timer_t *timer_ptr,
+    void *ud_ptr);
+
+/**
+ * Creates an event loop.
+ *
+ * @return A pointer to the event loop, or NULL on error. Must be destroyed
+ *     by @ref bs_event_loop_destroy.
+ */
+bs_event_loop_t *bs_event_loop_create(void);
+
+/**
+ * Destroys the event loop. Removes all watched file descriptors, and
+ * destroys all timers. Does not close the file descriptors.
+ */
+void bs_event_loop_destroy(bs_event_loop_t *loop_ptr);
+
+/**
+ * Watches `fd` for `events`.
+ *
+ * @param loop_ptr
+ * @param fd                  The file descriptor. Stays owned by the caller,
+ *                            and must remain open while watched.
+ * @param events              A bitmask of @ref BS_EVENT_LOOP_READABLE and
+ *                            @ref BS_EVENT_LOOP_WRITABLE.
+ * @param callback
+ * @param ud_ptr
+ *
+ * @return A handle to the watch, or NULL on error. Must be released by
+ *     @ref bs_event_loop_remove_fd, or by @ref bs_event_loop_destroy.
+ */
+bs_event_loop_fd_t *bs_event_loop_add_fd(
+    bs_event_loop_t *loop_ptr,
+    int fd,
+    uint32_t events,
+    bs_event_loop_fd_callback_t callback,
+    void *ud_ptr);
+
+/** Changes the events watched for. Returns whether it succeeded. */
+bool bs_event_loop_modify_fd(bs_event_loop_fd_t *fd_ptr, uint32_t events);
+
+/** Stops watching the file descriptor, and releases the handle. */
+void bs_event_loop_remove_fd(bs_event_loop_fd_t *fd_ptr);
+
+/**
+ * Creates a timer. It is not armed.
+ *
+ * @param loop_ptr
+ * @param callback
+ * @param ud_ptr
+ *
+ * @return A pointer to the timer, or NULL on error. Must be destroyed by
+ *     @ref bs_event_loop_timer_destroy, or by @ref bs_event_loop_destroy.
+ */
+bs_event_loop_timer_t *bs_event_loop_timer_create(
+    bs_event_loop_t *loop_ptr,
+    bs_event_loop_timer_callback_t callback,
+    void *ud_ptr);
+
+/** Destroys the timer. Disarms it first, if armed. */
+void bs_event_loop_timer_destroy(bs_event_loop_timer_t *timer_ptr);
+
+/**
+ * Arms the timer, or re-arms it if already armed.
+ *
+ * @param timer_ptr
+ * @param deadline_nsec       When to expire, in @ref bs_mono_nsec time.
+ * @param period_nsec         If non-zero, the timer re-arms itself for
+ *                            `period_nsec` after each expiry. If the loop
+ *                            fell behind, skipped periods are not caught up.
+ */
+void bs_event_loop_timer_arm(bs_event_loop_timer_t *timer_ptr,
+                             uint64_t deadline_nsec,
+                             uint64_t period_nsec);
+
+/** Disarms the timer. No-op if it is not armed. */
+void bs_event_loop_timer_disarm(bs_event_loop_timer_t *timer_ptr);
+
+/** Returns whether the timer is armed. */
+bool bs_event_loop_timer_armed(const bs_event_loop_timer_t *timer_ptr);
+
+/**
+ * Waits for events, up to `timeout_msec` or the next timer's deadline, and
+ * calls the callbacks of the events and of all expired timers.
+ *
+ * @param loop_ptr
+ * @param timeout_msec        Timeout, in milliseconds. 0 to not wait, and
+ *                            a negative value to wait until the next event.
+ *
+ * @return The number of callbacks called, or -1 on error.
+ */
+int bs_event_loop_dispatch(bs_event_loop_t *loop_ptr, int timeout_msec);
+
+/**
+ * Dispatches events, until @ref bs_event_loop_quit is called.
+ *
+ * @return true if quit, false on error.
+ */
+bool bs_event_loop_run(bs_event_loop_t *loop_ptr);
+
+/**
+ * Wakes up the loop, if it is waiting in @ref bs_event_loop_dispatch.
+ * Otherwise, the next dispatch returns without waiting. Thread-safe.
+ */
+void bs_event_loop_wakeup(bs_event_loop_t *loop_ptr);
+
+/** Makes @ref bs_event_loop_run return, and wakes up. Thread-safe. */
+void bs_event_loop_quit(bs_event_loop_t *loop_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_event_loop_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_event_loop_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_EVENT_LOOP_H__ */
+/* == End of event_loop.h ================================================== */
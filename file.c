@@ -18,21 +18,112 @@
  * limitations under the License.
  */
 
+/// O_TMPFILE, fallocate(2) and syncfs(2) are Linux extensions.
+#define _GNU_SOURCE
+
 #include "file.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include "def.h"
+#include "dllist.h"
+#include "hashmap.h"
 #include "log.h"
+#include "log_wrappers.h"
 #include "strutil.h"
+#include "time.h"
+
+#undef _GNU_SOURCE
 
 /* == Declarations ========================================================= */
 
+/** Initial buffer size for files that do not report their size. */
+static const size_t           _file_read_initial_size = 4096;
+
+/** A pending atomic write: The temporary file, not yet renamed. */
+typedef struct {
+    /** Node within @ref bs_file_batch_t::writes. */
+    bs_dllist_node_t          dlnode;
+    /** Name of the target file. */
+    char                      *fname_ptr;
+    /** Name of the temporary file. NULL, if an unnamed O_TMPFILE. */
+    char                      *tmp_fname_ptr;
+    /** File descriptor of the unnamed temporary file, or -1. */
+    int                       fd;
+    /** Device of the file system holding the file. */
+    dev_t                     dev;
+} _file_write_t;
+
+/** State of the batch. */
+struct _bs_file_batch_t {
+    /** Pending writes, of @ref _file_write_t::dlnode. */
+    bs_dllist_t               writes;
+};
+
+/** State of the lookup cache. */
+struct _bs_file_lookup_cache_t {
+    /** The search paths: A NULL-terminated copy. */
+    char                      **paths_ptr_ptr;
+    /** Cached lookups, of @ref _file_lookup_t. */
+    bs_hashmap_t              *hashmap_ptr;
+    /** The inotify(7) file descriptor, or -1. */
+    int                       inotify_fd;
+};
+
+/** Key of a cached lookup. */
+typedef struct {
+    /** Name of the file that was looked up. */
+    const char                *fname_ptr;
+    /** Mode, as passed to @ref bs_file_lookup_cache_lookup. */
+    int                       mode;
+} _file_lookup_key_t;
+
+/** A cached lookup. */
+typedef struct {
+    /** Node within @ref bs_file_lookup_cache_t::hashmap_ptr. */
+    bs_hashmap_node_t         node;
+    /** Mode of the lookup. */
+    int                       mode;
+    /** Resolved path, or NULL if the lookup failed. */
+    char                      *resolved_path_ptr;
+    /** Name of the file that was looked up. Allocated along the node. */
+    char                      fname[];
+} _file_lookup_t;
+
+static ssize_t _file_read_fd(int fd, char *buf_ptr, size_t count);
+static ssize_t _file_write_fd(int fd, const char *buf_ptr, size_t count);
+static char *_file_read_all(int fd,
+                            const struct stat *stat_ptr,
+                            const char *fname_ptr,
+                            size_t *size_ptr);
+static _file_write_t *_file_write_create(const char *fname_ptr,
+                                         unsigned flags);
+static void _file_write_destroy(_file_write_t *write_ptr);
+static bool _file_write_publish(_file_write_t *write_ptr);
+static bool _file_sync_dir(const char *fname_ptr, bool syncfs_all);
+static void _file_dirname(const char *fname_ptr, char *dir_ptr);
+static uint64_t _file_lookup_hash(const void *key_ptr);
+static bool _file_lookup_equals(const bs_hashmap_node_t *node_ptr,
+                                const void *key_ptr);
+static void _file_lookup_destroy(bs_hashmap_node_t *node_ptr);
+static void _file_lookup_cache_watch(bs_file_lookup_cache_t *cache_ptr,
+                                     const char *path_ptr,
+                                     const char *fname_ptr);
+static bool _file_lookup_cache_add_watch(bs_file_lookup_cache_t *cache_ptr,
+                                         const char *dir_ptr);
+
 /* == Exported methods ===================================================== */
 
 /* ------------------------------------------------------------------------- */
@@ -51,11 +142,11 @@ ssize_t bs_file_read_buffer(
         return -1;
     }
 
-    read_bytes = read(fd, buf_ptr, buf_len);
+    read_bytes = _file_read_fd(fd, buf_ptr, buf_len);
     if (0 > read_bytes) {
         bs_log(BS_WARNING | BS_ERRNO, "Failed read(%d, %p, %zu) from %s",
                fd, buf_ptr, buf_len - 1, fname_ptr);
-    } if ((size_t)read_bytes >= buf_len) {
+    } else if ((size_t)read_bytes >= buf_len) {
         bs_log(BS_WARNING | BS_ERRNO,
                "Read %zd >= %zu bytes. Too much data in %s",
                read_bytes, buf_len, fname_ptr);
@@ -73,6 +164,99 @@ ssize_t bs_file_read_buffer(
     return read_bytes;
 }
 
+/* ------------------------------------------------------------------------- */
+char *bs_file_read(const char *fname_ptr, size_t *size_ptr)
+{
+    struct stat               stat_buf;
+    char                      *buf_ptr = NULL;
+    int                       fd;
+
+    fd = open(fname_ptr, O_RDONLY | O_CLOEXEC);
+    if (0 > fd) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed open(%s, O_RDONLY)",
+               fname_ptr);
+        return NULL;
+    }
+
+    if (0 != fstat(fd, &stat_buf)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed fstat(%d) for %s",
+               fd, fname_ptr);
+    } else {
+        buf_ptr = _file_read_all(fd, &stat_buf, fname_ptr, size_ptr);
+    }
+
+    if (0 != close(fd)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed close(%d) for %s", fd,
+               fname_ptr);
+    }
+    return buf_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_file_map(const char *fname_ptr, bs_file_mapping_t *mapping_ptr)
+{
+    struct stat               stat_buf;
+    bool                      rv = false;
+    int                       fd;
+
+    *mapping_ptr = (bs_file_mapping_t){};
+    fd = open(fname_ptr, O_RDONLY | O_CLOEXEC);
+    if (0 > fd) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed open(%s, O_RDONLY)",
+               fname_ptr);
+        return false;
+    }
+
+    if (0 != fstat(fd, &stat_buf)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed fstat(%d) for %s",
+               fd, fname_ptr);
+    } else if (S_ISREG(stat_buf.st_mode) && 0 < stat_buf.st_size) {
+        void *data_ptr = mmap(NULL, stat_buf.st_size, PROT_READ, MAP_PRIVATE,
+                              fd, 0);
+        if (MAP_FAILED == data_ptr) {
+            bs_log(BS_WARNING | BS_ERRNO,
+                   "Failed mmap(NULL, %jd, PROT_READ, MAP_PRIVATE, %d, 0) "
+                   "for %s", (intmax_t)stat_buf.st_size, fd, fname_ptr);
+        } else {
+            if (0 != madvise(data_ptr, stat_buf.st_size, MADV_SEQUENTIAL)) {
+                bs_log(BS_DEBUG | BS_ERRNO,
+                       "Failed madvise(%p, %jd, MADV_SEQUENTIAL) for %s",
+                       data_ptr, (intmax_t)stat_buf.st_size, fname_ptr);
+            }
+            mapping_ptr->data_ptr = data_ptr;
+            mapping_ptr->size = stat_buf.st_size;
+            mapping_ptr->mapped = true;
+            rv = true;
+        }
+    } else {
+        // Pipes, devices and files in /proc: Nothing to map. Read instead.
+        mapping_ptr->data_ptr = _file_read_all(
+            fd, &stat_buf, fname_ptr, &mapping_ptr->size);
+        rv = NULL != mapping_ptr->data_ptr;
+    }
+
+    // The mapping remains valid after closing the file descriptor.
+    if (0 != close(fd)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed close(%d) for %s", fd,
+               fname_ptr);
+    }
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_file_unmap(bs_file_mapping_t *mapping_ptr)
+{
+    if (mapping_ptr->mapped) {
+        if (0 != munmap((void*)mapping_ptr->data_ptr, mapping_ptr->size)) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed munmap(%p, %zu)",
+                   mapping_ptr->data_ptr, mapping_ptr->size);
+        }
+    } else if (NULL != mapping_ptr->data_ptr) {
+        logged_free((void*)mapping_ptr->data_ptr);
+    }
+    *mapping_ptr = (bs_file_mapping_t){};
+}
+
 /* ------------------------------------------------------------------------- */
 ssize_t bs_file_write_buffer(
     const char *fname_ptr,
@@ -107,6 +291,134 @@ ssize_t bs_file_write_buffer(
     return written_bytes;
 }
 
+/* ------------------------------------------------------------------------- */
+bool bs_file_write_atomic(
+    const char *fname_ptr,
+    const void *buf_ptr,
+    size_t buf_len,
+    unsigned flags,
+    bs_file_batch_t *batch_ptr)
+{
+    _file_write_t *write_ptr = _file_write_create(fname_ptr, flags);
+    if (NULL == write_ptr) return false;
+    int fd = write_ptr->fd;
+    if (NULL != write_ptr->tmp_fname_ptr) {
+        fd = open(write_ptr->tmp_fname_ptr, O_WRONLY | O_CLOEXEC);
+        if (0 > fd) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed open(%s, O_WRONLY)",
+                   write_ptr->tmp_fname_ptr);
+            _file_write_destroy(write_ptr);
+            return false;
+        }
+    }
+
+    bool rv = true;
+    if ((flags & BS_FILE_ATOMIC_PREALLOCATE) && 0 < buf_len) {
+        if (0 != fallocate(fd, 0, 0, buf_len) && EOPNOTSUPP != errno) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed fallocate(%d, 0, 0, %zu) "
+                   "for %s", fd, buf_len, fname_ptr);
+            rv = false;
+        }
+    }
+    if (rv && (ssize_t)buf_len != _file_write_fd(fd, buf_ptr, buf_len)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed write(%d, %p, %zu) for %s",
+               fd, buf_ptr, buf_len, fname_ptr);
+        rv = false;
+    }
+    // Without a batch: The data must be durable before the rename is.
+    if (rv && NULL == batch_ptr && 0 != fdatasync(fd)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed fdatasync(%d) for %s",
+               fd, fname_ptr);
+        rv = false;
+    }
+    if (fd != write_ptr->fd && 0 != close(fd)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed close(%d) for %s",
+               fd, write_ptr->tmp_fname_ptr);
+        rv = false;
+    }
+
+    if (!rv) {
+        _file_write_destroy(write_ptr);
+        return false;
+    }
+    if (NULL != batch_ptr) {
+        bs_dllist_push_back(&batch_ptr->writes, &write_ptr->dlnode);
+        return true;
+    }
+    rv = _file_write_publish(write_ptr) && _file_sync_dir(fname_ptr, false);
+    _file_write_destroy(write_ptr);
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+bs_file_batch_t *bs_file_batch_create(void)
+{
+    return logged_calloc(1, sizeof(bs_file_batch_t));
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_file_batch_destroy(bs_file_batch_t *batch_ptr)
+{
+    bs_dllist_node_t *dlnode_ptr;
+    while (NULL != (dlnode_ptr = bs_dllist_pop_front(&batch_ptr->writes))) {
+        _file_write_t *write_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, _file_write_t, dlnode);
+        _file_write_destroy(write_ptr);
+    }
+    logged_free(batch_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_file_batch_size(bs_file_batch_t *batch_ptr)
+{
+    return bs_dllist_size(&batch_ptr->writes);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_file_batch_commit(bs_file_batch_t *batch_ptr)
+{
+    bs_dllist_node_t *dlnode_ptr;
+    bool rv = true;
+
+    // Syncs each file system once, before and after renaming. Writes are
+    // ordered, so that each file system is synced for its first write.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (dlnode_ptr = batch_ptr->writes.head_ptr;
+             NULL != dlnode_ptr;
+             dlnode_ptr = dlnode_ptr->next_ptr) {
+            _file_write_t *write_ptr = BS_CONTAINER_OF(
+                dlnode_ptr, _file_write_t, dlnode);
+            bool synced = false;
+            for (bs_dllist_node_t *prev_ptr = batch_ptr->writes.head_ptr;
+                 prev_ptr != dlnode_ptr && !synced;
+                 prev_ptr = prev_ptr->next_ptr) {
+                _file_write_t *prev_write_ptr = BS_CONTAINER_OF(
+                    prev_ptr, _file_write_t, dlnode);
+                synced = prev_write_ptr->dev == write_ptr->dev;
+            }
+            if (!synced && !_file_sync_dir(write_ptr->fname_ptr, true)) {
+                rv = false;
+            }
+        }
+        if (0 < pass) break;
+
+        for (dlnode_ptr = batch_ptr->writes.head_ptr;
+             NULL != dlnode_ptr;
+             dlnode_ptr = dlnode_ptr->next_ptr) {
+            _file_write_t *write_ptr = BS_CONTAINER_OF(
+                dlnode_ptr, _file_write_t, dlnode);
+            if (!_file_write_publish(write_ptr)) rv = false;
+        }
+    }
+
+    while (NULL != (dlnode_ptr = bs_dllist_pop_front(&batch_ptr->writes))) {
+        _file_write_t *write_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, _file_write_t, dlnode);
+        _file_write_destroy(write_ptr);
+    }
+    return rv;
+}
+
 /* ------------------------------------------------------------------------- */
 char *bs_file_resolve_path(
     const char *path_ptr,
@@ -173,23 +485,574 @@ char *bs_file_resolve_and_lookup_from_paths(
                 return resolved_path_ptr;
             }
         }
-        if (NULL == resolved_path_buf_ptr) free(resolved_path_ptr);
+        if (NULL == resolved_path_buf_ptr) logged_free(resolved_path_ptr);
     }
     return NULL;
 }
 
+/* ------------------------------------------------------------------------- */
+bs_file_lookup_cache_t *bs_file_lookup_cache_create(
+    const char **paths_ptr_ptr,
+    bool watch)
+{
+    bs_file_lookup_cache_t *cache_ptr = logged_calloc(
+        1, sizeof(bs_file_lookup_cache_t));
+    if (NULL == cache_ptr) return NULL;
+    cache_ptr->inotify_fd = -1;
+
+    size_t paths = 0;
+    while (NULL != paths_ptr_ptr[paths]) ++paths;
+    cache_ptr->paths_ptr_ptr = logged_calloc(paths + 1, sizeof(char*));
+    if (NULL == cache_ptr->paths_ptr_ptr) {
+        bs_file_lookup_cache_destroy(cache_ptr);
+        return NULL;
+    }
+    for (size_t i = 0; i < paths; ++i) {
+        cache_ptr->paths_ptr_ptr[i] = logged_strdup(paths_ptr_ptr[i]);
+        if (NULL == cache_ptr->paths_ptr_ptr[i]) {
+            bs_file_lookup_cache_destroy(cache_ptr);
+            return NULL;
+        }
+    }
+
+    if (!watch) return cache_ptr;
+    cache_ptr->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (0 > cache_ptr->inotify_fd) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed inotify_init1()");
+        bs_file_lookup_cache_destroy(cache_ptr);
+        return NULL;
+    }
+    for (size_t i = 0; i < paths; ++i) {
+        _file_lookup_cache_watch(cache_ptr, paths_ptr_ptr[i], NULL);
+    }
+    return cache_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_file_lookup_cache_destroy(bs_file_lookup_cache_t *cache_ptr)
+{
+    if (0 <= cache_ptr->inotify_fd) close(cache_ptr->inotify_fd);
+    if (NULL != cache_ptr->hashmap_ptr) {
+        bs_hashmap_destroy(cache_ptr->hashmap_ptr);
+    }
+    if (NULL != cache_ptr->paths_ptr_ptr) {
+        for (char **p_ptr = cache_ptr->paths_ptr_ptr; NULL != *p_ptr; ++p_ptr) {
+            logged_free(*p_ptr);
+        }
+        logged_free(cache_ptr->paths_ptr_ptr);
+    }
+    logged_free(cache_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+const char *bs_file_lookup_cache_lookup(
+    bs_file_lookup_cache_t *cache_ptr,
+    const char *fname_ptr,
+    int mode)
+{
+    if (NULL == cache_ptr->hashmap_ptr) {
+        cache_ptr->hashmap_ptr = bs_hashmap_create(
+            _file_lookup_hash, _file_lookup_equals, _file_lookup_destroy);
+        if (NULL == cache_ptr->hashmap_ptr) return NULL;
+    }
+
+    _file_lookup_key_t key = { .fname_ptr = fname_ptr, .mode = mode };
+    bs_hashmap_node_t *node_ptr = bs_hashmap_lookup(
+        cache_ptr->hashmap_ptr, &key);
+    if (NULL != node_ptr) {
+        _file_lookup_t *lookup_ptr = BS_CONTAINER_OF(
+            node_ptr, _file_lookup_t, node);
+        return lookup_ptr->resolved_path_ptr;
+    }
+
+    size_t len = strlen(fname_ptr);
+    _file_lookup_t *lookup_ptr = logged_calloc(
+        1, sizeof(_file_lookup_t) + len + 1);
+    if (NULL == lookup_ptr) return NULL;
+    memcpy(lookup_ptr->fname, fname_ptr, len + 1);
+    lookup_ptr->mode = mode;
+    // Watches subdirectories before resolving, to not miss a change between.
+    if (0 <= cache_ptr->inotify_fd && NULL != strchr(fname_ptr, '/')) {
+        for (char **p_ptr = cache_ptr->paths_ptr_ptr; NULL != *p_ptr; ++p_ptr) {
+            _file_lookup_cache_watch(cache_ptr, *p_ptr, fname_ptr);
+        }
+    }
+    lookup_ptr->resolved_path_ptr = bs_file_resolve_and_lookup_from_paths(
+        fname_ptr, (const char**)cache_ptr->paths_ptr_ptr, mode, NULL);
+    if (!bs_hashmap_insert(cache_ptr->hashmap_ptr, &key, &lookup_ptr->node,
+                           false)) {
+        _file_lookup_destroy(&lookup_ptr->node);
+        return NULL;
+    }
+    return lookup_ptr->resolved_path_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_file_lookup_cache_flush(bs_file_lookup_cache_t *cache_ptr)
+{
+    if (NULL == cache_ptr->hashmap_ptr) return;
+    bs_hashmap_destroy(cache_ptr->hashmap_ptr);
+    // Re-created on the next lookup.
+    cache_ptr->hashmap_ptr = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+int bs_file_lookup_cache_fd(bs_file_lookup_cache_t *cache_ptr)
+{
+    return cache_ptr->inotify_fd;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_file_lookup_cache_handle_events(bs_file_lookup_cache_t *cache_ptr)
+{
+    if (0 > cache_ptr->inotify_fd) return false;
+
+    // Any event invalidates. Events are only drained, not inspected.
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    for (;;) {
+        ssize_t read_bytes = read(cache_ptr->inotify_fd, buf, sizeof(buf));
+        if (0 < read_bytes) {
+            changed = true;
+            continue;
+        }
+        if (0 > read_bytes && EINTR == errno) continue;
+        if (0 > read_bytes && EAGAIN != errno) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed read(%d, %p, %zu)",
+                   cache_ptr->inotify_fd, buf, sizeof(buf));
+            // Events may be lost. Better flush.
+            changed = true;
+        }
+        break;
+    }
+    if (changed) bs_file_lookup_cache_flush(cache_ptr);
+    return changed;
+}
+
 /* == Static (local) functions ============================================= */
 
+/* ------------------------------------------------------------------------- */
+/**
+ * Reads from `fd` into `buf_ptr`, until `count` bytes are read or the end of
+ * file is reached. Retries on short reads and on EINTR.
+ *
+ * @return The number of bytes read, or -1 on error.
+ */
+ssize_t _file_read_fd(int fd, char *buf_ptr, size_t count)
+{
+    size_t pos = 0;
+    while (pos < count) {
+        ssize_t read_bytes = read(fd, buf_ptr + pos, count - pos);
+        if (0 > read_bytes) {
+            if (EINTR == errno) continue;
+            return -1;
+        }
+        if (0 == read_bytes) break;
+        pos += read_bytes;
+    }
+    return pos;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Writes `count` bytes from `buf_ptr` to `fd`. Retries on short writes and
+ * on EINTR.
+ *
+ * @return The number of bytes written, or -1 on error.
+ */
+ssize_t _file_write_fd(int fd, const char *buf_ptr, size_t count)
+{
+    size_t pos = 0;
+    while (pos < count) {
+        ssize_t written_bytes = write(fd, buf_ptr + pos, count - pos);
+        if (0 > written_bytes) {
+            if (EINTR == errno) continue;
+            return -1;
+        }
+        pos += written_bytes;
+    }
+    return pos;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Reads all of `fd` into a newly allocated, NUL-terminated buffer.
+ *
+ * @param fd
+ * @param stat_ptr            Status of `fd`. Used to size the buffer.
+ * @param fname_ptr           Name of the file, for logging.
+ * @param size_ptr            Optional. Stores the number of bytes read.
+ *
+ * @return A pointer to the buffer, to be released with free(3), or NULL.
+ */
+char *_file_read_all(int fd,
+                     const struct stat *stat_ptr,
+                     const char *fname_ptr,
+                     size_t *size_ptr)
+{
+    // One byte more than the size: The trailing NUL, and a read that finds
+    // the end of file without growing the buffer.
+    size_t capacity = _file_read_initial_size;
+    if (S_ISREG(stat_ptr->st_mode) && 0 < stat_ptr->st_size) {
+        capacity = stat_ptr->st_size + 1;
+    }
+    size_t size = 0;
+    char *buf_ptr = NULL;
+
+    for (;;) {
+        char *new_buf_ptr = realloc(buf_ptr, capacity);
+        if (NULL == new_buf_ptr) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed realloc(%p, %zu) for %s",
+                   buf_ptr, capacity, fname_ptr);
+            break;
+        }
+        buf_ptr = new_buf_ptr;
+
+        ssize_t read_bytes = _file_read_fd(
+            fd, buf_ptr + size, capacity - size);
+        if (0 > read_bytes) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed read(%d, %p, %zu) from %s",
+                   fd, buf_ptr + size, capacity - size, fname_ptr);
+            break;
+        }
+        size += read_bytes;
+        if (size < capacity) {
+            buf_ptr[size] = '\0';
+            if (NULL != size_ptr) *size_ptr = size;
+            return buf_ptr;
+        }
+        // The file is larger than it told. Grows geometrically.
+        capacity *= 2;
+    }
+
+    if (NULL != buf_ptr) logged_free(buf_ptr);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Creates the temporary file for an atomic write to `fname_ptr`.
+ *
+ * @param fname_ptr
+ * @param flags               See @ref bs_file_write_atomic.
+ *
+ * @return A pointer to the pending write, or NULL on error. Must be destroyed
+ *     by @ref _file_write_destroy. An unnamed temporary file is kept open,
+ *     a named one is closed.
+ */
+_file_write_t *_file_write_create(const char *fname_ptr, unsigned flags)
+{
+    char dir[PATH_MAX];
+    struct stat stat_buf;
+
+    if (strlen(fname_ptr) + 8 > PATH_MAX) {
+        bs_log(BS_WARNING, "Path too long: %s", fname_ptr);
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    _file_dirname(fname_ptr, dir);
+    // Set by fchmod(2) on either path, so the umask does not apply.
+    mode_t mode = 0644;
+    if (0 == stat(fname_ptr, &stat_buf)) mode = stat_buf.st_mode & 07777;
+
+    _file_write_t *write_ptr = logged_calloc(1, sizeof(_file_write_t));
+    if (NULL == write_ptr) return NULL;
+    write_ptr->fd = -1;
+    write_ptr->fname_ptr = logged_strdup(fname_ptr);
+    if (NULL == write_ptr->fname_ptr) {
+        _file_write_destroy(write_ptr);
+        return NULL;
+    }
+
+    if (flags & BS_FILE_ATOMIC_TMPFILE) {
+        write_ptr->fd = open(dir, O_TMPFILE | O_WRONLY | O_CLOEXEC, mode);
+        // Not supported by the kernel, or by the file system: Use a name.
+        if (0 > write_ptr->fd &&
+            EOPNOTSUPP != errno && EISDIR != errno && EINVAL != errno) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed open(%s, O_TMPFILE)", dir);
+            _file_write_destroy(write_ptr);
+            return NULL;
+        }
+    }
+
+    if (0 > write_ptr->fd) {
+        size_t len = strlen(fname_ptr) + 8;
+        write_ptr->tmp_fname_ptr = logged_malloc(len);
+        if (NULL == write_ptr->tmp_fname_ptr) {
+            _file_write_destroy(write_ptr);
+            return NULL;
+        }
+        snprintf(write_ptr->tmp_fname_ptr, len, "%s.XXXXXX", fname_ptr);
+        int fd = mkostemp(write_ptr->tmp_fname_ptr, O_CLOEXEC);
+        if (0 > fd) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed mkostemp(%s)",
+                   write_ptr->tmp_fname_ptr);
+            logged_free(write_ptr->tmp_fname_ptr);
+            write_ptr->tmp_fname_ptr = NULL;
+            _file_write_destroy(write_ptr);
+            return NULL;
+        }
+        int rv = fchmod(fd, mode);
+        if (0 != rv) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed fchmod(%d, 0%o) for %s",
+                   fd, mode, write_ptr->tmp_fname_ptr);
+        }
+        if (0 == rv) rv = fstat(fd, &stat_buf);
+        close(fd);
+        if (0 != rv) {
+            _file_write_destroy(write_ptr);
+            return NULL;
+        }
+    } else if (0 != fchmod(write_ptr->fd, mode)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed fchmod(%d, 0%o) for %s",
+               write_ptr->fd, mode, fname_ptr);
+        _file_write_destroy(write_ptr);
+        return NULL;
+    } else if (0 != fstat(write_ptr->fd, &stat_buf)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed fstat(%d) for %s",
+               write_ptr->fd, fname_ptr);
+        _file_write_destroy(write_ptr);
+        return NULL;
+    }
+    write_ptr->dev = stat_buf.st_dev;
+    return write_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Destroys the pending write. Removes the temporary file, if present. */
+void _file_write_destroy(_file_write_t *write_ptr)
+{
+    if (NULL != write_ptr->tmp_fname_ptr) {
+        if (0 != unlink(write_ptr->tmp_fname_ptr)) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed unlink(%s)",
+                   write_ptr->tmp_fname_ptr);
+        }
+        logged_free(write_ptr->tmp_fname_ptr);
+    }
+    if (0 <= write_ptr->fd) close(write_ptr->fd);
+    if (NULL != write_ptr->fname_ptr) logged_free(write_ptr->fname_ptr);
+    logged_free(write_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Renames the temporary file into place. An unnamed temporary file is first
+ * linked under a temporary name: linkat(2) does not replace an existing file.
+ *
+ * @return true on success. The temporary file is gone, in any case.
+ */
+bool _file_write_publish(_file_write_t *write_ptr)
+{
+    if (NULL == write_ptr->tmp_fname_ptr) {
+        char proc_path[64], tmp_fname[PATH_MAX];
+        snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d",
+                 write_ptr->fd);
+        for (int attempt = 0; NULL == write_ptr->tmp_fname_ptr; ++attempt) {
+            snprintf(tmp_fname, sizeof(tmp_fname), "%s.%d.%"PRIx64,
+                     write_ptr->fname_ptr, getpid(),
+                     bs_mono_nsec() + attempt);
+            if (0 == linkat(AT_FDCWD, proc_path, AT_FDCWD, tmp_fname,
+                            AT_SYMLINK_FOLLOW)) {
+                write_ptr->tmp_fname_ptr = logged_strdup(tmp_fname);
+                if (NULL == write_ptr->tmp_fname_ptr) unlink(tmp_fname);
+                if (NULL == write_ptr->tmp_fname_ptr) return false;
+            } else if (EEXIST != errno || 100 <= attempt) {
+                bs_log(BS_WARNING | BS_ERRNO, "Failed linkat(%s, %s)",
+                       proc_path, tmp_fname);
+                return false;
+            }
+        }
+    }
+
+    if (0 != rename(write_ptr->tmp_fname_ptr, write_ptr->fname_ptr)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed rename(%s, %s)",
+               write_ptr->tmp_fname_ptr, write_ptr->fname_ptr);
+        return false;
+    }
+    // Renamed: Nothing left to remove.
+    logged_free(write_ptr->tmp_fname_ptr);
+    write_ptr->tmp_fname_ptr = NULL;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Syncs the directory holding `fname_ptr`.
+ *
+ * @param fname_ptr
+ * @param syncfs_all          Whether to sync the entire file system, with
+ *                            syncfs(2). Otherwise, only the directory.
+ *
+ * @return true on success.
+ */
+bool _file_sync_dir(const char *fname_ptr, bool syncfs_all)
+{
+    char dir[PATH_MAX];
+    _file_dirname(fname_ptr, dir);
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (0 > fd) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed open(%s, O_DIRECTORY)", dir);
+        return false;
+    }
+    bool rv = true;
+    if (0 != (syncfs_all ? syncfs(fd) : fsync(fd))) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed %s(%d) for %s",
+               syncfs_all ? "syncfs" : "fsync", fd, dir);
+        rv = false;
+    }
+    close(fd);
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Stores the directory of `fname_ptr` into `dir_ptr`, of PATH_MAX. */
+void _file_dirname(const char *fname_ptr, char *dir_ptr)
+{
+    const char *slash_ptr = strrchr(fname_ptr, '/');
+    if (NULL == slash_ptr) {
+        strcpy(dir_ptr, ".");
+    } else if (slash_ptr == fname_ptr) {
+        strcpy(dir_ptr, "/");
+    } else {
+        size_t len = BS_MIN((size_t)(slash_ptr - fname_ptr),
+                            (size_t)PATH_MAX - 1);
+        memcpy(dir_ptr, fname_ptr, len);
+        dir_ptr[len] = '\0';
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Hash of a @ref _file_lookup_key_t. */
+uint64_t _file_lookup_hash(const void *key_ptr)
+{
+    const _file_lookup_key_t *lookup_key_ptr = key_ptr;
+    return bs_hashmap_hash_str(lookup_key_ptr->fname_ptr) ^
+        ((uint64_t)lookup_key_ptr->mode * 0x9e3779b97f4a7c15ULL);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Whether the @ref _file_lookup_t matches the @ref _file_lookup_key_t. */
+bool _file_lookup_equals(const bs_hashmap_node_t *node_ptr,
+                         const void *key_ptr)
+{
+    const _file_lookup_key_t *lookup_key_ptr = key_ptr;
+    const _file_lookup_t *lookup_ptr = BS_CONTAINER_OF(
+        node_ptr, const _file_lookup_t, node);
+    return (lookup_ptr->mode == lookup_key_ptr->mode &&
+            0 == strcmp(lookup_ptr->fname, lookup_key_ptr->fname_ptr));
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Watches the directories that a lookup of `fname_ptr` in `path_ptr` depends
+ * on: The search path, and each existing directory below it towards the
+ * file. A missing directory is noticed through the watch of its parent, and
+ * a missing search path through the watch of its closest existing ancestor.
+ *
+ * @param cache_ptr
+ * @param path_ptr            The search path. "~/" is expanded.
+ * @param fname_ptr           The file name, or NULL to watch the search path
+ *                            only.
+ */
+void _file_lookup_cache_watch(bs_file_lookup_cache_t *cache_ptr,
+                              const char *path_ptr,
+                              const char *fname_ptr)
+{
+    char path[PATH_MAX];
+    size_t pos = 0;
+    const char *home_dir_ptr = getenv("HOME");
+    if (bs_str_startswith(path_ptr, "~/") && NULL != home_dir_ptr) {
+        pos = bs_strappend(path, PATH_MAX, pos, home_dir_ptr);
+        path_ptr += 1;
+    }
+    pos = bs_strappend(path, PATH_MAX, pos, path_ptr);
+    size_t path_len = pos;
+    if (NULL != fname_ptr) {
+        pos = bs_strappend(path, PATH_MAX, pos, "/");
+        pos = bs_strappend(path, PATH_MAX, pos, fname_ptr);
+    }
+    if (pos >= PATH_MAX) return;
+
+    path[path_len] = '\0';
+    if (!_file_lookup_cache_add_watch(cache_ptr, path)) {
+        // Walks up, until a directory exists.
+        char *slash_ptr;
+        while (NULL != (slash_ptr = strrchr(path, '/')) && '\0' != path[1]) {
+            slash_ptr[slash_ptr == path ? 1 : 0] = '\0';
+            if (_file_lookup_cache_add_watch(cache_ptr, path)) return;
+        }
+        // A relative path: Up to the working directory.
+        if (NULL == slash_ptr) _file_lookup_cache_add_watch(cache_ptr, ".");
+        return;
+    }
+    if (NULL == fname_ptr) return;
+
+    path[path_len] = '/';
+    for (char *slash_ptr = strchr(path + path_len + 1, '/');
+         NULL != slash_ptr;
+         slash_ptr = strchr(slash_ptr + 1, '/')) {
+        *slash_ptr = '\0';
+        bool watched = _file_lookup_cache_add_watch(cache_ptr, path);
+        *slash_ptr = '/';
+        if (!watched) return;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Adds an inotify(7) watch for changes to entries of the directory `dir_ptr`.
+ *
+ * @return true if watched. false if it failed, eg. for not being a directory.
+ */
+bool _file_lookup_cache_add_watch(bs_file_lookup_cache_t *cache_ptr,
+                                  const char *dir_ptr)
+{
+    // Watching a directory again is not an error, it keeps its descriptor.
+    if (0 <= inotify_add_watch(
+            cache_ptr->inotify_fd, dir_ptr,
+            IN_ATTRIB | IN_CREATE | IN_DELETE | IN_DELETE_SELF |
+            IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)) {
+        return true;
+    }
+    if (ENOENT != errno && ENOTDIR != errno) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed inotify_add_watch(%d, %s)",
+               cache_ptr->inotify_fd, dir_ptr);
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Destroys the @ref _file_lookup_t. */
+void _file_lookup_destroy(bs_hashmap_node_t *node_ptr)
+{
+    _file_lookup_t *lookup_ptr = BS_CONTAINER_OF(
+        node_ptr, _file_lookup_t, node);
+    if (NULL != lookup_ptr->resolved_path_ptr) {
+        logged_free(lookup_ptr->resolved_path_ptr);
+    }
+    logged_free(lookup_ptr);
+}
+
 /* == Test Functions ======================================================= */
 
 static void test_resolve_path(bs_test_t *test_ptr);
 static void test_join_resolve_path(bs_test_t *test_ptr);
 static void test_lookup(bs_test_t *test_ptr);
+static void test_read(bs_test_t *test_ptr);
+static void test_map(bs_test_t *test_ptr);
+static void test_write_atomic(bs_test_t *test_ptr);
+static void test_write_atomic_batch(bs_test_t *test_ptr);
+static void test_lookup_cache(bs_test_t *test_ptr);
 
 const bs_test_case_t bs_file_test_cases[] = {
     { 1, "resolve_path", test_resolve_path },
     { 1, "join_resolve_path", test_join_resolve_path },
     { 1, "lookup", test_lookup },
+    { 1, "read", test_read },
+    { 1, "map", test_map },
+    { 1, "write_atomic", test_write_atomic },
+    { 1, "write_atomic_batch", test_write_atomic_batch },
+    { 1, "lookup_cache", test_lookup_cache },
     { 0, NULL, NULL }  // sentinel.
 };
 
@@ -200,7 +1063,7 @@ void test_resolve_path(bs_test_t *test_ptr)
 
     p = bs_file_resolve_path("/proc/self/cwd/libbase_test", NULL);
     BS_TEST_VERIFY_NEQ(test_ptr, NULL, p);
-    free(p);
+    logged_free(p);
 
     char path[PATH_MAX];
     p = bs_file_resolve_path("/proc/self/cwd/libbase_test", path);
@@ -216,7 +1079,7 @@ void test_join_resolve_path(bs_test_t *test_ptr)
     char *p;
     p = bs_file_join_resolve_path("/proc/self/cwd", "libbase_test", NULL);
     BS_TEST_VERIFY_NEQ(test_ptr, NULL, p);
-    free(p);
+    logged_free(p);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -228,7 +1091,7 @@ void test_lookup(bs_test_t *test_ptr)
     p = bs_file_resolve_and_lookup_from_paths(
         "libbase_test", paths, 0, NULL);
     BS_TEST_VERIFY_NEQ(test_ptr, NULL, p);
-    free(p);
+    logged_free(p);
 
     p = bs_file_resolve_and_lookup_from_paths(
         "libbase_test", paths, S_IFBLK, NULL);
@@ -254,4 +1117,420 @@ void test_lookup(bs_test_t *test_ptr)
     BS_TEST_VERIFY_NEQ(test_ptr, NULL, p);
 }
 
+/* ------------------------------------------------------------------------- */
+/** Helper: Creates a temporary file with `size` bytes of a pattern. */
+static bool test_create_file(bs_test_t *test_ptr,
+                             char *fname_ptr,
+                             size_t size)
+{
+    strcpy(fname_ptr, "/tmp/libbase_file_test_XXXXXX");
+    int fd = mkstemp(fname_ptr);
+    if (0 > fd) {
+        BS_TEST_FAIL(test_ptr, "Failed mkstemp(%s)", fname_ptr);
+        return false;
+    }
+    char buf[4096];
+    for (size_t i = 0; i < sizeof(buf); ++i) buf[i] = 'a' + i % 26;
+    for (size_t pos = 0; pos < size; pos += sizeof(buf)) {
+        size_t len = BS_MIN(sizeof(buf), size - pos);
+        if ((ssize_t)len != write(fd, buf, len)) {
+            BS_TEST_FAIL(test_ptr, "Failed write(%d, %p, %zu)", fd, buf, len);
+        }
+    }
+    close(fd);
+    return !bs_test_failed(test_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies `size` bytes at `data_ptr` follow the pattern. */
+static bool test_verify_pattern(const char *data_ptr, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (data_ptr[i] != (char)('a' + (i % 4096) % 26)) return false;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+void test_read(bs_test_t *test_ptr)
+{
+    char fname[64], buf[256];
+    size_t size = 0;
+    if (!test_create_file(test_ptr, fname, 100000)) return;
+
+    char *data_ptr = bs_file_read(fname, &size);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, data_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 100000, size);
+    BS_TEST_VERIFY_TRUE(test_ptr, test_verify_pattern(data_ptr, size));
+    BS_TEST_VERIFY_EQ(test_ptr, '\0', data_ptr[size]);
+    logged_free(data_ptr);
+
+    // bs_file_read_buffer rejects a buffer that is too small.
+    BS_TEST_VERIFY_EQ(test_ptr, -1,
+                      bs_file_read_buffer(fname, buf, sizeof(buf)));
+    unlink(fname);
+
+    // Reports a size of 0 through fstat.
+    data_ptr = bs_file_read("/proc/self/status", &size);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, data_ptr);
+    BS_TEST_VERIFY_TRUE(test_ptr, 0 < size);
+    BS_TEST_VERIFY_EQ(test_ptr, size, strlen(data_ptr));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_str_startswith(data_ptr, "Name:"));
+    logged_free(data_ptr);
+
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_file_read("/does/not/exist", NULL));
+}
+
+/* ------------------------------------------------------------------------- */
+void test_map(bs_test_t *test_ptr)
+{
+    bs_file_mapping_t mapping;
+    char fname[64];
+    if (!test_create_file(test_ptr, fname, 100000)) return;
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_file_map(fname, &mapping));
+    BS_TEST_VERIFY_TRUE(test_ptr, mapping.mapped);
+    BS_TEST_VERIFY_EQ(test_ptr, 100000, mapping.size);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, test_verify_pattern(mapping.data_ptr, mapping.size));
+    // Remains valid after the file is removed.
+    unlink(fname);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, test_verify_pattern(mapping.data_ptr, mapping.size));
+    bs_file_unmap(&mapping);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, mapping.data_ptr);
+
+    // Not mappable: Falls back to reading.
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_file_map("/proc/self/status", &mapping));
+    BS_TEST_VERIFY_FALSE(test_ptr, mapping.mapped);
+    BS_TEST_VERIFY_TRUE(test_ptr, 0 < mapping.size);
+    bs_file_unmap(&mapping);
+
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_file_map("/does/not/exist", &mapping));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Helper: Counts the entries of `dir_ptr`, excluding "." and "..". */
+static int test_count_entries(const char *dir_ptr)
+{
+    DIR *dir_handle_ptr = opendir(dir_ptr);
+    if (NULL == dir_handle_ptr) return -1;
+    int entries = 0;
+    struct dirent *dirent_ptr;
+    while (NULL != (dirent_ptr = readdir(dir_handle_ptr))) {
+        if (0 != strcmp(dirent_ptr->d_name, ".") &&
+            0 != strcmp(dirent_ptr->d_name, "..")) ++entries;
+    }
+    closedir(dir_handle_ptr);
+    return entries;
+}
+
+/* ------------------------------------------------------------------------- */
+void test_write_atomic(bs_test_t *test_ptr)
+{
+    char dir[64], fname[128];
+    struct stat stat_buf;
+    strcpy(dir, "/tmp/libbase_file_test_XXXXXX");
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, mkdtemp(dir));
+    snprintf(fname, sizeof(fname), "%s/state", dir);
+
+    const unsigned flags[3] = {
+        0, BS_FILE_ATOMIC_PREALLOCATE,
+        BS_FILE_ATOMIC_TMPFILE | BS_FILE_ATOMIC_PREALLOCATE };
+    const char *contents[3] = { "first", "second, and longer", "third" };
+    for (int i = 0; i < 3; ++i) {
+        BS_TEST_VERIFY_TRUE(
+            test_ptr,
+            bs_file_write_atomic(fname, contents[i], strlen(contents[i]),
+                                 flags[i], NULL));
+        char *data_ptr = bs_file_read(fname, NULL);
+        BS_TEST_VERIFY_STREQ(test_ptr, contents[i], data_ptr);
+        logged_free(data_ptr);
+        BS_TEST_VERIFY_EQ(test_ptr, 1, test_count_entries(dir));
+        if (0 == i) chmod(fname, 0600);
+    }
+    // Retains the permission bits.
+    BS_TEST_VERIFY_EQ(test_ptr, 0, stat(fname, &stat_buf));
+    BS_TEST_VERIFY_EQ(test_ptr, 0600, stat_buf.st_mode & 07777);
+
+    // New files get 0644 on either path, regardless of the umask.
+    mode_t old_umask = umask(077);
+    for (int i = 0; i < 3; ++i) {
+        unlink(fname);
+        BS_TEST_VERIFY_TRUE(
+            test_ptr,
+            bs_file_write_atomic(fname, "x", 1, flags[i], NULL));
+        BS_TEST_VERIFY_EQ(test_ptr, 0, stat(fname, &stat_buf));
+        BS_TEST_VERIFY_EQ(test_ptr, 0644, stat_buf.st_mode & 07777);
+    }
+    umask(old_umask);
+
+    // Fails if the directory doesn't exist.
+    snprintf(fname, sizeof(fname), "%s/nodir/state", dir);
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_file_write_atomic(fname, "x", 1, 0, NULL));
+
+    snprintf(fname, sizeof(fname), "%s/state", dir);
+    unlink(fname);
+    rmdir(dir);
+}
+
+/* ------------------------------------------------------------------------- */
+void test_write_atomic_batch(bs_test_t *test_ptr)
+{
+    char dir[64], fname[128];
+    strcpy(dir, "/tmp/libbase_file_test_XXXXXX");
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, mkdtemp(dir));
+    bs_file_batch_t *batch_ptr = bs_file_batch_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, batch_ptr);
+
+    // Named and unnamed temporary files. Only the named ones are visible.
+    for (int i = 0; i < 8; ++i) {
+        snprintf(fname, sizeof(fname), "%s/file%d", dir, i);
+        BS_TEST_VERIFY_TRUE(
+            test_ptr,
+            bs_file_write_atomic(fname, fname, strlen(fname),
+                                 i & 1 ? BS_FILE_ATOMIC_TMPFILE : 0,
+                                 batch_ptr));
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 8, bs_file_batch_size(batch_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 4, test_count_entries(dir));
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_file_batch_commit(batch_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_file_batch_size(batch_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 8, test_count_entries(dir));
+    for (int i = 0; i < 8; ++i) {
+        snprintf(fname, sizeof(fname), "%s/file%d", dir, i);
+        char *data_ptr = bs_file_read(fname, NULL);
+        BS_TEST_VERIFY_STREQ(test_ptr, fname, data_ptr);
+        logged_free(data_ptr);
+    }
+
+    // Not committed: Discarded, and the temporary files are removed.
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_file_write_atomic(fname, "x", 1, 0, batch_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 9, test_count_entries(dir));
+    bs_file_batch_destroy(batch_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 8, test_count_entries(dir));
+    char *data_ptr = bs_file_read(fname, NULL);
+    BS_TEST_VERIFY_STREQ(test_ptr, fname, data_ptr);
+    logged_free(data_ptr);
+
+    for (int i = 0; i < 8; ++i) {
+        snprintf(fname, sizeof(fname), "%s/file%d", dir, i);
+        unlink(fname);
+    }
+    rmdir(dir);
+}
+
+/* ------------------------------------------------------------------------- */
+void test_lookup_cache(bs_test_t *test_ptr)
+{
+    char dir[64], fname[128];
+    strcpy(dir, "/tmp/libbase_file_test_XXXXXX");
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, mkdtemp(dir));
+    const char *paths[] = { "/does/not/exist", dir, NULL };
+    bs_file_lookup_cache_t *cache_ptr = bs_file_lookup_cache_create(
+        paths, true);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, cache_ptr);
+    BS_TEST_VERIFY_TRUE(test_ptr, 0 <= bs_file_lookup_cache_fd(cache_ptr));
+
+    snprintf(fname, sizeof(fname), "%s/a", dir);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_file_write_atomic(fname, "a", 1, 0, NULL));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_file_lookup_cache_handle_events(cache_ptr));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_file_lookup_cache_handle_events(cache_ptr));
+
+    // Same path, from the cache. Mode is part of the key.
+    const char *p = bs_file_lookup_cache_lookup(cache_ptr, "a", 0);
+    BS_TEST_VERIFY_STREQ(test_ptr, fname, p);
+    BS_TEST_VERIFY_EQ(test_ptr, p, bs_file_lookup_cache_lookup(
+                          cache_ptr, "a", 0));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_file_lookup_cache_lookup(
+                          cache_ptr, "a", S_IFDIR));
+
+    // Failed lookups are cached, until the directory changes.
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_file_lookup_cache_lookup(
+                          cache_ptr, "b", 0));
+    snprintf(fname, sizeof(fname), "%s/b", dir);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_file_write_atomic(fname, "b", 1, 0, NULL));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_file_lookup_cache_lookup(
+                          cache_ptr, "b", 0));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_file_lookup_cache_handle_events(cache_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, fname, bs_file_lookup_cache_lookup(
+                             cache_ptr, "b", 0));
+
+    // An explicit flush.
+    unlink(fname);
+    bs_file_lookup_cache_flush(cache_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_file_lookup_cache_lookup(
+                          cache_ptr, "b", 0));
+
+    bs_file_lookup_cache_destroy(cache_ptr);
+    snprintf(fname, sizeof(fname), "%s/a", dir);
+    unlink(fname);
+
+    // Changes in subdirectories, and to a search path created later.
+    char late_dir[80], sub_dir[80], sub_fname[128];
+    snprintf(late_dir, sizeof(late_dir), "%s/late", dir);
+    snprintf(sub_dir, sizeof(sub_dir), "%s/sub", dir);
+    const char *paths2[] = { late_dir, dir, NULL };
+    cache_ptr = bs_file_lookup_cache_create(paths2, true);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, cache_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_file_lookup_cache_lookup(
+                          cache_ptr, "sub/c", 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, mkdir(sub_dir, 0700));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_file_lookup_cache_handle_events(cache_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_file_lookup_cache_lookup(
+                          cache_ptr, "sub/c", 0));
+    snprintf(sub_fname, sizeof(sub_fname), "%s/c", sub_dir);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_file_write_atomic(sub_fname, "c", 1, 0, NULL));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_file_lookup_cache_handle_events(cache_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, sub_fname, bs_file_lookup_cache_lookup(
+                             cache_ptr, "sub/c", 0));
+
+    // A file in the later-created search path takes precedence.
+    BS_TEST_VERIFY_EQ(test_ptr, 0, mkdir(late_dir, 0700));
+    snprintf(fname, sizeof(fname), "%s/sub", late_dir);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, mkdir(fname, 0700));
+    snprintf(fname, sizeof(fname), "%s/sub/c", late_dir);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_file_write_atomic(fname, "c", 1, 0, NULL));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_file_lookup_cache_handle_events(cache_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, fname, bs_file_lookup_cache_lookup(
+                             cache_ptr, "sub/c", 0));
+
+    bs_file_lookup_cache_destroy(cache_ptr);
+    unlink(fname);
+    snprintf(fname, sizeof(fname), "%s/sub", late_dir);
+    rmdir(fname);
+    rmdir(late_dir);
+    unlink(sub_fname);
+    rmdir(sub_dir);
+    rmdir(dir);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_write_atomic(bs_test_t *test_ptr);
+static void benchmark_write_atomic_batch(bs_test_t *test_ptr);
+static void benchmark_lookup(bs_test_t *test_ptr);
+static void benchmark_lookup_cache(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_file_benchmarks[] = {
+    { 1, "benchmark-write_atomic-64", benchmark_write_atomic },
+    { 1, "benchmark-write_atomic-64-batch", benchmark_write_atomic_batch },
+    { 1, "benchmark-lookup", benchmark_lookup },
+    { 1, "benchmark-lookup-cache", benchmark_lookup_cache },
+    { 0, NULL, NULL }  // sentinel.
+};
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Writes 64 small files atomically, `iterations` times. Into a directory
+ * below the current one: /tmp may be a tmpfs, where syncing is free.
+ */
+static void _benchmark_write_atomic_fn(void *arg_ptr, uint64_t iterations)
+{
+    bs_file_batch_t *batch_ptr = arg_ptr;
+    char fname[64];
+    for (uint64_t i = 0; i < iterations; ++i) {
+        for (int f = 0; f < 64; ++f) {
+            snprintf(fname, sizeof(fname), "benchmark_file.d/%d", f);
+            bs_file_write_atomic(fname, fname, strlen(fname), 0, batch_ptr);
+        }
+        if (NULL != batch_ptr) bs_file_batch_commit(batch_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Runs @ref _benchmark_write_atomic_fn, with or without a batch. */
+static void _benchmark_write_atomic_with(bs_test_t *test_ptr, bool batch)
+{
+    char fname[64];
+    if (0 != mkdir("benchmark_file.d", 0755) && EEXIST != errno) {
+        BS_TEST_FAIL(test_ptr, "Failed mkdir(benchmark_file.d)");
+        return;
+    }
+    bs_file_batch_t *batch_ptr = batch ? bs_file_batch_create() : NULL;
+    if (!bs_test_bench(test_ptr, batch ? "write_atomic-batch" : "write_atomic",
+                       _benchmark_write_atomic_fn, batch_ptr, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(write_atomic)");
+    }
+    if (NULL != batch_ptr) bs_file_batch_destroy(batch_ptr);
+    for (int f = 0; f < 64; ++f) {
+        snprintf(fname, sizeof(fname), "benchmark_file.d/%d", f);
+        unlink(fname);
+    }
+    rmdir("benchmark_file.d");
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_write_atomic(bs_test_t *test_ptr)
+{
+    _benchmark_write_atomic_with(test_ptr, false);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_write_atomic_batch(bs_test_t *test_ptr)
+{
+    _benchmark_write_atomic_with(test_ptr, true);
+}
+
+/** Search paths for the lookup benchmarks. The file is in the last. */
+static const char *_benchmark_lookup_paths[] = {
+    "/does/not/exist", "/usr/share", "/proc/self/cwd", NULL };
+
+/* ------------------------------------------------------------------------- */
+/** Looks up "libbase_test" without a cache, `iterations` times. */
+static void _benchmark_lookup_fn(__UNUSED__ void *arg_ptr, uint64_t iterations)
+{
+    char path[PATH_MAX];
+    for (uint64_t i = 0; i < iterations; ++i) {
+        char *p = bs_file_resolve_and_lookup_from_paths(
+            "libbase_test", _benchmark_lookup_paths, S_IFREG, path);
+        BS_TEST_DO_NOT_OPTIMIZE(p);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Looks up "libbase_test" from the cache, `iterations` times. */
+static void _benchmark_lookup_cache_fn(void *arg_ptr, uint64_t iterations)
+{
+    bs_file_lookup_cache_t *cache_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        const char *p = bs_file_lookup_cache_lookup(
+            cache_ptr, "libbase_test", S_IFREG);
+        BS_TEST_DO_NOT_OPTIMIZE(p);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_lookup(bs_test_t *test_ptr)
+{
+    if (!bs_test_bench(test_ptr, "lookup", _benchmark_lookup_fn, NULL,
+                       NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(lookup)");
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_lookup_cache(bs_test_t *test_ptr)
+{
+    bs_file_lookup_cache_t *cache_ptr = bs_file_lookup_cache_create(
+        _benchmark_lookup_paths, false);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, cache_ptr);
+    if (!bs_test_bench(test_ptr, "lookup-cache", _benchmark_lookup_cache_fn,
+                       cache_ptr, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(lookup-cache)");
+    }
+    bs_file_lookup_cache_destroy(cache_ptr);
+}
+
 /* == End of file.c ======================================================== */
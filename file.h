@@ -22,6 +22,7 @@
 #ifndef __LIBBASE_FILE_H__
 #define __LIBBASE_FILE_H__
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include <sys/types.h>
@@ -48,6 +49,55 @@ ssize_t bs_file_read_buffer(
     char *buf_ptr,
     size_t buf_len);
 
+/**
+ * Reads the entire contents of |fname_ptr| into a newly allocated buffer.
+ *
+ * The buffer is sized from fstat(2), and grown if the file turns out larger,
+ * or reports no size (eg. files in /proc). Reads until end of file. A
+ * trailing NUL character is added to the buffer, for convenience.
+ *
+ * @param fname_ptr
+ * @param size_ptr            Optional. Stores the number of bytes read, not
+ *                            including the trailing NUL.
+ *
+ * @return A pointer to the contents, or NULL on error. Must be released by
+ *     calling free(3). Any error will be logged.
+ */
+char *bs_file_read(const char *fname_ptr, size_t *size_ptr);
+
+/** A read-only view of a file's contents, see @ref bs_file_map. */
+typedef struct {
+    /** The contents. Not guaranteed to be NUL-terminated. */
+    const void                *data_ptr;
+    /** Size of the contents, in bytes. */
+    size_t                    size;
+    /** Whether `data_ptr` is mapped, or was read into an allocated buffer. */
+    bool                      mapped;
+} bs_file_mapping_t;
+
+/**
+ * Maps the entire contents of |fname_ptr| into memory, for reading.
+ *
+ * Regular files are mapped with mmap(2), and advised for sequential access.
+ * That avoids copying the contents, and suits large files. Files that cannot
+ * be mapped (eg. pipes, or files in /proc) are read with
+ * @ref bs_file_read instead.
+ *
+ * The mapping is private: Modifications to the file after mapping may or may
+ * not be visible, and truncating the file while mapped raises SIGBUS on
+ * access. Best used for files that are replaced, not modified in place.
+ *
+ * @param fname_ptr
+ * @param mapping_ptr         Set to the view on success. Must be released
+ *                            by @ref bs_file_unmap.
+ *
+ * @return true on success. Any error will be logged.
+ */
+bool bs_file_map(const char *fname_ptr, bs_file_mapping_t *mapping_ptr);
+
+/** Releases the view created by @ref bs_file_map. */
+void bs_file_unmap(bs_file_mapping_t *mapping_ptr);
+
 /**
  * Writes |buf_len| bytes from |buf_ptr| into the file |fname_ptr|.
  *
@@ -63,6 +113,85 @@ ssize_t bs_file_write_buffer(
     const char *buf_ptr,
     size_t buf_len);
 
+/** Options for @ref bs_file_write_atomic. */
+typedef enum {
+    /**
+     * Writes into an unnamed file, from open(2) with O_TMPFILE, which is
+     * only linked into the directory once complete. No named temporary file
+     * is left behind on crash. Falls back to a named temporary file, where
+     * the file system does not support O_TMPFILE.
+     */
+    BS_FILE_ATOMIC_TMPFILE = 1 << 0,
+    /**
+     * Preallocates the file's blocks with fallocate(2), before writing. Fails
+     * early if the space is not available, and reduces fragmentation.
+     */
+    BS_FILE_ATOMIC_PREALLOCATE = 1 << 1
+} bs_file_atomic_flags_t;
+
+/**
+ * A batch of atomic writes, see @ref bs_file_write_atomic.
+ *
+ * Writes added to a batch are not synced individually. Instead,
+ * @ref bs_file_batch_commit syncs the file systems once before renaming all
+ * files into place, and once after. That is two syncfs(2) per file system,
+ * instead of an fsync(2) of each file and of its directory.
+ */
+typedef struct _bs_file_batch_t bs_file_batch_t;
+
+/**
+ * Writes |buf_len| bytes from |buf_ptr| atomically into |fname_ptr|.
+ *
+ * The contents are written to a temporary file in the same directory, which
+ * then gets renamed to |fname_ptr|. A crash leaves either the former or the
+ * new contents, never a partial write. If |fname_ptr| exists, its permission
+ * bits are retained. Otherwise, the file is created with mode 0644. Either
+ * way, the mode is set explicitly and the umask does not apply, whether or
+ * not the temporary file is unnamed.
+ *
+ * @param fname_ptr
+ * @param buf_ptr
+ * @param buf_len
+ * @param flags               A bitmask of @ref bs_file_atomic_flags_t.
+ * @param batch_ptr           Optional. If NULL, the file is synced and
+ *                            renamed before returning. Otherwise, the write
+ *                            is completed by @ref bs_file_batch_commit.
+ *
+ * @return true on success. Any error will be logged.
+ */
+bool bs_file_write_atomic(
+    const char *fname_ptr,
+    const void *buf_ptr,
+    size_t buf_len,
+    unsigned flags,
+    bs_file_batch_t *batch_ptr);
+
+/**
+ * Creates a batch of atomic writes.
+ *
+ * @return A pointer to the batch, or NULL on error. Must be destroyed by
+ *     @ref bs_file_batch_destroy.
+ */
+bs_file_batch_t *bs_file_batch_create(void);
+
+/**
+ * Destroys the batch. Writes not yet committed are discarded, and their
+ * temporary files removed.
+ */
+void bs_file_batch_destroy(bs_file_batch_t *batch_ptr);
+
+/** Returns the number of writes in the batch, not yet committed. */
+size_t bs_file_batch_size(bs_file_batch_t *batch_ptr);
+
+/**
+ * Commits all writes of the batch: Syncs their data, renames all files into
+ * place, and syncs again. The batch is empty afterwards, and can be re-used.
+ *
+ * @return true if all writes were committed. On failure, the remaining
+ *     writes are still attempted. Writes that failed are discarded.
+ */
+bool bs_file_batch_commit(bs_file_batch_t *batch_ptr);
+
 /**
  * Resolves the real path to `path_ptr`, with home directory expansion.
  *
@@ -125,9 +254,80 @@ char *bs_file_resolve_and_lookup_from_paths(
     int mode,
     char *resolved_path_buf_ptr);
 
+/**
+ * A cache for @ref bs_file_resolve_and_lookup_from_paths, for one set of
+ * search paths.
+ *
+ * Repeated lookups of a name are served from memory, without system calls or
+ * allocations. Failed lookups are cached, too. The cache is invalidated by
+ * @ref bs_file_lookup_cache_flush, or when inotify(7) reports a change to
+ * one of the search paths, or to a subdirectory a lookup went through.
+ * Search paths that do not exist are noticed once created, through a watch
+ * of their closest existing ancestor. Changes there may flush the cache,
+ * even if unrelated. Watches are kept until the cache is destroyed.
+ */
+typedef struct _bs_file_lookup_cache_t bs_file_lookup_cache_t;
+
+/**
+ * Creates a lookup cache.
+ *
+ * @param paths_ptr_ptr       A NULL-terminated array of paths to search, as
+ *                            for @ref bs_file_resolve_and_lookup_from_paths.
+ *                            The paths are copied.
+ * @param watch               Whether to watch the paths with inotify(7).
+ *                            The cache is then flushed by
+ *                            @ref bs_file_lookup_cache_handle_events.
+ *
+ * @return A pointer to the cache, or NULL on error. Must be destroyed by
+ *     @ref bs_file_lookup_cache_destroy.
+ */
+bs_file_lookup_cache_t *bs_file_lookup_cache_create(
+    const char **paths_ptr_ptr,
+    bool watch);
+
+/** Destroys the lookup cache. */
+void bs_file_lookup_cache_destroy(bs_file_lookup_cache_t *cache_ptr);
+
+/**
+ * Looks up `fname_ptr` from the cache's paths. See
+ * @ref bs_file_resolve_and_lookup_from_paths.
+ *
+ * @param cache_ptr
+ * @param fname_ptr
+ * @param mode
+ *
+ * @return A pointer to the resolved path, or NULL if not found. The path is
+ *     owned by the cache, and remains valid until the cache is flushed.
+ */
+const char *bs_file_lookup_cache_lookup(
+    bs_file_lookup_cache_t *cache_ptr,
+    const char *fname_ptr,
+    int mode);
+
+/** Flushes all cached lookups. Previously returned paths become invalid. */
+void bs_file_lookup_cache_flush(bs_file_lookup_cache_t *cache_ptr);
+
+/**
+ * Returns the inotify(7) file descriptor of the cache, or -1 if not
+ * watching. It is readable when @ref bs_file_lookup_cache_handle_events has
+ * events to handle, eg. for watching it with a @ref bs_event_loop_t.
+ */
+int bs_file_lookup_cache_fd(bs_file_lookup_cache_t *cache_ptr);
+
+/**
+ * Handles pending inotify(7) events, without blocking. Flushes the cache if
+ * any of the search paths changed.
+ *
+ * @return Whether the cache was flushed.
+ */
+bool bs_file_lookup_cache_handle_events(bs_file_lookup_cache_t *cache_ptr);
+
 /** Unit tests. */
 extern const bs_test_case_t   bs_file_test_cases[];
 
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_file_benchmarks[];
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
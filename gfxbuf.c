@@ -18,27 +18,109 @@
  * limitations under the License.
  */
 
+/// memfd_create(2) is a Linux extension.
+#define _GNU_SOURCE
+
 #include "gfxbuf.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <libgen.h>
 #include <limits.h>
 #include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "log_wrappers.h"
 #include "test.h"
+#include "thread.h"
+#include "thread_pool.h"
 #include "time.h"
+#include "trace.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BS_GFXBUF_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define BS_GFXBUF_NEON
+#include <arm_neon.h>
+#endif
+
+#undef _GNU_SOURCE
 
 /* == Declarations ========================================================= */
 
+/** How the pixel storage of a managed buffer was obtained. */
+typedef enum {
+    /** From the heap. To be released by free(3). */
+    BS_GFXBUF_STORAGE_HEAP,
+    /**
+     * From the heap, 64-byte aligned by aligned_alloc(3). To be released by
+     * free(3). Kept apart from @ref BS_GFXBUF_STORAGE_HEAP, so the pool does
+     * not hand out unaligned storage for @ref BS_GFXBUF_ALIGNED.
+     */
+    BS_GFXBUF_STORAGE_ALIGNED,
+    /** Anonymous mapping. To be released by munmap(2). */
+    BS_GFXBUF_STORAGE_MMAP,
+    /** Shared mapping of the memfd `shm_fd`. To be unmapped and closed. */
+    BS_GFXBUF_STORAGE_SHM
+} bs_gfxbuf_storage_t;
+
 /** Internal handle of a graphics buffer. */
 typedef struct {
     /** Publicly accessible elements. */
     bs_gfxbuf_t               public;
     /** Whether `data_ptr` is owned by @ref bs_gfxbuf_t `public`. */
     bool                      managed;
+    /** For managed buffers: How `data_ptr` was obtained. */
+    bs_gfxbuf_storage_t       storage;
+    /** For managed buffers: Size of the storage at `data_ptr`, in bytes. */
+    size_t                    storage_bytes;
+    /** Whether to return the storage to the pool, instead of releasing. */
+    bool                      pooled;
+    /** For BS_GFXBUF_STORAGE_SHM: The memfd. -1 otherwise. */
+    int                       shm_fd;
 } bs_gfxbuf_internal_t;
 
+/** An element of the storage pool. */
+typedef struct {
+    /** The storage. NULL if the element is unused. */
+    void                      *ptr;
+    /** Size of the storage, in bytes. */
+    size_t                    bytes;
+    /** How the storage was obtained. */
+    bs_gfxbuf_storage_t       storage;
+} bs_gfxbuf_pool_entry_t;
+
+/** Maximum number of buffers kept in the storage pool. */
+#define BS_GFXBUF_POOL_ENTRIES    16
+/** Maximum number of bytes kept in the storage pool. */
+#define BS_GFXBUF_POOL_MAX_BYTES  (256 * 1024 * 1024)
+
+/** Process-wide storage pool, for @ref BS_GFXBUF_POOLED. */
+static struct {
+    /** Protects the pool. */
+    pthread_mutex_t           mutex;
+    /** Storage available for recycling. */
+    bs_gfxbuf_pool_entry_t    entries[BS_GFXBUF_POOL_ENTRIES];
+    /** Total bytes currently held in `entries`. */
+    size_t                    bytes;
+} _bs_gfxbuf_pool = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static void *_bs_gfxbuf_storage_alloc(size_t bytes,
+                                      unsigned flags,
+                                      bs_gfxbuf_storage_t *storage_ptr,
+                                      size_t *storage_bytes_ptr);
+static void _bs_gfxbuf_storage_release(void *ptr,
+                                       size_t bytes,
+                                       bs_gfxbuf_storage_t storage);
+static size_t _bs_gfxbuf_size_class(size_t bytes);
+static void *_bs_gfxbuf_pool_take(size_t bytes, bs_gfxbuf_storage_t storage);
+static bool _bs_gfxbuf_pool_put(void *ptr,
+                                size_t bytes,
+                                bs_gfxbuf_storage_t storage);
+
 /** Returns the @ref bs_gfxbuf_internal_t for a @ref bs_gfxbuf_t. */
 static inline bs_gfxbuf_internal_t *internal_from_gfxbuf(
     bs_gfxbuf_t *gfxbuf_ptr)
@@ -46,6 +128,234 @@ static inline bs_gfxbuf_internal_t *internal_from_gfxbuf(
     return BS_CONTAINER_OF(gfxbuf_ptr, bs_gfxbuf_internal_t, public);
 }
 
+/** Fills `num` pixels from `dest_ptr` on with `color`. */
+typedef void (*bs_gfxbuf_fill_t)(uint32_t *dest_ptr,
+                                 uint32_t color,
+                                 size_t num);
+
+static void _bs_gfxbuf_clear_with(bs_gfxbuf_t *gfxbuf_ptr,
+                                  const uint32_t color,
+                                  bs_gfxbuf_fill_t fill);
+static bs_gfxbuf_fill_t _bs_gfxbuf_fill_dispatch(void);
+static void _bs_gfxbuf_fill_scalar(uint32_t *dest_ptr,
+                                   uint32_t color,
+                                   size_t num);
+#if defined(BS_GFXBUF_X86)
+static void _bs_gfxbuf_fill_sse2(uint32_t *dest_ptr,
+                                 uint32_t color,
+                                 size_t num)
+    __attribute__((target("sse2")));
+static void _bs_gfxbuf_fill_avx2(uint32_t *dest_ptr,
+                                 uint32_t color,
+                                 size_t num)
+    __attribute__((target("avx2")));
+#elif defined(BS_GFXBUF_NEON)
+static void _bs_gfxbuf_fill_neon(uint32_t *dest_ptr,
+                                 uint32_t color,
+                                 size_t num);
+#endif
+
+/** Blends `num` pixels from `src_ptr` onto `dest_ptr`, as "source over". */
+typedef void (*bs_gfxbuf_blend_t)(uint32_t *dest_ptr,
+                                  const uint32_t *src_ptr,
+                                  size_t num);
+
+static bool _bs_gfxbuf_clip_area(
+    const bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned *width_ptr,
+    unsigned *height_ptr);
+static void _bs_gfxbuf_blend_area_with(
+    bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned width,
+    unsigned height,
+    bs_gfxbuf_blend_t blend);
+static bs_gfxbuf_blend_t _bs_gfxbuf_blend_dispatch(void);
+static void _bs_gfxbuf_blend_scalar(uint32_t *dest_ptr,
+                                    const uint32_t *src_ptr,
+                                    size_t num);
+#if defined(BS_GFXBUF_X86)
+static void _bs_gfxbuf_blend_sse4(uint32_t *dest_ptr,
+                                  const uint32_t *src_ptr,
+                                  size_t num)
+    __attribute__((target("sse4.1")));
+static void _bs_gfxbuf_blend_avx2(uint32_t *dest_ptr,
+                                  const uint32_t *src_ptr,
+                                  size_t num)
+    __attribute__((target("avx2")));
+#elif defined(BS_GFXBUF_NEON)
+static void _bs_gfxbuf_blend_neon(uint32_t *dest_ptr,
+                                  const uint32_t *src_ptr,
+                                  size_t num);
+#endif
+
+/** Kernels for scaling, see @ref bs_gfxbuf_copy_scaled. */
+typedef struct {
+    /**
+     * Interpolates `num` pixels between the rows `src0_ptr` and `src1_ptr`:
+     * dest = (src0 * (256 - weight) + src1 * weight) / 256, per channel.
+     * `weight` is in [1, 255].
+     */
+    void (*lerp_rows)(uint32_t *dest_ptr,
+                      const uint32_t *src0_ptr,
+                      const uint32_t *src1_ptr,
+                      uint32_t weight,
+                      size_t num);
+    /** Writes each of the `num` pixels at `src_ptr` twice to `dest_ptr`. */
+    void (*double_row)(uint32_t *dest_ptr,
+                       const uint32_t *src_ptr,
+                       size_t num);
+    /**
+     * Averages each 2x2 block of the rows `src0_ptr` and `src1_ptr` into one
+     * of the `num` pixels at `dest_ptr`. Rounds the same as `lerp_rows`.
+     */
+    void (*halve_rows)(uint32_t *dest_ptr,
+                       const uint32_t *src0_ptr,
+                       const uint32_t *src1_ptr,
+                       size_t num);
+} bs_gfxbuf_scale_kernels_t;
+
+static bool _bs_gfxbuf_copy_scaled_with(
+    bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    unsigned dest_width,
+    unsigned dest_height,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned src_width,
+    unsigned src_height,
+    bs_gfxbuf_filter_t filter,
+    const bs_gfxbuf_scale_kernels_t *kernels_ptr);
+static bool _bs_gfxbuf_scale_nearest(
+    bs_gfxbuf_t *dest_view_ptr,
+    const bs_gfxbuf_t *src_view_ptr,
+    unsigned dest_width,
+    unsigned dest_height,
+    const bs_gfxbuf_scale_kernels_t *kernels_ptr);
+static bool _bs_gfxbuf_scale_bilinear(
+    bs_gfxbuf_t *dest_view_ptr,
+    const bs_gfxbuf_t *src_view_ptr,
+    unsigned dest_width,
+    unsigned dest_height,
+    const bs_gfxbuf_scale_kernels_t *kernels_ptr);
+static const bs_gfxbuf_scale_kernels_t *_bs_gfxbuf_scale_dispatch(void);
+static void _bs_gfxbuf_lerp_rows_scalar(uint32_t *dest_ptr,
+                                        const uint32_t *src0_ptr,
+                                        const uint32_t *src1_ptr,
+                                        uint32_t weight,
+                                        size_t num);
+static void _bs_gfxbuf_double_row_scalar(uint32_t *dest_ptr,
+                                         const uint32_t *src_ptr,
+                                         size_t num);
+static void _bs_gfxbuf_halve_rows_scalar(uint32_t *dest_ptr,
+                                         const uint32_t *src0_ptr,
+                                         const uint32_t *src1_ptr,
+                                         size_t num);
+#if defined(BS_GFXBUF_X86)
+static void _bs_gfxbuf_lerp_rows_sse2(uint32_t *dest_ptr,
+                                      const uint32_t *src0_ptr,
+                                      const uint32_t *src1_ptr,
+                                      uint32_t weight,
+                                      size_t num)
+    __attribute__((target("sse2")));
+static void _bs_gfxbuf_double_row_sse2(uint32_t *dest_ptr,
+                                       const uint32_t *src_ptr,
+                                       size_t num)
+    __attribute__((target("sse2")));
+static void _bs_gfxbuf_halve_rows_sse2(uint32_t *dest_ptr,
+                                       const uint32_t *src0_ptr,
+                                       const uint32_t *src1_ptr,
+                                       size_t num)
+    __attribute__((target("sse2")));
+#elif defined(BS_GFXBUF_NEON)
+static void _bs_gfxbuf_lerp_rows_neon(uint32_t *dest_ptr,
+                                      const uint32_t *src0_ptr,
+                                      const uint32_t *src1_ptr,
+                                      uint32_t weight,
+                                      size_t num);
+static void _bs_gfxbuf_double_row_neon(uint32_t *dest_ptr,
+                                       const uint32_t *src_ptr,
+                                       size_t num);
+static void _bs_gfxbuf_halve_rows_neon(uint32_t *dest_ptr,
+                                       const uint32_t *src0_ptr,
+                                       const uint32_t *src1_ptr,
+                                       size_t num);
+#endif
+
+/** Scaling kernels that work everywhere. */
+static const bs_gfxbuf_scale_kernels_t _bs_gfxbuf_scale_scalar = {
+    .lerp_rows = _bs_gfxbuf_lerp_rows_scalar,
+    .double_row = _bs_gfxbuf_double_row_scalar,
+    .halve_rows = _bs_gfxbuf_halve_rows_scalar
+};
+#if defined(BS_GFXBUF_X86)
+/** Scaling kernels for SSE2. */
+static const bs_gfxbuf_scale_kernels_t _bs_gfxbuf_scale_sse2 = {
+    .lerp_rows = _bs_gfxbuf_lerp_rows_sse2,
+    .double_row = _bs_gfxbuf_double_row_sse2,
+    .halve_rows = _bs_gfxbuf_halve_rows_sse2
+};
+#elif defined(BS_GFXBUF_NEON)
+/** Scaling kernels for NEON. */
+static const bs_gfxbuf_scale_kernels_t _bs_gfxbuf_scale_neon = {
+    .lerp_rows = _bs_gfxbuf_lerp_rows_neon,
+    .double_row = _bs_gfxbuf_double_row_neon,
+    .halve_rows = _bs_gfxbuf_halve_rows_neon
+};
+#endif
+
+/** Processes one band: `dest_band_ptr` and `src_band_ptr` have same size. */
+typedef void (*bs_gfxbuf_band_fn_t)(bs_gfxbuf_t *dest_band_ptr,
+                                    const bs_gfxbuf_t *src_band_ptr,
+                                    uint32_t color);
+
+/** An operation for the worker pool, split into bands. */
+typedef struct {
+    /** Method to process each band. */
+    bs_gfxbuf_band_fn_t       band_fn;
+    /** View of the destination area. */
+    bs_gfxbuf_t               dest;
+    /** View of the source area, of same dimensions as `dest`. Optional. */
+    bs_gfxbuf_t               src;
+    /** Color, for clearing. */
+    uint32_t                  color;
+    /** Number of bands that the area is split into. */
+    unsigned                  bands;
+} bs_gfxbuf_job_t;
+
+/** State of the worker pool. */
+struct _bs_gfxbuf_workers_t {
+    /** Number of worker threads in `pool_ptr`. */
+    unsigned                  threads;
+    /** The thread pool, running the bands. NULL if `threads` is 0. */
+    bs_thread_pool_t          *pool_ptr;
+    /** Minimum number of pixels to use the worker threads. */
+    size_t                    min_pixels;
+};
+
+static void _bs_gfxbuf_workers_run_bands(void *arg_ptr,
+                                         size_t begin,
+                                         size_t end);
+static void _bs_gfxbuf_workers_run(bs_gfxbuf_workers_t *workers_ptr,
+                                   bs_gfxbuf_job_t *job_ptr);
+static void _bs_gfxbuf_band_clear(bs_gfxbuf_t *dest_band_ptr,
+                                  const bs_gfxbuf_t *src_band_ptr,
+                                  uint32_t color);
+static void _bs_gfxbuf_band_copy(bs_gfxbuf_t *dest_band_ptr,
+                                 const bs_gfxbuf_t *src_band_ptr,
+                                 uint32_t color);
+
 #ifdef HAVE_CAIRO
 /** Image format used for @ref bs_gfxbuf_t, translated to Cairo terms. */
 static const cairo_format_t   bs_gfx_cairo_image_format = CAIRO_FORMAT_ARGB32;
@@ -56,21 +366,119 @@ static const cairo_format_t   bs_gfx_cairo_image_format = CAIRO_FORMAT_ARGB32;
 /* ------------------------------------------------------------------------- */
 bs_gfxbuf_t *bs_gfxbuf_create(unsigned width, unsigned height)
 {
-    uint32_t *data_ptr = (uint32_t*)logged_calloc(1, 4 * width * height);
+    return bs_gfxbuf_create_with_flags(width, height, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+bs_gfxbuf_t *bs_gfxbuf_create_with_flags(unsigned width,
+                                         unsigned height,
+                                         unsigned flags)
+{
+    unsigned pixels_per_line = width;
+    if (flags & BS_GFXBUF_ALIGNED) pixels_per_line = (width + 15) & ~15u;
+
+    bs_gfxbuf_storage_t storage;
+    size_t storage_bytes;
+    uint32_t *data_ptr = _bs_gfxbuf_storage_alloc(
+        sizeof(uint32_t) * pixels_per_line * height, flags,
+        &storage, &storage_bytes);
     if (NULL == data_ptr) return NULL;
 
     bs_gfxbuf_t *gfxbuf_ptr = bs_gfxbuf_create_unmanaged(
-        width, height, width, data_ptr);
+        width, height, pixels_per_line, data_ptr);
     if (NULL == gfxbuf_ptr) {
-        free(data_ptr);
+        _bs_gfxbuf_storage_release(data_ptr, storage_bytes, storage);
     } else {
         bs_gfxbuf_internal_t *gfxbuf_internal_ptr =
             internal_from_gfxbuf(gfxbuf_ptr);
         gfxbuf_internal_ptr->managed = true;
+        gfxbuf_internal_ptr->storage = storage;
+        gfxbuf_internal_ptr->storage_bytes = storage_bytes;
+        gfxbuf_internal_ptr->pooled = flags & BS_GFXBUF_POOLED;
+    }
+    return gfxbuf_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_pool_flush(void)
+{
+    bs_gfxbuf_pool_entry_t entries[BS_GFXBUF_POOL_ENTRIES];
+
+    bs_mutex_lock(&_bs_gfxbuf_pool.mutex);
+    memcpy(entries, _bs_gfxbuf_pool.entries, sizeof(entries));
+    memset(_bs_gfxbuf_pool.entries, 0, sizeof(entries));
+    _bs_gfxbuf_pool.bytes = 0;
+    bs_mutex_unlock(&_bs_gfxbuf_pool.mutex);
+
+    for (int i = 0; i < BS_GFXBUF_POOL_ENTRIES; ++i) {
+        if (NULL == entries[i].ptr) continue;
+        _bs_gfxbuf_storage_release(
+            entries[i].ptr, entries[i].bytes, entries[i].storage);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+bs_gfxbuf_t *bs_gfxbuf_create_shm(unsigned width, unsigned height)
+{
+    size_t bytes = sizeof(uint32_t) * width * height;
+    int fd = memfd_create("bs_gfxbuf", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (0 > fd) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed memfd_create(\"bs_gfxbuf\", "
+               "MFD_CLOEXEC | MFD_ALLOW_SEALING)");
+        return NULL;
+    }
+    if (0 != ftruncate(fd, bytes)) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed ftruncate(%d, %zu)", fd, bytes);
+        close(fd);
+        return NULL;
+    }
+    // Consumers may rely on the file not shrinking under their mapping.
+    if (0 != fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed fcntl(%d, F_ADD_SEALS, "
+               "F_SEAL_SHRINK | F_SEAL_SEAL)", fd);
+    }
+
+    uint32_t *data_ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, fd, 0);
+    if (MAP_FAILED == data_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed mmap(NULL, %zu, "
+               "PROT_READ | PROT_WRITE, MAP_SHARED, %d, 0)", bytes, fd);
+        close(fd);
+        return NULL;
+    }
+
+    bs_gfxbuf_t *gfxbuf_ptr = bs_gfxbuf_create_unmanaged(
+        width, height, width, data_ptr);
+    if (NULL == gfxbuf_ptr) {
+        munmap(data_ptr, bytes);
+        close(fd);
+        return NULL;
     }
+    bs_gfxbuf_internal_t *gfxbuf_internal_ptr =
+        internal_from_gfxbuf(gfxbuf_ptr);
+    gfxbuf_internal_ptr->managed = true;
+    gfxbuf_internal_ptr->storage = BS_GFXBUF_STORAGE_SHM;
+    gfxbuf_internal_ptr->storage_bytes = bytes;
+    gfxbuf_internal_ptr->shm_fd = fd;
     return gfxbuf_ptr;
 }
 
+/* ------------------------------------------------------------------------- */
+bool bs_gfxbuf_get_shm(const bs_gfxbuf_t *gfxbuf_ptr,
+                       bs_gfxbuf_shm_t *shm_ptr)
+{
+    const bs_gfxbuf_internal_t *gfxbuf_internal_ptr = BS_CONTAINER_OF(
+        gfxbuf_ptr, const bs_gfxbuf_internal_t, public);
+    if (BS_GFXBUF_STORAGE_SHM != gfxbuf_internal_ptr->storage ||
+        !gfxbuf_internal_ptr->managed) return false;
+
+    shm_ptr->fd = gfxbuf_internal_ptr->shm_fd;
+    shm_ptr->offset = 0;
+    shm_ptr->size = gfxbuf_internal_ptr->storage_bytes;
+    shm_ptr->stride = gfxbuf_ptr->pixels_per_line * sizeof(uint32_t);
+    return true;
+}
+
 /* ------------------------------------------------------------------------- */
 bs_gfxbuf_t *bs_gfxbuf_create_unmanaged(unsigned width, unsigned height,
                                         unsigned pixels_per_line,
@@ -85,6 +493,7 @@ bs_gfxbuf_t *bs_gfxbuf_create_unmanaged(unsigned width, unsigned height,
     buf_internal_ptr->public.pixels_per_line = pixels_per_line;
     buf_internal_ptr->public.data_ptr = data_ptr;
     buf_internal_ptr->managed = false;
+    buf_internal_ptr->shm_fd = -1;
     return &buf_internal_ptr->public;
 }
 
@@ -94,33 +503,127 @@ void bs_gfxbuf_destroy(bs_gfxbuf_t *gfxbuf_ptr)
     bs_gfxbuf_internal_t *gfxbuf_internal_ptr =
         internal_from_gfxbuf(gfxbuf_ptr);
     if (gfxbuf_internal_ptr->managed &&
+        BS_GFXBUF_STORAGE_SHM == gfxbuf_internal_ptr->storage) {
+        if (0 != munmap(gfxbuf_ptr->data_ptr,
+                        gfxbuf_internal_ptr->storage_bytes)) {
+            bs_log(BS_ERROR | BS_ERRNO, "Failed munmap(%p, %zu)",
+                   gfxbuf_ptr->data_ptr, gfxbuf_internal_ptr->storage_bytes);
+        }
+        if (0 != close(gfxbuf_internal_ptr->shm_fd)) {
+            bs_log(BS_WARNING | BS_ERRNO, "Failed close(%d)",
+                   gfxbuf_internal_ptr->shm_fd);
+        }
+        gfxbuf_ptr->data_ptr = NULL;
+    } else if (gfxbuf_internal_ptr->managed &&
         NULL != gfxbuf_internal_ptr->public.data_ptr) {
-        free(gfxbuf_internal_ptr->public.data_ptr);
+        if (!gfxbuf_internal_ptr->pooled ||
+            !_bs_gfxbuf_pool_put(gfxbuf_ptr->data_ptr,
+                                 gfxbuf_internal_ptr->storage_bytes,
+                                 gfxbuf_internal_ptr->storage)) {
+            _bs_gfxbuf_storage_release(gfxbuf_ptr->data_ptr,
+                                       gfxbuf_internal_ptr->storage_bytes,
+                                       gfxbuf_internal_ptr->storage);
+        }
         gfxbuf_ptr->data_ptr = NULL;
     }
-    free(gfxbuf_internal_ptr);
+    if (NULL != gfxbuf_ptr->damage_spans_ptr) {
+        logged_free(gfxbuf_ptr->damage_spans_ptr);
+        gfxbuf_ptr->damage_spans_ptr = NULL;
+    }
+    logged_free(gfxbuf_internal_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
-void bs_gfxbuf_clear(bs_gfxbuf_t *gfxbuf_ptr, const uint32_t color)
+bool bs_gfxbuf_damage_enable(bs_gfxbuf_t *gfxbuf_ptr)
 {
-    uint32_t *pixel_ptr;
+    if (NULL != gfxbuf_ptr->damage_spans_ptr) return true;
+
+    gfxbuf_ptr->damage_spans_ptr = logged_calloc(
+        BS_MAX(1u, gfxbuf_ptr->height), sizeof(bs_gfxbuf_span_t));
+    if (NULL == gfxbuf_ptr->damage_spans_ptr) return false;
+    bs_gfxbuf_damage_add(gfxbuf_ptr, 0, 0,
+                         gfxbuf_ptr->width, gfxbuf_ptr->height);
+    return true;
+}
 
-    if (color == 0) {
-        for (unsigned y = 0; y < gfxbuf_ptr->height; ++y) {
-            pixel_ptr = &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line];
-            // On amd64, using memset is ca 3x faster than filling self.
-            memset(pixel_ptr, 0, sizeof(uint32_t) * gfxbuf_ptr->width);
-        }
-    } else {
-        for (unsigned y = 0; y < gfxbuf_ptr->height; ++y) {
-            pixel_ptr = &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line];
-            unsigned width = gfxbuf_ptr->width;
-            while (width--) *pixel_ptr++ = color;
-        }
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_damage_add(bs_gfxbuf_t *gfxbuf_ptr,
+                          unsigned x,
+                          unsigned y,
+                          unsigned width,
+                          unsigned height)
+{
+    if (NULL == gfxbuf_ptr->damage_spans_ptr ||
+        x >= gfxbuf_ptr->width ||
+        y >= gfxbuf_ptr->height) return;
+    width = BS_MIN(gfxbuf_ptr->width - x, width);
+    height = BS_MIN(gfxbuf_ptr->height - y, height);
+    if (0 == width) return;
+
+    for (unsigned l = y; l < y + height; ++l) {
+        bs_gfxbuf_span_add(&gfxbuf_ptr->damage_spans_ptr[l], x, x + width);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_gfxbuf_damage_next(const bs_gfxbuf_t *gfxbuf_ptr,
+                           unsigned *y_ptr,
+                           bs_gfxbuf_rect_t *rect_ptr)
+{
+    const bs_gfxbuf_span_t *spans_ptr = gfxbuf_ptr->damage_spans_ptr;
+    if (NULL == spans_ptr) return false;
+
+    unsigned y = *y_ptr;
+    while (y < gfxbuf_ptr->height &&
+           spans_ptr[y].x_begin >= spans_ptr[y].x_end) ++y;
+    if (y >= gfxbuf_ptr->height) {
+        *y_ptr = y;
+        return false;
+    }
+
+    rect_ptr->x = spans_ptr[y].x_begin;
+    rect_ptr->y = y;
+    rect_ptr->width = spans_ptr[y].x_end - spans_ptr[y].x_begin;
+    for (++y; y < gfxbuf_ptr->height &&
+             spans_ptr[y].x_begin == spans_ptr[rect_ptr->y].x_begin &&
+             spans_ptr[y].x_end == spans_ptr[rect_ptr->y].x_end; ++y) ;
+    rect_ptr->height = y - rect_ptr->y;
+    *y_ptr = y;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_damage_reset(bs_gfxbuf_t *gfxbuf_ptr)
+{
+    if (NULL == gfxbuf_ptr->damage_spans_ptr) return;
+    memset(gfxbuf_ptr->damage_spans_ptr, 0,
+           gfxbuf_ptr->height * sizeof(bs_gfxbuf_span_t));
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_copy_damaged(bs_gfxbuf_t *dest_gfxbuf_ptr,
+                            const bs_gfxbuf_t *src_gfxbuf_ptr)
+{
+    BS_ASSERT(src_gfxbuf_ptr->width == dest_gfxbuf_ptr->width);
+    BS_ASSERT(src_gfxbuf_ptr->height == dest_gfxbuf_ptr->height);
+
+    bs_gfxbuf_rect_t rect;
+    unsigned y = 0;
+    while (bs_gfxbuf_damage_next(src_gfxbuf_ptr, &y, &rect)) {
+        bs_gfxbuf_copy_area(dest_gfxbuf_ptr, rect.x, rect.y,
+                            src_gfxbuf_ptr, rect.x, rect.y,
+                            rect.width, rect.height);
     }
 }
 
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_clear(bs_gfxbuf_t *gfxbuf_ptr, const uint32_t color)
+{
+    _bs_gfxbuf_clear_with(gfxbuf_ptr, color, _bs_gfxbuf_fill_dispatch());
+    bs_gfxbuf_damage_add(gfxbuf_ptr, 0, 0,
+                         gfxbuf_ptr->width, gfxbuf_ptr->height);
+}
+
 /* ------------------------------------------------------------------------- */
 void bs_gfxbuf_copy(bs_gfxbuf_t *dest_gfxbuf_ptr,
                     const bs_gfxbuf_t *src_gfxbuf_ptr)
@@ -144,6 +647,8 @@ void bs_gfxbuf_copy(bs_gfxbuf_t *dest_gfxbuf_ptr,
         while (width--) *dest_pixel_ptr++ = *src_pixel_ptr++;
 #endif  // 1
     }
+    bs_gfxbuf_damage_add(dest_gfxbuf_ptr, 0, 0,
+                         dest_gfxbuf_ptr->width, dest_gfxbuf_ptr->height);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -157,19 +662,10 @@ void bs_gfxbuf_copy_area(
     unsigned width,
     unsigned height)
 {
-    // Sanity check, don't copy from/in outside the valid buffers.
-    if (src_gfxbuf_ptr->width <= src_x ||
-        src_gfxbuf_ptr->height <= src_y ||
-        dest_gfxbuf_ptr->width <= dest_x ||
-        dest_gfxbuf_ptr->height <= dest_y) {
-        return;
-    }
-
-    // Restrict area to buffer dimensions.
-    width = BS_MIN(dest_gfxbuf_ptr->width - dest_x,
-                   BS_MIN(src_gfxbuf_ptr->width - src_x, width));
-    height = BS_MIN(dest_gfxbuf_ptr->height - dest_y,
-                    BS_MIN(src_gfxbuf_ptr->height - src_y, height));
+    BS_TRACE_SCOPE("bs_gfxbuf_copy_area");
+    if (!_bs_gfxbuf_clip_area(dest_gfxbuf_ptr, dest_x, dest_y,
+                              src_gfxbuf_ptr, src_x, src_y,
+                              &width, &height)) return;
 
     uint32_t *src_data_ptr, *dest_data_ptr;
     for (unsigned y = 0; y < height; ++y) {
@@ -179,6 +675,149 @@ void bs_gfxbuf_copy_area(
             (src_y + y) * src_gfxbuf_ptr->pixels_per_line + src_x];
         memcpy(dest_data_ptr, src_data_ptr, sizeof(uint32_t) * width);
     }
+    bs_gfxbuf_damage_add(dest_gfxbuf_ptr, dest_x, dest_y, width, height);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_blend_area(
+    bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned width,
+    unsigned height)
+{
+    _bs_gfxbuf_blend_area_with(dest_gfxbuf_ptr, dest_x, dest_y,
+                               src_gfxbuf_ptr, src_x, src_y,
+                               width, height,
+                               _bs_gfxbuf_blend_dispatch());
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_gfxbuf_copy_scaled(
+    bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    unsigned dest_width,
+    unsigned dest_height,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned src_width,
+    unsigned src_height,
+    bs_gfxbuf_filter_t filter)
+{
+    return _bs_gfxbuf_copy_scaled_with(
+        dest_gfxbuf_ptr, dest_x, dest_y, dest_width, dest_height,
+        src_gfxbuf_ptr, src_x, src_y, src_width, src_height,
+        filter, _bs_gfxbuf_scale_dispatch());
+}
+
+/* ------------------------------------------------------------------------- */
+bs_gfxbuf_workers_t *bs_gfxbuf_workers_create(unsigned threads)
+{
+    if (0 == threads) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = 1 < cpus ? cpus - 1 : 0;
+    }
+
+    bs_gfxbuf_workers_t *workers_ptr = logged_calloc(
+        1, sizeof(bs_gfxbuf_workers_t));
+    if (NULL == workers_ptr) return NULL;
+    workers_ptr->min_pixels = BS_GFXBUF_PARALLEL_MIN_PIXELS;
+
+    if (0 < threads) {
+        workers_ptr->pool_ptr = bs_thread_pool_create(threads);
+        if (NULL == workers_ptr->pool_ptr) {
+            logged_free(workers_ptr);
+            return NULL;
+        }
+        workers_ptr->threads = threads;
+    }
+    return workers_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_workers_destroy(bs_gfxbuf_workers_t *workers_ptr)
+{
+    if (NULL != workers_ptr->pool_ptr) {
+        bs_thread_pool_destroy(workers_ptr->pool_ptr);
+    }
+    logged_free(workers_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_clear_parallel(bs_gfxbuf_workers_t *workers_ptr,
+                              bs_gfxbuf_t *gfxbuf_ptr,
+                              const uint32_t color)
+{
+    bs_gfxbuf_job_t job = {
+        .band_fn = _bs_gfxbuf_band_clear,
+        .dest = *gfxbuf_ptr,
+        .color = color
+    };
+    job.dest.damage_spans_ptr = NULL;
+    _bs_gfxbuf_workers_run(workers_ptr, &job);
+    bs_gfxbuf_damage_add(gfxbuf_ptr, 0, 0,
+                         gfxbuf_ptr->width, gfxbuf_ptr->height);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_copy_parallel(bs_gfxbuf_workers_t *workers_ptr,
+                             bs_gfxbuf_t *dest_gfxbuf_ptr,
+                             const bs_gfxbuf_t *src_gfxbuf_ptr)
+{
+    BS_ASSERT(src_gfxbuf_ptr->width == dest_gfxbuf_ptr->width);
+    BS_ASSERT(src_gfxbuf_ptr->height == dest_gfxbuf_ptr->height);
+
+    bs_gfxbuf_job_t job = {
+        .band_fn = _bs_gfxbuf_band_copy,
+        .dest = *dest_gfxbuf_ptr,
+        .src = *src_gfxbuf_ptr
+    };
+    job.dest.damage_spans_ptr = NULL;
+    _bs_gfxbuf_workers_run(workers_ptr, &job);
+    bs_gfxbuf_damage_add(dest_gfxbuf_ptr, 0, 0,
+                         dest_gfxbuf_ptr->width, dest_gfxbuf_ptr->height);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_copy_area_parallel(
+    bs_gfxbuf_workers_t *workers_ptr,
+    bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned width,
+    unsigned height)
+{
+    if (!_bs_gfxbuf_clip_area(dest_gfxbuf_ptr, dest_x, dest_y,
+                              src_gfxbuf_ptr, src_x, src_y,
+                              &width, &height)) return;
+
+    bs_gfxbuf_job_t job = {
+        .band_fn = _bs_gfxbuf_band_copy,
+        .dest = {
+            .width = width,
+            .height = height,
+            .pixels_per_line = dest_gfxbuf_ptr->pixels_per_line,
+            .data_ptr = &dest_gfxbuf_ptr->data_ptr[
+                dest_y * dest_gfxbuf_ptr->pixels_per_line + dest_x]
+        },
+        .src = {
+            .width = width,
+            .height = height,
+            .pixels_per_line = src_gfxbuf_ptr->pixels_per_line,
+            .data_ptr = &src_gfxbuf_ptr->data_ptr[
+                src_y * src_gfxbuf_ptr->pixels_per_line + src_x]
+        }
+    };
+    _bs_gfxbuf_workers_run(workers_ptr, &job);
+    bs_gfxbuf_damage_add(dest_gfxbuf_ptr, dest_x, dest_y, width, height);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -338,76 +977,1555 @@ void bs_test_gfxbuf_equals_png_at(
 
 #endif  // HAVE_CAIRO
 
-/* == Tests ================================================================ */
-
-static void test_copy_area(bs_test_t *test_ptr);
-static void test_argb8888_to_floats(bs_test_t *test_ptr);
-#ifdef HAVE_CAIRO
-static void test_cairo(bs_test_t *test_ptr);
-static void test_equals_png(bs_test_t *test_ptr);
-#endif  // HAVE_CAIRO
-
-const bs_test_case_t          bs_gfxbuf_test_cases[] = {
-    { 1, "copy_area", test_copy_area },
-    { 1, "argb8888_fo_floats", test_argb8888_to_floats },
-#ifdef HAVE_CAIRO
-    { 1, "cairo", test_cairo },
-    { 1, "equals_png", test_equals_png },
-#endif  // HAVE_CAIRO
-    { 0, NULL, NULL }
-};
+/* == Local (static) methods =============================================== */
 
 /* ------------------------------------------------------------------------- */
-void test_copy_area(bs_test_t *test_ptr)
+/**
+ * Allocates zero-initialized storage for the pixels, as per `flags`. Pooled
+ * storage is recycled as-is, without zeroing.
+ *
+ * @param bytes
+ * @param flags
+ * @param storage_ptr         Output: How the storage was obtained.
+ * @param storage_bytes_ptr   Output: Actual size of the storage, in bytes.
+ *
+ * @return A pointer to the storage, or NULL on error.
+ */
+void *_bs_gfxbuf_storage_alloc(size_t bytes,
+                               unsigned flags,
+                               bs_gfxbuf_storage_t *storage_ptr,
+                               size_t *storage_bytes_ptr)
 {
-    bs_gfxbuf_t *buf1 = bs_gfxbuf_create(3, 3);
-    bs_gfxbuf_clear(buf1, 0x10203040);
-    bs_gfxbuf_t *buf2 = bs_gfxbuf_create(4, 4);
+    *storage_ptr = BS_GFXBUF_STORAGE_HEAP;
+    if (flags & BS_GFXBUF_POOLED) bytes = _bs_gfxbuf_size_class(bytes);
+    if ((flags & BS_GFXBUF_HUGEPAGES) && bytes >= BS_GFXBUF_HUGEPAGE_SIZE) {
+        *storage_ptr = BS_GFXBUF_STORAGE_MMAP;
+        bytes = (bytes + BS_GFXBUF_HUGEPAGE_SIZE - 1) &
+            ~((size_t)BS_GFXBUF_HUGEPAGE_SIZE - 1);
+    } else if (flags & BS_GFXBUF_ALIGNED) {
+        *storage_ptr = BS_GFXBUF_STORAGE_ALIGNED;
+        // aligned_alloc(3) wants a multiple of the alignment.
+        bytes = (bytes + 63) & ~(size_t)63;
+    }
+    *storage_bytes_ptr = bytes;
 
-    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf2, 1, 1));
+    void *ptr = NULL;
+    if (flags & BS_GFXBUF_POOLED) {
+        ptr = _bs_gfxbuf_pool_take(bytes, *storage_ptr);
+        if (NULL != ptr) return ptr;
+    }
 
-    bs_gfxbuf_copy_area(buf2, 1, 1, buf1, 1, 1, 3, 3);
-    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf2, 0, 0));
-    BS_TEST_VERIFY_EQ(test_ptr, 0X10203040, *bs_gfxbuf_pixel_at(buf2, 1, 1));
-    BS_TEST_VERIFY_EQ(test_ptr, 0X10203040, *bs_gfxbuf_pixel_at(buf2, 2, 2));
-    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf2, 3, 3));
+    if (BS_GFXBUF_STORAGE_MMAP == *storage_ptr) {
+#if defined(MAP_HUGETLB)
+        ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (MAP_FAILED != ptr) return ptr;
+        // Commonly, there are no huge pages reserved. Go for THP instead.
+#endif  // MAP_HUGETLB
+        ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == ptr) {
+            bs_log(BS_ERROR | BS_ERRNO, "Failed mmap(NULL, %zu, "
+                   "PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, "
+                   "-1, 0)", bytes);
+            return NULL;
+        }
+#if defined(MADV_HUGEPAGE)
+        if (0 != madvise(ptr, bytes, MADV_HUGEPAGE)) {
+            bs_log(BS_DEBUG | BS_ERRNO, "Failed madvise(%p, %zu, "
+                   "MADV_HUGEPAGE)", ptr, bytes);
+        }
+#endif  // MADV_HUGEPAGE
+        return ptr;
+    }
 
-    bs_gfxbuf_destroy(buf2);
-    bs_gfxbuf_destroy(buf1);
+    if (BS_GFXBUF_STORAGE_ALIGNED == *storage_ptr) {
+        ptr = aligned_alloc(64, bytes);
+        if (NULL == ptr) {
+            bs_log(BS_ERROR | BS_ERRNO, "Failed aligned_alloc(64, %zu)",
+                   bytes);
+            return NULL;
+        }
+        memset(ptr, 0, bytes);
+        return ptr;
+    }
+    return logged_calloc(1, bytes);
 }
 
 /* ------------------------------------------------------------------------- */
-/** Verifies that cairo_util_argb8888_to_floats behaves properly */
-void test_argb8888_to_floats(bs_test_t *test_ptr) {
-    float r, g, b, alpha;
-    bs_gfxbuf_argb8888_to_floats(0, &r, &g, &b, &alpha);
-    BS_TEST_VERIFY_EQ(test_ptr, 0, r);
-    BS_TEST_VERIFY_EQ(test_ptr, 0, g);
-    BS_TEST_VERIFY_EQ(test_ptr, 0, b);
-    BS_TEST_VERIFY_EQ(test_ptr, 0, alpha);
+/** Releases storage obtained from @ref _bs_gfxbuf_storage_alloc. */
+void _bs_gfxbuf_storage_release(void *ptr,
+                                size_t bytes,
+                                bs_gfxbuf_storage_t storage)
+{
+    switch (storage) {
+    case BS_GFXBUF_STORAGE_HEAP:
+        logged_free(ptr);
+        break;
+    case BS_GFXBUF_STORAGE_ALIGNED:
+        // Not from a logged_* allocator.
+        free(ptr);
+        break;
+    case BS_GFXBUF_STORAGE_MMAP:
+        if (0 != munmap(ptr, bytes)) {
+            bs_log(BS_ERROR | BS_ERRNO, "Failed munmap(%p, %zu)", ptr, bytes);
+        }
+        break;
+    case BS_GFXBUF_STORAGE_SHM:
+        // Not allocated here. Released in bs_gfxbuf_destroy.
+        BS_ABORT();
+        break;
+    }
+}
 
-    bs_gfxbuf_argb8888_to_floats(0xffffffff, &r, &g, &b, &alpha);
-    BS_TEST_VERIFY_EQ(test_ptr, 1.0, r);
-    BS_TEST_VERIFY_EQ(test_ptr, 1.0, g);
-    BS_TEST_VERIFY_EQ(test_ptr, 1.0, b);
-    BS_TEST_VERIFY_EQ(test_ptr, 1.0, alpha);
+/* ------------------------------------------------------------------------- */
+/**
+ * Rounds `bytes` up to the pool's size buckets: There are 4 buckets for each
+ * power of two, wasting less than 25%.
+ */
+size_t _bs_gfxbuf_size_class(size_t bytes)
+{
+    if (bytes <= 4096) return 4096;
+    unsigned shift = 63 - __builtin_clzll(bytes - 1) - 2;
+    return (((bytes - 1) >> shift) + 1) << shift;
+}
 
-    // Floating point - we're fine with a near-enough value.
-    bs_gfxbuf_argb8888_to_floats(0xffc08040, &r, &g, &b, NULL);
-    BS_TEST_VERIFY_TRUE(test_ptr, 1e-3 > fabs(r - 0.7529));
-    BS_TEST_VERIFY_TRUE(test_ptr, 1e-3 > fabs(g - 0.5020));
-    BS_TEST_VERIFY_TRUE(test_ptr, 1e-3 > fabs(b - 0.2510));
+/* ------------------------------------------------------------------------- */
+/** Takes storage of exactly `bytes` from the pool. Returns NULL if none. */
+void *_bs_gfxbuf_pool_take(size_t bytes, bs_gfxbuf_storage_t storage)
+{
+    void *ptr = NULL;
+    bs_mutex_lock(&_bs_gfxbuf_pool.mutex);
+    for (int i = 0; i < BS_GFXBUF_POOL_ENTRIES; ++i) {
+        bs_gfxbuf_pool_entry_t *entry_ptr = &_bs_gfxbuf_pool.entries[i];
+        if (NULL != entry_ptr->ptr &&
+            bytes == entry_ptr->bytes &&
+            storage == entry_ptr->storage) {
+            ptr = entry_ptr->ptr;
+            entry_ptr->ptr = NULL;
+            _bs_gfxbuf_pool.bytes -= bytes;
+            break;
+        }
+    }
+    bs_mutex_unlock(&_bs_gfxbuf_pool.mutex);
+    return ptr;
 }
 
-#ifdef HAVE_CAIRO
 /* ------------------------------------------------------------------------- */
-void test_cairo(bs_test_t *test_ptr)
+/** Puts storage into the pool. Returns false if the pool is full. */
+bool _bs_gfxbuf_pool_put(void *ptr,
+                         size_t bytes,
+                         bs_gfxbuf_storage_t storage)
 {
-    bs_gfxbuf_t *buf = bs_gfxbuf_create(1, 1);
-    cairo_t *cairo_ptr = cairo_create_from_bs_gfxbuf(buf);
+    bool stored = false;
+    bs_mutex_lock(&_bs_gfxbuf_pool.mutex);
+    if (_bs_gfxbuf_pool.bytes + bytes <= BS_GFXBUF_POOL_MAX_BYTES) {
+        for (int i = 0; i < BS_GFXBUF_POOL_ENTRIES; ++i) {
+            bs_gfxbuf_pool_entry_t *entry_ptr = &_bs_gfxbuf_pool.entries[i];
+            if (NULL != entry_ptr->ptr) continue;
+            entry_ptr->ptr = ptr;
+            entry_ptr->bytes = bytes;
+            entry_ptr->storage = storage;
+            _bs_gfxbuf_pool.bytes += bytes;
+            stored = true;
+            break;
+        }
+    }
+    bs_mutex_unlock(&_bs_gfxbuf_pool.mutex);
+    return stored;
+}
 
-    BS_TEST_VERIFY_NEQ(test_ptr, NULL, cairo_ptr);
-    // Color is 0 after initialization.
+/* ------------------------------------------------------------------------- */
+/**
+ * Clears the graphics buffer with `color`, using `fill` for non-zero colors.
+ *
+ * @param gfxbuf_ptr
+ * @param color
+ * @param fill
+ */
+void _bs_gfxbuf_clear_with(bs_gfxbuf_t *gfxbuf_ptr,
+                           const uint32_t color,
+                           bs_gfxbuf_fill_t fill)
+{
+    uint32_t *pixel_ptr;
+
+    // Without padding, the buffer is contiguous and can be filled as a whole.
+    unsigned lines = gfxbuf_ptr->height;
+    size_t width = gfxbuf_ptr->width;
+    if (gfxbuf_ptr->pixels_per_line == gfxbuf_ptr->width) {
+        width *= lines;
+        lines = 1;
+    }
+
+    for (unsigned y = 0; y < lines; ++y) {
+        pixel_ptr = &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line];
+        if (color == 0) {
+            // On amd64, using memset is ca 3x faster than filling self.
+            memset(pixel_ptr, 0, sizeof(uint32_t) * width);
+        } else {
+            fill(pixel_ptr, color, width);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the fastest fill method supported by the CPU we're running on. */
+bs_gfxbuf_fill_t _bs_gfxbuf_fill_dispatch(void)
+{
+#if defined(BS_GFXBUF_X86)
+    if (__builtin_cpu_supports("avx2")) return _bs_gfxbuf_fill_avx2;
+    if (__builtin_cpu_supports("sse2")) return _bs_gfxbuf_fill_sse2;
+#elif defined(BS_GFXBUF_NEON)
+    return _bs_gfxbuf_fill_neon;
+#endif
+    return _bs_gfxbuf_fill_scalar;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Fills pixels one by one. Works everywhere. */
+void _bs_gfxbuf_fill_scalar(uint32_t *dest_ptr, uint32_t color, size_t num)
+{
+    while (num--) *dest_ptr++ = color;
+}
+
+#if defined(BS_GFXBUF_X86)
+/* ------------------------------------------------------------------------- */
+/** Fills pixels with aligned 128-bit stores, 16 pixels per iteration. */
+void _bs_gfxbuf_fill_sse2(uint32_t *dest_ptr, uint32_t color, size_t num)
+{
+    // Head: Align to 16 bytes. Pixels are always 4-byte aligned.
+    for (; 0 < num && 0 != ((uintptr_t)dest_ptr & 0x0f); --num) {
+        *dest_ptr++ = color;
+    }
+
+    __m128i c = _mm_set1_epi32((int)color);
+    for (; num >= 16; num -= 16, dest_ptr += 16) {
+        _mm_store_si128((__m128i*)dest_ptr, c);
+        _mm_store_si128((__m128i*)(dest_ptr + 4), c);
+        _mm_store_si128((__m128i*)(dest_ptr + 8), c);
+        _mm_store_si128((__m128i*)(dest_ptr + 12), c);
+    }
+    for (; num >= 4; num -= 4, dest_ptr += 4) {
+        _mm_store_si128((__m128i*)dest_ptr, c);
+    }
+
+    while (num--) *dest_ptr++ = color;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Fills pixels with aligned 256-bit stores, 32 pixels per iteration. */
+void _bs_gfxbuf_fill_avx2(uint32_t *dest_ptr, uint32_t color, size_t num)
+{
+    // Head: Align to 32 bytes. Pixels are always 4-byte aligned.
+    for (; 0 < num && 0 != ((uintptr_t)dest_ptr & 0x1f); --num) {
+        *dest_ptr++ = color;
+    }
+
+    __m256i c = _mm256_set1_epi32((int)color);
+    for (; num >= 32; num -= 32, dest_ptr += 32) {
+        _mm256_store_si256((__m256i*)dest_ptr, c);
+        _mm256_store_si256((__m256i*)(dest_ptr + 8), c);
+        _mm256_store_si256((__m256i*)(dest_ptr + 16), c);
+        _mm256_store_si256((__m256i*)(dest_ptr + 24), c);
+    }
+    for (; num >= 8; num -= 8, dest_ptr += 8) {
+        _mm256_store_si256((__m256i*)dest_ptr, c);
+    }
+
+    while (num--) *dest_ptr++ = color;
+}
+
+#elif defined(BS_GFXBUF_NEON)
+/* ------------------------------------------------------------------------- */
+/** Fills pixels with 128-bit NEON stores, 16 pixels per iteration. */
+void _bs_gfxbuf_fill_neon(uint32_t *dest_ptr, uint32_t color, size_t num)
+{
+    uint32x4_t c = vdupq_n_u32(color);
+    for (; num >= 16; num -= 16, dest_ptr += 16) {
+        vst1q_u32(dest_ptr, c);
+        vst1q_u32(dest_ptr + 4, c);
+        vst1q_u32(dest_ptr + 8, c);
+        vst1q_u32(dest_ptr + 12, c);
+    }
+    for (; num >= 4; num -= 4, dest_ptr += 4) {
+        vst1q_u32(dest_ptr, c);
+    }
+
+    while (num--) *dest_ptr++ = color;
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Restricts the area at (src_x, src_y) and (dest_x, dest_y) to fit both
+ * buffers.
+ *
+ * @return false if the area lies entirely outside either of the buffers.
+ */
+bool _bs_gfxbuf_clip_area(
+    const bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned *width_ptr,
+    unsigned *height_ptr)
+{
+    // Sanity check, don't copy from/in outside the valid buffers.
+    if (src_gfxbuf_ptr->width <= src_x ||
+        src_gfxbuf_ptr->height <= src_y ||
+        dest_gfxbuf_ptr->width <= dest_x ||
+        dest_gfxbuf_ptr->height <= dest_y) {
+        return false;
+    }
+
+    // Restrict area to buffer dimensions.
+    *width_ptr = BS_MIN(dest_gfxbuf_ptr->width - dest_x,
+                        BS_MIN(src_gfxbuf_ptr->width - src_x, *width_ptr));
+    *height_ptr = BS_MIN(dest_gfxbuf_ptr->height - dest_y,
+                         BS_MIN(src_gfxbuf_ptr->height - src_y, *height_ptr));
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Implements @ref bs_gfxbuf_blend_area, using the `blend` kernel. */
+void _bs_gfxbuf_blend_area_with(
+    bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned width,
+    unsigned height,
+    bs_gfxbuf_blend_t blend)
+{
+    if (!_bs_gfxbuf_clip_area(dest_gfxbuf_ptr, dest_x, dest_y,
+                              src_gfxbuf_ptr, src_x, src_y,
+                              &width, &height)) return;
+
+    for (unsigned y = 0; y < height; ++y) {
+        blend(&dest_gfxbuf_ptr->data_ptr[
+                  (dest_y + y) * dest_gfxbuf_ptr->pixels_per_line + dest_x],
+              &src_gfxbuf_ptr->data_ptr[
+                  (src_y + y) * src_gfxbuf_ptr->pixels_per_line + src_x],
+              width);
+    }
+    bs_gfxbuf_damage_add(dest_gfxbuf_ptr, dest_x, dest_y, width, height);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the fastest blend method supported by the CPU we're running on. */
+bs_gfxbuf_blend_t _bs_gfxbuf_blend_dispatch(void)
+{
+#if defined(BS_GFXBUF_X86)
+    if (__builtin_cpu_supports("avx2")) return _bs_gfxbuf_blend_avx2;
+    if (__builtin_cpu_supports("sse4.1")) return _bs_gfxbuf_blend_sse4;
+#elif defined(BS_GFXBUF_NEON)
+    return _bs_gfxbuf_blend_neon;
+#endif
+    return _bs_gfxbuf_blend_scalar;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Blends one premultiplied pixel: dest = src + dest * (255 - alpha) / 255.
+ *
+ * The division by 255 is computed as (t + (t >> 8)) >> 8, with t rounded,
+ * which is exact for all 8-bit inputs. Two channels are processed at once.
+ */
+static inline uint32_t _bs_gfxbuf_blend_pixel(uint32_t dest, uint32_t src)
+{
+    uint32_t ia = 255 - (src >> 24);
+    uint32_t rb = (dest & 0x00ff00ff) * ia + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+    uint32_t ag = ((dest >> 8) & 0x00ff00ff) * ia + 0x00800080;
+    ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+    return src + rb + ag;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Blends pixels one by one. Works everywhere. */
+void _bs_gfxbuf_blend_scalar(uint32_t *dest_ptr,
+                             const uint32_t *src_ptr,
+                             size_t num)
+{
+    for (; 0 < num; --num, ++dest_ptr, ++src_ptr) {
+        uint32_t alpha = *src_ptr >> 24;
+        if (0xff == alpha) {
+            *dest_ptr = *src_ptr;
+        } else if (0 != *src_ptr) {
+            *dest_ptr = _bs_gfxbuf_blend_pixel(*dest_ptr, *src_ptr);
+        }
+    }
+}
+
+#if defined(BS_GFXBUF_X86)
+/* ------------------------------------------------------------------------- */
+/** Blends 4 pixels per iteration, using 16-bit multiplication on SSE4.1. */
+void _bs_gfxbuf_blend_sse4(uint32_t *dest_ptr,
+                           const uint32_t *src_ptr,
+                           size_t num)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i c128 = _mm_set1_epi16(128);
+    // Spreads the alpha byte of pixels 0,1 (lo) resp. 2,3 (hi) to 16 bit.
+    const __m128i alpha_lo = _mm_setr_epi8(
+        3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+    const __m128i alpha_hi = _mm_setr_epi8(
+        11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+
+    for (; num >= 4; num -= 4, dest_ptr += 4, src_ptr += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)src_ptr);
+        if (_mm_testz_si128(s, s)) continue;
+        __m128i d = _mm_loadu_si128((const __m128i*)dest_ptr);
+
+        __m128i ia_lo = _mm_sub_epi16(c255, _mm_shuffle_epi8(s, alpha_lo));
+        __m128i ia_hi = _mm_sub_epi16(c255, _mm_shuffle_epi8(s, alpha_hi));
+        __m128i t_lo = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia_lo), c128);
+        __m128i t_hi = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia_hi), c128);
+        t_lo = _mm_srli_epi16(_mm_add_epi16(t_lo, _mm_srli_epi16(t_lo, 8)), 8);
+        t_hi = _mm_srli_epi16(_mm_add_epi16(t_hi, _mm_srli_epi16(t_hi, 8)), 8);
+
+        d = _mm_adds_epu8(s, _mm_packus_epi16(t_lo, t_hi));
+        _mm_storeu_si128((__m128i*)dest_ptr, d);
+    }
+
+    _bs_gfxbuf_blend_scalar(dest_ptr, src_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Blends 8 pixels per iteration, using 16-bit multiplication on AVX2. */
+void _bs_gfxbuf_blend_avx2(uint32_t *dest_ptr,
+                           const uint32_t *src_ptr,
+                           size_t num)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i c255 = _mm256_set1_epi16(255);
+    const __m256i c128 = _mm256_set1_epi16(128);
+    // Same as for SSE4.1, the shuffles and unpacks operate per 128-bit lane.
+    const __m256i alpha_lo = _mm256_setr_epi8(
+        3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1,
+        3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+    const __m256i alpha_hi = _mm256_setr_epi8(
+        11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1,
+        11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+
+    for (; num >= 8; num -= 8, dest_ptr += 8, src_ptr += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)src_ptr);
+        if (_mm256_testz_si256(s, s)) continue;
+        __m256i d = _mm256_loadu_si256((const __m256i*)dest_ptr);
+
+        __m256i ia_lo = _mm256_sub_epi16(
+            c255, _mm256_shuffle_epi8(s, alpha_lo));
+        __m256i ia_hi = _mm256_sub_epi16(
+            c255, _mm256_shuffle_epi8(s, alpha_hi));
+        __m256i t_lo = _mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), ia_lo), c128);
+        __m256i t_hi = _mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), ia_hi), c128);
+        t_lo = _mm256_srli_epi16(
+            _mm256_add_epi16(t_lo, _mm256_srli_epi16(t_lo, 8)), 8);
+        t_hi = _mm256_srli_epi16(
+            _mm256_add_epi16(t_hi, _mm256_srli_epi16(t_hi, 8)), 8);
+
+        d = _mm256_adds_epu8(s, _mm256_packus_epi16(t_lo, t_hi));
+        _mm256_storeu_si256((__m256i*)dest_ptr, d);
+    }
+
+    _bs_gfxbuf_blend_scalar(dest_ptr, src_ptr, num);
+}
+
+#elif defined(BS_GFXBUF_NEON)
+/* ------------------------------------------------------------------------- */
+/** Blends 8 pixels per iteration, on de-interleaved channels. */
+void _bs_gfxbuf_blend_neon(uint32_t *dest_ptr,
+                           const uint32_t *src_ptr,
+                           size_t num)
+{
+    for (; num >= 8; num -= 8, dest_ptr += 8, src_ptr += 8) {
+        uint8x8x4_t s = vld4_u8((const uint8_t*)src_ptr);
+        uint8x8x4_t d = vld4_u8((const uint8_t*)dest_ptr);
+        uint8x8_t ia = vmvn_u8(s.val[3]);
+        for (int c = 0; c < 4; ++c) {
+            // (t + ((t + 128) >> 8) + 128) >> 8, matching the scalar method.
+            uint16x8_t t = vmull_u8(d.val[c], ia);
+            d.val[c] = vqadd_u8(s.val[c],
+                                vraddhn_u16(t, vrshrq_n_u16(t, 8)));
+        }
+        vst4_u8((uint8_t*)dest_ptr, d);
+    }
+
+    _bs_gfxbuf_blend_scalar(dest_ptr, src_ptr, num);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Implements @ref bs_gfxbuf_copy_scaled, using `kernels_ptr`.
+ *
+ * Clips the rectangles, and hands views of the source rectangle and of the
+ * visible part of the destination rectangle to the filter's method.
+ */
+bool _bs_gfxbuf_copy_scaled_with(
+    bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    unsigned dest_width,
+    unsigned dest_height,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned src_width,
+    unsigned src_height,
+    bs_gfxbuf_filter_t filter,
+    const bs_gfxbuf_scale_kernels_t *kernels_ptr)
+{
+    if (src_gfxbuf_ptr->width <= src_x ||
+        src_gfxbuf_ptr->height <= src_y ||
+        dest_gfxbuf_ptr->width <= dest_x ||
+        dest_gfxbuf_ptr->height <= dest_y) {
+        return true;
+    }
+    src_width = BS_MIN(src_gfxbuf_ptr->width - src_x, src_width);
+    src_height = BS_MIN(src_gfxbuf_ptr->height - src_y, src_height);
+    if (0 == src_width || 0 == src_height ||
+        0 == dest_width || 0 == dest_height) return true;
+
+    // Same size: Both filters amount to a copy.
+    if (src_width == dest_width && src_height == dest_height) {
+        bs_gfxbuf_copy_area(dest_gfxbuf_ptr, dest_x, dest_y,
+                            src_gfxbuf_ptr, src_x, src_y,
+                            dest_width, dest_height);
+        return true;
+    }
+
+    // Views, for brevity: `width` and `height` of the destination view are
+    // the visible part. The scale is given by `dest_width` & `dest_height`.
+    bs_gfxbuf_t src_view = {
+        .width = src_width,
+        .height = src_height,
+        .pixels_per_line = src_gfxbuf_ptr->pixels_per_line,
+        .data_ptr = &src_gfxbuf_ptr->data_ptr[
+            src_y * src_gfxbuf_ptr->pixels_per_line + src_x]
+    };
+    bs_gfxbuf_t dest_view = {
+        .width = BS_MIN(dest_gfxbuf_ptr->width - dest_x, dest_width),
+        .height = BS_MIN(dest_gfxbuf_ptr->height - dest_y, dest_height),
+        .pixels_per_line = dest_gfxbuf_ptr->pixels_per_line,
+        .data_ptr = &dest_gfxbuf_ptr->data_ptr[
+            dest_y * dest_gfxbuf_ptr->pixels_per_line + dest_x]
+    };
+
+    bool rv;
+    switch (filter) {
+    case BS_GFXBUF_FILTER_NEAREST:
+        rv = _bs_gfxbuf_scale_nearest(&dest_view, &src_view,
+                                      dest_width, dest_height, kernels_ptr);
+        break;
+    case BS_GFXBUF_FILTER_BILINEAR:
+        rv = _bs_gfxbuf_scale_bilinear(&dest_view, &src_view,
+                                       dest_width, dest_height, kernels_ptr);
+        break;
+    default:
+        bs_log(BS_ERROR, "Unknown filter %d", filter);
+        return false;
+    }
+    bs_gfxbuf_damage_add(dest_gfxbuf_ptr, dest_x, dest_y,
+                         dest_view.width, dest_view.height);
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns the 16.16 fixed-point source position for destination `pos`, when
+ * scaling `src_size` to `dest_size`, such that pixel centers are mapped.
+ * The position is offset by half a pixel: Its integer part is the source
+ * pixel whose center is at or left of the mapped center.
+ */
+static inline int64_t _bs_gfxbuf_scale_pos(unsigned pos,
+                                           unsigned src_size,
+                                           unsigned dest_size)
+{
+    return ((((int64_t)pos << 1) + 1) * src_size << 16) /
+        ((int64_t)dest_size << 1) - 0x8000;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Scales the source view into the destination view, nearest-neighbour. */
+bool _bs_gfxbuf_scale_nearest(
+    bs_gfxbuf_t *dest_view_ptr,
+    const bs_gfxbuf_t *src_view_ptr,
+    unsigned dest_width,
+    unsigned dest_height,
+    const bs_gfxbuf_scale_kernels_t *kernels_ptr)
+{
+    bool doubling = dest_width == 2 * src_view_ptr->width;
+    uint32_t *x_ptr = NULL;
+    if (!doubling) {
+        x_ptr = logged_calloc(dest_view_ptr->width, sizeof(uint32_t));
+        if (NULL == x_ptr) return false;
+        for (unsigned x = 0; x < dest_view_ptr->width; ++x) {
+            x_ptr[x] = (_bs_gfxbuf_scale_pos(
+                            x, src_view_ptr->width, dest_width) + 0x8000) >> 16;
+        }
+    }
+
+    int64_t prev_src_y = -1;
+    for (unsigned y = 0; y < dest_view_ptr->height; ++y) {
+        int64_t src_y = (_bs_gfxbuf_scale_pos(
+                             y, src_view_ptr->height, dest_height) +
+                         0x8000) >> 16;
+        uint32_t *dest_ptr = &dest_view_ptr->data_ptr[
+            y * dest_view_ptr->pixels_per_line];
+
+        // Same source line as the line above: Just copy that.
+        if (src_y == prev_src_y) {
+            memcpy(dest_ptr, dest_ptr - dest_view_ptr->pixels_per_line,
+                   sizeof(uint32_t) * dest_view_ptr->width);
+            continue;
+        }
+        prev_src_y = src_y;
+
+        const uint32_t *src_ptr = &src_view_ptr->data_ptr[
+            src_y * src_view_ptr->pixels_per_line];
+        if (doubling) {
+            kernels_ptr->double_row(dest_ptr, src_ptr,
+                                    dest_view_ptr->width / 2);
+            if (dest_view_ptr->width & 1) {
+                dest_ptr[dest_view_ptr->width - 1] =
+                    src_ptr[dest_view_ptr->width / 2];
+            }
+        } else {
+            for (unsigned x = 0; x < dest_view_ptr->width; ++x) {
+                dest_ptr[x] = src_ptr[x_ptr[x]];
+            }
+        }
+    }
+
+    if (NULL != x_ptr) logged_free(x_ptr);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Scales the source view into the destination view, bilinear.
+ *
+ * Each destination line is interpolated horizontally from a line that is
+ * interpolated vertically first. The latter is kept while consecutive lines
+ * map to the same source position.
+ */
+bool _bs_gfxbuf_scale_bilinear(
+    bs_gfxbuf_t *dest_view_ptr,
+    const bs_gfxbuf_t *src_view_ptr,
+    unsigned dest_width,
+    unsigned dest_height,
+    const bs_gfxbuf_scale_kernels_t *kernels_ptr)
+{
+    unsigned src_width = src_view_ptr->width;
+    if (2 * dest_width == src_width &&
+        2 * dest_height == src_view_ptr->height) {
+        for (unsigned y = 0; y < dest_view_ptr->height; ++y) {
+            kernels_ptr->halve_rows(
+                &dest_view_ptr->data_ptr[y * dest_view_ptr->pixels_per_line],
+                &src_view_ptr->data_ptr[
+                    2 * y * src_view_ptr->pixels_per_line],
+                &src_view_ptr->data_ptr[
+                    (2 * y + 1) * src_view_ptr->pixels_per_line],
+                dest_view_ptr->width);
+        }
+        return true;
+    }
+
+    // Per destination column: Left source pixel and weight of the right one.
+    uint32_t *x_ptr = logged_calloc(dest_view_ptr->width, sizeof(uint32_t));
+    if (NULL == x_ptr) return false;
+    uint8_t *weight_ptr = logged_calloc(dest_view_ptr->width, sizeof(uint8_t));
+    if (NULL == weight_ptr) {
+        logged_free(x_ptr);
+        return false;
+    }
+    for (unsigned x = 0; x < dest_view_ptr->width; ++x) {
+        int64_t pos = _bs_gfxbuf_scale_pos(x, src_width, dest_width);
+        pos = BS_MAX(0, BS_MIN((int64_t)(src_width - 1) << 16, pos));
+        x_ptr[x] = pos >> 16;
+        weight_ptr[x] = (pos >> 8) & 0xff;
+    }
+    // Only columns in [x_begin, x_end) of the source are needed.
+    unsigned x_begin = x_ptr[0];
+    unsigned x_end = BS_MIN(x_ptr[dest_view_ptr->width - 1] + 2, src_width);
+    uint32_t *line_ptr = logged_calloc(src_width, sizeof(uint32_t));
+    if (NULL == line_ptr) {
+        logged_free(weight_ptr);
+        logged_free(x_ptr);
+        return false;
+    }
+
+    int64_t prev_pos = -1;
+    const uint32_t *src_line_ptr = NULL;
+    for (unsigned y = 0; y < dest_view_ptr->height; ++y) {
+        int64_t pos = _bs_gfxbuf_scale_pos(
+            y, src_view_ptr->height, dest_height);
+        pos = BS_MAX(0, BS_MIN(
+                         (int64_t)(src_view_ptr->height - 1) << 16, pos));
+        pos &= ~(int64_t)0xff;
+        if (pos != prev_pos) {
+            prev_pos = pos;
+            const uint32_t *src0_ptr = &src_view_ptr->data_ptr[
+                (pos >> 16) * src_view_ptr->pixels_per_line];
+            uint32_t weight = (pos >> 8) & 0xff;
+            if (0 == weight) {
+                src_line_ptr = src0_ptr;
+            } else {
+                kernels_ptr->lerp_rows(
+                    line_ptr + x_begin, src0_ptr + x_begin,
+                    src0_ptr + src_view_ptr->pixels_per_line + x_begin,
+                    weight, x_end - x_begin);
+                src_line_ptr = line_ptr;
+            }
+        }
+
+        uint32_t *dest_ptr = &dest_view_ptr->data_ptr[
+            y * dest_view_ptr->pixels_per_line];
+        for (unsigned x = 0; x < dest_view_ptr->width; ++x) {
+            const uint32_t *p_ptr = &src_line_ptr[x_ptr[x]];
+            if (0 == weight_ptr[x]) {
+                dest_ptr[x] = *p_ptr;
+            } else {
+                _bs_gfxbuf_lerp_rows_scalar(
+                    &dest_ptr[x], p_ptr, p_ptr + 1, weight_ptr[x], 1);
+            }
+        }
+    }
+
+    logged_free(line_ptr);
+    logged_free(weight_ptr);
+    logged_free(x_ptr);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the fastest scaling kernels supported by the CPU. */
+const bs_gfxbuf_scale_kernels_t *_bs_gfxbuf_scale_dispatch(void)
+{
+#if defined(BS_GFXBUF_X86)
+    if (__builtin_cpu_supports("sse2")) return &_bs_gfxbuf_scale_sse2;
+#elif defined(BS_GFXBUF_NEON)
+    return &_bs_gfxbuf_scale_neon;
+#endif
+    return &_bs_gfxbuf_scale_scalar;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Interpolates pixels one by one. Two channels are processed at once: With
+ * weights summing up to 256, each channel's sum stays within 16 bits.
+ */
+void _bs_gfxbuf_lerp_rows_scalar(uint32_t *dest_ptr,
+                                 const uint32_t *src0_ptr,
+                                 const uint32_t *src1_ptr,
+                                 uint32_t weight,
+                                 size_t num)
+{
+    uint32_t iweight = 256 - weight;
+    for (; 0 < num; --num, ++dest_ptr, ++src0_ptr, ++src1_ptr) {
+        uint32_t rb = ((*src0_ptr & 0x00ff00ff) * iweight +
+                       (*src1_ptr & 0x00ff00ff) * weight) >> 8;
+        uint32_t ag = ((*src0_ptr >> 8) & 0x00ff00ff) * iweight +
+            ((*src1_ptr >> 8) & 0x00ff00ff) * weight;
+        *dest_ptr = (rb & 0x00ff00ff) | (ag & 0xff00ff00);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Doubles pixels one by one. Works everywhere. */
+void _bs_gfxbuf_double_row_scalar(uint32_t *dest_ptr,
+                                  const uint32_t *src_ptr,
+                                  size_t num)
+{
+    for (; 0 < num; --num, dest_ptr += 2, ++src_ptr) {
+        dest_ptr[0] = *src_ptr;
+        dest_ptr[1] = *src_ptr;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Halves pixels one by one: Averages rows first, then columns, rounding down
+ * each time. That yields the same as @ref _bs_gfxbuf_lerp_rows_scalar with a
+ * weight of 128.
+ */
+void _bs_gfxbuf_halve_rows_scalar(uint32_t *dest_ptr,
+                                  const uint32_t *src0_ptr,
+                                  const uint32_t *src1_ptr,
+                                  size_t num)
+{
+    uint32_t v[2];
+    for (; 0 < num; --num, ++dest_ptr, src0_ptr += 2, src1_ptr += 2) {
+        _bs_gfxbuf_lerp_rows_scalar(v, src0_ptr, src1_ptr, 128, 2);
+        _bs_gfxbuf_lerp_rows_scalar(dest_ptr, &v[0], &v[1], 128, 1);
+    }
+}
+
+#if defined(BS_GFXBUF_X86)
+/* ------------------------------------------------------------------------- */
+/** Interpolates 4 pixels per iteration, using 16-bit multiplication. */
+void _bs_gfxbuf_lerp_rows_sse2(uint32_t *dest_ptr,
+                               const uint32_t *src0_ptr,
+                               const uint32_t *src1_ptr,
+                               uint32_t weight,
+                               size_t num)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w1 = _mm_set1_epi16(weight);
+    const __m128i w0 = _mm_set1_epi16(256 - weight);
+
+    for (; num >= 4; num -= 4, dest_ptr += 4, src0_ptr += 4, src1_ptr += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)src0_ptr);
+        __m128i b = _mm_loadu_si128((const __m128i*)src1_ptr);
+        __m128i lo = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1));
+        __m128i hi = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1));
+        _mm_storeu_si128((__m128i*)dest_ptr, _mm_packus_epi16(
+                             _mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+
+    _bs_gfxbuf_lerp_rows_scalar(dest_ptr, src0_ptr, src1_ptr, weight, num);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Doubles 4 pixels per iteration, by interleaving with themselves. */
+void _bs_gfxbuf_double_row_sse2(uint32_t *dest_ptr,
+                                const uint32_t *src_ptr,
+                                size_t num)
+{
+    for (; num >= 4; num -= 4, dest_ptr += 8, src_ptr += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)src_ptr);
+        _mm_storeu_si128((__m128i*)dest_ptr, _mm_unpacklo_epi32(s, s));
+        _mm_storeu_si128((__m128i*)(dest_ptr + 4), _mm_unpackhi_epi32(s, s));
+    }
+
+    _bs_gfxbuf_double_row_scalar(dest_ptr, src_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the per-byte average of `a` and `b`, rounded down. */
+__attribute__((target("sse2")))
+static inline __m128i _bs_gfxbuf_avg_floor_sse2(__m128i a, __m128i b)
+{
+    // _mm_avg_epu8 rounds up. Subtract 1 where the sum of a and b is odd.
+    return _mm_sub_epi8(
+        _mm_avg_epu8(a, b),
+        _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Halves 4 pixels from 2x8 per iteration, separating even & odd columns. */
+void _bs_gfxbuf_halve_rows_sse2(uint32_t *dest_ptr,
+                                const uint32_t *src0_ptr,
+                                const uint32_t *src1_ptr,
+                                size_t num)
+{
+    for (; num >= 4; num -= 4, dest_ptr += 4, src0_ptr += 8, src1_ptr += 8) {
+        __m128i v0 = _bs_gfxbuf_avg_floor_sse2(
+            _mm_loadu_si128((const __m128i*)src0_ptr),
+            _mm_loadu_si128((const __m128i*)src1_ptr));
+        __m128i v1 = _bs_gfxbuf_avg_floor_sse2(
+            _mm_loadu_si128((const __m128i*)(src0_ptr + 4)),
+            _mm_loadu_si128((const __m128i*)(src1_ptr + 4)));
+        __m128i even = _mm_castps_si128(_mm_shuffle_ps(
+            _mm_castsi128_ps(v0), _mm_castsi128_ps(v1),
+            _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i odd = _mm_castps_si128(_mm_shuffle_ps(
+            _mm_castsi128_ps(v0), _mm_castsi128_ps(v1),
+            _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_si128((__m128i*)dest_ptr,
+                         _bs_gfxbuf_avg_floor_sse2(even, odd));
+    }
+
+    _bs_gfxbuf_halve_rows_scalar(dest_ptr, src0_ptr, src1_ptr, num);
+}
+
+#elif defined(BS_GFXBUF_NEON)
+/* ------------------------------------------------------------------------- */
+/** Interpolates 4 pixels per iteration, using widening multiply-add. */
+void _bs_gfxbuf_lerp_rows_neon(uint32_t *dest_ptr,
+                               const uint32_t *src0_ptr,
+                               const uint32_t *src1_ptr,
+                               uint32_t weight,
+                               size_t num)
+{
+    // `weight` is in [1, 255], hence both weights fit into 8 bits.
+    const uint8x8_t w0 = vdup_n_u8(256 - weight);
+    const uint8x8_t w1 = vdup_n_u8(weight);
+
+    for (; num >= 4; num -= 4, dest_ptr += 4, src0_ptr += 4, src1_ptr += 4) {
+        uint8x16_t a = vld1q_u8((const uint8_t*)src0_ptr);
+        uint8x16_t b = vld1q_u8((const uint8_t*)src1_ptr);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(a), w0),
+                                 vget_low_u8(b), w1);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(a), w0),
+                                 vget_high_u8(b), w1);
+        vst1q_u8((uint8_t*)dest_ptr,
+                 vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+    }
+
+    _bs_gfxbuf_lerp_rows_scalar(dest_ptr, src0_ptr, src1_ptr, weight, num);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Doubles 4 pixels per iteration, by zipping with themselves. */
+void _bs_gfxbuf_double_row_neon(uint32_t *dest_ptr,
+                                const uint32_t *src_ptr,
+                                size_t num)
+{
+    for (; num >= 4; num -= 4, dest_ptr += 8, src_ptr += 4) {
+        uint32x4_t s = vld1q_u32(src_ptr);
+        uint32x4x2_t d = vzipq_u32(s, s);
+        vst1q_u32(dest_ptr, d.val[0]);
+        vst1q_u32(dest_ptr + 4, d.val[1]);
+    }
+
+    _bs_gfxbuf_double_row_scalar(dest_ptr, src_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Halves 4 pixels from 2x8 per iteration, loading even & odd columns. */
+void _bs_gfxbuf_halve_rows_neon(uint32_t *dest_ptr,
+                                const uint32_t *src0_ptr,
+                                const uint32_t *src1_ptr,
+                                size_t num)
+{
+    for (; num >= 4; num -= 4, dest_ptr += 4, src0_ptr += 8, src1_ptr += 8) {
+        uint32x4x2_t r0 = vld2q_u32(src0_ptr);
+        uint32x4x2_t r1 = vld2q_u32(src1_ptr);
+        // vhaddq_u8 is (a + b) >> 1, rounding down like the scalar method.
+        uint8x16_t even = vhaddq_u8(vreinterpretq_u8_u32(r0.val[0]),
+                                    vreinterpretq_u8_u32(r1.val[0]));
+        uint8x16_t odd = vhaddq_u8(vreinterpretq_u8_u32(r0.val[1]),
+                                   vreinterpretq_u8_u32(r1.val[1]));
+        vst1q_u32(dest_ptr, vreinterpretq_u32_u8(vhaddq_u8(even, odd)));
+    }
+
+    _bs_gfxbuf_halve_rows_scalar(dest_ptr, src0_ptr, src1_ptr, num);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/** Range method for the thread pool: Runs bands [begin, end) of the job. */
+void _bs_gfxbuf_workers_run_bands(void *arg_ptr, size_t begin, size_t end)
+{
+    const bs_gfxbuf_job_t *job_ptr = arg_ptr;
+
+    for (size_t band = begin; band < end; ++band) {
+        unsigned y = (uint64_t)band * job_ptr->dest.height / job_ptr->bands;
+        unsigned lines = (uint64_t)(band + 1) * job_ptr->dest.height /
+            job_ptr->bands - y;
+        bs_gfxbuf_t dest_band = {
+            .width = job_ptr->dest.width,
+            .height = lines,
+            .pixels_per_line = job_ptr->dest.pixels_per_line,
+            .data_ptr = &job_ptr->dest.data_ptr[
+                y * job_ptr->dest.pixels_per_line]
+        };
+        bs_gfxbuf_t src_band = {};
+        if (NULL != job_ptr->src.data_ptr) {
+            src_band = (bs_gfxbuf_t){
+                .width = job_ptr->src.width,
+                .height = lines,
+                .pixels_per_line = job_ptr->src.pixels_per_line,
+                .data_ptr = &job_ptr->src.data_ptr[
+                    y * job_ptr->src.pixels_per_line]
+            };
+        }
+        job_ptr->band_fn(&dest_band, &src_band, job_ptr->color);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs `job_ptr` on the worker pool, and returns once all bands are done.
+ * Runs on the calling thread, if there's no pool or the job is too small.
+ */
+void _bs_gfxbuf_workers_run(bs_gfxbuf_workers_t *workers_ptr,
+                            bs_gfxbuf_job_t *job_ptr)
+{
+    size_t pixels = (size_t)job_ptr->dest.width * job_ptr->dest.height;
+    if (NULL == workers_ptr ||
+        0 == workers_ptr->threads ||
+        pixels < workers_ptr->min_pixels ||
+        2 > job_ptr->dest.height) {
+        job_ptr->band_fn(&job_ptr->dest, &job_ptr->src, job_ptr->color);
+        return;
+    }
+
+    // A few bands per thread, to balance uneven progress among threads.
+    job_ptr->bands = BS_MIN(job_ptr->dest.height,
+                            4 * (workers_ptr->threads + 1));
+
+    bs_thread_pool_parallel_for(workers_ptr->pool_ptr, 0, job_ptr->bands, 1,
+                                _bs_gfxbuf_workers_run_bands, job_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Band method for @ref bs_gfxbuf_clear_parallel. */
+void _bs_gfxbuf_band_clear(bs_gfxbuf_t *dest_band_ptr,
+                           __UNUSED__ const bs_gfxbuf_t *src_band_ptr,
+                           uint32_t color)
+{
+    bs_gfxbuf_clear(dest_band_ptr, color);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Band method for @ref bs_gfxbuf_copy_parallel and copy_area. */
+void _bs_gfxbuf_band_copy(bs_gfxbuf_t *dest_band_ptr,
+                          const bs_gfxbuf_t *src_band_ptr,
+                          __UNUSED__ uint32_t color)
+{
+    bs_gfxbuf_copy(dest_band_ptr, src_band_ptr);
+}
+
+/* == Tests ================================================================ */
+
+static void test_create_with_flags(bs_test_t *test_ptr);
+static void test_shm(bs_test_t *test_ptr);
+static void test_clear(bs_test_t *test_ptr);
+static void test_copy_area(bs_test_t *test_ptr);
+static void test_blend_area(bs_test_t *test_ptr);
+static void test_copy_scaled(bs_test_t *test_ptr);
+static void test_parallel(bs_test_t *test_ptr);
+static void test_damage(bs_test_t *test_ptr);
+static void test_argb8888_to_floats(bs_test_t *test_ptr);
+#ifdef HAVE_CAIRO
+static void test_cairo(bs_test_t *test_ptr);
+static void test_equals_png(bs_test_t *test_ptr);
+#endif  // HAVE_CAIRO
+
+const bs_test_case_t          bs_gfxbuf_test_cases[] = {
+    { 1, "create_with_flags", test_create_with_flags },
+    { 1, "shm", test_shm },
+    { 1, "clear", test_clear },
+    { 1, "copy_area", test_copy_area },
+    { 1, "blend_area", test_blend_area },
+    { 1, "copy_scaled", test_copy_scaled },
+    { 1, "parallel", test_parallel },
+    { 1, "damage", test_damage },
+    { 1, "argb8888_fo_floats", test_argb8888_to_floats },
+#ifdef HAVE_CAIRO
+    { 1, "cairo", test_cairo },
+    { 1, "equals_png", test_equals_png },
+#endif  // HAVE_CAIRO
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Verifies alignment, huge page backing and pooling. */
+void test_create_with_flags(bs_test_t *test_ptr)
+{
+    bs_gfxbuf_t *buf_ptr;
+
+    BS_TEST_VERIFY_EQ(test_ptr, 4096, _bs_gfxbuf_size_class(1));
+    BS_TEST_VERIFY_EQ(test_ptr, 5120, _bs_gfxbuf_size_class(4097));
+    BS_TEST_VERIFY_EQ(test_ptr, 5120, _bs_gfxbuf_size_class(5120));
+    BS_TEST_VERIFY_EQ(test_ptr, 7 << 20, _bs_gfxbuf_size_class(6 << 20 | 1));
+
+    buf_ptr = bs_gfxbuf_create_with_flags(17, 3, BS_GFXBUF_ALIGNED);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 32, buf_ptr->pixels_per_line);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, (uintptr_t)buf_ptr->data_ptr & 0x3f);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf_ptr, 16, 2));
+    bs_gfxbuf_destroy(buf_ptr);
+
+    buf_ptr = bs_gfxbuf_create_with_flags(
+        1024, 1024, BS_GFXBUF_ALIGNED | BS_GFXBUF_HUGEPAGES);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 1024, buf_ptr->pixels_per_line);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, (uintptr_t)buf_ptr->data_ptr & 0xfff);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf_ptr, 1023, 1023));
+    bs_gfxbuf_clear(buf_ptr, 0x01020304);
+    bs_gfxbuf_destroy(buf_ptr);
+
+    // Pooled: Storage of the same bucket is recycled, without zeroing.
+    bs_gfxbuf_pool_flush();
+    buf_ptr = bs_gfxbuf_create_with_flags(100, 100, BS_GFXBUF_POOLED);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    uint32_t *data_ptr = buf_ptr->data_ptr;
+    bs_gfxbuf_set_pixel(buf_ptr, 0, 0, 42);
+    bs_gfxbuf_destroy(buf_ptr);
+    buf_ptr = bs_gfxbuf_create_with_flags(101, 99, BS_GFXBUF_POOLED);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, data_ptr, buf_ptr->data_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 42, *bs_gfxbuf_pixel_at(buf_ptr, 0, 0));
+    bs_gfxbuf_destroy(buf_ptr);
+
+    // Unaligned storage of the same bucket is not used for an aligned buffer.
+    buf_ptr = bs_gfxbuf_create_with_flags(
+        96, 100, BS_GFXBUF_ALIGNED | BS_GFXBUF_POOLED);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, (uintptr_t)buf_ptr->data_ptr & 63);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf_ptr, 0, 0));
+    bs_gfxbuf_destroy(buf_ptr);
+    bs_gfxbuf_pool_flush();
+    BS_TEST_VERIFY_EQ(test_ptr, 0, _bs_gfxbuf_pool.bytes);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the shared memory buffer is visible through its memfd. */
+void test_shm(bs_test_t *test_ptr)
+{
+    bs_gfxbuf_shm_t shm = {};
+
+    bs_gfxbuf_t *buf_ptr = bs_gfxbuf_create(3, 2);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_gfxbuf_get_shm(buf_ptr, &shm));
+    bs_gfxbuf_destroy(buf_ptr);
+
+    buf_ptr = bs_gfxbuf_create_shm(3, 2);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, bs_gfxbuf_get_shm(buf_ptr, &shm));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, shm.offset);
+    BS_TEST_VERIFY_EQ(test_ptr, 24, shm.size);
+    BS_TEST_VERIFY_EQ(test_ptr, 12, shm.stride);
+
+    // Pixels written to the buffer show up in a separate mapping of the fd.
+    bs_gfxbuf_set_pixel(buf_ptr, 2, 1, 0x11223344);
+    uint32_t *data_ptr = mmap(NULL, shm.size, PROT_READ, MAP_SHARED,
+                              shm.fd, shm.offset);
+    BS_TEST_VERIFY_NEQ(test_ptr, MAP_FAILED, data_ptr);
+    if (MAP_FAILED != data_ptr) {
+        BS_TEST_VERIFY_EQ(test_ptr, 0x11223344, data_ptr[5]);
+        BS_TEST_VERIFY_EQ(test_ptr, 0, data_ptr[4]);
+        munmap(data_ptr, shm.size);
+    }
+    bs_gfxbuf_destroy(buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, -1, fcntl(shm.fd, F_GETFD));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies a fill kernel covers lines exactly, for all widths and offsets. */
+static void _test_clear_with(bs_test_t *test_ptr, bs_gfxbuf_fill_t fill)
+{
+    uint32_t data[4 * 80];
+
+    for (unsigned width = 1; width < 70; ++width) {
+        for (unsigned offset = 0; offset < 8; ++offset) {
+            memset(data, 0, sizeof(data));
+            bs_gfxbuf_t *buf_ptr = bs_gfxbuf_create_unmanaged(
+                width, 3, 80, &data[offset]);
+            BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+            _bs_gfxbuf_clear_with(buf_ptr, 0x11223344, fill);
+            bs_gfxbuf_destroy(buf_ptr);
+
+            for (unsigned i = 0; i < 4 * 80; ++i) {
+                unsigned x = (i - offset) % 80, y = (i - offset) / 80;
+                uint32_t expected = 0;
+                if (i >= offset && x < width && y < 3) expected = 0x11223344;
+                if (expected != data[i]) {
+                    BS_TEST_FAIL(test_ptr, "width %u, offset %u: "
+                                 "data[%u] = 0x%08"PRIx32", expected 0x%08"
+                                 PRIx32, width, offset, i, data[i], expected);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void test_clear(bs_test_t *test_ptr)
+{
+    _test_clear_with(test_ptr, _bs_gfxbuf_fill_scalar);
+    _test_clear_with(test_ptr, _bs_gfxbuf_fill_dispatch());
+#if defined(BS_GFXBUF_X86)
+    if (__builtin_cpu_supports("sse2")) {
+        _test_clear_with(test_ptr, _bs_gfxbuf_fill_sse2);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        _test_clear_with(test_ptr, _bs_gfxbuf_fill_avx2);
+    }
+#elif defined(BS_GFXBUF_NEON)
+    _test_clear_with(test_ptr, _bs_gfxbuf_fill_neon);
+#endif
+
+    // Padded buffer, cleared to 0: Must leave the padding untouched.
+    uint32_t data[3 * 4];
+    for (unsigned i = 0; i < 3 * 4; ++i) data[i] = 0xff;
+    bs_gfxbuf_t *buf_ptr = bs_gfxbuf_create_unmanaged(3, 3, 4, data);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    bs_gfxbuf_clear(buf_ptr, 0);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, data[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff, data[3]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, data[10]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff, data[11]);
+    bs_gfxbuf_clear(buf_ptr, 0x01020304);
+    BS_TEST_VERIFY_EQ(test_ptr, 0x01020304, data[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff, data[7]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0x01020304, data[10]);
+    bs_gfxbuf_destroy(buf_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void test_copy_area(bs_test_t *test_ptr)
+{
+    bs_gfxbuf_t *buf1 = bs_gfxbuf_create(3, 3);
+    bs_gfxbuf_clear(buf1, 0x10203040);
+    bs_gfxbuf_t *buf2 = bs_gfxbuf_create(4, 4);
+
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf2, 1, 1));
+
+    bs_gfxbuf_copy_area(buf2, 1, 1, buf1, 1, 1, 3, 3);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf2, 0, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0X10203040, *bs_gfxbuf_pixel_at(buf2, 1, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 0X10203040, *bs_gfxbuf_pixel_at(buf2, 2, 2));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf2, 3, 3));
+
+    bs_gfxbuf_destroy(buf2);
+    bs_gfxbuf_destroy(buf1);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the blend kernel `blend` against the scalar implementation. */
+static void _test_blend_with(bs_test_t *test_ptr, bs_gfxbuf_blend_t blend)
+{
+    uint32_t src[67], dest[67], expected[67];
+
+    uint32_t seed = 1;
+    for (int i = 0; i < 67; ++i) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t alpha = (seed >> 16) & 0xff;
+        if (i % 5 == 0) alpha = 0xff;
+        if (i % 7 == 0) alpha = 0;
+        // Premultiplied: no color component may exceed alpha.
+        src[i] = (alpha << 24) |
+            ((((seed >> 4) & 0xff) * alpha / 255) << 16) |
+            ((((seed >> 8) & 0xff) * alpha / 255) << 8) |
+            (((seed >> 12) & 0xff) * alpha / 255);
+        dest[i] = seed * 2654435761u;
+        expected[i] = dest[i];
+    }
+    _bs_gfxbuf_blend_scalar(expected, src, 67);
+
+    for (size_t num = 0; num <= 67; num += 13) {
+        uint32_t d[67];
+        memcpy(d, dest, sizeof(d));
+        blend(d, src, num);
+        BS_TEST_VERIFY_MEMEQ(test_ptr, expected, d, num * sizeof(uint32_t));
+        BS_TEST_VERIFY_MEMEQ(test_ptr, &dest[num], &d[num],
+                             (67 - num) * sizeof(uint32_t));
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void test_blend_area(bs_test_t *test_ptr)
+{
+    bs_gfxbuf_t *src_ptr = bs_gfxbuf_create(3, 3);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, src_ptr);
+    bs_gfxbuf_t *dest_ptr = bs_gfxbuf_create(4, 4);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, dest_ptr);
+
+    bs_gfxbuf_clear(src_ptr, 0x80402010);
+    bs_gfxbuf_set_pixel(src_ptr, 2, 2, 0);
+    bs_gfxbuf_clear(dest_ptr, 0xff0080ff);
+    bs_gfxbuf_blend_area(dest_ptr, 1, 1, src_ptr, 1, 1, 3, 3);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff0080ff, *bs_gfxbuf_pixel_at(dest_ptr, 0, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff40608f, *bs_gfxbuf_pixel_at(dest_ptr, 1, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff0080ff, *bs_gfxbuf_pixel_at(dest_ptr, 2, 2));
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff0080ff, *bs_gfxbuf_pixel_at(dest_ptr, 3, 3));
+
+    // Opaque source replaces destination.
+    bs_gfxbuf_clear(src_ptr, 0xff102030);
+    bs_gfxbuf_blend_area(dest_ptr, 0, 0, src_ptr, 0, 0, 1, 1);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff102030, *bs_gfxbuf_pixel_at(dest_ptr, 0, 0));
+
+    bs_gfxbuf_destroy(dest_ptr);
+    bs_gfxbuf_destroy(src_ptr);
+
+    _test_blend_with(test_ptr, _bs_gfxbuf_blend_dispatch());
+#if defined(BS_GFXBUF_X86)
+    if (__builtin_cpu_supports("sse4.1")) {
+        _test_blend_with(test_ptr, _bs_gfxbuf_blend_sse4);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        _test_blend_with(test_ptr, _bs_gfxbuf_blend_avx2);
+    }
+#elif defined(BS_GFXBUF_NEON)
+    _test_blend_with(test_ptr, _bs_gfxbuf_blend_neon);
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Verifies that `kernels_ptr` scales arbitrary pixels just as the scalar
+ * kernels do, for the fast paths and for fractional scales. The source is
+ * 36x20, the destination is clipped for the largest size.
+ */
+static void _test_copy_scaled_with(
+    bs_test_t *test_ptr,
+    const bs_gfxbuf_scale_kernels_t *kernels_ptr)
+{
+    static const unsigned sizes[][2] = {
+        { 18, 10 }, { 13, 9 }, { 72, 40 }, { 4, 29 }
+    };
+    static const bs_gfxbuf_filter_t filters[] = {
+        BS_GFXBUF_FILTER_NEAREST, BS_GFXBUF_FILTER_BILINEAR
+    };
+    bs_gfxbuf_t *src_ptr = bs_gfxbuf_create(37, 23);
+    bs_gfxbuf_t *exp_ptr = bs_gfxbuf_create(40, 30);
+    bs_gfxbuf_t *dest_ptr = bs_gfxbuf_create(40, 30);
+    if (NULL == src_ptr || NULL == exp_ptr || NULL == dest_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create");
+        goto cleanup;
+    }
+    for (unsigned y = 0; y < 23; ++y) {
+        for (unsigned x = 0; x < 37; ++x) {
+            bs_gfxbuf_set_pixel(src_ptr, x, y,
+                                (x * 0x9e3779b9) ^ (y * 0x85ebca6b));
+        }
+    }
+
+    for (unsigned f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f) {
+        for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+            bs_gfxbuf_clear(exp_ptr, 0);
+            bs_gfxbuf_clear(dest_ptr, 0);
+            _bs_gfxbuf_copy_scaled_with(
+                exp_ptr, 2, 1, sizes[i][0], sizes[i][1],
+                src_ptr, 1, 2, 36, 20, filters[f], &_bs_gfxbuf_scale_scalar);
+            _bs_gfxbuf_copy_scaled_with(
+                dest_ptr, 2, 1, sizes[i][0], sizes[i][1],
+                src_ptr, 1, 2, 36, 20, filters[f], kernels_ptr);
+            BS_TEST_VERIFY_MEMEQ(test_ptr, exp_ptr->data_ptr,
+                                 dest_ptr->data_ptr,
+                                 40 * 30 * sizeof(uint32_t));
+        }
+    }
+
+cleanup:
+    if (NULL != dest_ptr) bs_gfxbuf_destroy(dest_ptr);
+    if (NULL != exp_ptr) bs_gfxbuf_destroy(exp_ptr);
+    if (NULL != src_ptr) bs_gfxbuf_destroy(src_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void test_copy_scaled(bs_test_t *test_ptr)
+{
+    bs_gfxbuf_t *src_ptr = bs_gfxbuf_create(2, 2);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, src_ptr);
+    bs_gfxbuf_t *dest_ptr = bs_gfxbuf_create(5, 5);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, dest_ptr);
+    bs_gfxbuf_set_pixel(src_ptr, 0, 0, 0x40000000);
+    bs_gfxbuf_set_pixel(src_ptr, 1, 0, 0x80000000);
+    bs_gfxbuf_set_pixel(src_ptr, 0, 1, 0x00400000);
+    bs_gfxbuf_set_pixel(src_ptr, 1, 1, 0x00800000);
+
+    // Nearest, doubled: Each pixel becomes 2x2. Truncated to the buffer.
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_gfxbuf_copy_scaled(
+                            dest_ptr, 1, 2, 4, 4, src_ptr, 0, 0, 2, 2,
+                            BS_GFXBUF_FILTER_NEAREST));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(dest_ptr, 0, 2));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(dest_ptr, 1, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x40000000,
+                      *bs_gfxbuf_pixel_at(dest_ptr, 1, 2));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x40000000,
+                      *bs_gfxbuf_pixel_at(dest_ptr, 2, 3));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x80000000,
+                      *bs_gfxbuf_pixel_at(dest_ptr, 3, 2));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x00800000,
+                      *bs_gfxbuf_pixel_at(dest_ptr, 4, 4));
+
+    // Bilinear, halved: Averages all four.
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_gfxbuf_copy_scaled(
+                            dest_ptr, 0, 0, 1, 1, src_ptr, 0, 0, 2, 2,
+                            BS_GFXBUF_FILTER_BILINEAR));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x30300000,
+                      *bs_gfxbuf_pixel_at(dest_ptr, 0, 0));
+
+    // Bilinear, 2x2 to 4x1: Columns at 1/4 and 3/4 between the pixels.
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_gfxbuf_copy_scaled(
+                            dest_ptr, 0, 0, 4, 1, src_ptr, 0, 0, 2, 2,
+                            BS_GFXBUF_FILTER_BILINEAR));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x20200000,
+                      *bs_gfxbuf_pixel_at(dest_ptr, 0, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x28280000,
+                      *bs_gfxbuf_pixel_at(dest_ptr, 1, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x38380000,
+                      *bs_gfxbuf_pixel_at(dest_ptr, 2, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x40400000,
+                      *bs_gfxbuf_pixel_at(dest_ptr, 3, 0));
+
+    // Outside the source: Nothing to do.
+    bs_gfxbuf_clear(dest_ptr, 0);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_gfxbuf_copy_scaled(
+                            dest_ptr, 0, 0, 4, 4, src_ptr, 2, 0, 2, 2,
+                            BS_GFXBUF_FILTER_NEAREST));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(dest_ptr, 0, 0));
+    bs_gfxbuf_destroy(dest_ptr);
+    bs_gfxbuf_destroy(src_ptr);
+
+    _test_copy_scaled_with(test_ptr, _bs_gfxbuf_scale_dispatch());
+#if defined(BS_GFXBUF_X86)
+    if (__builtin_cpu_supports("sse2")) {
+        _test_copy_scaled_with(test_ptr, &_bs_gfxbuf_scale_sse2);
+    }
+#elif defined(BS_GFXBUF_NEON)
+    _test_copy_scaled_with(test_ptr, &_bs_gfxbuf_scale_neon);
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the banded operations match their single-threaded sibling. */
+void test_parallel(bs_test_t *test_ptr)
+{
+    bs_gfxbuf_workers_t *workers_ptr = bs_gfxbuf_workers_create(3);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, workers_ptr);
+    workers_ptr->min_pixels = 0;
+
+    // Padded buffers, with heights not divisible by the number of bands.
+    uint32_t src[40 * 101], dest[40 * 101], expected[40 * 101];
+    bs_gfxbuf_t *src_ptr = bs_gfxbuf_create_unmanaged(37, 101, 40, src);
+    bs_gfxbuf_t *dest_ptr = bs_gfxbuf_create_unmanaged(37, 101, 40, dest);
+    bs_gfxbuf_t *exp_ptr = bs_gfxbuf_create_unmanaged(37, 101, 40, expected);
+    for (unsigned i = 0; i < 40 * 101; ++i) src[i] = i * 2654435761u;
+    memset(dest, 0, sizeof(dest));
+    memset(expected, 0, sizeof(expected));
+
+    bs_gfxbuf_clear(exp_ptr, 0x11223344);
+    bs_gfxbuf_clear_parallel(workers_ptr, dest_ptr, 0x11223344);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected, dest, sizeof(dest));
+
+    bs_gfxbuf_copy(exp_ptr, src_ptr);
+    bs_gfxbuf_copy_parallel(workers_ptr, dest_ptr, src_ptr);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected, dest, sizeof(dest));
+
+    bs_gfxbuf_clear(exp_ptr, 0);
+    bs_gfxbuf_clear(dest_ptr, 0);
+    bs_gfxbuf_copy_area(exp_ptr, 3, 5, src_ptr, 7, 2, 100, 80);
+    bs_gfxbuf_copy_area_parallel(workers_ptr, dest_ptr, 3, 5,
+                                 src_ptr, 7, 2, 100, 80);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected, dest, sizeof(dest));
+
+    // Without pool, or below threshold: Runs on the calling thread.
+    bs_gfxbuf_clear(exp_ptr, 0x55667788);
+    bs_gfxbuf_clear_parallel(NULL, dest_ptr, 0x55667788);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected, dest, sizeof(dest));
+    workers_ptr->min_pixels = BS_GFXBUF_PARALLEL_MIN_PIXELS;
+    bs_gfxbuf_copy_parallel(workers_ptr, dest_ptr, src_ptr);
+    bs_gfxbuf_copy(exp_ptr, src_ptr);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected, dest, sizeof(dest));
+
+    bs_gfxbuf_destroy(exp_ptr);
+    bs_gfxbuf_destroy(dest_ptr);
+    bs_gfxbuf_destroy(src_ptr);
+    bs_gfxbuf_workers_destroy(workers_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies damage tracking and coalescing into rectangles. */
+void test_damage(bs_test_t *test_ptr)
+{
+    bs_gfxbuf_rect_t r;
+    unsigned y = 0;
+
+    bs_gfxbuf_t *buf_ptr = bs_gfxbuf_create(8, 6);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    bs_gfxbuf_t *src_ptr = bs_gfxbuf_create(8, 6);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, src_ptr);
+
+    // Not enabled: No damage reported.
+    bs_gfxbuf_set_pixel(buf_ptr, 1, 1, 42);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_gfxbuf_damage_next(buf_ptr, &y, &r));
+
+    // Enabled: Everything is damaged.
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, bs_gfxbuf_damage_enable(buf_ptr));
+    y = 0;
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_gfxbuf_damage_next(buf_ptr, &y, &r));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, r.x);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, r.y);
+    BS_TEST_VERIFY_EQ(test_ptr, 8, r.width);
+    BS_TEST_VERIFY_EQ(test_ptr, 6, r.height);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_gfxbuf_damage_next(buf_ptr, &y, &r));
+
+    bs_gfxbuf_damage_reset(buf_ptr);
+    y = 0;
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_gfxbuf_damage_next(buf_ptr, &y, &r));
+
+    // Pixels on the same line extend the span. Lines coalesce if same span.
+    bs_gfxbuf_set_pixel(buf_ptr, 1, 1, 42);
+    bs_gfxbuf_set_pixel(buf_ptr, 3, 1, 42);
+    bs_gfxbuf_damage_add(buf_ptr, 1, 2, 3, 2);
+    bs_gfxbuf_copy_area(buf_ptr, 6, 5, src_ptr, 0, 0, 4, 4);
+    y = 0;
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_gfxbuf_damage_next(buf_ptr, &y, &r));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, r.x);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, r.y);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, r.width);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, r.height);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_gfxbuf_damage_next(buf_ptr, &y, &r));
+    BS_TEST_VERIFY_EQ(test_ptr, 6, r.x);
+    BS_TEST_VERIFY_EQ(test_ptr, 5, r.y);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, r.width);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, r.height);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_gfxbuf_damage_next(buf_ptr, &y, &r));
+
+    // Copies only the damaged areas.
+    bs_gfxbuf_clear(src_ptr, 0x01020304);
+    bs_gfxbuf_copy_damaged(src_ptr, buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 42, *bs_gfxbuf_pixel_at(src_ptr, 1, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(src_ptr, 2, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x01020304,
+                      *bs_gfxbuf_pixel_at(src_ptr, 4, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 0x01020304,
+                      *bs_gfxbuf_pixel_at(src_ptr, 0, 0));
+
+    bs_gfxbuf_damage_reset(buf_ptr);
+    bs_gfxbuf_clear(buf_ptr, 0);
+    y = 0;
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_gfxbuf_damage_next(buf_ptr, &y, &r));
+    BS_TEST_VERIFY_EQ(test_ptr, 8, r.width);
+    BS_TEST_VERIFY_EQ(test_ptr, 6, r.height);
+
+    bs_gfxbuf_destroy(src_ptr);
+    bs_gfxbuf_destroy(buf_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies that cairo_util_argb8888_to_floats behaves properly */
+void test_argb8888_to_floats(bs_test_t *test_ptr) {
+    float r, g, b, alpha;
+    bs_gfxbuf_argb8888_to_floats(0, &r, &g, &b, &alpha);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, r);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, g);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, b);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, alpha);
+
+    bs_gfxbuf_argb8888_to_floats(0xffffffff, &r, &g, &b, &alpha);
+    BS_TEST_VERIFY_EQ(test_ptr, 1.0, r);
+    BS_TEST_VERIFY_EQ(test_ptr, 1.0, g);
+    BS_TEST_VERIFY_EQ(test_ptr, 1.0, b);
+    BS_TEST_VERIFY_EQ(test_ptr, 1.0, alpha);
+
+    // Floating point - we're fine with a near-enough value.
+    bs_gfxbuf_argb8888_to_floats(0xffc08040, &r, &g, &b, NULL);
+    BS_TEST_VERIFY_TRUE(test_ptr, 1e-3 > fabs(r - 0.7529));
+    BS_TEST_VERIFY_TRUE(test_ptr, 1e-3 > fabs(g - 0.5020));
+    BS_TEST_VERIFY_TRUE(test_ptr, 1e-3 > fabs(b - 0.2510));
+}
+
+#ifdef HAVE_CAIRO
+/* ------------------------------------------------------------------------- */
+void test_cairo(bs_test_t *test_ptr)
+{
+    bs_gfxbuf_t *buf = bs_gfxbuf_create(1, 1);
+    cairo_t *cairo_ptr = cairo_create_from_bs_gfxbuf(buf);
+
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, cairo_ptr);
+    // Color is 0 after initialization.
     BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf, 0, 0));
 
     cairo_set_source_rgba(cairo_ptr, 1.0, 1.0, 1.0, 1.0);
@@ -437,7 +2555,31 @@ void test_equals_png(bs_test_t *test_ptr)
 
 static void benchmark_clear(bs_test_t *test_ptr);
 static void benchmark_clear_nonblack(bs_test_t *test_ptr);
+static void benchmark_clear_nonblack_scalar(bs_test_t *test_ptr);
+#if defined(BS_GFXBUF_X86)
+static void benchmark_clear_nonblack_sse2(bs_test_t *test_ptr);
+static void benchmark_clear_nonblack_avx2(bs_test_t *test_ptr);
+#elif defined(BS_GFXBUF_NEON)
+static void benchmark_clear_nonblack_neon(bs_test_t *test_ptr);
+#endif
 static void benchmark_copy(bs_test_t *test_ptr);
+static void benchmark_blend(bs_test_t *test_ptr);
+static void benchmark_blend_scalar(bs_test_t *test_ptr);
+#ifdef HAVE_CAIRO
+static void benchmark_blend_cairo(bs_test_t *test_ptr);
+#endif  // HAVE_CAIRO
+static void benchmark_scale_nearest_2x(bs_test_t *test_ptr);
+static void benchmark_scale_nearest_2x_scalar(bs_test_t *test_ptr);
+static void benchmark_scale_bilinear_half(bs_test_t *test_ptr);
+static void benchmark_scale_bilinear_half_scalar(bs_test_t *test_ptr);
+static void benchmark_scale_bilinear_1_5x(bs_test_t *test_ptr);
+static void benchmark_scale_bilinear_1_5x_scalar(bs_test_t *test_ptr);
+#ifdef HAVE_CAIRO
+static void benchmark_scale_bilinear_1_5x_cairo(bs_test_t *test_ptr);
+#endif  // HAVE_CAIRO
+static void benchmark_parallel_1080p(bs_test_t *test_ptr);
+static void benchmark_parallel_4k(bs_test_t *test_ptr);
+static void benchmark_parallel_8k(bs_test_t *test_ptr);
 
 /* set benchmarks to last for 2.5s each */
 static const uint64_t benchmark_duration = 2500000;
@@ -445,7 +2587,41 @@ static const uint64_t benchmark_duration = 2500000;
 const bs_test_case_t          bs_gfxbuf_benchmarks[] = {
     { 1, "benchmark-gfxbuf_clear-black", benchmark_clear },
     { 1, "benchmark-gfxbuf_clear-nonblack", benchmark_clear_nonblack },
+    { 1, "benchmark-gfxbuf_clear-nonblack-scalar",
+      benchmark_clear_nonblack_scalar },
+#if defined(BS_GFXBUF_X86)
+    { 1, "benchmark-gfxbuf_clear-nonblack-sse2",
+      benchmark_clear_nonblack_sse2 },
+    { 1, "benchmark-gfxbuf_clear-nonblack-avx2",
+      benchmark_clear_nonblack_avx2 },
+#elif defined(BS_GFXBUF_NEON)
+    { 1, "benchmark-gfxbuf_clear-nonblack-neon",
+      benchmark_clear_nonblack_neon },
+#endif
     { 1, "benchmark-gfxbuf_copy", benchmark_copy },
+    { 1, "benchmark-gfxbuf_blend", benchmark_blend },
+    { 1, "benchmark-gfxbuf_blend-scalar", benchmark_blend_scalar },
+#ifdef HAVE_CAIRO
+    { 1, "benchmark-gfxbuf_blend-cairo", benchmark_blend_cairo },
+#endif  // HAVE_CAIRO
+    { 1, "benchmark-gfxbuf_scale-nearest-2x", benchmark_scale_nearest_2x },
+    { 1, "benchmark-gfxbuf_scale-nearest-2x-scalar",
+      benchmark_scale_nearest_2x_scalar },
+    { 1, "benchmark-gfxbuf_scale-bilinear-0.5x",
+      benchmark_scale_bilinear_half },
+    { 1, "benchmark-gfxbuf_scale-bilinear-0.5x-scalar",
+      benchmark_scale_bilinear_half_scalar },
+    { 1, "benchmark-gfxbuf_scale-bilinear-1.5x",
+      benchmark_scale_bilinear_1_5x },
+    { 1, "benchmark-gfxbuf_scale-bilinear-1.5x-scalar",
+      benchmark_scale_bilinear_1_5x_scalar },
+#ifdef HAVE_CAIRO
+    { 1, "benchmark-gfxbuf_scale-bilinear-1.5x-cairo",
+      benchmark_scale_bilinear_1_5x_cairo },
+#endif  // HAVE_CAIRO
+    { 1, "benchmark-gfxbuf_parallel-1080p", benchmark_parallel_1080p },
+    { 1, "benchmark-gfxbuf_parallel-4k", benchmark_parallel_4k },
+    { 1, "benchmark-gfxbuf_parallel-8k", benchmark_parallel_8k },
     { 0, NULL, NULL }
 };
 
@@ -458,13 +2634,13 @@ static void benchmark_clear(bs_test_t *test_ptr)
         return;
     }
 
-    uint64_t usec = bs_usec();
+    uint64_t usec = bs_fast_usec();
     unsigned iterations = 0;
-    while (usec + benchmark_duration >= bs_usec()) {
+    while (usec + benchmark_duration >= bs_fast_usec()) {
         bs_gfxbuf_clear(buf_ptr, 0);
         iterations++;
     }
-    usec = bs_usec() - usec;
+    usec = bs_fast_usec() - usec;
 
     bs_test_succeed(test_ptr, "bs_gfxbuf_clear: %.3e pix/sec - %"PRIu64"us",
                     (double)iterations * 1024 * 768 / (usec * 1e-6), usec);
@@ -472,54 +2648,434 @@ static void benchmark_clear(bs_test_t *test_ptr)
 }
 
 /* ------------------------------------------------------------------------- */
-static void benchmark_clear_nonblack(bs_test_t *test_ptr)
+/** Argument to @ref _benchmark_clear_nonblack_fn. */
+struct _benchmark_clear_arg {
+    /** The buffer to clear. */
+    bs_gfxbuf_t               *buf_ptr;
+    /** The fill kernel to use. */
+    bs_gfxbuf_fill_t          fill;
+};
+
+/** Clears to a non-zero color, `iterations` times. For bs_test_bench. */
+static void _benchmark_clear_nonblack_fn(void *arg_ptr, uint64_t iterations)
 {
-    bs_gfxbuf_t *buf_ptr = bs_gfxbuf_create(1024, 768);
-    if (NULL == buf_ptr) {
+    struct _benchmark_clear_arg *clear_arg_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        _bs_gfxbuf_clear_with(
+            clear_arg_ptr->buf_ptr, 0x204080ff, clear_arg_ptr->fill);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks clearing to a non-zero color, using the `fill` kernel. */
+static void _benchmark_clear_nonblack_with(bs_test_t *test_ptr,
+                                           const char *name_ptr,
+                                           bs_gfxbuf_fill_t fill)
+{
+    struct _benchmark_clear_arg clear_arg = {
+        .buf_ptr = bs_gfxbuf_create(1024, 768), .fill = fill };
+    if (NULL == clear_arg.buf_ptr) {
         BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(1024, 768)");
         return;
     }
 
-    uint64_t usec = bs_usec();
-    unsigned iterations = 0;
-    while (usec + benchmark_duration >= bs_usec()) {
-        bs_gfxbuf_clear(buf_ptr, 0x204080ff);
-        iterations++;
+    if (!bs_test_bench(test_ptr, name_ptr, _benchmark_clear_nonblack_fn,
+                       &clear_arg, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(%s)", name_ptr);
     }
-    usec = bs_usec() - usec;
+    bs_gfxbuf_destroy(clear_arg.buf_ptr);
+}
 
-    bs_test_succeed(test_ptr, "bs_gfxbuf_clear: %.3e pix/sec - %"PRIu64"us",
-                    (double)iterations * 1024 * 768 / (usec * 1e-6), usec);
-    bs_gfxbuf_destroy(buf_ptr);
+/* ------------------------------------------------------------------------- */
+static void benchmark_clear_nonblack(bs_test_t *test_ptr)
+{
+    _benchmark_clear_nonblack_with(
+        test_ptr, "dispatched", _bs_gfxbuf_fill_dispatch());
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_clear_nonblack_scalar(bs_test_t *test_ptr)
+{
+    _benchmark_clear_nonblack_with(test_ptr, "scalar", _bs_gfxbuf_fill_scalar);
+}
+
+#if defined(BS_GFXBUF_X86)
+/* ------------------------------------------------------------------------- */
+static void benchmark_clear_nonblack_sse2(bs_test_t *test_ptr)
+{
+    if (!__builtin_cpu_supports("sse2")) {
+        bs_test_succeed(test_ptr, "SSE2 not supported by CPU, skipped.");
+        return;
+    }
+    _benchmark_clear_nonblack_with(test_ptr, "sse2", _bs_gfxbuf_fill_sse2);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_clear_nonblack_avx2(bs_test_t *test_ptr)
+{
+    if (!__builtin_cpu_supports("avx2")) {
+        bs_test_succeed(test_ptr, "AVX2 not supported by CPU, skipped.");
+        return;
+    }
+    _benchmark_clear_nonblack_with(test_ptr, "avx2", _bs_gfxbuf_fill_avx2);
+}
+
+#elif defined(BS_GFXBUF_NEON)
+/* ------------------------------------------------------------------------- */
+static void benchmark_clear_nonblack_neon(bs_test_t *test_ptr)
+{
+    _benchmark_clear_nonblack_with(test_ptr, "neon", _bs_gfxbuf_fill_neon);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/** Copies `arg_ptr[1]` into `arg_ptr[0]`, `iterations` times. */
+static void _benchmark_copy_fn(void *arg_ptr, uint64_t iterations)
+{
+    bs_gfxbuf_t **bufs_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_gfxbuf_copy(bufs_ptr[0], bufs_ptr[1]);
+        BS_TEST_CLOBBER_MEMORY();
+    }
 }
 
 /* ------------------------------------------------------------------------- */
 static void benchmark_copy(bs_test_t *test_ptr)
 {
-    bs_gfxbuf_t *buf_1_ptr = bs_gfxbuf_create(1024, 768);
-    if (NULL == buf_1_ptr) {
+    bs_gfxbuf_t *bufs_ptr[2];
+    bufs_ptr[1] = bs_gfxbuf_create(1024, 768);
+    if (NULL == bufs_ptr[1]) {
         BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(1024, 768)");
         return;
     }
-    bs_gfxbuf_t *buf_2_ptr = bs_gfxbuf_create(1024, 768);
-    if (NULL == buf_2_ptr) {
+    bufs_ptr[0] = bs_gfxbuf_create(1024, 768);
+    if (NULL == bufs_ptr[0]) {
         BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(1024, 768)");
-        bs_gfxbuf_destroy(buf_1_ptr);
+        bs_gfxbuf_destroy(bufs_ptr[1]);
         return;
     }
 
-    uint64_t usec = bs_usec();
+    if (!bs_test_bench(test_ptr, "bs_gfxbuf_copy", _benchmark_copy_fn,
+                       bufs_ptr, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(bs_gfxbuf_copy)");
+    }
+    bs_gfxbuf_destroy(bufs_ptr[0]);
+    bs_gfxbuf_destroy(bufs_ptr[1]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Creates the destination and a half-translucent source for blending. */
+static bool _benchmark_blend_create(bs_test_t *test_ptr,
+                                    bs_gfxbuf_t **dest_gfxbuf_ptr_ptr,
+                                    bs_gfxbuf_t **src_gfxbuf_ptr_ptr)
+{
+    *dest_gfxbuf_ptr_ptr = bs_gfxbuf_create(1024, 768);
+    if (NULL == *dest_gfxbuf_ptr_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(1024, 768)");
+        return false;
+    }
+    *src_gfxbuf_ptr_ptr = bs_gfxbuf_create(1024, 768);
+    if (NULL == *src_gfxbuf_ptr_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(1024, 768)");
+        bs_gfxbuf_destroy(*dest_gfxbuf_ptr_ptr);
+        return false;
+    }
+    bs_gfxbuf_clear(*dest_gfxbuf_ptr_ptr, 0xff204080);
+    bs_gfxbuf_clear(*src_gfxbuf_ptr_ptr, 0x80402010);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks @ref bs_gfxbuf_blend_area, using the `blend` kernel. */
+static void _benchmark_blend_with(bs_test_t *test_ptr,
+                                  const char *name_ptr,
+                                  bs_gfxbuf_blend_t blend)
+{
+    bs_gfxbuf_t *dest_ptr, *src_ptr;
+    if (!_benchmark_blend_create(test_ptr, &dest_ptr, &src_ptr)) return;
+
+    uint64_t usec = bs_fast_usec();
     unsigned iterations = 0;
-    while (usec + benchmark_duration >= bs_usec()) {
-        bs_gfxbuf_copy(buf_2_ptr, buf_1_ptr);
+    while (usec + benchmark_duration >= bs_fast_usec()) {
+        _bs_gfxbuf_blend_area_with(dest_ptr, 0, 0, src_ptr, 0, 0,
+                                   1024, 768, blend);
         iterations++;
     }
-    usec = bs_usec() - usec;
+    usec = bs_fast_usec() - usec;
 
-    bs_test_succeed(test_ptr, "bs_gfxbuf_copy: %.3e pix/sec",
+    bs_test_succeed(test_ptr, "bs_gfxbuf_blend_area (%s): %.3e pix/sec",
+                    name_ptr,
                     (double)iterations * 1024 * 768 / (usec * 1e-6));
-    bs_gfxbuf_destroy(buf_1_ptr);
+    bs_gfxbuf_destroy(src_ptr);
+    bs_gfxbuf_destroy(dest_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_blend(bs_test_t *test_ptr)
+{
+    _benchmark_blend_with(test_ptr, "dispatched", _bs_gfxbuf_blend_dispatch());
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_blend_scalar(bs_test_t *test_ptr)
+{
+    _benchmark_blend_with(test_ptr, "scalar", _bs_gfxbuf_blend_scalar);
+}
+
+#ifdef HAVE_CAIRO
+/* ------------------------------------------------------------------------- */
+/** Benchmarks the same blend, through Cairo's CAIRO_OPERATOR_OVER. */
+static void benchmark_blend_cairo(bs_test_t *test_ptr)
+{
+    bs_gfxbuf_t *dest_ptr, *src_ptr;
+    if (!_benchmark_blend_create(test_ptr, &dest_ptr, &src_ptr)) return;
+
+    cairo_surface_t *src_surface_ptr = cairo_image_surface_create_for_data(
+        (unsigned char*)src_ptr->data_ptr, bs_gfx_cairo_image_format,
+        src_ptr->width, src_ptr->height,
+        src_ptr->pixels_per_line * sizeof(uint32_t));
+    cairo_t *cairo_ptr = cairo_create_from_bs_gfxbuf(dest_ptr);
+    if (NULL == cairo_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed cairo_create_from_bs_gfxbuf(%p)",
+                     dest_ptr);
+    } else {
+        cairo_set_operator(cairo_ptr, CAIRO_OPERATOR_OVER);
+        cairo_set_source_surface(cairo_ptr, src_surface_ptr, 0, 0);
+
+        uint64_t usec = bs_fast_usec();
+        unsigned iterations = 0;
+        while (usec + benchmark_duration >= bs_fast_usec()) {
+            cairo_paint(cairo_ptr);
+            cairo_surface_flush(cairo_get_target(cairo_ptr));
+            iterations++;
+        }
+        usec = bs_fast_usec() - usec;
+
+        bs_test_succeed(test_ptr, "cairo_paint (OVER): %.3e pix/sec",
+                        (double)iterations * 1024 * 768 / (usec * 1e-6));
+        cairo_destroy(cairo_ptr);
+    }
+    cairo_surface_destroy(src_surface_ptr);
+    bs_gfxbuf_destroy(src_ptr);
+    bs_gfxbuf_destroy(dest_ptr);
+}
+#endif  // HAVE_CAIRO
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Benchmarks scaling a 1024x768 area to `dest_width` x `dest_height`, using
+ * `kernels_ptr`. Throughput is given in destination pixels.
+ */
+static void _benchmark_scale_with(bs_test_t *test_ptr,
+                                  const char *name_ptr,
+                                  unsigned dest_width,
+                                  unsigned dest_height,
+                                  bs_gfxbuf_filter_t filter,
+                                  const bs_gfxbuf_scale_kernels_t *kernels_ptr)
+{
+    bs_gfxbuf_t *src_ptr = bs_gfxbuf_create(1024, 768);
+    if (NULL == src_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(1024, 768)");
+        return;
+    }
+    bs_gfxbuf_t *dest_ptr = bs_gfxbuf_create(dest_width, dest_height);
+    if (NULL == dest_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(%u, %u)",
+                     dest_width, dest_height);
+        bs_gfxbuf_destroy(src_ptr);
+        return;
+    }
+    bs_gfxbuf_clear(src_ptr, 0x80402010);
+
+    uint64_t usec = bs_fast_usec();
+    unsigned iterations = 0;
+    while (usec + benchmark_duration >= bs_fast_usec()) {
+        _bs_gfxbuf_copy_scaled_with(dest_ptr, 0, 0, dest_width, dest_height,
+                                    src_ptr, 0, 0, 1024, 768,
+                                    filter, kernels_ptr);
+        iterations++;
+    }
+    usec = bs_fast_usec() - usec;
+
+    bs_test_succeed(test_ptr, "bs_gfxbuf_copy_scaled (%s): %.3e pix/sec",
+                    name_ptr, (double)iterations * dest_width * dest_height /
+                    (usec * 1e-6));
+    bs_gfxbuf_destroy(dest_ptr);
+    bs_gfxbuf_destroy(src_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_scale_nearest_2x(bs_test_t *test_ptr)
+{
+    _benchmark_scale_with(test_ptr, "nearest, 2x, dispatched", 2048, 1536,
+                          BS_GFXBUF_FILTER_NEAREST,
+                          _bs_gfxbuf_scale_dispatch());
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_scale_nearest_2x_scalar(bs_test_t *test_ptr)
+{
+    _benchmark_scale_with(test_ptr, "nearest, 2x, scalar", 2048, 1536,
+                          BS_GFXBUF_FILTER_NEAREST, &_bs_gfxbuf_scale_scalar);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_scale_bilinear_half(bs_test_t *test_ptr)
+{
+    _benchmark_scale_with(test_ptr, "bilinear, 0.5x, dispatched", 512, 384,
+                          BS_GFXBUF_FILTER_BILINEAR,
+                          _bs_gfxbuf_scale_dispatch());
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_scale_bilinear_half_scalar(bs_test_t *test_ptr)
+{
+    _benchmark_scale_with(test_ptr, "bilinear, 0.5x, scalar", 512, 384,
+                          BS_GFXBUF_FILTER_BILINEAR, &_bs_gfxbuf_scale_scalar);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_scale_bilinear_1_5x(bs_test_t *test_ptr)
+{
+    _benchmark_scale_with(test_ptr, "bilinear, 1.5x, dispatched", 1536, 1152,
+                          BS_GFXBUF_FILTER_BILINEAR,
+                          _bs_gfxbuf_scale_dispatch());
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_scale_bilinear_1_5x_scalar(bs_test_t *test_ptr)
+{
+    _benchmark_scale_with(test_ptr, "bilinear, 1.5x, scalar", 1536, 1152,
+                          BS_GFXBUF_FILTER_BILINEAR, &_bs_gfxbuf_scale_scalar);
+}
+
+#ifdef HAVE_CAIRO
+/* ------------------------------------------------------------------------- */
+/** Benchmarks the same scale, through a Cairo pattern with bilinear filter. */
+static void benchmark_scale_bilinear_1_5x_cairo(bs_test_t *test_ptr)
+{
+    bs_gfxbuf_t *src_ptr = bs_gfxbuf_create(1024, 768);
+    if (NULL == src_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(1024, 768)");
+        return;
+    }
+    bs_gfxbuf_t *dest_ptr = bs_gfxbuf_create(1536, 1152);
+    if (NULL == dest_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(1536, 1152)");
+        bs_gfxbuf_destroy(src_ptr);
+        return;
+    }
+    bs_gfxbuf_clear(src_ptr, 0x80402010);
+
+    cairo_surface_t *src_surface_ptr = cairo_image_surface_create_for_data(
+        (unsigned char*)src_ptr->data_ptr, bs_gfx_cairo_image_format,
+        src_ptr->width, src_ptr->height,
+        src_ptr->pixels_per_line * sizeof(uint32_t));
+    cairo_t *cairo_ptr = cairo_create_from_bs_gfxbuf(dest_ptr);
+    if (NULL == cairo_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed cairo_create_from_bs_gfxbuf(%p)",
+                     dest_ptr);
+    } else {
+        cairo_set_operator(cairo_ptr, CAIRO_OPERATOR_SOURCE);
+        cairo_scale(cairo_ptr, 1.5, 1.5);
+        cairo_set_source_surface(cairo_ptr, src_surface_ptr, 0, 0);
+        cairo_pattern_set_filter(cairo_get_source(cairo_ptr),
+                                 CAIRO_FILTER_BILINEAR);
+
+        uint64_t usec = bs_fast_usec();
+        unsigned iterations = 0;
+        while (usec + benchmark_duration >= bs_fast_usec()) {
+            cairo_paint(cairo_ptr);
+            cairo_surface_flush(cairo_get_target(cairo_ptr));
+            iterations++;
+        }
+        usec = bs_fast_usec() - usec;
+
+        bs_test_succeed(test_ptr, "cairo_paint (bilinear, 1.5x): "
+                        "%.3e pix/sec",
+                        (double)iterations * 1536 * 1152 / (usec * 1e-6));
+        cairo_destroy(cairo_ptr);
+    }
+    cairo_surface_destroy(src_surface_ptr);
+    bs_gfxbuf_destroy(dest_ptr);
+    bs_gfxbuf_destroy(src_ptr);
+}
+#endif  // HAVE_CAIRO
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Benchmarks clear and copy of a `width` x `height` buffer, on the calling
+ * thread only, and on a worker pool with a thread per CPU.
+ */
+static void _benchmark_parallel(bs_test_t *test_ptr,
+                                unsigned width,
+                                unsigned height)
+{
+    bs_gfxbuf_t *buf_1_ptr = bs_gfxbuf_create(width, height);
+    if (NULL == buf_1_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(%u, %u)",
+                     width, height);
+        return;
+    }
+    bs_gfxbuf_t *buf_2_ptr = bs_gfxbuf_create(width, height);
+    if (NULL == buf_2_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(%u, %u)",
+                     width, height);
+        bs_gfxbuf_destroy(buf_1_ptr);
+        return;
+    }
+    bs_gfxbuf_workers_t *workers_ptr = bs_gfxbuf_workers_create(0);
+    if (NULL == workers_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_workers_create(0)");
+        bs_gfxbuf_destroy(buf_2_ptr);
+        bs_gfxbuf_destroy(buf_1_ptr);
+        return;
+    }
+
+    double rates[4];
+    for (int i = 0; i < 4; ++i) {
+        // Even: Single-threaded. Odd: With workers. 0, 1: clear; 2, 3: copy.
+        bs_gfxbuf_workers_t *w_ptr = (i & 1) ? workers_ptr : NULL;
+        uint64_t usec = bs_fast_usec();
+        unsigned iterations = 0;
+        while (usec + benchmark_duration / 4 >= bs_fast_usec()) {
+            if (2 > i) {
+                bs_gfxbuf_clear_parallel(w_ptr, buf_1_ptr, 0x204080ff);
+            } else {
+                bs_gfxbuf_copy_parallel(w_ptr, buf_2_ptr, buf_1_ptr);
+            }
+            iterations++;
+        }
+        usec = bs_fast_usec() - usec;
+        rates[i] = (double)iterations * width * height / (usec * 1e-6);
+    }
+
+    bs_test_succeed(test_ptr, "%ux%u, %u+1 threads: clear %.3e / %.3e pix/sec, "
+                    "copy %.3e / %.3e pix/sec", width, height,
+                    workers_ptr->threads, rates[0], rates[1],
+                    rates[2], rates[3]);
+    bs_gfxbuf_workers_destroy(workers_ptr);
     bs_gfxbuf_destroy(buf_2_ptr);
+    bs_gfxbuf_destroy(buf_1_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_parallel_1080p(bs_test_t *test_ptr)
+{
+    _benchmark_parallel(test_ptr, 1920, 1080);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_parallel_4k(bs_test_t *test_ptr)
+{
+    _benchmark_parallel(test_ptr, 3840, 2160);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_parallel_8k(bs_test_t *test_ptr)
+{
+    _benchmark_parallel(test_ptr, 7680, 4320);
 }
 
 /* == End of gfxbuf.c ====================================================== */
@@ -20,9 +20,12 @@
 #ifndef __LIBBASE_GFXBUF_H__
 #define __LIBBASE_GFXBUF_H__
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "assert.h"
+#include "def.h"
 
 #ifdef HAVE_CAIRO
 #include <cairo.h>
@@ -35,6 +38,26 @@
 extern "C" {
 #endif  // __cplusplus
 
+/** A horizontal span of pixels [x_begin, x_end). Empty if x_begin >= x_end. */
+typedef struct {
+    /** First pixel of the span. */
+    unsigned                  x_begin;
+    /** One past the last pixel of the span. */
+    unsigned                  x_end;
+} bs_gfxbuf_span_t;
+
+/** A rectangle, in pixel coordinates. */
+typedef struct {
+    /** Left coordinate. */
+    unsigned                  x;
+    /** Top coordinate. */
+    unsigned                  y;
+    /** Width, in pixels. */
+    unsigned                  width;
+    /** Height, in pixels. */
+    unsigned                  height;
+} bs_gfxbuf_rect_t;
+
 /** A graphics buffer. */
 typedef struct {
     /** Width, in pixels. */
@@ -45,6 +68,11 @@ typedef struct {
     unsigned                  pixels_per_line;
     /** The pixels buffer. Has `height` * `pixels_per_line` elements. */
     uint32_t                  *data_ptr;
+    /**
+     * Damaged span of each line, has `height` elements. NULL, unless enabled
+     * through @ref bs_gfxbuf_damage_enable.
+     */
+    bs_gfxbuf_span_t          *damage_spans_ptr;
 } bs_gfxbuf_t;
 
 /**
@@ -58,6 +86,90 @@ typedef struct {
  */
 bs_gfxbuf_t *bs_gfxbuf_create(unsigned width, unsigned height);
 
+/** Flags for @ref bs_gfxbuf_create_with_flags. */
+typedef enum {
+    /**
+     * Aligns each line to 64 bytes, by padding `pixels_per_line` to a multiple
+     * of 16 pixels. The buffer has the same alignment.
+     */
+    BS_GFXBUF_ALIGNED = 0x01,
+    /**
+     * Backs buffers of at least @ref BS_GFXBUF_HUGEPAGE_SIZE by huge pages:
+     * Uses MAP_HUGETLB, if available, or else hints MADV_HUGEPAGE.
+     */
+    BS_GFXBUF_HUGEPAGES = 0x02,
+    /**
+     * Recycles the pixel storage: When destroyed, the storage is kept in a
+     * process-wide pool, bucketed by size, and handed out to the next pooled
+     * buffer of the same size bucket. Contents of a recycled buffer are left
+     * as-is, ie. are undefined: Use @ref bs_gfxbuf_clear as needed.
+     */
+    BS_GFXBUF_POOLED = 0x04
+} bs_gfxbuf_flags_t;
+
+/** Minimum buffer size for @ref BS_GFXBUF_HUGEPAGES to take effect. */
+#define BS_GFXBUF_HUGEPAGE_SIZE   (2 * 1024 * 1024)
+
+/**
+ * Creates a graphics buffer @ref bs_gfxbuf_t, with allocation options.
+ *
+ * @param width
+ * @param height
+ * @param flags               A combination of @ref bs_gfxbuf_flags_t. With 0,
+ *                            this is the same as @ref bs_gfxbuf_create.
+ *
+ * @return A pointer to @ref bs_gfxbuf_t. Must be free'd by
+ *     @ref bs_gfxbuf_destroy().
+ */
+bs_gfxbuf_t *bs_gfxbuf_create_with_flags(unsigned width,
+                                         unsigned height,
+                                         unsigned flags);
+
+/**
+ * Releases all pixel storage held in the pool of @ref BS_GFXBUF_POOLED.
+ */
+void bs_gfxbuf_pool_flush(void);
+
+/** Describes the shared memory backing a buffer from bs_gfxbuf_create_shm. */
+typedef struct {
+    /** File descriptor of the memfd. Owned by the buffer: Do not close. */
+    int                       fd;
+    /** Offset of the first pixel within the file, in bytes. */
+    size_t                    offset;
+    /** Size of the file, in bytes. */
+    size_t                    size;
+    /** Bytes per line. */
+    unsigned                  stride;
+} bs_gfxbuf_shm_t;
+
+/**
+ * Creates a graphics buffer @ref bs_gfxbuf_t, backed by shared memory.
+ *
+ * The pixels are stored in an anonymous memfd, mapped shared. The file
+ * descriptor can be passed to another process (eg. a display server through
+ * wl_shm), without copying. The memfd is sealed against shrinking and has
+ * close-on-exec set.
+ *
+ * @param width
+ * @param height
+ *
+ * @return A pointer to @ref bs_gfxbuf_t, or NULL on error. Must be free'd by
+ *     @ref bs_gfxbuf_destroy(), which also unmaps and closes the memfd.
+ */
+bs_gfxbuf_t *bs_gfxbuf_create_shm(unsigned width, unsigned height);
+
+/**
+ * Retrieves the shared memory details of the buffer.
+ *
+ * @param gfxbuf_ptr
+ * @param shm_ptr             Output.
+ *
+ * @return true if `gfxbuf_ptr` was created by @ref bs_gfxbuf_create_shm and
+ *     `shm_ptr` was filled. false otherwise.
+ */
+bool bs_gfxbuf_get_shm(const bs_gfxbuf_t *gfxbuf_ptr,
+                       bs_gfxbuf_shm_t *shm_ptr);
+
 /**
  * Creates a graphics buffer @ref bs_gfxbuf_t.
  *
@@ -80,6 +192,72 @@ bs_gfxbuf_t *bs_gfxbuf_create_unmanaged(unsigned width, unsigned height,
  */
 void bs_gfxbuf_destroy(bs_gfxbuf_t *gfxbuf_ptr);
 
+/**
+ * Enables damage tracking for the graphics buffer.
+ *
+ * Once enabled, @ref bs_gfxbuf_set_pixel, @ref bs_gfxbuf_clear,
+ * @ref bs_gfxbuf_copy, @ref bs_gfxbuf_copy_area, @ref bs_gfxbuf_blend_area and
+ * their parallel variants record the pixels they modify. Modifications made
+ * through `data_ptr` or Cairo must be reported by @ref bs_gfxbuf_damage_add.
+ * Enabling marks the whole buffer as damaged. Enabling twice is a no-op.
+ *
+ * @param gfxbuf_ptr
+ *
+ * @return true on success. Failures will be logged.
+ */
+bool bs_gfxbuf_damage_enable(bs_gfxbuf_t *gfxbuf_ptr);
+
+/**
+ * Marks the rectangular area as damaged. Truncated to fit the buffer.
+ *
+ * @param gfxbuf_ptr
+ * @param x
+ * @param y
+ * @param width
+ * @param height
+ */
+void bs_gfxbuf_damage_add(bs_gfxbuf_t *gfxbuf_ptr,
+                          unsigned x,
+                          unsigned y,
+                          unsigned width,
+                          unsigned height);
+
+/**
+ * Iterates over the damaged areas of the buffer, as rectangles.
+ *
+ * Each line's damage is a single span. Consecutive lines with the same span
+ * are coalesced into one rectangle.
+ *
+ * @param gfxbuf_ptr
+ * @param y_ptr               Iteration state. Must be 0 on the first call.
+ * @param rect_ptr            Output: The next damaged rectangle.
+ *
+ * @return true if `rect_ptr` was filled, false if there's no more damage.
+ *     Always false if damage tracking is not enabled.
+ */
+bool bs_gfxbuf_damage_next(const bs_gfxbuf_t *gfxbuf_ptr,
+                           unsigned *y_ptr,
+                           bs_gfxbuf_rect_t *rect_ptr);
+
+/**
+ * Clears all damage information, eg. after the buffer was presented.
+ *
+ * @param gfxbuf_ptr
+ */
+void bs_gfxbuf_damage_reset(bs_gfxbuf_t *gfxbuf_ptr);
+
+/**
+ * Copies only the damaged areas of `src_gfxbuf_ptr` to `dest_gfxbuf_ptr`.
+ *
+ * Expects width and height of `src_gfxbuf_ptr` and `dest_gfxbuf_ptr` the same.
+ * Does not reset the damage of `src_gfxbuf_ptr`.
+ *
+ * @param dest_gfxbuf_ptr
+ * @param src_gfxbuf_ptr
+ */
+void bs_gfxbuf_copy_damaged(bs_gfxbuf_t *dest_gfxbuf_ptr,
+                            const bs_gfxbuf_t *src_gfxbuf_ptr);
+
 /**
  * Clears the graphics buffer with the specified `color`.
  *
@@ -124,6 +302,159 @@ void bs_gfxbuf_copy_area(
     unsigned width,
     unsigned height);
 
+/**
+ * Blends a rectangular area of `src_gfxbuf_ptr` onto `dest_gfxbuf_ptr`.
+ *
+ * Uses the "source over" operator, with both buffers holding premultiplied
+ * ARGB 8888 pixels (as Cairo's CAIRO_FORMAT_ARGB32 does). The rectangular area
+ * is truncated the same way as in @ref bs_gfxbuf_copy_area.
+ *
+ * @param dest_gfxbuf_ptr     Destination graphics buffer.
+ * @param dest_x              Destination coordinate.
+ * @param dest_y              Destination coordinate.
+ * @param src_gfxbuf_ptr      Source graphics buffer.
+ * @param src_x               Source coordinate.
+ * @param src_y               Source coordinate.
+ * @param width               Width of the rectangle to blend.
+ * @param height              Height of the rectangle to blend.
+ */
+void bs_gfxbuf_blend_area(
+    bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned width,
+    unsigned height);
+
+/** Filter for @ref bs_gfxbuf_copy_scaled. */
+typedef enum {
+    /** Picks the source pixel nearest to the destination pixel's center. */
+    BS_GFXBUF_FILTER_NEAREST,
+    /** Interpolates linearly between the 4 nearest source pixels. */
+    BS_GFXBUF_FILTER_BILINEAR
+} bs_gfxbuf_filter_t;
+
+/**
+ * Copies a rectangular area of `src_gfxbuf_ptr`, scaled to the rectangular
+ * area of `dest_gfxbuf_ptr`.
+ *
+ * The source rectangle is truncated to fit the source buffer. The scale is
+ * then given by the source and destination rectangles: Parts of the
+ * destination rectangle outside the destination buffer are not drawn.
+ *
+ * Pixel centers are mapped onto each other, so scaling by 2 with
+ * @ref BS_GFXBUF_FILTER_NEAREST duplicates pixels, and scaling by 0.5 with
+ * @ref BS_GFXBUF_FILTER_BILINEAR averages 2x2 pixels. Both are fast paths.
+ * Bilinear filtering should be used on premultiplied pixels.
+ *
+ * @param dest_gfxbuf_ptr     Destination graphics buffer.
+ * @param dest_x              Destination coordinate.
+ * @param dest_y              Destination coordinate.
+ * @param dest_width          Width of the destination rectangle.
+ * @param dest_height         Height of the destination rectangle.
+ * @param src_gfxbuf_ptr      Source graphics buffer.
+ * @param src_x               Source coordinate.
+ * @param src_y               Source coordinate.
+ * @param src_width           Width of the source rectangle.
+ * @param src_height          Height of the source rectangle.
+ * @param filter
+ *
+ * @return true on success. Failures will be logged.
+ */
+bool bs_gfxbuf_copy_scaled(
+    bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    unsigned dest_width,
+    unsigned dest_height,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned src_width,
+    unsigned src_height,
+    bs_gfxbuf_filter_t filter);
+
+/**
+ * A pool of worker threads, for processing large buffers in horizontal bands.
+ *
+ * Runs the bands on a @ref bs_thread_pool_t. Concurrent calls to the
+ * `_parallel` methods on the same pool get serialized.
+ */
+typedef struct _bs_gfxbuf_workers_t bs_gfxbuf_workers_t;
+
+/**
+ * Buffers (or areas) with fewer pixels than this are processed on the calling
+ * thread only: Below, the cost of dispatching outweighs the gain.
+ */
+#define BS_GFXBUF_PARALLEL_MIN_PIXELS (1024 * 1024)
+
+/**
+ * Creates a pool of worker threads for the `_parallel` methods.
+ *
+ * @param threads             Number of worker threads to start. The calling
+ *                            thread participates in the work, too. If 0, one
+ *                            less than the number of online CPUs is used.
+ *
+ * @return A pointer to the pool, or NULL on error. Must be destroyed by
+ *     @ref bs_gfxbuf_workers_destroy.
+ */
+bs_gfxbuf_workers_t *bs_gfxbuf_workers_create(unsigned threads);
+
+/**
+ * Stops all worker threads and destroys the pool.
+ *
+ * @param workers_ptr
+ */
+void bs_gfxbuf_workers_destroy(bs_gfxbuf_workers_t *workers_ptr);
+
+/**
+ * Same as @ref bs_gfxbuf_clear, but split into bands run on `workers_ptr`.
+ *
+ * @param workers_ptr         Worker pool. May be NULL, to run single-threaded.
+ * @param gfxbuf_ptr
+ * @param color
+ */
+void bs_gfxbuf_clear_parallel(bs_gfxbuf_workers_t *workers_ptr,
+                              bs_gfxbuf_t *gfxbuf_ptr,
+                              const uint32_t color);
+
+/**
+ * Same as @ref bs_gfxbuf_copy, but split into bands run on `workers_ptr`.
+ *
+ * @param workers_ptr         Worker pool. May be NULL, to run single-threaded.
+ * @param dest_gfxbuf_ptr
+ * @param src_gfxbuf_ptr
+ */
+void bs_gfxbuf_copy_parallel(bs_gfxbuf_workers_t *workers_ptr,
+                             bs_gfxbuf_t *dest_gfxbuf_ptr,
+                             const bs_gfxbuf_t *src_gfxbuf_ptr);
+
+/**
+ * Same as @ref bs_gfxbuf_copy_area, but split into bands run on `workers_ptr`.
+ *
+ * @param workers_ptr         Worker pool. May be NULL, to run single-threaded.
+ * @param dest_gfxbuf_ptr
+ * @param dest_x
+ * @param dest_y
+ * @param src_gfxbuf_ptr
+ * @param src_x
+ * @param src_y
+ * @param width
+ * @param height
+ */
+void bs_gfxbuf_copy_area_parallel(
+    bs_gfxbuf_workers_t *workers_ptr,
+    bs_gfxbuf_t *dest_gfxbuf_ptr,
+    unsigned dest_x,
+    unsigned dest_y,
+    const bs_gfxbuf_t *src_gfxbuf_ptr,
+    unsigned src_x,
+    unsigned src_y,
+    unsigned width,
+    unsigned height);
+
 /**
  * Returns a pointer to the pixel at the given coordinates.
  *
@@ -142,6 +473,26 @@ static inline uint32_t *bs_gfxbuf_pixel_at(
     return &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line + x];
 }
 
+/**
+ * Extends the span to also cover [x_begin, x_end).
+ *
+ * @param span_ptr
+ * @param x_begin
+ * @param x_end
+ */
+static inline void bs_gfxbuf_span_add(
+    bs_gfxbuf_span_t *span_ptr,
+    unsigned x_begin,
+    unsigned x_end) {
+    if (span_ptr->x_begin >= span_ptr->x_end) {
+        span_ptr->x_begin = x_begin;
+        span_ptr->x_end = x_end;
+    } else {
+        span_ptr->x_begin = BS_MIN(span_ptr->x_begin, x_begin);
+        span_ptr->x_end = BS_MAX(span_ptr->x_end, x_end);
+    }
+}
+
 /**
  * Colors the pixel at the given coordinates.
  *
@@ -156,6 +507,9 @@ static inline void bs_gfxbuf_set_pixel(
     unsigned y,
     uint32_t color) {
     *bs_gfxbuf_pixel_at(gfxbuf_ptr, x, y) = color;
+    if (NULL != gfxbuf_ptr->damage_spans_ptr) {
+        bs_gfxbuf_span_add(&gfxbuf_ptr->damage_spans_ptr[y], x, x + 1);
+    }
 }
 
 /**
@@ -0,0 +1,768 @@
+/* ========================================================================= */
+/**
+ * @file gfxbuf_convert.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gfxbuf_convert.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "log_wrappers.h"
+#include "time.h"
+
+// SSE2 is part of the amd64 baseline, and NEON of aarch64. No need to check
+// the CPU at runtime.
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* == Declarations ========================================================= */
+
+static void _bs_gfxbuf_convert_argb8888_to_floats_scalar(
+    const uint32_t *src_ptr, float *dest_ptr, size_t num);
+static void _bs_gfxbuf_convert_floats_to_argb8888_scalar(
+    const float *src_ptr, uint32_t *dest_ptr, size_t num);
+static void _bs_gfxbuf_convert_premultiply_scalar(
+    uint32_t *pixels_ptr, size_t num);
+static void _bs_gfxbuf_convert_swap_rb_scalar(
+    const uint32_t *src_ptr, uint32_t *dest_ptr, size_t num);
+static void _bs_gfxbuf_convert_argb8888_to_rgb565_scalar(
+    const uint32_t *src_ptr, uint16_t *dest_ptr, size_t num);
+static void _bs_gfxbuf_convert_rgb565_to_argb8888_scalar(
+    const uint16_t *src_ptr, uint32_t *dest_ptr, size_t num);
+static void _bs_gfxbuf_convert_init_reciprocals(void);
+
+/** Scale from 8-bit to [0, 1]. */
+static const float            _bs_gfxbuf_convert_scale = 1.0f / 255.0f;
+
+/**
+ * Reciprocals for unpremultiplying: (255 << 16) / alpha, rounded. Initialized
+ * through @ref _bs_gfxbuf_convert_reciprocals_once.
+ */
+static uint32_t               _bs_gfxbuf_convert_reciprocals[256];
+/** Guards initialization of @ref _bs_gfxbuf_convert_reciprocals. */
+static pthread_once_t         _bs_gfxbuf_convert_reciprocals_once =
+    PTHREAD_ONCE_INIT;
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_convert_argb8888_to_floats(const uint32_t *src_ptr,
+                                          float *dest_ptr,
+                                          size_t num)
+{
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(_bs_gfxbuf_convert_scale);
+    for (; num >= 4; num -= 4, src_ptr += 4, dest_ptr += 16) {
+        __m128i p = _mm_loadu_si128((const __m128i*)src_ptr);
+        __m128i p16[2] = {
+            _mm_unpacklo_epi8(p, zero), _mm_unpackhi_epi8(p, zero) };
+        for (int i = 0; i < 2; ++i) {
+            // Lanes are B, G, R, A. Shuffle to R, G, B, A.
+            __m128i p32 = _mm_shuffle_epi32(
+                _mm_unpacklo_epi16(p16[i], zero), _MM_SHUFFLE(3, 0, 1, 2));
+            _mm_storeu_ps(dest_ptr + 8 * i,
+                          _mm_mul_ps(_mm_cvtepi32_ps(p32), scale));
+            p32 = _mm_shuffle_epi32(
+                _mm_unpackhi_epi16(p16[i], zero), _MM_SHUFFLE(3, 0, 1, 2));
+            _mm_storeu_ps(dest_ptr + 8 * i + 4,
+                          _mm_mul_ps(_mm_cvtepi32_ps(p32), scale));
+        }
+    }
+#elif defined(__ARM_NEON)
+    for (; num >= 8; num -= 8, src_ptr += 8, dest_ptr += 32) {
+        // De-interleaved into B, G, R, A.
+        uint8x8x4_t p = vld4_u8((const uint8_t*)src_ptr);
+        uint16x8_t c16[4];
+        for (int c = 0; c < 4; ++c) c16[c] = vmovl_u8(p.val[c]);
+        for (int half = 0; half < 2; ++half) {
+            float32x4x4_t f;
+            for (int c = 0; c < 4; ++c) {
+                uint16x4_t h = half ? vget_high_u16(c16[c]) :
+                    vget_low_u16(c16[c]);
+                // Output order is R, G, B, A.
+                f.val[c == 3 ? 3 : 2 - c] = vmulq_n_f32(
+                    vcvtq_f32_u32(vmovl_u16(h)), _bs_gfxbuf_convert_scale);
+            }
+            vst4q_f32(dest_ptr + 16 * half, f);
+        }
+    }
+#endif
+    _bs_gfxbuf_convert_argb8888_to_floats_scalar(src_ptr, dest_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_convert_floats_to_argb8888(const float *src_ptr,
+                                          uint32_t *dest_ptr,
+                                          size_t num)
+{
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 c255 = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; num >= 4; num -= 4, src_ptr += 16, dest_ptr += 4) {
+        __m128i p32[4];
+        for (int i = 0; i < 4; ++i) {
+            __m128 f = _mm_loadu_ps(src_ptr + 4 * i);
+            f = _mm_min_ps(_mm_max_ps(f, zero), one);
+            // Truncation of (f * 255 + 0.5) rounds, same as scalar.
+            p32[i] = _mm_shuffle_epi32(
+                _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(f, c255), half)),
+                _MM_SHUFFLE(3, 0, 1, 2));
+        }
+        __m128i p = _mm_packus_epi16(_mm_packs_epi32(p32[0], p32[1]),
+                                     _mm_packs_epi32(p32[2], p32[3]));
+        _mm_storeu_si128((__m128i*)dest_ptr, p);
+    }
+#endif
+    _bs_gfxbuf_convert_floats_to_argb8888_scalar(src_ptr, dest_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_convert_premultiply(uint32_t *pixels_ptr, size_t num)
+{
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c128 = _mm_set1_epi16(128);
+    // Colors get multiplied by alpha, and alpha by 255 (ie. unchanged).
+    const __m128i color_mask = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+    const __m128i alpha_255 = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+    for (; num >= 4; num -= 4, pixels_ptr += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)pixels_ptr);
+        __m128i p16[2] = {
+            _mm_unpacklo_epi8(p, zero), _mm_unpackhi_epi8(p, zero) };
+        for (int i = 0; i < 2; ++i) {
+            __m128i a = _mm_shufflehi_epi16(
+                _mm_shufflelo_epi16(p16[i], _MM_SHUFFLE(3, 3, 3, 3)),
+                _MM_SHUFFLE(3, 3, 3, 3));
+            a = _mm_or_si128(_mm_and_si128(a, color_mask), alpha_255);
+            __m128i t = _mm_add_epi16(_mm_mullo_epi16(p16[i], a), c128);
+            p16[i] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        }
+        _mm_storeu_si128((__m128i*)pixels_ptr,
+                         _mm_packus_epi16(p16[0], p16[1]));
+    }
+#elif defined(__ARM_NEON)
+    for (; num >= 8; num -= 8, pixels_ptr += 8) {
+        uint8x8x4_t p = vld4_u8((const uint8_t*)pixels_ptr);
+        for (int c = 0; c < 3; ++c) {
+            // (t + ((t + 128) >> 8) + 128) >> 8, matching the scalar method.
+            uint16x8_t t = vmull_u8(p.val[c], p.val[3]);
+            p.val[c] = vraddhn_u16(t, vrshrq_n_u16(t, 8));
+        }
+        vst4_u8((uint8_t*)pixels_ptr, p);
+    }
+#endif
+    _bs_gfxbuf_convert_premultiply_scalar(pixels_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_convert_unpremultiply(uint32_t *pixels_ptr, size_t num)
+{
+    // Division by alpha is replaced by multiplying with a reciprocal. There's
+    // no gather in SSE2 or NEON, so the table lookup is kept scalar.
+    pthread_once(&_bs_gfxbuf_convert_reciprocals_once,
+                 _bs_gfxbuf_convert_init_reciprocals);
+    for (; 0 < num; --num, ++pixels_ptr) {
+        uint32_t p = *pixels_ptr;
+        uint32_t alpha = p >> 24;
+        if (0xff == alpha) continue;
+        uint32_t r = _bs_gfxbuf_convert_reciprocals[alpha];
+        uint32_t red = BS_MIN(255u, (((p >> 16) & 0xff) * r + 0x8000) >> 16);
+        uint32_t green = BS_MIN(255u, (((p >> 8) & 0xff) * r + 0x8000) >> 16);
+        uint32_t blue = BS_MIN(255u, ((p & 0xff) * r + 0x8000) >> 16);
+        *pixels_ptr = (alpha << 24) | (red << 16) | (green << 8) | blue;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_convert_swap_rb(const uint32_t *src_ptr,
+                               uint32_t *dest_ptr,
+                               size_t num)
+{
+#if defined(__SSE2__)
+    const __m128i ag_mask = _mm_set1_epi32(0xff00ff00);
+    const __m128i b_mask = _mm_set1_epi32(0x000000ff);
+    for (; num >= 4; num -= 4, src_ptr += 4, dest_ptr += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)src_ptr);
+        __m128i q = _mm_or_si128(
+            _mm_and_si128(p, ag_mask),
+            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), b_mask),
+                         _mm_slli_epi32(_mm_and_si128(p, b_mask), 16)));
+        _mm_storeu_si128((__m128i*)dest_ptr, q);
+    }
+#elif defined(__ARM_NEON)
+    for (; num >= 16; num -= 16, src_ptr += 16, dest_ptr += 16) {
+        uint8x16x4_t p = vld4q_u8((const uint8_t*)src_ptr);
+        uint8x16_t tmp = p.val[0];
+        p.val[0] = p.val[2];
+        p.val[2] = tmp;
+        vst4q_u8((uint8_t*)dest_ptr, p);
+    }
+#endif
+    _bs_gfxbuf_convert_swap_rb_scalar(src_ptr, dest_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_convert_argb8888_to_rgb565(const uint32_t *src_ptr,
+                                          uint16_t *dest_ptr,
+                                          size_t num)
+{
+#if defined(__SSE2__)
+    const __m128i r_mask = _mm_set1_epi32(0xf800);
+    const __m128i g_mask = _mm_set1_epi32(0x07e0);
+    const __m128i b_mask = _mm_set1_epi32(0x001f);
+    for (; num >= 8; num -= 8, src_ptr += 8, dest_ptr += 8) {
+        __m128i v[2];
+        for (int i = 0; i < 2; ++i) {
+            __m128i p = _mm_loadu_si128((const __m128i*)(src_ptr + 4 * i));
+            v[i] = _mm_or_si128(
+                _mm_and_si128(_mm_srli_epi32(p, 8), r_mask),
+                _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 5), g_mask),
+                             _mm_and_si128(_mm_srli_epi32(p, 3), b_mask)));
+            // Sign-extend, so the signed saturation of packs is a no-op.
+            v[i] = _mm_srai_epi32(_mm_slli_epi32(v[i], 16), 16);
+        }
+        _mm_storeu_si128((__m128i*)dest_ptr, _mm_packs_epi32(v[0], v[1]));
+    }
+#endif
+    _bs_gfxbuf_convert_argb8888_to_rgb565_scalar(src_ptr, dest_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_convert_rgb565_to_argb8888(const uint16_t *src_ptr,
+                                          uint32_t *dest_ptr,
+                                          size_t num)
+{
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    for (; num >= 8; num -= 8, src_ptr += 8, dest_ptr += 8) {
+        __m128i p = _mm_loadu_si128((const __m128i*)src_ptr);
+        __m128i v[2] = {
+            _mm_unpacklo_epi16(p, zero), _mm_unpackhi_epi16(p, zero) };
+        for (int i = 0; i < 2; ++i) {
+            __m128i r = _mm_or_si128(
+                _mm_slli_epi32(_mm_and_si128(v[i], _mm_set1_epi32(0xf800)), 8),
+                _mm_slli_epi32(_mm_and_si128(v[i], _mm_set1_epi32(0xe000)), 3));
+            __m128i g = _mm_or_si128(
+                _mm_slli_epi32(_mm_and_si128(v[i], _mm_set1_epi32(0x07e0)), 5),
+                _mm_srli_epi32(_mm_and_si128(v[i], _mm_set1_epi32(0x0600)), 1));
+            __m128i b = _mm_or_si128(
+                _mm_slli_epi32(_mm_and_si128(v[i], _mm_set1_epi32(0x001f)), 3),
+                _mm_srli_epi32(_mm_and_si128(v[i], _mm_set1_epi32(0x001c)), 2));
+            _mm_storeu_si128(
+                (__m128i*)(dest_ptr + 4 * i),
+                _mm_or_si128(alpha, _mm_or_si128(r, _mm_or_si128(g, b))));
+        }
+    }
+#endif
+    _bs_gfxbuf_convert_rgb565_to_argb8888_scalar(src_ptr, dest_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_to_floats(const bs_gfxbuf_t *gfxbuf_ptr, float *dest_ptr)
+{
+    for (unsigned y = 0; y < gfxbuf_ptr->height; ++y) {
+        bs_gfxbuf_convert_argb8888_to_floats(
+            &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line],
+            dest_ptr + 4 * (size_t)y * gfxbuf_ptr->width,
+            gfxbuf_ptr->width);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_from_floats(bs_gfxbuf_t *gfxbuf_ptr, const float *src_ptr)
+{
+    for (unsigned y = 0; y < gfxbuf_ptr->height; ++y) {
+        bs_gfxbuf_convert_floats_to_argb8888(
+            src_ptr + 4 * (size_t)y * gfxbuf_ptr->width,
+            &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line],
+            gfxbuf_ptr->width);
+    }
+    bs_gfxbuf_damage_add(gfxbuf_ptr, 0, 0,
+                         gfxbuf_ptr->width, gfxbuf_ptr->height);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_to_rgb565(const bs_gfxbuf_t *gfxbuf_ptr, uint16_t *dest_ptr)
+{
+    for (unsigned y = 0; y < gfxbuf_ptr->height; ++y) {
+        bs_gfxbuf_convert_argb8888_to_rgb565(
+            &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line],
+            dest_ptr + (size_t)y * gfxbuf_ptr->width,
+            gfxbuf_ptr->width);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_from_rgb565(bs_gfxbuf_t *gfxbuf_ptr, const uint16_t *src_ptr)
+{
+    for (unsigned y = 0; y < gfxbuf_ptr->height; ++y) {
+        bs_gfxbuf_convert_rgb565_to_argb8888(
+            src_ptr + (size_t)y * gfxbuf_ptr->width,
+            &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line],
+            gfxbuf_ptr->width);
+    }
+    bs_gfxbuf_damage_add(gfxbuf_ptr, 0, 0,
+                         gfxbuf_ptr->width, gfxbuf_ptr->height);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_premultiply(bs_gfxbuf_t *gfxbuf_ptr)
+{
+    for (unsigned y = 0; y < gfxbuf_ptr->height; ++y) {
+        bs_gfxbuf_convert_premultiply(
+            &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line],
+            gfxbuf_ptr->width);
+    }
+    bs_gfxbuf_damage_add(gfxbuf_ptr, 0, 0,
+                         gfxbuf_ptr->width, gfxbuf_ptr->height);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_unpremultiply(bs_gfxbuf_t *gfxbuf_ptr)
+{
+    for (unsigned y = 0; y < gfxbuf_ptr->height; ++y) {
+        bs_gfxbuf_convert_unpremultiply(
+            &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line],
+            gfxbuf_ptr->width);
+    }
+    bs_gfxbuf_damage_add(gfxbuf_ptr, 0, 0,
+                         gfxbuf_ptr->width, gfxbuf_ptr->height);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_swap_rb(bs_gfxbuf_t *gfxbuf_ptr)
+{
+    for (unsigned y = 0; y < gfxbuf_ptr->height; ++y) {
+        uint32_t *line_ptr =
+            &gfxbuf_ptr->data_ptr[y * gfxbuf_ptr->pixels_per_line];
+        bs_gfxbuf_convert_swap_rb(line_ptr, line_ptr, gfxbuf_ptr->width);
+    }
+    bs_gfxbuf_damage_add(gfxbuf_ptr, 0, 0,
+                         gfxbuf_ptr->width, gfxbuf_ptr->height);
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+void _bs_gfxbuf_convert_argb8888_to_floats_scalar(
+    const uint32_t *src_ptr, float *dest_ptr, size_t num)
+{
+    for (; 0 < num; --num, ++src_ptr, dest_ptr += 4) {
+        uint32_t p = *src_ptr;
+        dest_ptr[0] = ((p >> 16) & 0xff) * _bs_gfxbuf_convert_scale;
+        dest_ptr[1] = ((p >> 8) & 0xff) * _bs_gfxbuf_convert_scale;
+        dest_ptr[2] = (p & 0xff) * _bs_gfxbuf_convert_scale;
+        dest_ptr[3] = (p >> 24) * _bs_gfxbuf_convert_scale;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Clamps `f` to [0, 1] and converts to the nearest 8-bit value. */
+static inline uint32_t _bs_gfxbuf_convert_float_to_8bit(float f)
+{
+    f = f > 0.0f ? f : 0.0f;
+    f = f < 1.0f ? f : 1.0f;
+    return (uint32_t)(f * 255.0f + 0.5f);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_gfxbuf_convert_floats_to_argb8888_scalar(
+    const float *src_ptr, uint32_t *dest_ptr, size_t num)
+{
+    for (; 0 < num; --num, src_ptr += 4, ++dest_ptr) {
+        *dest_ptr = (_bs_gfxbuf_convert_float_to_8bit(src_ptr[3]) << 24 |
+                     _bs_gfxbuf_convert_float_to_8bit(src_ptr[0]) << 16 |
+                     _bs_gfxbuf_convert_float_to_8bit(src_ptr[1]) << 8 |
+                     _bs_gfxbuf_convert_float_to_8bit(src_ptr[2]));
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_gfxbuf_convert_premultiply_scalar(uint32_t *pixels_ptr, size_t num)
+{
+    for (; 0 < num; --num, ++pixels_ptr) {
+        uint32_t p = *pixels_ptr;
+        uint32_t alpha = p >> 24;
+        // Exact division by 255, two channels at once. See gfxbuf.c.
+        uint32_t rb = (p & 0x00ff00ff) * alpha + 0x00800080;
+        rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+        uint32_t g = ((p >> 8) & 0xff) * alpha + 0x80;
+        g = ((g + (g >> 8)) >> 8) & 0xff;
+        *pixels_ptr = (alpha << 24) | rb | (g << 8);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_gfxbuf_convert_swap_rb_scalar(
+    const uint32_t *src_ptr, uint32_t *dest_ptr, size_t num)
+{
+    for (; 0 < num; --num, ++src_ptr, ++dest_ptr) {
+        uint32_t p = *src_ptr;
+        *dest_ptr = (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_gfxbuf_convert_argb8888_to_rgb565_scalar(
+    const uint32_t *src_ptr, uint16_t *dest_ptr, size_t num)
+{
+    for (; 0 < num; --num, ++src_ptr, ++dest_ptr) {
+        uint32_t p = *src_ptr;
+        *dest_ptr = ((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) |
+            ((p >> 3) & 0x001f);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_gfxbuf_convert_rgb565_to_argb8888_scalar(
+    const uint16_t *src_ptr, uint32_t *dest_ptr, size_t num)
+{
+    for (; 0 < num; --num, ++src_ptr, ++dest_ptr) {
+        uint32_t v = *src_ptr;
+        *dest_ptr = 0xff000000 |
+            ((v & 0xf800) << 8) | ((v & 0xe000) << 3) |
+            ((v & 0x07e0) << 5) | ((v & 0x0600) >> 1) |
+            ((v & 0x001f) << 3) | ((v & 0x001c) >> 2);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Initializes @ref _bs_gfxbuf_convert_reciprocals. */
+void _bs_gfxbuf_convert_init_reciprocals(void)
+{
+    _bs_gfxbuf_convert_reciprocals[0] = 0;
+    for (uint32_t a = 1; a < 256; ++a) {
+        _bs_gfxbuf_convert_reciprocals[a] = ((255u << 16) + a / 2) / a;
+    }
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_floats(bs_test_t *test_ptr);
+static void test_premultiply(bs_test_t *test_ptr);
+static void test_swap_rb(bs_test_t *test_ptr);
+static void test_rgb565(bs_test_t *test_ptr);
+static void test_gfxbuf(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_gfxbuf_convert_test_cases[] = {
+    { 1, "floats", test_floats },
+    { 1, "premultiply", test_premultiply },
+    { 1, "swap_rb", test_swap_rb },
+    { 1, "rgb565", test_rgb565 },
+    { 1, "gfxbuf", test_gfxbuf },
+    { 0, NULL, NULL }
+};
+
+/** Number of pixels used in tests. Not a multiple of any vector width. */
+#define _TEST_PIXELS 67
+
+/* ------------------------------------------------------------------------- */
+/** Fills `pixels` with pseudo-random values. */
+static void _test_random_pixels(uint32_t *pixels_ptr, size_t num)
+{
+    uint32_t seed = 1;
+    for (size_t i = 0; i < num; ++i) {
+        seed = seed * 1103515245 + 12345;
+        pixels_ptr[i] = seed ^ (seed << 13);
+    }
+    pixels_ptr[0] = 0;
+    pixels_ptr[1] = 0xffffffff;
+}
+
+/* ------------------------------------------------------------------------- */
+void test_floats(bs_test_t *test_ptr)
+{
+    uint32_t p[_TEST_PIXELS], q[_TEST_PIXELS], expected_p[_TEST_PIXELS];
+    float f[4 * _TEST_PIXELS], expected_f[4 * _TEST_PIXELS];
+    _test_random_pixels(p, _TEST_PIXELS);
+
+    bs_gfxbuf_convert_argb8888_to_floats(p, f, _TEST_PIXELS);
+    _bs_gfxbuf_convert_argb8888_to_floats_scalar(p, expected_f, _TEST_PIXELS);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected_f, f, sizeof(f));
+
+    // Matches the per-pixel method.
+    float r, g, b, a;
+    bs_gfxbuf_argb8888_to_floats(p[2], &r, &g, &b, &a);
+    BS_TEST_VERIFY_TRUE(test_ptr, 1e-6 > fabs(r - f[8]));
+    BS_TEST_VERIFY_TRUE(test_ptr, 1e-6 > fabs(g - f[9]));
+    BS_TEST_VERIFY_TRUE(test_ptr, 1e-6 > fabs(b - f[10]));
+    BS_TEST_VERIFY_TRUE(test_ptr, 1e-6 > fabs(a - f[11]));
+
+    // Round trip is lossless.
+    bs_gfxbuf_convert_floats_to_argb8888(f, q, _TEST_PIXELS);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, p, q, sizeof(p));
+
+    // Clamping, and same as scalar.
+    f[0] = -1.0f;
+    f[1] = 2.0f;
+    f[2] = 0.5f;
+    f[3] = 1.0f;
+    bs_gfxbuf_convert_floats_to_argb8888(f, q, _TEST_PIXELS);
+    _bs_gfxbuf_convert_floats_to_argb8888_scalar(f, expected_p, _TEST_PIXELS);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected_p, q, sizeof(q));
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff00ff80, q[0]);
+}
+
+/* ------------------------------------------------------------------------- */
+void test_premultiply(bs_test_t *test_ptr)
+{
+    uint32_t p[_TEST_PIXELS], expected[_TEST_PIXELS];
+    _test_random_pixels(p, _TEST_PIXELS);
+    memcpy(expected, p, sizeof(p));
+
+    bs_gfxbuf_convert_premultiply(p, _TEST_PIXELS);
+    _bs_gfxbuf_convert_premultiply_scalar(expected, _TEST_PIXELS);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected, p, sizeof(p));
+
+    uint32_t v = 0x80ff4020;
+    bs_gfxbuf_convert_premultiply(&v, 1);
+    BS_TEST_VERIFY_EQ(test_ptr, 0x80802010, v);
+    bs_gfxbuf_convert_unpremultiply(&v, 1);
+    BS_TEST_VERIFY_EQ(test_ptr, 0x80ff4020, v);
+
+    // Un-premultiplying gives back the straight color, within rounding.
+    uint32_t straight[_TEST_PIXELS];
+    _test_random_pixels(straight, _TEST_PIXELS);
+    bs_gfxbuf_convert_unpremultiply(p, _TEST_PIXELS);
+    for (int i = 0; i < _TEST_PIXELS; ++i) {
+        uint32_t alpha = straight[i] >> 24;
+        BS_TEST_VERIFY_EQ(test_ptr, alpha, p[i] >> 24);
+        if (0 == alpha) {
+            BS_TEST_VERIFY_EQ(test_ptr, 0, p[i]);
+            continue;
+        }
+        for (int shift = 0; shift < 24; shift += 8) {
+            int delta = (int)((p[i] >> shift) & 0xff) -
+                (int)((straight[i] >> shift) & 0xff);
+            // Precision loss of premultiplying is up to 255 / (2 * alpha).
+            BS_TEST_VERIFY_TRUE(test_ptr, abs(delta) <= (int)(128 / alpha + 1));
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void test_swap_rb(bs_test_t *test_ptr)
+{
+    uint32_t p[_TEST_PIXELS], q[_TEST_PIXELS], expected[_TEST_PIXELS];
+    _test_random_pixels(p, _TEST_PIXELS);
+
+    bs_gfxbuf_convert_swap_rb(p, q, _TEST_PIXELS);
+    _bs_gfxbuf_convert_swap_rb_scalar(p, expected, _TEST_PIXELS);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected, q, sizeof(q));
+
+    // In place, and back.
+    bs_gfxbuf_convert_swap_rb(q, q, _TEST_PIXELS);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, p, q, sizeof(q));
+
+    uint32_t v = 0x11223344;
+    bs_gfxbuf_convert_swap_rb(&v, &v, 1);
+    BS_TEST_VERIFY_EQ(test_ptr, 0x11443322, v);
+}
+
+/* ------------------------------------------------------------------------- */
+void test_rgb565(bs_test_t *test_ptr)
+{
+    uint32_t p[_TEST_PIXELS], q[_TEST_PIXELS], expected_p[_TEST_PIXELS];
+    uint16_t v[_TEST_PIXELS], expected_v[_TEST_PIXELS];
+    _test_random_pixels(p, _TEST_PIXELS);
+
+    bs_gfxbuf_convert_argb8888_to_rgb565(p, v, _TEST_PIXELS);
+    _bs_gfxbuf_convert_argb8888_to_rgb565_scalar(p, expected_v, _TEST_PIXELS);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected_v, v, sizeof(v));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, v[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xffff, v[1]);
+
+    bs_gfxbuf_convert_rgb565_to_argb8888(v, q, _TEST_PIXELS);
+    _bs_gfxbuf_convert_rgb565_to_argb8888_scalar(v, expected_p, _TEST_PIXELS);
+    BS_TEST_VERIFY_MEMEQ(test_ptr, expected_p, q, sizeof(q));
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff000000, q[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xffffffff, q[1]);
+
+    uint16_t red = 0xf800;
+    bs_gfxbuf_convert_rgb565_to_argb8888(&red, q, 1);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xffff0000, q[0]);
+}
+
+/* ------------------------------------------------------------------------- */
+void test_gfxbuf(bs_test_t *test_ptr)
+{
+    // Padded buffer: Padding must remain untouched.
+    uint32_t data[3 * 4] = {
+        0x80ff0000, 0x40404040, 0xff0000ff, 0xdeadbeef,
+        0x00000000, 0xffffffff, 0x01020304, 0xdeadbeef,
+        0x11223344, 0x55667788, 0x99aabbcc, 0xdeadbeef };
+    bs_gfxbuf_t *buf_ptr = bs_gfxbuf_create_unmanaged(3, 3, 4, data);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+
+    float f[4 * 3 * 3];
+    bs_gfxbuf_to_floats(buf_ptr, f);
+    BS_TEST_VERIFY_EQ(test_ptr, 1.0f, f[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, 1.0f, f[4 * 2 + 2]);
+    BS_TEST_VERIFY_EQ(test_ptr, 1.0f, f[4 * 4 + 3]);
+    f[0] = 0.0f;
+    bs_gfxbuf_from_floats(buf_ptr, f);
+    BS_TEST_VERIFY_EQ(test_ptr, 0x80000000, data[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xdeadbeef, data[3]);
+
+    bs_gfxbuf_swap_rb(buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xffff0000, data[2]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xdeadbeef, data[7]);
+
+    bs_gfxbuf_premultiply(buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0x40101010, data[1]);
+    bs_gfxbuf_unpremultiply(buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0x40404040, data[1]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xdeadbeef, data[11]);
+
+    uint16_t v[3 * 3];
+    bs_gfxbuf_to_rgb565(buf_ptr, v);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xffff, v[4]);
+    bs_gfxbuf_from_rgb565(buf_ptr, v);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xffffffff, data[5]);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xdeadbeef, data[11]);
+
+    bs_gfxbuf_destroy(buf_ptr);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_to_floats_per_pixel(bs_test_t *test_ptr);
+static void benchmark_to_floats(bs_test_t *test_ptr);
+static void benchmark_premultiply(bs_test_t *test_ptr);
+static void benchmark_to_rgb565(bs_test_t *test_ptr);
+
+/* set benchmarks to last for 2.5s each */
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t          bs_gfxbuf_convert_benchmarks[] = {
+    { 1, "benchmark-to_floats-per_pixel", benchmark_to_floats_per_pixel },
+    { 1, "benchmark-to_floats", benchmark_to_floats },
+    { 1, "benchmark-premultiply", benchmark_premultiply },
+    { 1, "benchmark-to_rgb565", benchmark_to_rgb565 },
+    { 0, NULL, NULL }
+};
+
+/** Signature of the methods to benchmark. */
+typedef void (*_benchmark_fn_t)(bs_gfxbuf_t *gfxbuf_ptr, void *dest_ptr);
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs `fn` on a 1024x768 buffer for @ref benchmark_duration, with an output
+ * buffer of 16 bytes per pixel.
+ */
+static void _benchmark(bs_test_t *test_ptr,
+                       const char *name_ptr,
+                       _benchmark_fn_t fn)
+{
+    bs_gfxbuf_t *buf_ptr = bs_gfxbuf_create(1024, 768);
+    if (NULL == buf_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_create(1024, 768)");
+        return;
+    }
+    void *dest_ptr = logged_malloc(16 * 1024 * 768);
+    if (NULL == dest_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed logged_malloc(%d)", 16 * 1024 * 768);
+        bs_gfxbuf_destroy(buf_ptr);
+        return;
+    }
+    bs_gfxbuf_clear(buf_ptr, 0x80402010);
+
+    uint64_t usec = bs_fast_usec();
+    unsigned iterations = 0;
+    while (usec + benchmark_duration >= bs_fast_usec()) {
+        fn(buf_ptr, dest_ptr);
+        iterations++;
+    }
+    usec = bs_fast_usec() - usec;
+
+    bs_test_succeed(test_ptr, "%s: %.3e pix/sec", name_ptr,
+                    (double)iterations * 1024 * 768 / (usec * 1e-6));
+    logged_free(dest_ptr);
+    bs_gfxbuf_destroy(buf_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Converts to floats, calling bs_gfxbuf_argb8888_to_floats per pixel. */
+static void _benchmark_to_floats_per_pixel(bs_gfxbuf_t *gfxbuf_ptr,
+                                           void *dest_ptr)
+{
+    float *f = dest_ptr;
+    for (unsigned y = 0; y < gfxbuf_ptr->height; ++y) {
+        for (unsigned x = 0; x < gfxbuf_ptr->width; ++x, f += 4) {
+            bs_gfxbuf_argb8888_to_floats(
+                *bs_gfxbuf_pixel_at(gfxbuf_ptr, x, y),
+                &f[0], &f[1], &f[2], &f[3]);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_to_floats(bs_gfxbuf_t *gfxbuf_ptr, void *dest_ptr)
+{
+    bs_gfxbuf_to_floats(gfxbuf_ptr, dest_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_premultiply(bs_gfxbuf_t *gfxbuf_ptr,
+                                   __UNUSED__ void *dest_ptr)
+{
+    bs_gfxbuf_premultiply(gfxbuf_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_to_rgb565(bs_gfxbuf_t *gfxbuf_ptr, void *dest_ptr)
+{
+    bs_gfxbuf_to_rgb565(gfxbuf_ptr, dest_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_to_floats_per_pixel(bs_test_t *test_ptr)
+{
+    _benchmark(test_ptr, "bs_gfxbuf_argb8888_to_floats",
+               _benchmark_to_floats_per_pixel);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_to_floats(bs_test_t *test_ptr)
+{
+    _benchmark(test_ptr, "bs_gfxbuf_to_floats", _benchmark_to_floats);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_premultiply(bs_test_t *test_ptr)
+{
+    _benchmark(test_ptr, "bs_gfxbuf_premultiply", _benchmark_premultiply);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_to_rgb565(bs_test_t *test_ptr)
+{
+    _benchmark(test_ptr, "bs_gfxbuf_to_rgb565", _benchmark_to_rgb565);
+}
+
+/* == End of gfxbuf_convert.c ============================================== */
@@ -0,0 +1,168 @@
+/* ========================================================================= */
+/**
+ * @file gfxbuf_convert.h
+ * Bulk pixel format conversions, for spans of pixels and for @ref bs_gfxbuf_t.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_GFXBUF_CONVERT_H__
+#define __LIBBASE_GFXBUF_CONVERT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gfxbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/**
+ * Converts ARGB 8888 pixels to floating point RGBA, in [0, 1].
+ *
+ * @param src_ptr             `num` pixels, in ARGB 8888.
+ * @param dest_ptr            Output: 4 * `num` floats, in R, G, B, A order.
+ * @param num
+ */
+void bs_gfxbuf_convert_argb8888_to_floats(const uint32_t *src_ptr,
+                                          float *dest_ptr,
+                                          size_t num);
+
+/**
+ * Converts floating point RGBA to ARGB 8888 pixels. Values are clamped to
+ * [0, 1] and rounded to the nearest 8-bit value.
+ *
+ * @param src_ptr             4 * `num` floats, in R, G, B, A order.
+ * @param dest_ptr            Output: `num` pixels, in ARGB 8888.
+ * @param num
+ */
+void bs_gfxbuf_convert_floats_to_argb8888(const float *src_ptr,
+                                          uint32_t *dest_ptr,
+                                          size_t num);
+
+/**
+ * Multiplies the color components of the pixels by their alpha, in place.
+ *
+ * @param pixels_ptr          `num` pixels, in (straight) ARGB 8888.
+ * @param num
+ */
+void bs_gfxbuf_convert_premultiply(uint32_t *pixels_ptr, size_t num);
+
+/**
+ * Divides the color components of the pixels by their alpha, in place.
+ * Pixels with an alpha of 0 become 0.
+ *
+ * @param pixels_ptr          `num` pixels, in premultiplied ARGB 8888.
+ * @param num
+ */
+void bs_gfxbuf_convert_unpremultiply(uint32_t *pixels_ptr, size_t num);
+
+/**
+ * Swaps red and blue components: Converts ARGB 8888 to ABGR 8888, and back.
+ * `src_ptr` and `dest_ptr` may be the same.
+ *
+ * @param src_ptr
+ * @param dest_ptr
+ * @param num
+ */
+void bs_gfxbuf_convert_swap_rb(const uint32_t *src_ptr,
+                               uint32_t *dest_ptr,
+                               size_t num);
+
+/**
+ * Converts ARGB 8888 to RGB 565, dropping alpha and truncating components.
+ *
+ * @param src_ptr
+ * @param dest_ptr
+ * @param num
+ */
+void bs_gfxbuf_convert_argb8888_to_rgb565(const uint32_t *src_ptr,
+                                          uint16_t *dest_ptr,
+                                          size_t num);
+
+/**
+ * Converts RGB 565 to opaque ARGB 8888, replicating the top bits into the
+ * bottom bits, so that 0x1f becomes 0xff.
+ *
+ * @param src_ptr
+ * @param dest_ptr
+ * @param num
+ */
+void bs_gfxbuf_convert_rgb565_to_argb8888(const uint16_t *src_ptr,
+                                          uint32_t *dest_ptr,
+                                          size_t num);
+
+/**
+ * Converts the graphics buffer to floating point RGBA. See
+ * @ref bs_gfxbuf_convert_argb8888_to_floats.
+ *
+ * @param gfxbuf_ptr
+ * @param dest_ptr            Output: 4 * `width` * `height` floats, without
+ *                            any padding between lines.
+ */
+void bs_gfxbuf_to_floats(const bs_gfxbuf_t *gfxbuf_ptr, float *dest_ptr);
+
+/**
+ * Sets the graphics buffer from floating point RGBA. See
+ * @ref bs_gfxbuf_convert_floats_to_argb8888.
+ *
+ * @param gfxbuf_ptr
+ * @param src_ptr             4 * `width` * `height` floats, without any
+ *                            padding between lines.
+ */
+void bs_gfxbuf_from_floats(bs_gfxbuf_t *gfxbuf_ptr, const float *src_ptr);
+
+/**
+ * Converts the graphics buffer to RGB 565. See
+ * @ref bs_gfxbuf_convert_argb8888_to_rgb565.
+ *
+ * @param gfxbuf_ptr
+ * @param dest_ptr            Output: `width` * `height` pixels, without any
+ *                            padding between lines.
+ */
+void bs_gfxbuf_to_rgb565(const bs_gfxbuf_t *gfxbuf_ptr, uint16_t *dest_ptr);
+
+/**
+ * Sets the graphics buffer from RGB 565. See
+ * @ref bs_gfxbuf_convert_rgb565_to_argb8888.
+ *
+ * @param gfxbuf_ptr
+ * @param src_ptr             `width` * `height` pixels, without any padding
+ *                            between lines.
+ */
+void bs_gfxbuf_from_rgb565(bs_gfxbuf_t *gfxbuf_ptr, const uint16_t *src_ptr);
+
+/** Premultiplies all pixels of the graphics buffer, in place. */
+void bs_gfxbuf_premultiply(bs_gfxbuf_t *gfxbuf_ptr);
+
+/** Un-premultiplies all pixels of the graphics buffer, in place. */
+void bs_gfxbuf_unpremultiply(bs_gfxbuf_t *gfxbuf_ptr);
+
+/** Swaps red and blue of all pixels in the graphics buffer, in place. */
+void bs_gfxbuf_swap_rb(bs_gfxbuf_t *gfxbuf_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_gfxbuf_convert_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_gfxbuf_convert_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_GFXBUF_CONVERT_H__ */
+/* == End of gfxbuf_convert.h ============================================== */
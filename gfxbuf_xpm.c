@@ -22,23 +22,68 @@
 
 #include <ctype.h>
 
+#include "arena.h"
 #include "avltree.h"
+#include "log_wrappers.h"
+#include "lru.h"
 #include "strutil.h"
+#include "time.h"
 
 /* == Declarations ========================================================= */
 
-/** Node for storing & looking up colors from the XPM. */
+/** Node for storing & looking up colors from the XPM. From an arena. */
 typedef struct {
     /** Tree node. */
     bs_avltree_node_t         node;
     /** The characters that define this color. */
     char                      *pixel_chars_ptr;
-    /** Number of caracters that make up the pixel. */
+    /** Number of characters that make up the pixel. */
     unsigned                  chars_per_pixel;
     /** Corresponding color, in ARGB8888. */
     uint32_t                  color;
 } bs_gfxbuf_xpm_color_node_t;
 
+/**
+ * Compiled lookup from pixel characters to color. Up to 2 characters per
+ * pixel are looked up directly in a table, indexed by the characters. Longer
+ * pixels are looked up in a hash table.
+ */
+typedef struct {
+    /** Number of characters that make up the pixel. */
+    unsigned                  chars_per_pixel;
+    /** Direct lookup: Colors, indexed by the pixel characters. */
+    uint32_t                  *colors_ptr;
+    /** Direct lookup: Bitmap of the defined entries in `colors_ptr`. */
+    uint8_t                   *defined_ptr;
+    /** Hash lookup: Open addressing with linear probing. */
+    const bs_gfxbuf_xpm_color_node_t **slots_ptr;
+    /** Hash lookup: Number of slots, minus 1. */
+    size_t                    slots_mask;
+} bs_gfxbuf_xpm_lookup_t;
+
+/** State of the XPM cache. */
+struct _bs_gfxbuf_xpm_cache_t {
+    /**
+     * Entries, keyed by the XPM data pointer. Owns the entries, with the
+     * bytes held by the image as cost.
+     */
+    bs_lru_t                  *lru_ptr;
+    /** The same entries, keyed by the image pointer. */
+    bs_avltree_t              *entries_by_gfxbuf_ptr;
+};
+
+/** An entry of the XPM cache. */
+typedef struct {
+    /** Node in @ref bs_gfxbuf_xpm_cache_t::lru_ptr. */
+    bs_lru_node_t             lru_node;
+    /** Node in @ref bs_gfxbuf_xpm_cache_t::entries_by_gfxbuf_ptr. */
+    bs_avltree_node_t         gfxbuf_node;
+    /** The XPM data this entry was decoded from. */
+    char                      **xpm_data_ptr;
+    /** The decoded image. */
+    bs_gfxbuf_t               *gfxbuf_ptr;
+} bs_gfxbuf_xpm_cache_entry_t;
+
 static bool _bs_gfxbuf_xpm_copy_data(
     bs_gfxbuf_t *gfxbuf_ptr,
     char **xpm_data_ptr,
@@ -57,13 +102,36 @@ static bool _bs_gfxbuf_xpm_parse_color_into_node(
     const char* color_line_ptr);
 
 static bs_gfxbuf_xpm_color_node_t *_bs_gfxbuf_xpm_color_node_create(
+    bs_arena_t *arena_ptr,
     unsigned chars_per_pixel);
-static void _bs_gfxbuf_xpm_color_node_destroy(
-    bs_avltree_node_t *node_ptr);
 static int _bs_gfxbuf_xpm_color_node_cmp(
     const bs_avltree_node_t *node_ptr,
     const void *key_ptr);
 
+static bool _bs_gfxbuf_xpm_lookup_init(
+    bs_gfxbuf_xpm_lookup_t *lookup_ptr,
+    bs_avltree_t *tree_ptr,
+    unsigned colors,
+    unsigned chars_per_pixel);
+static void _bs_gfxbuf_xpm_lookup_fini(bs_gfxbuf_xpm_lookup_t *lookup_ptr);
+static bool _bs_gfxbuf_xpm_lookup(
+    const bs_gfxbuf_xpm_lookup_t *lookup_ptr,
+    const char *pixel_chars_ptr,
+    uint32_t *color_ptr);
+static size_t _bs_gfxbuf_xpm_hash(const char *pixel_chars_ptr,
+                                  unsigned chars_per_pixel);
+
+static void _bs_gfxbuf_xpm_cache_evict(bs_lru_node_t *node_ptr,
+                                       void *ud_ptr);
+static void _bs_gfxbuf_xpm_cache_entry_destroy(
+    bs_gfxbuf_xpm_cache_entry_t *entry_ptr);
+static bool _bs_gfxbuf_xpm_cache_entry_data_equals(
+    const bs_hashmap_node_t *node_ptr,
+    const void *key_ptr);
+static int _bs_gfxbuf_xpm_cache_entry_gfxbuf_cmp(
+    const bs_avltree_node_t *node_ptr,
+    const void *key_ptr);
+
 /* == Exported methods ===================================================== */
 
 /* ------------------------------------------------------------------------- */
@@ -83,6 +151,107 @@ bs_gfxbuf_t *bs_gfxbuf_xpm_create_from_data(char **xpm_data_ptr)
     return NULL;
 }
 
+/* ------------------------------------------------------------------------- */
+bs_gfxbuf_xpm_cache_t *bs_gfxbuf_xpm_cache_create(size_t max_bytes)
+{
+    bs_gfxbuf_xpm_cache_t *cache_ptr = logged_calloc(
+        1, sizeof(bs_gfxbuf_xpm_cache_t));
+    if (NULL == cache_ptr) return NULL;
+
+    cache_ptr->lru_ptr = bs_lru_create(
+        bs_hashmap_hash_ptr,
+        _bs_gfxbuf_xpm_cache_entry_data_equals,
+        _bs_gfxbuf_xpm_cache_evict,
+        cache_ptr,
+        SIZE_MAX,
+        max_bytes,
+        BS_LRU_POLICY_LRU,
+        0);
+    cache_ptr->entries_by_gfxbuf_ptr = bs_avltree_create(
+        _bs_gfxbuf_xpm_cache_entry_gfxbuf_cmp, NULL);
+    if (NULL == cache_ptr->lru_ptr ||
+        NULL == cache_ptr->entries_by_gfxbuf_ptr) {
+        bs_gfxbuf_xpm_cache_destroy(cache_ptr);
+        return NULL;
+    }
+    return cache_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_xpm_cache_destroy(bs_gfxbuf_xpm_cache_t *cache_ptr)
+{
+    // Evicting the entries also deletes them from `entries_by_gfxbuf_ptr`.
+    if (NULL != cache_ptr->lru_ptr) {
+        bs_lru_destroy(cache_ptr->lru_ptr);
+        cache_ptr->lru_ptr = NULL;
+    }
+    if (NULL != cache_ptr->entries_by_gfxbuf_ptr) {
+        bs_avltree_destroy(cache_ptr->entries_by_gfxbuf_ptr);
+        cache_ptr->entries_by_gfxbuf_ptr = NULL;
+    }
+    logged_free(cache_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+const bs_gfxbuf_t *bs_gfxbuf_xpm_cache_acquire(
+    bs_gfxbuf_xpm_cache_t *cache_ptr,
+    char **xpm_data_ptr)
+{
+    bs_gfxbuf_xpm_cache_entry_t *entry_ptr;
+    bs_lru_node_t *node_ptr = bs_lru_acquire(cache_ptr->lru_ptr, xpm_data_ptr);
+    if (NULL != node_ptr) {
+        entry_ptr = BS_CONTAINER_OF(
+            node_ptr, bs_gfxbuf_xpm_cache_entry_t, lru_node);
+        return entry_ptr->gfxbuf_ptr;
+    }
+
+    entry_ptr = logged_calloc(1, sizeof(bs_gfxbuf_xpm_cache_entry_t));
+    if (NULL == entry_ptr) return NULL;
+    entry_ptr->gfxbuf_ptr = bs_gfxbuf_xpm_create_from_data(xpm_data_ptr);
+    if (NULL == entry_ptr->gfxbuf_ptr) {
+        logged_free(entry_ptr);
+        return NULL;
+    }
+    entry_ptr->xpm_data_ptr = xpm_data_ptr;
+    size_t bytes = (size_t)entry_ptr->gfxbuf_ptr->pixels_per_line *
+        entry_ptr->gfxbuf_ptr->height * sizeof(uint32_t);
+
+    // Indexed by image before inserting: Inserting may evict other entries.
+    bs_avltree_insert(cache_ptr->entries_by_gfxbuf_ptr, entry_ptr->gfxbuf_ptr,
+                      &entry_ptr->gfxbuf_node, false);
+    node_ptr = bs_lru_insert(cache_ptr->lru_ptr, xpm_data_ptr,
+                             &entry_ptr->lru_node, bytes);
+    if (NULL == node_ptr) {
+        bs_avltree_delete(cache_ptr->entries_by_gfxbuf_ptr,
+                          entry_ptr->gfxbuf_ptr);
+        _bs_gfxbuf_xpm_cache_entry_destroy(entry_ptr);
+        return NULL;
+    }
+    return entry_ptr->gfxbuf_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_gfxbuf_xpm_cache_release(bs_gfxbuf_xpm_cache_t *cache_ptr,
+                                 const bs_gfxbuf_t *gfxbuf_ptr)
+{
+    bs_avltree_node_t *node_ptr = bs_avltree_lookup(
+        cache_ptr->entries_by_gfxbuf_ptr, gfxbuf_ptr);
+    if (NULL == node_ptr) {
+        bs_log(BS_FATAL, "Releasing %p, not acquired from cache %p",
+               gfxbuf_ptr, cache_ptr);
+        return;
+    }
+    bs_gfxbuf_xpm_cache_entry_t *entry_ptr = BS_CONTAINER_OF(
+        node_ptr, bs_gfxbuf_xpm_cache_entry_t, gfxbuf_node);
+    bs_lru_release(cache_ptr->lru_ptr, &entry_ptr->lru_node);
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_gfxbuf_xpm_cache_bytes(const bs_gfxbuf_xpm_cache_t *cache_ptr)
+{
+    return bs_lru_cost(cache_ptr->lru_ptr);
+}
+
 /* == Local (static) methods =============================================== */
 
 /* ------------------------------------------------------------------------- */
@@ -115,7 +284,10 @@ bool _bs_gfxbuf_xpm_copy_data(
         return false;
     }
 
-    // Prevent the XPM from spilling beyond the buffer.
+    // Nothing to draw if fully outside. Otherwise, clip to the buffer.
+    if (dest_x >= gfxbuf_ptr->width || dest_y >= gfxbuf_ptr->height) {
+        return true;
+    }
     if (width + dest_x > gfxbuf_ptr->width) {
         width = gfxbuf_ptr->width - dest_x;
     }
@@ -124,15 +296,20 @@ bool _bs_gfxbuf_xpm_copy_data(
     }
     xpm_data_ptr++;
 
-    // Parse the colors and store htem in the lookup tree.
+    // Parse the colors and store htem in the lookup tree. The nodes are all
+    // released together, so they are taken from an arena.
+    bs_arena_t *arena_ptr = bs_arena_create(0);
+    if (NULL == arena_ptr) return false;
     bs_avltree_t *tree_ptr = bs_avltree_create(
-        _bs_gfxbuf_xpm_color_node_cmp, _bs_gfxbuf_xpm_color_node_destroy);
+        _bs_gfxbuf_xpm_color_node_cmp, NULL);
     if (NULL == tree_ptr) {
         bs_log(BS_ERROR, "Failed bs_avltree_create");
+        bs_arena_destroy(arena_ptr);
         return false;
     }
     for (unsigned color = 0; color < colors; ++color, ++xpm_data_ptr) {
-        color_node_ptr = _bs_gfxbuf_xpm_color_node_create(chars_per_pixel);
+        color_node_ptr = _bs_gfxbuf_xpm_color_node_create(
+            arena_ptr, chars_per_pixel);
         if (NULL != color_node_ptr) {
             if (_bs_gfxbuf_xpm_parse_color_into_node(
                     color_node_ptr, chars_per_pixel, *xpm_data_ptr)) {
@@ -145,37 +322,50 @@ bool _bs_gfxbuf_xpm_copy_data(
                 }
                 bs_log(BS_ERROR, "Color \"%s\" already exists", *xpm_data_ptr);
             }
-            _bs_gfxbuf_xpm_color_node_destroy(&color_node_ptr->node);
         }
         bs_avltree_destroy(tree_ptr);
+        bs_arena_destroy(arena_ptr);
+        return false;
+    }
+
+    // Compile the tree into a lookup that's cheap to query per pixel.
+    bs_gfxbuf_xpm_lookup_t lookup;
+    if (!_bs_gfxbuf_xpm_lookup_init(
+            &lookup, tree_ptr, colors, chars_per_pixel)) {
+        bs_avltree_destroy(tree_ptr);
+        bs_arena_destroy(arena_ptr);
         return false;
     }
 
     // Now, parse the XPM pixels.
     bool outcome = true;
-    for (unsigned y = 0; y < height; ++y, ++xpm_data_ptr) {
+    for (unsigned y = 0; y < height && outcome; ++y, ++xpm_data_ptr) {
         if (width * chars_per_pixel > strlen(*xpm_data_ptr)) {
             bs_log(BS_ERROR, "Shorter than %u chars: \"%s\"",
                    width * chars_per_pixel, *xpm_data_ptr);
             outcome = false;
             break;
         }
-        for (unsigned x = 0; x < width; ++x) {
-            bs_gfxbuf_xpm_color_node_t *color_node_ptr =
-                (bs_gfxbuf_xpm_color_node_t*)bs_avltree_lookup(
-                    tree_ptr,
-                    *xpm_data_ptr + x * chars_per_pixel);
-            // Ignore transparent pixels.
-            if (color_node_ptr->color != 0x00000000) {
-                bs_gfxbuf_set_pixel(
-                    gfxbuf_ptr,
-                    dest_x + x, dest_y + y,
-                    color_node_ptr->color);
+        uint32_t *pixel_ptr = &gfxbuf_ptr->data_ptr[
+            (dest_y + y) * gfxbuf_ptr->pixels_per_line + dest_x];
+        const char *chars_ptr = *xpm_data_ptr;
+        for (unsigned x = 0; x < width; ++x, chars_ptr += chars_per_pixel) {
+            uint32_t color;
+            if (!_bs_gfxbuf_xpm_lookup(&lookup, chars_ptr, &color)) {
+                bs_log(BS_ERROR, "Undefined pixel at %u, %u: \"%.*s\"",
+                       x, y, (int)chars_per_pixel, chars_ptr);
+                outcome = false;
+                break;
             }
+            // Ignore transparent pixels.
+            if (color != 0x00000000) pixel_ptr[x] = color;
         }
     }
+    bs_gfxbuf_damage_add(gfxbuf_ptr, dest_x, dest_y, width, height);
 
+    _bs_gfxbuf_xpm_lookup_fini(&lookup);
     bs_avltree_destroy(tree_ptr);
+    bs_arena_destroy(arena_ptr);
     return outcome;
 }
 
@@ -283,39 +473,22 @@ bool _bs_gfxbuf_xpm_parse_color_into_node(
 }
 
 /* ------------------------------------------------------------------------- */
+/** Creates a color node from `arena_ptr`. Released with the arena. */
 bs_gfxbuf_xpm_color_node_t *_bs_gfxbuf_xpm_color_node_create(
+    bs_arena_t *arena_ptr,
     unsigned chars_per_pixel)
 {
-    bs_gfxbuf_xpm_color_node_t *color_node_ptr = calloc(
-        1, sizeof(bs_gfxbuf_xpm_color_node_t));
-    if (NULL == color_node_ptr) {
-        bs_log(BS_ERROR | BS_ERRNO, "Failed calloc(1, %zu)",
-               sizeof(bs_gfxbuf_xpm_color_node_t));
-        return NULL;
-    }
+    bs_gfxbuf_xpm_color_node_t *color_node_ptr = bs_arena_calloc(
+        arena_ptr, 1, sizeof(bs_gfxbuf_xpm_color_node_t));
+    if (NULL == color_node_ptr) return NULL;
 
-    color_node_ptr->pixel_chars_ptr = calloc(1, chars_per_pixel);
-    if (NULL == color_node_ptr->pixel_chars_ptr) {
-        bs_log(BS_ERROR | BS_ERRNO, "Failed calloc(1, %u)", chars_per_pixel);
-        _bs_gfxbuf_xpm_color_node_destroy(&color_node_ptr->node);
-        return NULL;
-    }
+    color_node_ptr->pixel_chars_ptr = bs_arena_calloc(
+        arena_ptr, 1, chars_per_pixel);
+    if (NULL == color_node_ptr->pixel_chars_ptr) return NULL;
     color_node_ptr->chars_per_pixel = chars_per_pixel;
     return color_node_ptr;
 }
 
-/* ------------------------------------------------------------------------- */
-void _bs_gfxbuf_xpm_color_node_destroy(bs_avltree_node_t *node_ptr)
-{
-    bs_gfxbuf_xpm_color_node_t *color_node_ptr =
-        (bs_gfxbuf_xpm_color_node_t*)node_ptr;
-    if (NULL != color_node_ptr->pixel_chars_ptr) {
-        free(color_node_ptr->pixel_chars_ptr);
-        color_node_ptr->pixel_chars_ptr = NULL;
-    }
-    free(color_node_ptr);
-}
-
 /* ------------------------------------------------------------------------- */
 int _bs_gfxbuf_xpm_color_node_cmp(const bs_avltree_node_t *node_ptr,
                                   const void *key_ptr) {
@@ -326,16 +499,191 @@ int _bs_gfxbuf_xpm_color_node_cmp(const bs_avltree_node_t *node_ptr,
                   color_node_ptr->chars_per_pixel);
 }
 
+/* ------------------------------------------------------------------------- */
+/**
+ * Initializes `lookup_ptr` from the color nodes in `tree_ptr`. The tree must
+ * outlive the lookup.
+ *
+ * @return true on success.
+ */
+bool _bs_gfxbuf_xpm_lookup_init(
+    bs_gfxbuf_xpm_lookup_t *lookup_ptr,
+    bs_avltree_t *tree_ptr,
+    unsigned colors,
+    unsigned chars_per_pixel)
+{
+    memset(lookup_ptr, 0, sizeof(bs_gfxbuf_xpm_lookup_t));
+    lookup_ptr->chars_per_pixel = chars_per_pixel;
+
+    if (2 >= chars_per_pixel) {
+        size_t entries = 1 << (8 * chars_per_pixel);
+        lookup_ptr->colors_ptr = logged_calloc(entries, sizeof(uint32_t));
+        if (NULL == lookup_ptr->colors_ptr) return false;
+        lookup_ptr->defined_ptr = logged_calloc(entries / 8, 1);
+        if (NULL == lookup_ptr->defined_ptr) {
+            _bs_gfxbuf_xpm_lookup_fini(lookup_ptr);
+            return false;
+        }
+    } else {
+        // Keep the load factor at or below 50%.
+        size_t slots = 16;
+        while (slots < 2 * (size_t)colors) slots *= 2;
+        lookup_ptr->slots_ptr = logged_calloc(
+            slots, sizeof(bs_gfxbuf_xpm_color_node_t*));
+        if (NULL == lookup_ptr->slots_ptr) return false;
+        lookup_ptr->slots_mask = slots - 1;
+    }
+
+    for (bs_avltree_node_t *node_ptr = bs_avltree_min(tree_ptr);
+         NULL != node_ptr;
+         node_ptr = bs_avltree_node_next(tree_ptr, node_ptr)) {
+        const bs_gfxbuf_xpm_color_node_t *color_node_ptr =
+            (const bs_gfxbuf_xpm_color_node_t*)node_ptr;
+        const uint8_t *c_ptr = (const uint8_t*)color_node_ptr->pixel_chars_ptr;
+        if (NULL != lookup_ptr->colors_ptr) {
+            size_t idx = 2 == chars_per_pixel ? c_ptr[0] | c_ptr[1] << 8 :
+                c_ptr[0];
+            lookup_ptr->colors_ptr[idx] = color_node_ptr->color;
+            lookup_ptr->defined_ptr[idx / 8] |= 1 << (idx % 8);
+        } else {
+            size_t idx = _bs_gfxbuf_xpm_hash(
+                color_node_ptr->pixel_chars_ptr, chars_per_pixel);
+            while (NULL != lookup_ptr->slots_ptr[idx & lookup_ptr->slots_mask]) {
+                ++idx;
+            }
+            lookup_ptr->slots_ptr[idx & lookup_ptr->slots_mask] =
+                color_node_ptr;
+        }
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Releases the resources held by `lookup_ptr`. */
+void _bs_gfxbuf_xpm_lookup_fini(bs_gfxbuf_xpm_lookup_t *lookup_ptr)
+{
+    if (NULL != lookup_ptr->colors_ptr) {
+        logged_free(lookup_ptr->colors_ptr);
+        lookup_ptr->colors_ptr = NULL;
+    }
+    if (NULL != lookup_ptr->defined_ptr) {
+        logged_free(lookup_ptr->defined_ptr);
+        lookup_ptr->defined_ptr = NULL;
+    }
+    if (NULL != lookup_ptr->slots_ptr) {
+        logged_free(lookup_ptr->slots_ptr);
+        lookup_ptr->slots_ptr = NULL;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Looks up the color for the pixel at `pixel_chars_ptr`.
+ *
+ * @return false if the pixel characters weren't defined as a color.
+ */
+bool _bs_gfxbuf_xpm_lookup(
+    const bs_gfxbuf_xpm_lookup_t *lookup_ptr,
+    const char *pixel_chars_ptr,
+    uint32_t *color_ptr)
+{
+    if (NULL != lookup_ptr->colors_ptr) {
+        const uint8_t *c_ptr = (const uint8_t*)pixel_chars_ptr;
+        size_t idx = 2 == lookup_ptr->chars_per_pixel ?
+            c_ptr[0] | c_ptr[1] << 8 : c_ptr[0];
+        if (!(lookup_ptr->defined_ptr[idx / 8] & (1 << (idx % 8)))) {
+            return false;
+        }
+        *color_ptr = lookup_ptr->colors_ptr[idx];
+        return true;
+    }
+
+    size_t idx = _bs_gfxbuf_xpm_hash(
+        pixel_chars_ptr, lookup_ptr->chars_per_pixel);
+    for (;; ++idx) {
+        const bs_gfxbuf_xpm_color_node_t *color_node_ptr =
+            lookup_ptr->slots_ptr[idx & lookup_ptr->slots_mask];
+        if (NULL == color_node_ptr) return false;
+        if (0 == memcmp(color_node_ptr->pixel_chars_ptr, pixel_chars_ptr,
+                        lookup_ptr->chars_per_pixel)) {
+            *color_ptr = color_node_ptr->color;
+            return true;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** FNV-1a hash of the pixel characters. */
+size_t _bs_gfxbuf_xpm_hash(const char *pixel_chars_ptr,
+                           unsigned chars_per_pixel)
+{
+    uint32_t hash = 2166136261u;
+    for (unsigned i = 0; i < chars_per_pixel; ++i) {
+        hash = (hash ^ (uint8_t)pixel_chars_ptr[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Evicts the entry, once unreferenced and beyond the cache's budget. A
+ * @ref bs_lru_evict_t, with `ud_ptr` the @ref bs_gfxbuf_xpm_cache_t.
+ */
+void _bs_gfxbuf_xpm_cache_evict(bs_lru_node_t *node_ptr, void *ud_ptr)
+{
+    bs_gfxbuf_xpm_cache_t *cache_ptr = ud_ptr;
+    bs_gfxbuf_xpm_cache_entry_t *entry_ptr = BS_CONTAINER_OF(
+        node_ptr, bs_gfxbuf_xpm_cache_entry_t, lru_node);
+    bs_avltree_delete(cache_ptr->entries_by_gfxbuf_ptr,
+                      entry_ptr->gfxbuf_ptr);
+    _bs_gfxbuf_xpm_cache_entry_destroy(entry_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Destroys the cache entry. */
+void _bs_gfxbuf_xpm_cache_entry_destroy(bs_gfxbuf_xpm_cache_entry_t *entry_ptr)
+{
+    bs_gfxbuf_destroy(entry_ptr->gfxbuf_ptr);
+    logged_free(entry_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Whether the entry's XPM data pointer equals `key_ptr`. */
+bool _bs_gfxbuf_xpm_cache_entry_data_equals(
+    const bs_hashmap_node_t *node_ptr,
+    const void *key_ptr)
+{
+    const bs_gfxbuf_xpm_cache_entry_t *entry_ptr = BS_CONTAINER_OF(
+        bs_lru_node_from_hashmap_node(node_ptr),
+        const bs_gfxbuf_xpm_cache_entry_t, lru_node);
+    return entry_ptr->xpm_data_ptr == key_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Compares the entry's image pointer with `key_ptr`. */
+int _bs_gfxbuf_xpm_cache_entry_gfxbuf_cmp(
+    const bs_avltree_node_t *node_ptr,
+    const void *key_ptr)
+{
+    const bs_gfxbuf_xpm_cache_entry_t *entry_ptr = BS_CONTAINER_OF(
+        node_ptr, bs_gfxbuf_xpm_cache_entry_t, gfxbuf_node);
+    return bs_avltree_cmp_ptr(entry_ptr->gfxbuf_ptr, key_ptr);
+}
+
 /* == Unit tests =========================================================== */
 
 static void test_parse_color(bs_test_t *test_ptr);
 static void test_parse_xpm(bs_test_t *test_ptr);
 static void test_create_xpm(bs_test_t *test_ptr);
+static void test_chars_per_pixel(bs_test_t *test_ptr);
+static void test_cache(bs_test_t *test_ptr);
 
 const bs_test_case_t          bs_gfxbuf_xpm_test_cases[] = {
     { 1, "parse_color", test_parse_color },
     { 1, "parse_xpm", test_parse_xpm },
     { 1, "create_xpm", test_create_xpm },
+    { 1, "chars_per_pixel", test_chars_per_pixel },
+    { 1, "cache", test_cache },
     { 0, NULL, NULL }
 };
 
@@ -423,6 +771,33 @@ void test_parse_xpm(bs_test_t *test_ptr)
     BS_TEST_VERIFY_EQ(test_ptr, 0xff000000, *bs_gfxbuf_pixel_at(buf_ptr, 1, 2));
     BS_TEST_VERIFY_EQ(test_ptr, 42, *bs_gfxbuf_pixel_at(buf_ptr, 2, 2));
 
+    // Partly outside: Clipped to the buffer.
+    bs_gfxbuf_clear(buf_ptr, 42);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        _bs_gfxbuf_xpm_copy_data(buf_ptr, test_xpm_data, 2, 2));
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff0000ff, *bs_gfxbuf_pixel_at(buf_ptr, 2, 2));
+    BS_TEST_VERIFY_EQ(test_ptr, 42, *bs_gfxbuf_pixel_at(buf_ptr, 1, 2));
+    BS_TEST_VERIFY_EQ(test_ptr, 42, *bs_gfxbuf_pixel_at(buf_ptr, 2, 1));
+
+    // Fully outside, at and beyond the edge: Draws nothing.
+    bs_gfxbuf_clear(buf_ptr, 42);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        _bs_gfxbuf_xpm_copy_data(buf_ptr, test_xpm_data, 3, 0));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        _bs_gfxbuf_xpm_copy_data(buf_ptr, test_xpm_data, 5, 1));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        _bs_gfxbuf_xpm_copy_data(buf_ptr, test_xpm_data, 0, 3));
+    for (unsigned y = 0; y < 3; ++y) {
+        for (unsigned x = 0; x < 3; ++x) {
+            BS_TEST_VERIFY_EQ(
+                test_ptr, 42, *bs_gfxbuf_pixel_at(buf_ptr, x, y));
+        }
+    }
+
     bs_gfxbuf_destroy(buf_ptr);
 }
 
@@ -440,4 +815,208 @@ void test_create_xpm(bs_test_t *test_ptr)
     }
 }
 
+/* ------------------------------------------------------------------------- */
+/** Verifies direct and hashed lookups, and undefined pixels. */
+void test_chars_per_pixel(bs_test_t *test_ptr)
+{
+    static char *xpm_2cpp[] = {
+        "3 1 3 2",
+        "   c None",
+        "\xff\x01 c #0000ff",
+        "+. c #010203",
+        "+.\xff\x01  " };
+    static char *xpm_3cpp[] = {
+        "3 1 3 3",
+        "    c None",
+        "abc c #0000ff",
+        "abd c #010203",
+        "abdabc   " };
+    static char *xpm_undefined[] = {
+        "2 1 1 1",
+        ". c #0000ff",
+        ".x" };
+    bs_gfxbuf_t *buf_ptr;
+
+    buf_ptr = bs_gfxbuf_xpm_create_from_data(xpm_2cpp);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff010203, *bs_gfxbuf_pixel_at(buf_ptr, 0, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff0000ff, *bs_gfxbuf_pixel_at(buf_ptr, 1, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf_ptr, 2, 0));
+    bs_gfxbuf_destroy(buf_ptr);
+
+    buf_ptr = bs_gfxbuf_xpm_create_from_data(xpm_3cpp);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, buf_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff010203, *bs_gfxbuf_pixel_at(buf_ptr, 0, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0xff0000ff, *bs_gfxbuf_pixel_at(buf_ptr, 1, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, *bs_gfxbuf_pixel_at(buf_ptr, 2, 0));
+    bs_gfxbuf_destroy(buf_ptr);
+
+    BS_TEST_VERIFY_EQ(test_ptr, NULL,
+                      bs_gfxbuf_xpm_create_from_data(xpm_undefined));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies sharing, reference counting and LRU eviction of the cache. */
+void test_cache(bs_test_t *test_ptr)
+{
+    static char *xpm_other[] = {
+        "2 2 1 1",
+        ". c #00ff00",
+        "..",
+        ".." };
+    static char *xpm_third[] = {
+        "2 2 1 1",
+        ". c #ff0000",
+        "..",
+        ".." };
+    const bs_gfxbuf_t *buf1_ptr, *buf2_ptr, *buf3_ptr;
+
+    // Budget for exactly two 2x2 images.
+    bs_gfxbuf_xpm_cache_t *cache_ptr = bs_gfxbuf_xpm_cache_create(32);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, cache_ptr);
+
+    buf1_ptr = bs_gfxbuf_xpm_cache_acquire(cache_ptr, test_xpm_data);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, buf1_ptr);
+    BS_TEST_VERIFY_EQ(
+        test_ptr, buf1_ptr,
+        bs_gfxbuf_xpm_cache_acquire(cache_ptr, test_xpm_data));
+    BS_TEST_VERIFY_EQ(test_ptr, 16, bs_gfxbuf_xpm_cache_bytes(cache_ptr));
+    bs_gfxbuf_xpm_cache_release(cache_ptr, buf1_ptr);
+    bs_gfxbuf_xpm_cache_release(cache_ptr, buf1_ptr);
+
+    // Unreferenced, but within budget: Remains cached.
+    buf2_ptr = bs_gfxbuf_xpm_cache_acquire(cache_ptr, xpm_other);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, buf2_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 32, bs_gfxbuf_xpm_cache_bytes(cache_ptr));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, buf1_ptr,
+        bs_gfxbuf_xpm_cache_acquire(cache_ptr, test_xpm_data));
+    bs_gfxbuf_xpm_cache_release(cache_ptr, buf1_ptr);
+    bs_gfxbuf_xpm_cache_release(cache_ptr, buf2_ptr);
+
+    // Exceeding the budget evicts the least recently used: test_xpm_data.
+    buf3_ptr = bs_gfxbuf_xpm_cache_acquire(cache_ptr, xpm_third);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, buf3_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0xffff0000, buf3_ptr->data_ptr[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, 32, bs_gfxbuf_xpm_cache_bytes(cache_ptr));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, buf2_ptr,
+        bs_gfxbuf_xpm_cache_acquire(cache_ptr, xpm_other));
+
+    // Referenced entries are kept, even when exceeding the budget.
+    buf1_ptr = bs_gfxbuf_xpm_cache_acquire(cache_ptr, test_xpm_data);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, buf1_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 48, bs_gfxbuf_xpm_cache_bytes(cache_ptr));
+    bs_gfxbuf_xpm_cache_release(cache_ptr, buf3_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 32, bs_gfxbuf_xpm_cache_bytes(cache_ptr));
+
+    bs_gfxbuf_xpm_cache_release(cache_ptr, buf1_ptr);
+    bs_gfxbuf_xpm_cache_release(cache_ptr, buf2_ptr);
+    bs_gfxbuf_xpm_cache_destroy(cache_ptr);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_load_1cpp(bs_test_t *test_ptr);
+static void benchmark_load_2cpp(bs_test_t *test_ptr);
+static void benchmark_load_3cpp(bs_test_t *test_ptr);
+
+/* set benchmarks to last for 2.5s each */
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t          bs_gfxbuf_xpm_benchmarks[] = {
+    { 1, "benchmark-load-1cpp-64colors", benchmark_load_1cpp },
+    { 1, "benchmark-load-2cpp-4096colors", benchmark_load_2cpp },
+    { 1, "benchmark-load-3cpp-65536colors", benchmark_load_3cpp },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Generates XPM data of `size` x `size` pixels, with `colors` colors and
+ * `chars_per_pixel` characters per pixel, and benchmarks loading it.
+ */
+static void _benchmark_load(bs_test_t *test_ptr,
+                            unsigned size,
+                            unsigned colors,
+                            unsigned chars_per_pixel)
+{
+    static const char chars[] =
+        "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.+";
+    char **xpm_ptr = logged_calloc(1 + colors + size, sizeof(char*));
+    if (NULL == xpm_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed logged_calloc(%u, %zu)",
+                     1 + colors + size, sizeof(char*));
+        return;
+    }
+    char *lines_ptr = logged_calloc(1 + colors + size,
+                                    size * chars_per_pixel + 32);
+    if (NULL == lines_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed logged_calloc(%u, %u)",
+                     1 + colors + size, size * chars_per_pixel + 32);
+        logged_free(xpm_ptr);
+        return;
+    }
+    for (unsigned i = 0; i < 1 + colors + size; ++i) {
+        xpm_ptr[i] = lines_ptr + i * (size * chars_per_pixel + 32);
+    }
+
+    // Header, colors, and pixels. Characters encode the color index, base 64.
+    snprintf(xpm_ptr[0], 32, "%u %u %u %u",
+             size, size, colors, chars_per_pixel);
+    for (unsigned c = 0; c < colors; ++c) {
+        char *p = xpm_ptr[1 + c];
+        for (unsigned i = 0, v = c; i < chars_per_pixel; ++i, v /= 64) {
+            *p++ = chars[v % 64];
+        }
+        snprintf(p, 32, " c #%06x", c * 0x0f0f0f % 0x1000000);
+    }
+    for (unsigned y = 0; y < size; ++y) {
+        char *p = xpm_ptr[1 + colors + y];
+        for (unsigned x = 0; x < size; ++x) {
+            unsigned c = (x * 31 + y * 17) % colors;
+            for (unsigned i = 0, v = c; i < chars_per_pixel; ++i, v /= 64) {
+                *p++ = chars[v % 64];
+            }
+        }
+    }
+
+    uint64_t usec = bs_fast_usec();
+    unsigned iterations = 0;
+    while (usec + benchmark_duration >= bs_fast_usec()) {
+        bs_gfxbuf_t *buf_ptr = bs_gfxbuf_xpm_create_from_data(xpm_ptr);
+        if (NULL == buf_ptr) {
+            BS_TEST_FAIL(test_ptr, "Failed bs_gfxbuf_xpm_create_from_data");
+            break;
+        }
+        bs_gfxbuf_destroy(buf_ptr);
+        iterations++;
+    }
+    usec = bs_fast_usec() - usec;
+
+    bs_test_succeed(test_ptr, "%ux%u, %u colors: %.3e pix/sec",
+                    size, size, colors,
+                    (double)iterations * size * size / (usec * 1e-6));
+    logged_free(lines_ptr);
+    logged_free(xpm_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_load_1cpp(bs_test_t *test_ptr)
+{
+    _benchmark_load(test_ptr, 512, 64, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_load_2cpp(bs_test_t *test_ptr)
+{
+    _benchmark_load(test_ptr, 512, 4096, 2);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_load_3cpp(bs_test_t *test_ptr)
+{
+    _benchmark_load(test_ptr, 512, 65536, 3);
+}
+
 /* == End of gfxbuf_xpm.c ================================================== */
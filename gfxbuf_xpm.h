@@ -37,9 +37,70 @@ extern "C" {
  */
 bs_gfxbuf_t *bs_gfxbuf_xpm_create_from_data(char **xpm_data_ptr);
 
+/**
+ * A cache of decoded XPM images, keyed by the XPM data pointer.
+ *
+ * Images are shared and reference-counted: Each successful
+ * @ref bs_gfxbuf_xpm_cache_acquire must be balanced by a call to
+ * @ref bs_gfxbuf_xpm_cache_release. Unreferenced images are kept until the
+ * cache exceeds its byte budget, and are then evicted least-recently-used
+ * first. Images that are still referenced are never evicted.
+ *
+ * The cache is not thread-safe.
+ */
+typedef struct _bs_gfxbuf_xpm_cache_t bs_gfxbuf_xpm_cache_t;
+
+/**
+ * Creates a cache for decoded XPM images.
+ *
+ * @param max_bytes           Budget for pixel storage of the cached images.
+ *
+ * @return A pointer to the cache, or NULL on error. Must be destroyed by
+ *     calling @ref bs_gfxbuf_xpm_cache_destroy.
+ */
+bs_gfxbuf_xpm_cache_t *bs_gfxbuf_xpm_cache_create(size_t max_bytes);
+
+/**
+ * Destroys the cache and all images in it. All acquired images must have
+ * been released before.
+ *
+ * @param cache_ptr
+ */
+void bs_gfxbuf_xpm_cache_destroy(bs_gfxbuf_xpm_cache_t *cache_ptr);
+
+/**
+ * Acquires the decoded image for `xpm_data_ptr`. Decodes the XPM only if it
+ * is not already in the cache.
+ *
+ * @param cache_ptr
+ * @param xpm_data_ptr        The XPM data. Must remain valid and unchanged
+ *                            for the lifetime of the cache.
+ *
+ * @return The shared image, or NULL on error. The image must not be
+ *     modified nor destroyed. Release it by @ref bs_gfxbuf_xpm_cache_release.
+ */
+const bs_gfxbuf_t *bs_gfxbuf_xpm_cache_acquire(
+    bs_gfxbuf_xpm_cache_t *cache_ptr,
+    char **xpm_data_ptr);
+
+/**
+ * Releases a reference on an image acquired from the cache.
+ *
+ * @param cache_ptr
+ * @param gfxbuf_ptr          As returned by @ref bs_gfxbuf_xpm_cache_acquire.
+ */
+void bs_gfxbuf_xpm_cache_release(bs_gfxbuf_xpm_cache_t *cache_ptr,
+                                 const bs_gfxbuf_t *gfxbuf_ptr);
+
+/** Returns the number of bytes held by images in the cache. */
+size_t bs_gfxbuf_xpm_cache_bytes(const bs_gfxbuf_xpm_cache_t *cache_ptr);
+
 /** Unit test cases. */
 extern const bs_test_case_t bs_gfxbuf_xpm_test_cases[];
 
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t bs_gfxbuf_xpm_benchmarks[];
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
@@ -0,0 +1,676 @@
+/* ========================================================================= */
+/**
+ * @file hashmap.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hashmap.h"
+
+#include "avltree.h"
+#include "def.h"
+#include "log_wrappers.h"
+#include "time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* == Declarations ========================================================= */
+
+/** A table of buckets. */
+typedef struct {
+    /** The buckets: Each is a singly-linked list of nodes. */
+    bs_hashmap_node_t         **buckets_ptr;
+    /** Number of buckets, minus 1. The number of buckets is a power of 2. */
+    size_t                    mask;
+    /** Hash bits to shift away, for mapping to a bucket. */
+    unsigned                  shift;
+} bs_hashmap_table_t;
+
+/**
+ * @private State of the hash map.
+ *
+ * When growing, nodes are migrated from `old_table` to `table` a few buckets
+ * at a time, on each insert and delete. Until done, lookups search both.
+ */
+struct _bs_hashmap_t {
+    /** The current table. New nodes are inserted here. */
+    bs_hashmap_table_t        table;
+    /** The table being migrated from. `buckets_ptr` is NULL if none. */
+    bs_hashmap_table_t        old_table;
+    /** Next bucket of `old_table` to migrate. */
+    size_t                    migrate_pos;
+    /** Number of nodes stored in this hash map. */
+    size_t                    nodes;
+    /** Points to the method for hashing keys. */
+    bs_hashmap_hash_t         hash;
+    /** Points to the method for comparing nodes with keys. */
+    bs_hashmap_node_equals_t  equals;
+    /** Points to the method for destroying a node. May be NULL. */
+    bs_hashmap_node_destroy_t destroy;
+};
+
+/** Initial number of buckets. */
+static const size_t           _bs_hashmap_initial_buckets = 16;
+/** Number of buckets migrated on each insert and delete, while growing. */
+static const size_t           _bs_hashmap_migrate_buckets = 4;
+
+static bool _bs_hashmap_table_init(bs_hashmap_table_t *table_ptr,
+                                   size_t buckets);
+static size_t _bs_hashmap_table_index(const bs_hashmap_table_t *table_ptr,
+                                      uint64_t hash);
+static bs_hashmap_node_t **_bs_hashmap_table_find(
+    const bs_hashmap_t *hashmap_ptr,
+    const bs_hashmap_table_t *table_ptr,
+    const void *key_ptr,
+    uint64_t hash);
+static bs_hashmap_node_t **_bs_hashmap_table_find_node(
+    const bs_hashmap_table_t *table_ptr,
+    const bs_hashmap_node_t *node_ptr);
+static bs_hashmap_node_t **_bs_hashmap_find(const bs_hashmap_t *hashmap_ptr,
+                                            const void *key_ptr,
+                                            uint64_t hash);
+static void _bs_hashmap_migrate(bs_hashmap_t *hashmap_ptr, size_t buckets);
+static void _bs_hashmap_grow(bs_hashmap_t *hashmap_ptr);
+static void _bs_hashmap_table_for_each(
+    const bs_hashmap_table_t *table_ptr,
+    size_t first_bucket,
+    void (*func)(bs_hashmap_node_t *node_ptr, void *ud_ptr),
+    void *ud_ptr);
+static void _bs_hashmap_destroy_node(bs_hashmap_node_t *node_ptr,
+                                     void *ud_ptr);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_hashmap_t *bs_hashmap_create(bs_hashmap_hash_t hash,
+                                bs_hashmap_node_equals_t equals,
+                                bs_hashmap_node_destroy_t destroy)
+{
+    bs_hashmap_t *hashmap_ptr = logged_calloc(1, sizeof(bs_hashmap_t));
+    if (NULL == hashmap_ptr) return NULL;
+    hashmap_ptr->hash = hash;
+    hashmap_ptr->equals = equals;
+    hashmap_ptr->destroy = destroy;
+
+    if (!_bs_hashmap_table_init(&hashmap_ptr->table,
+                                _bs_hashmap_initial_buckets)) {
+        bs_hashmap_destroy(hashmap_ptr);
+        return NULL;
+    }
+    return hashmap_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_hashmap_destroy(bs_hashmap_t *hashmap_ptr)
+{
+    if (NULL != hashmap_ptr->destroy) {
+        bs_hashmap_for_each(hashmap_ptr, _bs_hashmap_destroy_node,
+                            hashmap_ptr);
+    }
+    if (NULL != hashmap_ptr->old_table.buckets_ptr) {
+        logged_free(hashmap_ptr->old_table.buckets_ptr);
+        hashmap_ptr->old_table.buckets_ptr = NULL;
+    }
+    if (NULL != hashmap_ptr->table.buckets_ptr) {
+        logged_free(hashmap_ptr->table.buckets_ptr);
+        hashmap_ptr->table.buckets_ptr = NULL;
+    }
+    logged_free(hashmap_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bs_hashmap_node_t *bs_hashmap_lookup(const bs_hashmap_t *hashmap_ptr,
+                                     const void *key_ptr)
+{
+    bs_hashmap_node_t **link_ptr_ptr = _bs_hashmap_find(
+        hashmap_ptr, key_ptr, hashmap_ptr->hash(key_ptr));
+    return NULL != link_ptr_ptr ? *link_ptr_ptr : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_hashmap_insert(bs_hashmap_t *hashmap_ptr,
+                       const void *key_ptr,
+                       bs_hashmap_node_t *node_ptr,
+                       bool do_overwrite)
+{
+    _bs_hashmap_migrate(hashmap_ptr, _bs_hashmap_migrate_buckets);
+
+    node_ptr->hash = hashmap_ptr->hash(key_ptr);
+    bs_hashmap_node_t **link_ptr_ptr = _bs_hashmap_find(
+        hashmap_ptr, key_ptr, node_ptr->hash);
+    if (NULL != link_ptr_ptr) {
+        if (!do_overwrite) return false;
+        bs_hashmap_node_t *old_node_ptr = *link_ptr_ptr;
+        node_ptr->next_ptr = old_node_ptr->next_ptr;
+        *link_ptr_ptr = node_ptr;
+        if (NULL != hashmap_ptr->destroy) hashmap_ptr->destroy(old_node_ptr);
+        return true;
+    }
+
+    size_t idx = _bs_hashmap_table_index(&hashmap_ptr->table, node_ptr->hash);
+    node_ptr->next_ptr = hashmap_ptr->table.buckets_ptr[idx];
+    hashmap_ptr->table.buckets_ptr[idx] = node_ptr;
+    hashmap_ptr->nodes++;
+
+    // Grows beyond an average of one node per bucket.
+    if (hashmap_ptr->nodes > hashmap_ptr->table.mask + 1) {
+        _bs_hashmap_grow(hashmap_ptr);
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bs_hashmap_node_t *bs_hashmap_delete(bs_hashmap_t *hashmap_ptr,
+                                     const void *key_ptr)
+{
+    _bs_hashmap_migrate(hashmap_ptr, _bs_hashmap_migrate_buckets);
+
+    bs_hashmap_node_t **link_ptr_ptr = _bs_hashmap_find(
+        hashmap_ptr, key_ptr, hashmap_ptr->hash(key_ptr));
+    if (NULL == link_ptr_ptr) return NULL;
+
+    bs_hashmap_node_t *node_ptr = *link_ptr_ptr;
+    *link_ptr_ptr = node_ptr->next_ptr;
+    node_ptr->next_ptr = NULL;
+    hashmap_ptr->nodes--;
+    return node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_hashmap_remove_node(bs_hashmap_t *hashmap_ptr,
+                            bs_hashmap_node_t *node_ptr)
+{
+    _bs_hashmap_migrate(hashmap_ptr, _bs_hashmap_migrate_buckets);
+
+    bs_hashmap_node_t **link_ptr_ptr = _bs_hashmap_table_find_node(
+        &hashmap_ptr->table, node_ptr);
+    if (NULL == link_ptr_ptr && NULL != hashmap_ptr->old_table.buckets_ptr) {
+        link_ptr_ptr = _bs_hashmap_table_find_node(
+            &hashmap_ptr->old_table, node_ptr);
+    }
+    if (NULL == link_ptr_ptr) return false;
+
+    *link_ptr_ptr = node_ptr->next_ptr;
+    node_ptr->next_ptr = NULL;
+    hashmap_ptr->nodes--;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_hashmap_size(const bs_hashmap_t *hashmap_ptr)
+{
+    return hashmap_ptr->nodes;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_hashmap_for_each(
+    const bs_hashmap_t *hashmap_ptr,
+    void (*func)(bs_hashmap_node_t *node_ptr, void *ud_ptr),
+    void *ud_ptr)
+{
+    if (NULL != hashmap_ptr->old_table.buckets_ptr) {
+        _bs_hashmap_table_for_each(&hashmap_ptr->old_table,
+                                   hashmap_ptr->migrate_pos, func, ud_ptr);
+    }
+    _bs_hashmap_table_for_each(&hashmap_ptr->table, 0, func, ud_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t bs_hashmap_hash_str(const void *key_ptr)
+{
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for (const unsigned char *c_ptr = key_ptr; *c_ptr; ++c_ptr) {
+        hash = (hash ^ *c_ptr) * UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t bs_hashmap_hash_ptr(const void *key_ptr)
+{
+    // Buckets are taken from the high bits of the multiplied hash, hence the
+    // pointer value itself is a suitable hash.
+    return (uintptr_t)key_ptr;
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Allocates `buckets` (a power of 2) empty buckets for `table_ptr`. */
+bool _bs_hashmap_table_init(bs_hashmap_table_t *table_ptr, size_t buckets)
+{
+    table_ptr->buckets_ptr = logged_calloc(buckets, sizeof(bs_hashmap_node_t*));
+    if (NULL == table_ptr->buckets_ptr) return false;
+    table_ptr->mask = buckets - 1;
+    table_ptr->shift = 64;
+    for (size_t b = buckets; 1 < b; b >>= 1) table_ptr->shift--;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns the bucket for `hash`. Multiplies by 2^64 / phi and takes the high
+ * bits, so that weak hashes (eg. aligned pointers) still spread well.
+ */
+size_t _bs_hashmap_table_index(const bs_hashmap_table_t *table_ptr,
+                               uint64_t hash)
+{
+    // Shifting a uint64_t by 64 is undefined: A single bucket has shift 64.
+    if (0 == table_ptr->mask) return 0;
+    return (hash * UINT64_C(0x9e3779b97f4a7c15)) >> table_ptr->shift;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Finds the node matching `key_ptr` within `table_ptr`.
+ *
+ * @return Pointer to the link pointing to the node, ie. the bucket or the
+ *     previous node's `next_ptr`. NULL if not found.
+ */
+bs_hashmap_node_t **_bs_hashmap_table_find(
+    const bs_hashmap_t *hashmap_ptr,
+    const bs_hashmap_table_t *table_ptr,
+    const void *key_ptr,
+    uint64_t hash)
+{
+    bs_hashmap_node_t **link_ptr_ptr =
+        &table_ptr->buckets_ptr[_bs_hashmap_table_index(table_ptr, hash)];
+    for (; NULL != *link_ptr_ptr; link_ptr_ptr = &(*link_ptr_ptr)->next_ptr) {
+        if ((*link_ptr_ptr)->hash == hash &&
+            hashmap_ptr->equals(*link_ptr_ptr, key_ptr)) return link_ptr_ptr;
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Finds `node_ptr` itself within `table_ptr`, through its cached hash.
+ *
+ * @return Pointer to the link pointing to the node. NULL if not found.
+ */
+bs_hashmap_node_t **_bs_hashmap_table_find_node(
+    const bs_hashmap_table_t *table_ptr,
+    const bs_hashmap_node_t *node_ptr)
+{
+    bs_hashmap_node_t **link_ptr_ptr = &table_ptr->buckets_ptr[
+        _bs_hashmap_table_index(table_ptr, node_ptr->hash)];
+    for (; NULL != *link_ptr_ptr; link_ptr_ptr = &(*link_ptr_ptr)->next_ptr) {
+        if (*link_ptr_ptr == node_ptr) return link_ptr_ptr;
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Finds the node matching `key_ptr`, in both tables. */
+bs_hashmap_node_t **_bs_hashmap_find(const bs_hashmap_t *hashmap_ptr,
+                                     const void *key_ptr,
+                                     uint64_t hash)
+{
+    bs_hashmap_node_t **link_ptr_ptr = _bs_hashmap_table_find(
+        hashmap_ptr, &hashmap_ptr->table, key_ptr, hash);
+    if (NULL == link_ptr_ptr && NULL != hashmap_ptr->old_table.buckets_ptr) {
+        link_ptr_ptr = _bs_hashmap_table_find(
+            hashmap_ptr, &hashmap_ptr->old_table, key_ptr, hash);
+    }
+    return link_ptr_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Migrates up to `buckets` buckets from the old to the current table. Frees
+ * the old table, once all buckets are migrated.
+ */
+void _bs_hashmap_migrate(bs_hashmap_t *hashmap_ptr, size_t buckets)
+{
+    bs_hashmap_table_t *old_table_ptr = &hashmap_ptr->old_table;
+    for (; 0 < buckets && NULL != old_table_ptr->buckets_ptr; --buckets) {
+        bs_hashmap_node_t *node_ptr =
+            old_table_ptr->buckets_ptr[hashmap_ptr->migrate_pos];
+        while (NULL != node_ptr) {
+            bs_hashmap_node_t *next_node_ptr = node_ptr->next_ptr;
+            size_t idx = _bs_hashmap_table_index(
+                &hashmap_ptr->table, node_ptr->hash);
+            node_ptr->next_ptr = hashmap_ptr->table.buckets_ptr[idx];
+            hashmap_ptr->table.buckets_ptr[idx] = node_ptr;
+            node_ptr = next_node_ptr;
+        }
+        old_table_ptr->buckets_ptr[hashmap_ptr->migrate_pos] = NULL;
+
+        if (++hashmap_ptr->migrate_pos > old_table_ptr->mask) {
+            logged_free(old_table_ptr->buckets_ptr);
+            old_table_ptr->buckets_ptr = NULL;
+            hashmap_ptr->migrate_pos = 0;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Starts growing to twice the number of buckets. A still-ongoing migration
+ * is completed first. On allocation failure, the map just stays at its size.
+ */
+void _bs_hashmap_grow(bs_hashmap_t *hashmap_ptr)
+{
+    _bs_hashmap_migrate(hashmap_ptr, SIZE_MAX);
+
+    bs_hashmap_table_t table;
+    if (!_bs_hashmap_table_init(&table, 2 * (hashmap_ptr->table.mask + 1))) {
+        return;
+    }
+    hashmap_ptr->old_table = hashmap_ptr->table;
+    hashmap_ptr->table = table;
+    hashmap_ptr->migrate_pos = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Calls `func` for all nodes of `table_ptr`, from `first_bucket` on. */
+void _bs_hashmap_table_for_each(
+    const bs_hashmap_table_t *table_ptr,
+    size_t first_bucket,
+    void (*func)(bs_hashmap_node_t *node_ptr, void *ud_ptr),
+    void *ud_ptr)
+{
+    for (size_t idx = first_bucket; idx <= table_ptr->mask; ++idx) {
+        bs_hashmap_node_t *node_ptr = table_ptr->buckets_ptr[idx];
+        while (NULL != node_ptr) {
+            bs_hashmap_node_t *next_node_ptr = node_ptr->next_ptr;
+            func(node_ptr, ud_ptr);
+            node_ptr = next_node_ptr;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Callback for @ref bs_hashmap_for_each: Destroys the node. Safe, since the
+ * iterator keeps hold of the next node before calling.
+ */
+void _bs_hashmap_destroy_node(bs_hashmap_node_t *node_ptr, void *ud_ptr)
+{
+    bs_hashmap_t *hashmap_ptr = ud_ptr;
+    hashmap_ptr->destroy(node_ptr);
+}
+
+/* == Test Functions ======================================================= */
+
+/** Test element: A string key with an embedded hash map node. */
+typedef struct {
+    /** The hash map node. */
+    bs_hashmap_node_t         node;
+    /** The key. */
+    char                      key[24];
+    /** Points to a counter, incremented on destruction. Or NULL. */
+    int                       *destroyed_ptr;
+} test_elem_t;
+
+/* ------------------------------------------------------------------------- */
+static bool test_elem_equals(const bs_hashmap_node_t *node_ptr,
+                             const void *key_ptr)
+{
+    const test_elem_t *elem_ptr = BS_CONTAINER_OF(
+        node_ptr, const test_elem_t, node);
+    return 0 == strcmp(elem_ptr->key, key_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+static void test_elem_destroy(bs_hashmap_node_t *node_ptr)
+{
+    test_elem_t *elem_ptr = BS_CONTAINER_OF(node_ptr, test_elem_t, node);
+    if (NULL != elem_ptr->destroyed_ptr) ++*elem_ptr->destroyed_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+static void test_elem_count(__UNUSED__ bs_hashmap_node_t *node_ptr,
+                            void *ud_ptr)
+{
+    ++*(size_t*)ud_ptr;
+}
+
+static void test_basic(bs_test_t *test_ptr);
+static void test_grow(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_hashmap_test_cases[] = {
+    { 1, "basic", test_basic },
+    { 1, "grow", test_grow },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Verifies insert, overwrite, lookup and delete. */
+void test_basic(bs_test_t *test_ptr)
+{
+    int destroyed = 0;
+    test_elem_t e1 = { .key = "one", .destroyed_ptr = &destroyed };
+    test_elem_t e2 = { .key = "two", .destroyed_ptr = &destroyed };
+    test_elem_t e1b = { .key = "one", .destroyed_ptr = &destroyed };
+
+    bs_hashmap_t *hashmap_ptr = bs_hashmap_create(
+        bs_hashmap_hash_str, test_elem_equals, test_elem_destroy);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, hashmap_ptr);
+
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_hashmap_lookup(hashmap_ptr, "one"));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_hashmap_insert(hashmap_ptr, e1.key, &e1.node, false));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_hashmap_insert(hashmap_ptr, e2.key, &e2.node, false));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, bs_hashmap_size(hashmap_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, &e1.node,
+                      bs_hashmap_lookup(hashmap_ptr, "one"));
+    BS_TEST_VERIFY_EQ(test_ptr, &e2.node,
+                      bs_hashmap_lookup(hashmap_ptr, "two"));
+
+    // Without overwrite, fails. With overwrite, destroys the former node.
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_hashmap_insert(hashmap_ptr, e1b.key, &e1b.node, false));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, destroyed);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_hashmap_insert(hashmap_ptr, e1b.key, &e1b.node, true));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, destroyed);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, bs_hashmap_size(hashmap_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, &e1b.node,
+                      bs_hashmap_lookup(hashmap_ptr, "one"));
+
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_hashmap_delete(hashmap_ptr, "three"));
+    BS_TEST_VERIFY_EQ(test_ptr, &e2.node,
+                      bs_hashmap_delete(hashmap_ptr, "two"));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_hashmap_lookup(hashmap_ptr, "two"));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_hashmap_size(hashmap_ptr));
+
+    // Removing by node: Only the node itself, not one of an equal key.
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_hashmap_remove_node(hashmap_ptr, &e1.node));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_hashmap_insert(
+                            hashmap_ptr, e2.key, &e2.node, false));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_hashmap_remove_node(hashmap_ptr, &e2.node));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_hashmap_lookup(hashmap_ptr, "two"));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_hashmap_size(hashmap_ptr));
+
+    bs_hashmap_destroy(hashmap_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, destroyed);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies all nodes remain accessible while growing incrementally. */
+void test_grow(bs_test_t *test_ptr)
+{
+    static const size_t n = 3000;
+    test_elem_t *elems_ptr = logged_calloc(n, sizeof(test_elem_t));
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, elems_ptr);
+    bs_hashmap_t *hashmap_ptr = bs_hashmap_create(
+        bs_hashmap_hash_str, test_elem_equals, NULL);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, hashmap_ptr);
+
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(elems_ptr[i].key, sizeof(elems_ptr[i].key), "key%zu", i);
+        BS_TEST_VERIFY_TRUE(
+            test_ptr, bs_hashmap_insert(hashmap_ptr, elems_ptr[i].key,
+                                        &elems_ptr[i].node, false));
+        // Checks a sample of earlier nodes, spanning both tables.
+        for (size_t j = 0; j <= i; j += 1 + i / 8) {
+            if (&elems_ptr[j].node !=
+                bs_hashmap_lookup(hashmap_ptr, elems_ptr[j].key)) {
+                BS_TEST_FAIL(test_ptr, "Lost %s after inserting %s",
+                             elems_ptr[j].key, elems_ptr[i].key);
+                break;
+            }
+        }
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, n, bs_hashmap_size(hashmap_ptr));
+    size_t count = 0;
+    bs_hashmap_for_each(hashmap_ptr, test_elem_count, &count);
+    BS_TEST_VERIFY_EQ(test_ptr, n, count);
+
+    for (size_t i = 0; i < n; i += 2) {
+        BS_TEST_VERIFY_EQ(test_ptr, &elems_ptr[i].node,
+                          bs_hashmap_delete(hashmap_ptr, elems_ptr[i].key));
+    }
+    for (size_t i = 0; i < n; ++i) {
+        bs_hashmap_node_t *node_ptr = bs_hashmap_lookup(
+            hashmap_ptr, elems_ptr[i].key);
+        if ((i % 2 ? &elems_ptr[i].node : NULL) != node_ptr) {
+            BS_TEST_FAIL(test_ptr, "Unexpected lookup(%s)", elems_ptr[i].key);
+            break;
+        }
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, n / 2, bs_hashmap_size(hashmap_ptr));
+
+    bs_hashmap_destroy(hashmap_ptr);
+    logged_free(elems_ptr);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_hashmap(bs_test_t *test_ptr);
+static void benchmark_avltree(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t          bs_hashmap_benchmarks[] = {
+    { 1, "benchmark-hashmap-str", benchmark_hashmap },
+    { 1, "benchmark-avltree-str", benchmark_avltree },
+    { 0, NULL, NULL }
+};
+
+/** Number of elements in the benchmarks. */
+#define _BENCHMARK_ELEMENTS   16384
+
+/** Element for the benchmarks, embeddable in either container. */
+typedef struct {
+    /** For the hash map. */
+    bs_hashmap_node_t         node;
+    /** For the AVL tree. */
+    bs_avltree_node_t         avlnode;
+    /** The key. */
+    char                      key[24];
+} _benchmark_elem_t;
+
+/* ------------------------------------------------------------------------- */
+static int _benchmark_avltree_cmp(const bs_avltree_node_t *node_ptr,
+                                  const void *key_ptr)
+{
+    const _benchmark_elem_t *elem_ptr = BS_CONTAINER_OF(
+        node_ptr, const _benchmark_elem_t, avlnode);
+    return strcmp(elem_ptr->key, key_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+static bool _benchmark_hashmap_equals(const bs_hashmap_node_t *node_ptr,
+                                      const void *key_ptr)
+{
+    const _benchmark_elem_t *elem_ptr = BS_CONTAINER_OF(
+        node_ptr, const _benchmark_elem_t, node);
+    return 0 == strcmp(elem_ptr->key, key_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Inserts @ref _BENCHMARK_ELEMENTS string-keyed elements, looks up each of
+ * them once, and deletes all. Into the hash map, or into an AVL tree.
+ */
+static void _benchmark(bs_test_t *test_ptr, bool use_hashmap)
+{
+    _benchmark_elem_t *elems_ptr = logged_calloc(
+        _BENCHMARK_ELEMENTS, sizeof(_benchmark_elem_t));
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, elems_ptr);
+    for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+        snprintf(elems_ptr[i].key, sizeof(elems_ptr[i].key), "elem%zu", i);
+    }
+
+    uint64_t iterations = 0;
+    uint64_t usec = bs_usec();
+    while (usec + benchmark_duration >= bs_usec()) {
+        size_t found = 0;
+        if (use_hashmap) {
+            bs_hashmap_t *hashmap_ptr = bs_hashmap_create(
+                bs_hashmap_hash_str, _benchmark_hashmap_equals, NULL);
+            if (NULL == hashmap_ptr) break;
+            for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+                bs_hashmap_insert(hashmap_ptr, elems_ptr[i].key,
+                                  &elems_ptr[i].node, false);
+            }
+            for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+                found += NULL != bs_hashmap_lookup(hashmap_ptr,
+                                                   elems_ptr[i].key);
+            }
+            for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+                bs_hashmap_delete(hashmap_ptr, elems_ptr[i].key);
+            }
+            bs_hashmap_destroy(hashmap_ptr);
+        } else {
+            bs_avltree_t *tree_ptr = bs_avltree_create(
+                _benchmark_avltree_cmp, NULL);
+            if (NULL == tree_ptr) break;
+            for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+                bs_avltree_insert(tree_ptr, elems_ptr[i].key,
+                                  &elems_ptr[i].avlnode, false);
+            }
+            for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+                found += NULL != bs_avltree_lookup(tree_ptr,
+                                                   elems_ptr[i].key);
+            }
+            for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+                bs_avltree_delete(tree_ptr, elems_ptr[i].key);
+            }
+            bs_avltree_destroy(tree_ptr);
+        }
+        BS_TEST_VERIFY_EQ(test_ptr, (size_t)_BENCHMARK_ELEMENTS, found);
+        iterations++;
+    }
+    usec = bs_usec() - usec;
+
+    bs_test_succeed(test_ptr, "%d elements: %.3e ops/sec",
+                    _BENCHMARK_ELEMENTS,
+                    (double)iterations * 3 * _BENCHMARK_ELEMENTS /
+                    (usec * 1e-6));
+    logged_free(elems_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_hashmap(bs_test_t *test_ptr)
+{
+    _benchmark(test_ptr, true);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_avltree(bs_test_t *test_ptr)
+{
+    _benchmark(test_ptr, false);
+}
+
+/* == End of hashmap.c ===================================================== */
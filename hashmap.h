@@ -0,0 +1,177 @@
+/* ========================================================================= */
+/**
+ * @file hashmap.h
+ * Implements a hash map with separate chaining, with nodes provided such
+ * they can be embedded in the element's struct. Grows incrementally, to
+ * avoid latency spikes from re-hashing all nodes at once.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_HASHMAP_H__
+#define __LIBBASE_HASHMAP_H__
+
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** The hash map. */
+typedef struct _bs_hashmap_t bs_hashmap_t;
+/** A node of the hash map. */
+typedef struct _bs_hashmap_node_t bs_hashmap_node_t;
+
+/** Actual struct of the hash map node. */
+struct _bs_hashmap_node_t {
+    /** Next node in the same bucket. NULL if this is the last. */
+    bs_hashmap_node_t         *next_ptr;
+    /** Hash of the node's key. Cached, for growing and comparing. */
+    uint64_t                  hash;
+};
+
+/**
+ * Functor type to compute the hash of a key.
+ *
+ * @param key_ptr
+ *
+ * @return The hash. Equal keys must have equal hashes.
+ */
+typedef uint64_t (*bs_hashmap_hash_t)(const void *key_ptr);
+
+/**
+ * Functor type to compare a hash map node with a key.
+ *
+ * @param node_ptr
+ * @param key_ptr
+ *
+ * @return Whether the node's key equals `key_ptr`.
+ */
+typedef bool (*bs_hashmap_node_equals_t)(const bs_hashmap_node_t *node_ptr,
+                                         const void *key_ptr);
+
+/**
+ * Functor type to destroy a hash map node.
+ *
+ * @param node_ptr
+ */
+typedef void (*bs_hashmap_node_destroy_t)(bs_hashmap_node_t *node_ptr);
+
+/**
+ * Creates a hash map.
+ *
+ * @param hash
+ * @param equals
+ * @param destroy Optionally, a functor to destroy nodes. If destroy is NULL,
+ *     the map will not destroy any nodes when overwriting or destroying.
+ *
+ * @return A pointer to the hash map, or NULL on error.
+ */
+bs_hashmap_t *bs_hashmap_create(bs_hashmap_hash_t hash,
+                                bs_hashmap_node_equals_t equals,
+                                bs_hashmap_node_destroy_t destroy);
+
+/**
+ * Destroys the hash map. Also destroys all remaining elements.
+ *
+ * @param hashmap_ptr
+ */
+void bs_hashmap_destroy(bs_hashmap_t *hashmap_ptr);
+
+/** Returns the node matching `key_ptr` in the hash map, or NULL. */
+bs_hashmap_node_t *bs_hashmap_lookup(const bs_hashmap_t *hashmap_ptr,
+                                     const void *key_ptr);
+
+/**
+ * Inserts a node into the hash map.
+ *
+ * @param hashmap_ptr
+ * @param key_ptr The key for this node, required for insert.
+ * @param node_ptr The node.
+ * @param do_overwrite Whether to overwrite any already-existing node at the
+ *     specified `key_ptr`. The overwritten node will be destroyed, if a
+ *     destroy method was specified.
+ *
+ * @return Whether the insert succeeded. It can fail if `do_overwrite` is false
+ *     and a node at `key_ptr` already exists.
+ */
+bool bs_hashmap_insert(bs_hashmap_t *hashmap_ptr,
+                       const void *key_ptr,
+                       bs_hashmap_node_t *node_ptr,
+                       bool do_overwrite);
+
+/**
+ * Deletes a node from the hash map.
+ *
+ * @param hashmap_ptr
+ * @param key_ptr The key for the node that is to be deleted from the map.
+ *
+ * @return A pointer to the deleted node, or NULL if it was not found.
+ *     Note: The node will NOT be destroyed.
+ */
+bs_hashmap_node_t *bs_hashmap_delete(bs_hashmap_t *hashmap_ptr,
+                                     const void *key_ptr);
+
+/**
+ * Removes `node_ptr` from the hash map, without requiring its key. Useful
+ * when the node is reached otherwise, eg. from a list.
+ *
+ * @param hashmap_ptr
+ * @param node_ptr
+ *
+ * @return Whether `node_ptr` was in the map. It will NOT be destroyed.
+ */
+bool bs_hashmap_remove_node(bs_hashmap_t *hashmap_ptr,
+                            bs_hashmap_node_t *node_ptr);
+
+/** Returns the number of nodes in the hash map. */
+size_t bs_hashmap_size(const bs_hashmap_t *hashmap_ptr);
+
+/**
+ * Calls `func` for each node of the hash map, in no particular order.
+ *
+ * `func` must not modify the hash map.
+ *
+ * @param hashmap_ptr
+ * @param func
+ * @param ud_ptr
+ */
+void bs_hashmap_for_each(
+    const bs_hashmap_t *hashmap_ptr,
+    void (*func)(bs_hashmap_node_t *node_ptr, void *ud_ptr),
+    void *ud_ptr);
+
+/** Helper: Hash function for NUL-terminated strings, as keys. FNV-1a. */
+uint64_t bs_hashmap_hash_str(const void *key_ptr);
+
+/** Helper: Hash function for pointers, as keys. */
+uint64_t bs_hashmap_hash_ptr(const void *key_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_hashmap_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_hashmap_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_HASHMAP_H__ */
+/* == End of hashmap.h ===================================================== */
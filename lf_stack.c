@@ -0,0 +1,479 @@
+/* ========================================================================= */
+/**
+ * @file lf_stack.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lf_stack.h"
+
+#include "assert.h"
+#include "def.h"
+#include "log_wrappers.h"
+#include "ptr_stack.h"
+#include "thread.h"
+#include "time.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/* == Declarations ========================================================= */
+
+/**
+ * Bits of the tagged head that hold the node's address. User-space addresses
+ * fit into 48 bits on 64-bit platforms; the upper 16 bits hold the counter.
+ * On 32-bit platforms, the counter gets the upper 32 bits.
+ */
+#define _BS_LF_STACK_PTR_BITS (4 == sizeof(void*) ? 32 : 48)
+
+/** Mask for the address bits of the tagged head. */
+#define _BS_LF_STACK_PTR_MASK (((uint64_t)1 << _BS_LF_STACK_PTR_BITS) - 1)
+
+static bs_lf_stack_node_t *_bs_lf_stack_ptr(int64_t tagged);
+static int64_t _bs_lf_stack_tagged(bs_lf_stack_node_t *node_ptr,
+                                   int64_t prev_tagged);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+void bs_lf_stack_init(bs_lf_stack_t *stack_ptr)
+{
+    bs_atomic_int64_set(&stack_ptr->head, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_lf_stack_fini(bs_lf_stack_t *stack_ptr)
+{
+    if (NULL != _bs_lf_stack_ptr(bs_atomic_int64_get(&stack_ptr->head))) {
+        bs_log(BS_WARNING, "Finalizing non-empty lf_stack at %p", stack_ptr);
+    }
+    bs_atomic_int64_set(&stack_ptr->head, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_lf_stack_push(bs_lf_stack_t *stack_ptr, bs_lf_stack_node_t *node_ptr)
+{
+    BS_ASSERT(0 == ((uint64_t)(uintptr_t)node_ptr & ~_BS_LF_STACK_PTR_MASK));
+
+    int64_t head = bs_atomic_int64_get(&stack_ptr->head);
+    for (;;) {
+        bs_atomic_int64_set(&node_ptr->next,
+                            (intptr_t)_bs_lf_stack_ptr(head));
+        int64_t new_head = _bs_lf_stack_tagged(node_ptr, head);
+        int64_t prev = bs_atomic_int64_cas(&stack_ptr->head, new_head, head);
+        if (prev == head) return;
+        head = prev;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+bs_lf_stack_node_t *bs_lf_stack_pop(bs_lf_stack_t *stack_ptr)
+{
+    int64_t head = bs_atomic_int64_get(&stack_ptr->head);
+    for (;;) {
+        bs_lf_stack_node_t *node_ptr = _bs_lf_stack_ptr(head);
+        if (NULL == node_ptr) return NULL;
+
+        // `node_ptr` may have been popped by another thread meanwhile, making
+        // `next` stale. The counter in `head` then changed, and the CAS fails.
+        bs_lf_stack_node_t *next_ptr = bs_lf_stack_node_next(node_ptr);
+        int64_t new_head = _bs_lf_stack_tagged(next_ptr, head);
+        int64_t prev = bs_atomic_int64_cas(&stack_ptr->head, new_head, head);
+        if (prev == head) return node_ptr;
+        head = prev;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+bs_lf_stack_node_t *bs_lf_stack_pop_all(bs_lf_stack_t *stack_ptr)
+{
+    int64_t head = bs_atomic_int64_get(&stack_ptr->head);
+    for (;;) {
+        bs_lf_stack_node_t *node_ptr = _bs_lf_stack_ptr(head);
+        if (NULL == node_ptr) return NULL;
+
+        int64_t new_head = _bs_lf_stack_tagged(NULL, head);
+        int64_t prev = bs_atomic_int64_cas(&stack_ptr->head, new_head, head);
+        if (prev == head) return node_ptr;
+        head = prev;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+bs_lf_stack_node_t *bs_lf_stack_node_next(bs_lf_stack_node_t *node_ptr)
+{
+    return (bs_lf_stack_node_t*)(intptr_t)bs_atomic_int64_get(
+        &node_ptr->next);
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Returns the node pointer of the tagged head `tagged`. */
+bs_lf_stack_node_t *_bs_lf_stack_ptr(int64_t tagged)
+{
+    return (bs_lf_stack_node_t*)(uintptr_t)(
+        (uint64_t)tagged & _BS_LF_STACK_PTR_MASK);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns a tagged head for `node_ptr`, counting on from `prev_tagged`. */
+int64_t _bs_lf_stack_tagged(bs_lf_stack_node_t *node_ptr, int64_t prev_tagged)
+{
+    uint64_t counter = ((uint64_t)prev_tagged >> _BS_LF_STACK_PTR_BITS) + 1;
+    return (int64_t)((counter << _BS_LF_STACK_PTR_BITS) |
+                     (uint64_t)(uintptr_t)node_ptr);
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_push_pop(bs_test_t *test_ptr);
+static void test_pop_all(bs_test_t *test_ptr);
+static void test_threads(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_lf_stack_test_cases[] = {
+    { 1, "push_pop", test_push_pop },
+    { 1, "pop_all", test_pop_all },
+    { 1, "threads", test_threads },
+    { 0, NULL, NULL }
+};
+
+/** A node with a value, for the tests. */
+typedef struct {
+    /** The stack's node. */
+    bs_lf_stack_node_t        snode;
+    /** Non-zero while a thread holds this node. */
+    bs_atomic_int32_t         held;
+    /** Sequence number of the node. */
+    int                       seq;
+} test_node_t;
+
+/* ------------------------------------------------------------------------- */
+/** Verifies LIFO order, including re-pushing popped nodes. */
+void test_push_pop(bs_test_t *test_ptr)
+{
+    test_node_t               nodes[3];
+    bs_lf_stack_t             stack = BS_LF_STACK_INIT;
+
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_lf_stack_pop(&stack));
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 3; ++i) {
+            bs_lf_stack_push(&stack, &nodes[i].snode);
+        }
+        for (int i = 2; i >= 0; --i) {
+            BS_TEST_VERIFY_EQ(test_ptr, &nodes[i].snode,
+                              bs_lf_stack_pop(&stack));
+        }
+        BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_lf_stack_pop(&stack));
+    }
+
+    bs_lf_stack_push(&stack, &nodes[0].snode);
+    BS_TEST_VERIFY_EQ(test_ptr, &nodes[0].snode, bs_lf_stack_pop(&stack));
+    bs_lf_stack_push(&stack, &nodes[1].snode);
+    bs_lf_stack_push(&stack, &nodes[0].snode);
+    BS_TEST_VERIFY_EQ(test_ptr, &nodes[0].snode, bs_lf_stack_pop(&stack));
+    BS_TEST_VERIFY_EQ(test_ptr, &nodes[1].snode, bs_lf_stack_pop(&stack));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_lf_stack_pop(&stack));
+    bs_lf_stack_fini(&stack);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies pop-all returns the chain, topmost first, and empties it. */
+void test_pop_all(bs_test_t *test_ptr)
+{
+    test_node_t               nodes[4];
+    bs_lf_stack_t             stack;
+
+    bs_lf_stack_init(&stack);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_lf_stack_pop_all(&stack));
+
+    for (int i = 0; i < 4; ++i) bs_lf_stack_push(&stack, &nodes[i].snode);
+    bs_lf_stack_node_t *snode_ptr = bs_lf_stack_pop_all(&stack);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_lf_stack_pop(&stack));
+    for (int i = 3; i >= 0; --i) {
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, &nodes[i].snode, snode_ptr);
+        snode_ptr = bs_lf_stack_node_next(snode_ptr);
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, snode_ptr);
+
+    // The stack is usable after pop-all.
+    bs_lf_stack_push(&stack, &nodes[2].snode);
+    BS_TEST_VERIFY_EQ(test_ptr, &nodes[2].snode, bs_lf_stack_pop(&stack));
+    bs_lf_stack_fini(&stack);
+}
+
+/** Number of nodes in the stack for @ref test_threads. */
+#define _TEST_NODES 16
+/** Number of threads in @ref test_threads. */
+#define _TEST_THREADS 4
+/** Number of pop/push rounds per thread in @ref test_threads. */
+#define _TEST_ROUNDS 50000
+
+/** Argument for @ref _test_thread. */
+typedef struct {
+    /** The stack. */
+    bs_lf_stack_t             *stack_ptr;
+    /** Number of times a node was popped while held by another thread. */
+    int                       duplicates;
+} test_thread_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Thread: Pops nodes and pushes them back, in pairs to provoke ABA. Counts
+ * nodes that were handed out twice.
+ */
+static void *_test_thread(void *arg_ptr)
+{
+    test_thread_arg_t *targ_ptr = arg_ptr;
+    for (int i = 0; i < _TEST_ROUNDS; ++i) {
+        test_node_t *n_ptr[2] = {};
+        for (int j = 0; j < 2; ++j) {
+            bs_lf_stack_node_t *snode_ptr = bs_lf_stack_pop(
+                targ_ptr->stack_ptr);
+            if (NULL == snode_ptr) continue;
+            n_ptr[j] = BS_CONTAINER_OF(snode_ptr, test_node_t, snode);
+            if (0 != bs_atomic_int32_cas(&n_ptr[j]->held, 1, 0)) {
+                ++targ_ptr->duplicates;
+            }
+        }
+        for (int j = 0; j < 2; ++j) {
+            if (NULL == n_ptr[j]) continue;
+            bs_atomic_int32_set(&n_ptr[j]->held, 0);
+            bs_lf_stack_push(targ_ptr->stack_ptr, &n_ptr[j]->snode);
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pops and pushes from multiple threads; verifies no node is lost. */
+void test_threads(bs_test_t *test_ptr)
+{
+    test_node_t               nodes[_TEST_NODES] = {};
+    test_thread_arg_t         targs[_TEST_THREADS];
+    pthread_t                 threads[_TEST_THREADS];
+    bs_lf_stack_t             stack;
+
+    bs_lf_stack_init(&stack);
+    for (int i = 0; i < _TEST_NODES; ++i) {
+        nodes[i].seq = i;
+        bs_lf_stack_push(&stack, &nodes[i].snode);
+    }
+
+    for (int t = 0; t < _TEST_THREADS; ++t) {
+        targs[t] = (test_thread_arg_t){ .stack_ptr = &stack };
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, 0,
+            pthread_create(&threads[t], NULL, _test_thread, &targs[t]));
+    }
+    for (int t = 0; t < _TEST_THREADS; ++t) {
+        pthread_join(threads[t], NULL);
+        BS_TEST_VERIFY_EQ(test_ptr, 0, targs[t].duplicates);
+    }
+
+    bool seen[_TEST_NODES] = {};
+    int popped = 0;
+    bs_lf_stack_node_t *snode_ptr = bs_lf_stack_pop_all(&stack);
+    for (; NULL != snode_ptr && popped <= _TEST_NODES; ++popped) {
+        test_node_t *node_ptr = BS_CONTAINER_OF(snode_ptr, test_node_t, snode);
+        BS_TEST_VERIFY_FALSE(test_ptr, seen[node_ptr->seq]);
+        seen[node_ptr->seq] = true;
+        snode_ptr = bs_lf_stack_node_next(snode_ptr);
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_NODES, popped);
+    bs_lf_stack_fini(&stack);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_contention_mutex_ptr_stack(bs_test_t *test_ptr);
+static void benchmark_contention_lf_stack(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_lf_stack_benchmarks[] = {
+    { 1, "benchmark-contention-mutex_ptr_stack",
+      benchmark_contention_mutex_ptr_stack },
+    { 1, "benchmark-contention-lf_stack", benchmark_contention_lf_stack },
+    { 0, NULL, NULL }
+};
+
+/** Number of pop+push pairs, per run and across all threads. */
+#define _BENCHMARK_OPS (1 << 21)
+/** Maximum number of threads. */
+#define _BENCHMARK_MAX_THREADS 8
+/** Number of nodes in the free list. */
+#define _BENCHMARK_NODES 1024
+
+/** A free list made of a `bs_ptr_stack_t` and a mutex, as baseline. */
+typedef struct {
+    /** The stack. */
+    bs_ptr_stack_t            ptr_stack;
+    /** Protects `ptr_stack`. */
+    pthread_mutex_t           mutex;
+} benchmark_mutex_ptr_stack_t;
+
+/** Operations for a benchmarked stack. */
+typedef struct {
+    /** Pushes the node. Thread-safe. */
+    void (*push)(void *stack_ptr, bs_lf_stack_node_t *node_ptr);
+    /** Pops a node, or returns NULL. Thread-safe. */
+    bs_lf_stack_node_t *(*pop)(void *stack_ptr);
+} benchmark_stack_ops_t;
+
+/** Argument for @ref _benchmark_thread. */
+typedef struct {
+    /** Operations of the stack. */
+    const benchmark_stack_ops_t *ops_ptr;
+    /** The stack. */
+    void                      *stack_ptr;
+    /** Number of pop+push pairs to run. */
+    size_t                    ops;
+} benchmark_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Pushes into the mutex-guarded pointer stack. */
+static void _benchmark_mutex_ptr_stack_push(void *stack_ptr,
+                                            bs_lf_stack_node_t *node_ptr)
+{
+    benchmark_mutex_ptr_stack_t *s_ptr = stack_ptr;
+    bs_mutex_lock(&s_ptr->mutex);
+    bs_ptr_stack_push(&s_ptr->ptr_stack, node_ptr);
+    bs_mutex_unlock(&s_ptr->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pops from the mutex-guarded pointer stack. */
+static bs_lf_stack_node_t *_benchmark_mutex_ptr_stack_pop(void *stack_ptr)
+{
+    benchmark_mutex_ptr_stack_t *s_ptr = stack_ptr;
+    bs_mutex_lock(&s_ptr->mutex);
+    bs_lf_stack_node_t *node_ptr = bs_ptr_stack_pop(&s_ptr->ptr_stack);
+    bs_mutex_unlock(&s_ptr->mutex);
+    return node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pushes into the lock-free stack. */
+static void _benchmark_lf_stack_push(void *stack_ptr,
+                                     bs_lf_stack_node_t *node_ptr)
+{
+    bs_lf_stack_push(stack_ptr, node_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pops from the lock-free stack. */
+static bs_lf_stack_node_t *_benchmark_lf_stack_pop(void *stack_ptr)
+{
+    return bs_lf_stack_pop(stack_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Takes nodes from the free list, and returns them. */
+static void *_benchmark_thread(void *arg_ptr)
+{
+    benchmark_arg_t *barg_ptr = arg_ptr;
+    for (size_t i = 0; i < barg_ptr->ops; ++i) {
+        bs_lf_stack_node_t *node_ptr = barg_ptr->ops_ptr->pop(
+            barg_ptr->stack_ptr);
+        if (NULL != node_ptr) {
+            barg_ptr->ops_ptr->push(barg_ptr->stack_ptr, node_ptr);
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs @ref _BENCHMARK_OPS pop+push pairs on a free list of
+ * @ref _BENCHMARK_NODES nodes, from 1, 2, 4 and 8 threads. Reports the
+ * throughput for each.
+ */
+static void _benchmark_contention(bs_test_t *test_ptr,
+                                  const benchmark_stack_ops_t *ops_ptr,
+                                  void *stack_ptr)
+{
+    benchmark_arg_t           bargs[_BENCHMARK_MAX_THREADS];
+    pthread_t                 threads[_BENCHMARK_MAX_THREADS];
+    double                    rates[4];
+
+    bs_lf_stack_node_t *nodes_ptr = logged_calloc(
+        _BENCHMARK_NODES, sizeof(bs_lf_stack_node_t));
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, nodes_ptr);
+    for (size_t i = 0; i < _BENCHMARK_NODES; ++i) {
+        ops_ptr->push(stack_ptr, &nodes_ptr[i]);
+    }
+
+    for (int run = 0; run < 4; ++run) {
+        int num_threads = 1 << run;
+        uint64_t usec = bs_usec();
+        for (int t = 0; t < num_threads; ++t) {
+            bargs[t] = (benchmark_arg_t){
+                .ops_ptr = ops_ptr,
+                .stack_ptr = stack_ptr,
+                .ops = _BENCHMARK_OPS / num_threads };
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, 0,
+                pthread_create(&threads[t], NULL, _benchmark_thread,
+                               &bargs[t]));
+        }
+        for (int t = 0; t < num_threads; ++t) pthread_join(threads[t], NULL);
+        usec = bs_usec() - usec;
+        rates[run] = (double)_BENCHMARK_OPS / (usec * 1e-6);
+    }
+
+    size_t popped = 0;
+    while (NULL != ops_ptr->pop(stack_ptr)) ++popped;
+    BS_TEST_VERIFY_EQ(test_ptr, (size_t)_BENCHMARK_NODES, popped);
+    logged_free(nodes_ptr);
+
+    bs_test_succeed(test_ptr, "%.3e, %.3e, %.3e, %.3e pop+push/sec at "
+                    "1, 2, 4, 8 threads", rates[0], rates[1], rates[2],
+                    rates[3]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks a `bs_ptr_stack_t` guarded by a mutex. */
+void benchmark_contention_mutex_ptr_stack(bs_test_t *test_ptr)
+{
+    static const benchmark_stack_ops_t ops = {
+        .push = _benchmark_mutex_ptr_stack_push,
+        .pop = _benchmark_mutex_ptr_stack_pop };
+    benchmark_mutex_ptr_stack_t s = {};
+
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, bs_ptr_stack_init(&s.ptr_stack));
+    if (!bs_mutex_init(&s.mutex)) {
+        bs_ptr_stack_fini(&s.ptr_stack);
+        BS_TEST_FAIL(test_ptr, "Failed bs_mutex_init()");
+        return;
+    }
+    _benchmark_contention(test_ptr, &ops, &s);
+    bs_mutex_destroy(&s.mutex);
+    bs_ptr_stack_fini(&s.ptr_stack);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks the lock-free stack. */
+void benchmark_contention_lf_stack(bs_test_t *test_ptr)
+{
+    static const benchmark_stack_ops_t ops = {
+        .push = _benchmark_lf_stack_push,
+        .pop = _benchmark_lf_stack_pop };
+    bs_lf_stack_t stack = BS_LF_STACK_INIT;
+
+    _benchmark_contention(test_ptr, &ops, &stack);
+    bs_lf_stack_fini(&stack);
+}
+
+/* == End of lf_stack.c ==================================================== */
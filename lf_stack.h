@@ -0,0 +1,134 @@
+/* ========================================================================= */
+/**
+ * @file lf_stack.h
+ * An intrusive, lock-free LIFO stack (Treiber stack).
+ *
+ * The thread-safe counterpart to @ref bs_ptr_stack_t, for use as a free
+ * list shared between threads. Nodes are embedded in the caller's structs,
+ * and the stack never allocates. Push, pop and pop-all may come from any
+ * thread.
+ *
+ * The head is a tagged pointer: The node's address and a counter that
+ * changes on every update, packed into one 64-bit atomic. A pop that raced
+ * with a pop and re-push of the same node (the ABA problem) thus fails its
+ * compare-and-swap, and retries.
+ *
+ * A pop may still read the `next` field of a node that another thread just
+ * popped. Node memory must hence stay readable while the stack is in use:
+ * Take nodes from a pool or arena, and do not free them before the stack is
+ * finalized.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_LF_STACK_H__
+#define __LIBBASE_LF_STACK_H__
+
+#include "atomic.h"
+#include "test.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+
+// The stack holds atomics, which are only defined for C. See atomic.h.
+
+#else  // defined(__cplusplus)
+
+/** A node in the stack. */
+typedef struct _bs_lf_stack_node_t bs_lf_stack_node_t;
+
+/** Details of the node. */
+struct _bs_lf_stack_node_t {
+    /** Next node, as an intptr_t. */
+    bs_atomic_int64_t         next;
+};
+
+/** State of the stack. */
+typedef struct {
+    /** Topmost node and update counter, as a tagged pointer. */
+    bs_atomic_int64_t         head;
+} bs_lf_stack_t;
+
+/** Static initializer for an empty @ref bs_lf_stack_t. */
+#define BS_LF_STACK_INIT  { .head = BS_ATOMIC_INT64_INIT(0) }
+
+/**
+ * Initializes the stack. Use this for static allocations of
+ * @ref bs_lf_stack_t. Must be cleaned up by calling @ref bs_lf_stack_fini.
+ *
+ * @param stack_ptr
+ */
+void bs_lf_stack_init(bs_lf_stack_t *stack_ptr);
+
+/**
+ * Cleans up the stack. Nodes still in the stack are not touched.
+ *
+ * No other thread may use the stack concurrently, or afterwards.
+ *
+ * @param stack_ptr
+ */
+void bs_lf_stack_fini(bs_lf_stack_t *stack_ptr);
+
+/**
+ * Pushes `node_ptr` onto the stack. Thread-safe, lock-free.
+ *
+ * @param stack_ptr
+ * @param node_ptr            Must not be in any stack.
+ */
+void bs_lf_stack_push(bs_lf_stack_t *stack_ptr, bs_lf_stack_node_t *node_ptr);
+
+/**
+ * Pops the topmost node from the stack. Thread-safe, lock-free.
+ *
+ * @param stack_ptr
+ *
+ * @return The node, or NULL if the stack is empty.
+ */
+bs_lf_stack_node_t *bs_lf_stack_pop(bs_lf_stack_t *stack_ptr);
+
+/**
+ * Pops all nodes from the stack at once. Thread-safe, lock-free.
+ *
+ * The nodes remain linked, topmost first. Walk them using
+ * @ref bs_lf_stack_node_next, and read each node's successor before pushing
+ * it anywhere.
+ *
+ * @param stack_ptr
+ *
+ * @return The formerly topmost node, or NULL if the stack was empty.
+ */
+bs_lf_stack_node_t *bs_lf_stack_pop_all(bs_lf_stack_t *stack_ptr);
+
+/**
+ * Returns the node below `node_ptr`, in a chain from @ref bs_lf_stack_pop_all.
+ *
+ * @param node_ptr
+ *
+ * @return The next node, or NULL at the end of the chain.
+ */
+bs_lf_stack_node_t *bs_lf_stack_node_next(bs_lf_stack_node_t *node_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_lf_stack_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_lf_stack_benchmarks[];
+
+#endif  // defined(__cplusplus)
+
+#endif /* __LIBBASE_LF_STACK_H__ */
+/* == End of lf_stack.h ==================================================== */
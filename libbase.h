@@ -20,27 +20,45 @@
 #ifndef __LIBBASE_H__
 #define __LIBBASE_H__
 
+#include "alloc_stats.h"
+#include "arena.h"
 #include "arg.h"
+#include "array.h"
 #include "assert.h"
 #include "atomic.h"
 #include "avltree.h"
+#include "btree.h"
 #include "c2x_compat.h"
 #include "def.h"
 #include "dequeue.h"
 #include "dllist.h"
+#include "epoch.h"
+#include "event_loop.h"
 #include "file.h"
 #include "gfxbuf.h"
+#include "gfxbuf_convert.h"
 #include "gfxbuf_xpm.h"
+#include "hashmap.h"
+#include "lf_stack.h"
+#include "lock.h"
 #include "log.h"
 #include "log_wrappers.h"
+#include "lru.h"
+#include "metrics.h"
+#include "mpmc_ring.h"
+#include "mpsc_queue.h"
+#include "pool.h"
 #include "ptr_set.h"
 #include "ptr_stack.h"
 #include "ptr_vector.h"
+#include "rcu_btree.h"
 #include "subprocess.h"
 #include "sock.h"
 #include "strutil.h"
 #include "thread.h"
+#include "thread_pool.h"
 #include "time.h"
+#include "trace.h"
 #include "vector.h"
 
 #include "test.h"
@@ -23,7 +23,34 @@
 
 /** Unit tests. */
 const bs_test_set_t           libbase_benchmarks[] = {
+    { 1, "bs_alloc_stats", bs_alloc_stats_benchmarks },
+    { 1, "bs_arg", bs_arg_benchmarks },
+    { 1, "bs_array", bs_array_benchmarks },
+    { 1, "bs_btree", bs_btree_benchmarks },
+    { 1, "bs_event_loop", bs_event_loop_benchmarks },
+    { 1, "bs_file", bs_file_benchmarks },
     { 1, "bs_gfxbuf", bs_gfxbuf_benchmarks },
+    { 1, "bs_gfxbuf_convert", bs_gfxbuf_convert_benchmarks },
+    { 1, "bs_gfxbuf_xpm", bs_gfxbuf_xpm_benchmarks },
+    { 1, "bs_hashmap", bs_hashmap_benchmarks },
+    { 1, "bs_lf_stack", bs_lf_stack_benchmarks },
+    { 1, "bs_lock", bs_lock_benchmarks },
+    { 1, "bs_log", bs_log_benchmarks },
+    { 1, "bs_lru", bs_lru_benchmarks },
+    { 1, "bs_metrics", bs_metrics_benchmarks },
+    { 1, "bs_mpmc_ring", bs_mpmc_ring_benchmarks },
+    { 1, "bs_mpsc_queue", bs_mpsc_queue_benchmarks },
+    { 1, "bs_pool", bs_pool_benchmarks },
+    { 1, "bs_ptr_set", bs_ptr_set_benchmarks },
+    { 1, "bs_ptr_stack", bs_ptr_stack_benchmarks },
+    { 1, "bs_ptr_vector", bs_ptr_vector_benchmarks },
+    { 1, "bs_rcu_btree", bs_rcu_btree_benchmarks },
+    { 1, "bs_strutil", bs_strutil_benchmarks },
+    { 1, "bs_subprocess", bs_subprocess_benchmarks },
+    { 1, "bs_thread_pool", bs_thread_pool_benchmarks },
+    { 1, "bs_time", bs_time_benchmarks },
+    { 1, "bs_trace", bs_trace_benchmarks },
+    { 1, "bs_vector", bs_vector_benchmarks },
     { 0, NULL, NULL }
 };
 
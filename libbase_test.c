@@ -33,23 +33,43 @@ static const bs_test_case_t bs_header_only_test_cases[] = {
 
 /** Unit tests. */
 const bs_test_set_t           libbase_tests[] = {
+    { 1, "alloc_stats", bs_alloc_stats_test_cases },
     { 1, "atomic", bs_atomic_test_cases },
+    { 1, "arena", bs_arena_test_cases },
     { 1, "arg", bs_arg_test_cases },
+    { 1, "array", bs_array_test_cases },
     { 1, "avltree", bs_avltree_test_cases },
+    { 1, "btree", bs_btree_test_cases },
     { 1, "dequeue", bs_dequeue_test_cases },
     { 1, "dllist", bs_dllist_test_cases },
+    { 1, "epoch", bs_epoch_test_cases },
+    { 1, "event_loop", bs_event_loop_test_cases },
     { 1, "file", bs_file_test_cases },
     { 1, "gfxbuf", bs_gfxbuf_test_cases },
+    { 1, "gfxbuf_convert", bs_gfxbuf_convert_test_cases },
     { 1, "gfxbuf_xpm", bs_gfxbuf_xpm_test_cases },
+    { 1, "hashmap", bs_hashmap_test_cases },
     { 1, "header_only", bs_header_only_test_cases },
+    { 1, "lf_stack", bs_lf_stack_test_cases },
+    { 1, "lock", bs_lock_test_cases },
     { 1, "log", bs_log_test_cases },
+    { 1, "lru", bs_lru_test_cases },
+    { 1, "metrics", bs_metrics_test_cases },
+    { 1, "mpmc_ring", bs_mpmc_ring_test_cases },
+    { 1, "mpsc_queue", bs_mpsc_queue_test_cases },
+    { 1, "pool", bs_pool_test_cases },
     { 1, "ptr_set", bs_ptr_set_test_cases },
     { 1, "ptr_stack", bs_ptr_stack_test_cases },
     { 1, "ptr_vector", bs_ptr_vector_test_cases },
+    { 1, "rcu_btree", bs_rcu_btree_test_cases },
+    { 1, "sock", bs_sock_test_cases },
     { 1, "subprocess", bs_subprocess_test_cases },
     { 1, "strutil", bs_strutil_test_cases },
     { 1, "test", bs_test_test_cases },
+    { 1, "thread_pool", bs_thread_pool_test_cases },
     { 1, "time", bs_time_test_cases },
+    { 1, "trace", bs_trace_test_cases },
+    { 1, "vector", bs_vector_test_cases },
     { 0, NULL, NULL }
 };
 
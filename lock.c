@@ -0,0 +1,620 @@
+/* ========================================================================= */
+/**
+ * @file lock.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lock.h"
+
+#include "assert.h"
+#include "log.h"
+#include "thread.h"
+#include "time.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif  // defined(__linux__)
+
+/* == Declarations ========================================================= */
+
+/** Number of spins before a waiter yields the CPU, or parks. */
+#define _BS_LOCK_SPINS 128
+
+static void _bs_lock_cpu_relax(void);
+static void _bs_lock_futex_wait(bs_atomic_int32_t *a_ptr, int32_t value);
+static void _bs_lock_futex_wake(bs_atomic_int32_t *a_ptr, int waiters);
+static bool _bs_rwlock_park(bs_rwlock_t *rwlock_ptr, bool writer);
+static void _bs_rwlock_wake(bs_rwlock_t *rwlock_ptr);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+void bs_spinlock_lock(bs_spinlock_t *spinlock_ptr)
+{
+    int32_t ticket = bs_atomic_int32_add(&spinlock_ptr->next, 1) - 1;
+    for (int spins = 0;
+         ticket != bs_atomic_int32_get_explicit(&spinlock_ptr->serving,
+                                                BS_ATOMIC_ACQUIRE);
+         ++spins) {
+        if (spins < _BS_LOCK_SPINS) {
+            _bs_lock_cpu_relax();
+        } else {
+            // The holder, or an earlier ticket, may have been preempted.
+            sched_yield();
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_spinlock_trylock(bs_spinlock_t *spinlock_ptr)
+{
+    int32_t serving = bs_atomic_int32_get_explicit(&spinlock_ptr->serving,
+                                                   BS_ATOMIC_ACQUIRE);
+    return serving == bs_atomic_int32_cas(&spinlock_ptr->next,
+                                          serving + 1, serving);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_spinlock_unlock(bs_spinlock_t *spinlock_ptr)
+{
+    int32_t serving = bs_atomic_int32_get_explicit(&spinlock_ptr->serving,
+                                                   BS_ATOMIC_RELAXED);
+    if (serving == bs_atomic_int32_get(&spinlock_ptr->next)) {
+        bs_log(BS_FATAL, "Unlocking unlocked spinlock %p", spinlock_ptr);
+        BS_ABORT();
+    }
+    bs_atomic_int32_set_explicit(&spinlock_ptr->serving, serving + 1,
+                                 BS_ATOMIC_RELEASE);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_lock_lock(bs_lock_t *lock_ptr)
+{
+    // See Ulrich Drepper, "Futexes Are Tricky", for the algorithm.
+    int32_t state = bs_atomic_int32_cas(&lock_ptr->state, 1, 0);
+    if (0 == state) return;
+
+    for (int spins = 0; spins < _BS_LOCK_SPINS; ++spins) {
+        _bs_lock_cpu_relax();
+        if (0 == bs_atomic_int32_get_explicit(&lock_ptr->state,
+                                              BS_ATOMIC_RELAXED)) {
+            state = bs_atomic_int32_cas(&lock_ptr->state, 1, 0);
+            if (0 == state) return;
+        }
+    }
+
+    // Mark as contended, so that the unlock will wake us up.
+    if (2 != state) {
+        state = 2;
+        bs_atomic_int32_xchg(&lock_ptr->state, &state);
+    }
+    while (0 != state) {
+        _bs_lock_futex_wait(&lock_ptr->state, 2);
+        state = 2;
+        bs_atomic_int32_xchg(&lock_ptr->state, &state);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_lock_trylock(bs_lock_t *lock_ptr)
+{
+    return 0 == bs_atomic_int32_cas(&lock_ptr->state, 1, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_lock_unlock(bs_lock_t *lock_ptr)
+{
+    int32_t state = bs_atomic_int32_add(&lock_ptr->state, -1);
+    if (0 == state) return;
+    if (1 != state) {
+        bs_log(BS_FATAL, "Unlocking unlocked lock %p", lock_ptr);
+        BS_ABORT();
+    }
+    bs_atomic_int32_set(&lock_ptr->state, 0);
+    _bs_lock_futex_wake(&lock_ptr->state, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_rwlock_rdlock(bs_rwlock_t *rwlock_ptr)
+{
+    for (int spins = 0; !bs_rwlock_tryrdlock(rwlock_ptr); ++spins) {
+        if (spins < _BS_LOCK_SPINS) {
+            _bs_lock_cpu_relax();
+        } else if (_bs_rwlock_park(rwlock_ptr, false)) {
+            return;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_rwlock_tryrdlock(bs_rwlock_t *rwlock_ptr)
+{
+    int32_t state = bs_atomic_int32_get(&rwlock_ptr->state);
+    if (0 > state || 0 < bs_atomic_int32_get(&rwlock_ptr->writers_waiting)) {
+        return false;
+    }
+    return state == bs_atomic_int32_cas(&rwlock_ptr->state, state + 1, state);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_rwlock_rdunlock(bs_rwlock_t *rwlock_ptr)
+{
+    int32_t state = bs_atomic_int32_add(&rwlock_ptr->state, -1);
+    if (0 > state) {
+        bs_log(BS_FATAL, "Read-unlocking rwlock %p not locked for reading",
+               rwlock_ptr);
+        BS_ABORT();
+    }
+    // Only the last reader can let a writer in.
+    if (0 == state) _bs_rwlock_wake(rwlock_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_rwlock_wrlock(bs_rwlock_t *rwlock_ptr)
+{
+    if (bs_rwlock_trywrlock(rwlock_ptr)) return;
+
+    bs_atomic_int32_add(&rwlock_ptr->writers_waiting, 1);
+    for (int spins = 0;
+         0 != bs_atomic_int32_cas(&rwlock_ptr->state, -1, 0);
+         ++spins) {
+        if (spins < _BS_LOCK_SPINS) {
+            _bs_lock_cpu_relax();
+        } else if (_bs_rwlock_park(rwlock_ptr, true)) {
+            break;
+        }
+    }
+    bs_atomic_int32_add(&rwlock_ptr->writers_waiting, -1);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_rwlock_trywrlock(bs_rwlock_t *rwlock_ptr)
+{
+    return 0 == bs_atomic_int32_cas(&rwlock_ptr->state, -1, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_rwlock_wrunlock(bs_rwlock_t *rwlock_ptr)
+{
+    if (-1 != bs_atomic_int32_cas(&rwlock_ptr->state, 0, -1)) {
+        bs_log(BS_FATAL, "Write-unlocking rwlock %p not locked for writing",
+               rwlock_ptr);
+        BS_ABORT();
+    }
+    _bs_rwlock_wake(rwlock_ptr);
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Hints the CPU that we're spinning. */
+void _bs_lock_cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile ("yield" ::: "memory");
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/** Parks the calling thread, unless `a_ptr` has changed from `value`. */
+void _bs_lock_futex_wait(bs_atomic_int32_t *a_ptr, int32_t value)
+{
+#if defined(__linux__)
+    long rv = syscall(SYS_futex, &a_ptr->v, FUTEX_WAIT_PRIVATE, value,
+                      NULL, NULL, 0);
+    if (0 != rv && EAGAIN != errno && EINTR != errno) {
+        bs_log(BS_FATAL | BS_ERRNO, "Failed futex(%p, FUTEX_WAIT, %"PRId32")",
+               a_ptr, value);
+        BS_ABORT();
+    }
+#else  // defined(__linux__)
+    // No futex(2) here. Fall back to yielding.
+    if (value == bs_atomic_int32_get(a_ptr)) sched_yield();
+#endif  // defined(__linux__)
+}
+
+/* ------------------------------------------------------------------------- */
+/** Wakes up to `waiters` threads parked on `a_ptr`. */
+void _bs_lock_futex_wake(bs_atomic_int32_t *a_ptr, int waiters)
+{
+#if defined(__linux__)
+    long rv = syscall(SYS_futex, &a_ptr->v, FUTEX_WAKE_PRIVATE, waiters,
+                      NULL, NULL, 0);
+    if (0 > rv) {
+        bs_log(BS_FATAL | BS_ERRNO, "Failed futex(%p, FUTEX_WAKE, %d)",
+               a_ptr, waiters);
+        BS_ABORT();
+    }
+#else  // defined(__linux__)
+    (void)a_ptr;
+    (void)waiters;
+#endif  // defined(__linux__)
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Parks the calling thread until the next unlock, unless the lock can be
+ * taken right away.
+ *
+ * @return true if the lock was taken.
+ */
+bool _bs_rwlock_park(bs_rwlock_t *rwlock_ptr, bool writer)
+{
+    // Take the sequence before announcing the park, and try again after: An
+    // unlock in between either lets us take the lock, or bumps sequence.
+    int32_t sequence = bs_atomic_int32_get(&rwlock_ptr->sequence);
+    bs_atomic_int32_add(&rwlock_ptr->parked, 1);
+    bool locked = writer ?
+        bs_rwlock_trywrlock(rwlock_ptr) :
+        bs_rwlock_tryrdlock(rwlock_ptr);
+    if (!locked) _bs_lock_futex_wait(&rwlock_ptr->sequence, sequence);
+    bs_atomic_int32_add(&rwlock_ptr->parked, -1);
+    return locked;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Wakes up all parked threads, if there are any. */
+void _bs_rwlock_wake(bs_rwlock_t *rwlock_ptr)
+{
+    bs_atomic_int32_add(&rwlock_ptr->sequence, 1);
+    if (0 < bs_atomic_int32_get(&rwlock_ptr->parked)) {
+        _bs_lock_futex_wake(&rwlock_ptr->sequence, INT_MAX);
+    }
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_spinlock(bs_test_t *test_ptr);
+static void test_lock(bs_test_t *test_ptr);
+static void test_rwlock(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_lock_test_cases[] = {
+    { 1, "spinlock", test_spinlock },
+    { 1, "lock", test_lock },
+    { 1, "rwlock", test_rwlock },
+    { 0, NULL, NULL }
+};
+
+/** Number of threads in the threaded tests. */
+#define _TEST_THREADS 8
+/** Number of iterations per thread in the threaded tests. */
+#define _TEST_ITERATIONS 20000
+
+/** Argument to the threaded tests. */
+typedef struct {
+    /** The lock under test. */
+    void                      *lock_ptr;
+    /** Protected by the lock. */
+    int                       a;
+    /** Protected by the lock. Must always be the same as `a`. */
+    int                       b;
+    /** Number of times a reader found `a` and `b` to differ. */
+    bs_atomic_int32_t         torn_reads;
+} test_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Increments under the spinlock. */
+static void *_test_spinlock_thread(void *arg_ptr)
+{
+    test_arg_t *targ_ptr = arg_ptr;
+    for (int i = 0; i < _TEST_ITERATIONS; ++i) {
+        bs_spinlock_lock(targ_ptr->lock_ptr);
+        targ_ptr->a++;
+        bs_spinlock_unlock(targ_ptr->lock_ptr);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Increments under the lock. */
+static void *_test_lock_thread(void *arg_ptr)
+{
+    test_arg_t *targ_ptr = arg_ptr;
+    for (int i = 0; i < _TEST_ITERATIONS; ++i) {
+        bs_lock_lock(targ_ptr->lock_ptr);
+        targ_ptr->a++;
+        bs_lock_unlock(targ_ptr->lock_ptr);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Increments under the write lock, and checks under read lock. */
+static void *_test_rwlock_thread(void *arg_ptr)
+{
+    test_arg_t *targ_ptr = arg_ptr;
+    for (int i = 0; i < _TEST_ITERATIONS; ++i) {
+        if (0 == i % 4) {
+            bs_rwlock_wrlock(targ_ptr->lock_ptr);
+            targ_ptr->a++;
+            sched_yield();
+            targ_ptr->b++;
+            bs_rwlock_wrunlock(targ_ptr->lock_ptr);
+        } else {
+            bs_rwlock_rdlock(targ_ptr->lock_ptr);
+            if (targ_ptr->a != targ_ptr->b) {
+                bs_atomic_int32_add(&targ_ptr->torn_reads, 1);
+            }
+            bs_rwlock_rdunlock(targ_ptr->lock_ptr);
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Runs `thread_func` on @ref _TEST_THREADS threads, and joins them. */
+static bool _test_run_threads(bs_test_t *test_ptr,
+                              void *(*thread_func)(void *),
+                              test_arg_t *targ_ptr)
+{
+    pthread_t                 threads[_TEST_THREADS];
+
+    int t = 0;
+    while (t < _TEST_THREADS &&
+           0 == pthread_create(&threads[t], NULL, thread_func, targ_ptr)) ++t;
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS, t);
+    while (0 < t) pthread_join(threads[--t], NULL);
+    return !bs_test_failed(test_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Exercises the ticket spinlock. */
+void test_spinlock(bs_test_t *test_ptr)
+{
+    bs_spinlock_t             spinlock = BS_SPINLOCK_INIT;
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_spinlock_trylock(&spinlock));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_spinlock_trylock(&spinlock));
+    bs_spinlock_unlock(&spinlock);
+    bs_spinlock_lock(&spinlock);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_spinlock_trylock(&spinlock));
+    bs_spinlock_unlock(&spinlock);
+
+    test_arg_t targ = { .lock_ptr = &spinlock };
+    if (!_test_run_threads(test_ptr, _test_spinlock_thread, &targ)) return;
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS * _TEST_ITERATIONS, targ.a);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Exercises the adaptive mutex. */
+void test_lock(bs_test_t *test_ptr)
+{
+    bs_lock_t                 lock = BS_LOCK_INIT;
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_lock_trylock(&lock));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_lock_trylock(&lock));
+    bs_lock_unlock(&lock);
+    bs_lock_lock(&lock);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_lock_trylock(&lock));
+    bs_lock_unlock(&lock);
+
+    test_arg_t targ = { .lock_ptr = &lock };
+    if (!_test_run_threads(test_ptr, _test_lock_thread, &targ)) return;
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS * _TEST_ITERATIONS, targ.a);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_atomic_int32_get(&lock.state));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Exercises the reader-writer lock. */
+void test_rwlock(bs_test_t *test_ptr)
+{
+    bs_rwlock_t               rwlock = BS_RWLOCK_INIT;
+
+    bs_rwlock_rdlock(&rwlock);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_rwlock_tryrdlock(&rwlock));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_rwlock_trywrlock(&rwlock));
+    bs_rwlock_rdunlock(&rwlock);
+    bs_rwlock_rdunlock(&rwlock);
+
+    bs_rwlock_wrlock(&rwlock);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_rwlock_tryrdlock(&rwlock));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_rwlock_trywrlock(&rwlock));
+    bs_rwlock_wrunlock(&rwlock);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_rwlock_trywrlock(&rwlock));
+    bs_rwlock_wrunlock(&rwlock);
+
+    test_arg_t targ = { .lock_ptr = &rwlock };
+    if (!_test_run_threads(test_ptr, _test_rwlock_thread, &targ)) return;
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS * _TEST_ITERATIONS / 4, targ.a);
+    BS_TEST_VERIFY_EQ(test_ptr, targ.a, targ.b);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_atomic_int32_get(&targ.torn_reads));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_atomic_int32_get(&rwlock.state));
+    BS_TEST_VERIFY_EQ(test_ptr, 0,
+                      bs_atomic_int32_get(&rwlock.writers_waiting));
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_mutex(bs_test_t *test_ptr);
+static void benchmark_spinlock(bs_test_t *test_ptr);
+static void benchmark_lock(bs_test_t *test_ptr);
+static void benchmark_rwlock_write(bs_test_t *test_ptr);
+static void benchmark_rwlock_read(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t bs_lock_benchmarks[] = {
+    { 1, "benchmark-mutex", benchmark_mutex },
+    { 1, "benchmark-spinlock", benchmark_spinlock },
+    { 1, "benchmark-lock", benchmark_lock },
+    { 1, "benchmark-rwlock_write", benchmark_rwlock_write },
+    { 1, "benchmark-rwlock_read", benchmark_rwlock_read },
+    { 0, NULL, NULL }
+};
+
+/** Maximum number of threads in the benchmark. */
+#define _BENCHMARK_MAX_THREADS 16
+
+/** Argument for the benchmark threads. */
+typedef struct {
+    /** The lock to take. */
+    void                      *lock_ptr;
+    /** Takes the lock. */
+    void                      (*lock)(void *lock_ptr);
+    /** Releases the lock. */
+    void                      (*unlock)(void *lock_ptr);
+    /** Incremented within the critical section. NULL for readers. */
+    uint64_t                  *counter_ptr;
+    /** Set to non-zero to terminate. */
+    bs_atomic_int32_t         *stop_ptr;
+    /** Number of critical sections this thread went through. */
+    uint64_t                  sections;
+} benchmark_arg_t;
+
+/** Wraps @ref bs_mutex_lock for @ref benchmark_arg_t. */
+static void _benchmark_mutex_lock(void *p) { bs_mutex_lock(p); }
+/** Wraps @ref bs_mutex_unlock for @ref benchmark_arg_t. */
+static void _benchmark_mutex_unlock(void *p) { bs_mutex_unlock(p); }
+/** Wraps @ref bs_spinlock_lock for @ref benchmark_arg_t. */
+static void _benchmark_spinlock_lock(void *p) { bs_spinlock_lock(p); }
+/** Wraps @ref bs_spinlock_unlock for @ref benchmark_arg_t. */
+static void _benchmark_spinlock_unlock(void *p) { bs_spinlock_unlock(p); }
+/** Wraps @ref bs_lock_lock for @ref benchmark_arg_t. */
+static void _benchmark_lock_lock(void *p) { bs_lock_lock(p); }
+/** Wraps @ref bs_lock_unlock for @ref benchmark_arg_t. */
+static void _benchmark_lock_unlock(void *p) { bs_lock_unlock(p); }
+/** Wraps @ref bs_rwlock_wrlock for @ref benchmark_arg_t. */
+static void _benchmark_wrlock(void *p) { bs_rwlock_wrlock(p); }
+/** Wraps @ref bs_rwlock_wrunlock for @ref benchmark_arg_t. */
+static void _benchmark_wrunlock(void *p) { bs_rwlock_wrunlock(p); }
+/** Wraps @ref bs_rwlock_rdlock for @ref benchmark_arg_t. */
+static void _benchmark_rdlock(void *p) { bs_rwlock_rdlock(p); }
+/** Wraps @ref bs_rwlock_rdunlock for @ref benchmark_arg_t. */
+static void _benchmark_rdunlock(void *p) { bs_rwlock_rdunlock(p); }
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Goes through short critical sections until told to stop. */
+static void *_benchmark_thread(void *arg_ptr)
+{
+    benchmark_arg_t *barg_ptr = arg_ptr;
+    while (0 == bs_atomic_int32_get(barg_ptr->stop_ptr)) {
+        for (int i = 0; i < 100; ++i) {
+            barg_ptr->lock(barg_ptr->lock_ptr);
+            if (NULL != barg_ptr->counter_ptr) ++*barg_ptr->counter_ptr;
+            barg_ptr->unlock(barg_ptr->lock_ptr);
+        }
+        barg_ptr->sections += 100;
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs critical sections on 1, 4 and 16 threads, each for a third of the
+ * benchmark duration, and reports the throughput for each thread count.
+ */
+static void _benchmark_contention(bs_test_t *test_ptr,
+                                  void *lock_ptr,
+                                  void (*lock)(void *lock_ptr),
+                                  void (*unlock)(void *lock_ptr),
+                                  bool readers)
+{
+    benchmark_arg_t           bargs[_BENCHMARK_MAX_THREADS];
+    pthread_t                 threads[_BENCHMARK_MAX_THREADS];
+    uint64_t                  counter = 0;
+    double                    rates[3];
+
+    for (int run = 0; run < 3; ++run) {
+        int num_threads = 1 << (2 * run);
+        bs_atomic_int32_t stop = BS_ATOMIC_INT32_INIT(0);
+        for (int t = 0; t < num_threads; ++t) {
+            // Readers do not exclude each other, so must not write.
+            bargs[t] = (benchmark_arg_t){
+                .lock_ptr = lock_ptr, .lock = lock, .unlock = unlock,
+                .counter_ptr = readers ? NULL : &counter,
+                .stop_ptr = &stop };
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, 0,
+                pthread_create(&threads[t], NULL, _benchmark_thread,
+                               &bargs[t]));
+        }
+        uint64_t usec = bs_usec();
+        while (usec + benchmark_duration / 3 >= bs_usec()) {
+            usleep(10000);
+        }
+        bs_atomic_int32_set(&stop, 1);
+        uint64_t sections = 0;
+        for (int t = 0; t < num_threads; ++t) {
+            pthread_join(threads[t], NULL);
+            sections += bargs[t].sections;
+        }
+        usec = bs_usec() - usec;
+        rates[run] = (double)sections / (usec * 1e-6);
+    }
+
+    bs_test_succeed(test_ptr, "%.3e, %.3e, %.3e locks/sec at 1, 4, 16 "
+                    "threads", rates[0], rates[1], rates[2]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks `pthread_mutex_t`, through @ref bs_mutex_lock, as baseline. */
+void benchmark_mutex(bs_test_t *test_ptr)
+{
+    pthread_mutex_t           mutex;
+
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, bs_mutex_init(&mutex));
+    _benchmark_contention(test_ptr, &mutex, _benchmark_mutex_lock,
+                          _benchmark_mutex_unlock, false);
+    bs_mutex_destroy(&mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks @ref bs_spinlock_t. */
+void benchmark_spinlock(bs_test_t *test_ptr)
+{
+    bs_spinlock_t             spinlock = BS_SPINLOCK_INIT;
+    _benchmark_contention(test_ptr, &spinlock, _benchmark_spinlock_lock,
+                          _benchmark_spinlock_unlock, false);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks @ref bs_lock_t. */
+void benchmark_lock(bs_test_t *test_ptr)
+{
+    bs_lock_t                 lock = BS_LOCK_INIT;
+    _benchmark_contention(test_ptr, &lock, _benchmark_lock_lock,
+                          _benchmark_lock_unlock, false);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks @ref bs_rwlock_t, with writers only. */
+void benchmark_rwlock_write(bs_test_t *test_ptr)
+{
+    bs_rwlock_t               rwlock = BS_RWLOCK_INIT;
+    _benchmark_contention(test_ptr, &rwlock, _benchmark_wrlock,
+                          _benchmark_wrunlock, false);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks @ref bs_rwlock_t, with readers only. */
+void benchmark_rwlock_read(bs_test_t *test_ptr)
+{
+    bs_rwlock_t               rwlock = BS_RWLOCK_INIT;
+    _benchmark_contention(test_ptr, &rwlock, _benchmark_rdlock,
+                          _benchmark_rdunlock, true);
+}
+
+/* == End of lock.c ======================================================== */
@@ -0,0 +1,125 @@
+/* ========================================================================= */
+/**
+ * @file lock.h
+ * Lightweight locks, for short critical sections.
+ *
+ * Unlike `pthread_mutex_t`, these locks are a few atomic integers, and take
+ * no system call when uncontended. Contended waiters on @ref bs_lock_t and
+ * @ref bs_rwlock_t spin briefly, and then park on a futex(2). Errors are
+ * logged and abort, same as for the wrappers in thread.h.
+ *
+ * None of the locks is recursive.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_LOCK_H__
+#define __LIBBASE_LOCK_H__
+
+#include "atomic.h"
+#include "test.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/**
+ * A ticket spinlock. Grants the lock in order of arrival. Waiters never
+ * park, they yield the CPU after spinning a while. Only for very short
+ * critical sections, and with no more contending threads than CPUs.
+ */
+typedef struct {
+    /** Next ticket to hand out. */
+    bs_atomic_int32_t         next;
+    /** Ticket currently holding the lock. */
+    bs_atomic_int32_t         serving;
+} bs_spinlock_t;
+
+/** Initializes a @ref bs_spinlock_t as unlocked. */
+#define BS_SPINLOCK_INIT { BS_ATOMIC_INT32_INIT(0), BS_ATOMIC_INT32_INIT(0) }
+
+/**
+ * An adaptive mutex: Spins for a short while, then parks on a futex.
+ * Unlocking takes a system call only if a waiter is parked.
+ */
+typedef struct {
+    /** 0: unlocked. 1: locked. 2: locked, and maybe with parked waiters. */
+    bs_atomic_int32_t         state;
+} bs_lock_t;
+
+/** Initializes a @ref bs_lock_t as unlocked. */
+#define BS_LOCK_INIT { BS_ATOMIC_INT32_INIT(0) }
+
+/**
+ * A reader-writer lock, preferring writers: Once a writer waits, new readers
+ * wait, too. A thread holding a read lock must thus not take another one.
+ */
+typedef struct {
+    /** Number of readers holding the lock, or -1 if a writer holds it. */
+    bs_atomic_int32_t         state;
+    /** Number of writers waiting for the lock. */
+    bs_atomic_int32_t         writers_waiting;
+    /** Number of threads parked on `sequence`. */
+    bs_atomic_int32_t         parked;
+    /** Futex word. Incremented on each unlock, to wake up parked threads. */
+    bs_atomic_int32_t         sequence;
+} bs_rwlock_t;
+
+/** Initializes a @ref bs_rwlock_t as unlocked. */
+#define BS_RWLOCK_INIT {                                        \
+        BS_ATOMIC_INT32_INIT(0), BS_ATOMIC_INT32_INIT(0),       \
+        BS_ATOMIC_INT32_INIT(0), BS_ATOMIC_INT32_INIT(0) }
+
+/** Locks the spinlock. */
+void bs_spinlock_lock(bs_spinlock_t *spinlock_ptr);
+/** Locks the spinlock, if it is unlocked. Returns whether it got locked. */
+bool bs_spinlock_trylock(bs_spinlock_t *spinlock_ptr);
+/** Unlocks the spinlock. Aborts if it was not locked. */
+void bs_spinlock_unlock(bs_spinlock_t *spinlock_ptr);
+
+/** Locks the lock, with error handling: aborts on error. */
+void bs_lock_lock(bs_lock_t *lock_ptr);
+/** Locks the lock, if it is unlocked. Returns whether it got locked. */
+bool bs_lock_trylock(bs_lock_t *lock_ptr);
+/** Unlocks the lock, with error handling: aborts if it was not locked. */
+void bs_lock_unlock(bs_lock_t *lock_ptr);
+
+/** Locks the reader-writer lock for reading. Aborts on error. */
+void bs_rwlock_rdlock(bs_rwlock_t *rwlock_ptr);
+/** Locks for reading, if possible without waiting. Returns success. */
+bool bs_rwlock_tryrdlock(bs_rwlock_t *rwlock_ptr);
+/** Unlocks a read lock. Aborts if not locked for reading. */
+void bs_rwlock_rdunlock(bs_rwlock_t *rwlock_ptr);
+/** Locks the reader-writer lock for writing. Aborts on error. */
+void bs_rwlock_wrlock(bs_rwlock_t *rwlock_ptr);
+/** Locks for writing, if possible without waiting. Returns success. */
+bool bs_rwlock_trywrlock(bs_rwlock_t *rwlock_ptr);
+/** Unlocks a write lock. Aborts if not locked for writing. */
+void bs_rwlock_wrunlock(bs_rwlock_t *rwlock_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_lock_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_lock_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_LOCK_H__ */
+/* == End of lock.h ======================================================== */
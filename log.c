@@ -19,22 +19,32 @@
  */
 
 #include "assert.h"
+#include "atomic.h"
+#include "dllist.h"
 #include "log.h"
+#include "mpmc_ring.h"
 #include "sock.h"
 #include "strutil.h"
+#include "thread.h"
+#include "time.h"
+#include "trace.h"
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/stat.h>
-#include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 /* == Data ================================================================= */
 
@@ -45,7 +55,200 @@ static const char*     _severity_names[5] = {
 
 static int             _log_fd = 2;
 
+/** Maximum number of messages written in one writev(2) call. */
+#define BS_LOG_ASYNC_BATCH    64
+
+/** A slot of the asynchronous log backend, holding one message. */
+typedef struct {
+    /** Length of the message in `buf`. */
+    size_t                    len;
+    /** The formatted message, including the trailing newline. */
+    char                      buf[BS_LOG_MAX_BUF_SIZE + 1];
+} bs_log_async_slot_t;
+
+/**
+ * State of the asynchronous log backend.
+ *
+ * Slots cycle through two rings: Callers take a slot from `free_ring_ptr`,
+ * format into it, and push it to `queue_ring_ptr`. The background thread
+ * writes the queued slots, and returns them to `free_ring_ptr`.
+ */
+typedef struct {
+    /** The slots. */
+    bs_log_async_slot_t       *slots_ptr;
+    /** Slots available for messages. */
+    bs_mpmc_ring_t            *free_ring_ptr;
+    /** Slots with messages to write. A NULL element stops `thread`. */
+    bs_mpmc_ring_t            *queue_ring_ptr;
+    /** What to do when no slot is free. */
+    bs_log_async_overflow_t   overflow;
+    /** Number of messages enqueued. */
+    bs_atomic_int64_t         enqueued;
+    /** Number of messages written. Updated by `thread`, under `mutex`. */
+    bs_atomic_int64_t         written;
+    /** Number of dropped messages. */
+    bs_atomic_int64_t         dropped;
+    /** Number of dropped messages already reported. Used by `thread`. */
+    int64_t                   reported_dropped;
+
+    /** The background thread. */
+    pthread_t                 thread;
+    /** Used for `done_cond`. */
+    pthread_mutex_t           mutex;
+    /** Broadcasted whenever `thread` has written a batch. */
+    pthread_cond_t            done_cond;
+} bs_log_async_t;
+
+/** The asynchronous log backend, if started. */
+static bs_log_async_t  *_log_async_ptr = NULL;
+
+/** Maximum size of the recorded arguments of one binary log message. */
+#define BS_LOG_BINARY_MAX_ARGS BS_LOG_MAX_BUF_SIZE
+
+/** Header of a binary log record. Followed by `args_size` bytes. */
+typedef struct {
+    /** Time of the log call, as from bs_usec(). */
+    uint64_t                  usec;
+    /** The format string. Referenced, not copied. */
+    const char                *fmt_ptr;
+    /** Source file of the log call. Referenced, not copied. */
+    const char                *file_name_ptr;
+    /** Source line of the log call. */
+    int                       line_num;
+    /** Value of errno at the time of the log call. */
+    int                       errno_value;
+    /** Severity, possibly OR-ed with BS_ERRNO. */
+    bs_log_severity_t         severity;
+    /** Size of the recorded arguments following this header. */
+    uint32_t                  args_size;
+} bs_log_binary_record_t;
+
+/** A thread's buffer of binary log records. */
+typedef struct {
+    /** Node within bs_log_binary_t::buffers. */
+    bs_dllist_node_t          dlnode;
+    /** Protects `used` and the contents of `data_ptr`. */
+    pthread_mutex_t           mutex;
+    /** The records. */
+    uint8_t                   *data_ptr;
+    /** Size of `data_ptr`, in bytes. */
+    size_t                    size;
+    /** Bytes used by records in `data_ptr`. */
+    size_t                    used;
+} bs_log_binary_buffer_t;
+
+/** State of the binary logging mode. */
+typedef struct {
+    /** Key for the calling thread's @ref bs_log_binary_buffer_t. */
+    pthread_key_t             key;
+    /** Size of each thread's buffer. */
+    size_t                    bytes_per_thread;
+    /** Protects `buffers`. */
+    pthread_mutex_t           mutex;
+    /** All threads' buffers. */
+    bs_dllist_t               buffers;
+} bs_log_binary_t;
+
+/** The binary logging mode, if started. */
+static bs_log_binary_t *_log_binary_ptr = NULL;
+
+/** Type of the argument consumed by a printf conversion. */
+typedef enum {
+    BS_LOG_ARG_NONE,          /**< "%%" or "%m": Consumes no argument. */
+    BS_LOG_ARG_UNKNOWN,       /**< Not understood: Rendered verbatim. */
+    BS_LOG_ARG_INT,
+    BS_LOG_ARG_LONG,
+    BS_LOG_ARG_LLONG,
+    BS_LOG_ARG_INTMAX,
+    BS_LOG_ARG_SIZE,
+    BS_LOG_ARG_PTRDIFF,
+    BS_LOG_ARG_DOUBLE,
+    BS_LOG_ARG_LDOUBLE,
+    BS_LOG_ARG_PTR,
+    BS_LOG_ARG_STR,
+    BS_LOG_ARG_COUNT          /**< "%n": Consumes a pointer, not recorded. */
+} bs_log_arg_t;
+
+/** A printf conversion specification, as parsed by _bs_log_next_conv(). */
+typedef struct {
+    /** Points to the '%' starting the specification. */
+    const char                *begin_ptr;
+    /** Length of the specification, including the '%'. */
+    size_t                    len;
+    /** Number of '*' for width and precision, each consuming an int. */
+    unsigned                  stars;
+    /** Whether the precision is given as '*'. */
+    bool                      precision_star;
+    /** The precision, if given as digits. -1 otherwise. */
+    int                       precision;
+    /** Type of the argument. */
+    bs_log_arg_t              arg;
+} bs_log_conv_t;
+
+/** Length of the timestamp, "YYYY-MM-DD hh:mm:ss.ccc". */
+#define BS_LOG_TIMESTAMP_LEN  23
+
+/** Per-thread cache of the timestamp, re-formatted only once per second. */
+static _Thread_local struct {
+    /** The second `buf` was formatted for. */
+    int64_t                   sec;
+    /** The timestamp. Milliseconds are patched in on each use. */
+    char                      buf[BS_LOG_TIMESTAMP_LEN + 1];
+} _log_timestamp = { .sec = -1 };
+
 static const char *_strip_prefix(const char *path_ptr);
+static size_t _bs_log_format_timestamp(char *buf_ptr, uint64_t usec);
+static const char *_bs_log_color(bs_log_severity_t severity);
+static size_t _bs_log_format_prefix(char *buf_ptr,
+                                    bs_log_severity_t severity,
+                                    const char *file_name_ptr,
+                                    int line_num,
+                                    uint64_t usec);
+static size_t _bs_log_format_suffix(char *buf_ptr,
+                                    size_t pos,
+                                    bs_log_severity_t severity,
+                                    int errno_value);
+static size_t _bs_log_format(char *buf_ptr,
+                             bs_log_severity_t severity,
+                             const char *file_name_ptr,
+                             int line_num,
+                             const char *fmt_ptr, va_list ap);
+static void _bs_log_emit(const char *buf_ptr,
+                         size_t len,
+                         bs_log_severity_t severity);
+static void _bs_log_write(const char *buf_ptr, size_t len);
+static void _bs_log_writev(struct iovec *iov_ptr, int iovcnt);
+static void _bs_log_async_enqueue(bs_log_async_t *async_ptr,
+                                  const char *buf_ptr,
+                                  size_t len,
+                                  bool block);
+static void *_bs_log_async_thread(void *arg_ptr);
+static void _bs_log_async_report_dropped(bs_log_async_t *async_ptr);
+static size_t _bs_log_async_pending(void);
+static bool _bs_log_async_is_background(void);
+static const char *_bs_log_next_conv(const char *fmt_ptr,
+                                     bs_log_conv_t *conv_ptr);
+static bool _bs_log_binary_put(uint8_t *args_ptr,
+                               size_t *pos_ptr,
+                               const void *src_ptr,
+                               size_t size);
+static size_t _bs_log_binary_encode(uint8_t *args_ptr,
+                                    const char *fmt_ptr,
+                                    va_list ap);
+static size_t _bs_log_binary_decode(char *buf_ptr,
+                                    size_t pos,
+                                    const char *fmt_ptr,
+                                    const uint8_t *args_ptr,
+                                    int errno_value);
+static bool _bs_log_binary_record(bs_log_binary_t *binary_ptr,
+                                  bs_log_severity_t severity,
+                                  const char *file_name_ptr,
+                                  int line_num,
+                                  const char *fmt_ptr, va_list ap);
+static bs_log_binary_buffer_t *_bs_log_binary_buffer(
+    bs_log_binary_t *binary_ptr);
+static void _bs_log_binary_render(bs_log_binary_buffer_t *buffer_ptr);
+static void _bs_log_binary_thread_exit(void *arg_ptr);
 
 /* == Functions ============================================================ */
 
@@ -65,6 +268,244 @@ bool bs_log_init_file(const char *log_filename_ptr,
     return true;
 }
 
+/* ------------------------------------------------------------------------- */
+bool bs_log_async_start(size_t slots, bs_log_async_overflow_t overflow)
+{
+    if (NULL != _log_async_ptr) {
+        bs_log(BS_WARNING, "Asynchronous logging already started.");
+        return true;
+    }
+
+    size_t s = 2;
+    while (s < slots) s <<= 1;
+    bs_log_async_t *async_ptr = calloc(1, sizeof(bs_log_async_t));
+    if (NULL == async_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed calloc(1, %zu)",
+               sizeof(bs_log_async_t));
+        return false;
+    }
+    async_ptr->slots_ptr = calloc(s, sizeof(bs_log_async_slot_t));
+    if (NULL == async_ptr->slots_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed calloc(%zu, %zu)",
+               s, sizeof(bs_log_async_slot_t));
+        free(async_ptr);
+        return false;
+    }
+    async_ptr->overflow = overflow;
+    bs_atomic_int64_set(&async_ptr->enqueued, 0);
+    bs_atomic_int64_set(&async_ptr->written, 0);
+    bs_atomic_int64_set(&async_ptr->dropped, 0);
+
+    async_ptr->free_ring_ptr = bs_mpmc_ring_create(s);
+    if (NULL == async_ptr->free_ring_ptr) goto error_free_ring;
+    for (size_t i = 0; i < s; ++i) {
+        bs_mpmc_ring_push(async_ptr->free_ring_ptr, &async_ptr->slots_ptr[i]);
+    }
+    // Room for all slots, and the NULL from bs_log_async_stop.
+    async_ptr->queue_ring_ptr = bs_mpmc_ring_create(s + 1);
+    if (NULL == async_ptr->queue_ring_ptr) goto error_queue_ring;
+
+    if (!bs_mutex_init(&async_ptr->mutex)) goto error_mutex;
+    if (!bs_cond_init(&async_ptr->done_cond)) goto error_done_cond;
+    int rv = pthread_create(&async_ptr->thread, NULL,
+                            _bs_log_async_thread, async_ptr);
+    if (0 != rv) {
+        errno = rv;
+        bs_log(BS_ERROR | BS_ERRNO, "Failed pthread_create(%p, NULL, %p, %p)",
+               &async_ptr->thread, _bs_log_async_thread, async_ptr);
+        goto error_thread;
+    }
+
+    _log_async_ptr = async_ptr;
+    return true;
+
+error_thread:
+    bs_cond_destroy(&async_ptr->done_cond);
+error_done_cond:
+    bs_mutex_destroy(&async_ptr->mutex);
+error_mutex:
+    bs_mpmc_ring_destroy(async_ptr->queue_ring_ptr);
+error_queue_ring:
+    bs_mpmc_ring_destroy(async_ptr->free_ring_ptr);
+error_free_ring:
+    free(async_ptr->slots_ptr);
+    free(async_ptr);
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_log_async_stop(void)
+{
+    bs_log_async_t *async_ptr = _log_async_ptr;
+    if (NULL == async_ptr) return;
+
+    bool pushed = bs_mpmc_ring_push(async_ptr->queue_ring_ptr, NULL);
+    BS_ASSERT(pushed);
+    int rv = pthread_join(async_ptr->thread, NULL);
+    _log_async_ptr = NULL;
+    if (0 != rv) {
+        errno = rv;
+        bs_log(BS_WARNING | BS_ERRNO, "Failed pthread_join(%p, NULL)",
+               &async_ptr->thread);
+    }
+
+    bs_cond_destroy(&async_ptr->done_cond);
+    bs_mutex_destroy(&async_ptr->mutex);
+    bs_mpmc_ring_destroy(async_ptr->queue_ring_ptr);
+    bs_mpmc_ring_destroy(async_ptr->free_ring_ptr);
+    free(async_ptr->slots_ptr);
+    free(async_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_log_async_flush(void)
+{
+    bs_log_async_t *async_ptr = _log_async_ptr;
+    if (NULL == async_ptr) return;
+
+    int64_t target = bs_atomic_int64_get(&async_ptr->enqueued);
+    bs_mutex_lock(&async_ptr->mutex);
+    while (bs_atomic_int64_get(&async_ptr->written) < target) {
+        bs_cond_wait(&async_ptr->done_cond, &async_ptr->mutex);
+    }
+    bs_mutex_unlock(&async_ptr->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t bs_log_async_dropped(void)
+{
+    if (NULL == _log_async_ptr) return 0;
+    return bs_atomic_int64_get(&_log_async_ptr->dropped);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_log_binary_start(size_t bytes_per_thread)
+{
+    if (NULL != _log_binary_ptr) {
+        bs_log(BS_WARNING, "Binary logging already started.");
+        return true;
+    }
+
+    bs_log_binary_t *binary_ptr = calloc(1, sizeof(bs_log_binary_t));
+    if (NULL == binary_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed calloc(1, %zu)",
+               sizeof(bs_log_binary_t));
+        return false;
+    }
+    binary_ptr->bytes_per_thread = bytes_per_thread;
+    int rv = pthread_key_create(&binary_ptr->key,
+                                _bs_log_binary_thread_exit);
+    if (0 != rv) {
+        errno = rv;
+        bs_log(BS_ERROR | BS_ERRNO, "Failed pthread_key_create(%p, %p)",
+               &binary_ptr->key, _bs_log_binary_thread_exit);
+        free(binary_ptr);
+        return false;
+    }
+    if (!bs_mutex_init(&binary_ptr->mutex)) {
+        pthread_key_delete(binary_ptr->key);
+        free(binary_ptr);
+        return false;
+    }
+
+    _log_binary_ptr = binary_ptr;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_log_binary_stop(void)
+{
+    bs_log_binary_t *binary_ptr = _log_binary_ptr;
+    if (NULL == binary_ptr) return;
+
+    // Further messages are formatted right away.
+    _log_binary_ptr = NULL;
+    pthread_key_delete(binary_ptr->key);
+
+    bs_dllist_node_t *dlnode_ptr;
+    while (NULL != (dlnode_ptr = bs_dllist_pop_front(&binary_ptr->buffers))) {
+        bs_log_binary_buffer_t *buffer_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, bs_log_binary_buffer_t, dlnode);
+        _bs_log_binary_render(buffer_ptr);
+        bs_mutex_destroy(&buffer_ptr->mutex);
+        free(buffer_ptr);
+    }
+    bs_mutex_destroy(&binary_ptr->mutex);
+    free(binary_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_log_binary_flush(void)
+{
+    bs_log_binary_t *binary_ptr = _log_binary_ptr;
+    if (NULL == binary_ptr) return;
+
+    bs_mutex_lock(&binary_ptr->mutex);
+    for (bs_dllist_node_t *dlnode_ptr = binary_ptr->buffers.head_ptr;
+         NULL != dlnode_ptr;
+         dlnode_ptr = dlnode_ptr->next_ptr) {
+        bs_log_binary_buffer_t *buffer_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, bs_log_binary_buffer_t, dlnode);
+        bs_mutex_lock(&buffer_ptr->mutex);
+        _bs_log_binary_render(buffer_ptr);
+        bs_mutex_unlock(&buffer_ptr->mutex);
+    }
+    bs_mutex_unlock(&binary_ptr->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_log_ratelimit_allow(bs_log_ratelimit_t *ratelimit_ptr,
+                            int64_t burst,
+                            uint64_t interval_usec,
+                            int64_t *suppressed_ptr)
+{
+    *suppressed_ptr = 0;
+
+    // The coarse clock is cheap to read, and precise enough for intervals.
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    int64_t now = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+    int64_t start = bs_atomic_int64_get(&ratelimit_ptr->interval_start);
+    if (now - start >= (int64_t)interval_usec) {
+        // The new interval's tag must differ from that of the current count.
+        int64_t calls = bs_atomic_int64_get(&ratelimit_ptr->calls);
+        if (0 == (((uint64_t)now ^ ((uint64_t)calls >> 32)) & UINT32_MAX)) {
+            ++now;
+        }
+        // Whichever call wins, `interval_start` is then the new interval.
+        bs_atomic_int64_cas(&ratelimit_ptr->interval_start, now, start);
+        start = bs_atomic_int64_get(&ratelimit_ptr->interval_start);
+    }
+    uint64_t tag = (uint64_t)start << 32;
+    // The count must not carry into the tag.
+    burst = BS_MIN(burst, (int64_t)UINT32_MAX - 1);
+
+    for (;;) {
+        int64_t calls = bs_atomic_int64_get(&ratelimit_ptr->calls);
+        if (((uint64_t)calls & ~(uint64_t)UINT32_MAX) != tag) {
+            // First call of the interval: Tags it, and resets the count.
+            if (calls != bs_atomic_int64_cas(&ratelimit_ptr->calls,
+                                             (int64_t)(tag | 1), calls)) {
+                continue;
+            }
+            if (0 >= burst) break;
+            int64_t suppressed = 0;
+            bs_atomic_int64_xchg(&ratelimit_ptr->suppressed, &suppressed);
+            *suppressed_ptr = suppressed;
+            return true;
+        }
+
+        if ((calls & UINT32_MAX) >= burst) break;
+        if (calls == bs_atomic_int64_cas(&ratelimit_ptr->calls,
+                                         calls + 1, calls)) {
+            return true;
+        }
+    }
+    bs_atomic_int64_add(&ratelimit_ptr->suppressed, 1);
+    return false;
+}
+
 /* ------------------------------------------------------------------------- */
 void bs_log_write(bs_log_severity_t severity,
                   const char *file_name_ptr,
@@ -84,58 +525,176 @@ void bs_log_vwrite(bs_log_severity_t severity,
                    int line_num,
                    const char *fmt_ptr, va_list ap)
 {
-    char buf[BS_LOG_MAX_BUF_SIZE + 1];
-    size_t pos = 0;
-
-    const char *color_attr_ptr = "";
-    switch (severity & 0x7f) {
-    case BS_DEBUG: color_attr_ptr = "\e[90m"; break;  // Dark gray foreground.
-    case BS_INFO: color_attr_ptr = "\e[37m"; break;  // Light gray foreground.
-    case BS_WARNING: color_attr_ptr = "\e[1;93m"; break;  // Yellow & bold.
-    case BS_ERROR: color_attr_ptr = "\e[1;91m"; break;  // Bright red & bold.
-    case BS_FATAL: color_attr_ptr = "\e[1;97;41m"; break; // White on red,bold.
+    BS_TRACE_SCOPE("bs_log_vwrite");
+    bs_log_binary_t *binary_ptr = _log_binary_ptr;
+    if (NULL != binary_ptr && !_bs_log_async_is_background()) {
+        if ((severity & 0x7f) != BS_FATAL &&
+            _bs_log_binary_record(binary_ptr, severity, file_name_ptr,
+                                  line_num, fmt_ptr, ap)) return;
+        // Keeps the order: Renders what was recorded before.
+        bs_log_binary_flush();
     }
-    char *reset_ptr = "";
-    if (*color_attr_ptr != '\0') {
-        reset_ptr = "\e[0m";
+
+    char buf_ptr[BS_LOG_MAX_BUF_SIZE + 1];
+    size_t len = _bs_log_format(
+        buf_ptr, severity, file_name_ptr, line_num, fmt_ptr, ap);
+    _bs_log_emit(buf_ptr, len, severity);
+
+    if (severity == BS_FATAL) BS_ABORT();
+}
+
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Writes local time `usec` to `buf_ptr`, as "YYYY-MM-DD hh:mm:ss.ccc".
+ * Uses the calling thread's cached date and time, unless the second changed.
+ *
+ * @return BS_LOG_TIMESTAMP_LEN. `buf_ptr` is not NUL-terminated.
+ */
+size_t _bs_log_format_timestamp(char *buf_ptr, uint64_t usec)
+{
+    time_t sec = usec / 1000000;
+    if (sec != _log_timestamp.sec) {
+        struct tm tm;
+        if (NULL == localtime_r(&sec, &tm)) memset(&tm, 0, sizeof(tm));
+        bs_strappendf(
+            _log_timestamp.buf, sizeof(_log_timestamp.buf), 0,
+            "%04d-%02d-%02d %02d:%02d:%02d.000",
+            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+            tm.tm_hour, tm.tm_min, tm.tm_sec);
+        _log_timestamp.sec = sec;
     }
 
-    struct timeval tv;
-    if (0 != gettimeofday(&tv, NULL)) {
-        memset(&tv, 0, sizeof(tv));
+    unsigned msec = (usec / 1000) % 1000;
+    _log_timestamp.buf[BS_LOG_TIMESTAMP_LEN - 3] = '0' + msec / 100;
+    _log_timestamp.buf[BS_LOG_TIMESTAMP_LEN - 2] = '0' + (msec / 10) % 10;
+    _log_timestamp.buf[BS_LOG_TIMESTAMP_LEN - 1] = '0' + msec % 10;
+    memcpy(buf_ptr, _log_timestamp.buf, BS_LOG_TIMESTAMP_LEN);
+    return BS_LOG_TIMESTAMP_LEN;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the color attribute for `severity`. */
+const char *_bs_log_color(bs_log_severity_t severity)
+{
+    switch (severity & 0x7f) {
+    case BS_DEBUG: return "\e[90m";  // Dark gray foreground.
+    case BS_INFO: return "\e[37m";  // Light gray foreground.
+    case BS_WARNING: return "\e[1;93m";  // Yellow & bold.
+    case BS_ERROR: return "\e[1;91m";  // Bright red & bold.
+    case BS_FATAL: return "\e[1;97;41m"; // White on red, bold.
     }
-    struct tm *tm_ptr = localtime(&tv.tv_sec);
+    return "";
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Formats timestamp, severity and source location into `buf_ptr`, which
+ * must hold at least @ref BS_LOG_MAX_BUF_SIZE + 1 bytes.
+ *
+ * @return Position after the prefix. The message text is to follow there.
+ */
+size_t _bs_log_format_prefix(char *buf_ptr,
+                             bs_log_severity_t severity,
+                             const char *file_name_ptr,
+                             int line_num,
+                             uint64_t usec)
+{
+    const char *color_attr_ptr = _bs_log_color(severity);
+    const char *reset_ptr = *color_attr_ptr != '\0' ? "\e[0m" : "";
+
+    size_t pos = _bs_log_format_timestamp(buf_ptr, usec);
     pos = bs_strappendf(
-        buf, BS_LOG_MAX_BUF_SIZE, pos,
-        "%04d-%02d-%02d %02d:%02d:%02d.%03d (%s%s%s) \e[90m%s:%d\e[0m ",
-        tm_ptr->tm_year + 1900, tm_ptr->tm_mon + 1, tm_ptr->tm_mday,
-        tm_ptr->tm_hour, tm_ptr->tm_min, tm_ptr->tm_sec,
-        (int)(tv.tv_usec / 1000),
+        buf_ptr, BS_LOG_MAX_BUF_SIZE, pos,
+        " (%s%s%s) \e[90m%s:%d\e[0m ",
         color_attr_ptr,
         _severity_names[severity & 0x7f],
         reset_ptr,
         _strip_prefix(file_name_ptr), line_num);
+    return bs_strappendf(
+        buf_ptr, BS_LOG_MAX_BUF_SIZE, pos, "%s", color_attr_ptr);
+}
 
-    pos = bs_strappendf(buf, BS_LOG_MAX_BUF_SIZE, pos, "%s", color_attr_ptr);
-    pos = bs_vstrappendf(buf, BS_LOG_MAX_BUF_SIZE, pos, fmt_ptr, ap);
+/* ------------------------------------------------------------------------- */
+/**
+ * Completes the log message in `buf_ptr` at `pos`: Appends errno, if
+ * requested, resets the color, marks truncation and appends the newline.
+ *
+ * @return Length of the message, including the trailing newline.
+ */
+size_t _bs_log_format_suffix(char *buf_ptr,
+                             size_t pos,
+                             bs_log_severity_t severity,
+                             int errno_value)
+{
     if (severity & BS_ERRNO) {
         pos = bs_strappendf(
-            buf, BS_LOG_MAX_BUF_SIZE, pos,
-            ": errno(%d): %s", errno, strerror(errno));
+            buf_ptr, BS_LOG_MAX_BUF_SIZE, pos,
+            ": errno(%d): %s", errno_value, strerror(errno_value));
+    }
+    if (*_bs_log_color(severity) != '\0') {
+        pos = bs_strappendf(buf_ptr, BS_LOG_MAX_BUF_SIZE, pos, "\e[0m");
     }
-    pos = bs_strappendf(buf, BS_LOG_MAX_BUF_SIZE, pos, "%s", reset_ptr);
     if (pos >= BS_LOG_MAX_BUF_SIZE) {
         pos = BS_LOG_MAX_BUF_SIZE;
-        buf[BS_LOG_MAX_BUF_SIZE - 3] = '.';
-        buf[BS_LOG_MAX_BUF_SIZE - 2] = '.';
-        buf[BS_LOG_MAX_BUF_SIZE - 1] = '.';
+        buf_ptr[BS_LOG_MAX_BUF_SIZE - 3] = '.';
+        buf_ptr[BS_LOG_MAX_BUF_SIZE - 2] = '.';
+        buf_ptr[BS_LOG_MAX_BUF_SIZE - 1] = '.';
     }
-    buf[pos++] = '\n';
+    buf_ptr[pos++] = '\n';
+    return pos;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Formats the log message into `buf_ptr`, which must hold at least
+ * @ref BS_LOG_MAX_BUF_SIZE + 1 bytes.
+ *
+ * @return Length of the message, including the trailing newline.
+ */
+size_t _bs_log_format(char *buf_ptr,
+                      bs_log_severity_t severity,
+                      const char *file_name_ptr,
+                      int line_num,
+                      const char *fmt_ptr, va_list ap)
+{
+    int errno_value = errno;
+    size_t pos = _bs_log_format_prefix(
+        buf_ptr, severity, file_name_ptr, line_num, bs_usec());
+    pos = bs_vstrappendf(buf_ptr, BS_LOG_MAX_BUF_SIZE, pos, fmt_ptr, ap);
+    return _bs_log_format_suffix(buf_ptr, pos, severity, errno_value);
+}
 
+/* ------------------------------------------------------------------------- */
+/**
+ * Emits the formatted message: Enqueues it to the asynchronous backend, if
+ * started, or writes it to the log file.
+ */
+void _bs_log_emit(const char *buf_ptr,
+                  size_t len,
+                  bs_log_severity_t severity)
+{
+    // The background thread itself must not wait for the ring.
+    bs_log_async_t *async_ptr = _log_async_ptr;
+    if (NULL != async_ptr && !_bs_log_async_is_background()) {
+        bool fatal = (severity & 0x7f) == BS_FATAL;
+        _bs_log_async_enqueue(async_ptr, buf_ptr, len, fatal);
+        if (fatal) bs_log_async_flush();
+    } else {
+        _bs_log_write(buf_ptr, len);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Writes `len` bytes at `buf_ptr` to the log file. Retries until done. */
+void _bs_log_write(const char *buf_ptr, size_t len)
+{
     size_t written_bytes = 0;
-    while (written_bytes < pos) {
-        ssize_t more_bytes = write(_log_fd, &buf[written_bytes],
-                                   pos - written_bytes);
+    while (written_bytes < len) {
+        ssize_t more_bytes = write(_log_fd, &buf_ptr[written_bytes],
+                                   len - written_bytes);
         if (0 > more_bytes) {
             if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
                 continue;
@@ -144,12 +703,527 @@ void bs_log_vwrite(bs_log_severity_t severity,
         }
         written_bytes += more_bytes;
     }
+}
 
-    if (severity == BS_FATAL) BS_ABORT();
+/* ------------------------------------------------------------------------- */
+/**
+ * Writes all of `iov_ptr` to the log file. Retries until done. Waits for
+ * the file to become writable, rather than spinning. `iov_ptr` is modified.
+ */
+void _bs_log_writev(struct iovec *iov_ptr, int iovcnt)
+{
+    while (0 < iovcnt) {
+        ssize_t more_bytes = writev(_log_fd, iov_ptr, iovcnt);
+        if (0 > more_bytes) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = { .fd = _log_fd, .events = POLLOUT };
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            if (errno == EINTR) continue;
+            abort();
+        }
+        // Skip over what was written, possibly stopping within an iovec.
+        while (0 < iovcnt && (size_t)more_bytes >= iov_ptr->iov_len) {
+            more_bytes -= iov_ptr->iov_len;
+            ++iov_ptr;
+            --iovcnt;
+        }
+        if (0 < iovcnt) {
+            iov_ptr->iov_base = (char*)iov_ptr->iov_base + more_bytes;
+            iov_ptr->iov_len -= more_bytes;
+        }
+    }
 }
 
+/* ------------------------------------------------------------------------- */
+/**
+ * Enqueues the message. If no slot is free, drops the message or waits for
+ * a free slot, as configured. Waits always, if `block` is set.
+ */
+void _bs_log_async_enqueue(bs_log_async_t *async_ptr,
+                           const char *buf_ptr,
+                           size_t len,
+                           bool block)
+{
+    void *ptr;
+    if (!bs_mpmc_ring_pop(async_ptr->free_ring_ptr, &ptr)) {
+        if (!block && BS_LOG_ASYNC_DROP == async_ptr->overflow) {
+            bs_atomic_int64_add(&async_ptr->dropped, 1);
+            return;
+        }
+        while (!bs_mpmc_ring_pop_wait(async_ptr->free_ring_ptr, &ptr,
+                                      1000000)) continue;
+    }
+
+    bs_log_async_slot_t *slot_ptr = ptr;
+    memcpy(slot_ptr->buf, buf_ptr, len);
+    slot_ptr->len = len;
+    // Counted first, so that `written` never exceeds `enqueued`.
+    bs_atomic_int64_add(&async_ptr->enqueued, 1);
+    // Cannot fail: The queue holds all slots.
+    bool pushed = bs_mpmc_ring_push(async_ptr->queue_ring_ptr, slot_ptr);
+    BS_ASSERT(pushed);
+}
 
-/* == Local (static) methods =============================================== */
+/* ------------------------------------------------------------------------- */
+/**
+ * Main loop of the background thread: Writes batches of queued messages,
+ * and waits while there are none. Exits on the NULL element queued by
+ * @ref bs_log_async_stop, once the queue is drained.
+ */
+void *_bs_log_async_thread(void *arg_ptr)
+{
+    bs_log_async_t *async_ptr = arg_ptr;
+    bs_log_async_slot_t *slot_ptrs[BS_LOG_ASYNC_BATCH];
+    struct iovec iov[BS_LOG_ASYNC_BATCH];
+    bool shutdown = false;
+
+    for (;;) {
+        void *ptr;
+        if (!bs_mpmc_ring_pop(async_ptr->queue_ring_ptr, &ptr)) {
+            if (shutdown) break;
+            _bs_log_async_report_dropped(async_ptr);
+            if (!bs_mpmc_ring_pop_wait(async_ptr->queue_ring_ptr, &ptr,
+                                       1000000)) continue;
+        }
+
+        int n = 0;
+        do {
+            if (NULL == ptr) {
+                shutdown = true;
+                continue;
+            }
+            slot_ptrs[n] = ptr;
+            iov[n].iov_base = slot_ptrs[n]->buf;
+            iov[n].iov_len = slot_ptrs[n]->len;
+            ++n;
+        } while (n < BS_LOG_ASYNC_BATCH &&
+                 bs_mpmc_ring_pop(async_ptr->queue_ring_ptr, &ptr));
+        if (0 == n) continue;
+
+        _bs_log_writev(iov, n);
+        for (int i = 0; i < n; ++i) {
+            bs_mpmc_ring_push(async_ptr->free_ring_ptr, slot_ptrs[i]);
+        }
+        bs_mutex_lock(&async_ptr->mutex);
+        bs_atomic_int64_add(&async_ptr->written, n);
+        bs_cond_broadcast(&async_ptr->done_cond);
+        bs_mutex_unlock(&async_ptr->mutex);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Logs the number of dropped messages, if there were new drops. */
+void _bs_log_async_report_dropped(bs_log_async_t *async_ptr)
+{
+    int64_t dropped = bs_atomic_int64_get(&async_ptr->dropped);
+    if (dropped == async_ptr->reported_dropped) return;
+    bs_log(BS_WARNING, "Dropped %"PRId64" log messages, ring full.",
+           dropped - async_ptr->reported_dropped);
+    async_ptr->reported_dropped = dropped;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the number of enqueued, but not yet written messages. */
+size_t _bs_log_async_pending(void)
+{
+    if (NULL == _log_async_ptr) return 0;
+    return bs_atomic_int64_get(&_log_async_ptr->enqueued) -
+        bs_atomic_int64_get(&_log_async_ptr->written);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns whether the caller is the asynchronous backend's thread. */
+bool _bs_log_async_is_background(void)
+{
+    bs_log_async_t *async_ptr = _log_async_ptr;
+    return (NULL != async_ptr &&
+            pthread_equal(pthread_self(), async_ptr->thread));
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Finds the next conversion specification in `fmt_ptr`, and determines the
+ * type of argument it consumes. Understands flags, width and precision as
+ * digits or '*', and the length modifiers of C11 plus 'q'.
+ *
+ * @param fmt_ptr
+ * @param conv_ptr            Output: The specification.
+ *
+ * @return Pointer to just after the specification, or NULL if there is no
+ *     further specification.
+ */
+const char *_bs_log_next_conv(const char *fmt_ptr, bs_log_conv_t *conv_ptr)
+{
+    const char *p = strchr(fmt_ptr, '%');
+    if (NULL == p) return NULL;
+    *conv_ptr = (bs_log_conv_t){ .begin_ptr = p, .precision = -1 };
+
+    ++p;
+    while ('\0' != *p && NULL != strchr("-+ #0'I", *p)) ++p;
+    if ('*' == *p) {
+        ++conv_ptr->stars;
+        ++p;
+    } else {
+        while (isdigit((unsigned char)*p)) ++p;
+    }
+    if ('.' == *p) {
+        ++p;
+        if ('*' == *p) {
+            ++conv_ptr->stars;
+            conv_ptr->precision_star = true;
+            ++p;
+        } else {
+            conv_ptr->precision = 0;
+            for (; isdigit((unsigned char)*p); ++p) {
+                if (conv_ptr->precision < BS_LOG_MAX_BUF_SIZE) {
+                    conv_ptr->precision =
+                        conv_ptr->precision * 10 + (*p - '0');
+                }
+            }
+        }
+    }
+
+    unsigned longs = 0;
+    char modifier = '\0';
+    for (; '\0' != *p && NULL != strchr("hljztLq", *p); ++p) {
+        if ('l' == *p) ++longs;
+        modifier = *p;
+    }
+
+    switch (*p) {
+    case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+        if ('j' == modifier) {
+            conv_ptr->arg = BS_LOG_ARG_INTMAX;
+        } else if ('z' == modifier) {
+            conv_ptr->arg = BS_LOG_ARG_SIZE;
+        } else if ('t' == modifier) {
+            conv_ptr->arg = BS_LOG_ARG_PTRDIFF;
+        } else if (2 <= longs || 'q' == modifier || 'L' == modifier) {
+            conv_ptr->arg = BS_LOG_ARG_LLONG;
+        } else if (1 == longs) {
+            conv_ptr->arg = BS_LOG_ARG_LONG;
+        } else {
+            conv_ptr->arg = BS_LOG_ARG_INT;
+        }
+        break;
+    case 'c': case 'C':
+        conv_ptr->arg = BS_LOG_ARG_INT;
+        break;
+    case 'e': case 'E': case 'f': case 'F':
+    case 'g': case 'G': case 'a': case 'A':
+        conv_ptr->arg = 'L' == modifier ?
+            BS_LOG_ARG_LDOUBLE : BS_LOG_ARG_DOUBLE;
+        break;
+    case 's':
+        // Wide strings are referenced, not copied.
+        conv_ptr->arg = 0 < longs ? BS_LOG_ARG_PTR : BS_LOG_ARG_STR;
+        break;
+    case 'S': case 'p':
+        conv_ptr->arg = BS_LOG_ARG_PTR;
+        break;
+    case 'n':
+        conv_ptr->arg = BS_LOG_ARG_COUNT;
+        break;
+    case '%': case 'm':
+        conv_ptr->arg = BS_LOG_ARG_NONE;
+        break;
+    default:
+        conv_ptr->arg = BS_LOG_ARG_UNKNOWN;
+        break;
+    }
+    if ('\0' != *p) ++p;
+    conv_ptr->len = p - conv_ptr->begin_ptr;
+    return p;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Appends `size` bytes at `src_ptr` to the arguments, if there is room. */
+bool _bs_log_binary_put(uint8_t *args_ptr,
+                        size_t *pos_ptr,
+                        const void *src_ptr,
+                        size_t size)
+{
+    if (*pos_ptr + size > BS_LOG_BINARY_MAX_ARGS) return false;
+    memcpy(args_ptr + *pos_ptr, src_ptr, size);
+    *pos_ptr += size;
+    return true;
+}
+
+/** Records the next argument, of type `_type`. Helper to encode. */
+#define _BS_LOG_BINARY_PUT_ARG(_type) {                                 \
+        _type _v = va_arg(ap, _type);                                   \
+        ok = ok && _bs_log_binary_put(args_ptr, &pos, &_v, sizeof(_v)); \
+    } break
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Records the raw arguments for `fmt_ptr` into `args_ptr`. Strings are
+ * copied, up to their precision, and prefixed with whether they are NULL.
+ *
+ * @param args_ptr            Holds at least @ref BS_LOG_BINARY_MAX_ARGS.
+ * @param fmt_ptr
+ * @param ap
+ *
+ * @return Bytes used in `args_ptr`, or SIZE_MAX if they did not fit.
+ */
+size_t _bs_log_binary_encode(uint8_t *args_ptr,
+                             const char *fmt_ptr,
+                             va_list ap)
+{
+    size_t pos = 0;
+    bool ok = true;
+    bs_log_conv_t conv;
+    while (ok && NULL != (fmt_ptr = _bs_log_next_conv(fmt_ptr, &conv))) {
+        int star = 0;
+        for (unsigned i = 0; i < conv.stars; ++i) {
+            star = va_arg(ap, int);
+            ok = ok && _bs_log_binary_put(args_ptr, &pos, &star, sizeof(star));
+        }
+
+        switch (conv.arg) {
+        case BS_LOG_ARG_INT: _BS_LOG_BINARY_PUT_ARG(int);
+        case BS_LOG_ARG_LONG: _BS_LOG_BINARY_PUT_ARG(long);
+        case BS_LOG_ARG_LLONG: _BS_LOG_BINARY_PUT_ARG(long long);
+        case BS_LOG_ARG_INTMAX: _BS_LOG_BINARY_PUT_ARG(intmax_t);
+        case BS_LOG_ARG_SIZE: _BS_LOG_BINARY_PUT_ARG(size_t);
+        case BS_LOG_ARG_PTRDIFF: _BS_LOG_BINARY_PUT_ARG(ptrdiff_t);
+        case BS_LOG_ARG_DOUBLE: _BS_LOG_BINARY_PUT_ARG(double);
+        case BS_LOG_ARG_LDOUBLE: _BS_LOG_BINARY_PUT_ARG(long double);
+        case BS_LOG_ARG_PTR: _BS_LOG_BINARY_PUT_ARG(void*);
+        case BS_LOG_ARG_COUNT:
+            va_arg(ap, void*);
+            break;
+        case BS_LOG_ARG_STR: {
+            const char *str_ptr = va_arg(ap, const char*);
+            uint8_t present = NULL != str_ptr;
+            ok = ok && _bs_log_binary_put(args_ptr, &pos, &present, 1);
+            if (!present) break;
+            int precision = conv.precision_star ? star : conv.precision;
+            size_t len = strnlen(str_ptr, 0 <= precision ?
+                                 (size_t)precision : BS_LOG_BINARY_MAX_ARGS);
+            ok = (ok && _bs_log_binary_put(args_ptr, &pos, str_ptr, len) &&
+                  _bs_log_binary_put(args_ptr, &pos, "", 1));
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return ok ? pos : SIZE_MAX;
+}
+
+#undef _BS_LOG_BINARY_PUT_ARG
+
+/** Renders the next argument, of type `_type`. Helper to decode. */
+#define _BS_LOG_BINARY_GET_ARG(_type) {                                 \
+        _type _v;                                                       \
+        memcpy(&_v, args_ptr, sizeof(_v));                              \
+        args_ptr += sizeof(_v);                                         \
+        pos = bs_strappendf(buf_ptr, BS_LOG_MAX_BUF_SIZE, pos, spec, _v); \
+    } break
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Renders `fmt_ptr` with the arguments recorded by _bs_log_binary_encode()
+ * into `buf_ptr` at `pos`. Values of '*' are substituted into each
+ * specification, so the output matches formatting the original arguments.
+ *
+ * @return The position after the rendered text.
+ */
+size_t _bs_log_binary_decode(char *buf_ptr,
+                             size_t pos,
+                             const char *fmt_ptr,
+                             const uint8_t *args_ptr,
+                             int errno_value)
+{
+    bs_log_conv_t conv;
+    const char *next_ptr;
+    char spec[64];
+    while (NULL != (next_ptr = _bs_log_next_conv(fmt_ptr, &conv))) {
+        pos = bs_strappendf(buf_ptr, BS_LOG_MAX_BUF_SIZE, pos, "%.*s",
+                            (int)(conv.begin_ptr - fmt_ptr), fmt_ptr);
+        fmt_ptr = next_ptr;
+
+        // Copies the specification, substituting the values for '*'.
+        size_t spec_pos = 0;
+        for (size_t i = 0; i < conv.len && spec_pos < sizeof(spec); ++i) {
+            if ('*' != conv.begin_ptr[i]) {
+                spec[spec_pos++] = conv.begin_ptr[i];
+                continue;
+            }
+            int star;
+            memcpy(&star, args_ptr, sizeof(star));
+            args_ptr += sizeof(star);
+            if ('.' == conv.begin_ptr[i - 1] && 0 > star) {
+                // A negative precision is taken as if it were omitted.
+                --spec_pos;
+                continue;
+            }
+            spec_pos = bs_strappendf(spec, sizeof(spec), spec_pos, "%d", star);
+        }
+        if (spec_pos >= sizeof(spec)) conv.arg = BS_LOG_ARG_UNKNOWN;
+        spec[BS_MIN(spec_pos, sizeof(spec) - 1)] = '\0';
+
+        switch (conv.arg) {
+        case BS_LOG_ARG_INT: _BS_LOG_BINARY_GET_ARG(int);
+        case BS_LOG_ARG_LONG: _BS_LOG_BINARY_GET_ARG(long);
+        case BS_LOG_ARG_LLONG: _BS_LOG_BINARY_GET_ARG(long long);
+        case BS_LOG_ARG_INTMAX: _BS_LOG_BINARY_GET_ARG(intmax_t);
+        case BS_LOG_ARG_SIZE: _BS_LOG_BINARY_GET_ARG(size_t);
+        case BS_LOG_ARG_PTRDIFF: _BS_LOG_BINARY_GET_ARG(ptrdiff_t);
+        case BS_LOG_ARG_DOUBLE: _BS_LOG_BINARY_GET_ARG(double);
+        case BS_LOG_ARG_LDOUBLE: _BS_LOG_BINARY_GET_ARG(long double);
+        case BS_LOG_ARG_PTR: _BS_LOG_BINARY_GET_ARG(void*);
+        case BS_LOG_ARG_STR: {
+            const char *str_ptr = NULL;
+            if (*args_ptr++) {
+                str_ptr = (const char*)args_ptr;
+                args_ptr += strlen(str_ptr) + 1;
+            }
+            pos = bs_strappendf(
+                buf_ptr, BS_LOG_MAX_BUF_SIZE, pos, spec, str_ptr);
+            break;
+        }
+        case BS_LOG_ARG_NONE:
+            // "%m" refers to errno. The unused argument keeps `spec` from
+            // being taken as a format without arguments.
+            errno = errno_value;
+            pos = bs_strappendf(buf_ptr, BS_LOG_MAX_BUF_SIZE, pos, spec, 0);
+            break;
+        case BS_LOG_ARG_COUNT:
+            break;
+        default:
+            pos = bs_strappendf(buf_ptr, BS_LOG_MAX_BUF_SIZE, pos, "%.*s",
+                                (int)conv.len, conv.begin_ptr);
+            break;
+        }
+    }
+    return bs_strappendf(buf_ptr, BS_LOG_MAX_BUF_SIZE, pos, "%s", fmt_ptr);
+}
+
+#undef _BS_LOG_BINARY_GET_ARG
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Records the log message into the calling thread's buffer. If the buffer
+ * is full, it's rendered first.
+ *
+ * Does not log errors, as that would recurse into here.
+ *
+ * @return false if the message could not be recorded, eg. if the arguments
+ *     are too large. It must then be formatted right away.
+ */
+bool _bs_log_binary_record(bs_log_binary_t *binary_ptr,
+                           bs_log_severity_t severity,
+                           const char *file_name_ptr,
+                           int line_num,
+                           const char *fmt_ptr, va_list ap)
+{
+    uint8_t data[sizeof(bs_log_binary_record_t) + BS_LOG_BINARY_MAX_ARGS];
+    bs_log_binary_record_t record = {
+        .errno_value = errno,
+        .usec = bs_usec(),
+        .fmt_ptr = fmt_ptr,
+        .file_name_ptr = file_name_ptr,
+        .line_num = line_num,
+        .severity = severity
+    };
+
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    size_t args_size = _bs_log_binary_encode(
+        data + sizeof(record), fmt_ptr, ap_copy);
+    va_end(ap_copy);
+    if (SIZE_MAX == args_size) return false;
+    record.args_size = args_size;
+    memcpy(data, &record, sizeof(record));
+    size_t size = sizeof(record) + args_size;
+
+    bs_log_binary_buffer_t *buffer_ptr = _bs_log_binary_buffer(binary_ptr);
+    if (NULL == buffer_ptr || size > buffer_ptr->size) return false;
+    bs_mutex_lock(&buffer_ptr->mutex);
+    if (buffer_ptr->used + size > buffer_ptr->size) {
+        _bs_log_binary_render(buffer_ptr);
+    }
+    memcpy(buffer_ptr->data_ptr + buffer_ptr->used, data, size);
+    buffer_ptr->used += size;
+    bs_mutex_unlock(&buffer_ptr->mutex);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the calling thread's buffer. Creates it, if needed. */
+bs_log_binary_buffer_t *_bs_log_binary_buffer(bs_log_binary_t *binary_ptr)
+{
+    bs_log_binary_buffer_t *buffer_ptr = pthread_getspecific(binary_ptr->key);
+    if (NULL != buffer_ptr) return buffer_ptr;
+
+    buffer_ptr = calloc(
+        1, sizeof(bs_log_binary_buffer_t) + binary_ptr->bytes_per_thread);
+    if (NULL == buffer_ptr) return NULL;
+    buffer_ptr->data_ptr = (uint8_t*)(buffer_ptr + 1);
+    buffer_ptr->size = binary_ptr->bytes_per_thread;
+    if (0 != pthread_mutex_init(&buffer_ptr->mutex, NULL)) {
+        free(buffer_ptr);
+        return NULL;
+    }
+    if (0 != pthread_setspecific(binary_ptr->key, buffer_ptr)) {
+        pthread_mutex_destroy(&buffer_ptr->mutex);
+        free(buffer_ptr);
+        return NULL;
+    }
+
+    bs_mutex_lock(&binary_ptr->mutex);
+    bs_dllist_push_back(&binary_ptr->buffers, &buffer_ptr->dlnode);
+    bs_mutex_unlock(&binary_ptr->mutex);
+    return buffer_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Renders and emits all records of `buffer_ptr`. Must hold its mutex. */
+void _bs_log_binary_render(bs_log_binary_buffer_t *buffer_ptr)
+{
+    char buf_ptr[BS_LOG_MAX_BUF_SIZE + 1];
+    size_t offset = 0;
+    while (offset < buffer_ptr->used) {
+        bs_log_binary_record_t record;
+        memcpy(&record, buffer_ptr->data_ptr + offset, sizeof(record));
+        offset += sizeof(record);
+
+        size_t pos = _bs_log_format_prefix(
+            buf_ptr, record.severity, record.file_name_ptr, record.line_num,
+            record.usec);
+        pos = _bs_log_binary_decode(
+            buf_ptr, pos, record.fmt_ptr, buffer_ptr->data_ptr + offset,
+            record.errno_value);
+        pos = _bs_log_format_suffix(
+            buf_ptr, pos, record.severity, record.errno_value);
+        _bs_log_emit(buf_ptr, pos, record.severity);
+        offset += record.args_size;
+    }
+    buffer_ptr->used = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Destructor of the thread's buffer: Renders the records, then frees. */
+void _bs_log_binary_thread_exit(void *arg_ptr)
+{
+    bs_log_binary_buffer_t *buffer_ptr = arg_ptr;
+    bs_log_binary_t *binary_ptr = _log_binary_ptr;
+
+    bs_mutex_lock(&binary_ptr->mutex);
+    bs_dllist_remove(&binary_ptr->buffers, &buffer_ptr->dlnode);
+    bs_mutex_unlock(&binary_ptr->mutex);
+
+    bs_mutex_lock(&buffer_ptr->mutex);
+    _bs_log_binary_render(buffer_ptr);
+    bs_mutex_unlock(&buffer_ptr->mutex);
+    bs_mutex_destroy(&buffer_ptr->mutex);
+    free(buffer_ptr);
+}
 
 /** Strips leading relative (or absolute) path prefix. */
 const char *_strip_prefix(const char *path_ptr)
@@ -225,11 +1299,33 @@ void verify_log_output_equals_at(
 }
 
 static void test_strip_prefix(bs_test_t *test_ptr);
+static void test_timestamp(bs_test_t *test_ptr);
 static void test_log(bs_test_t *test_ptr);
+static void test_log_async(bs_test_t *test_ptr);
+static void test_log_binary(bs_test_t *test_ptr);
+static void test_log_every_n(bs_test_t *test_ptr);
+static void test_log_ratelimited(bs_test_t *test_ptr);
+static void *_test_log_binary_thread(void *arg_ptr);
 
 const bs_test_case_t          bs_log_test_cases[] = {
     { 1, "basename", test_strip_prefix },
+    { 1, "timestamp", test_timestamp },
     { 1, "log", test_log },
+    { 1, "log_async", test_log_async },
+    { 1, "log_binary", test_log_binary },
+    { 1, "log_every_n", test_log_every_n },
+    { 1, "log_ratelimited", test_log_ratelimited },
+    { 0, NULL, NULL }
+};
+
+static void benchmark_text(bs_test_t *test_ptr);
+static void benchmark_binary(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t          bs_log_benchmarks[] = {
+    { 1, "benchmark-log-text", benchmark_text },
+    { 1, "benchmark-log-binary", benchmark_binary },
     { 0, NULL, NULL }
 };
 
@@ -245,6 +1341,36 @@ void test_strip_prefix(bs_test_t *test_ptr)
     BS_TEST_VERIFY_STREQ(test_ptr, ".", _strip_prefix("/."));
 }
 
+/* ------------------------------------------------------------------------- */
+/** Verifies the timestamp's format, and that the cache follows the time. */
+void test_timestamp(bs_test_t *test_ptr)
+{
+    char buf[BS_LOG_TIMESTAMP_LEN + 1];
+    static const char pattern[] = "dddd-dd-dd dd:dd:dd.ddd";
+
+    for (int i = 0; i < 2; ++i) {
+        memset(buf, 0, sizeof(buf));
+        BS_TEST_VERIFY_EQ(test_ptr, BS_LOG_TIMESTAMP_LEN,
+                          _bs_log_format_timestamp(buf, bs_usec()));
+        for (size_t p = 0; p < BS_LOG_TIMESTAMP_LEN; ++p) {
+            bool match = 'd' == pattern[p] ?
+                isdigit((unsigned char)buf[p]) : pattern[p] == buf[p];
+            if (!match) {
+                BS_TEST_FAIL(test_ptr, "Unexpected timestamp \"%s\"", buf);
+                break;
+            }
+        }
+        // Force re-formatting the cached date and time.
+        _log_timestamp.sec = -1;
+    }
+
+    time_t sec = time(NULL);
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    _bs_log_format_timestamp(buf, bs_usec());
+    BS_TEST_VERIFY_EQ(test_ptr, tm.tm_year + 1900, atoi(buf));
+}
+
 /* ------------------------------------------------------------------------- */
 void test_log(bs_test_t *test_ptr)
 {
@@ -303,4 +1429,367 @@ void test_log(bs_test_t *test_ptr)
     bs_log_severity = backup_severity;
 }
 
+/* ------------------------------------------------------------------------- */
+void test_log_async(bs_test_t *test_ptr)
+{
+    char                      expected_output[BS_LOG_MAX_BUF_SIZE + 1];
+    char                      buf[4096];
+
+    int fds[2];
+    if (0 != pipe(fds)) {
+        BS_TEST_FAIL(
+            test_ptr,
+            "Failed pipe(%p): errno(%d): %s", fds, errno, strerror(errno));
+        return;
+    }
+    if (!bs_sock_set_blocking(fds[0], false) ||
+        !bs_sock_set_blocking(fds[1], false)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_sock_set_blocking(%d|%d, false)",
+                     fds[0], fds[1]);
+        goto cleanup;
+    }
+    _log_fd = fds[1];
+
+    if (!bs_log_async_start(16, BS_LOG_ASYNC_BLOCK)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_log_async_start(16, BLOCK)");
+        goto cleanup;
+    }
+    snprintf(expected_output, sizeof(expected_output),
+             "(\e[1;93mWARNING\e[0m) \e[90mlog.c:%d\e[0m \e[1;93mtest 46\e[0m\n",
+             __LINE__ + 1);
+    bs_log(BS_WARNING, "test %d", 46);
+    bs_log_async_flush();
+    verify_log_output_equals_at(
+        test_ptr, __FILE__, __LINE__, fds[0], expected_output);
+    bs_log_async_stop();
+
+    // Fill the pipe, so the background thread stalls. The ring overflows.
+    memset(buf, ' ', sizeof(buf));
+    while (0 < write(fds[1], buf, sizeof(buf))) continue;
+    while (0 < write(fds[1], buf, 1)) continue;
+    if (!bs_log_async_start(4, BS_LOG_ASYNC_DROP)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_log_async_start(4, DROP)");
+        goto cleanup;
+    }
+    for (int i = 0; i < 20; ++i) bs_log(BS_WARNING, "test %d", i);
+    BS_TEST_VERIFY_TRUE(test_ptr, 0 < bs_log_async_dropped());
+
+    // Drain. Includes the report on dropped messages.
+    while (0 < _bs_log_async_pending() ||
+           0 < bs_sock_poll_read(fds[0], 50)) {
+        while (0 < read(fds[0], buf, sizeof(buf))) continue;
+    }
+    bs_log_async_stop();
+    while (0 < read(fds[0], buf, sizeof(buf))) continue;
+
+cleanup:
+    _log_fd = 2;
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Line of the log call in _test_log_binary_thread(). */
+static int _test_log_binary_line;
+
+/* ------------------------------------------------------------------------- */
+/** Logs one message from a separate thread, which then exits. */
+void *_test_log_binary_thread(__UNUSED__ void *arg_ptr)
+{
+    _test_log_binary_line = __LINE__ + 1;
+    bs_log(BS_WARNING, "thread %d", 49);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies binary logging renders the same text as formatting does. */
+void test_log_binary(bs_test_t *test_ptr)
+{
+    char                      expected_output[BS_LOG_MAX_BUF_SIZE + 1];
+    char                      msg[256];
+    char                      long_str[BS_LOG_MAX_BUF_SIZE + 1];
+
+    int fds[2];
+    if (0 != pipe(fds)) {
+        BS_TEST_FAIL(
+            test_ptr,
+            "Failed pipe(%p): errno(%d): %s", fds, errno, strerror(errno));
+        return;
+    }
+    if (!bs_sock_set_blocking(fds[0], false)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_sock_set_blocking(%d, false)",
+                     fds[0]);
+        goto cleanup;
+    }
+    _log_fd = fds[1];
+    if (!bs_log_binary_start(4096)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_log_binary_start(4096)");
+        goto cleanup;
+    }
+
+#define _TEST_FMT "%d %s|%5.2f %c|%-4s|%*d|%.*s|%ld %zu %#x %Lg %p 100%%"
+#define _TEST_ARGS 47, "str", 3.14159, 'x', "ab", -4, 7, 3, "abcdef", \
+        -5L, (size_t)8, 255u, (long double)0.5, (void*)NULL
+    snprintf(msg, sizeof(msg), _TEST_FMT, _TEST_ARGS);
+    snprintf(expected_output, sizeof(expected_output),
+             "(\e[1;93mWARNING\e[0m) \e[90mlog.c:%d\e[0m \e[1;93m%s\e[0m\n",
+             __LINE__ + 1, msg);
+    bs_log(BS_WARNING, _TEST_FMT, _TEST_ARGS);
+#undef _TEST_ARGS
+#undef _TEST_FMT
+    // Nothing is written, until flushed.
+    verify_log_output_equals_at(test_ptr, __FILE__, __LINE__, fds[0], NULL);
+    bs_log_binary_flush();
+    verify_log_output_equals_at(
+        test_ptr, __FILE__, __LINE__, fds[0], expected_output);
+
+    // errno is taken at the time of logging.
+    snprintf(expected_output, sizeof(expected_output),
+             "(\e[1;91mERROR\e[0m) \e[90mlog.c:%d\e[0m \e[1;91mtest 48"
+             ": errno(%d): Permission denied\e[0m\n",
+             __LINE__ + 2, EACCES);
+    errno = EACCES;
+    bs_log(BS_ERROR | BS_ERRNO, "test %d", 48);
+    errno = 0;
+    bs_log_binary_flush();
+    verify_log_output_equals_at(
+        test_ptr, __FILE__, __LINE__, fds[0], expected_output);
+
+    // A thread's records are rendered when it exits.
+    pthread_t thread;
+    BS_TEST_VERIFY_EQ_OR_RETURN(
+        test_ptr, 0,
+        pthread_create(&thread, NULL, _test_log_binary_thread, NULL));
+    pthread_join(thread, NULL);
+    snprintf(expected_output, sizeof(expected_output),
+             "(\e[1;93mWARNING\e[0m) \e[90mlog.c:%d\e[0m "
+             "\e[1;93mthread 49\e[0m\n",
+             _test_log_binary_line);
+    verify_log_output_equals_at(
+        test_ptr, __FILE__, __LINE__, fds[0], expected_output);
+
+    // Too large to record: Formatted right away, and truncated.
+    memset(long_str, 'a', sizeof(long_str) - 1);
+    long_str[sizeof(long_str) - 1] = '\0';
+    bs_log(BS_WARNING, "%s", long_str);
+    BS_TEST_VERIFY_EQ(test_ptr, BS_LOG_MAX_BUF_SIZE + 1,
+                      read(fds[0], long_str, sizeof(long_str)));
+    BS_TEST_VERIFY_EQ(test_ptr, '\n', long_str[BS_LOG_MAX_BUF_SIZE]);
+
+    bs_log_binary_stop();
+
+cleanup:
+    _log_fd = 2;
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies that every n-th call of the site is logged. */
+void test_log_every_n(bs_test_t *test_ptr)
+{
+    char                      expected_output[BS_LOG_MAX_BUF_SIZE + 1];
+
+    int fds[2];
+    if (0 != pipe(fds)) {
+        BS_TEST_FAIL(
+            test_ptr,
+            "Failed pipe(%p): errno(%d): %s", fds, errno, strerror(errno));
+        return;
+    }
+    if (!bs_sock_set_blocking(fds[0], false)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_sock_set_blocking(%d, false)",
+                     fds[0]);
+        goto cleanup;
+    }
+    _log_fd = fds[1];
+
+    for (int i = 0; i < 9; ++i) {
+        snprintf(expected_output, sizeof(expected_output),
+                 "(\e[1;93mWARNING\e[0m) \e[90mlog.c:%d\e[0m "
+                 "\e[1;93mtest %d\e[0m\n", __LINE__ + 1, i);
+        bs_log_every_n(4, BS_WARNING, "test %d", i);
+        verify_log_output_equals_at(
+            test_ptr, __FILE__, __LINE__, fds[0],
+            0 == i % 4 ? expected_output : NULL);
+    }
+
+    // Calls below the severity are not counted.
+    for (int i = 0; i < 3; ++i) {
+        snprintf(expected_output, sizeof(expected_output),
+                 "(\e[1;93mWARNING\e[0m) \e[90mlog.c:%d\e[0m "
+                 "\e[1;93mtest %d\e[0m\n", __LINE__ + 1, i);
+        bs_log_every_n(2, 1 == i ? BS_DEBUG : BS_WARNING, "test %d", i);
+        verify_log_output_equals_at(
+            test_ptr, __FILE__, __LINE__, fds[0],
+            0 == i ? expected_output : NULL);
+    }
+
+    // With n == 1, every call is logged.
+    for (int i = 0; i < 3; ++i) {
+        snprintf(expected_output, sizeof(expected_output),
+                 "(\e[1;93mWARNING\e[0m) \e[90mlog.c:%d\e[0m "
+                 "\e[1;93mtest %d\e[0m\n", __LINE__ + 1, i);
+        bs_log_every_n(1, BS_WARNING, "test %d", i);
+        verify_log_output_equals_at(
+            test_ptr, __FILE__, __LINE__, fds[0], expected_output);
+    }
+
+    // Same for n == 0, and a negative n.
+    for (int i = 0; i < 6; ++i) {
+        snprintf(expected_output, sizeof(expected_output),
+                 "(\e[1;93mWARNING\e[0m) \e[90mlog.c:%d\e[0m "
+                 "\e[1;93mtest %d\e[0m\n", __LINE__ + 1, i);
+        bs_log_every_n(i % 2 ? 0 : -3, BS_WARNING, "test %d", i);
+        verify_log_output_equals_at(
+            test_ptr, __FILE__, __LINE__, fds[0], expected_output);
+    }
+
+cleanup:
+    _log_fd = 2;
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies rate limiting, and the summary of suppressed messages. */
+void test_log_ratelimited(bs_test_t *test_ptr)
+{
+    char                      expected_output[BS_LOG_MAX_BUF_SIZE + 1];
+    bs_log_ratelimit_t        ratelimit = BS_LOG_RATELIMIT_INIT;
+    int64_t                   suppressed;
+
+    for (int i = 0; i < 5; ++i) {
+        BS_TEST_VERIFY_EQ(
+            test_ptr, i < 2,
+            bs_log_ratelimit_allow(&ratelimit, 2, 1000000000, &suppressed));
+        BS_TEST_VERIFY_EQ(test_ptr, 0, suppressed);
+    }
+    // Forces a new interval.
+    bs_atomic_int64_set(&ratelimit.interval_start, INT64_MIN / 2);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_log_ratelimit_allow(&ratelimit, 2, 1000000000, &suppressed));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, suppressed);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_log_ratelimit_allow(&ratelimit, 2, 1000000000, &suppressed));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, suppressed);
+
+    // Without burst, nothing is permitted, and suppressed calls are kept.
+    bs_log_ratelimit_t        ratelimit0 = BS_LOG_RATELIMIT_INIT;
+    for (int i = 0; i < 3; ++i) {
+        BS_TEST_VERIFY_FALSE(
+            test_ptr,
+            bs_log_ratelimit_allow(&ratelimit0, 0, 1000000000, &suppressed));
+        BS_TEST_VERIFY_EQ(test_ptr, 0, suppressed);
+        bs_atomic_int64_set(&ratelimit0.interval_start, INT64_MIN / 2);
+    }
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 3, bs_atomic_int64_get(&ratelimit0.suppressed));
+
+    int fds[2];
+    if (0 != pipe(fds)) {
+        BS_TEST_FAIL(
+            test_ptr,
+            "Failed pipe(%p): errno(%d): %s", fds, errno, strerror(errno));
+        return;
+    }
+    if (!bs_sock_set_blocking(fds[0], false)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_sock_set_blocking(%d, false)",
+                     fds[0]);
+        goto cleanup;
+    }
+    _log_fd = fds[1];
+
+    // 1 message per 50ms: Logs the first, then suppresses 2, then summarizes.
+    for (int i = 0; i < 4; ++i) {
+        if (3 == i) usleep(100000);
+        int line = __LINE__ + 1;
+        bs_log_ratelimited(1, 50000, BS_WARNING, "test %d", i);
+        if (3 == i) {
+            snprintf(expected_output, sizeof(expected_output),
+                     "(\e[1;93mWARNING\e[0m) \e[90mlog.c:%d\e[0m "
+                     "\e[1;93mSuppressed 2 messages.\e[0m\n", line);
+            // Reads just the summary line. The message follows.
+            char buf[BS_LOG_MAX_BUF_SIZE + 1] = {};
+            size_t len = BS_LOG_TIMESTAMP_LEN + 1 + strlen(expected_output);
+            BS_TEST_VERIFY_EQ(test_ptr, (ssize_t)len,
+                              bs_sock_read(fds[0], buf, len, 10));
+            BS_TEST_VERIFY_STREQ(test_ptr, expected_output,
+                                 &buf[BS_LOG_TIMESTAMP_LEN + 1]);
+        }
+        snprintf(expected_output, sizeof(expected_output),
+                 "(\e[1;93mWARNING\e[0m) \e[90mlog.c:%d\e[0m "
+                 "\e[1;93mtest %d\e[0m\n", line, i);
+        verify_log_output_equals_at(
+            test_ptr, __FILE__, __LINE__, fds[0],
+            (0 == i || 3 == i) ? expected_output : NULL);
+    }
+
+cleanup:
+    _log_fd = 2;
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Benchmarks log calls, written to /dev/null. For binary logging, reports
+ * separately the cost of recording and the deferred cost of rendering.
+ */
+static void _benchmark_log(bs_test_t *test_ptr, bool binary)
+{
+    int fd = open("/dev/null", O_WRONLY);
+    if (0 > fd) {
+        BS_TEST_FAIL(test_ptr, "Failed open(/dev/null, O_WRONLY)");
+        return;
+    }
+    _log_fd = fd;
+    if (binary && !bs_log_binary_start(1 << 20)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_log_binary_start(1 << 20)");
+        goto cleanup;
+    }
+
+    uint64_t iterations = 0, record_usec = 0, render_usec = 0;
+    uint64_t usec = bs_usec();
+    while (usec + benchmark_duration >= bs_usec()) {
+        uint64_t start_usec = bs_usec();
+        for (int i = 0; i < 1000; ++i, ++iterations) {
+            bs_log(BS_WARNING, "Benchmark %d: %s %p %.3f",
+                   i, "message", test_ptr, i * 0.5);
+        }
+        uint64_t end_usec = bs_usec();
+        record_usec += end_usec - start_usec;
+        bs_log_binary_flush();
+        render_usec += bs_usec() - end_usec;
+    }
+
+    if (binary) {
+        bs_log_binary_stop();
+        bs_test_succeed(test_ptr, "%.3e calls/sec, %.3e renders/sec",
+                        iterations / (record_usec * 1e-6),
+                        iterations / (render_usec * 1e-6));
+    } else {
+        bs_test_succeed(test_ptr, "%.3e calls/sec",
+                        iterations / (record_usec * 1e-6));
+    }
+
+cleanup:
+    _log_fd = 2;
+    close(fd);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_text(bs_test_t *test_ptr)
+{
+    _benchmark_log(test_ptr, false);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_binary(bs_test_t *test_ptr)
+{
+    _benchmark_log(test_ptr, true);
+}
+
 /* == End of log.c ========================================================= */
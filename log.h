@@ -21,11 +21,14 @@
 #ifndef __LIBBASE_LOG_H__
 #define __LIBBASE_LOG_H__
 
+#include "atomic.h"
 #include "def.h"
 #include "test.h"
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -68,6 +71,81 @@ void bs_log_vwrite(bs_log_severity_t severity,
 bool bs_log_init_file(const char *log_filename_ptr,
                       bs_log_severity_t severity);
 
+/** What to do when the ring of the asynchronous log backend is full. */
+typedef enum {
+    /** Drop the message, and count it. See @ref bs_log_async_dropped. */
+    BS_LOG_ASYNC_DROP,
+    /** Wait until the background thread has made room. */
+    BS_LOG_ASYNC_BLOCK
+} bs_log_async_overflow_t;
+
+/**
+ * Starts asynchronous logging: Log messages are formatted in the calling
+ * thread, and then queued in a lock-free ring. A background thread writes
+ * them out, batching multiple messages into a single writev(2).
+ *
+ * BS_FATAL messages are never dropped: They flush the ring before aborting.
+ *
+ * Must not be called while other threads are logging.
+ *
+ * @param slots               Number of messages the ring can hold. Rounded up
+ *                            to a power of 2. Each slot takes
+ *                            @ref BS_LOG_MAX_BUF_SIZE bytes.
+ * @param overflow            What to do when the ring is full.
+ *
+ * @return true on success.
+ */
+bool bs_log_async_start(size_t slots, bs_log_async_overflow_t overflow);
+
+/**
+ * Stops asynchronous logging. Writes all queued messages, and then joins the
+ * background thread. Must not be called while other threads are logging.
+ */
+void bs_log_async_stop(void);
+
+/** Waits until all messages queued so far have been written. */
+void bs_log_async_flush(void);
+
+/** Returns the number of messages dropped, since @ref bs_log_async_start. */
+uint64_t bs_log_async_dropped(void);
+
+/**
+ * Starts binary logging: Log calls do not format the message, but record
+ * the format string's address, source location, timestamp, errno and the
+ * raw arguments into a buffer of the calling thread. Records are rendered
+ * into the same text as from immediate formatting, and then written out:
+ * On @ref bs_log_binary_flush, when the thread's buffer is full, and when
+ * the thread exits.
+ *
+ * String arguments are copied. Format strings are referenced, and must
+ * remain valid until rendered; string literals are. Messages that are too
+ * large to record, and BS_FATAL messages, are formatted right away, after
+ * rendering the records so far.
+ *
+ * Can be combined with @ref bs_log_async_start, which then writes out the
+ * rendered messages.
+ *
+ * Must not be called while other threads are logging.
+ *
+ * @param bytes_per_thread    Size of each thread's buffer, in bytes.
+ *
+ * @return true on success.
+ */
+bool bs_log_binary_start(size_t bytes_per_thread);
+
+/**
+ * Stops binary logging. Renders all records, and releases the buffers.
+ * Must not be called while other threads are logging.
+ */
+void bs_log_binary_stop(void);
+
+/**
+ * Renders and writes all records so far. Records are in order for each
+ * thread, but not interleaved across threads. Can be called from any thread,
+ * eg. periodically from an idle handler.
+ */
+void bs_log_binary_flush(void);
+
 /** Returns whether log outut will happen for `severity`. */
 static inline bool bs_will_log(bs_log_severity_t severity)
 {
@@ -84,9 +162,92 @@ static inline bool bs_will_log(bs_log_severity_t severity)
         }                                                               \
     }
 
+#if !defined(__cplusplus)
+
+/** State of a rate-limited log call site. See @ref bs_log_ratelimited. */
+typedef struct {
+    /** Start of the current interval, in usec of CLOCK_MONOTONIC_COARSE. */
+    bs_atomic_int64_t         interval_start;
+    /**
+     * Calls within the interval, in the lower 32 bits. The upper 32 bits tag
+     * the interval, by the lower bits of its start. Starting the interval
+     * and resetting its count is thus one compare-and-swap.
+     */
+    bs_atomic_int64_t         calls;
+    /** Calls suppressed since the the site last logged. */
+    bs_atomic_int64_t         suppressed;
+} bs_log_ratelimit_t;
+
+/** Initializer for @ref bs_log_ratelimit_t. */
+#define BS_LOG_RATELIMIT_INIT {                                         \
+        BS_ATOMIC_INT64_INIT(INT64_MIN / 2),                            \
+        BS_ATOMIC_INT64_INIT(0),                                        \
+        BS_ATOMIC_INT64_INIT(0) }
+
+/**
+ * Registers a call at a rate-limited log site. Helper to
+ * @ref bs_log_ratelimited.
+ *
+ * @param ratelimit_ptr
+ * @param burst               Calls permitted per interval.
+ * @param interval_usec       Length of the interval.
+ * @param suppressed_ptr      Output: If the call starts a new interval and is
+ *                            permitted, the number of calls suppressed before.
+ *                            0 otherwise.
+ *
+ * @return Whether the call is permitted to log.
+ */
+bool bs_log_ratelimit_allow(bs_log_ratelimit_t *ratelimit_ptr,
+                            int64_t burst,
+                            uint64_t interval_usec,
+                            int64_t *suppressed_ptr);
+
+/**
+ * Writes a log message for the 1st, (n+1)th, (2n+1)th, ... call of this
+ * call site. Skipped calls cost an atomic increment. For n <= 1, every call
+ * is logged.
+ */
+#define bs_log_every_n(_n, _severity, ...) {                            \
+        static bs_atomic_int64_t _bs_log_calls = BS_ATOMIC_INT64_INIT(0); \
+        bs_log_severity_t _tmp_sev = (_severity);                       \
+        int64_t _tmp_n = (_n);                                          \
+        if (bs_will_log(_tmp_sev) &&                                    \
+            (1 >= _tmp_n ||                                             \
+             0 == (bs_atomic_int64_add(&_bs_log_calls, 1) - 1) % _tmp_n)) { \
+            bs_log_write(_tmp_sev, __FILE__, __LINE__, __VA_ARGS__);    \
+        }                                                               \
+    }
+
+/**
+ * Writes a log message, permitting up to `_burst` messages from this call
+ * site per `_interval_usec`. Suppressed calls are counted, and the first
+ * message of a later interval is preceded by a summary line.
+ */
+#define bs_log_ratelimited(_burst, _interval_usec, _severity, ...) {    \
+        static bs_log_ratelimit_t _bs_log_ratelimit =                   \
+            BS_LOG_RATELIMIT_INIT;                                      \
+        bs_log_severity_t _tmp_sev = (_severity);                       \
+        int64_t _suppressed;                                            \
+        if (bs_will_log(_tmp_sev) &&                                    \
+            bs_log_ratelimit_allow(&_bs_log_ratelimit, (_burst),        \
+                                   (_interval_usec), &_suppressed)) {   \
+            if (0 < _suppressed) {                                      \
+                bs_log_write(_tmp_sev & 0x7f, __FILE__, __LINE__,       \
+                             "Suppressed %lld messages.",               \
+                             (long long)_suppressed);                   \
+            }                                                           \
+            bs_log_write(_tmp_sev, __FILE__, __LINE__, __VA_ARGS__);    \
+        }                                                               \
+    }
+
+#endif  // !defined(__cplusplus)
+
 /** Unit tests. */
 extern const bs_test_case_t   bs_log_test_cases[];
 
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_log_benchmarks[];
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
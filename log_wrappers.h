@@ -21,9 +21,11 @@
 #ifndef __LIBBASE_LOG_WRAPPERS_H__
 #define __LIBBASE_LOG_WRAPPERS_H__
 
+#include "alloc_stats.h"
 #include "log.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include "c2x_compat.h"
 
 #ifdef __cplusplus
@@ -39,6 +41,9 @@ static inline void *_logged_calloc(
         bs_log_write((bs_log_severity_t)(BS_ERROR | BS_ERRNO), filename_ptr,
                      line_no, "Failed calloc(%zu, %zu)", nmemb, size);
     }
+    if (NULL != ptr && __atomic_load_n(&_bs_alloc_stats_on, __ATOMIC_RELAXED)) {
+        _bs_alloc_stats_record_alloc(filename_ptr, line_no, ptr, nmemb * size);
+    }
     return ptr;
 }
 
@@ -55,6 +60,9 @@ static inline void *_logged_malloc(
         bs_log_write((bs_log_severity_t)(BS_ERROR | BS_ERRNO), filename_ptr,
                      line_no, "Failed malloc(%zu)", size);
     }
+    if (NULL != ptr && __atomic_load_n(&_bs_alloc_stats_on, __ATOMIC_RELAXED)) {
+        _bs_alloc_stats_record_alloc(filename_ptr, line_no, ptr, size);
+    }
     return ptr;
 }
 
@@ -71,6 +79,11 @@ static inline char *_logged_strdup(
         bs_log_write((bs_log_severity_t)(BS_ERROR | BS_ERRNO), filename_ptr,
                      line_no, "Failed strdup(%s)", str);
     }
+    if (NULL != new_str &&
+        __atomic_load_n(&_bs_alloc_stats_on, __ATOMIC_RELAXED)) {
+        _bs_alloc_stats_record_alloc(filename_ptr, line_no, new_str,
+                                     strlen(new_str) + 1);
+    }
     return new_str;
 }
 
@@ -78,6 +91,19 @@ static inline char *_logged_strdup(
 #define logged_strdup(str)                      \
     _logged_strdup(__FILE__, __LINE__, str);
 
+/**
+ * Calls free(3). Releases the allocation from accounting, if it was made by
+ * a `logged_*` allocator while @ref bs_alloc_stats_enable was on.
+ */
+static inline void logged_free(void *ptr)
+{
+    if (NULL != ptr &&
+        0 != __atomic_load_n(&_bs_alloc_stats_live, __ATOMIC_RELAXED)) {
+        _bs_alloc_stats_record_free(ptr);
+    }
+    free(ptr);
+}
+
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -0,0 +1,985 @@
+/* ========================================================================= */
+/**
+ * @file lru.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lru.h"
+
+#include "atomic.h"
+#include "avltree.h"
+#include "log.h"
+#include "log_wrappers.h"
+#include "thread.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/* == Declarations ========================================================= */
+
+/** A shard of the cache. */
+typedef struct {
+    /** Guards the shard. Only initialized if the cache is locking. */
+    pthread_mutex_t           mutex;
+    /** The entries, by key. */
+    bs_hashmap_t              *hashmap_ptr;
+    /**
+     * With @ref BS_LRU_POLICY_LRU: Unreferenced entries, the least recently
+     * released at the head. With @ref BS_LRU_POLICY_CLOCK: All entries,
+     * with the clock hand at the head.
+     */
+    bs_dllist_t               list;
+    /** With @ref BS_LRU_POLICY_LRU: Referenced entries. */
+    bs_dllist_t               acquired;
+    /** Number of entries. */
+    size_t                    entries;
+    /** Total cost of the entries. */
+    size_t                    cost;
+    /** This shard's share of the budget for `entries`. */
+    size_t                    max_entries;
+    /** This shard's share of the budget for `cost`. */
+    size_t                    max_cost;
+} bs_lru_shard_t;
+
+/** State of the cache. */
+struct _bs_lru_t {
+    /** Hash of a key. */
+    bs_hashmap_hash_t         hash;
+    /** Evicts an entry. */
+    bs_lru_evict_t            evict;
+    /** Argument to `evict`. */
+    void                      *evict_ud_ptr;
+    /** Eviction policy. */
+    bs_lru_policy_t           policy;
+    /** Whether the shards are guarded by their mutex. */
+    bool                      locking;
+    /** Number of shards. */
+    unsigned                  num_shards;
+    /** The shards. */
+    bs_lru_shard_t            shards[];
+};
+
+static bs_lru_shard_t *_bs_lru_shard(bs_lru_t *lru_ptr, uint64_t hash);
+static void _bs_lru_lock(bs_lru_t *lru_ptr, bs_lru_shard_t *shard_ptr);
+static void _bs_lru_unlock(bs_lru_t *lru_ptr, bs_lru_shard_t *shard_ptr);
+static void _bs_lru_reference(bs_lru_t *lru_ptr,
+                              bs_lru_shard_t *shard_ptr,
+                              bs_lru_node_t *node_ptr);
+static void _bs_lru_detach(bs_lru_t *lru_ptr,
+                           bs_lru_shard_t *shard_ptr,
+                           bs_lru_node_t *node_ptr,
+                           bs_dllist_t *evicted_ptr);
+static void _bs_lru_enforce_budget(bs_lru_t *lru_ptr,
+                                   bs_lru_shard_t *shard_ptr,
+                                   bs_dllist_t *evicted_ptr);
+static bs_lru_node_t *_bs_lru_victim(bs_lru_t *lru_ptr,
+                                     bs_lru_shard_t *shard_ptr);
+static size_t _bs_lru_flush_shard(bs_lru_t *lru_ptr,
+                                  bs_lru_shard_t *shard_ptr);
+static void _bs_lru_evict_all(bs_lru_t *lru_ptr, bs_dllist_t *evicted_ptr);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_lru_t *bs_lru_create(bs_hashmap_hash_t hash,
+                        bs_hashmap_node_equals_t equals,
+                        bs_lru_evict_t evict,
+                        void *evict_ud_ptr,
+                        size_t max_entries,
+                        size_t max_cost,
+                        bs_lru_policy_t policy,
+                        unsigned shards)
+{
+    unsigned num_shards = BS_MAX(1u, shards);
+    bs_lru_t *lru_ptr = logged_calloc(
+        1, sizeof(bs_lru_t) + num_shards * sizeof(bs_lru_shard_t));
+    if (NULL == lru_ptr) return NULL;
+    lru_ptr->hash = hash;
+    lru_ptr->evict = evict;
+    lru_ptr->evict_ud_ptr = evict_ud_ptr;
+    lru_ptr->policy = policy;
+    lru_ptr->locking = 0 < shards;
+
+    // Rounds each share up: Total budget is met with keys spread evenly.
+    for (unsigned i = 0; i < num_shards; ++i) {
+        bs_lru_shard_t *shard_ptr = &lru_ptr->shards[i];
+        shard_ptr->max_entries = max_entries / num_shards +
+            (0 != max_entries % num_shards);
+        shard_ptr->max_cost = max_cost / num_shards +
+            (0 != max_cost % num_shards);
+        if (lru_ptr->locking && !bs_mutex_init(&shard_ptr->mutex)) break;
+        shard_ptr->hashmap_ptr = bs_hashmap_create(hash, equals, NULL);
+        if (NULL == shard_ptr->hashmap_ptr) {
+            if (lru_ptr->locking) bs_mutex_destroy(&shard_ptr->mutex);
+            break;
+        }
+        lru_ptr->num_shards++;
+    }
+    if (lru_ptr->num_shards < num_shards) {
+        bs_lru_destroy(lru_ptr);
+        return NULL;
+    }
+    return lru_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_lru_destroy(bs_lru_t *lru_ptr)
+{
+    size_t referenced = 0;
+    for (unsigned i = 0; i < lru_ptr->num_shards; ++i) {
+        bs_lru_shard_t *shard_ptr = &lru_ptr->shards[i];
+        referenced += _bs_lru_flush_shard(lru_ptr, shard_ptr);
+        bs_hashmap_destroy(shard_ptr->hashmap_ptr);
+        if (lru_ptr->locking) bs_mutex_destroy(&shard_ptr->mutex);
+    }
+    if (0 < referenced) {
+        bs_log(BS_WARNING, "Destroying cache %p with %zu acquired entries",
+               lru_ptr, referenced);
+    }
+    logged_free(lru_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bs_lru_node_t *bs_lru_acquire(bs_lru_t *lru_ptr, const void *key_ptr)
+{
+    bs_lru_shard_t *shard_ptr = _bs_lru_shard(lru_ptr, lru_ptr->hash(key_ptr));
+    _bs_lru_lock(lru_ptr, shard_ptr);
+    bs_lru_node_t *node_ptr = NULL;
+    bs_hashmap_node_t *hashmap_node_ptr = bs_hashmap_lookup(
+        shard_ptr->hashmap_ptr, key_ptr);
+    if (NULL != hashmap_node_ptr) {
+        node_ptr = BS_CONTAINER_OF(hashmap_node_ptr, bs_lru_node_t,
+                                   hashmap_node);
+        _bs_lru_reference(lru_ptr, shard_ptr, node_ptr);
+    }
+    _bs_lru_unlock(lru_ptr, shard_ptr);
+    return node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+bs_lru_node_t *bs_lru_insert(bs_lru_t *lru_ptr,
+                             const void *key_ptr,
+                             bs_lru_node_t *node_ptr,
+                             size_t cost)
+{
+    bs_lru_shard_t *shard_ptr = _bs_lru_shard(lru_ptr, lru_ptr->hash(key_ptr));
+    _bs_lru_lock(lru_ptr, shard_ptr);
+    bs_hashmap_node_t *hashmap_node_ptr = bs_hashmap_lookup(
+        shard_ptr->hashmap_ptr, key_ptr);
+    if (NULL != hashmap_node_ptr) {
+        bs_lru_node_t *cached_node_ptr = BS_CONTAINER_OF(
+            hashmap_node_ptr, bs_lru_node_t, hashmap_node);
+        _bs_lru_reference(lru_ptr, shard_ptr, cached_node_ptr);
+        _bs_lru_unlock(lru_ptr, shard_ptr);
+        return cached_node_ptr;
+    }
+
+    *node_ptr = (bs_lru_node_t){ .cost = cost, .references = 1,
+                                 .cached = true };
+    if (!bs_hashmap_insert(shard_ptr->hashmap_ptr, key_ptr,
+                           &node_ptr->hashmap_node, false)) {
+        _bs_lru_unlock(lru_ptr, shard_ptr);
+        return NULL;
+    }
+    // A new entry of the clock goes behind the hand: Last in line.
+    if (BS_LRU_POLICY_CLOCK == lru_ptr->policy) {
+        bs_dllist_push_back(&shard_ptr->list, &node_ptr->dlnode);
+    } else {
+        bs_dllist_push_back(&shard_ptr->acquired, &node_ptr->dlnode);
+    }
+    shard_ptr->entries++;
+    shard_ptr->cost += cost;
+
+    bs_dllist_t evicted = {};
+    _bs_lru_enforce_budget(lru_ptr, shard_ptr, &evicted);
+    _bs_lru_unlock(lru_ptr, shard_ptr);
+    _bs_lru_evict_all(lru_ptr, &evicted);
+    return node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_lru_release(bs_lru_t *lru_ptr, bs_lru_node_t *node_ptr)
+{
+    // The hash map cached the key's hash: Selects the same shard.
+    bs_lru_shard_t *shard_ptr = _bs_lru_shard(
+        lru_ptr, node_ptr->hashmap_node.hash);
+    bs_dllist_t evicted = {};
+    _bs_lru_lock(lru_ptr, shard_ptr);
+    if (0 == --node_ptr->references) {
+        if (!node_ptr->cached) {
+            bs_dllist_push_back(&evicted, &node_ptr->dlnode);
+        } else {
+            if (BS_LRU_POLICY_LRU == lru_ptr->policy) {
+                bs_dllist_remove(&shard_ptr->acquired, &node_ptr->dlnode);
+                bs_dllist_push_back(&shard_ptr->list, &node_ptr->dlnode);
+            }
+            _bs_lru_enforce_budget(lru_ptr, shard_ptr, &evicted);
+        }
+    }
+    _bs_lru_unlock(lru_ptr, shard_ptr);
+    _bs_lru_evict_all(lru_ptr, &evicted);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_lru_erase(bs_lru_t *lru_ptr, const void *key_ptr)
+{
+    bs_lru_shard_t *shard_ptr = _bs_lru_shard(lru_ptr, lru_ptr->hash(key_ptr));
+    bs_dllist_t evicted = {};
+    _bs_lru_lock(lru_ptr, shard_ptr);
+    bs_hashmap_node_t *hashmap_node_ptr = bs_hashmap_lookup(
+        shard_ptr->hashmap_ptr, key_ptr);
+    if (NULL != hashmap_node_ptr) {
+        _bs_lru_detach(lru_ptr, shard_ptr,
+                       BS_CONTAINER_OF(hashmap_node_ptr, bs_lru_node_t,
+                                       hashmap_node),
+                       &evicted);
+    }
+    _bs_lru_unlock(lru_ptr, shard_ptr);
+    _bs_lru_evict_all(lru_ptr, &evicted);
+    return NULL != hashmap_node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_lru_flush(bs_lru_t *lru_ptr)
+{
+    for (unsigned i = 0; i < lru_ptr->num_shards; ++i) {
+        _bs_lru_flush_shard(lru_ptr, &lru_ptr->shards[i]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_lru_entries(bs_lru_t *lru_ptr)
+{
+    size_t entries = 0;
+    for (unsigned i = 0; i < lru_ptr->num_shards; ++i) {
+        bs_lru_shard_t *shard_ptr = &lru_ptr->shards[i];
+        _bs_lru_lock(lru_ptr, shard_ptr);
+        entries += shard_ptr->entries;
+        _bs_lru_unlock(lru_ptr, shard_ptr);
+    }
+    return entries;
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_lru_cost(bs_lru_t *lru_ptr)
+{
+    size_t cost = 0;
+    for (unsigned i = 0; i < lru_ptr->num_shards; ++i) {
+        bs_lru_shard_t *shard_ptr = &lru_ptr->shards[i];
+        _bs_lru_lock(lru_ptr, shard_ptr);
+        cost += shard_ptr->cost;
+        _bs_lru_unlock(lru_ptr, shard_ptr);
+    }
+    return cost;
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns the shard for `hash`. Mixes the hash differently from the hash
+ * map's buckets, so that keys of a shard still spread over its buckets.
+ */
+bs_lru_shard_t *_bs_lru_shard(bs_lru_t *lru_ptr, uint64_t hash)
+{
+    if (1 == lru_ptr->num_shards) return &lru_ptr->shards[0];
+    hash ^= hash >> 31;
+    hash *= UINT64_C(0xbf58476d1ce4e5b9);
+    hash ^= hash >> 29;
+    return &lru_ptr->shards[hash % lru_ptr->num_shards];
+}
+
+/* ------------------------------------------------------------------------- */
+/** Locks the shard, if the cache is locking. */
+void _bs_lru_lock(bs_lru_t *lru_ptr, bs_lru_shard_t *shard_ptr)
+{
+    if (lru_ptr->locking) bs_mutex_lock(&shard_ptr->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Unlocks the shard, if the cache is locking. */
+void _bs_lru_unlock(bs_lru_t *lru_ptr, bs_lru_shard_t *shard_ptr)
+{
+    if (lru_ptr->locking) bs_mutex_unlock(&shard_ptr->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Adds a reference to the cached node, and marks it as used. */
+void _bs_lru_reference(bs_lru_t *lru_ptr,
+                       bs_lru_shard_t *shard_ptr,
+                       bs_lru_node_t *node_ptr)
+{
+    if (BS_LRU_POLICY_CLOCK == lru_ptr->policy) {
+        node_ptr->recently_used = true;
+        node_ptr->references++;
+        return;
+    }
+    if (0 == node_ptr->references++) {
+        bs_dllist_remove(&shard_ptr->list, &node_ptr->dlnode);
+        bs_dllist_push_back(&shard_ptr->acquired, &node_ptr->dlnode);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Removes the node from the shard. If unreferenced, appends it to
+ * `evicted_ptr`; else it will be evicted on the last release.
+ */
+void _bs_lru_detach(bs_lru_t *lru_ptr,
+                    bs_lru_shard_t *shard_ptr,
+                    bs_lru_node_t *node_ptr,
+                    bs_dllist_t *evicted_ptr)
+{
+    bs_hashmap_remove_node(shard_ptr->hashmap_ptr, &node_ptr->hashmap_node);
+    if (BS_LRU_POLICY_LRU == lru_ptr->policy && 0 < node_ptr->references) {
+        bs_dllist_remove(&shard_ptr->acquired, &node_ptr->dlnode);
+    } else {
+        bs_dllist_remove(&shard_ptr->list, &node_ptr->dlnode);
+    }
+    shard_ptr->entries--;
+    shard_ptr->cost -= node_ptr->cost;
+    node_ptr->cached = false;
+    if (0 == node_ptr->references) {
+        bs_dllist_push_back(evicted_ptr, &node_ptr->dlnode);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Detaches victims until the shard is within budget, or has none left. */
+void _bs_lru_enforce_budget(bs_lru_t *lru_ptr,
+                            bs_lru_shard_t *shard_ptr,
+                            bs_dllist_t *evicted_ptr)
+{
+    while (shard_ptr->entries > shard_ptr->max_entries ||
+           shard_ptr->cost > shard_ptr->max_cost) {
+        bs_lru_node_t *node_ptr = _bs_lru_victim(lru_ptr, shard_ptr);
+        if (NULL == node_ptr) return;
+        _bs_lru_detach(lru_ptr, shard_ptr, node_ptr, evicted_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Picks the next entry to evict.
+ *
+ * @return The node, or NULL if all entries are referenced.
+ */
+bs_lru_node_t *_bs_lru_victim(bs_lru_t *lru_ptr, bs_lru_shard_t *shard_ptr)
+{
+    if (BS_LRU_POLICY_LRU == lru_ptr->policy) {
+        if (NULL == shard_ptr->list.head_ptr) return NULL;
+        return BS_CONTAINER_OF(shard_ptr->list.head_ptr, bs_lru_node_t,
+                               dlnode);
+    }
+
+    // Advances the hand, clearing marks. Two rounds visit each entry after
+    // its mark was cleared.
+    for (size_t steps = 2 * bs_dllist_size(&shard_ptr->list);
+         0 < steps; --steps) {
+        bs_lru_node_t *node_ptr = BS_CONTAINER_OF(
+            shard_ptr->list.head_ptr, bs_lru_node_t, dlnode);
+        if (0 == node_ptr->references && !node_ptr->recently_used) {
+            return node_ptr;
+        }
+        node_ptr->recently_used = false;
+        bs_dllist_pop_front(&shard_ptr->list);
+        bs_dllist_push_back(&shard_ptr->list, &node_ptr->dlnode);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Removes all entries of the shard, and evicts the unreferenced ones.
+ *
+ * @return Number of referenced entries, to be evicted on release.
+ */
+size_t _bs_lru_flush_shard(bs_lru_t *lru_ptr, bs_lru_shard_t *shard_ptr)
+{
+    bs_dllist_t evicted = {};
+    size_t referenced = 0;
+    _bs_lru_lock(lru_ptr, shard_ptr);
+    while (NULL != shard_ptr->acquired.head_ptr) {
+        _bs_lru_detach(lru_ptr, shard_ptr,
+                       BS_CONTAINER_OF(shard_ptr->acquired.head_ptr,
+                                       bs_lru_node_t, dlnode),
+                       &evicted);
+        ++referenced;
+    }
+    while (NULL != shard_ptr->list.head_ptr) {
+        bs_lru_node_t *node_ptr = BS_CONTAINER_OF(
+            shard_ptr->list.head_ptr, bs_lru_node_t, dlnode);
+        if (0 < node_ptr->references) ++referenced;
+        _bs_lru_detach(lru_ptr, shard_ptr, node_ptr, &evicted);
+    }
+    _bs_lru_unlock(lru_ptr, shard_ptr);
+    _bs_lru_evict_all(lru_ptr, &evicted);
+    return referenced;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Calls the evict callback for each node of `evicted_ptr`. No lock held. */
+void _bs_lru_evict_all(bs_lru_t *lru_ptr, bs_dllist_t *evicted_ptr)
+{
+    bs_dllist_node_t *dlnode_ptr;
+    while (NULL != (dlnode_ptr = bs_dllist_pop_front(evicted_ptr))) {
+        lru_ptr->evict(BS_CONTAINER_OF(dlnode_ptr, bs_lru_node_t, dlnode),
+                       lru_ptr->evict_ud_ptr);
+    }
+}
+
+/* == Unit tests =========================================================== */
+/** @cond TEST */
+
+static void test_lru(bs_test_t *test_ptr);
+static void test_cost(bs_test_t *test_ptr);
+static void test_acquired(bs_test_t *test_ptr);
+static void test_clock(bs_test_t *test_ptr);
+static void test_sharded(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_lru_test_cases[] = {
+    { 1, "lru", test_lru },
+    { 1, "cost", test_cost },
+    { 1, "acquired", test_acquired },
+    { 1, "clock", test_clock },
+    { 1, "sharded", test_sharded },
+    { 0, NULL, NULL }
+};
+
+/** An entry for the tests. */
+typedef struct {
+    /** The cache node. */
+    bs_lru_node_t             lru_node;
+    /** The key. */
+    int                       key;
+    /** Whether the entry was evicted. */
+    bool                      evicted;
+} _test_entry_t;
+
+/** Records evictions, for the tests. */
+typedef struct {
+    /** Keys of evicted entries, in order. */
+    int                       keys[16];
+    /** Number of evicted entries. */
+    unsigned                  count;
+} _test_evictions_t;
+
+/* ------------------------------------------------------------------------- */
+/** Hashes an `int` key. */
+static uint64_t _test_hash(const void *key_ptr)
+{
+    return *(const int*)key_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Compares the entry's key with an `int` key. */
+static bool _test_equals(const bs_hashmap_node_t *node_ptr,
+                         const void *key_ptr)
+{
+    const _test_entry_t *entry_ptr = BS_CONTAINER_OF(
+        bs_lru_node_from_hashmap_node(node_ptr), const _test_entry_t,
+        lru_node);
+    return entry_ptr->key == *(const int*)key_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Marks the entry as evicted, and records it. */
+static void _test_evict(bs_lru_node_t *node_ptr, void *ud_ptr)
+{
+    _test_entry_t *entry_ptr = BS_CONTAINER_OF(
+        node_ptr, _test_entry_t, lru_node);
+    _test_evictions_t *evictions_ptr = ud_ptr;
+    entry_ptr->evicted = true;
+    if (evictions_ptr->count < 16) {
+        evictions_ptr->keys[evictions_ptr->count] = entry_ptr->key;
+    }
+    evictions_ptr->count++;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Inserts `entry_ptr` with `cost`, and releases it right away. */
+static bool _test_insert(bs_lru_t *lru_ptr,
+                         _test_entry_t *entry_ptr,
+                         size_t cost)
+{
+    bs_lru_node_t *node_ptr = bs_lru_insert(
+        lru_ptr, &entry_ptr->key, &entry_ptr->lru_node, cost);
+    bs_lru_release(lru_ptr, node_ptr);
+    return node_ptr == &entry_ptr->lru_node;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Acquires `key` and releases it right away. Returns whether found. */
+static bool _test_touch(bs_lru_t *lru_ptr, int key)
+{
+    bs_lru_node_t *node_ptr = bs_lru_acquire(lru_ptr, &key);
+    if (NULL == node_ptr) return false;
+    bs_lru_release(lru_ptr, node_ptr);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Evicts the least recently used, within an entries budget. */
+void test_lru(bs_test_t *test_ptr)
+{
+    _test_evictions_t ev = {};
+    _test_entry_t e[5] = {
+        { .key = 1 }, { .key = 2 }, { .key = 3 }, { .key = 4 }, { .key = 1 } };
+    bs_lru_t *lru_ptr = bs_lru_create(
+        _test_hash, _test_equals, _test_evict, &ev, 3, SIZE_MAX,
+        BS_LRU_POLICY_LRU, 0);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, lru_ptr);
+
+    int key = 1;
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_lru_acquire(lru_ptr, &key));
+    for (int i = 0; i < 3; ++i) {
+        BS_TEST_VERIFY_TRUE(test_ptr, _test_insert(lru_ptr, &e[i], 1));
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_lru_entries(lru_ptr));
+
+    // An existing key returns the cached entry.
+    BS_TEST_VERIFY_FALSE(test_ptr, _test_insert(lru_ptr, &e[4], 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, ev.count);
+
+    // Using 1 makes 2 the least recently used.
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_touch(lru_ptr, 1));
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_insert(lru_ptr, &e[3], 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, ev.count);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, ev.keys[0]);
+    BS_TEST_VERIFY_TRUE(test_ptr, e[1].evicted);
+    BS_TEST_VERIFY_FALSE(test_ptr, _test_touch(lru_ptr, 2));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_lru_entries(lru_ptr));
+
+    key = 3;
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_lru_erase(lru_ptr, &key));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_lru_erase(lru_ptr, &key));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, ev.count);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, ev.keys[1]);
+
+    bs_lru_destroy(lru_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 4, ev.count);
+    BS_TEST_VERIFY_FALSE(test_ptr, e[4].evicted);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Evicts within a cost budget, as many entries as needed. */
+void test_cost(bs_test_t *test_ptr)
+{
+    _test_evictions_t ev = {};
+    _test_entry_t e[4] = {
+        { .key = 1 }, { .key = 2 }, { .key = 3 }, { .key = 4 } };
+    bs_lru_t *lru_ptr = bs_lru_create(
+        _test_hash, _test_equals, _test_evict, &ev, SIZE_MAX, 100,
+        BS_LRU_POLICY_LRU, 0);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, lru_ptr);
+
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_insert(lru_ptr, &e[0], 30));
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_insert(lru_ptr, &e[1], 30));
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_insert(lru_ptr, &e[2], 40));
+    BS_TEST_VERIFY_EQ(test_ptr, 100, bs_lru_cost(lru_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, ev.count);
+
+    // 70 more must evict 1 and 2, to fit.
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_insert(lru_ptr, &e[3], 60));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, ev.count);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, ev.keys[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, ev.keys[1]);
+    BS_TEST_VERIFY_EQ(test_ptr, 100, bs_lru_cost(lru_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, bs_lru_entries(lru_ptr));
+
+    bs_lru_flush(lru_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 4, ev.count);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_lru_cost(lru_ptr));
+    bs_lru_destroy(lru_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Acquired entries stay, and are evicted on release if due. */
+void test_acquired(bs_test_t *test_ptr)
+{
+    _test_evictions_t ev = {};
+    _test_entry_t e[3] = { { .key = 1 }, { .key = 2 }, { .key = 3 } };
+    bs_lru_t *lru_ptr = bs_lru_create(
+        _test_hash, _test_equals, _test_evict, &ev, 1, SIZE_MAX,
+        BS_LRU_POLICY_LRU, 0);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, lru_ptr);
+
+    bs_lru_node_t *n1_ptr = bs_lru_insert(lru_ptr, &e[0].key,
+                                          &e[0].lru_node, 1);
+    bs_lru_node_t *n2_ptr = bs_lru_insert(lru_ptr, &e[1].key,
+                                          &e[1].lru_node, 1);
+    BS_TEST_VERIFY_EQ(test_ptr, &e[0].lru_node, n1_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, &e[1].lru_node, n2_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, bs_lru_entries(lru_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, ev.count);
+
+    // Still over budget: The first release evicts.
+    BS_TEST_VERIFY_EQ(test_ptr, n1_ptr, bs_lru_acquire(lru_ptr, &e[0].key));
+    bs_lru_release(lru_ptr, n1_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, ev.count);
+    bs_lru_release(lru_ptr, n1_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, ev.count);
+    BS_TEST_VERIFY_TRUE(test_ptr, e[0].evicted);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_lru_entries(lru_ptr));
+
+    // Erased while acquired: Gone from the cache, evicted on release.
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_lru_erase(lru_ptr, &e[1].key));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_lru_acquire(lru_ptr, &e[1].key));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_lru_entries(lru_ptr));
+    BS_TEST_VERIFY_FALSE(test_ptr, e[1].evicted);
+    bs_lru_release(lru_ptr, n2_ptr);
+    BS_TEST_VERIFY_TRUE(test_ptr, e[1].evicted);
+
+    // Flushed while acquired: Same.
+    bs_lru_node_t *n3_ptr = bs_lru_insert(lru_ptr, &e[2].key,
+                                          &e[2].lru_node, 1);
+    bs_lru_flush(lru_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_lru_entries(lru_ptr));
+    BS_TEST_VERIFY_FALSE(test_ptr, e[2].evicted);
+    bs_lru_release(lru_ptr, n3_ptr);
+    BS_TEST_VERIFY_TRUE(test_ptr, e[2].evicted);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, ev.count);
+    bs_lru_destroy(lru_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** The clock gives recently used entries a second chance. */
+void test_clock(bs_test_t *test_ptr)
+{
+    _test_evictions_t ev = {};
+    _test_entry_t e[5] = {
+        { .key = 1 }, { .key = 2 }, { .key = 3 }, { .key = 4 }, { .key = 5 } };
+    bs_lru_t *lru_ptr = bs_lru_create(
+        _test_hash, _test_equals, _test_evict, &ev, 3, SIZE_MAX,
+        BS_LRU_POLICY_CLOCK, 0);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, lru_ptr);
+
+    for (int i = 0; i < 3; ++i) {
+        BS_TEST_VERIFY_TRUE(test_ptr, _test_insert(lru_ptr, &e[i], 1));
+    }
+    // The hand passes 1 with a second chance, and evicts 2. Then 3.
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_touch(lru_ptr, 1));
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_insert(lru_ptr, &e[3], 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, ev.count);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, ev.keys[0]);
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_insert(lru_ptr, &e[4], 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, ev.count);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, ev.keys[1]);
+
+    // An acquired entry is skipped, however often the hand passes.
+    bs_lru_node_t *node_ptr = bs_lru_acquire(lru_ptr, &e[0].key);
+    BS_TEST_VERIFY_EQ(test_ptr, &e[0].lru_node, node_ptr);
+    e[1] = (_test_entry_t){ .key = 2 };
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_insert(lru_ptr, &e[1], 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, ev.count);
+    BS_TEST_VERIFY_FALSE(test_ptr, e[0].evicted);
+    bs_lru_release(lru_ptr, node_ptr);
+
+    bs_lru_destroy(lru_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 6, ev.count);
+}
+
+/** Number of threads in the sharded test. */
+#define _TEST_THREADS         4
+
+/** State shared by the threads of the sharded test. */
+typedef struct {
+    /** The cache. */
+    bs_lru_t                  *lru_ptr;
+    /** Number of entries allocated and not yet evicted. */
+    bs_atomic_int32_t         live;
+    /** Number of failed checks. */
+    bs_atomic_int32_t         failures;
+} _test_sharded_t;
+
+/* ------------------------------------------------------------------------- */
+/** Evict callback of the sharded test: Frees the entry. */
+static void _test_sharded_evict(bs_lru_node_t *node_ptr, void *ud_ptr)
+{
+    _test_sharded_t *shared_ptr = ud_ptr;
+    logged_free(BS_CONTAINER_OF(node_ptr, _test_entry_t, lru_node));
+    bs_atomic_int32_add(&shared_ptr->live, -1);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Thread of the sharded test: Acquires or inserts random keys. */
+static void *_test_sharded_thread(void *arg_ptr)
+{
+    _test_sharded_t *shared_ptr = arg_ptr;
+    uint32_t seed = (uint32_t)(uintptr_t)&seed;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1664525 + 1013904223;
+        int key = (seed >> 8) % 256;
+        bs_lru_node_t *node_ptr = bs_lru_acquire(shared_ptr->lru_ptr, &key);
+        if (NULL == node_ptr) {
+            _test_entry_t *entry_ptr = logged_calloc(1, sizeof(_test_entry_t));
+            if (NULL == entry_ptr) break;
+            entry_ptr->key = key;
+            bs_atomic_int32_add(&shared_ptr->live, 1);
+            node_ptr = bs_lru_insert(shared_ptr->lru_ptr, &key,
+                                     &entry_ptr->lru_node, 1);
+            // Another thread inserted first, or allocation failed.
+            if (node_ptr != &entry_ptr->lru_node) {
+                logged_free(entry_ptr);
+                bs_atomic_int32_add(&shared_ptr->live, -1);
+            }
+            if (NULL == node_ptr) {
+                bs_atomic_int32_add(&shared_ptr->failures, 1);
+                break;
+            }
+        }
+        _test_entry_t *entry_ptr = BS_CONTAINER_OF(
+            node_ptr, _test_entry_t, lru_node);
+        if (entry_ptr->key != key) {
+            bs_atomic_int32_add(&shared_ptr->failures, 1);
+        }
+        bs_lru_release(shared_ptr->lru_ptr, node_ptr);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Concurrent acquires, inserts and evictions on a sharded cache. */
+void test_sharded(bs_test_t *test_ptr)
+{
+    _test_sharded_t shared = {
+        .live = BS_ATOMIC_INT32_INIT(0),
+        .failures = BS_ATOMIC_INT32_INIT(0) };
+    shared.lru_ptr = bs_lru_create(
+        _test_hash, _test_equals, _test_sharded_evict, &shared, 64, SIZE_MAX,
+        BS_LRU_POLICY_LRU, 8);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, shared.lru_ptr);
+
+    pthread_t threads[_TEST_THREADS];
+    for (int t = 0; t < _TEST_THREADS; ++t) {
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, 0,
+            pthread_create(&threads[t], NULL, _test_sharded_thread, &shared));
+    }
+    for (int t = 0; t < _TEST_THREADS; ++t) pthread_join(threads[t], NULL);
+
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_atomic_int32_get(&shared.failures));
+    size_t entries = bs_lru_entries(shared.lru_ptr);
+    BS_TEST_VERIFY_TRUE(test_ptr, 0 < entries && entries <= 64);
+    BS_TEST_VERIFY_EQ(test_ptr, entries,
+                      (size_t)bs_atomic_int32_get(&shared.live));
+    bs_lru_destroy(shared.lru_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_atomic_int32_get(&shared.live));
+}
+
+/** @endcond */
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_hit(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_lru_benchmarks[] = {
+    { 1, "benchmark-hit", benchmark_hit },
+    { 0, NULL, NULL }
+};
+
+/** Number of entries in the benchmarks' caches. */
+#define _BENCHMARK_ENTRIES    (1 << 16)
+
+/** An entry, for both the caches and the AVL tree with list. */
+typedef struct {
+    /** Node in the cache. */
+    bs_lru_node_t             lru_node;
+    /** Node in the AVL tree. */
+    bs_avltree_node_t         avlnode;
+    /** Node in the recency list, next to the AVL tree. */
+    bs_dllist_node_t          dlnode;
+    /** The key. */
+    uint64_t                  key;
+} _benchmark_entry_t;
+
+/** The caches, holding the same entries. */
+typedef struct {
+    /** The entries. */
+    _benchmark_entry_t        *entries_ptr;
+    /** Cache, with the LRU policy. */
+    bs_lru_t                  *lru_ptr;
+    /** Cache, with the CLOCK policy. */
+    bs_lru_t                  *clock_ptr;
+    /** Cache, with the LRU policy and 16 locked shards. */
+    bs_lru_t                  *sharded_ptr;
+    /** Baseline: AVL tree for lookup... */
+    bs_avltree_t              *avltree_ptr;
+    /** ...and a list for recency. */
+    bs_dllist_t               list;
+    /** Sequence of keys to look up. */
+    uint64_t                  seed;
+} _benchmark_caches_t;
+
+/* ------------------------------------------------------------------------- */
+static uint64_t _benchmark_hash(const void *key_ptr)
+{
+    return *(const uint64_t*)key_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+static bool _benchmark_equals(const bs_hashmap_node_t *node_ptr,
+                              const void *key_ptr)
+{
+    const _benchmark_entry_t *entry_ptr = BS_CONTAINER_OF(
+        bs_lru_node_from_hashmap_node(node_ptr), const _benchmark_entry_t,
+        lru_node);
+    return entry_ptr->key == *(const uint64_t*)key_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_evict(__UNUSED__ bs_lru_node_t *node_ptr,
+                             __UNUSED__ void *ud_ptr)
+{
+}
+
+/* ------------------------------------------------------------------------- */
+static int _benchmark_avltree_cmp(const bs_avltree_node_t *node_ptr,
+                                  const void *key_ptr)
+{
+    const _benchmark_entry_t *entry_ptr = BS_CONTAINER_OF(
+        node_ptr, const _benchmark_entry_t, avlnode);
+    uint64_t key = *(const uint64_t*)key_ptr;
+    return (entry_ptr->key > key) - (entry_ptr->key < key);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the next key to look up: One of the cached, at random. */
+static uint64_t _benchmark_next_key(_benchmark_caches_t *c_ptr)
+{
+    c_ptr->seed = c_ptr->seed * 6364136223846793005ULL +
+        1442695040888963407ULL;
+    return (c_ptr->seed >> 33) & (_BENCHMARK_ENTRIES - 1);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Acquires and releases cached keys of `lru_ptr`. */
+static void _benchmark_hit(bs_lru_t *lru_ptr,
+                           _benchmark_caches_t *c_ptr,
+                           uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint64_t key = _benchmark_next_key(c_ptr);
+        bs_lru_node_t *node_ptr = bs_lru_acquire(lru_ptr, &key);
+        BS_TEST_DO_NOT_OPTIMIZE(node_ptr);
+        bs_lru_release(lru_ptr, node_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_hit_lru_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_caches_t *c_ptr = arg_ptr;
+    _benchmark_hit(c_ptr->lru_ptr, c_ptr, iterations);
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_hit_clock_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_caches_t *c_ptr = arg_ptr;
+    _benchmark_hit(c_ptr->clock_ptr, c_ptr, iterations);
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_hit_sharded_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_caches_t *c_ptr = arg_ptr;
+    _benchmark_hit(c_ptr->sharded_ptr, c_ptr, iterations);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Baseline: Looks up in the AVL tree, and moves to the list's tail. */
+static void _benchmark_hit_avltree_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_caches_t *c_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint64_t key = _benchmark_next_key(c_ptr);
+        bs_avltree_node_t *avlnode_ptr = bs_avltree_lookup(
+            c_ptr->avltree_ptr, &key);
+        _benchmark_entry_t *entry_ptr = BS_CONTAINER_OF(
+            avlnode_ptr, _benchmark_entry_t, avlnode);
+        bs_dllist_remove(&c_ptr->list, &entry_ptr->dlnode);
+        bs_dllist_push_back(&c_ptr->list, &entry_ptr->dlnode);
+        BS_TEST_DO_NOT_OPTIMIZE(entry_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Hits on 64k cached entries. Compares against an AVL tree with a list. */
+void benchmark_hit(bs_test_t *test_ptr)
+{
+    _benchmark_caches_t c = {};
+    c.entries_ptr = logged_calloc(_BENCHMARK_ENTRIES,
+                                  sizeof(_benchmark_entry_t));
+    bs_lru_t **lru_ptr_ptrs[3] = { &c.lru_ptr, &c.clock_ptr, &c.sharded_ptr };
+    c.lru_ptr = bs_lru_create(
+        _benchmark_hash, _benchmark_equals, _benchmark_evict, NULL,
+        SIZE_MAX, SIZE_MAX, BS_LRU_POLICY_LRU, 0);
+    c.clock_ptr = bs_lru_create(
+        _benchmark_hash, _benchmark_equals, _benchmark_evict, NULL,
+        SIZE_MAX, SIZE_MAX, BS_LRU_POLICY_CLOCK, 0);
+    c.sharded_ptr = bs_lru_create(
+        _benchmark_hash, _benchmark_equals, _benchmark_evict, NULL,
+        SIZE_MAX, SIZE_MAX, BS_LRU_POLICY_LRU, 16);
+    c.avltree_ptr = bs_avltree_create(_benchmark_avltree_cmp, NULL);
+
+    // Each entry is in one cache only: The nodes are not shared.
+    _benchmark_entry_t *entries_ptrs[3] = {};
+    bool ok = NULL != c.entries_ptr && NULL != c.avltree_ptr;
+    for (int l = 0; l < 3 && ok; ++l) {
+        entries_ptrs[l] = logged_calloc(_BENCHMARK_ENTRIES,
+                                        sizeof(_benchmark_entry_t));
+        ok = NULL != entries_ptrs[l] && NULL != *lru_ptr_ptrs[l];
+        for (uint64_t k = 0; k < _BENCHMARK_ENTRIES && ok; ++k) {
+            _benchmark_entry_t *entry_ptr = &entries_ptrs[l][k];
+            entry_ptr->key = k;
+            bs_lru_release(*lru_ptr_ptrs[l], bs_lru_insert(
+                               *lru_ptr_ptrs[l], &entry_ptr->key,
+                               &entry_ptr->lru_node, 1));
+        }
+    }
+    for (uint64_t k = 0; k < _BENCHMARK_ENTRIES && ok; ++k) {
+        _benchmark_entry_t *entry_ptr = &c.entries_ptr[k];
+        entry_ptr->key = k;
+        bs_avltree_insert(c.avltree_ptr, &entry_ptr->key,
+                          &entry_ptr->avlnode, false);
+        bs_dllist_push_back(&c.list, &entry_ptr->dlnode);
+    }
+
+    if (!ok) {
+        BS_TEST_FAIL(test_ptr, "Failed to set up caches.");
+    } else if (
+        !bs_test_bench(test_ptr, "hit-64k-lru",
+                       _benchmark_hit_lru_fn, &c, NULL) ||
+        !bs_test_bench(test_ptr, "hit-64k-clock",
+                       _benchmark_hit_clock_fn, &c, NULL) ||
+        !bs_test_bench(test_ptr, "hit-64k-lru-sharded",
+                       _benchmark_hit_sharded_fn, &c, NULL) ||
+        !bs_test_bench(test_ptr, "hit-64k-avltree-dllist",
+                       _benchmark_hit_avltree_fn, &c, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench()");
+    }
+
+    for (int l = 0; l < 3; ++l) {
+        if (NULL != *lru_ptr_ptrs[l]) bs_lru_destroy(*lru_ptr_ptrs[l]);
+        logged_free(entries_ptrs[l]);
+    }
+    if (NULL != c.avltree_ptr) bs_avltree_destroy(c.avltree_ptr);
+    logged_free(c.entries_ptr);
+}
+
+/* == End of lru.c ========================================================= */
@@ -0,0 +1,210 @@
+/* ========================================================================= */
+/**
+ * @file lru.h
+ * Implements an intrusive cache that evicts least-recently used entries.
+ *
+ * Entries embed a @ref bs_lru_node_t. Lookups go through a
+ * @ref bs_hashmap_t, and recency is tracked by a @ref bs_dllist_t, so that
+ * a hit, a promotion and an eviction each take O(1). The cache evicts once
+ * it exceeds a budget on the number of entries, or on their total cost,
+ * eg. bytes.
+ *
+ * Entries are reference counted: @ref bs_lru_acquire and @ref bs_lru_insert
+ * return an acquired entry, that stays valid until @ref bs_lru_release and
+ * is never evicted while acquired. Evicted entries are handed to the evict
+ * callback, which typically frees them.
+ *
+ * With @ref BS_LRU_POLICY_CLOCK, an acquire only flags the entry as
+ * recently used, instead of moving it in the list; eviction gives flagged
+ * entries a second chance. This approximates LRU, at a lower cost per hit.
+ *
+ * With shards, the cache is thread-safe: Each shard has its own mutex, hash
+ * map, list and a share of the budget, and keys are spread by hash.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_LRU_H__
+#define __LIBBASE_LRU_H__
+
+#include "def.h"
+#include "dllist.h"
+#include "hashmap.h"
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Forward declaration: The cache. */
+typedef struct _bs_lru_t bs_lru_t;
+/** Forward declaration: A node of the cache, to embed in the entry. */
+typedef struct _bs_lru_node_t bs_lru_node_t;
+
+/** Eviction policy. */
+typedef enum {
+    /** Evicts the least-recently released entry. */
+    BS_LRU_POLICY_LRU,
+    /** Evicts the next entry not used since the clock hand passed it. */
+    BS_LRU_POLICY_CLOCK
+} bs_lru_policy_t;
+
+/** Node of the cache. Fields are private to the cache. */
+struct _bs_lru_node_t {
+    /** Node in the shard's hash map. Passed to the `equals` functor. */
+    bs_hashmap_node_t         hashmap_node;
+    /** Node in the shard's recency list. */
+    bs_dllist_node_t          dlnode;
+    /** Cost, as given to @ref bs_lru_insert. */
+    size_t                    cost;
+    /** Number of references from acquiring the entry. */
+    unsigned                  references;
+    /** Whether the entry is in the cache. False once erased or flushed. */
+    bool                      cached;
+    /** With @ref BS_LRU_POLICY_CLOCK: Whether acquired since last passed. */
+    bool                      recently_used;
+};
+
+/**
+ * Functor type to evict an entry. Called without holding any lock of the
+ * cache, and may call into the cache.
+ *
+ * @param node_ptr
+ * @param ud_ptr              As given to @ref bs_lru_create.
+ */
+typedef void (*bs_lru_evict_t)(bs_lru_node_t *node_ptr, void *ud_ptr);
+
+/**
+ * Creates a cache.
+ *
+ * @param hash                Hash of a key.
+ * @param equals              Whether the node's key equals the key. Receives
+ *     the `hashmap_node` of the @ref bs_lru_node_t; see
+ *     @ref bs_lru_node_from_hashmap_node.
+ * @param evict               Called for each evicted entry.
+ * @param evict_ud_ptr        Passed to `evict`.
+ * @param max_entries         Budget for the number of entries. SIZE_MAX for
+ *     no limit.
+ * @param max_cost            Budget for the total cost of entries. SIZE_MAX
+ *     for no limit.
+ * @param policy
+ * @param shards              Number of shards. 0 for a single shard, and no
+ *     locking: The cache is then not thread-safe.
+ *
+ * @return A pointer to the cache, or NULL on error. Must be destroyed by
+ *     @ref bs_lru_destroy.
+ */
+bs_lru_t *bs_lru_create(bs_hashmap_hash_t hash,
+                        bs_hashmap_node_equals_t equals,
+                        bs_lru_evict_t evict,
+                        void *evict_ud_ptr,
+                        size_t max_entries,
+                        size_t max_cost,
+                        bs_lru_policy_t policy,
+                        unsigned shards);
+
+/**
+ * Destroys the cache, and evicts all entries. No entry may be acquired.
+ *
+ * @param lru_ptr
+ */
+void bs_lru_destroy(bs_lru_t *lru_ptr);
+
+/**
+ * Looks up `key_ptr`, and acquires the entry if found.
+ *
+ * @param lru_ptr
+ * @param key_ptr
+ *
+ * @return The entry's node, or NULL if not cached. Release the node by
+ *     @ref bs_lru_release.
+ */
+bs_lru_node_t *bs_lru_acquire(bs_lru_t *lru_ptr, const void *key_ptr);
+
+/**
+ * Inserts the entry at `node_ptr` for `key_ptr`, unless there is already
+ * an entry for `key_ptr`. May evict other entries, to stay within budget.
+ *
+ * @param lru_ptr
+ * @param key_ptr
+ * @param node_ptr
+ * @param cost                Cost of the entry, towards `max_cost`.
+ *
+ * @return The acquired node: `node_ptr` if inserted, or the node of the
+ *     already-cached entry. In the latter case, `node_ptr` is not used and
+ *     remains owned by the caller. Release the node by @ref bs_lru_release.
+ *     NULL on allocation failure.
+ */
+bs_lru_node_t *bs_lru_insert(bs_lru_t *lru_ptr,
+                             const void *key_ptr,
+                             bs_lru_node_t *node_ptr,
+                             size_t cost);
+
+/**
+ * Releases a node acquired from @ref bs_lru_acquire or @ref bs_lru_insert.
+ * Once unreferenced, the entry may be evicted.
+ *
+ * @param lru_ptr
+ * @param node_ptr
+ */
+void bs_lru_release(bs_lru_t *lru_ptr, bs_lru_node_t *node_ptr);
+
+/**
+ * Removes the entry for `key_ptr`. It is evicted once unreferenced.
+ *
+ * @param lru_ptr
+ * @param key_ptr
+ *
+ * @return Whether there was an entry for `key_ptr`.
+ */
+bool bs_lru_erase(bs_lru_t *lru_ptr, const void *key_ptr);
+
+/**
+ * Removes all entries. Each is evicted once unreferenced.
+ *
+ * @param lru_ptr
+ */
+void bs_lru_flush(bs_lru_t *lru_ptr);
+
+/** Returns the number of entries in the cache. */
+size_t bs_lru_entries(bs_lru_t *lru_ptr);
+
+/** Returns the total cost of the entries in the cache. */
+size_t bs_lru_cost(bs_lru_t *lru_ptr);
+
+/** Returns the @ref bs_lru_node_t, for the node passed to `equals`. */
+static inline const bs_lru_node_t *bs_lru_node_from_hashmap_node(
+    const bs_hashmap_node_t *hashmap_node_ptr)
+{
+    return BS_CONTAINER_OF(hashmap_node_ptr, const bs_lru_node_t,
+                           hashmap_node);
+}
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_lru_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_lru_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_LRU_H__ */
+/* == End of lru.h ========================================================= */
@@ -0,0 +1,915 @@
+/* ========================================================================= */
+/**
+ * @file metrics.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "metrics.h"
+
+#include "atomic.h"
+#include "avltree.h"
+#include "def.h"
+#include "log_wrappers.h"
+#include "thread.h"
+#include "time.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* == Declarations ========================================================= */
+
+/** Assumed size of a cache line. */
+#define _BS_METRICS_CACHELINE 64
+/** Number of shards of counters and histograms. */
+#define _BS_METRICS_SHARDS 16
+/** Number of 64-bit values per cache line. */
+#define _BS_METRICS_CELLS_PER_LINE \
+    (_BS_METRICS_CACHELINE / sizeof(bs_atomic_int64_t))
+
+/** A value, padded to own a cache line. */
+typedef struct {
+    /** The value. */
+    bs_atomic_int64_t         value;
+    /** Padding. */
+    uint8_t                   padding[
+        _BS_METRICS_CACHELINE - sizeof(bs_atomic_int64_t)];
+} bs_metrics_cell_t;
+
+/** @private State of a counter. Allocated cache-line aligned. */
+struct _bs_metrics_counter_t {
+    /** The shards. Summed up on read. */
+    bs_metrics_cell_t         shards[_BS_METRICS_SHARDS];
+};
+
+/** @private State of a gauge. Allocated cache-line aligned. */
+struct _bs_metrics_gauge_t {
+    /** The value. */
+    bs_metrics_cell_t         cell;
+};
+
+/** @private State of a histogram. */
+struct _bs_metrics_histogram_t {
+    /** Number of bounds. There is one more bucket, for overflows. */
+    size_t                    bounds;
+    /** The bounds. */
+    int64_t                   *bounds_ptr;
+    /**
+     * One row of values per shard, cache-line aligned. A row holds the
+     * count for each bucket, followed by the sum of the recorded values.
+     */
+    bs_atomic_int64_t         *cells_ptr;
+    /** Number of values per row, rounded up to fill cache lines. */
+    size_t                    stride;
+};
+
+/** Kinds of metrics in the registry. */
+typedef enum {
+    BS_METRICS_COUNTER,
+    BS_METRICS_GAUGE,
+    BS_METRICS_HISTOGRAM
+} bs_metrics_kind_t;
+
+/** A metric in the registry. */
+typedef struct {
+    /** Node of @ref bs_metrics_t::tree_ptr. */
+    bs_avltree_node_t         avlnode;
+    /** Name of the metric. Key of the node. */
+    char                      *name_ptr;
+    /** Which kind of metric. */
+    bs_metrics_kind_t         kind;
+    /** The metric. */
+    union {
+        /** For @ref BS_METRICS_COUNTER. */
+        bs_metrics_counter_t  *counter_ptr;
+        /** For @ref BS_METRICS_GAUGE. */
+        bs_metrics_gauge_t    *gauge_ptr;
+        /** For @ref BS_METRICS_HISTOGRAM. */
+        bs_metrics_histogram_t *histogram_ptr;
+    };
+} bs_metrics_node_t;
+
+/** @private State of the registry. */
+struct _bs_metrics_t {
+    /** The metrics, as @ref bs_metrics_node_t, by name. */
+    bs_avltree_t              *tree_ptr;
+    /** Protects `tree_ptr`. */
+    pthread_mutex_t           mutex;
+};
+
+static unsigned _bs_metrics_shard(void);
+static void *_bs_metrics_aligned_calloc(size_t size);
+static bool _bs_metrics_is_name_valid(const char *name_ptr);
+static bs_metrics_node_t *_bs_metrics_lookup(bs_metrics_t *metrics_ptr,
+                                             const char *name_ptr,
+                                             bs_metrics_kind_t kind,
+                                             const int64_t *bounds_ptr,
+                                             size_t bounds);
+static bs_metrics_node_t *_bs_metrics_node_create(bs_metrics_kind_t kind,
+                                                  const char *name_ptr,
+                                                  const int64_t *bounds_ptr,
+                                                  size_t bounds);
+static void _bs_metrics_node_destroy(bs_avltree_node_t *avlnode_ptr);
+static int _bs_metrics_node_cmp(const bs_avltree_node_t *avlnode_ptr,
+                                const void *key_ptr);
+static int _bs_metrics_dump_histogram(FILE *stream_ptr,
+                                      const char *name_ptr,
+                                      bs_metrics_histogram_t *histogram_ptr);
+
+/** Number of threads that got assigned a shard so far. */
+static bs_atomic_int32_t      _bs_metrics_threads = BS_ATOMIC_INT32_INIT(0);
+/** Shard of the calling thread, plus one. 0 if not assigned yet. */
+static _Thread_local unsigned _bs_metrics_thread_shard;
+
+const int64_t bs_metrics_latency_usec_bounds[BS_METRICS_LATENCY_USEC_BOUNDS] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 500,
+    1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+    1000000, 2000000, 5000000, 10000000
+};
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_metrics_counter_t *bs_metrics_counter_create(void)
+{
+    return _bs_metrics_aligned_calloc(sizeof(bs_metrics_counter_t));
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_metrics_counter_destroy(bs_metrics_counter_t *counter_ptr)
+{
+    logged_free(counter_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_metrics_counter_add(bs_metrics_counter_t *counter_ptr, int64_t value)
+{
+    bs_atomic_int64_add_explicit(
+        &counter_ptr->shards[_bs_metrics_shard()].value, value,
+        BS_ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------------------------- */
+int64_t bs_metrics_counter_get(bs_metrics_counter_t *counter_ptr)
+{
+    int64_t sum = 0;
+    for (unsigned i = 0; i < _BS_METRICS_SHARDS; ++i) {
+        sum += bs_atomic_int64_get_explicit(&counter_ptr->shards[i].value,
+                                            BS_ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+/* ------------------------------------------------------------------------- */
+bs_metrics_gauge_t *bs_metrics_gauge_create(void)
+{
+    return _bs_metrics_aligned_calloc(sizeof(bs_metrics_gauge_t));
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_metrics_gauge_destroy(bs_metrics_gauge_t *gauge_ptr)
+{
+    logged_free(gauge_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_metrics_gauge_set(bs_metrics_gauge_t *gauge_ptr, int64_t value)
+{
+    bs_atomic_int64_set_explicit(&gauge_ptr->cell.value, value,
+                                 BS_ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_metrics_gauge_add(bs_metrics_gauge_t *gauge_ptr, int64_t value)
+{
+    bs_atomic_int64_add_explicit(&gauge_ptr->cell.value, value,
+                                 BS_ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------------------------- */
+int64_t bs_metrics_gauge_get(bs_metrics_gauge_t *gauge_ptr)
+{
+    return bs_atomic_int64_get_explicit(&gauge_ptr->cell.value,
+                                        BS_ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------------------------- */
+bs_metrics_histogram_t *bs_metrics_histogram_create(
+    const int64_t *bounds_ptr,
+    size_t bounds)
+{
+    if (0 == bounds) {
+        bs_log(BS_ERROR, "Histogram requires at least one bound.");
+        return NULL;
+    }
+    for (size_t i = 1; i < bounds; ++i) {
+        if (bounds_ptr[i - 1] >= bounds_ptr[i]) {
+            bs_log(BS_ERROR, "Histogram bounds not ascending at %zu: "
+                   "%"PRId64" >= %"PRId64, i, bounds_ptr[i - 1],
+                   bounds_ptr[i]);
+            return NULL;
+        }
+    }
+
+    bs_metrics_histogram_t *histogram_ptr = logged_calloc(
+        1, sizeof(bs_metrics_histogram_t));
+    if (NULL == histogram_ptr) return NULL;
+    histogram_ptr->bounds = bounds;
+    histogram_ptr->bounds_ptr = logged_malloc(bounds * sizeof(int64_t));
+    if (NULL == histogram_ptr->bounds_ptr) {
+        bs_metrics_histogram_destroy(histogram_ptr);
+        return NULL;
+    }
+    memcpy(histogram_ptr->bounds_ptr, bounds_ptr, bounds * sizeof(int64_t));
+
+    // Count of each bucket, one overflow bucket, and the sum.
+    histogram_ptr->stride = ((bounds + 2 + _BS_METRICS_CELLS_PER_LINE - 1) /
+                             _BS_METRICS_CELLS_PER_LINE *
+                             _BS_METRICS_CELLS_PER_LINE);
+    histogram_ptr->cells_ptr = _bs_metrics_aligned_calloc(
+        _BS_METRICS_SHARDS * histogram_ptr->stride *
+        sizeof(bs_atomic_int64_t));
+    if (NULL == histogram_ptr->cells_ptr) {
+        bs_metrics_histogram_destroy(histogram_ptr);
+        return NULL;
+    }
+    return histogram_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_metrics_histogram_destroy(bs_metrics_histogram_t *histogram_ptr)
+{
+    if (NULL != histogram_ptr->cells_ptr) logged_free(histogram_ptr->cells_ptr);
+    if (NULL != histogram_ptr->bounds_ptr) {
+        logged_free(histogram_ptr->bounds_ptr);
+    }
+    logged_free(histogram_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_metrics_histogram_record(bs_metrics_histogram_t *histogram_ptr,
+                                 int64_t value)
+{
+    // Binary search for the first bound not less than `value`.
+    size_t lo = 0, hi = histogram_ptr->bounds;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (histogram_ptr->bounds_ptr[mid] < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    bs_atomic_int64_t *row_ptr = &histogram_ptr->cells_ptr[
+        _bs_metrics_shard() * histogram_ptr->stride];
+    bs_atomic_int64_add_explicit(&row_ptr[lo], 1, BS_ATOMIC_RELAXED);
+    bs_atomic_int64_add_explicit(&row_ptr[histogram_ptr->bounds + 1], value,
+                                 BS_ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_metrics_histogram_bounds(bs_metrics_histogram_t *histogram_ptr)
+{
+    return histogram_ptr->bounds;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_metrics_histogram_get(bs_metrics_histogram_t *histogram_ptr,
+                              uint64_t *counts_ptr,
+                              uint64_t *count_ptr,
+                              int64_t *sum_ptr)
+{
+    uint64_t                  count = 0;
+    int64_t                   sum = 0;
+
+    if (NULL != counts_ptr) {
+        memset(counts_ptr, 0, (histogram_ptr->bounds + 1) * sizeof(uint64_t));
+    }
+    for (unsigned shard = 0; shard < _BS_METRICS_SHARDS; ++shard) {
+        bs_atomic_int64_t *row_ptr = &histogram_ptr->cells_ptr[
+            shard * histogram_ptr->stride];
+        for (size_t i = 0; i <= histogram_ptr->bounds; ++i) {
+            uint64_t c = bs_atomic_int64_get_explicit(&row_ptr[i],
+                                                      BS_ATOMIC_RELAXED);
+            if (NULL != counts_ptr) counts_ptr[i] += c;
+            count += c;
+        }
+        sum += bs_atomic_int64_get_explicit(
+            &row_ptr[histogram_ptr->bounds + 1], BS_ATOMIC_RELAXED);
+    }
+    if (NULL != count_ptr) *count_ptr = count;
+    if (NULL != sum_ptr) *sum_ptr = sum;
+}
+
+/* ------------------------------------------------------------------------- */
+bs_metrics_t *bs_metrics_create(void)
+{
+    bs_metrics_t *metrics_ptr = logged_calloc(1, sizeof(bs_metrics_t));
+    if (NULL == metrics_ptr) return NULL;
+
+    if (!bs_mutex_init(&metrics_ptr->mutex)) {
+        logged_free(metrics_ptr);
+        return NULL;
+    }
+    metrics_ptr->tree_ptr = bs_avltree_create(_bs_metrics_node_cmp,
+                                              _bs_metrics_node_destroy);
+    if (NULL == metrics_ptr->tree_ptr) {
+        bs_metrics_destroy(metrics_ptr);
+        return NULL;
+    }
+    return metrics_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_metrics_destroy(bs_metrics_t *metrics_ptr)
+{
+    if (NULL != metrics_ptr->tree_ptr) {
+        bs_avltree_destroy(metrics_ptr->tree_ptr);
+    }
+    bs_mutex_destroy(&metrics_ptr->mutex);
+    logged_free(metrics_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bs_metrics_counter_t *bs_metrics_counter(bs_metrics_t *metrics_ptr,
+                                         const char *name_ptr)
+{
+    bs_metrics_node_t *node_ptr = _bs_metrics_lookup(
+        metrics_ptr, name_ptr, BS_METRICS_COUNTER, NULL, 0);
+    return NULL != node_ptr ? node_ptr->counter_ptr : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+bs_metrics_gauge_t *bs_metrics_gauge(bs_metrics_t *metrics_ptr,
+                                     const char *name_ptr)
+{
+    bs_metrics_node_t *node_ptr = _bs_metrics_lookup(
+        metrics_ptr, name_ptr, BS_METRICS_GAUGE, NULL, 0);
+    return NULL != node_ptr ? node_ptr->gauge_ptr : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+bs_metrics_histogram_t *bs_metrics_histogram(bs_metrics_t *metrics_ptr,
+                                             const char *name_ptr,
+                                             const int64_t *bounds_ptr,
+                                             size_t bounds)
+{
+    bs_metrics_node_t *node_ptr = _bs_metrics_lookup(
+        metrics_ptr, name_ptr, BS_METRICS_HISTOGRAM, bounds_ptr, bounds);
+    return NULL != node_ptr ? node_ptr->histogram_ptr : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+int bs_metrics_dump(bs_metrics_t *metrics_ptr, FILE *stream_ptr)
+{
+    int                       written_bytes = 0, rv = 0;
+
+    bs_mutex_lock(&metrics_ptr->mutex);
+    for (bs_avltree_node_t *avlnode_ptr = bs_avltree_min(
+             metrics_ptr->tree_ptr);
+         NULL != avlnode_ptr && 0 <= rv;
+         avlnode_ptr = bs_avltree_node_next(metrics_ptr->tree_ptr,
+                                            avlnode_ptr)) {
+        bs_metrics_node_t *node_ptr = BS_CONTAINER_OF(
+            avlnode_ptr, bs_metrics_node_t, avlnode);
+        switch (node_ptr->kind) {
+        case BS_METRICS_COUNTER:
+            rv = fprintf(stream_ptr, "# TYPE %s counter\n%s %"PRId64"\n",
+                         node_ptr->name_ptr, node_ptr->name_ptr,
+                         bs_metrics_counter_get(node_ptr->counter_ptr));
+            break;
+        case BS_METRICS_GAUGE:
+            rv = fprintf(stream_ptr, "# TYPE %s gauge\n%s %"PRId64"\n",
+                         node_ptr->name_ptr, node_ptr->name_ptr,
+                         bs_metrics_gauge_get(node_ptr->gauge_ptr));
+            break;
+        case BS_METRICS_HISTOGRAM:
+            rv = _bs_metrics_dump_histogram(stream_ptr, node_ptr->name_ptr,
+                                            node_ptr->histogram_ptr);
+            break;
+        }
+        if (0 <= rv) written_bytes += rv;
+    }
+    bs_mutex_unlock(&metrics_ptr->mutex);
+    return 0 <= rv ? written_bytes : -1;
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Returns the calling thread's shard. Assigns them round-robin. */
+unsigned _bs_metrics_shard(void)
+{
+    if (0 == _bs_metrics_thread_shard) {
+        uint32_t thread = bs_atomic_int32_add(&_bs_metrics_threads, 1);
+        _bs_metrics_thread_shard = 1 + thread % _BS_METRICS_SHARDS;
+    }
+    return _bs_metrics_thread_shard - 1;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Allocates zeroed, cache-line aligned memory. Release with free(3). */
+void *_bs_metrics_aligned_calloc(size_t size)
+{
+    // aligned_alloc(3) wants a multiple of the alignment.
+    size = (size + _BS_METRICS_CACHELINE - 1) &
+        ~(size_t)(_BS_METRICS_CACHELINE - 1);
+    void *ptr = aligned_alloc(_BS_METRICS_CACHELINE, size);
+    if (NULL == ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed aligned_alloc(%d, %zu)",
+               _BS_METRICS_CACHELINE, size);
+        return NULL;
+    }
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Names may only hold [a-zA-Z0-9_:], and must not start with a digit. */
+bool _bs_metrics_is_name_valid(const char *name_ptr)
+{
+    if (!isalpha(*name_ptr) && '_' != *name_ptr && ':' != *name_ptr) {
+        bs_log(BS_ERROR, "Metric name must start with [a-zA-Z_:]: \"%s\"",
+               name_ptr);
+        return false;
+    }
+    for (const char *c_ptr = name_ptr + 1; '\0' != *c_ptr; ++c_ptr) {
+        if (isalnum(*c_ptr) || '_' == *c_ptr || ':' == *c_ptr) continue;
+        bs_log(BS_ERROR, "Metric name must only contain [a-zA-Z0-9_:]: "
+               "\"%s\"", name_ptr);
+        return false;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Looks up the metric `name_ptr` of `kind`, and creates it if needed. */
+bs_metrics_node_t *_bs_metrics_lookup(bs_metrics_t *metrics_ptr,
+                                      const char *name_ptr,
+                                      bs_metrics_kind_t kind,
+                                      const int64_t *bounds_ptr,
+                                      size_t bounds)
+{
+    bs_metrics_node_t         *node_ptr = NULL;
+
+    bs_mutex_lock(&metrics_ptr->mutex);
+    bs_avltree_node_t *avlnode_ptr = bs_avltree_lookup(
+        metrics_ptr->tree_ptr, name_ptr);
+    if (NULL != avlnode_ptr) {
+        node_ptr = BS_CONTAINER_OF(avlnode_ptr, bs_metrics_node_t, avlnode);
+        if (node_ptr->kind != kind) {
+            bs_log(BS_ERROR, "Metric \"%s\" exists as another kind.",
+                   name_ptr);
+            node_ptr = NULL;
+        } else if (BS_METRICS_HISTOGRAM == kind &&
+                   (node_ptr->histogram_ptr->bounds != bounds ||
+                    0 != memcmp(node_ptr->histogram_ptr->bounds_ptr,
+                                bounds_ptr, bounds * sizeof(int64_t)))) {
+            bs_log(BS_ERROR, "Histogram \"%s\" exists with other bounds.",
+                   name_ptr);
+            node_ptr = NULL;
+        }
+    } else if (_bs_metrics_is_name_valid(name_ptr)) {
+        node_ptr = _bs_metrics_node_create(kind, name_ptr, bounds_ptr, bounds);
+        if (NULL != node_ptr) {
+            bs_avltree_insert(metrics_ptr->tree_ptr, node_ptr->name_ptr,
+                              &node_ptr->avlnode, false);
+        }
+    }
+    bs_mutex_unlock(&metrics_ptr->mutex);
+    return node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Creates a node, holding a new metric. */
+bs_metrics_node_t *_bs_metrics_node_create(bs_metrics_kind_t kind,
+                                           const char *name_ptr,
+                                           const int64_t *bounds_ptr,
+                                           size_t bounds)
+{
+    bs_metrics_node_t *node_ptr = logged_calloc(1, sizeof(bs_metrics_node_t));
+    if (NULL == node_ptr) return NULL;
+    node_ptr->kind = kind;
+
+    void *metric_ptr = NULL;
+    switch (kind) {
+    case BS_METRICS_COUNTER:
+        metric_ptr = node_ptr->counter_ptr = bs_metrics_counter_create();
+        break;
+    case BS_METRICS_GAUGE:
+        metric_ptr = node_ptr->gauge_ptr = bs_metrics_gauge_create();
+        break;
+    case BS_METRICS_HISTOGRAM:
+        metric_ptr = node_ptr->histogram_ptr = bs_metrics_histogram_create(
+            bounds_ptr, bounds);
+        break;
+    }
+    node_ptr->name_ptr = logged_strdup(name_ptr);
+    if (NULL == metric_ptr || NULL == node_ptr->name_ptr) {
+        _bs_metrics_node_destroy(&node_ptr->avlnode);
+        return NULL;
+    }
+    return node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Destroys the node and its metric. */
+void _bs_metrics_node_destroy(bs_avltree_node_t *avlnode_ptr)
+{
+    bs_metrics_node_t *node_ptr = BS_CONTAINER_OF(
+        avlnode_ptr, bs_metrics_node_t, avlnode);
+    switch (node_ptr->kind) {
+    case BS_METRICS_COUNTER:
+        if (NULL != node_ptr->counter_ptr) {
+            bs_metrics_counter_destroy(node_ptr->counter_ptr);
+        }
+        break;
+    case BS_METRICS_GAUGE:
+        if (NULL != node_ptr->gauge_ptr) {
+            bs_metrics_gauge_destroy(node_ptr->gauge_ptr);
+        }
+        break;
+    case BS_METRICS_HISTOGRAM:
+        if (NULL != node_ptr->histogram_ptr) {
+            bs_metrics_histogram_destroy(node_ptr->histogram_ptr);
+        }
+        break;
+    }
+    if (NULL != node_ptr->name_ptr) logged_free(node_ptr->name_ptr);
+    logged_free(node_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Comparator for the registry's tree. Key is the name. */
+int _bs_metrics_node_cmp(const bs_avltree_node_t *avlnode_ptr,
+                         const void *key_ptr)
+{
+    bs_metrics_node_t *node_ptr = BS_CONTAINER_OF(
+        avlnode_ptr, bs_metrics_node_t, avlnode);
+    return strcmp(node_ptr->name_ptr, (const char*)key_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Writes the histogram, with cumulative buckets. */
+int _bs_metrics_dump_histogram(FILE *stream_ptr,
+                               const char *name_ptr,
+                               bs_metrics_histogram_t *histogram_ptr)
+{
+    uint64_t                  count, cumulative = 0;
+    int64_t                   sum;
+    int                       written_bytes, rv;
+
+    uint64_t *counts_ptr = logged_calloc(histogram_ptr->bounds + 1,
+                                         sizeof(uint64_t));
+    if (NULL == counts_ptr) return -1;
+    bs_metrics_histogram_get(histogram_ptr, counts_ptr, &count, &sum);
+
+    written_bytes = fprintf(stream_ptr, "# TYPE %s histogram\n", name_ptr);
+    for (size_t i = 0; i < histogram_ptr->bounds && 0 <= written_bytes; ++i) {
+        cumulative += counts_ptr[i];
+        rv = fprintf(stream_ptr, "%s_bucket{le=\"%"PRId64"\"} %"PRIu64"\n",
+                     name_ptr, histogram_ptr->bounds_ptr[i], cumulative);
+        written_bytes = 0 <= rv ? written_bytes + rv : rv;
+    }
+    logged_free(counts_ptr);
+    if (0 > written_bytes) return written_bytes;
+
+    rv = fprintf(stream_ptr, "%s_bucket{le=\"+Inf\"} %"PRIu64"\n"
+                 "%s_sum %"PRId64"\n%s_count %"PRIu64"\n",
+                 name_ptr, count, name_ptr, sum, name_ptr, count);
+    return 0 <= rv ? written_bytes + rv : rv;
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_counter(bs_test_t *test_ptr);
+static void test_gauge(bs_test_t *test_ptr);
+static void test_histogram(bs_test_t *test_ptr);
+static void test_registry(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_metrics_test_cases[] = {
+    { 1, "counter", test_counter },
+    { 1, "gauge", test_gauge },
+    { 1, "histogram", test_histogram },
+    { 1, "registry", test_registry },
+    { 0, NULL, NULL }
+};
+
+/** Number of threads in @ref test_counter. */
+#define _TEST_THREADS 8
+/** Number of adds per thread in @ref test_counter. */
+#define _TEST_ADDS 100000
+
+/** Argument to @ref _test_counter_thread. */
+typedef struct {
+    /** The counter. */
+    bs_metrics_counter_t      *counter_ptr;
+    /** The histogram. */
+    bs_metrics_histogram_t    *histogram_ptr;
+} test_counter_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Adds to the counter, and records in the histogram. */
+static void *_test_counter_thread(void *arg_ptr)
+{
+    test_counter_arg_t *targ_ptr = arg_ptr;
+    for (int i = 0; i < _TEST_ADDS; ++i) {
+        bs_metrics_counter_add(targ_ptr->counter_ptr, 1);
+        bs_metrics_histogram_record(targ_ptr->histogram_ptr, i & 1);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Exercises the counter, from one and from several threads. */
+void test_counter(bs_test_t *test_ptr)
+{
+    pthread_t                 threads[_TEST_THREADS];
+    uint64_t                  counts[2], count;
+    int64_t                   sum;
+    const int64_t             bounds[] = { 0 };
+
+    bs_metrics_counter_t *counter_ptr = bs_metrics_counter_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, counter_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_metrics_counter_get(counter_ptr));
+    bs_metrics_counter_add(counter_ptr, 1);
+    bs_metrics_counter_add(counter_ptr, 41);
+    BS_TEST_VERIFY_EQ(test_ptr, 42, bs_metrics_counter_get(counter_ptr));
+    bs_metrics_counter_add(counter_ptr, -42);
+
+    test_counter_arg_t targ = {
+        .counter_ptr = counter_ptr,
+        .histogram_ptr = bs_metrics_histogram_create(bounds, 1)
+    };
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, targ.histogram_ptr);
+    for (int t = 0; t < _TEST_THREADS; ++t) {
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, 0,
+            pthread_create(&threads[t], NULL, _test_counter_thread, &targ));
+    }
+    for (int t = 0; t < _TEST_THREADS; ++t) pthread_join(threads[t], NULL);
+
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS * _TEST_ADDS,
+                      bs_metrics_counter_get(counter_ptr));
+    bs_metrics_histogram_get(targ.histogram_ptr, counts, &count, &sum);
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS * _TEST_ADDS / 2, counts[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS * _TEST_ADDS / 2, counts[1]);
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS * _TEST_ADDS, count);
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS * _TEST_ADDS / 2, sum);
+
+    bs_metrics_histogram_destroy(targ.histogram_ptr);
+    bs_metrics_counter_destroy(counter_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Exercises the gauge. */
+void test_gauge(bs_test_t *test_ptr)
+{
+    bs_metrics_gauge_t *gauge_ptr = bs_metrics_gauge_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, gauge_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_metrics_gauge_get(gauge_ptr));
+    bs_metrics_gauge_set(gauge_ptr, 100);
+    bs_metrics_gauge_add(gauge_ptr, -58);
+    BS_TEST_VERIFY_EQ(test_ptr, 42, bs_metrics_gauge_get(gauge_ptr));
+    bs_metrics_gauge_set(gauge_ptr, -7);
+    BS_TEST_VERIFY_EQ(test_ptr, -7, bs_metrics_gauge_get(gauge_ptr));
+    bs_metrics_gauge_destroy(gauge_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies bucketing, at and around the bounds. */
+void test_histogram(bs_test_t *test_ptr)
+{
+    const int64_t             bounds[] = { 10, 20, 50 };
+    const int64_t             bad_bounds[] = { 10, 10 };
+    uint64_t                  counts[4], count;
+    int64_t                   sum;
+
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_metrics_histogram_create(bounds, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL,
+                      bs_metrics_histogram_create(bad_bounds, 2));
+
+    bs_metrics_histogram_t *histogram_ptr = bs_metrics_histogram_create(
+        bounds, 3);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, histogram_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_metrics_histogram_bounds(histogram_ptr));
+
+    const int64_t values[] = { 5, 10, -3, 11, 50, 51, 1000 };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        bs_metrics_histogram_record(histogram_ptr, values[i]);
+    }
+    bs_metrics_histogram_get(histogram_ptr, counts, &count, &sum);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, counts[0]);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, counts[1]);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, counts[2]);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, counts[3]);
+    BS_TEST_VERIFY_EQ(test_ptr, 7, count);
+    BS_TEST_VERIFY_EQ(test_ptr, 1124, sum);
+    bs_metrics_histogram_destroy(histogram_ptr);
+
+    histogram_ptr = bs_metrics_histogram_create(
+        bs_metrics_latency_usec_bounds, BS_METRICS_LATENCY_USEC_BOUNDS);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, histogram_ptr);
+    bs_metrics_histogram_destroy(histogram_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies lookups in the registry, and the dump. */
+void test_registry(bs_test_t *test_ptr)
+{
+    const int64_t             bounds[] = { 10, 20 };
+    char                      buf[1024];
+
+    bs_metrics_t *metrics_ptr = bs_metrics_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, metrics_ptr);
+
+    bs_metrics_counter_t *counter_ptr = bs_metrics_counter(
+        metrics_ptr, "requests_total");
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, counter_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, counter_ptr,
+                      bs_metrics_counter(metrics_ptr, "requests_total"));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL,
+                      bs_metrics_gauge(metrics_ptr, "requests_total"));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_metrics_counter(metrics_ptr, "1a"));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_metrics_counter(metrics_ptr, "a-b"));
+    bs_metrics_counter_add(counter_ptr, 3);
+
+    bs_metrics_gauge_t *gauge_ptr = bs_metrics_gauge(metrics_ptr, "depth");
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, gauge_ptr);
+    bs_metrics_gauge_set(gauge_ptr, -2);
+
+    bs_metrics_histogram_t *histogram_ptr = bs_metrics_histogram(
+        metrics_ptr, "latency_usec", bounds, 2);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, histogram_ptr);
+    BS_TEST_VERIFY_EQ(
+        test_ptr, histogram_ptr,
+        bs_metrics_histogram(metrics_ptr, "latency_usec", bounds, 2));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, NULL,
+        bs_metrics_histogram(metrics_ptr, "latency_usec", bounds, 1));
+    bs_metrics_histogram_record(histogram_ptr, 7);
+    bs_metrics_histogram_record(histogram_ptr, 15);
+    bs_metrics_histogram_record(histogram_ptr, 25);
+
+    FILE *stream_ptr = tmpfile();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, stream_ptr);
+    int bytes = bs_metrics_dump(metrics_ptr, stream_ptr);
+    rewind(stream_ptr);
+    size_t len = fread(buf, 1, sizeof(buf) - 1, stream_ptr);
+    buf[len] = '\0';
+    fclose(stream_ptr);
+
+    const char *expected_ptr =
+        "# TYPE depth gauge\n"
+        "depth -2\n"
+        "# TYPE latency_usec histogram\n"
+        "latency_usec_bucket{le=\"10\"} 1\n"
+        "latency_usec_bucket{le=\"20\"} 2\n"
+        "latency_usec_bucket{le=\"+Inf\"} 3\n"
+        "latency_usec_sum 47\n"
+        "latency_usec_count 3\n"
+        "# TYPE requests_total counter\n"
+        "requests_total 3\n";
+    BS_TEST_VERIFY_STREQ(test_ptr, expected_ptr, buf);
+    BS_TEST_VERIFY_EQ(test_ptr, (int)strlen(expected_ptr), bytes);
+
+    bs_metrics_destroy(metrics_ptr);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_contention_atomic(bs_test_t *test_ptr);
+static void benchmark_contention_counter(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t bs_metrics_benchmarks[] = {
+    { 1, "benchmark-contention-atomic", benchmark_contention_atomic },
+    { 1, "benchmark-contention-counter", benchmark_contention_counter },
+    { 0, NULL, NULL }
+};
+
+/** Maximum number of threads in the benchmark. */
+#define _BENCHMARK_MAX_THREADS 8
+
+/** Argument for the benchmark threads. */
+typedef struct {
+    /** A `bs_atomic_int64_t` or a `bs_metrics_counter_t` to add to. */
+    void                      *target_ptr;
+    /** Set to non-zero to terminate. */
+    bs_atomic_int32_t         *stop_ptr;
+    /** Number of adds. */
+    uint64_t                  adds;
+} benchmark_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Adds to a shared atomic. */
+static void *_benchmark_atomic_thread(void *arg_ptr)
+{
+    benchmark_arg_t *barg_ptr = arg_ptr;
+    while (0 == bs_atomic_int32_get(barg_ptr->stop_ptr)) {
+        for (int i = 0; i < 1000; ++i) {
+            bs_atomic_int64_add(barg_ptr->target_ptr, 1);
+        }
+        barg_ptr->adds += 1000;
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Adds to a sharded counter. */
+static void *_benchmark_counter_thread(void *arg_ptr)
+{
+    benchmark_arg_t *barg_ptr = arg_ptr;
+    while (0 == bs_atomic_int32_get(barg_ptr->stop_ptr)) {
+        for (int i = 0; i < 1000; ++i) {
+            bs_metrics_counter_add(barg_ptr->target_ptr, 1);
+        }
+        barg_ptr->adds += 1000;
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs `thread_func` on 1, 2, 4 and 8 threads, each for a quarter of the
+ * benchmark duration, and reports the throughput for each thread count.
+ */
+static void _benchmark_contention(bs_test_t *test_ptr,
+                                  void *(*thread_func)(void *),
+                                  void *target_ptr)
+{
+    benchmark_arg_t           bargs[_BENCHMARK_MAX_THREADS];
+    pthread_t                 threads[_BENCHMARK_MAX_THREADS];
+    double                    rates[4];
+
+    for (int run = 0; run < 4; ++run) {
+        int num_threads = 1 << run;
+        bs_atomic_int32_t stop = BS_ATOMIC_INT32_INIT(0);
+        for (int t = 0; t < num_threads; ++t) {
+            bargs[t] = (benchmark_arg_t){
+                .target_ptr = target_ptr, .stop_ptr = &stop };
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, 0,
+                pthread_create(&threads[t], NULL, thread_func, &bargs[t]));
+        }
+        uint64_t usec = bs_usec();
+        while (usec + benchmark_duration / 4 >= bs_usec()) {
+            usleep(10000);
+        }
+        bs_atomic_int32_set(&stop, 1);
+        uint64_t adds = 0;
+        for (int t = 0; t < num_threads; ++t) {
+            pthread_join(threads[t], NULL);
+            adds += bargs[t].adds;
+        }
+        usec = bs_usec() - usec;
+        rates[run] = (double)adds / (usec * 1e-6);
+    }
+
+    bs_test_succeed(test_ptr, "%.3e, %.3e, %.3e, %.3e adds/sec at "
+                    "1, 2, 4, 8 threads", rates[0], rates[1], rates[2],
+                    rates[3]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks a single shared `bs_atomic_int64_t`, as baseline. */
+void benchmark_contention_atomic(bs_test_t *test_ptr)
+{
+    bs_metrics_gauge_t *gauge_ptr = bs_metrics_gauge_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, gauge_ptr);
+    _benchmark_contention(test_ptr, _benchmark_atomic_thread,
+                          &gauge_ptr->cell.value);
+    bs_metrics_gauge_destroy(gauge_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks the sharded counter. */
+void benchmark_contention_counter(bs_test_t *test_ptr)
+{
+    bs_metrics_counter_t *counter_ptr = bs_metrics_counter_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, counter_ptr);
+    _benchmark_contention(test_ptr, _benchmark_counter_thread, counter_ptr);
+    bs_metrics_counter_destroy(counter_ptr);
+}
+
+/* == End of metrics.c ===================================================== */
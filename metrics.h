@@ -0,0 +1,195 @@
+/* ========================================================================= */
+/**
+ * @file metrics.h
+ * Counters, gauges and histograms for instrumenting hot paths, and a
+ * registry to dump them as text.
+ *
+ * Counters and histograms are sharded: Each thread updates its own shard,
+ * padded to a cache line, with a relaxed atomic add. Reads sum up all
+ * shards. Updates from many threads thus do not contend on a shared cache
+ * line, while reads are more expensive and may miss concurrent updates.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_METRICS_H__
+#define __LIBBASE_METRICS_H__
+
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Forward declaration: A monotonic counter. */
+typedef struct _bs_metrics_counter_t bs_metrics_counter_t;
+/** Forward declaration: A gauge, holding a current value. */
+typedef struct _bs_metrics_gauge_t bs_metrics_gauge_t;
+/** Forward declaration: A histogram with fixed buckets. */
+typedef struct _bs_metrics_histogram_t bs_metrics_histogram_t;
+/** Forward declaration: A registry of named metrics. */
+typedef struct _bs_metrics_t bs_metrics_t;
+
+/** Number of bucket bounds in @ref bs_metrics_latency_usec_bounds. */
+#define BS_METRICS_LATENCY_USEC_BOUNDS 22
+
+/** Bucket bounds for latencies in microseconds: 1us, 2us, 5us ... 10s. */
+extern const int64_t bs_metrics_latency_usec_bounds[
+    BS_METRICS_LATENCY_USEC_BOUNDS];
+
+/**
+ * Creates a counter, starting from zero.
+ *
+ * @return A pointer to the counter, or NULL on error. Must be destroyed by
+ *     calling @ref bs_metrics_counter_destroy.
+ */
+bs_metrics_counter_t *bs_metrics_counter_create(void);
+
+/** Destroys the counter. */
+void bs_metrics_counter_destroy(bs_metrics_counter_t *counter_ptr);
+
+/** Adds `value` to the counter. Thread-safe, to the calling thread's shard. */
+void bs_metrics_counter_add(bs_metrics_counter_t *counter_ptr, int64_t value);
+
+/** Returns the sum over all shards of the counter. Thread-safe. */
+int64_t bs_metrics_counter_get(bs_metrics_counter_t *counter_ptr);
+
+/**
+ * Creates a gauge, starting at zero. A gauge is a single value, and is not
+ * sharded: It is meant for values that get set, rather than counted.
+ *
+ * @return A pointer to the gauge, or NULL on error. Must be destroyed by
+ *     calling @ref bs_metrics_gauge_destroy.
+ */
+bs_metrics_gauge_t *bs_metrics_gauge_create(void);
+
+/** Destroys the gauge. */
+void bs_metrics_gauge_destroy(bs_metrics_gauge_t *gauge_ptr);
+
+/** Sets the gauge to `value`. Thread-safe. */
+void bs_metrics_gauge_set(bs_metrics_gauge_t *gauge_ptr, int64_t value);
+
+/** Adds `value` to the gauge. Thread-safe. */
+void bs_metrics_gauge_add(bs_metrics_gauge_t *gauge_ptr, int64_t value);
+
+/** Returns the value of the gauge. Thread-safe. */
+int64_t bs_metrics_gauge_get(bs_metrics_gauge_t *gauge_ptr);
+
+/**
+ * Creates a histogram.
+ *
+ * @param bounds_ptr          Inclusive upper bounds of the buckets, strictly
+ *                            ascending. Values above the last bound go to an
+ *                            extra overflow bucket. The array is copied.
+ * @param bounds              Number of bounds. Must be at least 1.
+ *
+ * @return A pointer to the histogram, or NULL on error. Must be destroyed by
+ *     calling @ref bs_metrics_histogram_destroy.
+ */
+bs_metrics_histogram_t *bs_metrics_histogram_create(
+    const int64_t *bounds_ptr,
+    size_t bounds);
+
+/** Destroys the histogram. */
+void bs_metrics_histogram_destroy(bs_metrics_histogram_t *histogram_ptr);
+
+/** Records `value` in the histogram. Thread-safe. */
+void bs_metrics_histogram_record(bs_metrics_histogram_t *histogram_ptr,
+                                 int64_t value);
+
+/** Returns the number of bounds of the histogram. */
+size_t bs_metrics_histogram_bounds(bs_metrics_histogram_t *histogram_ptr);
+
+/**
+ * Aggregates the histogram's shards. Thread-safe.
+ *
+ * @param histogram_ptr
+ * @param counts_ptr          Array of bounds + 1 elements, or NULL. Is set to
+ *                            the number of values recorded in each bucket,
+ *                            with the overflow bucket last.
+ * @param count_ptr           Optional, is set to the number of values.
+ * @param sum_ptr             Optional, is set to the sum of all values.
+ */
+void bs_metrics_histogram_get(bs_metrics_histogram_t *histogram_ptr,
+                              uint64_t *counts_ptr,
+                              uint64_t *count_ptr,
+                              int64_t *sum_ptr);
+
+/**
+ * Creates a registry.
+ *
+ * @return A pointer to the registry, or NULL on error. Must be destroyed by
+ *     calling @ref bs_metrics_destroy.
+ */
+bs_metrics_t *bs_metrics_create(void);
+
+/** Destroys the registry, and all the metrics it holds. */
+void bs_metrics_destroy(bs_metrics_t *metrics_ptr);
+
+/**
+ * Returns the counter named `name_ptr`, and creates it if needed.
+ * Thread-safe. Callers on hot paths should look up once, and keep the
+ * pointer: It remains valid until the registry is destroyed.
+ *
+ * @param metrics_ptr
+ * @param name_ptr            Must only contain [a-zA-Z0-9_:].
+ *
+ * @return The counter, or NULL on error, or if `name_ptr` is registered as
+ *     another kind of metric.
+ */
+bs_metrics_counter_t *bs_metrics_counter(bs_metrics_t *metrics_ptr,
+                                         const char *name_ptr);
+
+/** Same as @ref bs_metrics_counter, for a gauge. */
+bs_metrics_gauge_t *bs_metrics_gauge(bs_metrics_t *metrics_ptr,
+                                     const char *name_ptr);
+
+/**
+ * Same as @ref bs_metrics_counter, for a histogram. Fails if the histogram
+ * exists already, with different bounds.
+ */
+bs_metrics_histogram_t *bs_metrics_histogram(bs_metrics_t *metrics_ptr,
+                                             const char *name_ptr,
+                                             const int64_t *bounds_ptr,
+                                             size_t bounds);
+
+/**
+ * Writes all metrics to `stream_ptr`, sorted by name, in the Prometheus
+ * text format. Histogram buckets are cumulative.
+ *
+ * @param metrics_ptr
+ * @param stream_ptr
+ *
+ * @return Number of bytes written, or a negative value on error.
+ */
+int bs_metrics_dump(bs_metrics_t *metrics_ptr, FILE *stream_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_metrics_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_metrics_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_METRICS_H__ */
+/* == End of metrics.h ===================================================== */
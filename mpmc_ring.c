@@ -0,0 +1,651 @@
+/* ========================================================================= */
+/**
+ * @file mpmc_ring.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mpmc_ring.h"
+
+#include "atomic.h"
+#include "dequeue.h"
+#include "log_wrappers.h"
+#include "thread.h"
+#include "time.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* == Declarations ========================================================= */
+
+/** Assumed size of a cache line. */
+#define _BS_MPMC_RING_CACHELINE 64
+/** Maximum capacity of the ring. */
+#define _BS_MPMC_RING_MAX_CAPACITY ((size_t)1 << 30)
+
+/** A slot of the ring. */
+typedef struct {
+    /**
+     * Sequence counter. Equals the position when the slot is ready to be
+     * written, and position + 1 when it is ready to be read.
+     */
+    bs_atomic_int64_t         sequence;
+    /** The element, as an intptr_t. */
+    bs_atomic_int64_t         element;
+} bs_mpmc_ring_slot_t;
+
+/** A position, padded to own a cache line. Avoids false sharing. */
+typedef struct {
+    /** The position. */
+    bs_atomic_int64_t         value;
+    /** Padding. */
+    uint8_t                   padding[
+        _BS_MPMC_RING_CACHELINE - sizeof(bs_atomic_int64_t)];
+} bs_mpmc_ring_position_t;
+
+/** @private State of the ring. */
+struct _bs_mpmc_ring_t {
+    /** Position of the next push. Shared by producers. */
+    bs_mpmc_ring_position_t   push_pos;
+    /** Position of the next pop. Shared by consumers. */
+    bs_mpmc_ring_position_t   pop_pos;
+
+    /** The slots. */
+    bs_mpmc_ring_slot_t       *slots_ptr;
+    /** Number of slots minus 1. The number of slots is a power of two. */
+    size_t                    mask;
+
+    /** Number of threads blocked in a wait. Pushes and pops notify these. */
+    bs_atomic_int32_t         waiters;
+    /** Protects the wait on `cond`. */
+    pthread_mutex_t           mutex;
+    /** Broadcasted on push or pop, whenever there are `waiters`. */
+    pthread_cond_t            cond;
+};
+
+static bool _bs_mpmc_ring_try_push(bs_mpmc_ring_t *ring_ptr,
+                                   void *element_ptr);
+static bool _bs_mpmc_ring_try_pop(bs_mpmc_ring_t *ring_ptr,
+                                  void **element_ptr_ptr);
+static void _bs_mpmc_ring_store_fence(bs_atomic_int64_t *a_ptr,
+                                      int64_t value);
+static void _bs_mpmc_ring_notify(bs_mpmc_ring_t *ring_ptr);
+static bool _bs_mpmc_ring_wait(bs_mpmc_ring_t *ring_ptr,
+                               bool push,
+                               void **element_ptr_ptr,
+                               uint64_t usec);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_mpmc_ring_t *bs_mpmc_ring_create(size_t capacity)
+{
+    if (0 == capacity || _BS_MPMC_RING_MAX_CAPACITY < capacity) {
+        bs_log(BS_ERROR, "Capacity %zu out of range.", capacity);
+        return NULL;
+    }
+    // With a single slot, a written slot's sequence would equal the next
+    // position, and look free. Hence, use at least two.
+    size_t slots = 2;
+    while (slots < capacity) slots <<= 1;
+
+    bs_mpmc_ring_t *ring_ptr = logged_calloc(1, sizeof(bs_mpmc_ring_t));
+    if (NULL == ring_ptr) return NULL;
+    ring_ptr->slots_ptr = logged_calloc(slots, sizeof(bs_mpmc_ring_slot_t));
+    if (NULL == ring_ptr->slots_ptr) {
+        logged_free(ring_ptr);
+        return NULL;
+    }
+    for (size_t i = 0; i < slots; ++i) {
+        bs_atomic_int64_set(&ring_ptr->slots_ptr[i].sequence, i);
+    }
+    ring_ptr->mask = slots - 1;
+
+    if (!bs_mutex_init(&ring_ptr->mutex)) {
+        logged_free(ring_ptr->slots_ptr);
+        logged_free(ring_ptr);
+        return NULL;
+    }
+    if (!bs_cond_init(&ring_ptr->cond)) {
+        bs_mutex_destroy(&ring_ptr->mutex);
+        logged_free(ring_ptr->slots_ptr);
+        logged_free(ring_ptr);
+        return NULL;
+    }
+    return ring_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_mpmc_ring_destroy(bs_mpmc_ring_t *ring_ptr)
+{
+    bs_cond_destroy(&ring_ptr->cond);
+    bs_mutex_destroy(&ring_ptr->mutex);
+    logged_free(ring_ptr->slots_ptr);
+    logged_free(ring_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_mpmc_ring_capacity(bs_mpmc_ring_t *ring_ptr)
+{
+    return ring_ptr->mask + 1;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_mpmc_ring_push(bs_mpmc_ring_t *ring_ptr, void *element_ptr)
+{
+    if (!_bs_mpmc_ring_try_push(ring_ptr, element_ptr)) return false;
+    _bs_mpmc_ring_notify(ring_ptr);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_mpmc_ring_pop(bs_mpmc_ring_t *ring_ptr, void **element_ptr_ptr)
+{
+    if (!_bs_mpmc_ring_try_pop(ring_ptr, element_ptr_ptr)) return false;
+    _bs_mpmc_ring_notify(ring_ptr);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_mpmc_ring_push_wait(bs_mpmc_ring_t *ring_ptr,
+                            void *element_ptr,
+                            uint64_t usec)
+{
+    if (bs_mpmc_ring_push(ring_ptr, element_ptr)) return true;
+    return _bs_mpmc_ring_wait(ring_ptr, true, &element_ptr, usec);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_mpmc_ring_pop_wait(bs_mpmc_ring_t *ring_ptr,
+                           void **element_ptr_ptr,
+                           uint64_t usec)
+{
+    if (bs_mpmc_ring_pop(ring_ptr, element_ptr_ptr)) return true;
+    return _bs_mpmc_ring_wait(ring_ptr, false, element_ptr_ptr, usec);
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Pushes `element_ptr`, if there is space. Does not notify waiters. */
+bool _bs_mpmc_ring_try_push(bs_mpmc_ring_t *ring_ptr, void *element_ptr)
+{
+    bs_mpmc_ring_slot_t       *slot_ptr;
+
+    int64_t pos = bs_atomic_int64_get(&ring_ptr->push_pos.value);
+    while (true) {
+        slot_ptr = &ring_ptr->slots_ptr[pos & ring_ptr->mask];
+        int64_t diff = bs_atomic_int64_get(&slot_ptr->sequence) - pos;
+        if (0 == diff) {
+            // Slot is free at our position. Claim the position.
+            int64_t curr_pos = bs_atomic_int64_cas(
+                &ring_ptr->push_pos.value, pos + 1, pos);
+            if (curr_pos == pos) break;
+            pos = curr_pos;
+        } else if (0 > diff) {
+            // Slot still holds the element from one lap before: Full.
+            return false;
+        } else {
+            // Another producer claimed the position. Retry on the current.
+            pos = bs_atomic_int64_get(&ring_ptr->push_pos.value);
+        }
+    }
+
+    bs_atomic_int64_set(&slot_ptr->element, (intptr_t)element_ptr);
+    _bs_mpmc_ring_store_fence(&slot_ptr->sequence, pos + 1);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pops into `element_ptr_ptr`, if not empty. Does not notify waiters. */
+bool _bs_mpmc_ring_try_pop(bs_mpmc_ring_t *ring_ptr, void **element_ptr_ptr)
+{
+    bs_mpmc_ring_slot_t       *slot_ptr;
+
+    int64_t pos = bs_atomic_int64_get(&ring_ptr->pop_pos.value);
+    while (true) {
+        slot_ptr = &ring_ptr->slots_ptr[pos & ring_ptr->mask];
+        int64_t diff = bs_atomic_int64_get(&slot_ptr->sequence) - (pos + 1);
+        if (0 == diff) {
+            // Slot holds the element for our position. Claim the position.
+            int64_t curr_pos = bs_atomic_int64_cas(
+                &ring_ptr->pop_pos.value, pos + 1, pos);
+            if (curr_pos == pos) break;
+            pos = curr_pos;
+        } else if (0 > diff) {
+            // Slot was not written yet: Empty.
+            return false;
+        } else {
+            // Another consumer claimed the position. Retry on the current.
+            pos = bs_atomic_int64_get(&ring_ptr->pop_pos.value);
+        }
+    }
+
+    *element_ptr_ptr = (void*)(intptr_t)bs_atomic_int64_get(
+        &slot_ptr->element);
+    // Frees the slot for the producer of the next lap.
+    _bs_mpmc_ring_store_fence(&slot_ptr->sequence, pos + ring_ptr->mask + 1);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Stores `value` at `a_ptr`, as a full memory barrier: Uses an exchange,
+ * since a plain store may be re-ordered after succeeding loads. This keeps
+ * the load of @ref bs_mpmc_ring_t::waiters from passing the store.
+ */
+void _bs_mpmc_ring_store_fence(bs_atomic_int64_t *a_ptr, int64_t value)
+{
+    bs_atomic_int64_xchg(a_ptr, &value);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Wakes up all waiters, if there are any.
+ *
+ * A waiter increments @ref bs_mpmc_ring_t::waiters before re-trying, and
+ * the caller changed the ring before reading it. So either the waiter sees
+ * the change, or we see the waiter, and broadcast under the mutex.
+ */
+void _bs_mpmc_ring_notify(bs_mpmc_ring_t *ring_ptr)
+{
+    if (0 >= bs_atomic_int32_get(&ring_ptr->waiters)) return;
+    bs_mutex_lock(&ring_ptr->mutex);
+    bs_cond_broadcast(&ring_ptr->cond);
+    bs_mutex_unlock(&ring_ptr->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Re-tries a push or pop, until it succeeds or `usec` have passed. */
+bool _bs_mpmc_ring_wait(bs_mpmc_ring_t *ring_ptr,
+                        bool push,
+                        void **element_ptr_ptr,
+                        uint64_t usec)
+{
+    bool                      rv;
+
+    uint64_t deadline = bs_usec() + usec;
+    bs_mutex_lock(&ring_ptr->mutex);
+    bs_atomic_int32_add(&ring_ptr->waiters, 1);
+    while (true) {
+        if (push) {
+            rv = _bs_mpmc_ring_try_push(ring_ptr, *element_ptr_ptr);
+        } else {
+            rv = _bs_mpmc_ring_try_pop(ring_ptr, element_ptr_ptr);
+        }
+        if (rv) break;
+
+        uint64_t now = bs_usec();
+        if (now >= deadline) break;
+        bs_cond_timedwait(&ring_ptr->cond, &ring_ptr->mutex, deadline - now);
+    }
+    bs_atomic_int32_add(&ring_ptr->waiters, -1);
+    bs_mutex_unlock(&ring_ptr->mutex);
+
+    // Outside the lock, since notifying acquires it.
+    if (rv) _bs_mpmc_ring_notify(ring_ptr);
+    return rv;
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_push_pop(bs_test_t *test_ptr);
+static void test_wait(bs_test_t *test_ptr);
+static void test_threads(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_mpmc_ring_test_cases[] = {
+    { 1, "push_pop", test_push_pop },
+    { 1, "wait", test_wait },
+    { 1, "threads", test_threads },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Verifies FIFO order, capacity, and wrapping around. */
+void test_push_pop(bs_test_t *test_ptr)
+{
+    void                      *element_ptr;
+
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_mpmc_ring_create(0));
+    bs_mpmc_ring_t *ring_ptr = bs_mpmc_ring_create(3);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, ring_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 4, bs_mpmc_ring_capacity(ring_ptr));
+
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_mpmc_ring_pop(ring_ptr, &element_ptr));
+    for (intptr_t lap = 0; lap < 3; ++lap) {
+        for (intptr_t i = 0; i < 4; ++i) {
+            BS_TEST_VERIFY_TRUE(
+                test_ptr, bs_mpmc_ring_push(ring_ptr, (void*)(lap * 4 + i)));
+        }
+        BS_TEST_VERIFY_FALSE(test_ptr, bs_mpmc_ring_push(ring_ptr, NULL));
+        for (intptr_t i = 0; i < 4; ++i) {
+            BS_TEST_VERIFY_TRUE(
+                test_ptr, bs_mpmc_ring_pop(ring_ptr, &element_ptr));
+            BS_TEST_VERIFY_EQ(test_ptr, (void*)(lap * 4 + i), element_ptr);
+        }
+        BS_TEST_VERIFY_FALSE(
+            test_ptr, bs_mpmc_ring_pop(ring_ptr, &element_ptr));
+    }
+    bs_mpmc_ring_destroy(ring_ptr);
+}
+
+/** Argument for @ref _test_wait_thread. */
+typedef struct {
+    /** The ring. */
+    bs_mpmc_ring_t            *ring_ptr;
+    /** Element to push, after a delay. */
+    void                      *element_ptr;
+} test_wait_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Pushes an element after a delay. */
+static void *_test_wait_thread(void *arg_ptr)
+{
+    test_wait_arg_t *targ_ptr = arg_ptr;
+    uint64_t usec = bs_usec();
+    while (usec + 10000 > bs_usec()) sched_yield();
+    bs_mpmc_ring_push(targ_ptr->ring_ptr, targ_ptr->element_ptr);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies timeouts, and that a blocked pop gets woken up. */
+void test_wait(bs_test_t *test_ptr)
+{
+    void                      *element_ptr;
+    pthread_t                 thread;
+
+    bs_mpmc_ring_t *ring_ptr = bs_mpmc_ring_create(1);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, ring_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 2, bs_mpmc_ring_capacity(ring_ptr));
+
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_mpmc_ring_pop_wait(ring_ptr, &element_ptr, 1000));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_mpmc_ring_push_wait(ring_ptr, ring_ptr, 1000));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_mpmc_ring_push_wait(ring_ptr, NULL, 1000));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_mpmc_ring_push_wait(ring_ptr, NULL, 1000));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_mpmc_ring_pop_wait(ring_ptr, &element_ptr, 1000));
+    BS_TEST_VERIFY_EQ(test_ptr, ring_ptr, element_ptr);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_mpmc_ring_pop_wait(ring_ptr, &element_ptr, 1000));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, element_ptr);
+
+    test_wait_arg_t targ = { .ring_ptr = ring_ptr, .element_ptr = &targ };
+    BS_TEST_VERIFY_EQ_OR_RETURN(
+        test_ptr, 0,
+        pthread_create(&thread, NULL, _test_wait_thread, &targ));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_mpmc_ring_pop_wait(ring_ptr, &element_ptr, 10000000));
+    BS_TEST_VERIFY_EQ(test_ptr, &targ, element_ptr);
+    pthread_join(thread, NULL);
+
+    bs_mpmc_ring_destroy(ring_ptr);
+}
+
+/** Number of elements each producer pushes in @ref test_threads. */
+#define _TEST_THREAD_ELEMENTS 20000
+/** Number of producers, and of consumers, in @ref test_threads. */
+#define _TEST_THREADS 4
+
+/** Argument for @ref _test_producer and @ref _test_consumer. */
+typedef struct {
+    /** The ring. */
+    bs_mpmc_ring_t            *ring_ptr;
+    /** Index of the producer. */
+    intptr_t                  producer;
+    /** Number of elements popped, over all consumers. */
+    bs_atomic_int32_t         *popped_ptr;
+    /** Consumer: Sum of the popped elements. */
+    int64_t                   sum;
+    /** Number of failed verifications. */
+    int                       failures;
+} test_thread_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Pushes elements, encoding the producer and a sequence number. */
+static void *_test_producer(void *arg_ptr)
+{
+    test_thread_arg_t *targ_ptr = arg_ptr;
+    for (intptr_t i = 1; i <= _TEST_THREAD_ELEMENTS; ++i) {
+        void *element_ptr = (void*)(targ_ptr->producer << 20 | i);
+        if (!bs_mpmc_ring_push_wait(targ_ptr->ring_ptr, element_ptr,
+                                    10000000)) {
+            targ_ptr->failures++;
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Pops elements, verifying each producer's are in order. */
+static void *_test_consumer(void *arg_ptr)
+{
+    test_thread_arg_t *targ_ptr = arg_ptr;
+    intptr_t last[_TEST_THREADS] = {};
+    void *element_ptr;
+
+    while (bs_atomic_int32_get(targ_ptr->popped_ptr) <
+           _TEST_THREADS * _TEST_THREAD_ELEMENTS) {
+        if (!bs_mpmc_ring_pop_wait(targ_ptr->ring_ptr, &element_ptr, 1000)) {
+            continue;
+        }
+        bs_atomic_int32_add(targ_ptr->popped_ptr, 1);
+        intptr_t producer = (intptr_t)element_ptr >> 20;
+        intptr_t i = (intptr_t)element_ptr & ((1 << 20) - 1);
+        if (0 > producer || _TEST_THREADS <= producer ||
+            last[producer] >= i) {
+            targ_ptr->failures++;
+            continue;
+        }
+        last[producer] = i;
+        targ_ptr->sum += i;
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pushes and pops from multiple threads, through a small ring. */
+void test_threads(bs_test_t *test_ptr)
+{
+    test_thread_arg_t         targs[2 * _TEST_THREADS];
+    pthread_t                 threads[2 * _TEST_THREADS];
+    bs_atomic_int32_t         popped = BS_ATOMIC_INT32_INIT(0);
+
+    bs_mpmc_ring_t *ring_ptr = bs_mpmc_ring_create(16);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, ring_ptr);
+
+    memset(targs, 0, sizeof(targs));
+    for (int t = 0; t < 2 * _TEST_THREADS; ++t) {
+        targs[t].ring_ptr = ring_ptr;
+        targs[t].producer = t;
+        targs[t].popped_ptr = &popped;
+        BS_TEST_VERIFY_EQ(
+            test_ptr, 0,
+            pthread_create(&threads[t], NULL,
+                           t < _TEST_THREADS ? _test_producer : _test_consumer,
+                           &targs[t]));
+    }
+    int64_t sum = 0;
+    for (int t = 0; t < 2 * _TEST_THREADS; ++t) {
+        pthread_join(threads[t], NULL);
+        BS_TEST_VERIFY_EQ(test_ptr, 0, targs[t].failures);
+        sum += targs[t].sum;
+    }
+
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS * _TEST_THREAD_ELEMENTS,
+                      bs_atomic_int32_get(&popped));
+    BS_TEST_VERIFY_EQ(
+        test_ptr,
+        (int64_t)_TEST_THREADS * _TEST_THREAD_ELEMENTS *
+        (_TEST_THREAD_ELEMENTS + 1) / 2,
+        sum);
+    bs_mpmc_ring_destroy(ring_ptr);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_contention_mutex_dequeue(bs_test_t *test_ptr);
+static void benchmark_contention_mpmc_ring(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t bs_mpmc_ring_benchmarks[] = {
+    { 1, "benchmark-contention-mutex_dequeue",
+      benchmark_contention_mutex_dequeue },
+    { 1, "benchmark-contention-mpmc_ring", benchmark_contention_mpmc_ring },
+    { 0, NULL, NULL }
+};
+
+/** Number of elements circulating through the queue, in the benchmark. */
+#define _BENCHMARK_ELEMENTS 256
+/** Maximum number of threads in the benchmark. */
+#define _BENCHMARK_MAX_THREADS 8
+
+/** A queue made of a `bs_dequeue_t` and a mutex, as baseline. */
+typedef struct {
+    /** The queue. */
+    bs_dequeue_t              dequeue;
+    /** Protects `dequeue`. */
+    pthread_mutex_t           mutex;
+} benchmark_mutex_dequeue_t;
+
+/** Argument for the benchmark threads. */
+typedef struct {
+    /** The queue to pop from and push to. */
+    void                      *queue_ptr;
+    /** Set to non-zero to terminate. */
+    bs_atomic_int32_t         *stop_ptr;
+    /** Number of pop & push pairs. */
+    uint64_t                  operations;
+} benchmark_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Pops and pushes back, from the mutex-protected dequeue. */
+static void *_benchmark_mutex_dequeue_thread(void *arg_ptr)
+{
+    benchmark_arg_t *barg_ptr = arg_ptr;
+    benchmark_mutex_dequeue_t *q_ptr = barg_ptr->queue_ptr;
+    while (0 == bs_atomic_int32_get(barg_ptr->stop_ptr)) {
+        for (int i = 0; i < 100; ++i) {
+            bs_mutex_lock(&q_ptr->mutex);
+            bs_dequeue_node_t *node_ptr = bs_dequeue_pop(&q_ptr->dequeue);
+            bs_mutex_unlock(&q_ptr->mutex);
+            if (NULL == node_ptr) continue;
+            bs_mutex_lock(&q_ptr->mutex);
+            bs_dequeue_push_back(&q_ptr->dequeue, node_ptr);
+            bs_mutex_unlock(&q_ptr->mutex);
+            barg_ptr->operations++;
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Pops and pushes back, from the ring. */
+static void *_benchmark_mpmc_ring_thread(void *arg_ptr)
+{
+    benchmark_arg_t *barg_ptr = arg_ptr;
+    void *element_ptr;
+    while (0 == bs_atomic_int32_get(barg_ptr->stop_ptr)) {
+        for (int i = 0; i < 100; ++i) {
+            if (!bs_mpmc_ring_pop(barg_ptr->queue_ptr, &element_ptr)) {
+                continue;
+            }
+            bs_mpmc_ring_push(barg_ptr->queue_ptr, element_ptr);
+            barg_ptr->operations++;
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs `thread_func` on 1, 2, 4 and 8 threads, each for a quarter of the
+ * benchmark duration, and reports the throughput for each thread count.
+ */
+static void _benchmark_contention(bs_test_t *test_ptr,
+                                  void *(*thread_func)(void *),
+                                  void *queue_ptr)
+{
+    benchmark_arg_t           bargs[_BENCHMARK_MAX_THREADS];
+    pthread_t                 threads[_BENCHMARK_MAX_THREADS];
+    double                    rates[4];
+
+    for (int run = 0; run < 4; ++run) {
+        int num_threads = 1 << run;
+        bs_atomic_int32_t stop = BS_ATOMIC_INT32_INIT(0);
+        for (int t = 0; t < num_threads; ++t) {
+            bargs[t] = (benchmark_arg_t){
+                .queue_ptr = queue_ptr, .stop_ptr = &stop };
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, 0,
+                pthread_create(&threads[t], NULL, thread_func, &bargs[t]));
+        }
+        uint64_t usec = bs_usec();
+        while (usec + benchmark_duration / 4 >= bs_usec()) {
+            usleep(10000);
+        }
+        bs_atomic_int32_set(&stop, 1);
+        uint64_t operations = 0;
+        for (int t = 0; t < num_threads; ++t) {
+            pthread_join(threads[t], NULL);
+            operations += bargs[t].operations;
+        }
+        usec = bs_usec() - usec;
+        rates[run] = (double)operations / (usec * 1e-6);
+    }
+
+    bs_test_succeed(test_ptr, "%.3e, %.3e, %.3e, %.3e pop+push/sec at "
+                    "1, 2, 4, 8 threads", rates[0], rates[1], rates[2],
+                    rates[3]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks a `bs_dequeue_t` guarded by a mutex. */
+void benchmark_contention_mutex_dequeue(bs_test_t *test_ptr)
+{
+    static bs_dequeue_node_t  nodes[_BENCHMARK_ELEMENTS];
+    benchmark_mutex_dequeue_t q = {};
+
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, bs_mutex_init(&q.mutex));
+    for (int i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+        bs_dequeue_push_back(&q.dequeue, &nodes[i]);
+    }
+    _benchmark_contention(test_ptr, _benchmark_mutex_dequeue_thread, &q);
+    bs_mutex_destroy(&q.mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks the lock-free ring. */
+void benchmark_contention_mpmc_ring(bs_test_t *test_ptr)
+{
+    bs_mpmc_ring_t *ring_ptr = bs_mpmc_ring_create(4 * _BENCHMARK_ELEMENTS);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, ring_ptr);
+    for (intptr_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+        bs_mpmc_ring_push(ring_ptr, (void*)i);
+    }
+    _benchmark_contention(test_ptr, _benchmark_mpmc_ring_thread, ring_ptr);
+    bs_mpmc_ring_destroy(ring_ptr);
+}
+
+/* == End of mpmc_ring.c =================================================== */
@@ -0,0 +1,123 @@
+/* ========================================================================= */
+/**
+ * @file mpmc_ring.h
+ * A bounded, lock-free multi-producer multi-consumer queue of pointers.
+ *
+ * Each slot carries a sequence counter, telling whether it is ready to be
+ * written or read for a given position. Producers and consumers then only
+ * contend on a compare-and-swap of their position. See Dmitry Vyukov's
+ * "Bounded MPMC queue" for the algorithm.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_MPMC_RING_H__
+#define __LIBBASE_MPMC_RING_H__
+
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Forward declaration: The ring. */
+typedef struct _bs_mpmc_ring_t bs_mpmc_ring_t;
+
+/**
+ * Creates a ring.
+ *
+ * @param capacity            Number of elements the ring can hold. Will be
+ *                            rounded up to the next power of two, and to
+ *                            at least 2.
+ *
+ * @return A pointer to the ring, or NULL on error. Must be destroyed by
+ *     calling @ref bs_mpmc_ring_destroy.
+ */
+bs_mpmc_ring_t *bs_mpmc_ring_create(size_t capacity);
+
+/**
+ * Destroys the ring. Elements still in the ring are not touched.
+ *
+ * No other thread may use the ring concurrently, or afterwards.
+ *
+ * @param ring_ptr
+ */
+void bs_mpmc_ring_destroy(bs_mpmc_ring_t *ring_ptr);
+
+/** Returns the capacity of the ring. */
+size_t bs_mpmc_ring_capacity(bs_mpmc_ring_t *ring_ptr);
+
+/**
+ * Pushes `element_ptr` to the back of the ring. Thread-safe, lock-free.
+ *
+ * @param ring_ptr
+ * @param element_ptr         May be NULL.
+ *
+ * @return true on success, or false if the ring is full.
+ */
+bool bs_mpmc_ring_push(bs_mpmc_ring_t *ring_ptr, void *element_ptr);
+
+/**
+ * Pops the element at the front of the ring. Thread-safe, lock-free.
+ *
+ * @param ring_ptr
+ * @param element_ptr_ptr     Set to the element, if one was popped.
+ *
+ * @return true on success, or false if the ring is empty.
+ */
+bool bs_mpmc_ring_pop(bs_mpmc_ring_t *ring_ptr, void **element_ptr_ptr);
+
+/**
+ * Pushes `element_ptr`, and waits for space if the ring is full.
+ *
+ * @param ring_ptr
+ * @param element_ptr
+ * @param usec                Maximum time to wait, in microseconds.
+ *
+ * @return true on success, or false if the ring was still full at timeout.
+ */
+bool bs_mpmc_ring_push_wait(bs_mpmc_ring_t *ring_ptr,
+                            void *element_ptr,
+                            uint64_t usec);
+
+/**
+ * Pops an element, and waits for one if the ring is empty.
+ *
+ * @param ring_ptr
+ * @param element_ptr_ptr
+ * @param usec                Maximum time to wait, in microseconds.
+ *
+ * @return true on success, or false if the ring was still empty at timeout.
+ */
+bool bs_mpmc_ring_pop_wait(bs_mpmc_ring_t *ring_ptr,
+                           void **element_ptr_ptr,
+                           uint64_t usec);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_mpmc_ring_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_mpmc_ring_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_MPMC_RING_H__ */
+/* == End of mpmc_ring.h =================================================== */
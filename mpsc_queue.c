@@ -0,0 +1,501 @@
+/* ========================================================================= */
+/**
+ * @file mpsc_queue.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mpsc_queue.h"
+
+#include "def.h"
+#include "dequeue.h"
+#include "log_wrappers.h"
+#include "thread.h"
+#include "time.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* == Declarations ========================================================= */
+
+/** Assumed size of a cache line. */
+#define _BS_MPSC_QUEUE_CACHELINE 64
+
+/** @private State of the queue. */
+struct _bs_mpsc_queue_t {
+    /** Most recently pushed node, as an intptr_t. Shared by producers. */
+    bs_atomic_int64_t         head;
+    /** Padding: Keeps the producers' `head` off the consumer's line. */
+    uint8_t                   padding[
+        _BS_MPSC_QUEUE_CACHELINE - sizeof(bs_atomic_int64_t)];
+
+    /** Oldest node. Only accessed by the consumer. */
+    bs_mpsc_queue_node_t      *tail_ptr;
+    /** Placeholder, so the queue never runs out of nodes entirely. */
+    bs_mpsc_queue_node_t      stub;
+
+    /** Non-zero while the consumer is blocked in a wait. */
+    bs_atomic_int32_t         waiters;
+    /** Protects the wait on `cond`. */
+    pthread_mutex_t           mutex;
+    /** Broadcasted on push, whenever there are `waiters`. */
+    pthread_cond_t            cond;
+};
+
+static void _bs_mpsc_queue_link(bs_mpsc_queue_t *queue_ptr,
+                                bs_mpsc_queue_node_t *node_ptr);
+static bs_mpsc_queue_node_t *_bs_mpsc_queue_node_next(
+    bs_mpsc_queue_node_t *node_ptr);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_mpsc_queue_t *bs_mpsc_queue_create(void)
+{
+    bs_mpsc_queue_t *queue_ptr = logged_calloc(1, sizeof(bs_mpsc_queue_t));
+    if (NULL == queue_ptr) return NULL;
+    bs_atomic_int64_set(&queue_ptr->head, (intptr_t)&queue_ptr->stub);
+    queue_ptr->tail_ptr = &queue_ptr->stub;
+
+    if (!bs_mutex_init(&queue_ptr->mutex)) {
+        logged_free(queue_ptr);
+        return NULL;
+    }
+    if (!bs_cond_init(&queue_ptr->cond)) {
+        bs_mutex_destroy(&queue_ptr->mutex);
+        logged_free(queue_ptr);
+        return NULL;
+    }
+    return queue_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_mpsc_queue_destroy(bs_mpsc_queue_t *queue_ptr)
+{
+    bs_cond_destroy(&queue_ptr->cond);
+    bs_mutex_destroy(&queue_ptr->mutex);
+    logged_free(queue_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_mpsc_queue_push(bs_mpsc_queue_t *queue_ptr,
+                        bs_mpsc_queue_node_t *node_ptr)
+{
+    _bs_mpsc_queue_link(queue_ptr, node_ptr);
+
+    // The consumer increments `waiters` before re-trying the pop, and we
+    // linked the node before reading it. So either the consumer sees the
+    // node, or we see the consumer waiting, and broadcast under the mutex.
+    if (0 >= bs_atomic_int32_get(&queue_ptr->waiters)) return;
+    bs_mutex_lock(&queue_ptr->mutex);
+    bs_cond_broadcast(&queue_ptr->cond);
+    bs_mutex_unlock(&queue_ptr->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+bs_mpsc_queue_node_t *bs_mpsc_queue_pop(bs_mpsc_queue_t *queue_ptr)
+{
+    bs_mpsc_queue_node_t *tail_ptr = queue_ptr->tail_ptr;
+    bs_mpsc_queue_node_t *next_ptr = _bs_mpsc_queue_node_next(tail_ptr);
+
+    // Skip over the stub, if it's at the front.
+    if (tail_ptr == &queue_ptr->stub) {
+        if (NULL == next_ptr) return NULL;
+        queue_ptr->tail_ptr = next_ptr;
+        tail_ptr = next_ptr;
+        next_ptr = _bs_mpsc_queue_node_next(next_ptr);
+    }
+
+    if (NULL != next_ptr) {
+        queue_ptr->tail_ptr = next_ptr;
+        return tail_ptr;
+    }
+
+    // `tail_ptr` is the last linked node. If it's not the head, a producer
+    // is in the middle of pushing after it: Try again later.
+    intptr_t head = bs_atomic_int64_get(&queue_ptr->head);
+    if ((intptr_t)tail_ptr != head) return NULL;
+
+    // `tail_ptr` is the only node. Push the stub, so it can be taken.
+    _bs_mpsc_queue_link(queue_ptr, &queue_ptr->stub);
+    next_ptr = _bs_mpsc_queue_node_next(tail_ptr);
+    if (NULL != next_ptr) {
+        queue_ptr->tail_ptr = next_ptr;
+        return tail_ptr;
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+bs_mpsc_queue_node_t *bs_mpsc_queue_pop_wait(bs_mpsc_queue_t *queue_ptr,
+                                             uint64_t usec)
+{
+    bs_mpsc_queue_node_t *node_ptr = bs_mpsc_queue_pop(queue_ptr);
+    if (NULL != node_ptr) return node_ptr;
+
+    uint64_t deadline = bs_usec() + usec;
+    bs_mutex_lock(&queue_ptr->mutex);
+    bs_atomic_int32_add(&queue_ptr->waiters, 1);
+    while (NULL == (node_ptr = bs_mpsc_queue_pop(queue_ptr))) {
+        uint64_t now = bs_usec();
+        if (now >= deadline) break;
+        bs_cond_timedwait(&queue_ptr->cond, &queue_ptr->mutex,
+                          deadline - now);
+    }
+    bs_atomic_int32_add(&queue_ptr->waiters, -1);
+    bs_mutex_unlock(&queue_ptr->mutex);
+    return node_ptr;
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Links `node_ptr` as the new head. Both steps are exchanges, and thus full
+ * memory barriers: A succeeding read of @ref bs_mpsc_queue_t::waiters
+ * cannot pass them.
+ */
+void _bs_mpsc_queue_link(bs_mpsc_queue_t *queue_ptr,
+                         bs_mpsc_queue_node_t *node_ptr)
+{
+    bs_atomic_int64_set(&node_ptr->next, 0);
+    int64_t prev = (intptr_t)node_ptr;
+    bs_atomic_int64_xchg(&queue_ptr->head, &prev);
+
+    // Until here, the consumer cannot reach `node_ptr`.
+    bs_mpsc_queue_node_t *prev_node_ptr = (bs_mpsc_queue_node_t*)(
+        intptr_t)prev;
+    int64_t next = (intptr_t)node_ptr;
+    bs_atomic_int64_xchg(&prev_node_ptr->next, &next);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the node following `node_ptr`, or NULL. */
+bs_mpsc_queue_node_t *_bs_mpsc_queue_node_next(
+    bs_mpsc_queue_node_t *node_ptr)
+{
+    return (bs_mpsc_queue_node_t*)(intptr_t)bs_atomic_int64_get(
+        &node_ptr->next);
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_push_pop(bs_test_t *test_ptr);
+static void test_threads(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_mpsc_queue_test_cases[] = {
+    { 1, "push_pop", test_push_pop },
+    { 1, "threads", test_threads },
+    { 0, NULL, NULL }
+};
+
+/** A node with a value, for the tests. */
+typedef struct {
+    /** The queue's node. */
+    bs_mpsc_queue_node_t      qnode;
+    /** Producer that pushed this node. */
+    int                       producer;
+    /** Sequence number of the node. */
+    int                       seq;
+} test_node_t;
+
+/* ------------------------------------------------------------------------- */
+/** Verifies FIFO order, including re-pushing popped nodes. */
+void test_push_pop(bs_test_t *test_ptr)
+{
+    test_node_t               nodes[3];
+    bs_mpsc_queue_node_t      *qnode_ptr;
+
+    bs_mpsc_queue_t *queue_ptr = bs_mpsc_queue_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, queue_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_mpsc_queue_pop(queue_ptr));
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 3; ++i) {
+            nodes[i].seq = i;
+            bs_mpsc_queue_push(queue_ptr, &nodes[i].qnode);
+        }
+        for (int i = 0; i < 3; ++i) {
+            qnode_ptr = bs_mpsc_queue_pop(queue_ptr);
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, &nodes[i].qnode, qnode_ptr);
+        }
+        BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_mpsc_queue_pop(queue_ptr));
+    }
+
+    // Interleaved: The queue runs to a single node repeatedly.
+    bs_mpsc_queue_push(queue_ptr, &nodes[0].qnode);
+    BS_TEST_VERIFY_EQ(test_ptr, &nodes[0].qnode, bs_mpsc_queue_pop(queue_ptr));
+    bs_mpsc_queue_push(queue_ptr, &nodes[1].qnode);
+    bs_mpsc_queue_push(queue_ptr, &nodes[0].qnode);
+    BS_TEST_VERIFY_EQ(test_ptr, &nodes[1].qnode, bs_mpsc_queue_pop(queue_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, &nodes[0].qnode, bs_mpsc_queue_pop(queue_ptr));
+
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_mpsc_queue_pop_wait(queue_ptr, 1000));
+    bs_mpsc_queue_destroy(queue_ptr);
+}
+
+/** Number of nodes each producer pushes in @ref test_threads. */
+#define _TEST_THREAD_NODES 20000
+/** Number of producers in @ref test_threads. */
+#define _TEST_THREADS 4
+
+/** Argument for @ref _test_producer. */
+typedef struct {
+    /** The queue. */
+    bs_mpsc_queue_t           *queue_ptr;
+    /** The nodes to push. */
+    test_node_t               *nodes_ptr;
+} test_producer_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Pushes all nodes. */
+static void *_test_producer(void *arg_ptr)
+{
+    test_producer_arg_t *targ_ptr = arg_ptr;
+    for (int i = 0; i < _TEST_THREAD_NODES; ++i) {
+        bs_mpsc_queue_push(targ_ptr->queue_ptr, &targ_ptr->nodes_ptr[i].qnode);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pushes from multiple producers, and verifies each's nodes are in order. */
+void test_threads(bs_test_t *test_ptr)
+{
+    test_producer_arg_t       targs[_TEST_THREADS];
+    pthread_t                 threads[_TEST_THREADS];
+    int                       last[_TEST_THREADS];
+
+    bs_mpsc_queue_t *queue_ptr = bs_mpsc_queue_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, queue_ptr);
+    test_node_t *nodes_ptr = logged_calloc(
+        _TEST_THREADS * _TEST_THREAD_NODES, sizeof(test_node_t));
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, nodes_ptr);
+
+    for (int t = 0; t < _TEST_THREADS; ++t) {
+        targs[t].queue_ptr = queue_ptr;
+        targs[t].nodes_ptr = nodes_ptr + t * _TEST_THREAD_NODES;
+        for (int i = 0; i < _TEST_THREAD_NODES; ++i) {
+            targs[t].nodes_ptr[i].producer = t;
+            targs[t].nodes_ptr[i].seq = i;
+        }
+        last[t] = -1;
+        BS_TEST_VERIFY_EQ(
+            test_ptr, 0,
+            pthread_create(&threads[t], NULL, _test_producer, &targs[t]));
+    }
+
+    int popped = 0;
+    for (; popped < _TEST_THREADS * _TEST_THREAD_NODES; ++popped) {
+        bs_mpsc_queue_node_t *qnode_ptr = bs_mpsc_queue_pop_wait(
+            queue_ptr, 10000000);
+        if (NULL == qnode_ptr) break;
+        test_node_t *node_ptr = BS_CONTAINER_OF(qnode_ptr, test_node_t, qnode);
+        if (last[node_ptr->producer] + 1 != node_ptr->seq) {
+            BS_TEST_FAIL(test_ptr, "Producer %d: Got %d after %d",
+                         node_ptr->producer, node_ptr->seq,
+                         last[node_ptr->producer]);
+            break;
+        }
+        last[node_ptr->producer] = node_ptr->seq;
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, _TEST_THREADS * _TEST_THREAD_NODES, popped);
+
+    for (int t = 0; t < _TEST_THREADS; ++t) pthread_join(threads[t], NULL);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_mpsc_queue_pop(queue_ptr));
+    logged_free(nodes_ptr);
+    bs_mpsc_queue_destroy(queue_ptr);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_producers_mutex_dequeue(bs_test_t *test_ptr);
+static void benchmark_producers_mpsc_queue(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_mpsc_queue_benchmarks[] = {
+    { 1, "benchmark-producers-mutex_dequeue",
+      benchmark_producers_mutex_dequeue },
+    { 1, "benchmark-producers-mpsc_queue", benchmark_producers_mpsc_queue },
+    { 0, NULL, NULL }
+};
+
+/** Number of nodes passed through the queue, per run. */
+#define _BENCHMARK_NODES (1 << 21)
+/** Maximum number of producers. */
+#define _BENCHMARK_MAX_PRODUCERS 8
+
+/** Node for the benchmark: Fits either queue. */
+typedef union {
+    /** For @ref bs_mpsc_queue_t. */
+    bs_mpsc_queue_node_t      qnode;
+    /** For the mutex-guarded @ref bs_dequeue_t. */
+    bs_dequeue_node_t         dqnode;
+} benchmark_node_t;
+
+/** A queue made of a `bs_dequeue_t` and a mutex, as baseline. */
+typedef struct {
+    /** The queue. */
+    bs_dequeue_t              dequeue;
+    /** Protects `dequeue`. */
+    pthread_mutex_t           mutex;
+} benchmark_mutex_dequeue_t;
+
+/** Operations for a benchmarked queue. */
+typedef struct {
+    /** Pushes the node. Thread-safe. */
+    void (*push)(void *queue_ptr, benchmark_node_t *node_ptr);
+    /** Pops a node, or returns NULL. */
+    benchmark_node_t *(*pop)(void *queue_ptr);
+} benchmark_queue_ops_t;
+
+/** Argument for @ref _benchmark_producer. */
+typedef struct {
+    /** Operations of the queue. */
+    const benchmark_queue_ops_t *ops_ptr;
+    /** The queue. */
+    void                      *queue_ptr;
+    /** Nodes to push. */
+    benchmark_node_t          *nodes_ptr;
+    /** Number of nodes at `nodes_ptr`. */
+    size_t                    nodes;
+} benchmark_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Pushes into the mutex-guarded dequeue. */
+static void _benchmark_mutex_dequeue_push(void *queue_ptr,
+                                          benchmark_node_t *node_ptr)
+{
+    benchmark_mutex_dequeue_t *q_ptr = queue_ptr;
+    bs_mutex_lock(&q_ptr->mutex);
+    bs_dequeue_push_back(&q_ptr->dequeue, &node_ptr->dqnode);
+    bs_mutex_unlock(&q_ptr->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pops from the mutex-guarded dequeue. */
+static benchmark_node_t *_benchmark_mutex_dequeue_pop(void *queue_ptr)
+{
+    benchmark_mutex_dequeue_t *q_ptr = queue_ptr;
+    bs_mutex_lock(&q_ptr->mutex);
+    bs_dequeue_node_t *dqnode_ptr = bs_dequeue_pop(&q_ptr->dequeue);
+    bs_mutex_unlock(&q_ptr->mutex);
+    if (NULL == dqnode_ptr) return NULL;
+    return BS_CONTAINER_OF(dqnode_ptr, benchmark_node_t, dqnode);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pushes into the MPSC queue. */
+static void _benchmark_mpsc_queue_push(void *queue_ptr,
+                                       benchmark_node_t *node_ptr)
+{
+    bs_mpsc_queue_push(queue_ptr, &node_ptr->qnode);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pops from the MPSC queue. */
+static benchmark_node_t *_benchmark_mpsc_queue_pop(void *queue_ptr)
+{
+    bs_mpsc_queue_node_t *qnode_ptr = bs_mpsc_queue_pop(queue_ptr);
+    if (NULL == qnode_ptr) return NULL;
+    return BS_CONTAINER_OF(qnode_ptr, benchmark_node_t, qnode);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Pushes all nodes. */
+static void *_benchmark_producer(void *arg_ptr)
+{
+    benchmark_arg_t *barg_ptr = arg_ptr;
+    for (size_t i = 0; i < barg_ptr->nodes; ++i) {
+        barg_ptr->ops_ptr->push(barg_ptr->queue_ptr, &barg_ptr->nodes_ptr[i]);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Passes @ref _BENCHMARK_NODES through the queue, from 1, 2, 4 and 8
+ * producers to a single consumer. Reports the throughput for each.
+ */
+static void _benchmark_producers(bs_test_t *test_ptr,
+                                 const benchmark_queue_ops_t *ops_ptr,
+                                 void *queue_ptr)
+{
+    benchmark_arg_t           bargs[_BENCHMARK_MAX_PRODUCERS];
+    pthread_t                 threads[_BENCHMARK_MAX_PRODUCERS];
+    double                    rates[4];
+
+    benchmark_node_t *nodes_ptr = logged_calloc(
+        _BENCHMARK_NODES, sizeof(benchmark_node_t));
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, nodes_ptr);
+
+    for (int run = 0; run < 4; ++run) {
+        int producers = 1 << run;
+        uint64_t usec = bs_usec();
+        for (int t = 0; t < producers; ++t) {
+            bargs[t] = (benchmark_arg_t){
+                .ops_ptr = ops_ptr,
+                .queue_ptr = queue_ptr,
+                .nodes_ptr = nodes_ptr + t * (_BENCHMARK_NODES / producers),
+                .nodes = _BENCHMARK_NODES / producers };
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, 0,
+                pthread_create(&threads[t], NULL, _benchmark_producer,
+                               &bargs[t]));
+        }
+        for (size_t popped = 0; popped < _BENCHMARK_NODES;) {
+            if (NULL != ops_ptr->pop(queue_ptr)) ++popped;
+        }
+        for (int t = 0; t < producers; ++t) pthread_join(threads[t], NULL);
+        usec = bs_usec() - usec;
+        rates[run] = (double)_BENCHMARK_NODES / (usec * 1e-6);
+    }
+    logged_free(nodes_ptr);
+
+    bs_test_succeed(test_ptr, "%.3e, %.3e, %.3e, %.3e push+pop/sec at "
+                    "1, 2, 4, 8 producers", rates[0], rates[1], rates[2],
+                    rates[3]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks a `bs_dequeue_t` guarded by a mutex. */
+void benchmark_producers_mutex_dequeue(bs_test_t *test_ptr)
+{
+    static const benchmark_queue_ops_t ops = {
+        .push = _benchmark_mutex_dequeue_push,
+        .pop = _benchmark_mutex_dequeue_pop };
+    benchmark_mutex_dequeue_t q = {};
+
+    BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, bs_mutex_init(&q.mutex));
+    _benchmark_producers(test_ptr, &ops, &q);
+    bs_mutex_destroy(&q.mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks the lock-free MPSC queue. */
+void benchmark_producers_mpsc_queue(bs_test_t *test_ptr)
+{
+    static const benchmark_queue_ops_t ops = {
+        .push = _benchmark_mpsc_queue_push,
+        .pop = _benchmark_mpsc_queue_pop };
+
+    bs_mpsc_queue_t *queue_ptr = bs_mpsc_queue_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, queue_ptr);
+    _benchmark_producers(test_ptr, &ops, queue_ptr);
+    bs_mpsc_queue_destroy(queue_ptr);
+}
+
+/* == End of mpsc_queue.c ================================================== */
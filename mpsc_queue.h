@@ -0,0 +1,112 @@
+/* ========================================================================= */
+/**
+ * @file mpsc_queue.h
+ * An unbounded, intrusive multi-producer single-consumer queue.
+ *
+ * Like @ref bs_dequeue_t, nodes are embedded in the caller's structs, and
+ * the queue never allocates. Pushes are wait-free and may come from any
+ * thread. Pops must all come from the same single consumer at a time. See
+ * Dmitry Vyukov's "Intrusive MPSC node-based queue" for the algorithm.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_MPSC_QUEUE_H__
+#define __LIBBASE_MPSC_QUEUE_H__
+
+#include "atomic.h"
+#include "test.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+
+// The nodes hold atomics, which are only defined for C. See atomic.h.
+
+#else  // defined(__cplusplus)
+
+/** Forward declaration: The queue. */
+typedef struct _bs_mpsc_queue_t bs_mpsc_queue_t;
+/** A node in the queue. */
+typedef struct _bs_mpsc_queue_node_t bs_mpsc_queue_node_t;
+
+/** Details of the node. */
+struct _bs_mpsc_queue_node_t {
+    /** Next node, as an intptr_t. */
+    bs_atomic_int64_t         next;
+};
+
+/**
+ * Creates a queue.
+ *
+ * @return A pointer to the queue, or NULL on error. Must be destroyed by
+ *     calling @ref bs_mpsc_queue_destroy.
+ */
+bs_mpsc_queue_t *bs_mpsc_queue_create(void);
+
+/**
+ * Destroys the queue. Nodes still in the queue are not touched.
+ *
+ * No other thread may use the queue concurrently, or afterwards.
+ *
+ * @param queue_ptr
+ */
+void bs_mpsc_queue_destroy(bs_mpsc_queue_t *queue_ptr);
+
+/**
+ * Pushes `node_ptr` to the back of the queue. Thread-safe, wait-free.
+ *
+ * @param queue_ptr
+ * @param node_ptr            Must not be in any queue.
+ */
+void bs_mpsc_queue_push(bs_mpsc_queue_t *queue_ptr,
+                        bs_mpsc_queue_node_t *node_ptr);
+
+/**
+ * Pops the node at the front of the queue. For the consumer only.
+ *
+ * May return NULL while a producer is in the middle of a push, even though
+ * an earlier push completed. The node then becomes available once that push
+ * completes. @ref bs_mpsc_queue_pop_wait accounts for that.
+ *
+ * @param queue_ptr
+ *
+ * @return The node, or NULL if the queue is empty.
+ */
+bs_mpsc_queue_node_t *bs_mpsc_queue_pop(bs_mpsc_queue_t *queue_ptr);
+
+/**
+ * Pops the node at the front, and waits for one if the queue is empty. For
+ * the consumer only.
+ *
+ * @param queue_ptr
+ * @param usec                Maximum time to wait, in microseconds.
+ *
+ * @return The node, or NULL if the queue was still empty at timeout.
+ */
+bs_mpsc_queue_node_t *bs_mpsc_queue_pop_wait(bs_mpsc_queue_t *queue_ptr,
+                                             uint64_t usec);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_mpsc_queue_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_mpsc_queue_benchmarks[];
+
+#endif  // defined(__cplusplus)
+
+#endif /* __LIBBASE_MPSC_QUEUE_H__ */
+/* == End of mpsc_queue.h ================================================== */
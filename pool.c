@@ -0,0 +1,688 @@
+/* ========================================================================= */
+/**
+ * @file pool.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pool.h"
+
+#include "assert.h"
+#include "avltree.h"
+#include "def.h"
+#include "dllist.h"
+#include "log_wrappers.h"
+#include "thread.h"
+#include "time.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* == Declarations ========================================================= */
+
+/** Maximum number of free objects kept in a thread's cache. */
+#define _BS_POOL_CACHE_MAX    64
+/** Minimum number of objects per slab. Slabs grow beyond a page for these. */
+#define _BS_POOL_MIN_OBJECTS_PER_SLAB 8
+/** Fill pattern for freed objects, when poisoning. */
+#define _BS_POOL_POISON_FREE  0xdb
+/** Fill pattern for allocated objects, when poisoning. */
+#define _BS_POOL_POISON_ALLOC 0xa5
+
+/** A free object. The link is stored in the object's memory. */
+typedef struct _bs_pool_object_t bs_pool_object_t;
+/** Actual struct of the free object. */
+struct _bs_pool_object_t {
+    /** Next free object, or NULL if this is the last. */
+    bs_pool_object_t          *next_ptr;
+};
+
+/** Header of a slab. The objects follow at `objects_offset`. */
+typedef struct _bs_pool_slab_t bs_pool_slab_t;
+/** Actual struct of the slab header. */
+struct _bs_pool_slab_t {
+    /** Next slab of the pool, or NULL if this is the last. */
+    bs_pool_slab_t            *next_ptr;
+};
+
+/** A thread's cache of free objects. Only accessed by the owning thread. */
+typedef struct {
+    /** Element of @ref bs_pool_t::caches. */
+    bs_dllist_node_t          dlnode;
+    /** Back-link to the pool. */
+    bs_pool_t                 *pool_ptr;
+    /** The free objects. */
+    bs_pool_object_t          *free_ptr;
+    /** Number of objects at `free_ptr`. */
+    size_t                    free;
+} bs_pool_cache_t;
+
+/** @private State of the pool. */
+struct _bs_pool_t {
+    /** Size of each object, rounded up for alignment. */
+    size_t                    object_size;
+    /** Size of each slab. A multiple of `page_size`. */
+    size_t                    slab_size;
+    /** Page size, and alignment of each slab. */
+    size_t                    page_size;
+    /** Offset of the first object in the slab. */
+    size_t                    objects_offset;
+    /** Number of objects in each slab. */
+    size_t                    objects_per_slab;
+    /** Whether to poison freed objects. */
+    bool                      poison;
+    /** Key for the calling thread's @ref bs_pool_cache_t. */
+    pthread_key_t             key;
+
+    /** Protects all elements below. */
+    pthread_mutex_t           mutex;
+    /** Shared free list: Objects not held in any thread's cache. */
+    bs_pool_object_t          *free_ptr;
+    /** Number of objects at `free_ptr`. */
+    size_t                    free;
+    /** All slabs. */
+    bs_pool_slab_t            *slabs_ptr;
+    /** Number of slabs. */
+    size_t                    slabs;
+    /** All threads' caches. */
+    bs_dllist_t               caches;
+};
+
+static bs_pool_cache_t *_bs_pool_cache(bs_pool_t *pool_ptr);
+static void _bs_pool_cache_thread_exit(void *cache_ptr);
+static bool _bs_pool_refill(bs_pool_t *pool_ptr, bs_pool_cache_t *cache_ptr);
+static void _bs_pool_flush(bs_pool_t *pool_ptr,
+                           bs_pool_cache_t *cache_ptr,
+                           size_t num);
+static bool _bs_pool_add_slab(bs_pool_t *pool_ptr);
+static void _bs_pool_verify_poison(bs_pool_t *pool_ptr,
+                                   bs_pool_object_t *object_ptr);
+static void _bs_pool_free_object(bs_pool_t *pool_ptr,
+                                 bs_pool_object_t *object_ptr);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_pool_t *bs_pool_create(size_t object_size, bool poison)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (0 >= page_size) page_size = 4096;
+    const size_t alignment = alignof(max_align_t);
+    if (object_size > (SIZE_MAX - page_size) / _BS_POOL_MIN_OBJECTS_PER_SLAB -
+        alignment) {
+        bs_log(BS_ERROR, "Object size %zu too large.", object_size);
+        return NULL;
+    }
+
+    bs_pool_t *pool_ptr = logged_calloc(1, sizeof(bs_pool_t));
+    if (NULL == pool_ptr) return NULL;
+    object_size = BS_MAX(object_size, sizeof(bs_pool_object_t));
+    pool_ptr->object_size = (object_size + alignment - 1) & ~(alignment - 1);
+    pool_ptr->objects_offset =
+        (sizeof(bs_pool_slab_t) + alignment - 1) & ~(alignment - 1);
+    pool_ptr->page_size = page_size;
+    pool_ptr->slab_size = pool_ptr->objects_offset +
+        _BS_POOL_MIN_OBJECTS_PER_SLAB * pool_ptr->object_size;
+    pool_ptr->slab_size = ((pool_ptr->slab_size + page_size - 1) /
+                           page_size) * page_size;
+    pool_ptr->objects_per_slab =
+        (pool_ptr->slab_size - pool_ptr->objects_offset) /
+        pool_ptr->object_size;
+    pool_ptr->poison = poison;
+
+    int rv = pthread_key_create(&pool_ptr->key, _bs_pool_cache_thread_exit);
+    if (0 != rv) {
+        errno = rv;
+        bs_log(BS_ERROR | BS_ERRNO, "Failed pthread_key_create(%p, %p)",
+               &pool_ptr->key, _bs_pool_cache_thread_exit);
+        logged_free(pool_ptr);
+        return NULL;
+    }
+    if (!bs_mutex_init(&pool_ptr->mutex)) {
+        pthread_key_delete(pool_ptr->key);
+        logged_free(pool_ptr);
+        return NULL;
+    }
+    return pool_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_pool_destroy(bs_pool_t *pool_ptr)
+{
+    pthread_setspecific(pool_ptr->key, NULL);
+    pthread_key_delete(pool_ptr->key);
+
+    size_t free_objects = pool_ptr->free;
+    bs_dllist_node_t *dlnode_ptr;
+    while (NULL != (dlnode_ptr = bs_dllist_pop_front(&pool_ptr->caches))) {
+        bs_pool_cache_t *cache_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, bs_pool_cache_t, dlnode);
+        free_objects += cache_ptr->free;
+        logged_free(cache_ptr);
+    }
+    if (free_objects != pool_ptr->slabs * pool_ptr->objects_per_slab) {
+        bs_log(BS_WARNING, "Pool %p destroyed with %zu objects allocated.",
+               pool_ptr,
+               pool_ptr->slabs * pool_ptr->objects_per_slab - free_objects);
+    }
+
+    while (NULL != pool_ptr->slabs_ptr) {
+        bs_pool_slab_t *slab_ptr = pool_ptr->slabs_ptr;
+        pool_ptr->slabs_ptr = slab_ptr->next_ptr;
+        logged_free(slab_ptr);
+    }
+    bs_mutex_destroy(&pool_ptr->mutex);
+    logged_free(pool_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void *bs_pool_alloc(bs_pool_t *pool_ptr)
+{
+    bs_pool_object_t          *object_ptr;
+
+    bs_pool_cache_t *cache_ptr = _bs_pool_cache(pool_ptr);
+    if (NULL != cache_ptr) {
+        if (NULL == cache_ptr->free_ptr &&
+            !_bs_pool_refill(pool_ptr, cache_ptr)) return NULL;
+        object_ptr = cache_ptr->free_ptr;
+        cache_ptr->free_ptr = object_ptr->next_ptr;
+        cache_ptr->free--;
+    } else {
+        // No cache for this thread. Allocate from the shared free list.
+        bs_mutex_lock(&pool_ptr->mutex);
+        if (NULL == pool_ptr->free_ptr) _bs_pool_add_slab(pool_ptr);
+        object_ptr = pool_ptr->free_ptr;
+        if (NULL != object_ptr) {
+            pool_ptr->free_ptr = object_ptr->next_ptr;
+            pool_ptr->free--;
+        }
+        bs_mutex_unlock(&pool_ptr->mutex);
+        if (NULL == object_ptr) return NULL;
+    }
+
+    if (pool_ptr->poison) {
+        _bs_pool_verify_poison(pool_ptr, object_ptr);
+        memset(object_ptr, _BS_POOL_POISON_ALLOC, pool_ptr->object_size);
+    }
+    return object_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_pool_free(bs_pool_t *pool_ptr, void *object_ptr)
+{
+    if (pool_ptr->poison) {
+        memset(object_ptr, _BS_POOL_POISON_FREE, pool_ptr->object_size);
+    }
+
+    bs_pool_cache_t *cache_ptr = _bs_pool_cache(pool_ptr);
+    if (NULL == cache_ptr) {
+        bs_mutex_lock(&pool_ptr->mutex);
+        _bs_pool_free_object(pool_ptr, object_ptr);
+        bs_mutex_unlock(&pool_ptr->mutex);
+        return;
+    }
+
+    ((bs_pool_object_t*)object_ptr)->next_ptr = cache_ptr->free_ptr;
+    cache_ptr->free_ptr = object_ptr;
+    cache_ptr->free++;
+    if (_BS_POOL_CACHE_MAX <= cache_ptr->free) {
+        bs_mutex_lock(&pool_ptr->mutex);
+        _bs_pool_flush(pool_ptr, cache_ptr, _BS_POOL_CACHE_MAX / 2);
+        bs_mutex_unlock(&pool_ptr->mutex);
+    }
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns the calling thread's cache, and creates it if needed.
+ *
+ * @param pool_ptr
+ *
+ * @return A pointer to the cache, or NULL on error.
+ */
+bs_pool_cache_t *_bs_pool_cache(bs_pool_t *pool_ptr)
+{
+    bs_pool_cache_t *cache_ptr = pthread_getspecific(pool_ptr->key);
+    if (NULL != cache_ptr) return cache_ptr;
+
+    cache_ptr = logged_calloc(1, sizeof(bs_pool_cache_t));
+    if (NULL == cache_ptr) return NULL;
+    cache_ptr->pool_ptr = pool_ptr;
+    if (0 != pthread_setspecific(pool_ptr->key, cache_ptr)) {
+        logged_free(cache_ptr);
+        return NULL;
+    }
+
+    bs_mutex_lock(&pool_ptr->mutex);
+    bs_dllist_push_back(&pool_ptr->caches, &cache_ptr->dlnode);
+    bs_mutex_unlock(&pool_ptr->mutex);
+    return cache_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Destructor for the thread's cache: Returns all objects to the pool. */
+void _bs_pool_cache_thread_exit(void *cache_ptr)
+{
+    bs_pool_cache_t *pool_cache_ptr = cache_ptr;
+    bs_pool_t *pool_ptr = pool_cache_ptr->pool_ptr;
+
+    bs_mutex_lock(&pool_ptr->mutex);
+    _bs_pool_flush(pool_ptr, pool_cache_ptr, pool_cache_ptr->free);
+    bs_dllist_remove(&pool_ptr->caches, &pool_cache_ptr->dlnode);
+    bs_mutex_unlock(&pool_ptr->mutex);
+    logged_free(pool_cache_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Moves up to half a cache's worth of objects from the shared free list into
+ * the thread's cache. Adds a slab, if the shared free list is empty.
+ *
+ * @return Whether the cache holds any object.
+ */
+bool _bs_pool_refill(bs_pool_t *pool_ptr, bs_pool_cache_t *cache_ptr)
+{
+    bs_mutex_lock(&pool_ptr->mutex);
+    while (cache_ptr->free < _BS_POOL_CACHE_MAX / 2) {
+        if (NULL == pool_ptr->free_ptr && !_bs_pool_add_slab(pool_ptr)) break;
+
+        bs_pool_object_t *object_ptr = pool_ptr->free_ptr;
+        pool_ptr->free_ptr = object_ptr->next_ptr;
+        pool_ptr->free--;
+        object_ptr->next_ptr = cache_ptr->free_ptr;
+        cache_ptr->free_ptr = object_ptr;
+        cache_ptr->free++;
+    }
+    bs_mutex_unlock(&pool_ptr->mutex);
+    return NULL != cache_ptr->free_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Moves `num` objects from the cache to the shared free list. Locked. */
+void _bs_pool_flush(bs_pool_t *pool_ptr,
+                    bs_pool_cache_t *cache_ptr,
+                    size_t num)
+{
+    for (; 0 < num && NULL != cache_ptr->free_ptr; --num) {
+        bs_pool_object_t *object_ptr = cache_ptr->free_ptr;
+        cache_ptr->free_ptr = object_ptr->next_ptr;
+        cache_ptr->free--;
+        _bs_pool_free_object(pool_ptr, object_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Allocates a slab, and adds its objects to the shared free list. Locked. */
+bool _bs_pool_add_slab(bs_pool_t *pool_ptr)
+{
+    void                      *slab_ptr;
+
+    int rv = posix_memalign(&slab_ptr, pool_ptr->page_size,
+                            pool_ptr->slab_size);
+    if (0 != rv) {
+        errno = rv;
+        bs_log(BS_ERROR | BS_ERRNO, "Failed posix_memalign(%p, %zu, %zu)",
+               &slab_ptr, pool_ptr->page_size, pool_ptr->slab_size);
+        return false;
+    }
+    ((bs_pool_slab_t*)slab_ptr)->next_ptr = pool_ptr->slabs_ptr;
+    pool_ptr->slabs_ptr = slab_ptr;
+    pool_ptr->slabs++;
+
+    // Adds in reverse, so that objects are handed out in ascending order.
+    uint8_t *objects_ptr = (uint8_t*)slab_ptr + pool_ptr->objects_offset;
+    for (size_t i = pool_ptr->objects_per_slab; i > 0; --i) {
+        bs_pool_object_t *object_ptr = (bs_pool_object_t*)(
+            objects_ptr + (i - 1) * pool_ptr->object_size);
+        if (pool_ptr->poison) {
+            memset(object_ptr, _BS_POOL_POISON_FREE, pool_ptr->object_size);
+        }
+        _bs_pool_free_object(pool_ptr, object_ptr);
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies a free object was not modified, beyond it's link. */
+void _bs_pool_verify_poison(bs_pool_t *pool_ptr,
+                            bs_pool_object_t *object_ptr)
+{
+    const uint8_t *data_ptr = (const uint8_t*)object_ptr;
+    for (size_t i = sizeof(bs_pool_object_t); i < pool_ptr->object_size; ++i) {
+        if (_BS_POOL_POISON_FREE != data_ptr[i]) {
+            bs_log(BS_FATAL, "Pool %p object %p modified at offset %zu after "
+                   "free: 0x%02x", pool_ptr, object_ptr, i, data_ptr[i]);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Puts the object into the shared free list. Must be locked. */
+void _bs_pool_free_object(bs_pool_t *pool_ptr, bs_pool_object_t *object_ptr)
+{
+    object_ptr->next_ptr = pool_ptr->free_ptr;
+    pool_ptr->free_ptr = object_ptr;
+    pool_ptr->free++;
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_alloc_free(bs_test_t *test_ptr);
+static void test_poison(bs_test_t *test_ptr);
+static void test_threads(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_pool_test_cases[] = {
+    { 1, "alloc_free", test_alloc_free },
+    { 1, "poison", test_poison },
+    { 1, "threads", test_threads },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Allocates across multiple slabs, and verifies objects get re-used. */
+void test_alloc_free(bs_test_t *test_ptr)
+{
+    size_t                    *objects[1000];
+
+    bs_pool_t *pool_ptr = bs_pool_create(3 * sizeof(size_t), false);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, pool_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0,
+                      pool_ptr->object_size % alignof(max_align_t));
+
+    for (size_t i = 0; i < 1000; ++i) {
+        objects[i] = bs_pool_alloc(pool_ptr);
+        BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, objects[i]);
+        BS_TEST_VERIFY_EQ(test_ptr, 0,
+                          (uintptr_t)objects[i] % alignof(max_align_t));
+        objects[i][0] = i;
+        objects[i][2] = ~i;
+    }
+    for (size_t i = 0; i < 1000; ++i) {
+        BS_TEST_VERIFY_EQ(test_ptr, i, objects[i][0]);
+        BS_TEST_VERIFY_EQ(test_ptr, ~i, objects[i][2]);
+    }
+    size_t slabs = pool_ptr->slabs;
+    BS_TEST_VERIFY_TRUE(test_ptr, 1 < slabs);
+
+    for (size_t i = 0; i < 1000; ++i) bs_pool_free(pool_ptr, objects[i]);
+    for (size_t i = 0; i < 1000; ++i) objects[i] = bs_pool_alloc(pool_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, slabs, pool_ptr->slabs);
+    for (size_t i = 0; i < 1000; ++i) bs_pool_free(pool_ptr, objects[i]);
+
+    bs_pool_destroy(pool_ptr);
+
+    // Objects larger than a page.
+    pool_ptr = bs_pool_create(10000, false);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, pool_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, _BS_POOL_MIN_OBJECTS_PER_SLAB,
+                      pool_ptr->objects_per_slab);
+    void *object_ptr = bs_pool_alloc(pool_ptr);
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, object_ptr);
+    memset(object_ptr, 0, 10000);
+    bs_pool_free(pool_ptr, object_ptr);
+    bs_pool_destroy(pool_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the poison patterns on allocated and freed objects. */
+void test_poison(bs_test_t *test_ptr)
+{
+    bs_pool_t *pool_ptr = bs_pool_create(40, true);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, pool_ptr);
+
+    uint8_t *data_ptr = bs_pool_alloc(pool_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, data_ptr);
+    for (size_t i = 0; i < 40; ++i) {
+        BS_TEST_VERIFY_EQ(test_ptr, _BS_POOL_POISON_ALLOC, data_ptr[i]);
+    }
+    memset(data_ptr, 0, 40);
+
+    bs_pool_free(pool_ptr, data_ptr);
+    for (size_t i = sizeof(bs_pool_object_t); i < 40; ++i) {
+        BS_TEST_VERIFY_EQ(test_ptr, _BS_POOL_POISON_FREE, data_ptr[i]);
+    }
+
+    // Free lists are LIFO: We're getting the same object, still intact.
+    BS_TEST_VERIFY_EQ(test_ptr, data_ptr, bs_pool_alloc(pool_ptr));
+    bs_pool_free(pool_ptr, data_ptr);
+    bs_pool_destroy(pool_ptr);
+}
+
+/** Number of objects each thread allocates, per round. */
+#define _TEST_THREAD_OBJECTS 200
+
+/** Argument for @ref _test_thread. */
+typedef struct {
+    /** The pool. */
+    bs_pool_t                 *pool_ptr;
+    /** Objects allocated by another thread, for this thread to free. */
+    uintptr_t                 *foreign_objects[_TEST_THREAD_OBJECTS];
+    /** Number of failed verifications. */
+    int                       failures;
+} test_thread_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Frees the foreign objects, then churns through allocations. */
+static void *_test_thread(void *arg_ptr)
+{
+    test_thread_arg_t *targ_ptr = arg_ptr;
+    uintptr_t *objects[_TEST_THREAD_OBJECTS];
+
+    for (int i = 0; i < _TEST_THREAD_OBJECTS; ++i) {
+        bs_pool_free(targ_ptr->pool_ptr, targ_ptr->foreign_objects[i]);
+    }
+
+    for (int round = 0; round < 100; ++round) {
+        for (int i = 0; i < _TEST_THREAD_OBJECTS; ++i) {
+            objects[i] = bs_pool_alloc(targ_ptr->pool_ptr);
+            if (NULL == objects[i]) return NULL;
+            objects[i][0] = (uintptr_t)objects[i];
+        }
+        for (int i = _TEST_THREAD_OBJECTS - 1; i >= 0; --i) {
+            if (objects[i][0] != (uintptr_t)objects[i]) targ_ptr->failures++;
+            bs_pool_free(targ_ptr->pool_ptr, objects[i]);
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Churns from multiple threads, including cross-thread frees. */
+void test_threads(bs_test_t *test_ptr)
+{
+    test_thread_arg_t         targs[4];
+    pthread_t                 threads[4];
+
+    bs_pool_t *pool_ptr = bs_pool_create(sizeof(uintptr_t), false);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, pool_ptr);
+
+    for (int t = 0; t < 4; ++t) {
+        targs[t].pool_ptr = pool_ptr;
+        targs[t].failures = 0;
+        for (int i = 0; i < _TEST_THREAD_OBJECTS; ++i) {
+            targs[t].foreign_objects[i] = bs_pool_alloc(pool_ptr);
+            BS_TEST_VERIFY_NEQ_OR_RETURN(
+                test_ptr, NULL, targs[t].foreign_objects[i]);
+        }
+    }
+    for (int t = 0; t < 4; ++t) {
+        BS_TEST_VERIFY_EQ(
+            test_ptr, 0,
+            pthread_create(&threads[t], NULL, _test_thread, &targs[t]));
+    }
+    for (int t = 0; t < 4; ++t) {
+        pthread_join(threads[t], NULL);
+        BS_TEST_VERIFY_EQ(test_ptr, 0, targs[t].failures);
+    }
+
+    // Exited threads returned their cached objects. Only ours remains.
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_dllist_size(&pool_ptr->caches));
+    bs_pool_cache_t *cache_ptr = BS_CONTAINER_OF(
+        pool_ptr->caches.head_ptr, bs_pool_cache_t, dlnode);
+    BS_TEST_VERIFY_EQ(test_ptr,
+                      pool_ptr->slabs * pool_ptr->objects_per_slab,
+                      pool_ptr->free + cache_ptr->free);
+    bs_pool_destroy(pool_ptr);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_churn_malloc(bs_test_t *test_ptr);
+static void benchmark_churn_pool(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t bs_pool_benchmarks[] = {
+    { 1, "benchmark-avltree-churn-malloc", benchmark_churn_malloc },
+    { 1, "benchmark-avltree-churn-pool", benchmark_churn_pool },
+    { 0, NULL, NULL }
+};
+
+/** Node for the churn benchmark. */
+typedef struct {
+    /** Tree node. */
+    bs_avltree_node_t         avlnode;
+    /** Key. */
+    uint32_t                  key;
+} benchmark_node_t;
+
+/** Allocators for the churn benchmark. */
+typedef struct {
+    /** Allocates a node. */
+    void *(*alloc)(void *ud_ptr);
+    /** Frees the node. */
+    void (*free)(void *ud_ptr, void *node_ptr);
+} benchmark_allocator_t;
+
+/* ------------------------------------------------------------------------- */
+/** Comparator for @ref benchmark_node_t. */
+static int _benchmark_node_cmp(const bs_avltree_node_t *node_ptr,
+                               const void *key_ptr)
+{
+    const benchmark_node_t *bnode_ptr = BS_CONTAINER_OF(
+        node_ptr, const benchmark_node_t, avlnode);
+    uint32_t key = bnode_ptr->key, other_key = *(const uint32_t*)key_ptr;
+    return (key > other_key) - (key < other_key);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Allocates with malloc(3). */
+static void *_benchmark_malloc(__UNUSED__ void *ud_ptr)
+{
+    return malloc(sizeof(benchmark_node_t));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Frees with free(3). */
+static void _benchmark_free(__UNUSED__ void *ud_ptr, void *node_ptr)
+{
+    logged_free(node_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Allocates from the pool at `ud_ptr`. */
+static void *_benchmark_pool_alloc(void *ud_ptr)
+{
+    return bs_pool_alloc(ud_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Frees into the pool at `ud_ptr`. */
+static void _benchmark_pool_free(void *ud_ptr, void *node_ptr)
+{
+    bs_pool_free(ud_ptr, node_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Churns a tree of ~4096 nodes: Each step erases the node at a pseudo-random
+ * key, or inserts one if absent.
+ */
+static void _benchmark_churn(bs_test_t *test_ptr,
+                             const benchmark_allocator_t *allocator_ptr,
+                             void *ud_ptr)
+{
+    bs_avltree_t *tree_ptr = bs_avltree_create(_benchmark_node_cmp, NULL);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, tree_ptr);
+
+    uint64_t iterations = 0;
+    uint32_t state = 1;
+    uint64_t usec = bs_usec();
+    while (usec + benchmark_duration >= bs_usec()) {
+        for (int i = 0; i < 1000; ++i) {
+            state = state * 1664525 + 1013904223;
+            uint32_t key = state >> 19;
+            bs_avltree_node_t *avlnode_ptr = bs_avltree_delete(tree_ptr,
+                                                               &key);
+            if (NULL != avlnode_ptr) {
+                allocator_ptr->free(ud_ptr, BS_CONTAINER_OF(
+                                        avlnode_ptr, benchmark_node_t,
+                                        avlnode));
+                continue;
+            }
+            benchmark_node_t *node_ptr = allocator_ptr->alloc(ud_ptr);
+            if (NULL == node_ptr) break;
+            memset(&node_ptr->avlnode, 0, sizeof(node_ptr->avlnode));
+            node_ptr->key = key;
+            bs_avltree_insert(tree_ptr, &node_ptr->key, &node_ptr->avlnode,
+                              false);
+        }
+        iterations += 1000;
+    }
+    usec = bs_usec() - usec;
+
+    bs_avltree_node_t *avlnode_ptr;
+    while (NULL != (avlnode_ptr = bs_avltree_min(tree_ptr))) {
+        benchmark_node_t *node_ptr = BS_CONTAINER_OF(
+            avlnode_ptr, benchmark_node_t, avlnode);
+        bs_avltree_delete(tree_ptr, &node_ptr->key);
+        allocator_ptr->free(ud_ptr, node_ptr);
+    }
+    bs_avltree_destroy(tree_ptr);
+
+    bs_test_succeed(test_ptr, "%.3e insert or erase/sec",
+                    (double)iterations / (usec * 1e-6));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks churn with nodes from malloc(3). */
+void benchmark_churn_malloc(bs_test_t *test_ptr)
+{
+    static const benchmark_allocator_t allocator = {
+        .alloc = _benchmark_malloc, .free = _benchmark_free };
+    _benchmark_churn(test_ptr, &allocator, NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks churn with nodes from a @ref bs_pool_t. */
+void benchmark_churn_pool(bs_test_t *test_ptr)
+{
+    static const benchmark_allocator_t allocator = {
+        .alloc = _benchmark_pool_alloc, .free = _benchmark_pool_free };
+    bs_pool_t *pool_ptr = bs_pool_create(sizeof(benchmark_node_t), false);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, pool_ptr);
+    _benchmark_churn(test_ptr, &allocator, pool_ptr);
+    bs_pool_destroy(pool_ptr);
+}
+
+/* == End of pool.c ======================================================== */
@@ -0,0 +1,94 @@
+/* ========================================================================= */
+/**
+ * @file pool.h
+ * A pool allocator for fixed-size objects, such as nodes of the intrusive
+ * containers. Objects are carved from page-sized slabs, and recycled through
+ * per-thread free lists.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_POOL_H__
+#define __LIBBASE_POOL_H__
+
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Forward declaration: The pool. */
+typedef struct _bs_pool_t bs_pool_t;
+
+/**
+ * Creates a pool.
+ *
+ * @param object_size         Size of each object. Objects are aligned as for
+ *                            malloc(3).
+ * @param poison              Whether to poison freed objects, and to verify
+ *                            they were not modified when re-allocating. For
+ *                            debugging: A modification is FATAL. Allocated
+ *                            objects are then filled with a pattern, too.
+ *
+ * @return A pointer to the pool, or NULL on error. Must be destroyed by
+ *     calling @ref bs_pool_destroy.
+ */
+bs_pool_t *bs_pool_create(size_t object_size, bool poison);
+
+/**
+ * Destroys the pool, and releases all slabs.
+ *
+ * Objects still allocated become invalid, and will be reported as a warning.
+ * No other thread may use the pool concurrently, or afterwards.
+ *
+ * @param pool_ptr
+ */
+void bs_pool_destroy(bs_pool_t *pool_ptr);
+
+/**
+ * Allocates an object from the pool. Thread-safe.
+ *
+ * @param pool_ptr
+ *
+ * @return A pointer to the object, or NULL on error. The contents are not
+ *     initialized. Must be released by @ref bs_pool_free.
+ */
+void *bs_pool_alloc(bs_pool_t *pool_ptr);
+
+/**
+ * Returns an object to the pool. Thread-safe. It may be freed by another
+ * thread than the one that allocated it.
+ *
+ * @param pool_ptr
+ * @param object_ptr          As obtained from @ref bs_pool_alloc on the same
+ *                            pool. Must not be NULL.
+ */
+void bs_pool_free(bs_pool_t *pool_ptr, void *object_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_pool_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_pool_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_POOL_H__ */
+/* == End of pool.h ======================================================== */
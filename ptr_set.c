@@ -25,131 +25,261 @@
 #include "avltree.h"
 #include "def.h"
 #include "log_wrappers.h"
+#include "time.h"
+
+#include <stdint.h>
+#include <string.h>
 
 /* == Declarations ========================================================= */
 
-/** A set. */
+/**
+ * A set. Robin Hood hashing with linear probing: Each slot holds the element
+ * and its probe distance. Elements are not allocated individually.
+ */
 struct _bs_ptr_set_t {
-    /** Maps to the tree holding the set elements. */
-    bs_avltree_t              *tree_ptr;
+    /** The slots' elements. */
+    void                      **elems_ptr;
+    /** Probe distance of each slot's element, plus 1. 0 for empty slots. */
+    uint32_t                  *dists_ptr;
+    /** Number of slots, minus 1. The number of slots is a power of 2. */
+    size_t                    mask;
+    /** Hash bits to shift away, for mapping to a slot. */
+    unsigned                  shift;
+    /** Number of occupied slots. */
+    size_t                    size;
+    /** All slots before this index are empty. Speeds up the `any` method. */
+    size_t                    any_hint;
+    /** Whether the set contains NULL. It's not stored in the slots. */
+    bool                      contains_null;
 };
 
-/** Holder for one element. */
-typedef struct {
-    /** The tree node. */
-    bs_avltree_node_t         avlnode;
-    /** Element pointer. */
-    void                      *elem_ptr;
-} bs_ptr_set_elem_holder_t;
+/** Initial number of slots. */
+static const size_t           _bs_ptr_set_initial_slots = 16;
 
-static int elem_compare(
-    const bs_avltree_node_t *node_ptr,
-    const void *key_ptr);
+static size_t _bs_ptr_set_slot(const bs_ptr_set_t *set_ptr, void *elem_ptr);
+static bool _bs_ptr_set_find(const bs_ptr_set_t *set_ptr,
+                             void *elem_ptr,
+                             size_t *pos_ptr);
+static void _bs_ptr_set_place(bs_ptr_set_t *set_ptr, void *elem_ptr);
+static bool _bs_ptr_set_grow(bs_ptr_set_t *set_ptr);
 
 /* == Exported methods ===================================================== */
 
 /* ------------------------------------------------------------------------- */
 bs_ptr_set_t *bs_ptr_set_create(void)
 {
-    bs_ptr_set_t *set_ptr = logged_calloc(1, sizeof(bs_ptr_set_t));
-    if (NULL == set_ptr) return NULL;
-
-    set_ptr->tree_ptr = bs_avltree_create(elem_compare, NULL);
-    if (NULL == set_ptr->tree_ptr) {
-        bs_ptr_set_destroy(set_ptr);
-        return NULL;
-    }
-
-    return set_ptr;
+    return logged_calloc(1, sizeof(bs_ptr_set_t));
 }
 
 /* ------------------------------------------------------------------------- */
 void bs_ptr_set_destroy(bs_ptr_set_t *set_ptr)
 {
-    if (NULL != set_ptr->tree_ptr) {
-        bs_avltree_destroy(set_ptr->tree_ptr);
-        set_ptr->tree_ptr = NULL;
+    if (NULL != set_ptr->elems_ptr) {
+        logged_free(set_ptr->elems_ptr);
+        set_ptr->elems_ptr = NULL;
+    }
+    if (NULL != set_ptr->dists_ptr) {
+        logged_free(set_ptr->dists_ptr);
+        set_ptr->dists_ptr = NULL;
     }
 
-    free(set_ptr);
+    logged_free(set_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
 bool bs_ptr_set_insert(bs_ptr_set_t *set_ptr, void *elem_ptr)
 {
-    bs_ptr_set_elem_holder_t *holder_ptr = logged_calloc(
-        1, sizeof(bs_ptr_set_elem_holder_t));
-    if (NULL == holder_ptr) return false;
+    if (NULL == elem_ptr) {
+        if (set_ptr->contains_null) return false;
+        set_ptr->contains_null = true;
+        return true;
+    }
+
+    size_t pos;
+    if (_bs_ptr_set_find(set_ptr, elem_ptr, &pos)) return false;
 
-    holder_ptr->elem_ptr = elem_ptr;
-    bool rv = bs_avltree_insert(
-        set_ptr->tree_ptr,
-        holder_ptr->elem_ptr,
-        &holder_ptr->avlnode,
-        false);
-    if (!rv) free(holder_ptr);
-    return rv;
+    // Grows beyond a load of 7/8.
+    if (NULL == set_ptr->elems_ptr ||
+        (set_ptr->size + 1) * 8 > (set_ptr->mask + 1) * 7) {
+        if (!_bs_ptr_set_grow(set_ptr)) return false;
+    }
+    _bs_ptr_set_place(set_ptr, elem_ptr);
+    set_ptr->size++;
+    set_ptr->any_hint = 0;
+    return true;
 }
 
 /* ------------------------------------------------------------------------- */
 void bs_ptr_set_erase(bs_ptr_set_t *set_ptr, void *elem_ptr)
 {
-    bs_avltree_node_t *node_ptr = bs_avltree_delete(
-        set_ptr->tree_ptr, elem_ptr);
-    if (NULL != node_ptr) {
-        bs_ptr_set_elem_holder_t *holder_ptr = BS_CONTAINER_OF(
-            node_ptr,  bs_ptr_set_elem_holder_t, avlnode);
-        free(holder_ptr);
+    if (NULL == elem_ptr) {
+        set_ptr->contains_null = false;
+        return;
     }
+
+    size_t pos;
+    if (!_bs_ptr_set_find(set_ptr, elem_ptr, &pos)) return;
+
+    // Backward-shift deletion: Moves the following displaced elements one
+    // slot closer to their home. No tombstones needed.
+    size_t next_pos = (pos + 1) & set_ptr->mask;
+    while (1 < set_ptr->dists_ptr[next_pos]) {
+        set_ptr->elems_ptr[pos] = set_ptr->elems_ptr[next_pos];
+        set_ptr->dists_ptr[pos] = set_ptr->dists_ptr[next_pos] - 1;
+        pos = next_pos;
+        next_pos = (pos + 1) & set_ptr->mask;
+    }
+    set_ptr->elems_ptr[pos] = NULL;
+    set_ptr->dists_ptr[pos] = 0;
+    set_ptr->size--;
 }
 
 /* ------------------------------------------------------------------------- */
 bool bs_ptr_set_contains(bs_ptr_set_t *set_ptr, void *elem_ptr)
 {
-    return NULL != bs_avltree_lookup(set_ptr->tree_ptr, elem_ptr);
+    if (NULL == elem_ptr) return set_ptr->contains_null;
+    size_t pos;
+    return _bs_ptr_set_find(set_ptr, elem_ptr, &pos);
 }
 
 /* ------------------------------------------------------------------------- */
 void *bs_ptr_set_any(bs_ptr_set_t *set_ptr)
 {
-    bs_avltree_node_t *avlnode_ptr = bs_avltree_min(set_ptr->tree_ptr);
-    if (NULL == avlnode_ptr) return NULL;
-
-    bs_ptr_set_elem_holder_t *holder_ptr = BS_CONTAINER_OF(
-        avlnode_ptr, bs_ptr_set_elem_holder_t, avlnode);
-    return holder_ptr->elem_ptr;
+    if (0 == set_ptr->size) return NULL;
+
+    // Erasing never moves elements before an occupied slot, hence all slots
+    // before `any_hint` remain empty until the next insert.
+    size_t pos = set_ptr->any_hint;
+    while (0 == set_ptr->dists_ptr[pos]) ++pos;
+    set_ptr->any_hint = pos;
+    return set_ptr->elems_ptr[pos];
 }
 
 /* ------------------------------------------------------------------------- */
 bool bs_ptr_set_empty(bs_ptr_set_t *set_ptr)
 {
-    return 0 == bs_avltree_size(set_ptr->tree_ptr);
+    return 0 == set_ptr->size && !set_ptr->contains_null;
 }
 
 /* == Local (static) methods =============================================== */
 
 /* ------------------------------------------------------------------------- */
 /**
- * Compares two element pointers.
+ * Returns the home slot of `elem_ptr`. Uses Fibonacci hashing, which spreads
+ * the aligned and often sequential pointer values well.
+ */
+size_t _bs_ptr_set_slot(const bs_ptr_set_t *set_ptr, void *elem_ptr)
+{
+    uint64_t h = (uint64_t)(uintptr_t)elem_ptr * UINT64_C(0x9e3779b97f4a7c15);
+    return h >> set_ptr->shift;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Looks up the slot holding `elem_ptr`. Stops early, once reaching a slot
+ * with an element closer to its home than `elem_ptr` would be.
  *
- * @param node_ptr
- * @param key_ptr
+ * @param set_ptr
+ * @param elem_ptr            Must not be NULL.
+ * @param pos_ptr             Output: The slot, if found.
  *
- * @return As specified by @ref bs_avltree_node_cmp_t.
+ * @return Whether `elem_ptr` was found.
  */
-int elem_compare(const bs_avltree_node_t *node_ptr, const void *key_ptr)
+bool _bs_ptr_set_find(const bs_ptr_set_t *set_ptr,
+                      void *elem_ptr,
+                      size_t *pos_ptr)
+{
+    if (0 == set_ptr->size) return false;
+
+    size_t pos = _bs_ptr_set_slot(set_ptr, elem_ptr);
+    for (uint32_t dist = 1; dist <= set_ptr->dists_ptr[pos]; ++dist) {
+        if (set_ptr->elems_ptr[pos] == elem_ptr) {
+            *pos_ptr = pos;
+            return true;
+        }
+        pos = (pos + 1) & set_ptr->mask;
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Places `elem_ptr` into the slots. Displaces elements that are closer to
+ * their home, and continues placing those. Requires a free slot.
+ */
+void _bs_ptr_set_place(bs_ptr_set_t *set_ptr, void *elem_ptr)
+{
+    size_t pos = _bs_ptr_set_slot(set_ptr, elem_ptr);
+    uint32_t dist = 1;
+    while (0 != set_ptr->dists_ptr[pos]) {
+        if (set_ptr->dists_ptr[pos] < dist) {
+            void *displaced_elem_ptr = set_ptr->elems_ptr[pos];
+            uint32_t displaced_dist = set_ptr->dists_ptr[pos];
+            set_ptr->elems_ptr[pos] = elem_ptr;
+            set_ptr->dists_ptr[pos] = dist;
+            elem_ptr = displaced_elem_ptr;
+            dist = displaced_dist;
+        }
+        pos = (pos + 1) & set_ptr->mask;
+        ++dist;
+    }
+    set_ptr->elems_ptr[pos] = elem_ptr;
+    set_ptr->dists_ptr[pos] = dist;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Doubles the number of slots, and re-places all elements. */
+bool _bs_ptr_set_grow(bs_ptr_set_t *set_ptr)
 {
-    const bs_ptr_set_elem_holder_t *holder_ptr = BS_CONTAINER_OF(
-        node_ptr, const bs_ptr_set_elem_holder_t, avlnode);
-    return (size_t)key_ptr - (size_t)holder_ptr->elem_ptr;
+    size_t old_slots = NULL != set_ptr->elems_ptr ? set_ptr->mask + 1 : 0;
+    size_t slots = 0 < old_slots ? 2 * old_slots : _bs_ptr_set_initial_slots;
+
+    void **elems_ptr = logged_calloc(slots, sizeof(void*));
+    if (NULL == elems_ptr) return false;
+    uint32_t *dists_ptr = logged_calloc(slots, sizeof(uint32_t));
+    if (NULL == dists_ptr) {
+        logged_free(elems_ptr);
+        return false;
+    }
+
+    void **old_elems_ptr = set_ptr->elems_ptr;
+    uint32_t *old_dists_ptr = set_ptr->dists_ptr;
+    set_ptr->elems_ptr = elems_ptr;
+    set_ptr->dists_ptr = dists_ptr;
+    set_ptr->mask = slots - 1;
+    set_ptr->shift = 64;
+    for (size_t s = slots; 1 < s; s >>= 1) set_ptr->shift--;
+    set_ptr->any_hint = 0;
+
+    for (size_t pos = 0; pos < old_slots; ++pos) {
+        if (0 != old_dists_ptr[pos]) {
+            _bs_ptr_set_place(set_ptr, old_elems_ptr[pos]);
+        }
+    }
+    if (NULL != old_elems_ptr) logged_free(old_elems_ptr);
+    if (NULL != old_dists_ptr) logged_free(old_dists_ptr);
+    return true;
 }
 
 /* == Test Functions ======================================================= */
 
 static void bs_ptr_set_test(bs_test_t *test_ptr);
+static void bs_ptr_set_test_many(bs_test_t *test_ptr);
 
 const bs_test_case_t          bs_ptr_set_test_cases[] = {
     { 1, "test", bs_ptr_set_test },
+    { 1, "many", bs_ptr_set_test_many },
+    { 0, NULL, NULL }
+};
+
+static void benchmark_hash(bs_test_t *test_ptr);
+static void benchmark_avltree(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t          bs_ptr_set_benchmarks[] = {
+    { 1, "benchmark-ptr_set-hash", benchmark_hash },
+    { 1, "benchmark-ptr_set-avltree", benchmark_avltree },
     { 0, NULL, NULL }
 };
 
@@ -187,4 +317,218 @@ void bs_ptr_set_test(bs_test_t *test_ptr)
     bs_ptr_set_destroy(set_ptr);
 }
 
+/* ------------------------------------------------------------------------- */
+/** Inserts, looks up and erases many elements, across several grows. */
+void bs_ptr_set_test_many(bs_test_t *test_ptr)
+{
+    bs_ptr_set_t *set_ptr = bs_ptr_set_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, set_ptr);
+    static const uintptr_t n = 5000;
+
+    for (uintptr_t i = 1; i <= n; ++i) {
+        BS_TEST_VERIFY_TRUE(test_ptr,
+                            bs_ptr_set_insert(set_ptr, (void*)(i * 8)));
+    }
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_set_insert(set_ptr, NULL));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_ptr_set_insert(set_ptr, NULL));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_ptr_set_insert(set_ptr, (void*)8));
+
+    // Erase the odd ones.
+    for (uintptr_t i = 1; i <= n; i += 2) {
+        bs_ptr_set_erase(set_ptr, (void*)(i * 8));
+    }
+    for (uintptr_t i = 1; i <= n; ++i) {
+        if (bs_ptr_set_contains(set_ptr, (void*)(i * 8)) != (0 == i % 2)) {
+            BS_TEST_FAIL(test_ptr, "Unexpected contains(%p)", (void*)(i * 8));
+            break;
+        }
+    }
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_set_contains(set_ptr, NULL));
+    bs_ptr_set_erase(set_ptr, NULL);
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_ptr_set_contains(set_ptr, NULL));
+
+    // Drain, through `any`.
+    uintptr_t drained = 0;
+    while (!bs_ptr_set_empty(set_ptr)) {
+        void *elem_ptr = bs_ptr_set_any(set_ptr);
+        BS_TEST_VERIFY_NEQ(test_ptr, NULL, elem_ptr);
+        BS_TEST_VERIFY_EQ(test_ptr, 0, (uintptr_t)elem_ptr % 16);
+        bs_ptr_set_erase(set_ptr, elem_ptr);
+        if (++drained > n) break;
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, n / 2, drained);
+
+    bs_ptr_set_destroy(set_ptr);
+}
+
+/** Number of elements in the benchmark's set. */
+#define _BENCHMARK_ELEMENTS   65536
+
+/** Operations on the set, for @ref _benchmark. */
+typedef struct {
+    void *(*create)(void);
+    void (*destroy)(void *set_ptr);
+    bool (*insert)(void *set_ptr, void *elem_ptr);
+    bool (*contains)(void *set_ptr, void *elem_ptr);
+    void (*erase)(void *set_ptr, void *elem_ptr);
+} _benchmark_ops_t;
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Inserts @ref _BENCHMARK_ELEMENTS pointers to distinct heap-like addresses,
+ * looks up each of them and as many absent ones, then erases all.
+ */
+static void _benchmark(bs_test_t *test_ptr, const _benchmark_ops_t *ops_ptr)
+{
+    static char storage[_BENCHMARK_ELEMENTS * 48];
+
+    uint64_t iterations = 0;
+    uint64_t usec = bs_usec();
+    while (usec + benchmark_duration >= bs_usec()) {
+        void *set_ptr = ops_ptr->create();
+        if (NULL == set_ptr) {
+            BS_TEST_FAIL(test_ptr, "Failed create()");
+            return;
+        }
+        size_t found = 0;
+        for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+            ops_ptr->insert(set_ptr, &storage[i * 48]);
+        }
+        for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+            found += ops_ptr->contains(set_ptr, &storage[i * 48]);
+            found += ops_ptr->contains(set_ptr, &storage[i * 48 + 16]);
+        }
+        for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+            ops_ptr->erase(set_ptr, &storage[i * 48]);
+        }
+        ops_ptr->destroy(set_ptr);
+        BS_TEST_VERIFY_EQ(test_ptr, (size_t)_BENCHMARK_ELEMENTS, found);
+        iterations++;
+    }
+    usec = bs_usec() - usec;
+
+    bs_test_succeed(test_ptr, "%d elements: %.3e ops/sec",
+                    _BENCHMARK_ELEMENTS,
+                    (double)iterations * 4 * _BENCHMARK_ELEMENTS /
+                    (usec * 1e-6));
+}
+
+/* ------------------------------------------------------------------------- */
+static void *_benchmark_hash_create(void)
+{
+    return bs_ptr_set_create();
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_hash_destroy(void *p)
+{
+    bs_ptr_set_destroy(p);
+}
+
+/* ------------------------------------------------------------------------- */
+static bool _benchmark_hash_insert(void *p, void *e)
+{
+    return bs_ptr_set_insert(p, e);
+}
+
+/* ------------------------------------------------------------------------- */
+static bool _benchmark_hash_contains(void *p, void *e)
+{
+    return bs_ptr_set_contains(p, e);
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_hash_erase(void *p, void *e)
+{
+    bs_ptr_set_erase(p, e);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_hash(bs_test_t *test_ptr)
+{
+    static const _benchmark_ops_t ops = {
+        .create = _benchmark_hash_create,
+        .destroy = _benchmark_hash_destroy,
+        .insert = _benchmark_hash_insert,
+        .contains = _benchmark_hash_contains,
+        .erase = _benchmark_hash_erase
+    };
+    _benchmark(test_ptr, &ops);
+}
+
+/** Baseline for the benchmark: A set on @ref bs_avltree_t, as before. */
+typedef struct {
+    /** The tree node. */
+    bs_avltree_node_t         avlnode;
+    /** Element pointer. */
+    void                      *elem_ptr;
+} _benchmark_avltree_holder_t;
+
+/* ------------------------------------------------------------------------- */
+static int _benchmark_avltree_cmp(const bs_avltree_node_t *node_ptr,
+                                  const void *key_ptr)
+{
+    const _benchmark_avltree_holder_t *holder_ptr = BS_CONTAINER_OF(
+        node_ptr, const _benchmark_avltree_holder_t, avlnode);
+    return bs_avltree_cmp_ptr(holder_ptr->elem_ptr, key_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_avltree_node_destroy(bs_avltree_node_t *node_ptr)
+{
+    logged_free(
+        BS_CONTAINER_OF(node_ptr, _benchmark_avltree_holder_t, avlnode));
+}
+
+/* ------------------------------------------------------------------------- */
+static void *_benchmark_avltree_create(void)
+{
+    return bs_avltree_create(_benchmark_avltree_cmp,
+                             _benchmark_avltree_node_destroy);
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_avltree_destroy(void *p)
+{
+    bs_avltree_destroy(p);
+}
+
+/* ------------------------------------------------------------------------- */
+static bool _benchmark_avltree_insert(void *p, void *e)
+{
+    _benchmark_avltree_holder_t *holder_ptr = logged_calloc(
+        1, sizeof(_benchmark_avltree_holder_t));
+    if (NULL == holder_ptr) return false;
+    holder_ptr->elem_ptr = e;
+    if (bs_avltree_insert(p, e, &holder_ptr->avlnode, false)) return true;
+    logged_free(holder_ptr);
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+static bool _benchmark_avltree_contains(void *p, void *e)
+{
+    return NULL != bs_avltree_lookup(p, e);
+}
+
+/* ------------------------------------------------------------------------- */
+static void _benchmark_avltree_erase(void *p, void *e)
+{
+    bs_avltree_node_t *node_ptr = bs_avltree_delete(p, e);
+    if (NULL != node_ptr) _benchmark_avltree_node_destroy(node_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_avltree(bs_test_t *test_ptr)
+{
+    static const _benchmark_ops_t ops = {
+        .create = _benchmark_avltree_create,
+        .destroy = _benchmark_avltree_destroy,
+        .insert = _benchmark_avltree_insert,
+        .contains = _benchmark_avltree_contains,
+        .erase = _benchmark_avltree_erase
+    };
+    _benchmark(test_ptr, &ops);
+}
+
 /* == End of ptr_set.c ===================================================== */
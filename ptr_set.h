@@ -99,6 +99,9 @@ bool bs_ptr_set_empty(bs_ptr_set_t *set_ptr);
 /** Unit tests. */
 extern const bs_test_case_t   bs_ptr_set_test_cases[];
 
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_ptr_set_benchmarks[];
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
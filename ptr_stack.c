@@ -21,7 +21,11 @@
 #include "ptr_stack.h"
 
 #include "assert.h"
+#include "def.h"
 #include "log_wrappers.h"
+#include "time.h"
+
+#include <stdint.h>
 
 /* == Declarations ========================================================= */
 
@@ -49,7 +53,7 @@ bs_ptr_stack_t *bs_ptr_stack_create(void)
 void bs_ptr_stack_destroy(bs_ptr_stack_t *ptr_stack_ptr)
 {
     bs_ptr_stack_fini(ptr_stack_ptr);
-    free(ptr_stack_ptr);
+    logged_free(ptr_stack_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -69,7 +73,7 @@ void bs_ptr_stack_fini(bs_ptr_stack_t *ptr_stack_ptr)
             bs_log(BS_WARNING, "Destroying non-empty ptr_stack at %p",
                    ptr_stack_ptr);
         }
-        free(ptr_stack_ptr->data_ptr);
+        logged_free(ptr_stack_ptr->data_ptr);
         ptr_stack_ptr->data_ptr = NULL;
     }
 
@@ -107,10 +111,15 @@ void *bs_ptr_stack_peek(bs_ptr_stack_t *ptr_stack_ptr,
 /* == Local (static) methods =============================================== */
 
 /* ------------------------------------------------------------------------- */
-/** Grows the stack by INITIAL_SIZE elements. */
+/** Grows the stack to INITIAL_SIZE elements, or doubles its size. */
 bool grow_stack(bs_ptr_stack_t *ptr_stack_ptr)
 {
-    size_t new_size = ptr_stack_ptr->size + INITIAL_SIZE;
+    size_t new_size = BS_MAX(2 * ptr_stack_ptr->size, (size_t)INITIAL_SIZE);
+    if (new_size > SIZE_MAX / sizeof(void*)) {
+        bs_log(BS_ERROR, "Size %zu of ptr_stack %p too large.",
+               new_size, ptr_stack_ptr);
+        return false;
+    }
     void *new_data_ptr = realloc(
         ptr_stack_ptr->data_ptr, new_size * sizeof(void*));
     if (NULL == new_data_ptr) {
@@ -134,6 +143,15 @@ const bs_test_case_t          bs_ptr_stack_test_cases[] = {
     { 0, NULL, NULL }  // sentinel.
 };
 
+static void benchmark_push(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t          bs_ptr_stack_benchmarks[] = {
+    { 1, "benchmark-push-1M", benchmark_push },
+    { 0, NULL, NULL }  // sentinel.
+};
+
 /* ------------------------------------------------------------------------- */
 /** Basic functionality: init, empty pop, push, pop, empty pop, fini. */
 void basic_test(bs_test_t *test_ptr)
@@ -198,4 +216,30 @@ void large_test(bs_test_t *test_ptr)
     bs_ptr_stack_fini(&ptr_stack);
 }
 
+/* ------------------------------------------------------------------------- */
+/** Benchmarks pushing and popping a million elements. */
+void benchmark_push(bs_test_t *test_ptr)
+{
+    static const size_t elements = 1024 * 1024;
+
+    uint64_t iterations = 0;
+    uint64_t usec = bs_usec();
+    while (usec + benchmark_duration >= bs_usec()) {
+        bs_ptr_stack_t ptr_stack;
+        bs_ptr_stack_init(&ptr_stack);
+        for (size_t i = 1; i <= elements; ++i) {
+            bs_ptr_stack_push(&ptr_stack, (void*)i);
+        }
+        size_t popped = 0;
+        while (NULL != bs_ptr_stack_pop(&ptr_stack)) ++popped;
+        BS_TEST_VERIFY_EQ(test_ptr, elements, popped);
+        bs_ptr_stack_fini(&ptr_stack);
+        iterations++;
+    }
+    usec = bs_usec() - usec;
+
+    bs_test_succeed(test_ptr, "%.3e elements/sec",
+                    (double)iterations * elements / (usec * 1e-6));
+}
+
 /* == End of ptr_stack.c =================================================== */
@@ -107,6 +107,9 @@ void *bs_ptr_stack_peek(bs_ptr_stack_t *ptr_stack_ptr,
 /** Unit tests. */
 extern const bs_test_case_t   bs_ptr_stack_test_cases[];
 
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_ptr_stack_benchmarks[];
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
@@ -23,14 +23,22 @@
 #include "ptr_vector.h"
 
 #include "assert.h"
+#include "def.h"
 #include "log.h"
+#include "time.h"
+
+#include <stdint.h>
+#include <string.h>
 
 /* == Declarations ========================================================= */
 
 /** Initial vector size, 1024 elements. */
 #define INITIAL_SIZE 1024
 
-static bool _bs_ptr_vector_grow(bs_ptr_vector_t *ptr_vector_ptr);
+static bool _bs_ptr_vector_grow(bs_ptr_vector_t *ptr_vector_ptr,
+                                size_t min_capacity);
+static bool _bs_ptr_vector_realloc(bs_ptr_vector_t *ptr_vector_ptr,
+                                   size_t capacity);
 
 /* == Exported methods ===================================================== */
 
@@ -40,7 +48,7 @@ bool bs_ptr_vector_init(bs_ptr_vector_t *ptr_vector_ptr)
     ptr_vector_ptr->capacity = 0;
     ptr_vector_ptr->consumed = 0;
     ptr_vector_ptr->elements_ptr = NULL;
-    _bs_ptr_vector_grow(ptr_vector_ptr);
+    _bs_ptr_vector_grow(ptr_vector_ptr, INITIAL_SIZE);
     return true;
 }
 
@@ -69,8 +77,9 @@ size_t bs_ptr_vector_size(bs_ptr_vector_t *ptr_vector_ptr)
 bool bs_ptr_vector_push_back(bs_ptr_vector_t *ptr_vector_ptr,
                              void *data_ptr)
 {
-    while (ptr_vector_ptr->consumed >= ptr_vector_ptr->capacity) {
-        if (!_bs_ptr_vector_grow(ptr_vector_ptr)) return false;
+    if (ptr_vector_ptr->consumed >= ptr_vector_ptr->capacity &&
+        !_bs_ptr_vector_grow(ptr_vector_ptr, ptr_vector_ptr->consumed + 1)) {
+        return false;
     }
     ptr_vector_ptr->elements_ptr[ptr_vector_ptr->consumed++] = data_ptr;
     return true;
@@ -91,6 +100,57 @@ bool bs_ptr_vector_erase(bs_ptr_vector_t *ptr_vector_ptr,
     return true;
 }
 
+/* ------------------------------------------------------------------------- */
+bool bs_ptr_vector_swap_erase(bs_ptr_vector_t *ptr_vector_ptr,
+                              size_t pos)
+{
+    if (pos >= ptr_vector_ptr->consumed) return false;
+
+    --ptr_vector_ptr->consumed;
+    ptr_vector_ptr->elements_ptr[pos] =
+        ptr_vector_ptr->elements_ptr[ptr_vector_ptr->consumed];
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_ptr_vector_append(bs_ptr_vector_t *ptr_vector_ptr,
+                          void *const *elements_ptr,
+                          size_t num)
+{
+    if (0 == num) return true;
+    if (num > SIZE_MAX - ptr_vector_ptr->consumed) return false;
+    if (ptr_vector_ptr->consumed + num > ptr_vector_ptr->capacity &&
+        !_bs_ptr_vector_grow(ptr_vector_ptr,
+                             ptr_vector_ptr->consumed + num)) {
+        return false;
+    }
+    memcpy(ptr_vector_ptr->elements_ptr + ptr_vector_ptr->consumed,
+           elements_ptr, num * sizeof(void*));
+    ptr_vector_ptr->consumed += num;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_ptr_vector_reserve(bs_ptr_vector_t *ptr_vector_ptr,
+                           size_t capacity)
+{
+    if (capacity <= ptr_vector_ptr->capacity) return true;
+    return _bs_ptr_vector_realloc(ptr_vector_ptr, capacity);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_ptr_vector_shrink_to_fit(bs_ptr_vector_t *ptr_vector_ptr)
+{
+    if (ptr_vector_ptr->consumed == ptr_vector_ptr->capacity) return true;
+    if (0 == ptr_vector_ptr->consumed) {
+        free(ptr_vector_ptr->elements_ptr);
+        ptr_vector_ptr->elements_ptr = NULL;
+        ptr_vector_ptr->capacity = 0;
+        return true;
+    }
+    return _bs_ptr_vector_realloc(ptr_vector_ptr, ptr_vector_ptr->consumed);
+}
+
 /* ------------------------------------------------------------------------- */
 void* bs_ptr_vector_at(bs_ptr_vector_t *ptr_vector_ptr, size_t pos)
 {
@@ -102,23 +162,54 @@ void* bs_ptr_vector_at(bs_ptr_vector_t *ptr_vector_ptr, size_t pos)
 
 /* ------------------------------------------------------------------------- */
 /**
- * Grows the vector, by INITIAL_SIZE elements.
+ * Grows the vector geometrically, doubling the capacity until it holds at
+ * least `min_capacity` elements. Starts at INITIAL_SIZE elements.
+ *
+ * @param ptr_vector_ptr
+ * @param min_capacity
+ *
+ * @return true on success.
+ */
+bool _bs_ptr_vector_grow(bs_ptr_vector_t *ptr_vector_ptr,
+                         size_t min_capacity)
+{
+    size_t capacity = BS_MAX(ptr_vector_ptr->capacity, (size_t)INITIAL_SIZE);
+    while (capacity < min_capacity) {
+        if (capacity > SIZE_MAX / 2) {
+            capacity = min_capacity;
+            break;
+        }
+        capacity *= 2;
+    }
+    return _bs_ptr_vector_realloc(ptr_vector_ptr, capacity);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Re-allocates the vector's elements to hold exactly `capacity` elements.
+ * `capacity` must be at least the vector's size, and not 0.
  *
  * @param ptr_vector_ptr
+ * @param capacity
  *
  * @return true on success.
  */
-bool _bs_ptr_vector_grow(bs_ptr_vector_t *ptr_vector_ptr)
+bool _bs_ptr_vector_realloc(bs_ptr_vector_t *ptr_vector_ptr,
+                            size_t capacity)
 {
-    size_t new_size = ptr_vector_ptr->capacity + INITIAL_SIZE;
+    if (capacity > SIZE_MAX / sizeof(void*)) {
+        bs_log(BS_ERROR, "Capacity %zu of vector %p too large.",
+               capacity, ptr_vector_ptr);
+        return false;
+    }
     void *new_elements_ptr = realloc(
-        ptr_vector_ptr->elements_ptr, new_size * sizeof(void*));
+        ptr_vector_ptr->elements_ptr, capacity * sizeof(void*));
     if (NULL == new_elements_ptr) {
         bs_log(BS_ERROR | BS_ERRNO, "Failed realloc(%p, %zu)",
-               ptr_vector_ptr->elements_ptr, new_size * sizeof(void*));
+               ptr_vector_ptr->elements_ptr, capacity * sizeof(void*));
         return false;
     }
-    ptr_vector_ptr->capacity = new_size;
+    ptr_vector_ptr->capacity = capacity;
     ptr_vector_ptr->elements_ptr = new_elements_ptr;
     return true;
 }
@@ -127,10 +218,25 @@ bool _bs_ptr_vector_grow(bs_ptr_vector_t *ptr_vector_ptr)
 
 static void basic_test(bs_test_t *test_ptr);
 static void large_test(bs_test_t *test_ptr);
+static void capacity_test(bs_test_t *test_ptr);
+static void append_swap_erase_test(bs_test_t *test_ptr);
 
 const bs_test_case_t bs_ptr_vector_test_cases[] = {
     { 1, "basic", basic_test },
     { 1, "large", large_test },
+    { 1, "capacity", capacity_test },
+    { 1, "append_swap_erase", append_swap_erase_test },
+    { 0, NULL, NULL }
+};
+
+static void benchmark_push_back(bs_test_t *test_ptr);
+static void benchmark_append(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t bs_ptr_vector_benchmarks[] = {
+    { 1, "benchmark-push_back-1M", benchmark_push_back },
+    { 1, "benchmark-append-1M", benchmark_append },
     { 0, NULL, NULL }
 };
 
@@ -185,4 +291,133 @@ void large_test(bs_test_t *test_ptr)
     bs_ptr_vector_fini(&vec);
 }
 
+/* ------------------------------------------------------------------------- */
+/** Tests geometric growth, reserve and shrink_to_fit. */
+void capacity_test(bs_test_t *test_ptr)
+{
+    bs_ptr_vector_t vec;
+    char e;
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_init(&vec));
+    BS_TEST_VERIFY_EQ(test_ptr, INITIAL_SIZE, vec.capacity);
+    for (size_t i = 0; i <= INITIAL_SIZE; ++i) {
+        BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_push_back(&vec, &e));
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 2 * INITIAL_SIZE, vec.capacity);
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_reserve(&vec, 100));
+    BS_TEST_VERIFY_EQ(test_ptr, 2 * INITIAL_SIZE, vec.capacity);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_reserve(&vec, 5000));
+    BS_TEST_VERIFY_EQ(test_ptr, 5000, vec.capacity);
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_shrink_to_fit(&vec));
+    BS_TEST_VERIFY_EQ(test_ptr, INITIAL_SIZE + 1, vec.capacity);
+    BS_TEST_VERIFY_EQ(test_ptr, &e, bs_ptr_vector_at(&vec, INITIAL_SIZE));
+
+    while (0 < bs_ptr_vector_size(&vec)) bs_ptr_vector_erase(&vec, 0);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_shrink_to_fit(&vec));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, vec.capacity);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, vec.elements_ptr);
+
+    // Still usable, after shrinking to nothing.
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_push_back(&vec, &e));
+    BS_TEST_VERIFY_EQ(test_ptr, &e, bs_ptr_vector_at(&vec, 0));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_erase(&vec, 0));
+
+    bs_ptr_vector_fini(&vec);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Tests bulk append, and erasing by swapping with the last element. */
+void append_swap_erase_test(bs_test_t *test_ptr)
+{
+    bs_ptr_vector_t vec;
+    char e[3 * INITIAL_SIZE];
+    void *elements[3 * INITIAL_SIZE];
+    for (size_t i = 0; i < 3 * INITIAL_SIZE; ++i) elements[i] = &e[i];
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_init(&vec));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_append(&vec, elements, 2));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_ptr_vector_append(&vec, elements + 2, 3 * INITIAL_SIZE - 2));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_append(&vec, elements, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 3 * INITIAL_SIZE, bs_ptr_vector_size(&vec));
+    for (size_t i = 0; i < 3 * INITIAL_SIZE; ++i) {
+        BS_TEST_VERIFY_EQ(test_ptr, &e[i], bs_ptr_vector_at(&vec, i));
+    }
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_ptr_vector_swap_erase(&vec, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, &e[0], bs_ptr_vector_at(&vec, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, &e[3 * INITIAL_SIZE - 1],
+                      bs_ptr_vector_at(&vec, 1));
+    BS_TEST_VERIFY_EQ(test_ptr, 3 * INITIAL_SIZE - 1, bs_ptr_vector_size(&vec));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_ptr_vector_swap_erase(&vec, 3 * INITIAL_SIZE - 1));
+
+    // Erasing the last element just drops it.
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_ptr_vector_swap_erase(&vec, 3 * INITIAL_SIZE - 2));
+    BS_TEST_VERIFY_EQ(test_ptr, 3 * INITIAL_SIZE - 2, bs_ptr_vector_size(&vec));
+    BS_TEST_VERIFY_EQ(test_ptr, &e[3 * INITIAL_SIZE - 3],
+                      bs_ptr_vector_at(&vec, 3 * INITIAL_SIZE - 3));
+
+    while (0 < bs_ptr_vector_size(&vec)) bs_ptr_vector_swap_erase(&vec, 0);
+    bs_ptr_vector_fini(&vec);
+}
+
+/** Number of elements added in each benchmark iteration. */
+#define _BENCHMARK_ELEMENTS   (1024 * 1024)
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks pushing _BENCHMARK_ELEMENTS elements one by one. */
+void benchmark_push_back(bs_test_t *test_ptr)
+{
+    uint64_t iterations = 0;
+    uint64_t usec = bs_usec();
+    while (usec + benchmark_duration >= bs_usec()) {
+        bs_ptr_vector_t vec;
+        bs_ptr_vector_init(&vec);
+        for (size_t i = 0; i < _BENCHMARK_ELEMENTS; ++i) {
+            bs_ptr_vector_push_back(&vec, (void*)i);
+        }
+        BS_TEST_VERIFY_EQ(test_ptr, _BENCHMARK_ELEMENTS,
+                          bs_ptr_vector_size(&vec));
+        vec.consumed = 0;
+        bs_ptr_vector_fini(&vec);
+        iterations++;
+    }
+    usec = bs_usec() - usec;
+
+    bs_test_succeed(test_ptr, "%.3e elements/sec",
+                    (double)iterations * _BENCHMARK_ELEMENTS / (usec * 1e-6));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks appending _BENCHMARK_ELEMENTS elements in chunks of 256. */
+void benchmark_append(bs_test_t *test_ptr)
+{
+    void *elements[256];
+    for (size_t i = 0; i < 256; ++i) elements[i] = (void*)i;
+
+    uint64_t iterations = 0;
+    uint64_t usec = bs_usec();
+    while (usec + benchmark_duration >= bs_usec()) {
+        bs_ptr_vector_t vec;
+        bs_ptr_vector_init(&vec);
+        for (size_t i = 0; i < _BENCHMARK_ELEMENTS; i += 256) {
+            bs_ptr_vector_append(&vec, elements, 256);
+        }
+        BS_TEST_VERIFY_EQ(test_ptr, _BENCHMARK_ELEMENTS,
+                          bs_ptr_vector_size(&vec));
+        vec.consumed = 0;
+        bs_ptr_vector_fini(&vec);
+        iterations++;
+    }
+    usec = bs_usec() - usec;
+
+    bs_test_succeed(test_ptr, "%.3e elements/sec",
+                    (double)iterations * _BENCHMARK_ELEMENTS / (usec * 1e-6));
+}
+
 /* == End of ptr_vector.c ================================================== */
@@ -82,12 +82,63 @@ bool bs_ptr_vector_push_back(bs_ptr_vector_t *ptr_vector_ptr,
 bool bs_ptr_vector_erase(bs_ptr_vector_t *ptr_vector_ptr,
                          size_t pos);
 
+/**
+ * Erases the element at pos, by moving the last element into its place.
+ * Does not retain the order of elements, but avoids moving all subsequent
+ * elements.
+ *
+ * @param ptr_vector_ptr
+ * @param pos
+ *
+ * @return true if pos was valid.
+ */
+bool bs_ptr_vector_swap_erase(bs_ptr_vector_t *ptr_vector_ptr,
+                              size_t pos);
+
+/**
+ * Adds `num` elements from `elements_ptr` at the end of the vector.
+ *
+ * @param ptr_vector_ptr
+ * @param elements_ptr
+ * @param num
+ *
+ * @return true on success.
+ */
+bool bs_ptr_vector_append(bs_ptr_vector_t *ptr_vector_ptr,
+                          void *const *elements_ptr,
+                          size_t num);
+
+/**
+ * Ensures the vector has capacity for at least `capacity` elements, so that
+ * adding up to that many elements does not re-allocate.
+ *
+ * @param ptr_vector_ptr
+ * @param capacity
+ *
+ * @return true on success.
+ */
+bool bs_ptr_vector_reserve(bs_ptr_vector_t *ptr_vector_ptr,
+                           size_t capacity);
+
+/**
+ * Reduces the vector's capacity to its size. Frees all storage, if the
+ * vector is empty.
+ *
+ * @param ptr_vector_ptr
+ *
+ * @return true on success.
+ */
+bool bs_ptr_vector_shrink_to_fit(bs_ptr_vector_t *ptr_vector_ptr);
+
 /** @return the element at `pos`. It must be `pos` < size. */
 void* bs_ptr_vector_at(bs_ptr_vector_t *ptr_vector_ptr, size_t pos);
 
 /** Unit tests. */
 extern const bs_test_case_t   bs_ptr_vector_test_cases[];
 
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_ptr_vector_benchmarks[];
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
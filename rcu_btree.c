@@ -0,0 +1,1368 @@
+/* ========================================================================= */
+/**
+ * @file rcu_btree.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rcu_btree.h"
+
+#include "atomic.h"
+#include "avltree.h"
+#include "def.h"
+#include "log_wrappers.h"
+#include "thread.h"
+#include "time.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* == Declarations ========================================================= */
+
+/** Forward declaration: A tree node. */
+typedef struct _bs_rcu_btree_node_t bs_rcu_btree_node_t;
+
+/**
+ * @private A node of the tree.
+ *
+ * Once reachable from a published root, a node is immutable. All nodes are
+ * allocated at the same size, so that spare nodes serve as leaf or internal.
+ */
+struct _bs_rcu_btree_node_t {
+    /** Number of keys in this node. */
+    unsigned                  count;
+    /** Whether this is a leaf node. */
+    bool                      leaf;
+    /** The keys, in ascending order. */
+    uint64_t                  keys[BS_BTREE_MAX_KEYS];
+    /** The value for each key. */
+    void                      *values_ptr[BS_BTREE_MAX_KEYS];
+    /** Write operation that created the node. Only read by the writer. */
+    uint64_t                  generation;
+    /** For retiring; also links spare and replaced nodes. */
+    bs_epoch_retired_t        retired;
+    /** Children, `count` + 1 of them. Unused in leaf nodes. */
+    bs_rcu_btree_node_t       *children_ptr[BS_BTREE_MAX_KEYS + 1];
+};
+
+/** State of the tree. */
+struct _bs_rcu_btree_t {
+    /** The root node, a `bs_rcu_btree_node_t*`. NULL if empty. */
+    bs_atomic_ptr_t           root;
+    /** Number of keys in the tree. */
+    bs_atomic_int64_t         size;
+
+    /** Serializes writers. Guards all fields below. */
+    pthread_mutex_t           mutex;
+    /** The writers' participant in the epoch domain, to retire nodes. */
+    bs_epoch_participant_t    *writer_participant_ptr;
+    /** Incremented for each write operation. */
+    uint64_t                  generation;
+    /** Number of levels. 0 if empty. */
+    unsigned                  height;
+    /** Nodes allocated ahead, so no write fails halfway. */
+    bs_rcu_btree_node_t       *spares_ptr;
+    /** Number of nodes in `spares_ptr`. */
+    unsigned                  spares;
+    /** Nodes replaced by the current write, to retire once published. */
+    bs_rcu_btree_node_t       *replaced_ptr;
+};
+
+static bool _bs_rcu_btree_reserve(bs_rcu_btree_t *tree_ptr, unsigned nodes);
+static bs_rcu_btree_node_t *_bs_rcu_btree_node_take(bs_rcu_btree_t *tree_ptr,
+                                                    bool leaf);
+static void _bs_rcu_btree_node_drop(bs_rcu_btree_t *tree_ptr,
+                                    bs_rcu_btree_node_t *node_ptr);
+static bs_rcu_btree_node_t *_bs_rcu_btree_node_cow(
+    bs_rcu_btree_t *tree_ptr,
+    bs_rcu_btree_node_t *node_ptr);
+static void _bs_rcu_btree_node_reclaim(bs_epoch_retired_t *retired_ptr);
+static void _bs_rcu_btree_node_destroy(bs_rcu_btree_node_t *node_ptr);
+static void _bs_rcu_btree_publish(bs_rcu_btree_t *tree_ptr,
+                                  bs_rcu_btree_node_t *root_ptr);
+static unsigned _bs_rcu_btree_node_search(
+    const bs_rcu_btree_node_t *node_ptr,
+    uint64_t key,
+    bool *found_ptr);
+static bool _bs_rcu_btree_find(const bs_rcu_btree_node_t *node_ptr,
+                               uint64_t key,
+                               void **value_ptr_ptr);
+static bool _bs_rcu_btree_scan_node(const bs_rcu_btree_node_t *node_ptr,
+                                    uint64_t key,
+                                    bs_rcu_btree_scan_fn_t fn,
+                                    void *ud_ptr,
+                                    size_t *count_ptr);
+static void _bs_rcu_btree_split_child(bs_rcu_btree_t *tree_ptr,
+                                      bs_rcu_btree_node_t *node_ptr,
+                                      unsigned pos);
+static void _bs_rcu_btree_merge_children(bs_rcu_btree_t *tree_ptr,
+                                         bs_rcu_btree_node_t *node_ptr,
+                                         unsigned pos);
+static unsigned _bs_rcu_btree_fill_child(bs_rcu_btree_t *tree_ptr,
+                                         bs_rcu_btree_node_t *node_ptr,
+                                         unsigned pos);
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_rcu_btree_t *bs_rcu_btree_create(bs_epoch_t *epoch_ptr)
+{
+    bs_rcu_btree_t *tree_ptr = logged_calloc(1, sizeof(bs_rcu_btree_t));
+    if (NULL == tree_ptr) return NULL;
+    if (!bs_mutex_init(&tree_ptr->mutex)) {
+        logged_free(tree_ptr);
+        return NULL;
+    }
+    tree_ptr->writer_participant_ptr = bs_epoch_register(epoch_ptr);
+    if (NULL == tree_ptr->writer_participant_ptr) {
+        bs_mutex_destroy(&tree_ptr->mutex);
+        logged_free(tree_ptr);
+        return NULL;
+    }
+    return tree_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_rcu_btree_destroy(bs_rcu_btree_t *tree_ptr)
+{
+    bs_rcu_btree_node_t *root_ptr = bs_atomic_ptr_get(&tree_ptr->root);
+    if (NULL != root_ptr) _bs_rcu_btree_node_destroy(root_ptr);
+
+    // Reclaims all retired nodes.
+    bs_epoch_unregister(tree_ptr->writer_participant_ptr);
+
+    while (NULL != tree_ptr->spares_ptr) {
+        bs_rcu_btree_node_t *node_ptr = _bs_rcu_btree_node_take(
+            tree_ptr, true);
+        logged_free(node_ptr);
+    }
+    bs_mutex_destroy(&tree_ptr->mutex);
+    logged_free(tree_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_rcu_btree_insert(bs_rcu_btree_t *tree_ptr,
+                         uint64_t key,
+                         void *value_ptr,
+                         bool do_overwrite)
+{
+    bs_mutex_lock(&tree_ptr->mutex);
+
+    // Checks before copying anything. Each level copies the node on the
+    // path, and may split its child; plus a new root.
+    bs_rcu_btree_node_t *root_ptr = bs_atomic_ptr_get_explicit(
+        &tree_ptr->root, BS_ATOMIC_RELAXED);
+    bool found = _bs_rcu_btree_find(root_ptr, key, NULL);
+    if ((found && !do_overwrite) ||
+        !_bs_rcu_btree_reserve(tree_ptr, 2 * tree_ptr->height + 4)) {
+        bs_mutex_unlock(&tree_ptr->mutex);
+        return false;
+    }
+    tree_ptr->generation++;
+
+    if (NULL == root_ptr) {
+        root_ptr = _bs_rcu_btree_node_take(tree_ptr, true);
+        tree_ptr->height = 1;
+    } else {
+        root_ptr = _bs_rcu_btree_node_cow(tree_ptr, root_ptr);
+    }
+    if (BS_BTREE_MAX_KEYS == root_ptr->count) {
+        bs_rcu_btree_node_t *new_root_ptr = _bs_rcu_btree_node_take(
+            tree_ptr, false);
+        new_root_ptr->children_ptr[0] = root_ptr;
+        _bs_rcu_btree_split_child(tree_ptr, new_root_ptr, 0);
+        root_ptr = new_root_ptr;
+        tree_ptr->height++;
+    }
+
+    // As bs_btree_insert, but copying each child before descending into it.
+    bs_rcu_btree_node_t *node_ptr = root_ptr;
+    for (;;) {
+        unsigned pos = _bs_rcu_btree_node_search(node_ptr, key, &found);
+
+        if (!found && !node_ptr->leaf) {
+            bs_rcu_btree_node_t *child_ptr = _bs_rcu_btree_node_cow(
+                tree_ptr, node_ptr->children_ptr[pos]);
+            node_ptr->children_ptr[pos] = child_ptr;
+            if (BS_BTREE_MAX_KEYS == child_ptr->count) {
+                _bs_rcu_btree_split_child(tree_ptr, node_ptr, pos);
+                if (key == node_ptr->keys[pos]) found = true;
+                if (key > node_ptr->keys[pos]) ++pos;
+            }
+        }
+
+        if (found) {
+            node_ptr->values_ptr[pos] = value_ptr;
+            break;
+        }
+
+        if (node_ptr->leaf) {
+            unsigned tail = node_ptr->count - pos;
+            memmove(&node_ptr->keys[pos + 1], &node_ptr->keys[pos],
+                    tail * sizeof(uint64_t));
+            memmove(&node_ptr->values_ptr[pos + 1], &node_ptr->values_ptr[pos],
+                    tail * sizeof(void*));
+            node_ptr->keys[pos] = key;
+            node_ptr->values_ptr[pos] = value_ptr;
+            node_ptr->count++;
+            bs_atomic_int64_add(&tree_ptr->size, 1);
+            break;
+        }
+        node_ptr = node_ptr->children_ptr[pos];
+    }
+
+    _bs_rcu_btree_publish(tree_ptr, root_ptr);
+    bs_mutex_unlock(&tree_ptr->mutex);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_rcu_btree_delete(bs_rcu_btree_t *tree_ptr,
+                         uint64_t key,
+                         void **value_ptr_ptr)
+{
+    bs_mutex_lock(&tree_ptr->mutex);
+
+    // Each level copies the node on the path, and may copy a sibling.
+    bs_rcu_btree_node_t *root_ptr = bs_atomic_ptr_get_explicit(
+        &tree_ptr->root, BS_ATOMIC_RELAXED);
+    void *value_ptr;
+    if (!_bs_rcu_btree_find(root_ptr, key, &value_ptr) ||
+        !_bs_rcu_btree_reserve(tree_ptr, 2 * tree_ptr->height + 1)) {
+        bs_mutex_unlock(&tree_ptr->mutex);
+        return false;
+    }
+    tree_ptr->generation++;
+
+    // As bs_btree_delete. The key is known to exist, so every node on the
+    // path gets modified, and is copied.
+    root_ptr = _bs_rcu_btree_node_cow(tree_ptr, root_ptr);
+    bs_rcu_btree_node_t *node_ptr = root_ptr;
+    for (;;) {
+        bool found;
+        unsigned pos = _bs_rcu_btree_node_search(node_ptr, key, &found);
+
+        if (node_ptr->leaf) {
+            unsigned tail = node_ptr->count - pos - 1;
+            memmove(&node_ptr->keys[pos], &node_ptr->keys[pos + 1],
+                    tail * sizeof(uint64_t));
+            memmove(&node_ptr->values_ptr[pos], &node_ptr->values_ptr[pos + 1],
+                    tail * sizeof(void*));
+            node_ptr->count--;
+            break;
+        }
+
+        if (!found) {
+            pos = _bs_rcu_btree_fill_child(tree_ptr, node_ptr, pos);
+            node_ptr = node_ptr->children_ptr[pos];
+            continue;
+        }
+
+        // Found in an internal node: Replace by the predecessor or the
+        // successor, and continue by deleting that one from its leaf.
+        bs_rcu_btree_node_t *left_ptr = node_ptr->children_ptr[pos];
+        bs_rcu_btree_node_t *right_ptr = node_ptr->children_ptr[pos + 1];
+        if (BS_BTREE_MIN_DEGREE <= left_ptr->count) {
+            const bs_rcu_btree_node_t *n_ptr = left_ptr;
+            while (!n_ptr->leaf) n_ptr = n_ptr->children_ptr[n_ptr->count];
+            key = n_ptr->keys[n_ptr->count - 1];
+            node_ptr->keys[pos] = key;
+            node_ptr->values_ptr[pos] = n_ptr->values_ptr[n_ptr->count - 1];
+            node_ptr->children_ptr[pos] = _bs_rcu_btree_node_cow(
+                tree_ptr, left_ptr);
+            node_ptr = node_ptr->children_ptr[pos];
+        } else if (BS_BTREE_MIN_DEGREE <= right_ptr->count) {
+            const bs_rcu_btree_node_t *n_ptr = right_ptr;
+            while (!n_ptr->leaf) n_ptr = n_ptr->children_ptr[0];
+            key = n_ptr->keys[0];
+            node_ptr->keys[pos] = key;
+            node_ptr->values_ptr[pos] = n_ptr->values_ptr[0];
+            node_ptr->children_ptr[pos + 1] = _bs_rcu_btree_node_cow(
+                tree_ptr, right_ptr);
+            node_ptr = node_ptr->children_ptr[pos + 1];
+        } else {
+            _bs_rcu_btree_merge_children(tree_ptr, node_ptr, pos);
+            node_ptr = node_ptr->children_ptr[pos];
+        }
+    }
+
+    if (0 == root_ptr->count) {
+        bs_rcu_btree_node_t *old_root_ptr = root_ptr;
+        root_ptr = root_ptr->leaf ? NULL : root_ptr->children_ptr[0];
+        _bs_rcu_btree_node_drop(tree_ptr, old_root_ptr);
+        tree_ptr->height--;
+    }
+    bs_atomic_int64_add(&tree_ptr->size, -1);
+
+    _bs_rcu_btree_publish(tree_ptr, root_ptr);
+    bs_mutex_unlock(&tree_ptr->mutex);
+    if (NULL != value_ptr_ptr) *value_ptr_ptr = value_ptr;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_rcu_btree_lookup(bs_rcu_btree_t *tree_ptr,
+                         bs_epoch_participant_t *participant_ptr,
+                         uint64_t key,
+                         void **value_ptr_ptr)
+{
+    bs_epoch_enter(participant_ptr);
+    bool found = _bs_rcu_btree_find(
+        bs_atomic_ptr_get_explicit(&tree_ptr->root, BS_ATOMIC_ACQUIRE),
+        key, value_ptr_ptr);
+    bs_epoch_leave(participant_ptr);
+    return found;
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_rcu_btree_scan(bs_rcu_btree_t *tree_ptr,
+                         bs_epoch_participant_t *participant_ptr,
+                         uint64_t key,
+                         bs_rcu_btree_scan_fn_t fn,
+                         void *ud_ptr)
+{
+    size_t count = 0;
+    bs_epoch_enter(participant_ptr);
+    bs_rcu_btree_node_t *root_ptr = bs_atomic_ptr_get_explicit(
+        &tree_ptr->root, BS_ATOMIC_ACQUIRE);
+    if (NULL != root_ptr) {
+        _bs_rcu_btree_scan_node(root_ptr, key, fn, ud_ptr, &count);
+    }
+    bs_epoch_leave(participant_ptr);
+    return count;
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_rcu_btree_size(bs_rcu_btree_t *tree_ptr)
+{
+    return bs_atomic_int64_get(&tree_ptr->size);
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Allocates spare nodes, for at least `nodes` to take. */
+bool _bs_rcu_btree_reserve(bs_rcu_btree_t *tree_ptr, unsigned nodes)
+{
+    while (tree_ptr->spares < nodes) {
+        bs_rcu_btree_node_t *node_ptr = logged_malloc(
+            sizeof(bs_rcu_btree_node_t));
+        if (NULL == node_ptr) return false;
+        node_ptr->retired.next_ptr = NULL;
+        if (NULL != tree_ptr->spares_ptr) {
+            node_ptr->retired.next_ptr = &tree_ptr->spares_ptr->retired;
+        }
+        tree_ptr->spares_ptr = node_ptr;
+        tree_ptr->spares++;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Takes a spare node, for the current write. There must be a spare. */
+bs_rcu_btree_node_t *_bs_rcu_btree_node_take(bs_rcu_btree_t *tree_ptr,
+                                             bool leaf)
+{
+    bs_rcu_btree_node_t *node_ptr = tree_ptr->spares_ptr;
+    tree_ptr->spares_ptr = NULL;
+    if (NULL != node_ptr->retired.next_ptr) {
+        tree_ptr->spares_ptr = BS_CONTAINER_OF(
+            node_ptr->retired.next_ptr, bs_rcu_btree_node_t, retired);
+    }
+    tree_ptr->spares--;
+    node_ptr->count = 0;
+    node_ptr->leaf = leaf;
+    node_ptr->generation = tree_ptr->generation;
+    return node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Drops a node from the tree. A node taken by the current write was never
+ * published, and returns to the spares. Others are retired after publishing.
+ */
+void _bs_rcu_btree_node_drop(bs_rcu_btree_t *tree_ptr,
+                             bs_rcu_btree_node_t *node_ptr)
+{
+    bs_rcu_btree_node_t **list_ptr_ptr = &tree_ptr->replaced_ptr;
+    if (node_ptr->generation == tree_ptr->generation) {
+        list_ptr_ptr = &tree_ptr->spares_ptr;
+        tree_ptr->spares++;
+    }
+    node_ptr->retired.next_ptr = NULL;
+    if (NULL != *list_ptr_ptr) {
+        node_ptr->retired.next_ptr = &(*list_ptr_ptr)->retired;
+    }
+    *list_ptr_ptr = node_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns a node of the current write, with the contents of `node_ptr`:
+ * `node_ptr` itself if it is of the current write, else a copy. The caller
+ * must link the returned node in place of `node_ptr`.
+ */
+bs_rcu_btree_node_t *_bs_rcu_btree_node_cow(bs_rcu_btree_t *tree_ptr,
+                                            bs_rcu_btree_node_t *node_ptr)
+{
+    if (node_ptr->generation == tree_ptr->generation) return node_ptr;
+
+    bs_rcu_btree_node_t *copy_ptr = _bs_rcu_btree_node_take(
+        tree_ptr, node_ptr->leaf);
+    copy_ptr->count = node_ptr->count;
+    memcpy(copy_ptr->keys, node_ptr->keys, node_ptr->count * sizeof(uint64_t));
+    memcpy(copy_ptr->values_ptr, node_ptr->values_ptr,
+           node_ptr->count * sizeof(void*));
+    if (!node_ptr->leaf) {
+        memcpy(copy_ptr->children_ptr, node_ptr->children_ptr,
+               (node_ptr->count + 1) * sizeof(bs_rcu_btree_node_t*));
+    }
+    _bs_rcu_btree_node_drop(tree_ptr, node_ptr);
+    return copy_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Frees a retired node, once no reader can reference it. */
+void _bs_rcu_btree_node_reclaim(bs_epoch_retired_t *retired_ptr)
+{
+    bs_rcu_btree_node_t *node_ptr = BS_CONTAINER_OF(
+        retired_ptr, bs_rcu_btree_node_t, retired);
+    logged_free(node_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Frees the node and its subtree. Bound by BS_BTREE_MAX_HEIGHT. */
+void _bs_rcu_btree_node_destroy(bs_rcu_btree_node_t *node_ptr)
+{
+    if (!node_ptr->leaf) {
+        for (unsigned i = 0; i <= node_ptr->count; ++i) {
+            _bs_rcu_btree_node_destroy(node_ptr->children_ptr[i]);
+        }
+    }
+    logged_free(node_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Publishes the new root, then retires the nodes it replaced: Readers that
+ * load the root from now on can no longer reach them.
+ */
+void _bs_rcu_btree_publish(bs_rcu_btree_t *tree_ptr,
+                           bs_rcu_btree_node_t *root_ptr)
+{
+    // The release pairs with the readers' acquire: Contents of the new
+    // nodes are visible before the root that leads to them.
+    bs_atomic_ptr_set_explicit(&tree_ptr->root, root_ptr, BS_ATOMIC_RELEASE);
+
+    while (NULL != tree_ptr->replaced_ptr) {
+        bs_rcu_btree_node_t *node_ptr = tree_ptr->replaced_ptr;
+        tree_ptr->replaced_ptr = NULL;
+        if (NULL != node_ptr->retired.next_ptr) {
+            tree_ptr->replaced_ptr = BS_CONTAINER_OF(
+                node_ptr->retired.next_ptr, bs_rcu_btree_node_t, retired);
+        }
+        bs_epoch_retire(tree_ptr->writer_participant_ptr,
+                        &node_ptr->retired,
+                        _bs_rcu_btree_node_reclaim);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Branch-free binary search for the first key not less than `key`. As the
+ * inline path of the search in btree.c.
+ *
+ * @return Position of the first key not less than `key`. This is `count`,
+ *     if all keys are less.
+ */
+unsigned _bs_rcu_btree_node_search(const bs_rcu_btree_node_t *node_ptr,
+                                   uint64_t key,
+                                   bool *found_ptr)
+{
+    const uint64_t *base_ptr = node_ptr->keys;
+    unsigned n = node_ptr->count;
+    *found_ptr = false;
+    if (0 == n) return 0;
+
+    while (1 < n) {
+        unsigned half = n / 2;
+        base_ptr = (base_ptr[half] < key) ? base_ptr + half : base_ptr;
+        n -= half;
+    }
+    unsigned pos = (base_ptr - node_ptr->keys) + (*base_ptr < key);
+    *found_ptr = pos < node_ptr->count && node_ptr->keys[pos] == key;
+    return pos;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Looks up `key` in the subtree at `node_ptr`, which may be NULL. */
+bool _bs_rcu_btree_find(const bs_rcu_btree_node_t *node_ptr,
+                        uint64_t key,
+                        void **value_ptr_ptr)
+{
+    while (NULL != node_ptr) {
+        bool found;
+        unsigned pos = _bs_rcu_btree_node_search(node_ptr, key, &found);
+        if (found) {
+            if (NULL != value_ptr_ptr) {
+                *value_ptr_ptr = node_ptr->values_ptr[pos];
+            }
+            return true;
+        }
+        if (node_ptr->leaf) break;
+        node_ptr = node_ptr->children_ptr[pos];
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Calls `fn` for keys not less than `key` of the subtree, in order.
+ *
+ * @return false if `fn` returned false.
+ */
+bool _bs_rcu_btree_scan_node(const bs_rcu_btree_node_t *node_ptr,
+                             uint64_t key,
+                             bs_rcu_btree_scan_fn_t fn,
+                             void *ud_ptr,
+                             size_t *count_ptr)
+{
+    bool found;
+    unsigned pos = _bs_rcu_btree_node_search(node_ptr, key, &found);
+    for (unsigned i = pos; i <= node_ptr->count; ++i) {
+        // Left of a found key, all keys are less. Recursion is bound by
+        // BS_BTREE_MAX_HEIGHT.
+        if (!node_ptr->leaf && !(found && i == pos) &&
+            !_bs_rcu_btree_scan_node(node_ptr->children_ptr[i], key,
+                                     fn, ud_ptr, count_ptr)) {
+            return false;
+        }
+        if (i == node_ptr->count) break;
+        ++*count_ptr;
+        if (!fn(node_ptr->keys[i], node_ptr->values_ptr[i], ud_ptr)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Splits the full child at `pos` of `node_ptr` into two, and moves its
+ * median key into `node_ptr`. Both must be of the current write.
+ */
+void _bs_rcu_btree_split_child(bs_rcu_btree_t *tree_ptr,
+                               bs_rcu_btree_node_t *node_ptr,
+                               unsigned pos)
+{
+    const unsigned t = BS_BTREE_MIN_DEGREE;
+    bs_rcu_btree_node_t *child_ptr = node_ptr->children_ptr[pos];
+    bs_rcu_btree_node_t *new_ptr = _bs_rcu_btree_node_take(
+        tree_ptr, child_ptr->leaf);
+
+    new_ptr->count = t - 1;
+    memcpy(new_ptr->keys, &child_ptr->keys[t], (t - 1) * sizeof(uint64_t));
+    memcpy(new_ptr->values_ptr, &child_ptr->values_ptr[t],
+           (t - 1) * sizeof(void*));
+    if (!child_ptr->leaf) {
+        memcpy(new_ptr->children_ptr, &child_ptr->children_ptr[t],
+               t * sizeof(bs_rcu_btree_node_t*));
+    }
+    child_ptr->count = t - 1;
+
+    unsigned tail = node_ptr->count - pos;
+    memmove(&node_ptr->keys[pos + 1], &node_ptr->keys[pos],
+            tail * sizeof(uint64_t));
+    memmove(&node_ptr->values_ptr[pos + 1], &node_ptr->values_ptr[pos],
+            tail * sizeof(void*));
+    memmove(&node_ptr->children_ptr[pos + 2], &node_ptr->children_ptr[pos + 1],
+            tail * sizeof(bs_rcu_btree_node_t*));
+    node_ptr->keys[pos] = child_ptr->keys[t - 1];
+    node_ptr->values_ptr[pos] = child_ptr->values_ptr[t - 1];
+    node_ptr->children_ptr[pos + 1] = new_ptr;
+    node_ptr->count++;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Merges the children at `pos` and `pos + 1` of `node_ptr`, together with
+ * the key at `pos`, into a copy of the child at `pos`. Drops the right one.
+ */
+void _bs_rcu_btree_merge_children(bs_rcu_btree_t *tree_ptr,
+                                  bs_rcu_btree_node_t *node_ptr,
+                                  unsigned pos)
+{
+    bs_rcu_btree_node_t *left_ptr = _bs_rcu_btree_node_cow(
+        tree_ptr, node_ptr->children_ptr[pos]);
+    bs_rcu_btree_node_t *right_ptr = node_ptr->children_ptr[pos + 1];
+    node_ptr->children_ptr[pos] = left_ptr;
+    unsigned l = left_ptr->count;
+
+    left_ptr->keys[l] = node_ptr->keys[pos];
+    left_ptr->values_ptr[l] = node_ptr->values_ptr[pos];
+    memcpy(&left_ptr->keys[l + 1], right_ptr->keys,
+           right_ptr->count * sizeof(uint64_t));
+    memcpy(&left_ptr->values_ptr[l + 1], right_ptr->values_ptr,
+           right_ptr->count * sizeof(void*));
+    if (!left_ptr->leaf) {
+        memcpy(&left_ptr->children_ptr[l + 1], right_ptr->children_ptr,
+               (right_ptr->count + 1) * sizeof(bs_rcu_btree_node_t*));
+    }
+    left_ptr->count += right_ptr->count + 1;
+    _bs_rcu_btree_node_drop(tree_ptr, right_ptr);
+
+    unsigned tail = node_ptr->count - pos - 1;
+    memmove(&node_ptr->keys[pos], &node_ptr->keys[pos + 1],
+            tail * sizeof(uint64_t));
+    memmove(&node_ptr->values_ptr[pos], &node_ptr->values_ptr[pos + 1],
+            tail * sizeof(void*));
+    memmove(&node_ptr->children_ptr[pos + 1], &node_ptr->children_ptr[pos + 2],
+            tail * sizeof(bs_rcu_btree_node_t*));
+    node_ptr->count--;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Copies the child at `pos` of `node_ptr`, and ensures it has at least
+ * @ref BS_BTREE_MIN_DEGREE keys. As in btree.c, by borrowing from a copied
+ * sibling, or by merging with a sibling.
+ *
+ * @return The position of the child holding the keys of the former child
+ *     at `pos`. Differs from `pos` if merged with the left sibling.
+ */
+unsigned _bs_rcu_btree_fill_child(bs_rcu_btree_t *tree_ptr,
+                                  bs_rcu_btree_node_t *node_ptr,
+                                  unsigned pos)
+{
+    bs_rcu_btree_node_t *child_ptr = _bs_rcu_btree_node_cow(
+        tree_ptr, node_ptr->children_ptr[pos]);
+    node_ptr->children_ptr[pos] = child_ptr;
+    if (BS_BTREE_MIN_DEGREE <= child_ptr->count) return pos;
+
+    bs_rcu_btree_node_t *left_ptr = NULL, *right_ptr = NULL;
+    if (0 < pos) left_ptr = node_ptr->children_ptr[pos - 1];
+    if (pos < node_ptr->count) right_ptr = node_ptr->children_ptr[pos + 1];
+
+    if (NULL != left_ptr && BS_BTREE_MIN_DEGREE <= left_ptr->count) {
+        left_ptr = _bs_rcu_btree_node_cow(tree_ptr, left_ptr);
+        node_ptr->children_ptr[pos - 1] = left_ptr;
+        memmove(&child_ptr->keys[1], child_ptr->keys,
+                child_ptr->count * sizeof(uint64_t));
+        memmove(&child_ptr->values_ptr[1], child_ptr->values_ptr,
+                child_ptr->count * sizeof(void*));
+        child_ptr->keys[0] = node_ptr->keys[pos - 1];
+        child_ptr->values_ptr[0] = node_ptr->values_ptr[pos - 1];
+        if (!child_ptr->leaf) {
+            memmove(&child_ptr->children_ptr[1], child_ptr->children_ptr,
+                    (child_ptr->count + 1) * sizeof(bs_rcu_btree_node_t*));
+            child_ptr->children_ptr[0] =
+                left_ptr->children_ptr[left_ptr->count];
+        }
+        child_ptr->count++;
+        left_ptr->count--;
+        node_ptr->keys[pos - 1] = left_ptr->keys[left_ptr->count];
+        node_ptr->values_ptr[pos - 1] = left_ptr->values_ptr[left_ptr->count];
+        return pos;
+    }
+
+    if (NULL != right_ptr && BS_BTREE_MIN_DEGREE <= right_ptr->count) {
+        right_ptr = _bs_rcu_btree_node_cow(tree_ptr, right_ptr);
+        node_ptr->children_ptr[pos + 1] = right_ptr;
+        child_ptr->keys[child_ptr->count] = node_ptr->keys[pos];
+        child_ptr->values_ptr[child_ptr->count] = node_ptr->values_ptr[pos];
+        if (!child_ptr->leaf) {
+            child_ptr->children_ptr[child_ptr->count + 1] =
+                right_ptr->children_ptr[0];
+            memmove(right_ptr->children_ptr, &right_ptr->children_ptr[1],
+                    right_ptr->count * sizeof(bs_rcu_btree_node_t*));
+        }
+        child_ptr->count++;
+        node_ptr->keys[pos] = right_ptr->keys[0];
+        node_ptr->values_ptr[pos] = right_ptr->values_ptr[0];
+        right_ptr->count--;
+        memmove(right_ptr->keys, &right_ptr->keys[1],
+                right_ptr->count * sizeof(uint64_t));
+        memmove(right_ptr->values_ptr, &right_ptr->values_ptr[1],
+                right_ptr->count * sizeof(void*));
+        return pos;
+    }
+
+    if (NULL != right_ptr) {
+        _bs_rcu_btree_merge_children(tree_ptr, node_ptr, pos);
+        return pos;
+    }
+    _bs_rcu_btree_merge_children(tree_ptr, node_ptr, pos - 1);
+    return pos - 1;
+}
+
+/* == Unit tests =========================================================== */
+/** @cond TEST */
+
+static void test_basic(bs_test_t *test_ptr);
+static void test_random(bs_test_t *test_ptr);
+static void test_scan(bs_test_t *test_ptr);
+static void test_concurrent(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_rcu_btree_test_cases[] = {
+    { 1, "basic", test_basic },
+    { 1, "random", test_random },
+    { 1, "scan", test_scan },
+    { 1, "concurrent", test_concurrent },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Verifies the subtree at `node_ptr`: Ordering, fill and depth.
+ *
+ * @return Number of keys in the subtree.
+ */
+static size_t _test_verify_node(bs_test_t *test_ptr,
+                                const bs_rcu_btree_t *tree_ptr,
+                                const bs_rcu_btree_node_t *node_ptr,
+                                bool root,
+                                const uint64_t *min_ptr,
+                                const uint64_t *max_ptr,
+                                unsigned depth)
+{
+    if (!root && node_ptr->count < BS_BTREE_MIN_DEGREE - 1) {
+        BS_TEST_FAIL(test_ptr, "Node %p under-full: %u keys",
+                     node_ptr, node_ptr->count);
+    }
+    for (unsigned i = 0; i < node_ptr->count; ++i) {
+        uint64_t k = node_ptr->keys[i];
+        if ((0 < i && node_ptr->keys[i - 1] >= k) ||
+            (NULL != min_ptr && *min_ptr >= k) ||
+            (NULL != max_ptr && k >= *max_ptr)) {
+            BS_TEST_FAIL(test_ptr, "Node %p: Key %u out of order", node_ptr, i);
+        }
+    }
+
+    if (node_ptr->leaf) {
+        if (depth + 1 != tree_ptr->height) {
+            BS_TEST_FAIL(test_ptr, "Leaf %p at depth %u, height %u",
+                         node_ptr, depth, tree_ptr->height);
+        }
+        return node_ptr->count;
+    }
+
+    size_t size = node_ptr->count;
+    for (unsigned i = 0; i <= node_ptr->count; ++i) {
+        size += _test_verify_node(
+            test_ptr, tree_ptr, node_ptr->children_ptr[i], false,
+            0 < i ? &node_ptr->keys[i - 1] : min_ptr,
+            i < node_ptr->count ? &node_ptr->keys[i] : max_ptr,
+            depth + 1);
+    }
+    return size;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the tree's structure. Must not be written concurrently. */
+static void _test_verify(bs_test_t *test_ptr, bs_rcu_btree_t *tree_ptr)
+{
+    size_t size = 0;
+    const bs_rcu_btree_node_t *root_ptr = bs_atomic_ptr_get(&tree_ptr->root);
+    if (NULL != root_ptr) {
+        BS_TEST_VERIFY_NEQ(test_ptr, 0, root_ptr->count);
+        size = _test_verify_node(test_ptr, tree_ptr, root_ptr, true,
+                                 NULL, NULL, 0);
+    } else {
+        BS_TEST_VERIFY_EQ(test_ptr, 0, tree_ptr->height);
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, bs_rcu_btree_size(tree_ptr), size);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, tree_ptr->replaced_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Inserts, looks up, overwrites and deletes a few keys. */
+void test_basic(bs_test_t *test_ptr)
+{
+    bs_epoch_t *epoch_ptr = bs_epoch_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, epoch_ptr);
+    bs_epoch_participant_t *p_ptr = bs_epoch_register(epoch_ptr);
+    bs_rcu_btree_t *tree_ptr = bs_rcu_btree_create(epoch_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, p_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, tree_ptr);
+
+    void *value_ptr = NULL;
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_rcu_btree_lookup(tree_ptr, p_ptr, 1, &value_ptr));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_rcu_btree_delete(tree_ptr, 1, NULL));
+
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_rcu_btree_insert(tree_ptr, 1, "one", false));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_rcu_btree_insert(tree_ptr, 2, "two", false));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_rcu_btree_insert(tree_ptr, 1, "x", false));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_rcu_btree_insert(tree_ptr, UINT64_MAX, "max", false));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_rcu_btree_size(tree_ptr));
+
+    // Lookups nest within an outer critical section.
+    bs_epoch_enter(p_ptr);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_rcu_btree_lookup(tree_ptr, p_ptr, 1, &value_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, "one", value_ptr);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_rcu_btree_lookup(tree_ptr, p_ptr, UINT64_MAX, NULL));
+    bs_epoch_leave(p_ptr);
+
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_rcu_btree_insert(tree_ptr, 1, "uno", true));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_rcu_btree_lookup(tree_ptr, p_ptr, 1, &value_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, "uno", value_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_rcu_btree_size(tree_ptr));
+
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_rcu_btree_delete(tree_ptr, 2, &value_ptr));
+    BS_TEST_VERIFY_STREQ(test_ptr, "two", value_ptr);
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_rcu_btree_lookup(tree_ptr, p_ptr, 2, NULL));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, bs_rcu_btree_size(tree_ptr));
+    _test_verify(test_ptr, tree_ptr);
+
+    bs_rcu_btree_destroy(tree_ptr);
+    bs_epoch_unregister(p_ptr);
+    bs_epoch_destroy(epoch_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Random inserts and deletes, verified against a bitmap. */
+void test_random(bs_test_t *test_ptr)
+{
+    bs_epoch_t *epoch_ptr = bs_epoch_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, epoch_ptr);
+    bs_epoch_participant_t *p_ptr = bs_epoch_register(epoch_ptr);
+    bs_rcu_btree_t *tree_ptr = bs_rcu_btree_create(epoch_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, p_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, tree_ptr);
+
+    bool present[4096] = {};
+    size_t size = 0;
+    uint32_t seed = 1;
+    for (int i = 0; i < 40000; ++i) {
+        seed = seed * 1664525 + 1013904223;
+        uint64_t k = (seed >> 8) % 4096;
+        // Grows first, then shrinks: Exercises splits, then merges.
+        bool insert = (seed >> 30) < (i < 20000 ? 3u : 1u);
+        if (insert) {
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, !present[k],
+                bs_rcu_btree_insert(tree_ptr, k, (void*)(uintptr_t)k, false));
+            if (!present[k]) ++size;
+            present[k] = true;
+        } else {
+            void *value_ptr = NULL;
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, present[k],
+                bs_rcu_btree_delete(tree_ptr, k, &value_ptr));
+            if (present[k]) {
+                BS_TEST_VERIFY_EQ_OR_RETURN(
+                    test_ptr, (void*)(uintptr_t)k, value_ptr);
+                --size;
+            }
+            present[k] = false;
+        }
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, size, bs_rcu_btree_size(tree_ptr));
+        if (0 == i % 1000) _test_verify(test_ptr, tree_ptr);
+    }
+    _test_verify(test_ptr, tree_ptr);
+
+    for (uint64_t k = 0; k < 4096; ++k) {
+        void *value_ptr = NULL;
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, present[k],
+            bs_rcu_btree_lookup(tree_ptr, p_ptr, k, &value_ptr));
+        if (present[k]) {
+            BS_TEST_VERIFY_EQ(test_ptr, (void*)(uintptr_t)k, value_ptr);
+        }
+    }
+
+    // Deletes all remaining, down to an empty tree.
+    for (uint64_t k = 0; k < 4096; ++k) {
+        if (present[k]) bs_rcu_btree_delete(tree_ptr, k, NULL);
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_rcu_btree_size(tree_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, bs_atomic_ptr_get(&tree_ptr->root));
+    _test_verify(test_ptr, tree_ptr);
+
+    bs_rcu_btree_destroy(tree_ptr);
+    bs_epoch_unregister(p_ptr);
+    bs_epoch_destroy(epoch_ptr);
+}
+
+/** Argument for @ref _test_scan_fn. */
+typedef struct {
+    /** Expected next key. */
+    uint64_t                  expected;
+    /** Number of keys to accept. */
+    size_t                    limit;
+    /** Optionally, a tree to delete the next key from, while scanning. */
+    bs_rcu_btree_t            *tree_ptr;
+    /** Number of mismatches. */
+    int                       mismatches;
+} _test_scan_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Verifies keys arrive in order, at a stride of 2. */
+static bool _test_scan_fn(uint64_t key, void *value_ptr, void *ud_ptr)
+{
+    _test_scan_arg_t *arg_ptr = ud_ptr;
+    if (key != arg_ptr->expected ||
+        value_ptr != (void*)(uintptr_t)(key + 1)) arg_ptr->mismatches++;
+    arg_ptr->expected = key + 2;
+    if (NULL != arg_ptr->tree_ptr) {
+        bs_rcu_btree_delete(arg_ptr->tree_ptr, key + 2, NULL);
+    }
+    return 0 < --arg_ptr->limit;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Scans from keys and between keys, and from a snapshot. */
+void test_scan(bs_test_t *test_ptr)
+{
+    bs_epoch_t *epoch_ptr = bs_epoch_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, epoch_ptr);
+    bs_epoch_participant_t *p_ptr = bs_epoch_register(epoch_ptr);
+    bs_rcu_btree_t *tree_ptr = bs_rcu_btree_create(epoch_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, p_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, tree_ptr);
+
+    _test_scan_arg_t arg = { .limit = 1 };
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_rcu_btree_scan(
+                          tree_ptr, p_ptr, 0, _test_scan_fn, &arg));
+
+    // Even keys 0, 2, ... 3998: Enough for 3 levels.
+    const uint64_t n = 2000;
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t k = ((i * 7919) % n) * 2;
+        BS_TEST_VERIFY_TRUE_OR_RETURN(
+            test_ptr, bs_rcu_btree_insert(
+                tree_ptr, k, (void*)(uintptr_t)(k + 1), false));
+    }
+    _test_verify(test_ptr, tree_ptr);
+
+    for (uint64_t k = 0; k < 2 * n + 2; k += 3) {
+        arg = (_test_scan_arg_t){ .expected = (k + 1) & ~1, .limit = 50 };
+        size_t count = bs_rcu_btree_scan(
+            tree_ptr, p_ptr, k, _test_scan_fn, &arg);
+        size_t remaining = k < 2 * n - 1 ? n - (k + 1) / 2 : 0;
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, BS_MIN(remaining, (size_t)50), count);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 0, arg.mismatches);
+    }
+
+    // Deleting the next key during the scan: The scan still sees it.
+    arg = (_test_scan_arg_t){ .limit = 2 * n, .tree_ptr = tree_ptr };
+    BS_TEST_VERIFY_EQ(test_ptr, n, bs_rcu_btree_scan(
+                          tree_ptr, p_ptr, 0, _test_scan_fn, &arg));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, arg.mismatches);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_rcu_btree_size(tree_ptr));
+    _test_verify(test_ptr, tree_ptr);
+
+    bs_rcu_btree_destroy(tree_ptr);
+    bs_epoch_unregister(p_ptr);
+    bs_epoch_destroy(epoch_ptr);
+}
+
+/** Number of reader threads in the concurrent test. */
+#define _TEST_READERS         4
+/** Keys in the concurrent test: Even keys stay, odd keys come and go. */
+#define _TEST_KEYS            2048
+
+/** State shared by the threads of the concurrent test. */
+typedef struct {
+    /** The domain. */
+    bs_epoch_t                *epoch_ptr;
+    /** The tree. */
+    bs_rcu_btree_t            *tree_ptr;
+    /** Set to non-zero to terminate the readers. */
+    bs_atomic_int32_t         stop;
+    /** Number of reads that found a wrong state. */
+    bs_atomic_int32_t         failures;
+} _test_shared_t;
+
+/** Progress of a scan in the concurrent test. */
+typedef struct {
+    /** The next even key: All of them must be seen. */
+    uint64_t                  next_even;
+    /** Set if a key was out of order, or had a wrong value. */
+    bool                      bad;
+} _test_concurrent_scan_t;
+
+/* ------------------------------------------------------------------------- */
+/** Verifies all even keys are seen, and odd keys only in between. */
+static bool _test_concurrent_scan_fn(uint64_t key,
+                                     void *value_ptr,
+                                     void *ud_ptr)
+{
+    _test_concurrent_scan_t *scan_ptr = ud_ptr;
+    bool in_order = (key & 1) ?
+        key + 1 == scan_ptr->next_even : key == scan_ptr->next_even;
+    if (!in_order || value_ptr != (void*)(uintptr_t)(key + 1)) {
+        scan_ptr->bad = true;
+        return false;
+    }
+    if (0 == (key & 1)) scan_ptr->next_even += 2;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Reader thread: Looks up and scans keys until stopped. */
+static void *_test_concurrent_reader(void *arg_ptr)
+{
+    _test_shared_t *shared_ptr = arg_ptr;
+    bs_epoch_participant_t *p_ptr = bs_epoch_register(shared_ptr->epoch_ptr);
+    if (NULL == p_ptr) {
+        bs_atomic_int32_add(&shared_ptr->failures, 1);
+        return NULL;
+    }
+
+    uint32_t seed = (uint32_t)(uintptr_t)p_ptr;
+    while (0 == bs_atomic_int32_get(&shared_ptr->stop)) {
+        for (int i = 0; i < 100; ++i) {
+            seed = seed * 1664525 + 1013904223;
+            uint64_t key = (seed >> 8) % _TEST_KEYS;
+            void *value_ptr = NULL;
+            bool found = bs_rcu_btree_lookup(
+                shared_ptr->tree_ptr, p_ptr, key, &value_ptr);
+            if ((0 == (key & 1) && !found) ||
+                (found && value_ptr != (void*)(uintptr_t)(key + 1))) {
+                bs_atomic_int32_add(&shared_ptr->failures, 1);
+            }
+        }
+
+        _test_concurrent_scan_t scan = {};
+        bs_rcu_btree_scan(shared_ptr->tree_ptr, p_ptr, 0,
+                          _test_concurrent_scan_fn, &scan);
+        if (scan.bad || _TEST_KEYS != scan.next_even) {
+            bs_atomic_int32_add(&shared_ptr->failures, 1);
+        }
+    }
+    bs_epoch_unregister(p_ptr);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Readers look up keys while a writer inserts and deletes others. */
+void test_concurrent(bs_test_t *test_ptr)
+{
+    _test_shared_t shared = {
+        .stop = BS_ATOMIC_INT32_INIT(0),
+        .failures = BS_ATOMIC_INT32_INIT(0) };
+    shared.epoch_ptr = bs_epoch_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, shared.epoch_ptr);
+    shared.tree_ptr = bs_rcu_btree_create(shared.epoch_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, shared.tree_ptr);
+    for (uint64_t k = 0; k < _TEST_KEYS; k += 2) {
+        BS_TEST_VERIFY_TRUE_OR_RETURN(
+            test_ptr, bs_rcu_btree_insert(
+                shared.tree_ptr, k, (void*)(uintptr_t)(k + 1), false));
+    }
+
+    pthread_t threads[_TEST_READERS];
+    for (int t = 0; t < _TEST_READERS; ++t) {
+        BS_TEST_VERIFY_EQ_OR_RETURN(
+            test_ptr, 0,
+            pthread_create(&threads[t], NULL, _test_concurrent_reader,
+                           &shared));
+    }
+
+    uint32_t seed = 1;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1664525 + 1013904223;
+        uint64_t key = (seed >> 8) % _TEST_KEYS;
+        void *value_ptr = (void*)(uintptr_t)(key + 1);
+        if (key & 1) {
+            if (!bs_rcu_btree_delete(shared.tree_ptr, key, NULL)) {
+                bs_rcu_btree_insert(shared.tree_ptr, key, value_ptr, false);
+            }
+        } else {
+            bs_rcu_btree_insert(shared.tree_ptr, key, value_ptr, true);
+        }
+        if (0 == i % 64) sched_yield();
+    }
+
+    bs_atomic_int32_set(&shared.stop, 1);
+    for (int t = 0; t < _TEST_READERS; ++t) pthread_join(threads[t], NULL);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_atomic_int32_get(&shared.failures));
+    _test_verify(test_ptr, shared.tree_ptr);
+
+    bs_rcu_btree_destroy(shared.tree_ptr);
+    bs_epoch_destroy(shared.epoch_ptr);
+}
+
+/** @endcond */
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_readers_rcu_btree(bs_test_t *test_ptr);
+static void benchmark_readers_avltree(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t          bs_rcu_btree_benchmarks[] = {
+    { 1, "benchmark-readers-rcu_btree", benchmark_readers_rcu_btree },
+    { 1, "benchmark-readers-avltree", benchmark_readers_avltree },
+    { 0, NULL, NULL }
+};
+
+/** Number of keys in the benchmarks' maps. */
+#define _BENCHMARK_KEYS       (1 << 20)
+/** Reader thread counts to benchmark: 1, 2, 4 ... 32. */
+#define _BENCHMARK_RUNS       6
+/** Maximum number of reader threads. */
+#define _BENCHMARK_MAX_READERS (1 << (_BENCHMARK_RUNS - 1))
+
+/** An element of the AVL tree. */
+typedef struct {
+    /** The tree node. */
+    bs_avltree_node_t         avlnode;
+    /** The key. */
+    uint64_t                  key;
+} _benchmark_elem_t;
+
+/** The map: RCU B-tree, or AVL tree with a mutex. */
+typedef struct {
+    /** Whether to use the RCU B-tree, rather than the AVL tree. */
+    bool                      rcu;
+    /** The keys, in random order. */
+    uint64_t                  *keys_ptr;
+    /** Elements of the AVL tree. */
+    _benchmark_elem_t         *elems_ptr;
+    /** The AVL tree. */
+    bs_avltree_t              *avltree_ptr;
+    /** Guards `avltree_ptr`. */
+    pthread_mutex_t           mutex;
+    /** The epoch domain for `rcu_btree_ptr`. */
+    bs_epoch_t                *epoch_ptr;
+    /** The RCU B-tree. */
+    bs_rcu_btree_t            *rcu_btree_ptr;
+} _benchmark_maps_t;
+
+/** Argument for the benchmark threads. */
+typedef struct {
+    /** The maps. */
+    _benchmark_maps_t         *maps_ptr;
+    /** Set to non-zero to terminate. */
+    bs_atomic_int32_t         *stop_ptr;
+    /** Position in `keys_ptr` to start at. */
+    size_t                    pos;
+    /** Number of lookups, or updates, this thread did. */
+    uint64_t                  operations;
+} _benchmark_arg_t;
+
+/* ------------------------------------------------------------------------- */
+static int _benchmark_avltree_cmp(const bs_avltree_node_t *node_ptr,
+                                  const void *key_ptr)
+{
+    const _benchmark_elem_t *elem_ptr = BS_CONTAINER_OF(
+        node_ptr, const _benchmark_elem_t, avlnode);
+    uint64_t key = *(const uint64_t*)key_ptr;
+    return (elem_ptr->key > key) - (elem_ptr->key < key);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Creates the map, with @ref _BENCHMARK_KEYS random keys. */
+static bool _benchmark_maps_init(_benchmark_maps_t *m_ptr, bool rcu)
+{
+    *m_ptr = (_benchmark_maps_t){ .rcu = rcu };
+    if (!bs_mutex_init(&m_ptr->mutex)) return false;
+    m_ptr->keys_ptr = logged_calloc(_BENCHMARK_KEYS, sizeof(uint64_t));
+    m_ptr->elems_ptr = logged_calloc(_BENCHMARK_KEYS,
+                                     sizeof(_benchmark_elem_t));
+    if (NULL == m_ptr->keys_ptr || NULL == m_ptr->elems_ptr) return false;
+    if (rcu) {
+        m_ptr->epoch_ptr = bs_epoch_create();
+        if (NULL == m_ptr->epoch_ptr) return false;
+        m_ptr->rcu_btree_ptr = bs_rcu_btree_create(m_ptr->epoch_ptr);
+        if (NULL == m_ptr->rcu_btree_ptr) return false;
+    } else {
+        m_ptr->avltree_ptr = bs_avltree_create(_benchmark_avltree_cmp, NULL);
+        if (NULL == m_ptr->avltree_ptr) return false;
+    }
+
+    uint64_t seed = 1;
+    for (size_t i = 0; i < _BENCHMARK_KEYS; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        m_ptr->keys_ptr[i] = seed;
+        m_ptr->elems_ptr[i].key = seed;
+        if (rcu ?
+            !bs_rcu_btree_insert(m_ptr->rcu_btree_ptr, seed, NULL, false) :
+            !bs_avltree_insert(m_ptr->avltree_ptr, &m_ptr->elems_ptr[i].key,
+                               &m_ptr->elems_ptr[i].avlnode, false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Releases what @ref _benchmark_maps_init created. */
+static void _benchmark_maps_fini(_benchmark_maps_t *m_ptr)
+{
+    if (NULL != m_ptr->rcu_btree_ptr) {
+        bs_rcu_btree_destroy(m_ptr->rcu_btree_ptr);
+    }
+    if (NULL != m_ptr->epoch_ptr) bs_epoch_destroy(m_ptr->epoch_ptr);
+    if (NULL != m_ptr->avltree_ptr) bs_avltree_destroy(m_ptr->avltree_ptr);
+    logged_free(m_ptr->elems_ptr);
+    logged_free(m_ptr->keys_ptr);
+    bs_mutex_destroy(&m_ptr->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Reader thread: Looks up keys until told to stop. */
+static void *_benchmark_reader(void *arg_ptr)
+{
+    _benchmark_arg_t *barg_ptr = arg_ptr;
+    _benchmark_maps_t *m_ptr = barg_ptr->maps_ptr;
+    bs_epoch_participant_t *p_ptr = NULL;
+    if (m_ptr->rcu) {
+        p_ptr = bs_epoch_register(m_ptr->epoch_ptr);
+        if (NULL == p_ptr) return NULL;
+    }
+
+    size_t pos = barg_ptr->pos;
+    while (0 == bs_atomic_int32_get(barg_ptr->stop_ptr)) {
+        for (int i = 0; i < 100; ++i) {
+            uint64_t key = m_ptr->keys_ptr[pos++ & (_BENCHMARK_KEYS - 1)];
+            bool found;
+            if (m_ptr->rcu) {
+                found = bs_rcu_btree_lookup(
+                    m_ptr->rcu_btree_ptr, p_ptr, key, NULL);
+            } else {
+                bs_mutex_lock(&m_ptr->mutex);
+                found = NULL != bs_avltree_lookup(m_ptr->avltree_ptr, &key);
+                bs_mutex_unlock(&m_ptr->mutex);
+            }
+            BS_TEST_DO_NOT_OPTIMIZE(found);
+        }
+        barg_ptr->operations += 100;
+    }
+    if (NULL != p_ptr) bs_epoch_unregister(p_ptr);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Writer thread: Replaces a key about every 100us, until told to stop. */
+static void *_benchmark_writer(void *arg_ptr)
+{
+    _benchmark_arg_t *barg_ptr = arg_ptr;
+    _benchmark_maps_t *m_ptr = barg_ptr->maps_ptr;
+    size_t pos = barg_ptr->pos;
+    while (0 == bs_atomic_int32_get(barg_ptr->stop_ptr)) {
+        _benchmark_elem_t *elem_ptr =
+            &m_ptr->elems_ptr[pos++ & (_BENCHMARK_KEYS - 1)];
+        if (m_ptr->rcu) {
+            bs_rcu_btree_insert(m_ptr->rcu_btree_ptr, elem_ptr->key,
+                                elem_ptr, true);
+        } else {
+            bs_mutex_lock(&m_ptr->mutex);
+            bs_avltree_delete(m_ptr->avltree_ptr, &elem_ptr->key);
+            bs_avltree_insert(m_ptr->avltree_ptr, &elem_ptr->key,
+                              &elem_ptr->avlnode, false);
+            bs_mutex_unlock(&m_ptr->mutex);
+        }
+        barg_ptr->operations++;
+        usleep(100);
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs 1, 2, 4 ... 32 readers next to one writer, each for a sixth of the
+ * benchmark duration, and reports the lookup rate for each reader count.
+ */
+static void _benchmark_scaling(bs_test_t *test_ptr,
+                               _benchmark_maps_t *m_ptr)
+{
+    _benchmark_arg_t          bargs[_BENCHMARK_MAX_READERS + 1];
+    pthread_t                 threads[_BENCHMARK_MAX_READERS + 1];
+    double                    rates[_BENCHMARK_RUNS];
+    uint64_t                  writes = 0;
+
+    for (int run = 0; run < _BENCHMARK_RUNS; ++run) {
+        int num_readers = 1 << run;
+        bs_atomic_int32_t stop = BS_ATOMIC_INT32_INIT(0);
+        for (int t = 0; t <= num_readers; ++t) {
+            bargs[t] = (_benchmark_arg_t){
+                .maps_ptr = m_ptr, .stop_ptr = &stop,
+                .pos = (size_t)t * (_BENCHMARK_KEYS / _BENCHMARK_MAX_READERS) };
+            BS_TEST_VERIFY_EQ_OR_RETURN(
+                test_ptr, 0,
+                pthread_create(&threads[t], NULL,
+                               0 == t ? _benchmark_writer : _benchmark_reader,
+                               &bargs[t]));
+        }
+        uint64_t usec = bs_usec();
+        while (usec + benchmark_duration / _BENCHMARK_RUNS >= bs_usec()) {
+            usleep(10000);
+        }
+        bs_atomic_int32_set(&stop, 1);
+        uint64_t lookups = 0;
+        for (int t = 0; t <= num_readers; ++t) {
+            pthread_join(threads[t], NULL);
+            if (0 < t) lookups += bargs[t].operations;
+        }
+        writes += bargs[0].operations;
+        usec = bs_usec() - usec;
+        rates[run] = (double)lookups / (usec * 1e-6);
+    }
+
+    bs_test_succeed(
+        test_ptr, "%.3e, %.3e, %.3e, %.3e, %.3e, %.3e lookups/sec at "
+        "1, 2, 4, 8, 16, 32 readers; %"PRIu64" writes",
+        rates[0], rates[1], rates[2], rates[3], rates[4], rates[5], writes);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Creates the map, and runs @ref _benchmark_scaling on it. */
+static void _benchmark_readers(bs_test_t *test_ptr, bool rcu)
+{
+    _benchmark_maps_t maps;
+    if (!_benchmark_maps_init(&maps, rcu)) {
+        BS_TEST_FAIL(test_ptr, "Failed _benchmark_maps_init()");
+    } else {
+        _benchmark_scaling(test_ptr, &maps);
+    }
+    _benchmark_maps_fini(&maps);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Lookups on a 1M-key @ref bs_rcu_btree_t, while a writer replaces keys. */
+void benchmark_readers_rcu_btree(bs_test_t *test_ptr)
+{
+    _benchmark_readers(test_ptr, true);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Same, on a @ref bs_avltree_t guarded by a mutex, as baseline. */
+void benchmark_readers_avltree(bs_test_t *test_ptr)
+{
+    _benchmark_readers(test_ptr, false);
+}
+
+/* == End of rcu_btree.c =================================================== */
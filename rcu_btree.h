@@ -0,0 +1,173 @@
+/* ========================================================================= */
+/**
+ * @file rcu_btree.h
+ * A B-tree mapping 64-bit keys to values, for many concurrent readers and a
+ * single writer at a time.
+ *
+ * Readers take no lock: @ref bs_rcu_btree_lookup and @ref bs_rcu_btree_scan
+ * run within a critical section of @ref bs_epoch_t, and never wait for the
+ * writer nor for each other. Writers are serialized by a mutex, and update
+ * the tree by copy-on-write: Each node on the path is copied, modified, and
+ * the new root is published atomically. Readers see either the tree before
+ * or after the update, never a partial one. Replaced nodes are retired to
+ * the epoch domain, and freed once no reader can reference them.
+ *
+ * Keys are compared as unsigned integers. Values are not owned by the tree.
+ * The node layout follows @ref bs_btree_t, so lookups cost about the same.
+ * Each update copies one node of up to @ref BS_BTREE_MAX_KEYS keys per
+ * level, so the tree suits read-mostly use.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_RCU_BTREE_H__
+#define __LIBBASE_RCU_BTREE_H__
+
+#include "btree.h"
+#include "epoch.h"
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Forward declaration: The tree. */
+typedef struct _bs_rcu_btree_t bs_rcu_btree_t;
+
+/**
+ * Callback for @ref bs_rcu_btree_scan.
+ *
+ * @param key
+ * @param value_ptr
+ * @param ud_ptr
+ *
+ * @return true to continue the scan, false to stop.
+ */
+typedef bool (*bs_rcu_btree_scan_fn_t)(uint64_t key,
+                                       void *value_ptr,
+                                       void *ud_ptr);
+
+/**
+ * Creates a tree.
+ *
+ * @param epoch_ptr           Epoch domain for reclaiming replaced nodes.
+ *     Readers must be participants of the same domain. Must outlive the
+ *     tree.
+ *
+ * @return A pointer to the tree, or NULL on error. Must be destroyed by
+ *     @ref bs_rcu_btree_destroy.
+ */
+bs_rcu_btree_t *bs_rcu_btree_create(bs_epoch_t *epoch_ptr);
+
+/**
+ * Destroys the tree. There must be no concurrent readers or writers.
+ *
+ * @param tree_ptr
+ */
+void bs_rcu_btree_destroy(bs_rcu_btree_t *tree_ptr);
+
+/**
+ * Inserts `key` into the tree, mapped to `value_ptr`. Blocks other writers,
+ * but not readers.
+ *
+ * @param tree_ptr
+ * @param key
+ * @param value_ptr
+ * @param do_overwrite        Whether to overwrite an already-existing `key`.
+ *
+ * @return Whether the insert succeeded. It fails if `do_overwrite` is false
+ *     and `key` already exists, or on allocation failure. On failure, the
+ *     tree is unchanged.
+ */
+bool bs_rcu_btree_insert(bs_rcu_btree_t *tree_ptr,
+                         uint64_t key,
+                         void *value_ptr,
+                         bool do_overwrite);
+
+/**
+ * Deletes `key` from the tree. Blocks other writers, but not readers.
+ *
+ * Readers that already looked up `key` may still use the value: Reclaiming
+ * it is up to the caller, eg. through @ref bs_epoch_retire.
+ *
+ * @param tree_ptr
+ * @param key
+ * @param value_ptr_ptr       Optional. Stores the value, if found.
+ *
+ * @return Whether `key` was found and deleted. Also false on allocation
+ *     failure, with the tree unchanged.
+ */
+bool bs_rcu_btree_delete(bs_rcu_btree_t *tree_ptr,
+                         uint64_t key,
+                         void **value_ptr_ptr);
+
+/**
+ * Looks up `key` in the tree. Lock-free, safe against concurrent writers.
+ *
+ * @param tree_ptr
+ * @param participant_ptr     The calling thread's participant of the epoch
+ *     domain. May already be within a critical section.
+ * @param key
+ * @param value_ptr_ptr       Optional. Stores the value, if found.
+ *
+ * @return Whether `key` was found.
+ */
+bool bs_rcu_btree_lookup(bs_rcu_btree_t *tree_ptr,
+                         bs_epoch_participant_t *participant_ptr,
+                         uint64_t key,
+                         void **value_ptr_ptr);
+
+/**
+ * Calls `fn` on keys not less than `key`, in ascending order, until it
+ * returns false. Lock-free, safe against concurrent writers: The scan sees
+ * a consistent snapshot of the tree.
+ *
+ * `fn` is called within a critical section, and must not call
+ * @ref bs_epoch_synchronize. It may write to the tree: The scan does not
+ * see these writes.
+ *
+ * @param tree_ptr
+ * @param participant_ptr
+ * @param key
+ * @param fn
+ * @param ud_ptr
+ *
+ * @return Number of keys `fn` was called for.
+ */
+size_t bs_rcu_btree_scan(bs_rcu_btree_t *tree_ptr,
+                         bs_epoch_participant_t *participant_ptr,
+                         uint64_t key,
+                         bs_rcu_btree_scan_fn_t fn,
+                         void *ud_ptr);
+
+/** Returns the number of keys in the tree. */
+size_t bs_rcu_btree_size(bs_rcu_btree_t *tree_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_rcu_btree_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_rcu_btree_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_RCU_BTREE_H__ */
+/* == End of rcu_btree.h =================================================== */
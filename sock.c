@@ -20,6 +20,7 @@
 
 #include "def.h"
 #include "log.h"
+#include "log_wrappers.h"
 #include "sock.h"
 #include "time.h"
 
@@ -28,8 +29,77 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <poll.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+
+/* == Declarations ========================================================= */
+
+/** A ring buffer, for @ref bs_sock_reader_t and @ref bs_sock_writer_t. */
+typedef struct {
+    /** The buffer. */
+    uint8_t                   *buf_ptr;
+    /** Capacity of `buf_ptr`, in bytes. */
+    size_t                    capacity;
+    /** Position of the first byte of data within `buf_ptr`. */
+    size_t                    pos;
+    /** Number of bytes of data. */
+    size_t                    size;
+} bs_sock_ring_t;
+
+/** State of the buffered reader. */
+struct _bs_sock_reader_t {
+    /** File descriptor to read from. */
+    int                       fd;
+    /** Buffered data. */
+    bs_sock_ring_t            ring;
+};
+
+/** State of the buffered writer. */
+struct _bs_sock_writer_t {
+    /** File descriptor to write to. */
+    int                       fd;
+    /** Buffered data, not yet written. */
+    bs_sock_ring_t            ring;
+};
+
+#if !defined(IOV_MAX)
+/** Limit of iovecs per writev(2), if not declared without _XOPEN_SOURCE. */
+#define IOV_MAX 1024
+#endif  // !defined(IOV_MAX)
+
+/** Default capacity of the buffers. */
+static const size_t           bs_sock_default_capacity = 65536;
+
+static bool bs_sock_ring_init(bs_sock_ring_t *ring_ptr, size_t capacity);
+static int bs_sock_ring_data_iov(const bs_sock_ring_t *ring_ptr,
+                                 struct iovec *iov_ptr);
+static int bs_sock_ring_space_iov(const bs_sock_ring_t *ring_ptr,
+                                  struct iovec *iov_ptr);
+static void bs_sock_ring_consume(bs_sock_ring_t *ring_ptr, size_t count);
+static void bs_sock_ring_copy_out(const bs_sock_ring_t *ring_ptr,
+                                  void *buf_ptr,
+                                  size_t count);
+static void bs_sock_ring_copy_in(bs_sock_ring_t *ring_ptr,
+                                 const void *buf_ptr,
+                                 size_t count);
+
+static int bs_sock_poll(int fd, short events, int msec);
+static uint64_t bs_sock_deadline_nsec(int msec);
+static int bs_sock_remaining_msec(uint64_t deadline_nsec, int msec);
+static size_t bs_sock_iov_size(const struct iovec *iov_ptr, int iovcnt);
+static void bs_sock_iov_advance(struct iovec **iov_ptr_ptr,
+                                int *iovcnt_ptr,
+                                size_t count);
+static bool bs_sock_writer_write_iov(bs_sock_writer_t *writer_ptr,
+                                     struct iovec *iov_ptr,
+                                     int iovcnt,
+                                     size_t ring_bytes,
+                                     bool buffer_rest,
+                                     int msec);
 
 /* == Methods ============================================================== */
 
@@ -145,4 +215,587 @@ ssize_t bs_sock_read(int fd, void *buf_ptr, size_t count, int msec)
     return consumed_bytes;
 }
 
+/* ------------------------------------------------------------------------- */
+bs_sock_reader_t *bs_sock_reader_create(int fd, size_t capacity)
+{
+    bs_sock_reader_t *reader_ptr = logged_calloc(1, sizeof(bs_sock_reader_t));
+    if (NULL == reader_ptr) return NULL;
+    reader_ptr->fd = fd;
+    if (!bs_sock_ring_init(&reader_ptr->ring, capacity)) {
+        bs_sock_reader_destroy(reader_ptr);
+        return NULL;
+    }
+    return reader_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_sock_reader_destroy(bs_sock_reader_t *reader_ptr)
+{
+    if (NULL != reader_ptr->ring.buf_ptr) logged_free(reader_ptr->ring.buf_ptr);
+    logged_free(reader_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_sock_reader_buffered(const bs_sock_reader_t *reader_ptr)
+{
+    return reader_ptr->ring.size;
+}
+
+/* ------------------------------------------------------------------------- */
+ssize_t bs_sock_reader_fill(bs_sock_reader_t *reader_ptr, int msec)
+{
+    struct iovec              iov[2];
+    ssize_t                   read_bytes;
+    int                       rv;
+
+    if (reader_ptr->ring.size >= reader_ptr->ring.capacity) return 0;
+
+    rv = bs_sock_poll(reader_ptr->fd, POLLIN, msec);
+    if (0 >= rv) return rv;
+
+    // A single readv(2) fills all free space, also across the wrap-around.
+    int iovcnt = bs_sock_ring_space_iov(&reader_ptr->ring, iov);
+    do {
+        read_bytes = readv(reader_ptr->fd, iov, iovcnt);
+    } while (0 > read_bytes && EINTR == errno);
+
+    if (0 == read_bytes) {
+        /* connection was closed, return prescribed error. */
+        errno = EPIPE;
+        return -1;
+    }
+    if (0 > read_bytes) {
+        if (EAGAIN == errno || EWOULDBLOCK == errno) return 0;
+        rv = errno;
+        bs_log(BS_ERROR | BS_ERRNO, "Failed readv(%d, %p, %d)",
+               reader_ptr->fd, iov, iovcnt);
+        errno = rv;
+        return -1;
+    }
+    reader_ptr->ring.size += read_bytes;
+    return read_bytes;
+}
+
+/* ------------------------------------------------------------------------- */
+ssize_t bs_sock_reader_read(bs_sock_reader_t *reader_ptr,
+                            void *buf_ptr,
+                            size_t count,
+                            int msec)
+{
+    if (INT32_MAX < count) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (0 >= count) return 0;
+
+    if (0 == reader_ptr->ring.size) {
+        ssize_t rv = bs_sock_reader_fill(reader_ptr, msec);
+        if (0 >= rv) return rv;
+    }
+
+    count = BS_MIN(count, reader_ptr->ring.size);
+    bs_sock_ring_copy_out(&reader_ptr->ring, buf_ptr, count);
+    bs_sock_ring_consume(&reader_ptr->ring, count);
+    return count;
+}
+
+/* ------------------------------------------------------------------------- */
+ssize_t bs_sock_reader_read_until(bs_sock_reader_t *reader_ptr,
+                                  char delim,
+                                  char *buf_ptr,
+                                  size_t size,
+                                  int msec)
+{
+    uint64_t deadline_nsec = bs_sock_deadline_nsec(msec);
+    bs_sock_ring_t *ring_ptr = &reader_ptr->ring;
+    struct iovec iov[2];
+    size_t scanned = 0;
+
+    if (INT32_MAX < size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (;;) {
+        // Scans only the data that arrived since the last iteration.
+        int iovcnt = bs_sock_ring_data_iov(ring_ptr, iov);
+        size_t offset = 0;
+        for (int i = 0; i < iovcnt; offset += iov[i++].iov_len) {
+            if (scanned >= offset + iov[i].iov_len) continue;
+            size_t skip = scanned > offset ? scanned - offset : 0;
+            const uint8_t *delim_ptr = memchr(
+                (uint8_t*)iov[i].iov_base + skip, delim,
+                iov[i].iov_len - skip);
+            if (NULL == delim_ptr) continue;
+
+            size_t len = offset + (delim_ptr - (uint8_t*)iov[i].iov_base) + 1;
+            if (len > size) {
+                errno = ENOBUFS;
+                return -1;
+            }
+            bs_sock_ring_copy_out(ring_ptr, buf_ptr, len);
+            bs_sock_ring_consume(ring_ptr, len);
+            if (len < size) buf_ptr[len] = '\0';
+            return len;
+        }
+        scanned = ring_ptr->size;
+
+        if (ring_ptr->size >= size || ring_ptr->size >= ring_ptr->capacity) {
+            errno = ENOBUFS;
+            return -1;
+        }
+        ssize_t rv = bs_sock_reader_fill(
+            reader_ptr, bs_sock_remaining_msec(deadline_nsec, msec));
+        if (0 >= rv) return rv;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+bs_sock_writer_t *bs_sock_writer_create(int fd, size_t capacity)
+{
+    bs_sock_writer_t *writer_ptr = logged_calloc(1, sizeof(bs_sock_writer_t));
+    if (NULL == writer_ptr) return NULL;
+    writer_ptr->fd = fd;
+    if (!bs_sock_ring_init(&writer_ptr->ring, capacity)) {
+        bs_sock_writer_destroy(writer_ptr);
+        return NULL;
+    }
+    return writer_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_sock_writer_destroy(bs_sock_writer_t *writer_ptr)
+{
+    if (NULL != writer_ptr->ring.buf_ptr) logged_free(writer_ptr->ring.buf_ptr);
+    logged_free(writer_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_sock_writer_pending(const bs_sock_writer_t *writer_ptr)
+{
+    return writer_ptr->ring.size;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_sock_writer_writev(bs_sock_writer_t *writer_ptr,
+                           const struct iovec *iov_ptr,
+                           int iovcnt,
+                           int msec)
+{
+    bs_sock_ring_t *ring_ptr = &writer_ptr->ring;
+    size_t size = bs_sock_iov_size(iov_ptr, iovcnt);
+    if (size <= ring_ptr->capacity - ring_ptr->size) {
+        for (int i = 0; i < iovcnt; ++i) {
+            bs_sock_ring_copy_in(ring_ptr, iov_ptr[i].iov_base,
+                                 iov_ptr[i].iov_len);
+        }
+        return true;
+    }
+
+    // Does not fit. Sends buffered and new data with the same writev(2).
+    struct iovec local_iov[18], *all_iov_ptr = local_iov;
+    if (16 < iovcnt) {
+        all_iov_ptr = logged_calloc(iovcnt + 2, sizeof(struct iovec));
+        if (NULL == all_iov_ptr) return false;
+    }
+    int ring_iovcnt = bs_sock_ring_data_iov(ring_ptr, all_iov_ptr);
+    memcpy(all_iov_ptr + ring_iovcnt, iov_ptr, iovcnt * sizeof(struct iovec));
+    bool rv = bs_sock_writer_write_iov(
+        writer_ptr, all_iov_ptr, ring_iovcnt + iovcnt, ring_ptr->size,
+        true, msec);
+    if (all_iov_ptr != local_iov) logged_free(all_iov_ptr);
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_sock_writer_write(bs_sock_writer_t *writer_ptr,
+                          const void *buf_ptr,
+                          size_t count,
+                          int msec)
+{
+    struct iovec iov = { .iov_base = (void*)buf_ptr, .iov_len = count };
+    return bs_sock_writer_writev(writer_ptr, &iov, 1, msec);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_sock_writer_flush(bs_sock_writer_t *writer_ptr, int msec)
+{
+    struct iovec iov[2];
+    int iovcnt = bs_sock_ring_data_iov(&writer_ptr->ring, iov);
+    return bs_sock_writer_write_iov(
+        writer_ptr, iov, iovcnt, writer_ptr->ring.size, false, msec);
+}
+
+/* == Local methods ======================================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Allocates the ring's buffer. A `capacity` of 0 picks the default. */
+bool bs_sock_ring_init(bs_sock_ring_t *ring_ptr, size_t capacity)
+{
+    if (0 == capacity) capacity = bs_sock_default_capacity;
+    ring_ptr->buf_ptr = logged_malloc(capacity);
+    if (NULL == ring_ptr->buf_ptr) return false;
+    ring_ptr->capacity = capacity;
+    ring_ptr->pos = 0;
+    ring_ptr->size = 0;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Sets up to two iovecs, covering the ring's data. Returns their count. */
+int bs_sock_ring_data_iov(const bs_sock_ring_t *ring_ptr,
+                          struct iovec *iov_ptr)
+{
+    if (0 == ring_ptr->size) return 0;
+    size_t first = BS_MIN(ring_ptr->size, ring_ptr->capacity - ring_ptr->pos);
+    iov_ptr[0].iov_base = ring_ptr->buf_ptr + ring_ptr->pos;
+    iov_ptr[0].iov_len = first;
+    if (first == ring_ptr->size) return 1;
+    iov_ptr[1].iov_base = ring_ptr->buf_ptr;
+    iov_ptr[1].iov_len = ring_ptr->size - first;
+    return 2;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Sets up to two iovecs, covering the free space. Returns their count. */
+int bs_sock_ring_space_iov(const bs_sock_ring_t *ring_ptr,
+                           struct iovec *iov_ptr)
+{
+    size_t space = ring_ptr->capacity - ring_ptr->size;
+    if (0 == space) return 0;
+    size_t end = (ring_ptr->pos + ring_ptr->size) % ring_ptr->capacity;
+    size_t first = BS_MIN(space, ring_ptr->capacity - end);
+    iov_ptr[0].iov_base = ring_ptr->buf_ptr + end;
+    iov_ptr[0].iov_len = first;
+    if (first == space) return 1;
+    iov_ptr[1].iov_base = ring_ptr->buf_ptr;
+    iov_ptr[1].iov_len = space - first;
+    return 2;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Drops `count` bytes from the front of the ring. */
+void bs_sock_ring_consume(bs_sock_ring_t *ring_ptr, size_t count)
+{
+    ring_ptr->size -= count;
+    // An empty ring restarts at the front, to keep data contiguous.
+    if (0 == ring_ptr->size) {
+        ring_ptr->pos = 0;
+    } else {
+        ring_ptr->pos = (ring_ptr->pos + count) % ring_ptr->capacity;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Copies `count` bytes from the front of the ring. Does not consume. */
+void bs_sock_ring_copy_out(const bs_sock_ring_t *ring_ptr,
+                           void *buf_ptr,
+                           size_t count)
+{
+    size_t first = BS_MIN(count, ring_ptr->capacity - ring_ptr->pos);
+    memcpy(buf_ptr, ring_ptr->buf_ptr + ring_ptr->pos, first);
+    memcpy((uint8_t*)buf_ptr + first, ring_ptr->buf_ptr, count - first);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Appends `count` bytes to the ring. They must fit. */
+void bs_sock_ring_copy_in(bs_sock_ring_t *ring_ptr,
+                          const void *buf_ptr,
+                          size_t count)
+{
+    size_t end = (ring_ptr->pos + ring_ptr->size) % ring_ptr->capacity;
+    size_t first = BS_MIN(count, ring_ptr->capacity - end);
+    memcpy(ring_ptr->buf_ptr + end, buf_ptr, first);
+    memcpy(ring_ptr->buf_ptr, (const uint8_t*)buf_ptr + first, count - first);
+    ring_ptr->size += count;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Waits up to `msec` for `events` on `fd`. Retries on EINTR.
+ *
+ * @return A positive value if ready, 0 on timeout, and a negative value on
+ * error. The error is logged, and errno is retained.
+ */
+int bs_sock_poll(int fd, short events, int msec)
+{
+    struct pollfd poll_fd = { .fd = fd, .events = events };
+    int rv;
+    do {
+        rv = poll(&poll_fd, 1, msec);
+    } while (0 > rv && EINTR == errno);
+    if (0 > rv) {
+        rv = errno;
+        bs_log(BS_ERROR | BS_ERRNO, "Failed poll(%d, 1, %d)", fd, msec);
+        errno = rv;
+        return -1;
+    }
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the deadline for a timeout of `msec`, if non-negative. */
+uint64_t bs_sock_deadline_nsec(int msec)
+{
+    if (0 > msec) return UINT64_MAX;
+    return bs_mono_nsec() + (uint64_t)msec * 1000000;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the milliseconds left until `deadline_nsec`, or -1 if infinite. */
+int bs_sock_remaining_msec(uint64_t deadline_nsec, int msec)
+{
+    if (0 > msec) return -1;
+    uint64_t now_nsec = bs_mono_nsec();
+    if (now_nsec >= deadline_nsec) return 0;
+    return BS_MIN((deadline_nsec - now_nsec + 999999) / 1000000,
+                  (uint64_t)INT32_MAX);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the total number of bytes in the iovec. */
+size_t bs_sock_iov_size(const struct iovec *iov_ptr, int iovcnt)
+{
+    size_t size = 0;
+    for (int i = 0; i < iovcnt; ++i) size += iov_ptr[i].iov_len;
+    return size;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Advances the iovec by `count` bytes, after a partial write. */
+void bs_sock_iov_advance(struct iovec **iov_ptr_ptr,
+                         int *iovcnt_ptr,
+                         size_t count)
+{
+    while (0 < *iovcnt_ptr && count >= (*iov_ptr_ptr)->iov_len) {
+        count -= (*iov_ptr_ptr)->iov_len;
+        ++*iov_ptr_ptr;
+        --*iovcnt_ptr;
+    }
+    if (0 < *iovcnt_ptr) {
+        (*iov_ptr_ptr)->iov_base = (uint8_t*)(*iov_ptr_ptr)->iov_base + count;
+        (*iov_ptr_ptr)->iov_len -= count;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Writes the iovec with writev(2), until done or timed out.
+ *
+ * @param writer_ptr
+ * @param iov_ptr             The iovec. Will be modified.
+ * @param iovcnt
+ * @param ring_bytes          Number of leading bytes of the iovec that are
+ *                            from the writer's ring. They get consumed as
+ *                            they are written.
+ * @param buffer_rest         Whether to buffer the remainder of the iovec,
+ *                            once the ring is written and the rest fits.
+ * @param msec
+ *
+ * @return true on success.
+ */
+bool bs_sock_writer_write_iov(bs_sock_writer_t *writer_ptr,
+                              struct iovec *iov_ptr,
+                              int iovcnt,
+                              size_t ring_bytes,
+                              bool buffer_rest,
+                              int msec)
+{
+    uint64_t deadline_nsec = bs_sock_deadline_nsec(msec);
+    bs_sock_ring_t *ring_ptr = &writer_ptr->ring;
+
+    while (0 < iovcnt) {
+        if (buffer_rest && 0 == ring_bytes &&
+            bs_sock_iov_size(iov_ptr, iovcnt) <= ring_ptr->capacity) {
+            for (int i = 0; i < iovcnt; ++i) {
+                bs_sock_ring_copy_in(ring_ptr, iov_ptr[i].iov_base,
+                                     iov_ptr[i].iov_len);
+            }
+            return true;
+        }
+
+        ssize_t written_bytes = writev(
+            writer_ptr->fd, iov_ptr, BS_MIN(iovcnt, IOV_MAX));
+        if (0 > written_bytes) {
+            if (EINTR == errno) continue;
+            if (EAGAIN != errno && EWOULDBLOCK != errno) {
+                int rv = errno;
+                bs_log(BS_ERROR | BS_ERRNO, "Failed writev(%d, %p, %d)",
+                       writer_ptr->fd, iov_ptr, iovcnt);
+                errno = rv;
+                return false;
+            }
+            int rv = bs_sock_poll(
+                writer_ptr->fd, POLLOUT,
+                bs_sock_remaining_msec(deadline_nsec, msec));
+            if (0 > rv) return false;
+            if (0 == rv) {
+                errno = ETIMEDOUT;
+                return false;
+            }
+            continue;
+        }
+
+        size_t from_ring = BS_MIN((size_t)written_bytes, ring_bytes);
+        bs_sock_ring_consume(ring_ptr, from_ring);
+        ring_bytes -= from_ring;
+        bs_sock_iov_advance(&iov_ptr, &iovcnt, written_bytes);
+    }
+    return true;
+}
+
+/* == Unit tests =========================================================== */
+/** @cond TEST */
+
+static void test_reader(bs_test_t *test_ptr);
+static void test_reader_read_until(bs_test_t *test_ptr);
+static void test_writer(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_sock_test_cases[] = {
+    { 1, "reader", test_reader },
+    { 1, "reader_read_until", test_reader_read_until },
+    { 1, "writer", test_writer },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Helper: Creates a connected socket pair, both non-blocking. */
+static bool test_socketpair(bs_test_t *test_ptr, int fds[2])
+{
+    if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+        BS_TEST_FAIL(test_ptr, "Failed socketpair()");
+        return false;
+    }
+    bs_sock_set_blocking(fds[0], false);
+    bs_sock_set_blocking(fds[1], false);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Reads through a small buffer, wrapping around. */
+void test_reader(bs_test_t *test_ptr)
+{
+    int fds[2];
+    char buf[16];
+    if (!test_socketpair(test_ptr, fds)) return;
+    bs_sock_reader_t *reader_ptr = bs_sock_reader_create(fds[0], 8);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, reader_ptr);
+
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_sock_reader_read(reader_ptr, buf, 4, 0));
+
+    BS_TEST_VERIFY_EQ(test_ptr, 10, write(fds[1], "0123456789", 10));
+    BS_TEST_VERIFY_EQ(test_ptr, 8, bs_sock_reader_fill(reader_ptr, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_sock_reader_fill(reader_ptr, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 5, bs_sock_reader_read(reader_ptr, buf, 5, 0));
+    BS_TEST_VERIFY_MEMEQ(test_ptr, "01234", buf, 5);
+
+    // Fills the space at the end, and at the front.
+    BS_TEST_VERIFY_EQ(test_ptr, 4, write(fds[1], "abcd", 4));
+    BS_TEST_VERIFY_EQ(test_ptr, 5, bs_sock_reader_fill(reader_ptr, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 8, bs_sock_reader_buffered(reader_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 8, bs_sock_reader_read(reader_ptr, buf, 16, 0));
+    BS_TEST_VERIFY_MEMEQ(test_ptr, "56789abc", buf, 8);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_sock_reader_read(reader_ptr, buf, 16, 0));
+    BS_TEST_VERIFY_MEMEQ(test_ptr, "d", buf, 1);
+
+    close(fds[1]);
+    BS_TEST_VERIFY_EQ(test_ptr, -1, bs_sock_reader_read(reader_ptr, buf, 1, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, EPIPE, errno);
+    bs_sock_reader_destroy(reader_ptr);
+    close(fds[0]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Reads lines, across fills and wrap-arounds. */
+void test_reader_read_until(bs_test_t *test_ptr)
+{
+    int fds[2];
+    char buf[16];
+    if (!test_socketpair(test_ptr, fds)) return;
+    bs_sock_reader_t *reader_ptr = bs_sock_reader_create(fds[0], 8);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, reader_ptr);
+
+    BS_TEST_VERIFY_EQ(test_ptr, 14, write(fds[1], "alpha\nbeta\ngam", 14));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 6,
+        bs_sock_reader_read_until(reader_ptr, '\n', buf, sizeof(buf), 0));
+    BS_TEST_VERIFY_STREQ(test_ptr, "alpha\n", buf);
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 5,
+        bs_sock_reader_read_until(reader_ptr, '\n', buf, sizeof(buf), 0));
+    BS_TEST_VERIFY_STREQ(test_ptr, "beta\n", buf);
+
+    // Incomplete: Times out, and keeps the data.
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 0,
+        bs_sock_reader_read_until(reader_ptr, '\n', buf, sizeof(buf), 10));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_sock_reader_buffered(reader_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, write(fds[1], "ma\n", 3));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 6,
+        bs_sock_reader_read_until(reader_ptr, '\n', buf, sizeof(buf), 0));
+    BS_TEST_VERIFY_STREQ(test_ptr, "gamma\n", buf);
+
+    // Does not fit the caller's buffer, nor the reader's capacity.
+    BS_TEST_VERIFY_EQ(test_ptr, 4, write(fds[1], "abc\n", 4));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, -1,
+        bs_sock_reader_read_until(reader_ptr, '\n', buf, 3, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, ENOBUFS, errno);
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 4,
+        bs_sock_reader_read_until(reader_ptr, '\n', buf, 4, 0));
+    BS_TEST_VERIFY_MEMEQ(test_ptr, "abc\n", buf, 4);
+    BS_TEST_VERIFY_EQ(test_ptr, 9, write(fds[1], "123456789", 9));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, -1,
+        bs_sock_reader_read_until(reader_ptr, '\n', buf, sizeof(buf), 0));
+    BS_TEST_VERIFY_EQ(test_ptr, ENOBUFS, errno);
+
+    bs_sock_reader_destroy(reader_ptr);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Buffers small writes, and sends large ones along with the buffer. */
+void test_writer(bs_test_t *test_ptr)
+{
+    int fds[2];
+    char buf[64];
+    if (!test_socketpair(test_ptr, fds)) return;
+    bs_sock_writer_t *writer_ptr = bs_sock_writer_create(fds[1], 8);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, writer_ptr);
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_sock_writer_write(writer_ptr, "ab", 2, 0));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_sock_writer_write(writer_ptr, "cde", 3, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 5, bs_sock_writer_pending(writer_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, -1, read(fds[0], buf, sizeof(buf)));
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_sock_writer_flush(writer_ptr, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_sock_writer_pending(writer_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 5, read(fds[0], buf, sizeof(buf)));
+    BS_TEST_VERIFY_MEMEQ(test_ptr, "abcde", buf, 5);
+
+    // Overflows: Buffered and new data go out with the same writev.
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_sock_writer_write(writer_ptr, "0123", 4, 0));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_sock_writer_write(writer_ptr, "4567", 4, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 8, bs_sock_writer_pending(writer_ptr));
+    struct iovec iov[2] = {
+        { .iov_base = "89ABCDEFGH", .iov_len = 10 },
+        { .iov_base = "IJ", .iov_len = 2 } };
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_sock_writer_writev(writer_ptr, iov, 2, 0));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_sock_writer_pending(writer_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 20, read(fds[0], buf, sizeof(buf)));
+    BS_TEST_VERIFY_MEMEQ(test_ptr, "0123456789ABCDEFGHIJ", buf, 20);
+
+    bs_sock_writer_destroy(writer_ptr);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/** @endcond */
 /* == End of sock.c ======================================================== */
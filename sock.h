@@ -21,8 +21,12 @@
 #ifndef __LIBBASE_SOCK_H__
 #define __LIBBASE_SOCK_H__
 
+#include "test.h"
+
 #include <stdbool.h>
+#include <stddef.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -68,6 +72,159 @@ int bs_sock_poll_read(int fd, int msec);
  */
 ssize_t bs_sock_read(int fd, void *buf_ptr, size_t count, int msec);
 
+/**
+ * A buffered reader for a file descriptor.
+ *
+ * Data is read into an internal ring buffer, with one readv(2) filling all
+ * free space at once. Line- or message-oriented parsers then consume from
+ * the buffer, and take a system call only when it runs empty.
+ */
+typedef struct _bs_sock_reader_t bs_sock_reader_t;
+
+/**
+ * Creates a buffered reader for `fd`. Does not take ownership of `fd`.
+ *
+ * @param fd
+ * @param capacity            Size of the buffer, in bytes. If 0, a default
+ *                            of 65536 is used.
+ *
+ * @return The reader, or NULL on error. Must be destroyed by calling
+ *     @ref bs_sock_reader_destroy.
+ */
+bs_sock_reader_t *bs_sock_reader_create(int fd, size_t capacity);
+
+/** Destroys the reader. Does not close the file descriptor. */
+void bs_sock_reader_destroy(bs_sock_reader_t *reader_ptr);
+
+/** Returns the number of bytes currently buffered. */
+size_t bs_sock_reader_buffered(const bs_sock_reader_t *reader_ptr);
+
+/**
+ * Reads from the file descriptor into the buffer, if there is space.
+ *
+ * @param reader_ptr
+ * @param msec                Timeout in milliseconds. A negative value
+ *                            specifies an infinite timeout.
+ *
+ * @return Number of bytes added to the buffer, which is 0 if the call timed
+ * out or the buffer is full. Returns a negative value on error, with the
+ * error logged and errno retained. If the connection was closed, a negative
+ * value is returned and errno is set to EPIPE.
+ */
+ssize_t bs_sock_reader_fill(bs_sock_reader_t *reader_ptr, int msec);
+
+/**
+ * Reads up to `count` bytes, from the buffer, or filling it once if empty.
+ *
+ * @param reader_ptr
+ * @param buf_ptr
+ * @param count
+ * @param msec                Timeout in milliseconds, for filling. A
+ *                            negative value specifies an infinite timeout.
+ *
+ * @return Number of bytes read, 0 if the call timed out. A negative value,
+ * with errno set, on error or if the connection was closed. See
+ * @ref bs_sock_reader_fill.
+ */
+ssize_t bs_sock_reader_read(bs_sock_reader_t *reader_ptr,
+                            void *buf_ptr,
+                            size_t count,
+                            int msec);
+
+/**
+ * Reads up to and including the first `delim`. Fills the buffer as needed.
+ *
+ * If no delimiter is found before the timeout, nothing is consumed, and the
+ * buffered data remains available for a later call.
+ *
+ * @param reader_ptr
+ * @param delim               Delimiter, eg. '\n'.
+ * @param buf_ptr             Where to store the data, including `delim`.
+ *                            NUL-terminated, if `size` permits.
+ * @param size                Size of `buf_ptr`.
+ * @param msec                Timeout in milliseconds, for all of the call.
+ *                            A negative value specifies an infinite timeout.
+ *
+ * @return Number of bytes read, including `delim`, or 0 if the call timed
+ * out. A negative value, with errno set, on error or if the connection was
+ * closed. errno is ENOBUFS if no delimiter was found within `size` bytes or
+ * within the reader's capacity.
+ */
+ssize_t bs_sock_reader_read_until(bs_sock_reader_t *reader_ptr,
+                                  char delim,
+                                  char *buf_ptr,
+                                  size_t size,
+                                  int msec);
+
+/**
+ * A buffered writer for a file descriptor.
+ *
+ * Writes go into an internal ring buffer, and are sent with a single
+ * writev(2) when the buffer is full, or on @ref bs_sock_writer_flush.
+ */
+typedef struct _bs_sock_writer_t bs_sock_writer_t;
+
+/**
+ * Creates a buffered writer for `fd`. Does not take ownership of `fd`.
+ *
+ * @param fd
+ * @param capacity            Size of the buffer, in bytes. If 0, a default
+ *                            of 65536 is used.
+ *
+ * @return The writer, or NULL on error. Must be destroyed by calling
+ *     @ref bs_sock_writer_destroy.
+ */
+bs_sock_writer_t *bs_sock_writer_create(int fd, size_t capacity);
+
+/**
+ * Destroys the writer. Does not flush, and does not close the file
+ * descriptor. Data not flushed is discarded.
+ */
+void bs_sock_writer_destroy(bs_sock_writer_t *writer_ptr);
+
+/** Returns the number of bytes buffered, and not yet written. */
+size_t bs_sock_writer_pending(const bs_sock_writer_t *writer_ptr);
+
+/**
+ * Writes the iovec. Buffers it, if it fits the remaining space. Otherwise,
+ * writes buffer and iovec together with writev(2).
+ *
+ * @param writer_ptr
+ * @param iov_ptr
+ * @param iovcnt
+ * @param msec                Timeout in milliseconds, for the writes this
+ *                            call needs. A negative value specifies an
+ *                            infinite timeout.
+ *
+ * @return true if all data was written or buffered. On error or timeout,
+ * returns false, with errno set. Data may then have been partially written.
+ */
+bool bs_sock_writer_writev(bs_sock_writer_t *writer_ptr,
+                           const struct iovec *iov_ptr,
+                           int iovcnt,
+                           int msec);
+
+/** Writes `count` bytes from `buf_ptr`. See @ref bs_sock_writer_writev. */
+bool bs_sock_writer_write(bs_sock_writer_t *writer_ptr,
+                          const void *buf_ptr,
+                          size_t count,
+                          int msec);
+
+/**
+ * Writes all buffered data to the file descriptor.
+ *
+ * @param writer_ptr
+ * @param msec                Timeout in milliseconds. A negative value
+ *                            specifies an infinite timeout.
+ *
+ * @return true on success. On error, or on timeout (errno then is
+ * ETIMEDOUT), returns false, and the remaining data stays buffered.
+ */
+bool bs_sock_writer_flush(bs_sock_writer_t *writer_ptr, int msec);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_sock_test_cases[];
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
@@ -18,6 +18,9 @@
  * limitations under the License.
  */
 
+/// newlocale(3) and strtod_l(3), for parsing independent of the locale.
+#define _GNU_SOURCE
+
 #include "strutil.h"
 
 #include "log.h"
@@ -25,8 +28,48 @@
 #include <ctype.h>
 #include <errno.h>
 #include <float.h>
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#undef _GNU_SOURCE
+
+/* == Declarations ========================================================= */
+
+/** Minimum size of the allocated buffer of a @ref bs_strbuilder_t. */
+static const size_t           _strbuilder_min_size = 64;
+
+static bool _strbuilder_reserve(bs_strbuilder_t *sb_ptr, size_t len);
+
+/** Two-digit pairs "00" to "99", for formatting two digits at a time. */
+static const char             _strformat_digit_pairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/** Powers of ten that are exact in a double, for Clinger's fast path. */
+static const double           _strconvert_exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/** The "C" locale, for @ref bs_strconvert_double_n falling back to strtod. */
+static locale_t               _strconvert_c_locale = (locale_t)0;
+/** Guards @ref _strconvert_c_locale_create. */
+static pthread_once_t         _strconvert_c_locale_once = PTHREAD_ONCE_INIT;
+
+static void _strconvert_c_locale_create(void);
+static bool _strconvert_is_8digits(uint64_t chunk);
+static uint64_t _strconvert_parse_8digits(uint64_t chunk);
+static bool _strconvert_double_fallback(
+    const char *ptr,
+    size_t len,
+    double *value_ptr);
 
 /* == Exported methods ===================================================== */
 
@@ -160,20 +203,473 @@ bool bs_str_startswith(const char *string_ptr, const char *prefix_ptr)
     return 0 == strncmp(string_ptr, prefix_ptr, strlen(prefix_ptr));
 }
 
+/* ------------------------------------------------------------------------- */
+bool bs_strconvert_uint64_n(
+    const char *ptr,
+    size_t len,
+    uint64_t *value_ptr)
+{
+    if (0 == len) return false;
+
+    // Leading zeroes do not count towards the 20 digits of UINT64_MAX.
+    while (1 < len && '0' == *ptr) {
+        ++ptr;
+        --len;
+    }
+    if (20 < len) return false;
+
+    // Any 19 digits fit into an uint64_t. Parse those 8 at a time, and check
+    // only the remainder for overflow.
+    uint64_t value = 0;
+    size_t pos = 0;
+    for (; pos + 8 <= BS_MIN(len, (size_t)19); pos += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, ptr + pos, sizeof(chunk));
+        if (!_strconvert_is_8digits(chunk)) return false;
+        value = value * 100000000 + _strconvert_parse_8digits(chunk);
+    }
+    for (; pos < len; ++pos) {
+        unsigned digit = (unsigned char)ptr[pos] - '0';
+        if (9 < digit) return false;
+        if (__builtin_mul_overflow(value, 10, &value) ||
+            __builtin_add_overflow(value, digit, &value)) return false;
+    }
+
+    *value_ptr = value;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_strconvert_int64_n(
+    const char *ptr,
+    size_t len,
+    int64_t *value_ptr)
+{
+    bool negative = 0 < len && '-' == *ptr;
+    if (negative) {
+        ++ptr;
+        --len;
+    }
+
+    uint64_t value;
+    if (!bs_strconvert_uint64_n(ptr, len, &value)) return false;
+    if (!negative) {
+        if ((uint64_t)INT64_MAX < value) return false;
+        *value_ptr = value;
+    } else if (0 == value) {
+        *value_ptr = 0;
+    } else {
+        if ((uint64_t)INT64_MAX + 1 < value) return false;
+        // Offset by one: INT64_MIN has no positive int64_t counterpart.
+        *value_ptr = -(int64_t)(value - 1) - 1;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_strconvert_double_n(
+    const char *ptr,
+    size_t len,
+    double *value_ptr)
+{
+    const char *end_ptr = ptr + len;
+    const char *p = ptr;
+    bool negative = false;
+    if (p < end_ptr && ('-' == *p || '+' == *p)) negative = '-' == *p++;
+
+    // Gathers up to 19 significant digits into `mantissa`, and the position
+    // of the decimal point into `exponent`.
+    uint64_t mantissa = 0;
+    int significant_digits = 0;
+    int exponent = 0;
+    size_t digits = 0;
+    bool fraction = false;
+    for (; p < end_ptr; ++p) {
+        if ('.' == *p && !fraction) {
+            fraction = true;
+            continue;
+        }
+        unsigned digit = (unsigned char)*p - '0';
+        if (9 < digit) break;
+        ++digits;
+        if (fraction) --exponent;
+        if (0 == mantissa && 0 == digit) continue;
+        if (19 <= significant_digits) {
+            return _strconvert_double_fallback(ptr, len, value_ptr);
+        }
+        mantissa = mantissa * 10 + digit;
+        ++significant_digits;
+    }
+    if (0 == digits) return _strconvert_double_fallback(ptr, len, value_ptr);
+
+    if (p < end_ptr && ('e' == *p || 'E' == *p)) {
+        ++p;
+        bool exponent_negative = false;
+        if (p < end_ptr && ('-' == *p || '+' == *p)) {
+            exponent_negative = '-' == *p++;
+        }
+        if (p >= end_ptr) return false;
+        int explicit_exponent = 0;
+        for (; p < end_ptr; ++p) {
+            unsigned digit = (unsigned char)*p - '0';
+            if (9 < digit) return false;
+            // Saturates. Anything this large is out of range, or zero.
+            if (100000 > explicit_exponent) {
+                explicit_exponent = explicit_exponent * 10 + digit;
+            }
+        }
+        exponent += exponent_negative ? -explicit_exponent : explicit_exponent;
+    }
+    if (p != end_ptr) return _strconvert_double_fallback(ptr, len, value_ptr);
+
+    if (0 == mantissa) {
+        *value_ptr = negative ? -0.0 : 0.0;
+        return true;
+    }
+
+#if FLT_EVAL_METHOD == 0
+    // Clinger's fast path: Both the mantissa and the power of ten are exact
+    // doubles, so a single IEEE multiplication or division rounds correctly.
+    if ((UINT64_C(1) << 53) >= mantissa && -22 <= exponent && 22 >= exponent) {
+        double value = mantissa;
+        if (0 > exponent) {
+            value /= _strconvert_exact_pow10[-exponent];
+        } else {
+            value *= _strconvert_exact_pow10[exponent];
+        }
+        *value_ptr = negative ? -value : value;
+        return true;
+    }
+#endif  // FLT_EVAL_METHOD == 0
+
+    return _strconvert_double_fallback(ptr, len, value_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_strformat_uint64(char *buf_ptr, uint64_t value)
+{
+    char digits[BS_STRFORMAT_UINT64_SIZE - 1];
+    size_t pos = sizeof(digits);
+    while (100 <= value) {
+        pos -= 2;
+        memcpy(digits + pos, &_strformat_digit_pairs[2 * (value % 100)], 2);
+        value /= 100;
+    }
+    if (10 <= value) {
+        pos -= 2;
+        memcpy(digits + pos, &_strformat_digit_pairs[2 * value], 2);
+    } else {
+        digits[--pos] = '0' + value;
+    }
+
+    size_t len = sizeof(digits) - pos;
+    memcpy(buf_ptr, digits + pos, len);
+    buf_ptr[len] = '\0';
+    return len;
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_strformat_int64(char *buf_ptr, int64_t value)
+{
+    if (0 <= value) return bs_strformat_uint64(buf_ptr, value);
+    // Negates as unsigned: INT64_MIN has no positive int64_t counterpart.
+    buf_ptr[0] = '-';
+    return 1 + bs_strformat_uint64(buf_ptr + 1, -(uint64_t)value);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_strbuilder_init(bs_strbuilder_t *sb_ptr,
+                        char *initial_buf_ptr,
+                        size_t initial_size)
+{
+    *sb_ptr = (bs_strbuilder_t){
+        .buf_ptr = initial_buf_ptr,
+        .size = NULL != initial_buf_ptr ? initial_size : 0,
+        .initial_buf_ptr = initial_buf_ptr,
+        .initial_size = NULL != initial_buf_ptr ? initial_size : 0
+    };
+    if (0 < sb_ptr->size) sb_ptr->buf_ptr[0] = '\0';
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_strbuilder_fini(bs_strbuilder_t *sb_ptr)
+{
+    if (sb_ptr->buf_ptr != sb_ptr->initial_buf_ptr) free(sb_ptr->buf_ptr);
+    *sb_ptr = (bs_strbuilder_t){};
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_strbuilder_reset(bs_strbuilder_t *sb_ptr)
+{
+    sb_ptr->len = 0;
+    sb_ptr->failed = false;
+    if (0 < sb_ptr->size) sb_ptr->buf_ptr[0] = '\0';
+}
+
+/* ------------------------------------------------------------------------- */
+const char *bs_strbuilder_str(const bs_strbuilder_t *sb_ptr)
+{
+    return 0 < sb_ptr->size ? sb_ptr->buf_ptr : "";
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_strbuilder_len(const bs_strbuilder_t *sb_ptr)
+{
+    return sb_ptr->len;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_strbuilder_failed(const bs_strbuilder_t *sb_ptr)
+{
+    return sb_ptr->failed;
+}
+
+/* ------------------------------------------------------------------------- */
+char *bs_strbuilder_steal(bs_strbuilder_t *sb_ptr)
+{
+    bool allocated = sb_ptr->buf_ptr != sb_ptr->initial_buf_ptr;
+    char *str_ptr = NULL;
+    if (sb_ptr->failed) {
+        if (allocated) free(sb_ptr->buf_ptr);
+    } else if (allocated) {
+        str_ptr = sb_ptr->buf_ptr;
+    } else {
+        str_ptr = malloc(sb_ptr->len + 1);
+        if (NULL == str_ptr) {
+            bs_log(BS_ERROR | BS_ERRNO, "Failed malloc(%zu)", sb_ptr->len + 1);
+        } else {
+            memcpy(str_ptr, bs_strbuilder_str(sb_ptr), sb_ptr->len + 1);
+        }
+    }
+    bs_strbuilder_init(sb_ptr, sb_ptr->initial_buf_ptr, sb_ptr->initial_size);
+    return str_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_strbuilder_append_n(bs_strbuilder_t *sb_ptr,
+                            const char *ptr,
+                            size_t len)
+{
+    if (!_strbuilder_reserve(sb_ptr, len)) return false;
+    memcpy(sb_ptr->buf_ptr + sb_ptr->len, ptr, len);
+    sb_ptr->len += len;
+    sb_ptr->buf_ptr[sb_ptr->len] = '\0';
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_strbuilder_append(bs_strbuilder_t *sb_ptr, const char *str_ptr)
+{
+    return bs_strbuilder_append_n(sb_ptr, str_ptr, strlen(str_ptr));
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_strbuilder_append_char(bs_strbuilder_t *sb_ptr, char c)
+{
+    if (!_strbuilder_reserve(sb_ptr, 1)) return false;
+    sb_ptr->buf_ptr[sb_ptr->len++] = c;
+    sb_ptr->buf_ptr[sb_ptr->len] = '\0';
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_strbuilder_append_int64(bs_strbuilder_t *sb_ptr, int64_t value)
+{
+    char digits[BS_STRFORMAT_INT64_SIZE];
+    size_t len = bs_strformat_int64(digits, value);
+    return bs_strbuilder_append_n(sb_ptr, digits, len);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_strbuilder_append_uint64(bs_strbuilder_t *sb_ptr, uint64_t value)
+{
+    char digits[BS_STRFORMAT_UINT64_SIZE];
+    size_t len = bs_strformat_uint64(digits, value);
+    return bs_strbuilder_append_n(sb_ptr, digits, len);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_strbuilder_appendf(
+    bs_strbuilder_t *sb_ptr,
+    const char *fmt_ptr, ...)
+{
+    va_list ap;
+    va_start(ap, fmt_ptr);
+    bool rv = bs_strbuilder_vappendf(sb_ptr, fmt_ptr, ap);
+    va_end(ap);
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_strbuilder_vappendf(
+    bs_strbuilder_t *sb_ptr,
+    const char *fmt_ptr,
+    va_list ap)
+{
+    if (sb_ptr->failed) return false;
+
+    // Formats into the remaining space. Only if that is too small, grows the
+    // buffer and formats again.
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    size_t available = sb_ptr->size - sb_ptr->len;
+    int rv = vsnprintf(0 < available ? sb_ptr->buf_ptr + sb_ptr->len : NULL,
+                       available, fmt_ptr, ap_copy);
+    va_end(ap_copy);
+    if (0 > rv) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed vsnprintf(\"%s\")", fmt_ptr);
+        if (0 < sb_ptr->size) sb_ptr->buf_ptr[sb_ptr->len] = '\0';
+        return false;
+    }
+    if ((size_t)rv >= available) {
+        if (!_strbuilder_reserve(sb_ptr, rv)) {
+            if (0 < sb_ptr->size) sb_ptr->buf_ptr[sb_ptr->len] = '\0';
+            return false;
+        }
+        vsnprintf(sb_ptr->buf_ptr + sb_ptr->len, rv + 1, fmt_ptr, ap);
+    }
+    sb_ptr->len += rv;
+    return true;
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Creates @ref _strconvert_c_locale. Called through pthread_once(3). */
+void _strconvert_c_locale_create(void)
+{
+    _strconvert_c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+    if ((locale_t)0 == _strconvert_c_locale) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed newlocale(LC_ALL_MASK, \"C\", 0)");
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns whether all 8 bytes of `chunk` are ASCII digits. */
+bool _strconvert_is_8digits(uint64_t chunk)
+{
+    // Digits are 0x30 to 0x39: Their high nibble is 3, and adding 6 keeps it.
+    return (((chunk & UINT64_C(0xf0f0f0f0f0f0f0f0)) |
+             (((chunk + UINT64_C(0x0606060606060606)) &
+               UINT64_C(0xf0f0f0f0f0f0f0f0)) >> 4)) ==
+            UINT64_C(0x3333333333333333));
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns the value of the 8 digits in `chunk`, as loaded from memory. The
+ * first digit is the most significant one.
+ */
+uint64_t _strconvert_parse_8digits(uint64_t chunk)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    chunk = __builtin_bswap64(chunk);
+#endif
+    // Combines adjacent digits to pairs, pairs to quads, and quads to the
+    // final 8 digits: Three multiplications, instead of eight.
+    chunk = ((chunk & UINT64_C(0x0f0f0f0f0f0f0f0f)) * 2561) >> 8;
+    chunk = ((chunk & UINT64_C(0x00ff00ff00ff00ff)) * 6553601) >> 16;
+    return ((chunk & UINT64_C(0x0000ffff0000ffff)) *
+            UINT64_C(42949672960001)) >> 32;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Parses the span with strtod_l(3), in the "C" locale. Copies the span, for
+ * NUL-terminating it.
+ */
+bool _strconvert_double_fallback(
+    const char *ptr,
+    size_t len,
+    double *value_ptr)
+{
+    // strtod(3) would skip leading whitespace. The span is a number, only.
+    if (0 == len || isspace((unsigned char)*ptr)) return false;
+
+    pthread_once(&_strconvert_c_locale_once, _strconvert_c_locale_create);
+    if ((locale_t)0 == _strconvert_c_locale) return false;
+
+    char buf[64];
+    char *str_ptr = buf;
+    if (len >= sizeof(buf)) {
+        str_ptr = malloc(len + 1);
+        if (NULL == str_ptr) return false;
+    }
+    memcpy(str_ptr, ptr, len);
+    str_ptr[len] = '\0';
+
+    char *invalid_ptr = NULL;
+    errno = 0;
+    double value = strtod_l(str_ptr, &invalid_ptr, _strconvert_c_locale);
+    // ERANGE is also reported for subnormal results. Those are fine.
+    bool rv = ((0 == errno ||
+                (ERANGE == errno && 0 != value && !isinf(value))) &&
+               invalid_ptr == str_ptr + len);
+    if (str_ptr != buf) free(str_ptr);
+
+    if (rv) *value_ptr = value;
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Ensures the buffer holds `len` more bytes, plus the terminating NUL.
+ * Grows it geometrically, if needed. Sets the failed flag on error.
+ *
+ * @return Whether the builder has the space.
+ */
+bool _strbuilder_reserve(bs_strbuilder_t *sb_ptr, size_t len)
+{
+    if (sb_ptr->failed) return false;
+    if (sb_ptr->len + len < sb_ptr->size) return true;
+
+    size_t size = BS_MAX(_strbuilder_min_size, 2 * sb_ptr->size);
+    size = BS_MAX(size, sb_ptr->len + len + 1);
+    char *buf_ptr;
+    if (sb_ptr->buf_ptr != sb_ptr->initial_buf_ptr) {
+        buf_ptr = realloc(sb_ptr->buf_ptr, size);
+    } else {
+        buf_ptr = malloc(size);
+        if (NULL != buf_ptr) {
+            memcpy(buf_ptr, bs_strbuilder_str(sb_ptr), sb_ptr->len + 1);
+        }
+    }
+    if (NULL == buf_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed to allocate %zu bytes", size);
+        sb_ptr->failed = true;
+        return false;
+    }
+    sb_ptr->buf_ptr = buf_ptr;
+    sb_ptr->size = size;
+    return true;
+}
+
 /* == Test functions ======================================================= */
 
 static void test_strappend(bs_test_t *test_ptr);
 static void strconvert_uint64_test(bs_test_t *test_ptr);
 static void strconvert_int64_test(bs_test_t *test_ptr);
 static void strconvert_double_test(bs_test_t *test_ptr);
+static void strconvert_uint64_n_test(bs_test_t *test_ptr);
+static void strconvert_int64_n_test(bs_test_t *test_ptr);
+static void strconvert_double_n_test(bs_test_t *test_ptr);
+static void test_strformat(bs_test_t *test_ptr);
 static void test_startswith(bs_test_t *test_ptr);
+static void test_strbuilder(bs_test_t *test_ptr);
+static void test_strbuilder_steal(bs_test_t *test_ptr);
 
 const bs_test_case_t          bs_strutil_test_cases[] = {
     { 1, "strappend", test_strappend },
     { 1, "strconvert_uint64", strconvert_uint64_test },
     { 1, "strconvert_int64", strconvert_int64_test },
     { 1, "strconvert_double", strconvert_double_test },
+    { 1, "strconvert_uint64_n", strconvert_uint64_n_test },
+    { 1, "strconvert_int64_n", strconvert_int64_n_test },
+    { 1, "strconvert_double_n", strconvert_double_n_test },
+    { 1, "strformat", test_strformat },
     { 1, "startswith", test_startswith },
+    { 1, "strbuilder", test_strbuilder },
+    { 1, "strbuilder_steal", test_strbuilder_steal },
     { 0, NULL, NULL }
 };
 
@@ -306,6 +802,178 @@ void strconvert_double_test(bs_test_t *test_ptr)
     BS_TEST_VERIFY_FALSE(test_ptr, bs_strconvert_double("1e+400", &value));
 }
 
+/* ------------------------------------------------------------------------- */
+void strconvert_uint64_n_test(bs_test_t *test_ptr)
+{
+    uint64_t value;
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strconvert_uint64_n("42", 2, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, 42, value);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strconvert_uint64_n("0", 1, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, value);
+    // Not NUL-terminated: Only the span is parsed.
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_strconvert_uint64_n("1234567890x", 9, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, 123456789, value);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_strconvert_uint64_n("18446744073709551615", 20, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, UINT64_MAX, value);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_strconvert_uint64_n("000000018446744073709551615", 27, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, UINT64_MAX, value);
+
+    value = 7;
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_strconvert_uint64_n("", 0, &value));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_strconvert_uint64_n("18446744073709551616", 20, &value));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_strconvert_uint64_n("99999999999999999999", 20, &value));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_strconvert_uint64_n("184467440737095516150", 21, &value));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_strconvert_uint64_n("-42", 3, &value));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_strconvert_uint64_n(" 42", 3, &value));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_strconvert_uint64_n("42 ", 3, &value));
+    // A non-digit in either the 8-digit chunk, or in the remainder.
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_strconvert_uint64_n("1234:678", 8, &value));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_strconvert_uint64_n("12345678/", 9, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, 7, value);
+
+    // Agrees with strtoull(3), across all lengths.
+    uint64_t v = 1;
+    for (int i = 0; i < 1000; ++i) {
+        char buf[BS_STRFORMAT_UINT64_SIZE];
+        v = v * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+        uint64_t expected = v >> (i % 64);
+        size_t len = snprintf(buf, sizeof(buf), "%"PRIu64, expected);
+        BS_TEST_VERIFY_TRUE_OR_RETURN(
+            test_ptr, bs_strconvert_uint64_n(buf, len, &value));
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, expected, value);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void strconvert_int64_n_test(bs_test_t *test_ptr)
+{
+    int64_t value;
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strconvert_int64_n("-42", 3, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, -42, value);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strconvert_int64_n("-0", 2, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, value);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_strconvert_int64_n("9223372036854775807", 19, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, INT64_MAX, value);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_strconvert_int64_n("-9223372036854775808", 20, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, INT64_MIN, value);
+
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_strconvert_int64_n("9223372036854775808", 19, &value));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_strconvert_int64_n("-9223372036854775809", 20, &value));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_strconvert_int64_n("-", 1, &value));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_strconvert_int64_n("+1", 2, &value));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_strconvert_int64_n("--1", 3, &value));
+}
+
+/* ------------------------------------------------------------------------- */
+void strconvert_double_n_test(bs_test_t *test_ptr)
+{
+    static const char *valid_ptrs[] = {
+        "0", "-0", "+1", "1.5", "-2.25", ".5", "5.", "0.1", "3.14159",
+        "1e10", "1E-10", "1e22", "1e23", "9007199254740993", "0.000001",
+        "123456789012345678901234567890", "2.2250738585072014e-308",
+        "1.7976931348623158e+308", "4.9406564584124654e-324",
+        "0e99999", "0x1.8p1", "inf", "-Infinity", "nan",
+        "1.00000000000000011102230246251565404236316680908203125",
+        NULL
+    };
+    double value;
+
+    for (const char **str_ptr_ptr = valid_ptrs;
+         NULL != *str_ptr_ptr;
+         ++str_ptr_ptr) {
+        const char *str_ptr = *str_ptr_ptr;
+        double expected = strtod(str_ptr, NULL);
+        if (!bs_strconvert_double_n(str_ptr, strlen(str_ptr), &value)) {
+            BS_TEST_FAIL(test_ptr, "Failed to parse \"%s\"", str_ptr);
+            continue;
+        }
+        if (isnan(expected)) {
+            BS_TEST_VERIFY_TRUE(test_ptr, isnan(value));
+        } else {
+            BS_TEST_VERIFY_EQ(test_ptr, 0, memcmp(&expected, &value,
+                                                  sizeof(double)));
+        }
+    }
+
+    // Not NUL-terminated.
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strconvert_double_n("2.50e", 4, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, 2.5, value);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strconvert_double_n("1e-5x", 4, &value));
+    BS_TEST_VERIFY_EQ(test_ptr, 1e-5, value);
+
+    static const char *invalid_ptrs[] = {
+        "", "-", ".", "1e", "1e+", "1.2.3", " 1", "1 ", "1x", "badvalue",
+        "1e+400", "1e-400", "--1", NULL
+    };
+    for (const char **str_ptr_ptr = invalid_ptrs;
+         NULL != *str_ptr_ptr;
+         ++str_ptr_ptr) {
+        const char *str_ptr = *str_ptr_ptr;
+        if (bs_strconvert_double_n(str_ptr, strlen(str_ptr), &value)) {
+            BS_TEST_FAIL(test_ptr, "Unexpectedly parsed \"%s\"", str_ptr);
+        }
+    }
+
+    // Agrees with strtod(3) bit by bit, on and off the fast path.
+    uint64_t v = 1;
+    for (int i = 0; i < 10000; ++i) {
+        char buf[64];
+        v = v * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+        int exponent = (int)((v >> 8) % 80) - 40;
+        size_t len = snprintf(buf, sizeof(buf), "%"PRIu64".%"PRIu64"e%d",
+                              v >> (v % 64), (v >> 32) % 1000, exponent);
+        double expected = strtod(buf, NULL);
+        BS_TEST_VERIFY_TRUE_OR_RETURN(
+            test_ptr, bs_strconvert_double_n(buf, len, &value));
+        if (0 != memcmp(&expected, &value, sizeof(double))) {
+            BS_TEST_FAIL(test_ptr, "Mismatch for \"%s\": %.17g != %.17g",
+                         buf, value, expected);
+            return;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void test_strformat(bs_test_t *test_ptr)
+{
+    char buf[BS_STRFORMAT_INT64_SIZE];
+
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_strformat_uint64(buf, 0));
+    BS_TEST_VERIFY_STREQ(test_ptr, "0", buf);
+    BS_TEST_VERIFY_EQ(test_ptr, 20, bs_strformat_uint64(buf, UINT64_MAX));
+    BS_TEST_VERIFY_STREQ(test_ptr, "18446744073709551615", buf);
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_strformat_int64(buf, -42));
+    BS_TEST_VERIFY_STREQ(test_ptr, "-42", buf);
+    BS_TEST_VERIFY_EQ(test_ptr, 20, bs_strformat_int64(buf, INT64_MIN));
+    BS_TEST_VERIFY_STREQ(test_ptr, "-9223372036854775808", buf);
+
+    uint64_t value = 1;
+    for (int i = 0; i < 20; ++i, value *= 10) {
+        char expected[BS_STRFORMAT_UINT64_SIZE];
+        snprintf(expected, sizeof(expected), "%"PRIu64, value - 1);
+        bs_strformat_uint64(buf, value - 1);
+        BS_TEST_VERIFY_STREQ_OR_RETURN(test_ptr, expected, buf);
+        snprintf(expected, sizeof(expected), "%"PRIu64, value);
+        bs_strformat_uint64(buf, value);
+        BS_TEST_VERIFY_STREQ_OR_RETURN(test_ptr, expected, buf);
+    }
+}
+
 /* ------------------------------------------------------------------------- */
 void test_startswith(bs_test_t *test_ptr)
 {
@@ -316,4 +984,309 @@ void test_startswith(bs_test_t *test_ptr)
     BS_TEST_VERIFY_FALSE(test_ptr, bs_str_startswith("", "asdf"));
 }
 
+/* -- String builder ------------------------------------------------------- */
+void test_strbuilder(bs_test_t *test_ptr)
+{
+    char buf[8];
+    bs_strbuilder_t sb;
+    bs_strbuilder_init(&sb, buf, sizeof(buf));
+    BS_TEST_VERIFY_STREQ(test_ptr, "", bs_strbuilder_str(&sb));
+
+    // Fits the initial buffer.
+    BS_TEST_VERIFY_TRUE(test_ptr, BS_STRBUILDER_APPEND_LITERAL(&sb, "ab"));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strbuilder_append_char(&sb, 'c'));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strbuilder_append_int64(&sb, -42));
+    BS_TEST_VERIFY_EQ(test_ptr, buf, bs_strbuilder_str(&sb));
+    BS_TEST_VERIFY_STREQ(test_ptr, "abc-42", bs_strbuilder_str(&sb));
+
+    // Moves out of the initial buffer.
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strbuilder_append(&sb, "def"));
+    BS_TEST_VERIFY_NEQ(test_ptr, buf, bs_strbuilder_str(&sb));
+    BS_TEST_VERIFY_STREQ(test_ptr, "abc-42def", bs_strbuilder_str(&sb));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_strbuilder_append_int64(&sb, INT64_MIN));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_strbuilder_append_uint64(&sb, UINT64_MAX));
+    BS_TEST_VERIFY_STREQ(
+        test_ptr, "abc-42def-922337203685477580818446744073709551615",
+        bs_strbuilder_str(&sb));
+
+    bs_strbuilder_reset(&sb);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_strbuilder_len(&sb));
+    for (int i = 0; i < 1000; ++i) {
+        BS_TEST_VERIFY_TRUE(
+            test_ptr, bs_strbuilder_appendf(&sb, "%03d,", i));
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 4000, bs_strbuilder_len(&sb));
+    BS_TEST_VERIFY_EQ(test_ptr, 4000, strlen(bs_strbuilder_str(&sb)));
+    BS_TEST_VERIFY_STRMATCH(
+        test_ptr, bs_strbuilder_str(&sb), "^000,001,.*,998,999,$");
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_strbuilder_failed(&sb));
+    bs_strbuilder_fini(&sb);
+
+    // Without an initial buffer.
+    bs_strbuilder_init(&sb, NULL, 0);
+    BS_TEST_VERIFY_STREQ(test_ptr, "", bs_strbuilder_str(&sb));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strbuilder_appendf(&sb, "%s", ""));
+    BS_TEST_VERIFY_STREQ(test_ptr, "", bs_strbuilder_str(&sb));
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strbuilder_appendf(&sb, "x%dy", 7));
+    BS_TEST_VERIFY_STREQ(test_ptr, "x7y", bs_strbuilder_str(&sb));
+    bs_strbuilder_fini(&sb);
+}
+
+/* ------------------------------------------------------------------------- */
+void test_strbuilder_steal(bs_test_t *test_ptr)
+{
+    char buf[8];
+    bs_strbuilder_t sb;
+    bs_strbuilder_init(&sb, buf, sizeof(buf));
+
+    // Still in the initial buffer: Gets copied.
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strbuilder_append(&sb, "short"));
+    char *str_ptr = bs_strbuilder_steal(&sb);
+    BS_TEST_VERIFY_NEQ(test_ptr, buf, str_ptr);
+    BS_TEST_VERIFY_STREQ(test_ptr, "short", str_ptr);
+    BS_TEST_VERIFY_STREQ(test_ptr, "", bs_strbuilder_str(&sb));
+    free(str_ptr);
+
+    // Allocated: Handed over.
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_strbuilder_append(&sb, "a longer one"));
+    const char *p = bs_strbuilder_str(&sb);
+    str_ptr = bs_strbuilder_steal(&sb);
+    BS_TEST_VERIFY_EQ(test_ptr, p, str_ptr);
+    BS_TEST_VERIFY_STREQ(test_ptr, "a longer one", str_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, buf, bs_strbuilder_str(&sb));
+    free(str_ptr);
+    bs_strbuilder_fini(&sb);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_strappendf(bs_test_t *test_ptr);
+static void benchmark_strbuilder(bs_test_t *test_ptr);
+static void benchmark_strconvert(bs_test_t *test_ptr);
+static void benchmark_strformat(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_strutil_benchmarks[] = {
+    { 1, "benchmark-strappendf", benchmark_strappendf },
+    { 1, "benchmark-strbuilder", benchmark_strbuilder },
+    { 1, "benchmark-strconvert", benchmark_strconvert },
+    { 1, "benchmark-strformat", benchmark_strformat },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Builds a log-like line with repeated bs_strappendf, `iterations` times. */
+static void _benchmark_strappendf_fn(
+    __UNUSED__ void *arg_ptr,
+    uint64_t iterations)
+{
+    char buf[256];
+    for (uint64_t i = 0; i < iterations; ++i) {
+        size_t pos = bs_strappendf(buf, sizeof(buf), 0, "%s", "INFO");
+        pos = bs_strappendf(buf, sizeof(buf), pos, " %s:%d ", "file.c", 123);
+        pos = bs_strappendf(buf, sizeof(buf), pos, "value %"PRIu64, i);
+        pos = bs_strappendf(buf, sizeof(buf), pos, "%s", " done");
+        BS_TEST_DO_NOT_OPTIMIZE(pos);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Builds the same line with a @ref bs_strbuilder_t, `iterations` times. */
+static void _benchmark_strbuilder_fn(
+    __UNUSED__ void *arg_ptr,
+    uint64_t iterations)
+{
+    char buf[256];
+    bs_strbuilder_t sb;
+    bs_strbuilder_init(&sb, buf, sizeof(buf));
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_strbuilder_reset(&sb);
+        BS_STRBUILDER_APPEND_LITERAL(&sb, "INFO");
+        BS_STRBUILDER_APPEND_LITERAL(&sb, " file.c:");
+        bs_strbuilder_append_int64(&sb, 123);
+        BS_STRBUILDER_APPEND_LITERAL(&sb, " value ");
+        bs_strbuilder_append_uint64(&sb, i);
+        BS_STRBUILDER_APPEND_LITERAL(&sb, " done");
+        BS_TEST_DO_NOT_OPTIMIZE(sb.len);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+    bs_strbuilder_fini(&sb);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_strappendf(bs_test_t *test_ptr)
+{
+    if (!bs_test_bench(test_ptr, "bs_strappendf", _benchmark_strappendf_fn,
+                       NULL, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(bs_strappendf)");
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_strbuilder(bs_test_t *test_ptr)
+{
+    if (!bs_test_bench(test_ptr, "bs_strbuilder", _benchmark_strbuilder_fn,
+                       NULL, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(bs_strbuilder)");
+    }
+}
+
+/** Number of fields parsed per benchmark iteration. */
+#define _BENCHMARK_FIELDS 10
+
+/** Numeric fields, as parsed from a config or data file. */
+static const char             *_benchmark_uint64_ptrs[_BENCHMARK_FIELDS] = {
+    "0", "7", "42", "1234", "65535", "1000000", "4294967295",
+    "123456789012", "9007199254740993", "18446744073709551615"
+};
+/** Floating point fields, as parsed from a config or data file. */
+static const char             *_benchmark_double_ptrs[_BENCHMARK_FIELDS] = {
+    "0", "1.5", "-2.25", "3.14159", "0.001", "1e10", "-6.02e-3",
+    "123.456", "299792.458", "0.30000000000000004"
+};
+
+/* ------------------------------------------------------------------------- */
+/** Parses all of @ref _benchmark_uint64_ptrs, `iterations` times. */
+static void _benchmark_strconvert_uint64_fn(
+    __UNUSED__ void *arg_ptr,
+    uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint64_t sum = 0;
+        for (size_t j = 0; j < _BENCHMARK_FIELDS; ++j) {
+            uint64_t value = 0;
+            bs_strconvert_uint64(_benchmark_uint64_ptrs[j], &value, 10);
+            sum += value;
+        }
+        BS_TEST_DO_NOT_OPTIMIZE(sum);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Parses all of @ref _benchmark_uint64_ptrs, `iterations` times, as spans. */
+static void _benchmark_strconvert_uint64_n_fn(
+    void *arg_ptr,
+    uint64_t iterations)
+{
+    const size_t *lengths = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint64_t sum = 0;
+        for (size_t j = 0; j < _BENCHMARK_FIELDS; ++j) {
+            uint64_t value = 0;
+            bs_strconvert_uint64_n(
+                _benchmark_uint64_ptrs[j], lengths[j], &value);
+            sum += value;
+        }
+        BS_TEST_DO_NOT_OPTIMIZE(sum);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Parses all of @ref _benchmark_double_ptrs, `iterations` times. */
+static void _benchmark_strconvert_double_fn(
+    __UNUSED__ void *arg_ptr,
+    uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; ++i) {
+        double sum = 0;
+        for (size_t j = 0; j < _BENCHMARK_FIELDS; ++j) {
+            double value = 0;
+            bs_strconvert_double(_benchmark_double_ptrs[j], &value);
+            sum += value;
+        }
+        BS_TEST_DO_NOT_OPTIMIZE(sum);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Parses all of @ref _benchmark_double_ptrs, `iterations` times, as spans. */
+static void _benchmark_strconvert_double_n_fn(
+    void *arg_ptr,
+    uint64_t iterations)
+{
+    const size_t *lengths = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        double sum = 0;
+        for (size_t j = 0; j < _BENCHMARK_FIELDS; ++j) {
+            double value = 0;
+            bs_strconvert_double_n(
+                _benchmark_double_ptrs[j], lengths[j], &value);
+            sum += value;
+        }
+        BS_TEST_DO_NOT_OPTIMIZE(sum);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Formats an uint64_t with snprintf(3), `iterations` times. */
+static void _benchmark_snprintf_uint64_fn(
+    __UNUSED__ void *arg_ptr,
+    uint64_t iterations)
+{
+    char buf[BS_STRFORMAT_UINT64_SIZE];
+    for (uint64_t i = 0; i < iterations; ++i) {
+        int len = snprintf(buf, sizeof(buf), "%"PRIu64,
+                           i * UINT64_C(2654435761));
+        BS_TEST_DO_NOT_OPTIMIZE(len);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Formats an uint64_t with @ref bs_strformat_uint64, `iterations` times. */
+static void _benchmark_strformat_uint64_fn(
+    __UNUSED__ void *arg_ptr,
+    uint64_t iterations)
+{
+    char buf[BS_STRFORMAT_UINT64_SIZE];
+    for (uint64_t i = 0; i < iterations; ++i) {
+        size_t len = bs_strformat_uint64(buf, i * UINT64_C(2654435761));
+        BS_TEST_DO_NOT_OPTIMIZE(len);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_strconvert(bs_test_t *test_ptr)
+{
+    size_t uint64_lengths[_BENCHMARK_FIELDS];
+    for (size_t i = 0; i < _BENCHMARK_FIELDS; ++i) {
+        uint64_lengths[i] = strlen(_benchmark_uint64_ptrs[i]);
+    }
+    size_t double_lengths[_BENCHMARK_FIELDS];
+    for (size_t i = 0; i < _BENCHMARK_FIELDS; ++i) {
+        double_lengths[i] = strlen(_benchmark_double_ptrs[i]);
+    }
+
+    if (!bs_test_bench(test_ptr, "bs_strconvert_uint64-10",
+                       _benchmark_strconvert_uint64_fn, NULL, NULL) ||
+        !bs_test_bench(test_ptr, "bs_strconvert_uint64_n-10",
+                       _benchmark_strconvert_uint64_n_fn,
+                       uint64_lengths, NULL) ||
+        !bs_test_bench(test_ptr, "bs_strconvert_double-10",
+                       _benchmark_strconvert_double_fn, NULL, NULL) ||
+        !bs_test_bench(test_ptr, "bs_strconvert_double_n-10",
+                       _benchmark_strconvert_double_n_fn,
+                       double_lengths, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(bs_strconvert)");
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_strformat(bs_test_t *test_ptr)
+{
+    if (!bs_test_bench(test_ptr, "snprintf-uint64",
+                       _benchmark_snprintf_uint64_fn, NULL, NULL) ||
+        !bs_test_bench(test_ptr, "bs_strformat_uint64",
+                       _benchmark_strformat_uint64_fn, NULL, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(bs_strformat)");
+    }
+}
+
 /* == End of strutil.c ===================================================== */
@@ -23,6 +23,8 @@
 
 #include <inttypes.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <sys/types.h>
 
 #include "def.h"
@@ -128,9 +130,198 @@ bool bs_strconvert_double(
 /** @return Whether `string_ptr` starts with `prefix_ptr`. */
 bool bs_str_startswith(const char *string_ptr, const char *prefix_ptr);
 
+/**
+ * Parses a decimal uint64_t from the `len` bytes at `ptr`.
+ *
+ * Unlike @ref bs_strconvert_uint64, the span need not be NUL-terminated, eg.
+ * when parsing in place from a mapped file. The span must consist of digits
+ * only: No sign, whitespace or base prefix. Digits are parsed eight at a
+ * time, and independent of the locale. Does not log on failure, to suit bulk
+ * parsing.
+ *
+ * @param ptr
+ * @param len
+ * @param value_ptr           Holds the value on success, and is untouched
+ *                            otherwise.
+ *
+ * @return true on success, false if the span is empty, has a non-digit, or
+ *     overflows.
+ */
+bool bs_strconvert_uint64_n(
+    const char *ptr,
+    size_t len,
+    uint64_t *value_ptr);
+
+/**
+ * Parses a decimal int64_t from the `len` bytes at `ptr`. Permits a single
+ * leading '-'. See @ref bs_strconvert_uint64_n.
+ */
+bool bs_strconvert_int64_n(
+    const char *ptr,
+    size_t len,
+    int64_t *value_ptr);
+
+/**
+ * Parses a double from the `len` bytes at `ptr`, in the "C" locale.
+ *
+ * Decimals of up to 19 significant digits, with an exponent small enough for
+ * the result to be exact in double arithmetic (Clinger's fast path), are
+ * converted directly. Everything else, including hexadecimal floats, "inf"
+ * and "nan", goes through strtod_l(3). The result is correctly rounded
+ * either way. The span must be fully consumed. Does not log on failure.
+ *
+ * @param ptr
+ * @param len
+ * @param value_ptr           Holds the value on success, and is untouched
+ *                            otherwise.
+ *
+ * @return true on success, false if the span is not a number, or out of
+ *     range.
+ */
+bool bs_strconvert_double_n(
+    const char *ptr,
+    size_t len,
+    double *value_ptr);
+
+/** Buffer size for @ref bs_strformat_uint64, including the NUL. */
+#define BS_STRFORMAT_UINT64_SIZE 21
+/** Buffer size for @ref bs_strformat_int64, including the NUL. */
+#define BS_STRFORMAT_INT64_SIZE 21
+
+/**
+ * Formats `value` in decimal into `buf_ptr`, without printf and independent
+ * of the locale.
+ *
+ * @param buf_ptr             Must hold at least @ref BS_STRFORMAT_UINT64_SIZE
+ *                            bytes. Gets NUL-terminated.
+ * @param value
+ *
+ * @return The number of characters written, excluding the NUL.
+ */
+size_t bs_strformat_uint64(char *buf_ptr, uint64_t value);
+
+/**
+ * Formats `value` in decimal into `buf_ptr`. Must hold at least
+ * @ref BS_STRFORMAT_INT64_SIZE bytes. See @ref bs_strformat_uint64.
+ */
+size_t bs_strformat_int64(char *buf_ptr, int64_t value);
+
+/**
+ * A growable string builder.
+ *
+ * Starts out in a caller-provided buffer, eg. on the stack, and moves to an
+ * allocated buffer only once that is exhausted. The allocated buffer grows
+ * geometrically. The string is always NUL-terminated.
+ *
+ * If an allocation fails, the builder keeps the string built so far, and
+ * ignores further appends: Check once with @ref bs_strbuilder_failed,
+ * instead of after each append.
+ *
+ * Example:
+ * ```
+ * char buf[256];
+ * bs_strbuilder_t sb;
+ * bs_strbuilder_init(&sb, buf, sizeof(buf));
+ * BS_STRBUILDER_APPEND_LITERAL(&sb, "count=");
+ * bs_strbuilder_append_int64(&sb, count);
+ * puts(bs_strbuilder_str(&sb));
+ * bs_strbuilder_fini(&sb);
+ * ```
+ */
+typedef struct {
+    /** The string. Points to `initial_buf_ptr`, or to an allocated buffer. */
+    char                      *buf_ptr;
+    /** Length of the string, without the terminating NUL. */
+    size_t                    len;
+    /** Size of `buf_ptr`. 0 for an empty builder without buffer. */
+    size_t                    size;
+    /** The caller-provided buffer. May be NULL. */
+    char                      *initial_buf_ptr;
+    /** Size of `initial_buf_ptr`. */
+    size_t                    initial_size;
+    /** Whether an allocation failed. */
+    bool                      failed;
+} bs_strbuilder_t;
+
+/**
+ * Initializes the string builder, with the string empty.
+ *
+ * @param sb_ptr
+ * @param initial_buf_ptr     Optional. Buffer to build in, before allocating.
+ *                            Must outlive the builder.
+ * @param initial_size        Size of `initial_buf_ptr`.
+ */
+void bs_strbuilder_init(bs_strbuilder_t *sb_ptr,
+                        char *initial_buf_ptr,
+                        size_t initial_size);
+
+/**
+ * Releases the allocated buffer, if any. The builder must be initialized
+ * again, before further use.
+ */
+void bs_strbuilder_fini(bs_strbuilder_t *sb_ptr);
+
+/** Empties the string. Retains the buffer, and clears the failed flag. */
+void bs_strbuilder_reset(bs_strbuilder_t *sb_ptr);
+
+/** Returns the NUL-terminated string. Valid until the next modification. */
+const char *bs_strbuilder_str(const bs_strbuilder_t *sb_ptr);
+
+/** Returns the length of the string, not counting the terminating NUL. */
+size_t bs_strbuilder_len(const bs_strbuilder_t *sb_ptr);
+
+/** Returns whether an allocation failed, and appends got dropped. */
+bool bs_strbuilder_failed(const bs_strbuilder_t *sb_ptr);
+
+/**
+ * Takes the string out of the builder, which is reset and empty afterwards.
+ *
+ * The string is handed over as-is if it lives in an allocated buffer. If it
+ * is still in the initial buffer, it is copied.
+ *
+ * @return The string, to be released by free(3). NULL on error, or if the
+ *     builder had failed.
+ */
+char *bs_strbuilder_steal(bs_strbuilder_t *sb_ptr);
+
+/** Appends `len` bytes from `ptr`. Returns false if the builder failed. */
+bool bs_strbuilder_append_n(bs_strbuilder_t *sb_ptr,
+                            const char *ptr,
+                            size_t len);
+
+/** Appends the NUL-terminated `str_ptr`. */
+bool bs_strbuilder_append(bs_strbuilder_t *sb_ptr, const char *str_ptr);
+
+/** Appends a string literal, without computing its length at runtime. */
+#define BS_STRBUILDER_APPEND_LITERAL(_sb_ptr, _literal)                 \
+    bs_strbuilder_append_n((_sb_ptr), "" _literal, sizeof(_literal) - 1)
+
+/** Appends a single character. */
+bool bs_strbuilder_append_char(bs_strbuilder_t *sb_ptr, char c);
+
+/** Appends `value` in decimal. See @ref bs_strformat_int64. */
+bool bs_strbuilder_append_int64(bs_strbuilder_t *sb_ptr, int64_t value);
+
+/** Appends `value` in decimal. See @ref bs_strformat_uint64. */
+bool bs_strbuilder_append_uint64(bs_strbuilder_t *sb_ptr, uint64_t value);
+
+/** Appends a formatted string. See printf(3). */
+bool bs_strbuilder_appendf(
+    bs_strbuilder_t *sb_ptr,
+    const char *fmt_ptr, ...) __ARG_PRINTF__(2, 3);
+
+/** Same as @ref bs_strbuilder_appendf, with a va_list argument. */
+bool bs_strbuilder_vappendf(
+    bs_strbuilder_t *sb_ptr,
+    const char *fmt_ptr,
+    va_list ap) __ARG_PRINTF__(2, 0);
+
 /** Test cases. */
 extern const bs_test_case_t   bs_strutil_test_cases[];
 
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_strutil_benchmarks[];
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
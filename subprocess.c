@@ -20,6 +20,8 @@
 
 /// kill(2) is a POSIX extension, and we can't do IPC without it.
 #define _POSIX_C_SOURCE 200809L
+/// syscall(2), for pidfd_open(2).
+#define _DEFAULT_SOURCE
 
 #include "subprocess.h"
 
@@ -28,19 +30,33 @@
 #include <errno.h>
 #include <poll.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <regex.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include "arena.h"
 #include "assert.h"
+#include "dllist.h"
 #include "log.h"
 #include "log_wrappers.h"
 #include "sock.h"
+#include "trace.h"
 
+#undef _DEFAULT_SOURCE
 #undef _POSIX_C_SOURCE
 
+#if !defined(SYS_pidfd_open)
+/** pidfd_open(2) has the same number on all architectures, except alpha. */
+#define SYS_pidfd_open 434
+#endif  // !defined(SYS_pidfd_open)
+
+/** The environment of the calling process. See environ(7). */
+extern char **environ;
+
 /* == Definitions ========================================================== */
 
 /** Local type, describes an environment variable. Non-const. */
@@ -51,8 +67,22 @@ typedef struct {
     char *value_ptr;
 } _env_var_t;
 
+typedef struct _managed_t _managed_t;
+
+/** Captured output of stdout or stderr. */
+typedef struct {
+    /** The buffer. Holds `capacity` chars and a terminating NUL. */
+    char                      *buf_ptr;
+    /** Number of chars stored in `buf_ptr`. */
+    size_t                    pos;
+    /** Capacity of `buf_ptr`. Grows up to `max_size` of the subprocess. */
+    size_t                    capacity;
+} _capture_t;
+
 /** Subprocess handle. */
 struct _bs_subprocess_t {
+    /** Arena holding `file_ptr`, `argv_ptr` and `env_vars_ptr`. */
+    bs_arena_t                *arena_ptr;
     /** Name of the executable to execute in the subprocess. */
     char                      *file_ptr;
     /**
@@ -61,7 +91,7 @@ struct _bs_subprocess_t {
      */
     char                      **argv_ptr;
     /** Environment variables. */
-    _env_var_t                 *env_vars_ptr;
+    _env_var_t                *env_vars_ptr;
 
     /** Will be non-zero when a child process is running. */
     pid_t                     pid;
@@ -77,18 +107,70 @@ struct _bs_subprocess_t {
     int                       stdout_read;
     /** File descriptor for stderr (read) */
     int                       stderr_read;
-    /** Points to the buffer for stdout */
-    char                      *stdout_buf_ptr;
-    /** Position within `stdout_buf_ptr`. */
-    size_t                    stdout_pos;
-    /** Size of `stdout_buf_ptr`. */
-    size_t                    stdout_size;
-    /** Points to the buffer for stderr */
-    char                      *stderr_buf_ptr;
-    /** Position within `stderr_buf_ptr`. */
-    size_t                    stderr_pos;
-    /** Size of `stderr_buf_ptr`. */
-    size_t                    stderr_size;
+    /** Captured output, for stdout and stderr. */
+    _capture_t                captures[2];
+    /** How output is captured, see @ref bs_subprocess_set_capture. */
+    bs_subprocess_capture_mode_t capture_mode;
+    /** Maximum size of each capture buffer. */
+    size_t                    capture_max_size;
+    /** Streaming callback for output. May be NULL. */
+    bs_subprocess_output_callback_t output_callback;
+    /** Argument to `output_callback`. */
+    void                      *output_ud_ptr;
+
+    /** Registration with a @ref bs_subprocess_manager_t, or NULL. */
+    _managed_t                *managed_ptr;
+};
+
+/** What a file descriptor, watched by the manager, is for. */
+typedef enum {
+    _WATCH_STDOUT,
+    _WATCH_STDERR,
+    _WATCH_PIDFD
+} _watch_type_t;
+
+/** A file descriptor in the manager's epoll set. */
+typedef struct {
+    /** Back-link to the registration. */
+    _managed_t                *managed_ptr;
+    /** What the file descriptor is for. */
+    _watch_type_t             type;
+    /** The file descriptor. */
+    int                       fd;
+    /** Whether `fd` is currently in the epoll set. */
+    bool                      registered;
+} _watch_t;
+
+/** Registration of a subprocess with a @ref bs_subprocess_manager_t. */
+struct _managed_t {
+    /** Node within `managed` or `released` of the manager. */
+    bs_dllist_node_t          dlnode;
+    /** Back-link to the manager. */
+    bs_subprocess_manager_t   *manager_ptr;
+    /** The registered subprocess. NULL once released. */
+    bs_subprocess_t           *subprocess_ptr;
+    /** Callback for when the subprocess has terminated. */
+    bs_subprocess_terminated_callback_t callback;
+    /** Argument to `callback`. */
+    void                      *ud_ptr;
+    /** Watches for stdout, stderr and the pidfd. */
+    _watch_t                  watches[3];
+};
+
+/** State of the subprocess manager. */
+struct _bs_subprocess_manager_t {
+    /** The epoll(7) file descriptor. */
+    int                       epoll_fd;
+    /** Registered subprocesses, as @ref _managed_t. */
+    bs_dllist_t               managed;
+    /**
+     * Registrations released during @ref bs_subprocess_manager_dispatch.
+     * Events of the current batch may still point to them, hence they are
+     * only freed once the batch is handled.
+     */
+    bs_dllist_t               released;
+    /** Whether @ref bs_subprocess_manager_dispatch is handling events. */
+    bool                      dispatching;
 };
 
 /** Deterministic Finite Automation transition. */
@@ -100,33 +182,60 @@ typedef struct {
 } dfa_transition_t;
 
 static bs_subprocess_t *_subprocess_create_argv(
+    bs_arena_t *arena_ptr,
     char **argv_ptr,
     _env_var_t *env_vars_ptr);
+static bool _subprocess_start(bs_subprocess_t *subprocess_ptr,
+                              bool use_spawn);
+static bool _subprocess_spawn(
+    bs_subprocess_t *subprocess_ptr,
+    int stdin_read, int stdout_write, int stderr_write);
+static bool _spawn_add_fd_actions(
+    posix_spawn_file_actions_t *actions_ptr,
+    int fd, int child_fd);
+static char **_create_envp(bs_arena_t *arena_ptr,
+                           const _env_var_t *env_vars_ptr);
 static int _waitpid_nointr(bs_subprocess_t *subprocess_ptr, bool wait);
 static void _close_fd(int *fd_ptr);
 static bool _create_pipe_fds(int *read_fd_ptr, int *write_fd_ptr);
 static void _flush_stdout_stderr(bs_subprocess_t *subprocess_ptr);
+static bool _capture_init(_capture_t *capture_ptr, size_t capacity);
+static bool _capture_drain(bs_subprocess_t *subprocess_ptr,
+                           bs_subprocess_stream_t stream,
+                           int fd);
+static bool _watch_register(int epoll_fd, _watch_t *watch_ptr);
+static void _watch_unregister(int epoll_fd, _watch_t *watch_ptr);
+static bool _managed_drain(_managed_t *managed_ptr, _watch_t *watch_ptr);
+static bool _managed_reap(_managed_t *managed_ptr);
+static void _managed_release(_managed_t *managed_ptr);
 static void _subprocess_child(
     bs_subprocess_t *subprocess_ptr,
     int stdin_read, int stdout_write, int stderr_write);
 
 static char **_split_command(
+    bs_arena_t *arena_ptr,
     const char *cmd_ptr,
     _env_var_t **env_var_ptr_ptr);
-static char *_split_next_token(const char *word_ptr, const char **next_ptr);
-static void _free_argv_list(char **argv_ptr);
-static void _free_env_var_list(_env_var_t *env_var_ptr);
+static const char *_split_next_token(
+    const char *word_ptr,
+    char **token_ptr_ptr);
+static size_t _variable_name_length(const char *word_ptr);
 static bool _populate_env_var(
+    bs_arena_t *arena_ptr,
     _env_var_t *env_var_ptr,
     const char *name_ptr,
     size_t name_len,
     const char *value_ptr);
 static bool _is_variable_assignment(
+    bs_arena_t *arena_ptr,
     const char *word_ptr,
     _env_var_t *env_variable_ptr);
 
 /* == Data ================================================================ */
 
+/** Initial size of the capture buffers, and default maximum size. */
+static const size_t           _capture_initial_size = 4096;
+
 /** character types, for the DFA table. */
 static const int8_t            char_type_alpha = 0;
 static const int8_t            char_type_blank = 1;
@@ -191,22 +300,29 @@ bs_subprocess_t *bs_subprocess_create(
 {
     char **full_argv_ptr;
 
+    // All strings and lists live in the arena, and are released together.
+    bs_arena_t *arena_ptr = bs_arena_create(0);
+    if (NULL == arena_ptr) return NULL;
+
     size_t argv_size = 0;
     while (NULL != argv_ptr[argv_size]) ++argv_size;
     // Don't forget to alloc space for the sentinel NULL and file_ptr.
-    full_argv_ptr = (char**)logged_calloc(argv_size + 2, sizeof(char*));
-    if (NULL == full_argv_ptr) return NULL;
+    full_argv_ptr = bs_arena_calloc(arena_ptr, argv_size + 2, sizeof(char*));
+    if (NULL == full_argv_ptr) {
+        bs_arena_destroy(arena_ptr);
+        return NULL;
+    }
 
-    full_argv_ptr[0] = logged_strdup(file_ptr);
+    full_argv_ptr[0] = bs_arena_strdup(arena_ptr, file_ptr);
     if (NULL == full_argv_ptr[0]) {
-        _free_argv_list(full_argv_ptr);
+        bs_arena_destroy(arena_ptr);
         return NULL;
     }
 
     for (size_t i = 0; i < argv_size; ++i) {
-        full_argv_ptr[i + 1] = logged_strdup(argv_ptr[i]);
+        full_argv_ptr[i + 1] = bs_arena_strdup(arena_ptr, argv_ptr[i]);
         if (NULL == full_argv_ptr[i + 1]) {
-            _free_argv_list(full_argv_ptr);
+            bs_arena_destroy(arena_ptr);
             return NULL;
         }
     }
@@ -215,132 +331,87 @@ bs_subprocess_t *bs_subprocess_create(
     if (NULL != env_vars_ptr) {
         size_t env_var_size = 0;
         while (NULL != env_vars_ptr[env_var_size].name_ptr) ++env_var_size;
-        env_var_ptr = logged_calloc(env_var_size + 1, sizeof(_env_var_t));
+        env_var_ptr = bs_arena_calloc(
+            arena_ptr, env_var_size + 1, sizeof(_env_var_t));
         if (NULL == env_var_ptr) {
-            _free_argv_list(full_argv_ptr);
+            bs_arena_destroy(arena_ptr);
             return NULL;
         }
 
         for (size_t i = 0; i < env_var_size; ++i) {
             if (!_populate_env_var(
+                    arena_ptr,
                     env_var_ptr + i,
                     env_vars_ptr[i].name_ptr,
                     strlen(env_vars_ptr[i].name_ptr),
                     env_vars_ptr[i].value_ptr)) {
-                _free_env_var_list(env_var_ptr);
-                _free_argv_list(full_argv_ptr);
+                bs_arena_destroy(arena_ptr);
                 return NULL;
             }
         }
     }
 
-
-    return _subprocess_create_argv(full_argv_ptr, env_var_ptr);
+    return _subprocess_create_argv(arena_ptr, full_argv_ptr, env_var_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
 bs_subprocess_t *bs_subprocess_create_cmdline(
     const char *cmdline_ptr)
 {
+    bs_arena_t *arena_ptr = bs_arena_create(0);
+    if (NULL == arena_ptr) return NULL;
+
     _env_var_t *env_var_ptr = NULL;
-    char **argv_ptr = _split_command(cmdline_ptr, &env_var_ptr);
+    char **argv_ptr = _split_command(arena_ptr, cmdline_ptr, &env_var_ptr);
     if (NULL == argv_ptr) {
-        bs_log(BS_ERROR, "Failed _split_command(%s)", cmdline_ptr);
+        bs_log(BS_ERROR, "Failed _split_command(%p, %s)",
+               arena_ptr, cmdline_ptr);
+        bs_arena_destroy(arena_ptr);
+        return NULL;
+    }
+    if (NULL == argv_ptr[0]) {
+        bs_log(BS_ERROR, "No executable in commandline \"%s\"", cmdline_ptr);
+        bs_arena_destroy(arena_ptr);
         return NULL;
     }
 
-    return _subprocess_create_argv(argv_ptr, env_var_ptr);
+    return _subprocess_create_argv(arena_ptr, argv_ptr, env_var_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
 void bs_subprocess_destroy(bs_subprocess_t *subprocess_ptr)
 {
+    bs_subprocess_manager_remove(subprocess_ptr);
     if (0 != subprocess_ptr->pid) {
         bs_subprocess_stop(subprocess_ptr);
     }
 
-    if (NULL != subprocess_ptr->stderr_buf_ptr) {
-        free(subprocess_ptr->stderr_buf_ptr);
-    }
-    if (NULL != subprocess_ptr->stdout_buf_ptr) {
-        free(subprocess_ptr->stdout_buf_ptr);
-    }
-
-    if (NULL != subprocess_ptr->env_vars_ptr) {
-        _free_env_var_list(subprocess_ptr->env_vars_ptr);
-        subprocess_ptr->env_vars_ptr = NULL;
-    }
-
-    if (NULL != subprocess_ptr->argv_ptr) {
-        _free_argv_list(subprocess_ptr->argv_ptr);
-        // If argv_ptr was created, then file_ptr was argv_ptr[0], and thus it
-        // was already free()-ed.
-        subprocess_ptr->file_ptr = NULL;
+    for (int i = 0; i < 2; ++i) {
+        if (NULL != subprocess_ptr->captures[i].buf_ptr) {
+            logged_free(subprocess_ptr->captures[i].buf_ptr);
+        }
     }
 
-    if (NULL != subprocess_ptr->file_ptr) {
-        free(subprocess_ptr->file_ptr);
+    // File, arguments and environment variables all live in the arena.
+    if (NULL != subprocess_ptr->arena_ptr) {
+        bs_arena_destroy(subprocess_ptr->arena_ptr);
+        subprocess_ptr->arena_ptr = NULL;
     }
 
-    free(subprocess_ptr);
+    logged_free(subprocess_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
 bool bs_subprocess_start(bs_subprocess_t *subprocess_ptr)
 {
-    int stdin_read = -1, stdout_write = -1, stderr_write = -1;
-
-    if (0 != subprocess_ptr->pid) {
-        bs_log(BS_ERROR, "Already a running subprocess, pid %d",
-               subprocess_ptr->pid);
-        return false;
-    }
-
-    if (_create_pipe_fds(&stdin_read, &subprocess_ptr->stdin_write) &&
-        _create_pipe_fds(&subprocess_ptr->stdout_read, &stdout_write) &&
-        _create_pipe_fds(&subprocess_ptr->stderr_read, &stderr_write)) {
-
-        subprocess_ptr->pid = fork();
-        if (0 == subprocess_ptr->pid) {
-            _subprocess_child(subprocess_ptr,
-                              stdin_read, stdout_write, stderr_write);
-
-            // Will never return, hence not reach this line.
-            abort();
-        }
-    }
-
-    // No matter what, we clean up descriptors for the child side.
-    if (-1 != stdin_read) _close_fd(&stdin_read);
-    if (-1 != stdout_write) _close_fd(&stdout_write);
-    if (-1 != stderr_write) _close_fd(&stderr_write);
-
-    subprocess_ptr->stdout_pos = 0;
-    subprocess_ptr->stderr_pos = 0;
-
-    // All worked -- go ahead.
-    if (0 < subprocess_ptr->pid) {
-        bs_sock_set_blocking(subprocess_ptr->stdout_read, false);
-        bs_sock_set_blocking(subprocess_ptr->stderr_read, false);
-        return true;
-    }
-
-    // There was a failure. Clean up descriptors on the parent side.
-    if (-1 != subprocess_ptr->stdin_write) {
-        _close_fd(&subprocess_ptr->stdin_write);
-    }
-    if (-1 != subprocess_ptr->stdout_read) {
-        _close_fd(&subprocess_ptr->stdout_read);
-    }
-    if (-1 != subprocess_ptr->stderr_read) {
-        _close_fd(&subprocess_ptr->stderr_read);
-    }
-    return false;
+    return _subprocess_start(subprocess_ptr, true);
 }
 
 /* ------------------------------------------------------------------------- */
 void bs_subprocess_stop(bs_subprocess_t *subprocess_ptr)
 {
+    bs_subprocess_manager_remove(subprocess_ptr);
+
     if (0 != subprocess_ptr->pid) {
         // The child process is apparently still up. Send a KILL signal.
         if (0 != kill(subprocess_ptr->pid, SIGKILL)) {
@@ -416,20 +487,279 @@ pid_t bs_subprocess_pid(bs_subprocess_t *subprocess_ptr)
 /* ------------------------------------------------------------------------- */
 const char *bs_subprocess_stdout(const bs_subprocess_t *subprocess_ptr)
 {
-    return subprocess_ptr->stdout_buf_ptr;
+    return subprocess_ptr->captures[BS_SUBPROCESS_STDOUT].buf_ptr;
 }
 
 /* ------------------------------------------------------------------------- */
 const char *bs_subprocess_stderr(const bs_subprocess_t *subprocess_ptr)
 {
-    return subprocess_ptr->stderr_buf_ptr;
+    return subprocess_ptr->captures[BS_SUBPROCESS_STDERR].buf_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_subprocess_stdout_size(const bs_subprocess_t *subprocess_ptr)
+{
+    return subprocess_ptr->captures[BS_SUBPROCESS_STDOUT].pos;
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_subprocess_stderr_size(const bs_subprocess_t *subprocess_ptr)
+{
+    return subprocess_ptr->captures[BS_SUBPROCESS_STDERR].pos;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_subprocess_set_capture(
+    bs_subprocess_t *subprocess_ptr,
+    bs_subprocess_capture_mode_t mode,
+    size_t max_size,
+    bs_subprocess_output_callback_t callback,
+    void *ud_ptr)
+{
+    if (0 != subprocess_ptr->pid) {
+        bs_log(BS_ERROR, "Cannot set capture on running subprocess, pid %d",
+               subprocess_ptr->pid);
+        return false;
+    }
+
+    // Starts small, and grows geometrically when output arrives.
+    for (int i = 0; i < 2; ++i) {
+        if (!_capture_init(&subprocess_ptr->captures[i],
+                           BS_MIN(max_size, _capture_initial_size))) {
+            return false;
+        }
+    }
+    subprocess_ptr->capture_mode = mode;
+    subprocess_ptr->capture_max_size = max_size;
+    subprocess_ptr->output_callback = callback;
+    subprocess_ptr->output_ud_ptr = ud_ptr;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+bs_subprocess_manager_t *bs_subprocess_manager_create(void)
+{
+    bs_subprocess_manager_t *manager_ptr = logged_calloc(
+        1, sizeof(bs_subprocess_manager_t));
+    if (NULL == manager_ptr) return NULL;
+
+    manager_ptr->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (0 > manager_ptr->epoll_fd) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed epoll_create1(EPOLL_CLOEXEC)");
+        logged_free(manager_ptr);
+        return NULL;
+    }
+    return manager_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_subprocess_manager_destroy(bs_subprocess_manager_t *manager_ptr)
+{
+    bs_dllist_node_t *dlnode_ptr;
+    while (NULL != (dlnode_ptr = manager_ptr->managed.head_ptr)) {
+        _managed_t *managed_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, _managed_t, dlnode);
+        _managed_release(managed_ptr);
+    }
+    _close_fd(&manager_ptr->epoll_fd);
+    logged_free(manager_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_subprocess_manager_add(
+    bs_subprocess_manager_t *manager_ptr,
+    bs_subprocess_t *subprocess_ptr,
+    bs_subprocess_terminated_callback_t callback,
+    void *ud_ptr)
+{
+    if (0 == subprocess_ptr->pid) {
+        bs_log(BS_ERROR, "Subprocess %p is not running", subprocess_ptr);
+        return false;
+    }
+    if (NULL != subprocess_ptr->managed_ptr) {
+        bs_log(BS_ERROR, "Subprocess %p is already managed by %p",
+               subprocess_ptr, subprocess_ptr->managed_ptr->manager_ptr);
+        return false;
+    }
+
+    _managed_t *managed_ptr = logged_calloc(1, sizeof(_managed_t));
+    if (NULL == managed_ptr) return false;
+    managed_ptr->manager_ptr = manager_ptr;
+    managed_ptr->subprocess_ptr = subprocess_ptr;
+    managed_ptr->callback = callback;
+    managed_ptr->ud_ptr = ud_ptr;
+    const int fds[3] = {
+        subprocess_ptr->stdout_read,
+        subprocess_ptr->stderr_read,
+        (int)syscall(SYS_pidfd_open, subprocess_ptr->pid, 0) };
+    for (int i = 0; i < 3; ++i) {
+        managed_ptr->watches[i].managed_ptr = managed_ptr;
+        managed_ptr->watches[i].type = (_watch_type_t)i;
+        managed_ptr->watches[i].fd = fds[i];
+    }
+    if (0 > fds[_WATCH_PIDFD]) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed pidfd_open(%d, 0)",
+               subprocess_ptr->pid);
+        logged_free(managed_ptr);
+        return false;
+    }
+    subprocess_ptr->managed_ptr = managed_ptr;
+    bs_dllist_push_back(&manager_ptr->managed, &managed_ptr->dlnode);
+
+    for (int i = 0; i < 3; ++i) {
+        if (!_watch_register(manager_ptr->epoll_fd,
+                             &managed_ptr->watches[i])) {
+            _managed_release(managed_ptr);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_subprocess_manager_remove(bs_subprocess_t *subprocess_ptr)
+{
+    if (NULL == subprocess_ptr->managed_ptr) return;
+    _managed_release(subprocess_ptr->managed_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+size_t bs_subprocess_manager_size(bs_subprocess_manager_t *manager_ptr)
+{
+    return bs_dllist_size(&manager_ptr->managed);
+}
+
+/* ------------------------------------------------------------------------- */
+int bs_subprocess_manager_fd(bs_subprocess_manager_t *manager_ptr)
+{
+    return manager_ptr->epoll_fd;
+}
+
+/* ------------------------------------------------------------------------- */
+int bs_subprocess_manager_dispatch(bs_subprocess_manager_t *manager_ptr,
+                                   int timeout_msec)
+{
+    struct epoll_event        events[64];
+    int                       events_size;
+
+    do {
+        events_size = epoll_wait(manager_ptr->epoll_fd, events, 64,
+                                 timeout_msec);
+    } while (0 > events_size && EINTR == errno);
+    if (0 > events_size) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed epoll_wait(%d, %p, 64, %d)",
+               manager_ptr->epoll_fd, events, timeout_msec);
+        return -1;
+    }
+
+    int terminated = 0;
+    manager_ptr->dispatching = true;
+    for (int i = 0; i < events_size; ++i) {
+        _watch_t *watch_ptr = events[i].data.ptr;
+        _managed_t *managed_ptr = watch_ptr->managed_ptr;
+        // Released by an earlier event or callback of this batch.
+        if (NULL == managed_ptr->subprocess_ptr) continue;
+
+        if (_WATCH_PIDFD == watch_ptr->type) {
+            if (_managed_reap(managed_ptr)) ++terminated;
+        } else if (watch_ptr->registered &&
+                   !_managed_drain(managed_ptr, watch_ptr)) {
+            // End of file: No more output. Stop watching, to not spin.
+            _watch_unregister(manager_ptr->epoll_fd, watch_ptr);
+        }
+    }
+    manager_ptr->dispatching = false;
+
+    bs_dllist_node_t *dlnode_ptr;
+    while (NULL != (dlnode_ptr = bs_dllist_pop_front(
+                        &manager_ptr->released))) {
+        _managed_t *managed_ptr = BS_CONTAINER_OF(
+            dlnode_ptr, _managed_t, dlnode);
+        logged_free(managed_ptr);
+    }
+    return terminated;
 }
 
 /* == Local methods ======================================================== */
 
 /* ------------------------------------------------------------------------- */
-/** Creates the subprocess from |argv_ptr|. argv_ptr[0] is the executable. */
+/**
+ * Starts the sub-process. See @ref bs_subprocess_start.
+ *
+ * @param subprocess_ptr
+ * @param use_spawn           Whether to try posix_spawnp(3) first. If not
+ *                            set, or if spawning fails, uses fork(2).
+ *
+ * @return Whether the call succeeded.
+ */
+bool _subprocess_start(bs_subprocess_t *subprocess_ptr, bool use_spawn)
+{
+    BS_TRACE_SCOPE("bs_subprocess_start");
+    int stdin_read = -1, stdout_write = -1, stderr_write = -1;
+
+    if (0 != subprocess_ptr->pid) {
+        bs_log(BS_ERROR, "Already a running subprocess, pid %d",
+               subprocess_ptr->pid);
+        return false;
+    }
+    // A stale registration, if terminated but not yet dispatched.
+    bs_subprocess_manager_remove(subprocess_ptr);
+
+    if (_create_pipe_fds(&stdin_read, &subprocess_ptr->stdin_write) &&
+        _create_pipe_fds(&subprocess_ptr->stdout_read, &stdout_write) &&
+        _create_pipe_fds(&subprocess_ptr->stderr_read, &stderr_write) &&
+        (!use_spawn ||
+         !_subprocess_spawn(subprocess_ptr,
+                            stdin_read, stdout_write, stderr_write))) {
+
+        subprocess_ptr->pid = fork();
+        if (0 == subprocess_ptr->pid) {
+            _subprocess_child(subprocess_ptr,
+                              stdin_read, stdout_write, stderr_write);
+
+            // Will never return, hence not reach this line.
+            abort();
+        }
+    }
+
+    // No matter what, we clean up descriptors for the child side.
+    if (-1 != stdin_read) _close_fd(&stdin_read);
+    if (-1 != stdout_write) _close_fd(&stdout_write);
+    if (-1 != stderr_write) _close_fd(&stderr_write);
+
+    for (int i = 0; i < 2; ++i) {
+        subprocess_ptr->captures[i].pos = 0;
+        subprocess_ptr->captures[i].buf_ptr[0] = '\0';
+    }
+
+    // All worked -- go ahead.
+    if (0 < subprocess_ptr->pid) {
+        bs_sock_set_blocking(subprocess_ptr->stdout_read, false);
+        bs_sock_set_blocking(subprocess_ptr->stderr_read, false);
+        return true;
+    }
+
+    // There was a failure. Clean up descriptors on the parent side.
+    if (-1 != subprocess_ptr->stdin_write) {
+        _close_fd(&subprocess_ptr->stdin_write);
+    }
+    if (-1 != subprocess_ptr->stdout_read) {
+        _close_fd(&subprocess_ptr->stdout_read);
+    }
+    if (-1 != subprocess_ptr->stderr_read) {
+        _close_fd(&subprocess_ptr->stderr_read);
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Creates the subprocess from |argv_ptr|. argv_ptr[0] is the executable.
+ * Takes ownership of |arena_ptr|, which holds |argv_ptr| and |env_vars_ptr|.
+ * It will be destroyed on error, too.
+ */
 bs_subprocess_t *_subprocess_create_argv(
+    bs_arena_t *arena_ptr,
     char **argv_ptr,
     _env_var_t *env_vars_ptr)
 {
@@ -437,27 +767,25 @@ bs_subprocess_t *_subprocess_create_argv(
 
     subprocess_ptr = (bs_subprocess_t*)logged_calloc(
         1, sizeof(bs_subprocess_t));
-    if (NULL == subprocess_ptr) return NULL;
+    if (NULL == subprocess_ptr) {
+        bs_arena_destroy(arena_ptr);
+        return NULL;
+    }
+    subprocess_ptr->arena_ptr = arena_ptr;
     subprocess_ptr->file_ptr = argv_ptr[0];
     subprocess_ptr->argv_ptr = argv_ptr;
     subprocess_ptr->env_vars_ptr = env_vars_ptr;
 
-    // A buffer for stdout and stderr. Keep a char for a terminating NUL.
-    size_t buf_size = 4096;
-    subprocess_ptr->stdout_buf_ptr = malloc(buf_size + 1);
-    if (NULL == subprocess_ptr->stdout_buf_ptr) {
-        bs_log(BS_ERROR | BS_ERRNO, "Failed malloc(%zu)", buf_size + 1);
-        bs_subprocess_destroy(subprocess_ptr);
-        return NULL;
-    }
-    subprocess_ptr->stdout_size = buf_size;
-    subprocess_ptr->stderr_buf_ptr = malloc(buf_size + 1);
-    if (NULL == subprocess_ptr->stderr_buf_ptr) {
-        bs_log(BS_ERROR | BS_ERRNO, "Failed malloc(%zu)", buf_size + 1);
-        bs_subprocess_destroy(subprocess_ptr);
-        return NULL;
+    // By default, keeps the first 4096 bytes of stdout and stderr.
+    subprocess_ptr->capture_mode = BS_SUBPROCESS_CAPTURE_HEAD;
+    subprocess_ptr->capture_max_size = _capture_initial_size;
+    for (int i = 0; i < 2; ++i) {
+        if (!_capture_init(&subprocess_ptr->captures[i],
+                           _capture_initial_size)) {
+            bs_subprocess_destroy(subprocess_ptr);
+            return NULL;
+        }
     }
-    subprocess_ptr->stderr_size = buf_size;
 
     subprocess_ptr->stdin_write = -1;
     subprocess_ptr->stdout_read = -1;
@@ -505,50 +833,359 @@ int _waitpid_nointr(bs_subprocess_t *subprocess_ptr, bool wait)
                    subprocess_ptr->pid, status);
         }
     }
-    return rv;
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Helper: Close socket, log error, and invalidate |*fd_ptr|. */
+void _close_fd(int *fd_ptr)
+{
+    if (0 != close(*fd_ptr)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed close(%d)", *fd_ptr);
+    }
+    *fd_ptr = -1;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Helper: Reads all of stdout and stderr into the buffers. */
+void _flush_stdout_stderr(bs_subprocess_t *subprocess_ptr)
+{
+    _capture_drain(subprocess_ptr, BS_SUBPROCESS_STDOUT,
+                   subprocess_ptr->stdout_read);
+    _capture_drain(subprocess_ptr, BS_SUBPROCESS_STDERR,
+                   subprocess_ptr->stderr_read);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Helper: (Re)allocates the capture's buffer, empty, at `capacity`. */
+bool _capture_init(_capture_t *capture_ptr, size_t capacity)
+{
+    char *buf_ptr = realloc(capture_ptr->buf_ptr, capacity + 1);
+    if (NULL == buf_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed realloc(%p, %zu)",
+               capture_ptr->buf_ptr, capacity + 1);
+        return false;
+    }
+    capture_ptr->buf_ptr = buf_ptr;
+    capture_ptr->buf_ptr[0] = '\0';
+    capture_ptr->pos = 0;
+    capture_ptr->capacity = capacity;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Helper: Reads from `fd` until it would block. Passes each chunk to the
+ * output callback, and stores it as configured by the capture mode.
+ *
+ * Grows the buffer geometrically, up to the maximum size, so that reads
+ * remain large and few. Once at the maximum, reads go to a local buffer.
+ * To keep file descriptors from spinning when they are level-triggered,
+ * data beyond the capture is read as well, and discarded.
+ *
+ * @param subprocess_ptr
+ * @param stream
+ * @param fd
+ *
+ * @return false on end of file, or on error.
+ */
+bool _capture_drain(bs_subprocess_t *subprocess_ptr,
+                    bs_subprocess_stream_t stream,
+                    int fd)
+{
+    _capture_t *capture_ptr = &subprocess_ptr->captures[stream];
+    char local_buf[16384];
+
+    for (;;) {
+        size_t max_size = subprocess_ptr->capture_max_size;
+        if (capture_ptr->capacity - capture_ptr->pos < sizeof(local_buf) &&
+            capture_ptr->capacity < max_size) {
+            size_t capacity = BS_MIN(
+                BS_MAX(2 * capture_ptr->capacity, _capture_initial_size),
+                max_size);
+            char *buf_ptr = realloc(capture_ptr->buf_ptr, capacity + 1);
+            if (NULL != buf_ptr) {
+                capture_ptr->buf_ptr = buf_ptr;
+                capture_ptr->capacity = capacity;
+            } else {
+                bs_log(BS_WARNING | BS_ERRNO, "Failed realloc(%p, %zu)",
+                       capture_ptr->buf_ptr, capacity + 1);
+            }
+        }
+
+        char *dest_ptr = local_buf;
+        size_t dest_size = sizeof(local_buf);
+        if (capture_ptr->pos < capture_ptr->capacity) {
+            dest_ptr = capture_ptr->buf_ptr + capture_ptr->pos;
+            dest_size = capture_ptr->capacity - capture_ptr->pos;
+        }
+
+        ssize_t read_bytes = read(fd, dest_ptr, dest_size);
+        if (0 > read_bytes) {
+            if (EINTR == errno) continue;
+            if (EAGAIN == errno || EWOULDBLOCK == errno) return true;
+            bs_log(BS_ERROR | BS_ERRNO, "Failed read(%d, %p, %zu)",
+                   fd, dest_ptr, dest_size);
+            return false;
+        }
+        if (0 == read_bytes) return false;
+        size_t size = read_bytes;
+
+        if (NULL != subprocess_ptr->output_callback) {
+            subprocess_ptr->output_callback(
+                subprocess_ptr, stream, dest_ptr, size,
+                subprocess_ptr->output_ud_ptr);
+        }
+
+        if (dest_ptr != local_buf) {
+            capture_ptr->pos += size;
+        } else if (BS_SUBPROCESS_CAPTURE_TAIL == subprocess_ptr->capture_mode &&
+                   0 < capture_ptr->capacity) {
+            // Full: Drops the oldest output, to make room for the chunk.
+            size_t keep = capture_ptr->capacity - BS_MIN(
+                size, capture_ptr->capacity);
+            memmove(capture_ptr->buf_ptr,
+                    capture_ptr->buf_ptr + capture_ptr->capacity - keep,
+                    keep);
+            memcpy(capture_ptr->buf_ptr + keep,
+                   local_buf + size - (capture_ptr->capacity - keep),
+                   capture_ptr->capacity - keep);
+        }
+        capture_ptr->buf_ptr[capture_ptr->pos] = '\0';
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Launches the child through posix_spawnp(3), which uses vfork(2) or
+ * clone(CLONE_VM|CLONE_VFORK) and does not copy the parent's page tables.
+ * That keeps the launch fast, even for a parent with a large address space.
+ *
+ * Returns false if the child was not launched. The caller then falls back
+ * to fork(2): That is the case if the environment overrides PATH, since
+ * posix_spawnp(3) looks up the executable from the parent's PATH; and if
+ * the executable could not be run, so that the child logs the error on
+ * stderr and aborts, same as through fork(2).
+ *
+ * @param subprocess_ptr
+ * @param stdin_read
+ * @param stdout_write
+ * @param stderr_write
+ *
+ * @return true if the child was launched, and `pid` is set.
+ */
+bool _subprocess_spawn(
+    bs_subprocess_t *subprocess_ptr,
+    int stdin_read, int stdout_write, int stderr_write)
+{
+    for (const _env_var_t *var_ptr = subprocess_ptr->env_vars_ptr;
+         NULL != var_ptr && NULL != var_ptr->name_ptr;
+         ++var_ptr) {
+        if (0 == strcmp(var_ptr->name_ptr, "PATH")) return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    int rv = posix_spawn_file_actions_init(&actions);
+    if (0 != rv) {
+        errno = rv;
+        bs_log(BS_WARNING | BS_ERRNO,
+               "Failed posix_spawn_file_actions_init(%p)", &actions);
+        return false;
+    }
+
+    // The environment is built in a transient arena, released after spawn.
+    bs_arena_t *arena_ptr = bs_arena_create(0);
+    char **envp = NULL;
+    if (NULL != arena_ptr) {
+        envp = _create_envp(arena_ptr, subprocess_ptr->env_vars_ptr);
+    }
+
+    pid_t pid = 0;
+    rv = -1;
+    if (NULL != envp &&
+        _spawn_add_fd_actions(&actions, stdin_read, 0) &&
+        _spawn_add_fd_actions(&actions, stdout_write, 1) &&
+        _spawn_add_fd_actions(&actions, stderr_write, 2) &&
+        0 == posix_spawn_file_actions_addclose(
+            &actions, subprocess_ptr->stdin_write) &&
+        0 == posix_spawn_file_actions_addclose(
+            &actions, subprocess_ptr->stdout_read) &&
+        0 == posix_spawn_file_actions_addclose(
+            &actions, subprocess_ptr->stderr_read)) {
+        rv = posix_spawnp(&pid, subprocess_ptr->file_ptr, &actions, NULL,
+                          subprocess_ptr->argv_ptr, envp);
+        if (0 != rv) {
+            errno = rv;
+            bs_log(BS_DEBUG | BS_ERRNO, "Failed posix_spawnp(%s, %p), "
+                   "falling back to fork()",
+                   subprocess_ptr->file_ptr, subprocess_ptr->argv_ptr);
+        }
+    }
+
+    if (NULL != arena_ptr) bs_arena_destroy(arena_ptr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (0 != rv) return false;
+    subprocess_ptr->pid = pid;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Helper: Adds actions to make `fd` become `child_fd` in the child. */
+bool _spawn_add_fd_actions(
+    posix_spawn_file_actions_t *actions_ptr,
+    int fd, int child_fd)
+{
+    int rv = posix_spawn_file_actions_adddup2(actions_ptr, fd, child_fd);
+    if (0 == rv && fd != child_fd) {
+        rv = posix_spawn_file_actions_addclose(actions_ptr, fd);
+    }
+    if (0 != rv) {
+        errno = rv;
+        bs_log(BS_WARNING | BS_ERRNO, "Failed adding actions for fd %d", fd);
+        return false;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Creates a NULL-terminated environment for the child: The caller's
+ * `environ`, with the variables of `env_vars_ptr` added or replaced.
+ *
+ * @param arena_ptr           Arena to allocate the environment from.
+ * @param env_vars_ptr        Sentinel-terminated variables. May be NULL.
+ *
+ * @return Pointer to the environment, or NULL on error.
+ */
+char **_create_envp(bs_arena_t *arena_ptr, const _env_var_t *env_vars_ptr)
+{
+    size_t environ_size = 0, env_vars_size = 0;
+    while (NULL != environ && NULL != environ[environ_size]) ++environ_size;
+    while (NULL != env_vars_ptr &&
+           NULL != env_vars_ptr[env_vars_size].name_ptr) ++env_vars_size;
+
+    char **envp = bs_arena_calloc(
+        arena_ptr, environ_size + env_vars_size + 1, sizeof(char*));
+    if (NULL == envp) return NULL;
+
+    size_t envp_size = 0;
+    for (size_t i = 0; i < environ_size; ++i) {
+        bool replaced = false;
+        for (size_t v = 0; v < env_vars_size && !replaced; ++v) {
+            size_t len = strlen(env_vars_ptr[v].name_ptr);
+            replaced = (0 == strncmp(environ[i], env_vars_ptr[v].name_ptr,
+                                     len) && '=' == environ[i][len]);
+        }
+        if (!replaced) envp[envp_size++] = environ[i];
+    }
+
+    for (size_t v = 0; v < env_vars_size; ++v) {
+        size_t name_len = strlen(env_vars_ptr[v].name_ptr);
+        size_t value_len = strlen(env_vars_ptr[v].value_ptr);
+        char *var_ptr = bs_arena_alloc(arena_ptr, name_len + value_len + 2);
+        if (NULL == var_ptr) return NULL;
+        memcpy(var_ptr, env_vars_ptr[v].name_ptr, name_len);
+        var_ptr[name_len] = '=';
+        memcpy(var_ptr + name_len + 1, env_vars_ptr[v].value_ptr,
+               value_len + 1);
+        envp[envp_size++] = var_ptr;
+    }
+    return envp;
 }
 
 /* ------------------------------------------------------------------------- */
-/** Helper: Close socket, log error, and invalidate |*fd_ptr|. */
-void _close_fd(int *fd_ptr)
+/** Helper: Adds the watch's file descriptor to the epoll set. */
+bool _watch_register(int epoll_fd, _watch_t *watch_ptr)
 {
-    if (0 != close(*fd_ptr)) {
-        bs_log(BS_WARNING | BS_ERRNO, "Failed close(%d)", *fd_ptr);
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = watch_ptr };
+    if (0 != epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watch_ptr->fd, &event)) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed epoll_ctl(%d, EPOLL_CTL_ADD, %d)",
+               epoll_fd, watch_ptr->fd);
+        return false;
     }
-    *fd_ptr = -1;
+    watch_ptr->registered = true;
+    return true;
 }
 
 /* ------------------------------------------------------------------------- */
-/** Helper: Reads all of stdout and stderr into the buffers. */
-void _flush_stdout_stderr(bs_subprocess_t *subprocess_ptr)
+/** Helper: Removes the watch's file descriptor from the epoll set. */
+void _watch_unregister(int epoll_fd, _watch_t *watch_ptr)
 {
-    ssize_t read_bytes;
+    if (!watch_ptr->registered) return;
+    if (0 != epoll_ctl(epoll_fd, EPOLL_CTL_DEL, watch_ptr->fd, NULL)) {
+        bs_log(BS_WARNING | BS_ERRNO,
+               "Failed epoll_ctl(%d, EPOLL_CTL_DEL, %d)",
+               epoll_fd, watch_ptr->fd);
+    }
+    watch_ptr->registered = false;
+}
 
-    read_bytes = read(
-        subprocess_ptr->stdout_read,
-        subprocess_ptr->stdout_buf_ptr + subprocess_ptr->stdout_pos,
-        subprocess_ptr->stdout_size - subprocess_ptr->stdout_pos);
-    if (0 > read_bytes && (EAGAIN != errno || EWOULDBLOCK != errno)) {
-        bs_log(BS_ERROR | BS_ERRNO, "Failed read(%d, %p, %zu)",
-               subprocess_ptr->stdout_read,
-               subprocess_ptr->stdout_buf_ptr + subprocess_ptr->stdout_pos,
-               subprocess_ptr->stdout_size - subprocess_ptr->stdout_pos);
-    } else if (0 <= read_bytes) {
-        subprocess_ptr->stdout_pos += read_bytes;
-        subprocess_ptr->stdout_buf_ptr[subprocess_ptr->stdout_pos] = '\0';
-    }
-    read_bytes = read(
-        subprocess_ptr->stderr_read,
-        subprocess_ptr->stderr_buf_ptr + subprocess_ptr->stderr_pos,
-        subprocess_ptr->stderr_size - subprocess_ptr->stderr_pos);
-    if (0 > read_bytes && (EAGAIN != errno || EWOULDBLOCK != errno)) {
-        bs_log(BS_ERROR | BS_ERRNO, "Failed read(%d, %p, %zu)",
-               subprocess_ptr->stderr_read,
-               subprocess_ptr->stderr_buf_ptr + subprocess_ptr->stderr_pos,
-               subprocess_ptr->stderr_size - subprocess_ptr->stderr_pos);
-    } else if (0 <= read_bytes) {
-        subprocess_ptr->stderr_pos += read_bytes;
-        subprocess_ptr->stderr_buf_ptr[subprocess_ptr->stderr_pos] = '\0';
+/* ------------------------------------------------------------------------- */
+/** Drains stdout or stderr of the managed subprocess. False on EOF. */
+bool _managed_drain(_managed_t *managed_ptr, _watch_t *watch_ptr)
+{
+    return _capture_drain(
+        managed_ptr->subprocess_ptr,
+        _WATCH_STDOUT == watch_ptr->type ?
+        BS_SUBPROCESS_STDOUT : BS_SUBPROCESS_STDERR,
+        watch_ptr->fd);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Reaps the managed subprocess, once its pidfd is readable. Drains any
+ * remaining output, releases the registration and invokes the callback.
+ *
+ * @param managed_ptr
+ *
+ * @return Whether the subprocess was reaped.
+ */
+bool _managed_reap(_managed_t *managed_ptr)
+{
+    bs_subprocess_t *subprocess_ptr = managed_ptr->subprocess_ptr;
+    // pid is 0 if bs_subprocess_terminated() had already reaped it.
+    if (0 != subprocess_ptr->pid) {
+        if (0 >= _waitpid_nointr(subprocess_ptr, false)) return false;
+        subprocess_ptr->pid = 0;
+    }
+
+    for (int i = _WATCH_STDOUT; i <= _WATCH_STDERR; ++i) {
+        _watch_t *watch_ptr = &managed_ptr->watches[i];
+        if (watch_ptr->registered) _managed_drain(managed_ptr, watch_ptr);
+    }
+
+    bs_subprocess_terminated_callback_t callback = managed_ptr->callback;
+    void *ud_ptr = managed_ptr->ud_ptr;
+    _managed_release(managed_ptr);
+    if (NULL != callback) {
+        callback(subprocess_ptr,
+                 subprocess_ptr->exit_status,
+                 subprocess_ptr->signal_number,
+                 ud_ptr);
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Unregisters the subprocess from the manager, and closes the pidfd. Frees
+ * the registration, or defers that until the end of the dispatch.
+ */
+void _managed_release(_managed_t *managed_ptr)
+{
+    bs_subprocess_manager_t *manager_ptr = managed_ptr->manager_ptr;
+    for (int i = 0; i < 3; ++i) {
+        _watch_unregister(manager_ptr->epoll_fd, &managed_ptr->watches[i]);
+    }
+    _close_fd(&managed_ptr->watches[_WATCH_PIDFD].fd);
+
+    managed_ptr->subprocess_ptr->managed_ptr = NULL;
+    managed_ptr->subprocess_ptr = NULL;
+    bs_dllist_remove(&manager_ptr->managed, &managed_ptr->dlnode);
+    if (manager_ptr->dispatching) {
+        bs_dllist_push_back(&manager_ptr->released, &managed_ptr->dlnode);
+    } else {
+        logged_free(managed_ptr);
     }
 }
 
@@ -616,85 +1253,78 @@ void _subprocess_child(
 }
 
 /* ------------------------------------------------------------------------- */
-/** Splits the commandline into a NULL-terminated list of strings. */
-char **_split_command(const char *cmd_ptr, _env_var_t **env_var_ptr_ptr)
+/**
+ * Splits the commandline into a NULL-terminated list of strings. Leading
+ * variable assignments go into |*env_var_ptr_ptr|, also NULL-terminated.
+ * Everything is allocated from |arena_ptr|.
+ *
+ * Takes two passes: The first counts tokens, so that the lists can be sized
+ * up front. The second writes all tokens into a single buffer. Variable
+ * assignments are split in place.
+ */
+char **_split_command(
+    bs_arena_t *arena_ptr,
+    const char *cmd_ptr,
+    _env_var_t **env_var_ptr_ptr)
 {
-    char *token_ptr;
-    const char*line_ptr;
-    char **argv_ptr;
-
-    size_t argv_size = 0;
-    argv_ptr = (char**)logged_calloc(1, (argv_size + 1) * sizeof(char*));
+    size_t tokens = 0;
+    for (const char *line_ptr = cmd_ptr;
+         NULL != (line_ptr = _split_next_token(line_ptr, NULL));
+         ++tokens) {}
+
+    // Both lists keep one more element, for the sentinel. The tokens take at
+    // most as much space as the commandline: Each token's terminating NUL
+    // takes the place of a blank, or of the commandline's NUL.
+    char **argv_ptr = bs_arena_calloc(arena_ptr, tokens + 1, sizeof(char*));
     if (NULL == argv_ptr) return NULL;
-
-    _env_var_t *env_var_ptr;
-    env_var_ptr = logged_calloc(1, sizeof(_env_var_t));
-    if (NULL == env_var_ptr) {
-        free(argv_ptr);
-        return NULL;
-    }
-    size_t env_var_size = 0;
-
-    line_ptr = cmd_ptr;
-    do {
-        token_ptr = _split_next_token(line_ptr, &line_ptr);
-        if (NULL != token_ptr) {
-
-            if (0 == argv_size &&
-                _is_variable_assignment(token_ptr, &env_var_ptr[env_var_size])) {
-                free(token_ptr);
-
-                void *tmp_ptr = realloc(
-                    env_var_ptr,
-                    (env_var_size + 2) * sizeof(_env_var_t));
-                if (NULL == tmp_ptr) {
-                    bs_log(BS_ERROR | BS_ERRNO, "Failed realloc(%p, %zu)",
-                           env_var_ptr,
-                           (env_var_size + 2) * sizeof(_env_var_t));
-                    _free_env_var_list(env_var_ptr);
-                    _free_argv_list(argv_ptr);
-                    return NULL;
-                }
-                env_var_ptr = tmp_ptr;
-                ++env_var_size;
-                memset(&env_var_ptr[env_var_size], 0, sizeof(_env_var_t));
-            } else {
-                argv_ptr[argv_size++] = token_ptr;
-                void *tmp_ptr = realloc(argv_ptr, (argv_size + 1) * sizeof(char*));
-                if (NULL == tmp_ptr) {
-                    bs_log(BS_ERROR | BS_ERRNO, "Failed realloc(%p, %zu)",
-                           argv_ptr, (argv_size + 1) * sizeof(char*));
-                    _free_env_var_list(env_var_ptr);
-                    _free_argv_list(argv_ptr);
-                    return NULL;
-                }
-                argv_ptr = (char**)tmp_ptr;
-                argv_ptr[argv_size] = NULL;
-            }
+    _env_var_t *env_var_ptr = bs_arena_calloc(
+        arena_ptr, tokens + 1, sizeof(_env_var_t));
+    if (NULL == env_var_ptr) return NULL;
+    char *buf_ptr = bs_arena_alloc(arena_ptr, strlen(cmd_ptr) + 1);
+    if (NULL == buf_ptr) return NULL;
+
+    size_t argv_size = 0, env_var_size = 0;
+    const char *line_ptr = cmd_ptr;
+    char *token_ptr = buf_ptr;
+    while (NULL != (line_ptr = _split_next_token(line_ptr, &buf_ptr))) {
+        size_t name_len = 0;
+        if (0 == argv_size) name_len = _variable_name_length(token_ptr);
+        if (0 < name_len) {
+            token_ptr[name_len] = '\0';
+            env_var_ptr[env_var_size].name_ptr = token_ptr;
+            env_var_ptr[env_var_size].value_ptr = token_ptr + name_len + 1;
+            ++env_var_size;
+        } else {
+            argv_ptr[argv_size++] = token_ptr;
         }
-    } while (NULL != token_ptr && NULL != line_ptr);
+        token_ptr = buf_ptr;
+    }
 
     *env_var_ptr_ptr = env_var_ptr;
     return argv_ptr;
 }
 
 /* ------------------------------------------------------------------------- */
-/** Returns a copy of the next token from |word_ptr|. Must be free()-ed. */
-char *_split_next_token(const char *word_ptr, const char **next_ptr)
+/**
+ * Lexes the next token from |word_ptr|.
+ *
+ * @param word_ptr
+ * @param token_ptr_ptr       If not NULL, the token is written to
+ *     |*token_ptr_ptr|, NUL-terminated, and |*token_ptr_ptr| is advanced
+ *     past the NUL.
+ *
+ * @return Position to continue lexing from, or NULL if |word_ptr| has no
+ *     further token.
+ */
+const char *_split_next_token(
+    const char *word_ptr,
+    char **token_ptr_ptr)
 {
-    char *token_ptr, *orig_token_ptr;
     int state, char_type;
 
     if (*word_ptr == '\0') return NULL;
-    token_ptr = malloc(strlen(word_ptr) + 1);
-    if (NULL == token_ptr) {
-        bs_log(BS_ERROR | BS_ERRNO, "Failed malloc(%zu)", strlen(word_ptr) + 1);
-        return NULL;
-    }
-    orig_token_ptr = token_ptr;
 
     state = 0;
-    *token_ptr = '\0';
     while (true) {
         switch (*word_ptr) {
         case '\0': char_type = char_type_end_of_string; break;
@@ -706,67 +1336,56 @@ char *_split_next_token(const char *word_ptr, const char **next_ptr)
         default: char_type = char_type_alpha; break;
         }
 
-        if (state_transition_table[state][char_type].output) {
-            *token_ptr = *word_ptr;
-            ++token_ptr;
-            *token_ptr = '\0';
+        if (state_transition_table[state][char_type].output &&
+            NULL != token_ptr_ptr) {
+            *(*token_ptr_ptr)++ = *word_ptr;
         }
         state = state_transition_table[state][char_type].next_state;
-        word_ptr++;
         if (0 > state_transition_table[state][0].output) break;
+        word_ptr++;
     }
 
-    // The token might be shorter than what we had reserved, update that.
-    token_ptr = logged_strdup(orig_token_ptr);
-    free(orig_token_ptr);
-
-    if (char_type == char_type_end_of_string) {
-        *next_ptr = NULL;
-    } else {
-        *next_ptr = word_ptr;
-    }
-
-    return token_ptr;
-}
-
-/* ------------------------------------------------------------------------- */
-/** Frees up strings and the list of a NULL-terminated list of strings. */
-void _free_argv_list(char **argv_ptr) {
-    for (char **iter_ptr = argv_ptr; *iter_ptr != NULL; ++iter_ptr) {
-        free(*iter_ptr);
-    }
-    free(argv_ptr);
+    // State 8 is reached from the initial state: Only blanks were left.
+    if (8 == state) return NULL;
+    if (NULL != token_ptr_ptr) *(*token_ptr_ptr)++ = '\0';
+    // Continue past the blank, but stay on the terminating NUL.
+    return char_type == char_type_end_of_string ? word_ptr : word_ptr + 1;
 }
 
 /* ------------------------------------------------------------------------- */
-/** Frees up the variable names and values, as well as the list itself. */
-void _free_env_var_list(_env_var_t *env_var_ptr)
+/**
+ * Returns the length of the variable name, if |word_ptr| starts with a
+ * variable assignment. That is: A letter or underscore, followed by
+ * letters, numbers or underscores, and succeeded by a '=' sign.
+ *
+ * @return Length of the variable name, or 0 if no variable assignment.
+ */
+size_t _variable_name_length(const char *word_ptr)
 {
-    for (_env_var_t *iter_ptr = env_var_ptr;
-         iter_ptr->name_ptr != NULL;
-         ++iter_ptr) {
-        free(iter_ptr->name_ptr);
-        free(iter_ptr->value_ptr);
+    size_t len = 0;
+    for (;; ++len) {
+        char c = word_ptr[len];
+        if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || '_' == c) {
+            continue;
+        }
+        if (0 < len && '0' <= c && c <= '9') continue;
+        return (0 < len && '=' == c) ? len : 0;
     }
-    free(env_var_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
-/** Populates the entry from name and value. */
-bool _populate_env_var(_env_var_t *env_var_ptr,
+/** Populates the entry from name and value, allocated from |arena_ptr|. */
+bool _populate_env_var(bs_arena_t *arena_ptr,
+                       _env_var_t *env_var_ptr,
                        const char *name_ptr,
                        size_t name_len,
                        const char *value_ptr)
 {
-    env_var_ptr->name_ptr = logged_malloc(name_len + 1);
+    env_var_ptr->name_ptr = bs_arena_strndup(arena_ptr, name_ptr, name_len);
     if (NULL == env_var_ptr->name_ptr) return false;
 
-    memcpy(env_var_ptr->name_ptr, name_ptr, name_len);
-    env_var_ptr->name_ptr[name_len] = '\0';
-
-    env_var_ptr->value_ptr = logged_strdup(value_ptr);
+    env_var_ptr->value_ptr = bs_arena_strdup(arena_ptr, value_ptr);
     if (NULL == env_var_ptr->value_ptr) {
-        free(env_var_ptr->name_ptr);
         env_var_ptr->name_ptr = NULL;
         return false;
     }
@@ -783,55 +1402,30 @@ bool _populate_env_var(_env_var_t *env_var_ptr,
  * The variable name must be succeeded by a '=' sign. All that follows will be
  * considered the value.
  *
+ * @param arena_ptr           Arena to allocate name and value from.
  * @param word_ptr            The token to analyse.
- * @param name_ptr_ptr        If `word_ptr` is a variable assignment, then
- *     *name_ptr_ptr will be set to point to a newly allocated copy of the
- *     variable name. Will only be set if the function returns true. If so,
- *     the allocated memory must be free()-ed.
- * @param value_ptr_ptr       If `word_ptr` is a variable assignent, then
- *     *value_ptr_ptr will be set to point to a newly allocated copy of the
- *     variable's value. Will only be set if the function return true. I fos,
- *     the allocated memory must be free()-ed.
+ * @param env_variable_ptr    If `word_ptr` is a variable assignment, then
+ *     name_ptr and value_ptr will be set to point to copies of the variable
+ *     name and value, allocated from `arena_ptr`. Will only be set if the
+ *     function returns true.
  *
  * @return true if `word_ptr` is a variable, and false if it's not a varaible
- *     or if an error occurred. *name_ptr_ptr and *value_ptr_ptr will be set
- *     only on success.
+ *     or if an error occurred. `env_variable_ptr` will be set only on
+ *     success.
  */
 bool _is_variable_assignment(
+    bs_arena_t *arena_ptr,
     const char *word_ptr,
     _env_var_t *env_variable_ptr)
 {
-    static const char *name_regexp_ptr = "^[a-zA-Z_][a-zA-Z_0-9]*=";
-    regex_t regex;
-    regmatch_t matches[1];
-    int rv;
-
-    if (0 != (rv = regcomp(&regex, name_regexp_ptr, REG_EXTENDED))) {
-        bs_log(BS_ERROR, "Failed regcomp(%p, \"%s\", REG_EXTENDED): %d",
-               &regex, name_regexp_ptr, rv);
-        return false;
-    }
-
-    rv = regexec(&regex, word_ptr, 1, matches, 0);
-    regfree(&regex);
-    if (REG_NOMATCH == rv) return false;
-    if (0 != rv) {
-        bs_log(BS_ERROR, "Failed regexec(%p, \"%s\", 1, %p): %d",
-               &regex, word_ptr, matches, rv);
-        return false;
-    }
-
-    // A valid match must start at the beginning of the word, and it must at
-    // least hold two chars: the variable name, and the '=' sign.
-    if (matches[0].rm_so != 0 || matches[0].rm_eo < 2) return false;
-
-    if (!_populate_env_var(env_variable_ptr,
-                           word_ptr,
-                           matches[0].rm_eo - matches[0].rm_so - 1,
-                           word_ptr + matches[0].rm_eo)) {
-        return false;
-    }
-    return true;
+    size_t name_len = _variable_name_length(word_ptr);
+    if (0 == name_len) return false;
+
+    return _populate_env_var(arena_ptr,
+                             env_variable_ptr,
+                             word_ptr,
+                             name_len,
+                             word_ptr + name_len + 1);
 }
 
 /* == Unit tests =========================================================== */
@@ -846,6 +1440,12 @@ static void test_sigpipe(bs_test_t *test_ptr);
 static void test_success(bs_test_t *test_ptr);
 static void test_success_cmdline(bs_test_t *test_ptr);
 static void test_success_twice(bs_test_t *test_ptr);
+static void test_success_fork(bs_test_t *test_ptr);
+static void test_manager(bs_test_t *test_ptr);
+static void test_manager_remove(bs_test_t *test_ptr);
+static void test_capture_grow(bs_test_t *test_ptr);
+static void test_capture_tail(bs_test_t *test_ptr);
+static void test_capture_stream(bs_test_t *test_ptr);
 
 const bs_test_case_t          bs_subprocess_test_cases[] = {
     { 1, "is_variable_assignment", test_is_variable_assignment },
@@ -857,6 +1457,12 @@ const bs_test_case_t          bs_subprocess_test_cases[] = {
     { 1, "success", test_success },
     { 1, "success_cmdline", test_success_cmdline },
     { 1, "success_twice", test_success_twice },
+    { 1, "success_fork", test_success_fork },
+    { 1, "manager", test_manager },
+    { 1, "manager_remove", test_manager_remove },
+    { 1, "capture_grow", test_capture_grow },
+    { 1, "capture_tail", test_capture_tail },
+    { 1, "capture_stream", test_capture_stream },
     { 0, NULL, NULL }
 };
 
@@ -893,54 +1499,59 @@ void test_verify_eq_envlist(
 void test_is_variable_assignment(bs_test_t *test_ptr)
 {
     _env_var_t var;
-    BS_TEST_VERIFY_TRUE(test_ptr, _is_variable_assignment("a=value", &var));
+    bs_arena_t *arena_ptr = bs_arena_create(0);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, arena_ptr);
+
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, _is_variable_assignment(arena_ptr, "a=value", &var));
     BS_TEST_VERIFY_STREQ(test_ptr, var.name_ptr, "a");
     BS_TEST_VERIFY_STREQ(test_ptr, var.value_ptr, "value");
-    free(var.name_ptr);
-    free(var.value_ptr);
+    bs_arena_reset(arena_ptr);
 
-    BS_TEST_VERIFY_TRUE(test_ptr, _is_variable_assignment("a1=value", &var));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, _is_variable_assignment(arena_ptr, "a1=value", &var));
     BS_TEST_VERIFY_STREQ(test_ptr, var.name_ptr, "a1");
     BS_TEST_VERIFY_STREQ(test_ptr, var.value_ptr, "value");
-    free(var.name_ptr);
-    free(var.value_ptr);
+    bs_arena_reset(arena_ptr);
 
-    BS_TEST_VERIFY_TRUE(test_ptr, _is_variable_assignment("_=value", &var));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, _is_variable_assignment(arena_ptr, "_=value", &var));
     BS_TEST_VERIFY_STREQ(test_ptr, var.name_ptr, "_");
     BS_TEST_VERIFY_STREQ(test_ptr, var.value_ptr, "value");
-    free(var.name_ptr);
-    free(var.value_ptr);
+    bs_arena_reset(arena_ptr);
 
     BS_TEST_VERIFY_TRUE(
         test_ptr,
-        _is_variable_assignment("SILLY_2_LONG_VARIABLE_42=value", &var));
+        _is_variable_assignment(
+            arena_ptr, "SILLY_2_LONG_VARIABLE_42=value", &var));
     BS_TEST_VERIFY_STREQ(test_ptr, var.name_ptr, "SILLY_2_LONG_VARIABLE_42");
     BS_TEST_VERIFY_STREQ(test_ptr, var.value_ptr, "value");
-    free(var.name_ptr);
-    free(var.value_ptr);
+    bs_arena_reset(arena_ptr);
 
     BS_TEST_VERIFY_TRUE(
         test_ptr,
-        _is_variable_assignment("a=value\" with more\"", &var));
+        _is_variable_assignment(arena_ptr, "a=value\" with more\"", &var));
     BS_TEST_VERIFY_STREQ(test_ptr, var.name_ptr, "a");
     BS_TEST_VERIFY_STREQ(test_ptr, var.value_ptr, "value\" with more\"");
-    free(var.name_ptr);
-    free(var.value_ptr);
+    bs_arena_reset(arena_ptr);
 
-    BS_TEST_VERIFY_TRUE(test_ptr, _is_variable_assignment("a= value", &var));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, _is_variable_assignment(arena_ptr, "a= value", &var));
     BS_TEST_VERIFY_STREQ(test_ptr, var.name_ptr, "a");
     BS_TEST_VERIFY_STREQ(test_ptr, var.value_ptr, " value");
-    free(var.name_ptr);
-    free(var.value_ptr);
+    bs_arena_reset(arena_ptr);
 
-    BS_TEST_VERIFY_TRUE(test_ptr, _is_variable_assignment("a=", &var));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, _is_variable_assignment(arena_ptr, "a=", &var));
     BS_TEST_VERIFY_STREQ(test_ptr, var.name_ptr, "a");
     BS_TEST_VERIFY_STREQ(test_ptr, var.value_ptr, "");
-    free(var.name_ptr);
-    free(var.value_ptr);
+    bs_arena_reset(arena_ptr);
 
-    BS_TEST_VERIFY_FALSE(test_ptr, _is_variable_assignment("a", &var));
-    BS_TEST_VERIFY_FALSE(test_ptr, _is_variable_assignment("1a=b", &var));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, _is_variable_assignment(arena_ptr, "a", &var));
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, _is_variable_assignment(arena_ptr, "1a=b", &var));
+    bs_arena_destroy(arena_ptr);
 }
 
 
@@ -949,46 +1560,79 @@ void test_split_command(bs_test_t *test_ptr)
 {
     char **argv_ptr;
     _env_var_t *env_var_ptr;
+    bs_arena_t *arena_ptr = bs_arena_create(0);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, arena_ptr);
 
     char *expected1[] = {"command", "arg1", "arg2", NULL };
-    argv_ptr = _split_command("command arg1 arg2", &env_var_ptr);
+    argv_ptr = _split_command(arena_ptr, "command arg1 arg2", &env_var_ptr);
     test_verify_eq_arglist(test_ptr, expected1, argv_ptr);
-    _free_argv_list(argv_ptr);
-    _free_env_var_list(env_var_ptr);
+    bs_arena_reset(arena_ptr);
 
     char *expected2[] = {"command", "arg1 arg2", "arg3", NULL };
-    argv_ptr = _split_command("command \"arg1 arg2\" arg3", &env_var_ptr);
+    argv_ptr = _split_command(
+        arena_ptr, "command \"arg1 arg2\" arg3", &env_var_ptr);
     test_verify_eq_arglist(test_ptr, expected2, argv_ptr);
-    _free_argv_list(argv_ptr);
-    _free_env_var_list(env_var_ptr);
+    bs_arena_reset(arena_ptr);
 
     char *expected3[] = {"command", "arg1 arg2", "arg3", NULL };
-    argv_ptr = _split_command("command \'arg1 arg2\' arg3", &env_var_ptr);
+    argv_ptr = _split_command(
+        arena_ptr, "command \'arg1 arg2\' arg3", &env_var_ptr);
     test_verify_eq_arglist(test_ptr, expected3, argv_ptr);
-    _free_argv_list(argv_ptr);
-    _free_env_var_list(env_var_ptr);
+    bs_arena_reset(arena_ptr);
 
     char *expected4[] = {"command", "arg1 \'arg2", "arg3", NULL };
-    argv_ptr = _split_command("command \"arg1 \'arg2\" arg3\'", &env_var_ptr);
+    argv_ptr = _split_command(
+        arena_ptr, "command \"arg1 \'arg2\" arg3\'", &env_var_ptr);
     test_verify_eq_arglist(test_ptr, expected4, argv_ptr);
-    _free_argv_list(argv_ptr);
-    _free_env_var_list(env_var_ptr);
+    bs_arena_reset(arena_ptr);
 
     char *expected5[] = {"command", "\"arg1", "arg2\"", "arg3", NULL };
-    argv_ptr = _split_command("command \\\"arg1 arg2\\\" arg3", &env_var_ptr);
+    argv_ptr = _split_command(
+        arena_ptr, "command \\\"arg1 arg2\\\" arg3", &env_var_ptr);
     test_verify_eq_arglist(test_ptr, expected5, argv_ptr);
-    _free_argv_list(argv_ptr);
-    _free_env_var_list(env_var_ptr);
+    bs_arena_reset(arena_ptr);
 
     char *expected6[] = {"command", "arg1", NULL };
     const bs_subprocess_environment_variable_t expected_env6[] = {
         { "var1", "1" }, { "var2", "2" }, { NULL, NULL }
     };
-    argv_ptr = _split_command("var1=1 var2=2 command arg1", &env_var_ptr);
+    argv_ptr = _split_command(
+        arena_ptr, "var1=1 var2=2 command arg1", &env_var_ptr);
     test_verify_eq_arglist(test_ptr, expected6, argv_ptr);
     test_verify_eq_envlist(test_ptr, expected_env6, env_var_ptr);
-    _free_argv_list(argv_ptr);
-    _free_env_var_list(env_var_ptr);
+
+    char *expected7[] = {
+        "c", "1", "2", "3", "4", "5", "6", "7", "8", "9", NULL };
+    const bs_subprocess_environment_variable_t expected_env7[] = {
+        { "a", "1" }, { "b", "2" }, { "c", "3" }, { "d", "4" }, { "e", "5" },
+        { NULL, NULL }
+    };
+    argv_ptr = _split_command(
+        arena_ptr, "a=1 b=2 c=3 d=4 e=5 c 1 2 3 4 5 6 7 8 9", &env_var_ptr);
+    test_verify_eq_arglist(test_ptr, expected7, argv_ptr);
+    test_verify_eq_envlist(test_ptr, expected_env7, env_var_ptr);
+
+    // Runs of blanks, and an empty quoted argument.
+    char *expected8[] = {"command", "", "arg1", NULL };
+    argv_ptr = _split_command(
+        arena_ptr, "  command \t\"\"  arg1   ", &env_var_ptr);
+    test_verify_eq_arglist(test_ptr, expected8, argv_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, env_var_ptr[0].name_ptr);
+
+    // Assignments only lead. Later, they are arguments.
+    char *expected9[] = {"command", "a=1", NULL };
+    const bs_subprocess_environment_variable_t expected_env9[] = {
+        { "v", "x y" }, { NULL, NULL }
+    };
+    argv_ptr = _split_command(
+        arena_ptr, "v=\"x y\" command a=1", &env_var_ptr);
+    test_verify_eq_arglist(test_ptr, expected9, argv_ptr);
+    test_verify_eq_envlist(test_ptr, expected_env9, env_var_ptr);
+
+    argv_ptr = _split_command(arena_ptr, "", &env_var_ptr);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, argv_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, argv_ptr[0]);
+    bs_arena_destroy(arena_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -1150,5 +1794,405 @@ void test_success_twice(bs_test_t *test_ptr)
     bs_subprocess_destroy(sp_ptr);
 }
 
+/* ------------------------------------------------------------------------- */
+/** Verifies the fork(2) path, which is otherwise only taken on fallback. */
+void test_success_fork(bs_test_t *test_ptr)
+{
+    const bs_subprocess_environment_variable_t envs[] = {
+        { "SUBPROCESS_ENV", "FORK" },
+        { NULL, NULL }
+    };
+    bs_subprocess_t *sp_ptr = bs_subprocess_create(
+        "./subprocess_test_success", test_args, envs);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, sp_ptr);
+    BS_TEST_VERIFY_TRUE(test_ptr, _subprocess_start(sp_ptr, false));
+
+    int exit_status, signal_number;
+    while (!bs_subprocess_terminated(sp_ptr, &exit_status, &signal_number)) {
+        // Don't busy-loop -- just wait a little.
+        poll(NULL, 0, 10);
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 0, exit_status);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, signal_number);
+    BS_TEST_VERIFY_STREQ(
+        test_ptr, "test stdout: ./subprocess_test_success\nenv: FORK\n",
+        bs_subprocess_stdout(sp_ptr));
+    bs_subprocess_destroy(sp_ptr);
+}
+
+/** Outcome of a managed subprocess, for @ref test_manager. */
+struct test_manager_outcome {
+    /** Number of callback invocations. */
+    int                       calls;
+    /** Exit status, as reported to the callback. */
+    int                       exit_status;
+    /** Signal number, as reported to the callback. */
+    int                       signal_number;
+};
+
+/* ------------------------------------------------------------------------- */
+/** Callback for @ref test_manager: Stores the outcome. */
+static void test_manager_terminated(
+    __UNUSED__ bs_subprocess_t *subprocess_ptr,
+    int exit_status,
+    int signal_number,
+    void *ud_ptr)
+{
+    struct test_manager_outcome *outcome_ptr = ud_ptr;
+    outcome_ptr->calls++;
+    outcome_ptr->exit_status = exit_status;
+    outcome_ptr->signal_number = signal_number;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Supervises several subprocesses through the manager. */
+void test_manager(bs_test_t *test_ptr)
+{
+    bs_subprocess_t *sp_ptrs[5];
+    struct test_manager_outcome outcomes[5] = {};
+    bs_subprocess_manager_t *manager_ptr = bs_subprocess_manager_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, manager_ptr);
+
+    for (int i = 0; i < 5; ++i) {
+        sp_ptrs[i] = bs_subprocess_create(
+            4 > i ? "./subprocess_test_success" : "./subprocess_test_failure",
+            test_args, NULL);
+        BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, sp_ptrs[i]);
+        BS_TEST_VERIFY_TRUE(test_ptr, bs_subprocess_start(sp_ptrs[i]));
+        BS_TEST_VERIFY_TRUE(
+            test_ptr,
+            bs_subprocess_manager_add(manager_ptr, sp_ptrs[i],
+                                      test_manager_terminated, &outcomes[i]));
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 5, bs_subprocess_manager_size(manager_ptr));
+    // A subprocess can only be registered once.
+    BS_TEST_VERIFY_FALSE(
+        test_ptr,
+        bs_subprocess_manager_add(manager_ptr, sp_ptrs[0], NULL, NULL));
+
+    int terminated = 0;
+    while (0 < bs_subprocess_manager_size(manager_ptr) &&
+           !bs_test_failed(test_ptr)) {
+        int rv = bs_subprocess_manager_dispatch(manager_ptr, -1);
+        BS_TEST_VERIFY_TRUE(test_ptr, 0 <= rv);
+        terminated += rv;
+    }
+    BS_TEST_VERIFY_EQ(test_ptr, 5, terminated);
+
+    for (int i = 0; i < 5; ++i) {
+        BS_TEST_VERIFY_EQ(test_ptr, 1, outcomes[i].calls);
+        BS_TEST_VERIFY_EQ(test_ptr, 4 > i ? 0 : 42, outcomes[i].exit_status);
+        BS_TEST_VERIFY_EQ(test_ptr, 0, outcomes[i].signal_number);
+        BS_TEST_VERIFY_EQ(test_ptr, 0, bs_subprocess_pid(sp_ptrs[i]));
+        if (4 > i) {
+            BS_TEST_VERIFY_STREQ(
+                test_ptr,
+                "test stdout: ./subprocess_test_success\nenv: (null)\n",
+                bs_subprocess_stdout(sp_ptrs[i]));
+            BS_TEST_VERIFY_STREQ(
+                test_ptr, "test stderr: alpha\n",
+                bs_subprocess_stderr(sp_ptrs[i]));
+        }
+        bs_subprocess_destroy(sp_ptrs[i]);
+    }
+    bs_subprocess_manager_destroy(manager_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Unregisters from the manager: Explicitly, by stopping and destroying. */
+void test_manager_remove(bs_test_t *test_ptr)
+{
+    bs_subprocess_manager_t *manager_ptr = bs_subprocess_manager_create();
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, manager_ptr);
+    bs_subprocess_t *sp_ptr = bs_subprocess_create(
+        "./subprocess_test_hang", test_args, NULL);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, sp_ptr);
+
+    // Not running: Cannot be added.
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_subprocess_manager_add(manager_ptr, sp_ptr, NULL, NULL));
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_subprocess_start(sp_ptr));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_subprocess_manager_add(manager_ptr, sp_ptr, NULL, NULL));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_subprocess_manager_size(manager_ptr));
+    bs_subprocess_manager_remove(sp_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_subprocess_manager_size(manager_ptr));
+    BS_TEST_VERIFY_EQ(test_ptr, 0,
+                      bs_subprocess_manager_dispatch(manager_ptr, 0));
+
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_subprocess_manager_add(manager_ptr, sp_ptr, NULL, NULL));
+    bs_subprocess_stop(sp_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_subprocess_manager_size(manager_ptr));
+
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_subprocess_start(sp_ptr));
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_subprocess_manager_add(manager_ptr, sp_ptr, NULL, NULL));
+    bs_subprocess_destroy(sp_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_subprocess_manager_size(manager_ptr));
+    bs_subprocess_manager_destroy(manager_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Helper: Runs `subprocess_test_chatty`, for 100000 lines, to completion. */
+static bool test_capture_run(bs_test_t *test_ptr, bs_subprocess_t *sp_ptr)
+{
+    bs_subprocess_manager_t *manager_ptr = bs_subprocess_manager_create();
+    BS_TEST_VERIFY_NEQ(test_ptr, NULL, manager_ptr);
+    if (NULL == manager_ptr) return false;
+    struct test_manager_outcome outcome = {};
+    if (bs_subprocess_start(sp_ptr) &&
+        bs_subprocess_manager_add(manager_ptr, sp_ptr,
+                                  test_manager_terminated, &outcome)) {
+        while (0 < bs_subprocess_manager_size(manager_ptr) &&
+               0 <= bs_subprocess_manager_dispatch(manager_ptr, -1)) {}
+    }
+    bs_subprocess_manager_destroy(manager_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, outcome.calls);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, outcome.exit_status);
+    return !bs_test_failed(test_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Captures 1.2MB of output into a growing buffer. */
+void test_capture_grow(bs_test_t *test_ptr)
+{
+    const char *args[] = { "100000", NULL };
+    bs_subprocess_t *sp_ptr = bs_subprocess_create(
+        "./subprocess_test_chatty", args, NULL);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, sp_ptr);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_subprocess_set_capture(
+            sp_ptr, BS_SUBPROCESS_CAPTURE_HEAD, 1 << 22, NULL, NULL));
+
+    if (test_capture_run(test_ptr, sp_ptr)) {
+        const char *out_ptr = bs_subprocess_stdout(sp_ptr);
+        BS_TEST_VERIFY_EQ(test_ptr, 1200000, bs_subprocess_stdout_size(sp_ptr));
+        BS_TEST_VERIFY_MEMEQ(test_ptr, "line 000000\nline 000001\n",
+                             out_ptr, 24);
+        BS_TEST_VERIFY_STREQ(test_ptr, "line 099999\n",
+                             out_ptr + 1200000 - 12);
+        BS_TEST_VERIFY_EQ(test_ptr, 0, bs_subprocess_stderr_size(sp_ptr));
+    }
+
+    // Capped at 30 bytes, keeping the head.
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_subprocess_set_capture(
+            sp_ptr, BS_SUBPROCESS_CAPTURE_HEAD, 30, NULL, NULL));
+    if (test_capture_run(test_ptr, sp_ptr)) {
+        BS_TEST_VERIFY_STREQ(test_ptr, "line 000000\nline 000001\nline 0",
+                             bs_subprocess_stdout(sp_ptr));
+    }
+    bs_subprocess_destroy(sp_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Keeps the most recent output. */
+void test_capture_tail(bs_test_t *test_ptr)
+{
+    const char *args[] = { "100000", NULL };
+    bs_subprocess_t *sp_ptr = bs_subprocess_create(
+        "./subprocess_test_chatty", args, NULL);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, sp_ptr);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_subprocess_set_capture(
+            sp_ptr, BS_SUBPROCESS_CAPTURE_TAIL, 30, NULL, NULL));
+
+    if (test_capture_run(test_ptr, sp_ptr)) {
+        BS_TEST_VERIFY_STREQ(test_ptr, "99997\nline 099998\nline 099999\n",
+                             bs_subprocess_stdout(sp_ptr));
+    }
+    bs_subprocess_destroy(sp_ptr);
+}
+
+/** Accumulates statistics from @ref test_capture_stream. */
+struct test_capture_stream_stats {
+    /** Number of chunks received. */
+    size_t                    chunks;
+    /** Number of bytes received. */
+    size_t                    bytes;
+    /** Number of newlines received. */
+    size_t                    lines;
+};
+
+/* ------------------------------------------------------------------------- */
+/** Output callback for @ref test_capture_stream. */
+static void test_capture_stream_output(
+    __UNUSED__ bs_subprocess_t *subprocess_ptr,
+    bs_subprocess_stream_t stream,
+    const char *data_ptr,
+    size_t size,
+    void *ud_ptr)
+{
+    struct test_capture_stream_stats *stats_ptr = ud_ptr;
+    if (BS_SUBPROCESS_STDOUT != stream) return;
+    stats_ptr->chunks++;
+    stats_ptr->bytes += size;
+    for (size_t i = 0; i < size; ++i) {
+        if ('\n' == data_ptr[i]) stats_ptr->lines++;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Streams output through the callback, without keeping it. */
+void test_capture_stream(bs_test_t *test_ptr)
+{
+    const char *args[] = { "100000", NULL };
+    struct test_capture_stream_stats stats = {};
+    bs_subprocess_t *sp_ptr = bs_subprocess_create(
+        "./subprocess_test_chatty", args, NULL);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, sp_ptr);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr,
+        bs_subprocess_set_capture(
+            sp_ptr, BS_SUBPROCESS_CAPTURE_HEAD, 0,
+            test_capture_stream_output, &stats));
+
+    if (test_capture_run(test_ptr, sp_ptr)) {
+        BS_TEST_VERIFY_EQ(test_ptr, 1200000, stats.bytes);
+        BS_TEST_VERIFY_EQ(test_ptr, 100000, stats.lines);
+        BS_TEST_VERIFY_TRUE(test_ptr, 0 < stats.chunks);
+        BS_TEST_VERIFY_EQ(test_ptr, 0, bs_subprocess_stdout_size(sp_ptr));
+        BS_TEST_VERIFY_STREQ(test_ptr, "", bs_subprocess_stdout(sp_ptr));
+    }
+    bs_subprocess_destroy(sp_ptr);
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_spawn_rss_0(bs_test_t *test_ptr);
+static void benchmark_spawn_rss_256(bs_test_t *test_ptr);
+static void benchmark_spawn_rss_1024(bs_test_t *test_ptr);
+static void benchmark_split_command(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_subprocess_benchmarks[] = {
+    { 1, "benchmark-spawn-rss-0MiB", benchmark_spawn_rss_0 },
+    { 1, "benchmark-spawn-rss-256MiB", benchmark_spawn_rss_256 },
+    { 1, "benchmark-spawn-rss-1024MiB", benchmark_spawn_rss_1024 },
+    { 1, "benchmark-split_command", benchmark_split_command },
+    { 0, NULL, NULL }
+};
+
+/** Argument to @ref _benchmark_spawn_fn. */
+struct _benchmark_spawn_arg {
+    /** The subprocess to start. */
+    bs_subprocess_t           *subprocess_ptr;
+    /** Whether to use posix_spawnp(3), or fork(2). */
+    bool                      use_spawn;
+    /** Set if starting the subprocess failed. */
+    bool                      failed;
+};
+
+/* ------------------------------------------------------------------------- */
+/** Starts the subprocess and waits for it, `iterations` times. */
+static void _benchmark_spawn_fn(void *arg_ptr, uint64_t iterations)
+{
+    struct _benchmark_spawn_arg *spawn_arg_ptr = arg_ptr;
+    bs_subprocess_t *subprocess_ptr = spawn_arg_ptr->subprocess_ptr;
+    for (uint64_t i = 0; i < iterations && !spawn_arg_ptr->failed; ++i) {
+        if (!_subprocess_start(subprocess_ptr, spawn_arg_ptr->use_spawn)) {
+            spawn_arg_ptr->failed = true;
+            return;
+        }
+        _waitpid_nointr(subprocess_ptr, true);
+        subprocess_ptr->pid = 0;
+        bs_subprocess_stop(subprocess_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Benchmarks the latency of launching (and reaping) `true`, through fork(2)
+ * and through posix_spawnp(3), with `rss_mib` of touched memory in the
+ * parent.
+ */
+static void _benchmark_spawn_with(bs_test_t *test_ptr, size_t rss_mib)
+{
+    const char *args[] = { NULL };
+    struct _benchmark_spawn_arg spawn_arg = {
+        .subprocess_ptr = bs_subprocess_create("true", args, NULL) };
+    if (NULL == spawn_arg.subprocess_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_subprocess_create(true)");
+        return;
+    }
+
+    // Ballast, to grow resident memory and page tables of the parent.
+    char *ballast_ptr = NULL;
+    if (0 < rss_mib) {
+        ballast_ptr = logged_malloc(rss_mib << 20);
+        if (NULL == ballast_ptr) {
+            BS_TEST_FAIL(test_ptr, "Failed malloc(%zu MiB)", rss_mib);
+            bs_subprocess_destroy(spawn_arg.subprocess_ptr);
+            return;
+        }
+        memset(ballast_ptr, 0x5a, rss_mib << 20);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+
+    spawn_arg.use_spawn = false;
+    bs_test_bench(test_ptr, "fork", _benchmark_spawn_fn, &spawn_arg, NULL);
+    spawn_arg.use_spawn = true;
+    bs_test_bench(test_ptr, "posix_spawn", _benchmark_spawn_fn, &spawn_arg,
+                  NULL);
+    if (spawn_arg.failed) BS_TEST_FAIL(test_ptr, "Failed starting true");
+
+    if (NULL != ballast_ptr) logged_free(ballast_ptr);
+    bs_subprocess_destroy(spawn_arg.subprocess_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_spawn_rss_0(bs_test_t *test_ptr)
+{
+    _benchmark_spawn_with(test_ptr, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_spawn_rss_256(bs_test_t *test_ptr)
+{
+    _benchmark_spawn_with(test_ptr, 256);
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_spawn_rss_1024(bs_test_t *test_ptr)
+{
+    _benchmark_spawn_with(test_ptr, 1024);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Splits a commandline into an arena, `iterations` times. */
+static void _benchmark_split_command_fn(void *arg_ptr, uint64_t iterations)
+{
+    bs_arena_t *arena_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        _env_var_t *env_var_ptr;
+        char **argv_ptr = _split_command(
+            arena_ptr,
+            "LANG=C WAYLAND_DISPLAY=wayland-1 /usr/bin/foot --server "
+            "--title \"A terminal\" -o 'font=monospace:size=10' -e top",
+            &env_var_ptr);
+        BS_TEST_DO_NOT_OPTIMIZE(argv_ptr);
+        bs_arena_reset(arena_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+static void benchmark_split_command(bs_test_t *test_ptr)
+{
+    bs_arena_t *arena_ptr = bs_arena_create(0);
+    if (NULL == arena_ptr) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_arena_create(0)");
+        return;
+    }
+    if (!bs_test_bench(test_ptr, "_split_command",
+                       _benchmark_split_command_fn, arena_ptr, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(_split_command)");
+    }
+    bs_arena_destroy(arena_ptr);
+}
+
 /** @endcond */
 /* == End of subprocess.c ================================================== */
@@ -25,6 +25,7 @@
 #include "test.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <unistd.h>
 
 #ifdef __cplusplus
@@ -93,6 +94,11 @@ void bs_subprocess_destroy(bs_subprocess_t *subprocess_ptr);
  * A started sub-process can be stopped by calling |bs_subprocess_stop| (and
  * then can be started again), or by |bs_subprocess_destroy|.
  *
+ * The child is launched through posix_spawnp(3), which does not copy the
+ * parent's page tables and stays fast for parents with a large address
+ * space. It falls back to fork(2) if the environment overrides PATH, or if
+ * the executable cannot be run.
+ *
  * @param subprocess_ptr
  *
  * @return Whether the call succeeded.
@@ -152,10 +158,161 @@ pid_t bs_subprocess_pid(bs_subprocess_t *subprocess_ptr);
 const char *bs_subprocess_stdout(const bs_subprocess_t *subprocess_ptr);
 /** Provides a pointer to the stderr buffer for |subprocess_ptr|. */
 const char *bs_subprocess_stderr(const bs_subprocess_t *subprocess_ptr);
+/** Returns the number of bytes in the stdout buffer for |subprocess_ptr|. */
+size_t bs_subprocess_stdout_size(const bs_subprocess_t *subprocess_ptr);
+/** Returns the number of bytes in the stderr buffer for |subprocess_ptr|. */
+size_t bs_subprocess_stderr_size(const bs_subprocess_t *subprocess_ptr);
+
+/** Output streams of a sub-process. */
+typedef enum {
+    BS_SUBPROCESS_STDOUT = 0,
+    BS_SUBPROCESS_STDERR = 1
+} bs_subprocess_stream_t;
+
+/** What to keep, once output exceeds the capture buffer's maximum size. */
+typedef enum {
+    /** Keeps the first bytes, and discards later output. The default. */
+    BS_SUBPROCESS_CAPTURE_HEAD,
+    /** Keeps the most recent bytes, and discards older output. */
+    BS_SUBPROCESS_CAPTURE_TAIL
+} bs_subprocess_capture_mode_t;
+
+/**
+ * Callback for output of a sub-process, see @ref bs_subprocess_set_capture.
+ *
+ * @param subprocess_ptr
+ * @param stream
+ * @param data_ptr            The chunk that was read. Not NUL-terminated.
+ * @param size                Size of the chunk, in bytes.
+ * @param ud_ptr              As provided to @ref bs_subprocess_set_capture.
+ */
+typedef void (*bs_subprocess_output_callback_t)(
+    bs_subprocess_t *subprocess_ptr,
+    bs_subprocess_stream_t stream,
+    const char *data_ptr,
+    size_t size,
+    void *ud_ptr);
+
+/**
+ * Configures how stdout and stderr are captured. By default, the first 4096
+ * bytes of each are kept.
+ *
+ * The buffers start small, and grow geometrically up to `max_size` as
+ * output arrives. Each chunk read is also passed to `callback`. Output is
+ * read whenever @ref bs_subprocess_terminated or @ref bs_subprocess_stop
+ * are called, or when the @ref bs_subprocess_manager_t dispatches events.
+ *
+ * Must be called while the sub-process is not running. Clears the buffers.
+ *
+ * @param subprocess_ptr
+ * @param mode                What to keep, once output exceeds `max_size`.
+ * @param max_size            Maximum size of each buffer, in bytes. With 0,
+ *                            nothing is kept, and output is only streamed.
+ * @param callback            Optional, is called for each chunk of output.
+ * @param ud_ptr              Passed to `callback`.
+ *
+ * @return true on success.
+ */
+bool bs_subprocess_set_capture(
+    bs_subprocess_t *subprocess_ptr,
+    bs_subprocess_capture_mode_t mode,
+    size_t max_size,
+    bs_subprocess_output_callback_t callback,
+    void *ud_ptr);
+
+/**
+ * Supervises many sub-processes from a single epoll(7) set.
+ *
+ * The stdout and stderr pipes and a pidfd(2) of each registered sub-process
+ * are watched together. @ref bs_subprocess_manager_dispatch waits until any
+ * of them is ready, drains output into the sub-process' buffers, reaps
+ * children that exited and invokes their callbacks. Requires Linux 5.3 or
+ * later, for pidfd_open(2).
+ */
+typedef struct _bs_subprocess_manager_t bs_subprocess_manager_t;
+
+/**
+ * Callback for a terminated sub-process, see @ref bs_subprocess_manager_add.
+ *
+ * The sub-process is no longer registered with the manager when called, and
+ * the callback may destroy it, or start and register it again.
+ *
+ * @param subprocess_ptr
+ * @param exit_status         See @ref bs_subprocess_terminated.
+ * @param signal_number       See @ref bs_subprocess_terminated.
+ * @param ud_ptr              As provided to @ref bs_subprocess_manager_add.
+ */
+typedef void (*bs_subprocess_terminated_callback_t)(
+    bs_subprocess_t *subprocess_ptr,
+    int exit_status,
+    int signal_number,
+    void *ud_ptr);
+
+/** Creates a sub-process manager. Returns NULL on error. */
+bs_subprocess_manager_t *bs_subprocess_manager_create(void);
+
+/**
+ * Destroys the manager. Remaining sub-processes are unregistered, but not
+ * stopped.
+ *
+ * @param manager_ptr
+ */
+void bs_subprocess_manager_destroy(bs_subprocess_manager_t *manager_ptr);
+
+/**
+ * Registers a started sub-process with the manager.
+ *
+ * The sub-process remains registered until it has terminated, or until
+ * @ref bs_subprocess_manager_remove, @ref bs_subprocess_stop or
+ * @ref bs_subprocess_destroy are called for it. It can be registered with
+ * at most one manager at a time.
+ *
+ * @param manager_ptr
+ * @param subprocess_ptr
+ * @param callback            Invoked when the sub-process has terminated.
+ * @param ud_ptr              Passed to `callback`.
+ *
+ * @return true on success.
+ */
+bool bs_subprocess_manager_add(
+    bs_subprocess_manager_t *manager_ptr,
+    bs_subprocess_t *subprocess_ptr,
+    bs_subprocess_terminated_callback_t callback,
+    void *ud_ptr);
+
+/** Unregisters the sub-process from its manager, if any. */
+void bs_subprocess_manager_remove(bs_subprocess_t *subprocess_ptr);
+
+/** Returns the number of sub-processes registered with the manager. */
+size_t bs_subprocess_manager_size(bs_subprocess_manager_t *manager_ptr);
+
+/**
+ * Returns the manager's epoll(7) file descriptor. It is readable whenever
+ * @ref bs_subprocess_manager_dispatch has work, so it can be watched from
+ * another event loop.
+ */
+int bs_subprocess_manager_fd(bs_subprocess_manager_t *manager_ptr);
+
+/**
+ * Waits for events on the registered sub-processes, and handles them:
+ * Drains stdout and stderr, reaps terminated processes and invokes their
+ * callbacks.
+ *
+ * @param manager_ptr
+ * @param timeout_msec        Maximum time to wait, in milliseconds. 0 does
+ *                            not wait, -1 waits indefinitely.
+ *
+ * @return Number of sub-processes that terminated, or -1 on error.
+ */
+int bs_subprocess_manager_dispatch(bs_subprocess_manager_t *manager_ptr,
+                                   int timeout_msec);
 
 /** Unit tests. */
 extern const bs_test_case_t   bs_subprocess_test_cases[];
 
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_subprocess_benchmarks[];
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
@@ -0,0 +1,38 @@
+/* ========================================================================= */
+/**
+ * @file subprocess_test_chatty.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/** A test program that writes as many numbered lines to stdout as asked. */
+int main(int argc, char** argv) {
+    if (2 != argc) {
+        fprintf(stderr, "Expecting 1 arguments.\n");
+        return EXIT_FAILURE;
+    }
+
+    long lines = strtol(argv[1], NULL, 10);
+    for (long i = 0; i < lines; ++i) {
+        fprintf(stdout, "line %06ld\n", i);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* == End of subprocess_test_chatty.c ====================================== */
@@ -18,10 +18,15 @@
  * limitations under the License.
  */
 
+/// sched_setaffinity(2) and the CPU_* macros are Linux extensions.
+#define _GNU_SOURCE
+
 #include <curses.h>
 #include <stdarg.h>
 #include <fnmatch.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <sched.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -33,7 +38,11 @@
 #include "dllist.h"
 #include "file.h"
 #include "log_wrappers.h"
+#include "subprocess.h"
 #include "test.h"
+#include "time.h"
+
+#undef _GNU_SOURCE
 
 /** Information on current test case. */
 struct _bs_test_t {
@@ -41,11 +50,13 @@ struct _bs_test_t {
     int                       case_idx;
     /** Current test case descriptor. */
     const bs_test_case_t      *case_ptr;
+    /** Full name of the test case. May be NULL. */
+    const char                *full_name_ptr;
 
     /** Test outcome: Failed? */
     bool                      failed;
     /** Test report summary (through bs_test_succeed, bs_test_fail) */
-    char                      report[256];
+    char                      report[1024];
 };
 
 /** Terminal codes for commands we're requiring. */
@@ -92,6 +103,78 @@ struct bs_test_report {
     int                      total;
 };
 
+/** Formats for `--benchmark_output`. */
+enum _bs_test_bench_format {
+    BS_TEST_BENCH_FORMAT_JSON,
+    BS_TEST_BENCH_FORMAT_CSV
+};
+
+/** Double-linked-list node, holding a benchmark's result. */
+struct bs_test_bench_node {
+    /** Node of the double-linked list. */
+    bs_dllist_node_t          dlnode;
+    /** Full name of the benchmark: Test case, and benchmark name. */
+    char                      *name_ptr;
+    /** Statistics. */
+    bs_test_bench_stats_t     stats;
+};
+
+/** A test case, run in a worker process for `--jobs`. */
+struct bs_test_job {
+    /** The test set this case belongs to. */
+    const bs_test_set_t       *set_ptr;
+    /** Index of the set within the test sets. */
+    int                       set_idx;
+    /** State of the case: Outcome and report, as received from the worker. */
+    bs_test_t                 test;
+    /** Full name of the test case. */
+    char                      *full_name_ptr;
+    /** Whether the case runs, after applying the filter and the shard. */
+    bool                      enabled;
+    /** Whether the case is a benchmark, and must get a core to itself. */
+    bool                      benchmark;
+    /** Whether the case has completed, or was skipped. */
+    bool                      done;
+    /** The worker, while running. */
+    bs_subprocess_t           *subprocess_ptr;
+    /** Output of the worker on stderr. Printed before the report. */
+    char                      *output_ptr;
+    /** Results of @ref bs_test_bench, as received from the worker. */
+    bs_dllist_t               bench_results;
+    /** Back-link to the run. */
+    struct bs_test_parallel   *parallel_ptr;
+};
+
+/** State of a run with `--jobs`. */
+struct bs_test_parallel {
+    /** All test cases of the selected test sets, in order. */
+    struct bs_test_job        *jobs_ptr;
+    /** Number of elements at `jobs_ptr`. */
+    size_t                    jobs;
+    /** Maximum number of workers to run concurrently. */
+    size_t                    max_running;
+    /** Number of workers currently running. */
+    size_t                    running;
+    /** Number of benchmark workers currently running. At most 1. */
+    size_t                    benchmarks_running;
+    /** Supervises the workers. */
+    bs_subprocess_manager_t   *manager_ptr;
+    /** Summary of the test set currently being reported. */
+    struct bs_test_report     set_report;
+    /** Arguments for the worker, with a slot for `--test_worker`. */
+    const char                **argv_ptr;
+    /** Index of the `--test_worker` argument in `argv_ptr`. */
+    int                       worker_arg_idx;
+    /** Whether workers get pinned: Benchmarks to one core, others not. */
+    bool                      pin;
+    /** CPUs of this process. Restored after starting a worker. */
+    cpu_set_t                 all_cpus;
+    /** CPUs for non-benchmark workers: All but the benchmark core. */
+    cpu_set_t                 test_cpus;
+    /** The core reserved for benchmarks. */
+    cpu_set_t                 benchmark_cpus;
+};
+
 /* Other helpers */
 static void bs_test_tcode_init(void);
 static int bs_test_putc(int c);
@@ -104,6 +187,9 @@ static void bs_test_set_report(const bs_test_set_t *set_ptr,
 static int bs_test_set(const bs_test_set_t *set_ptr,
                        const char *pattern_ptr,
                        bs_dllist_t *failed_tests_ptr);
+static bool bs_test_set_selected(const bs_test_set_t *set_ptr,
+                                 int argc,
+                                 const char **argv);
 
 /* Testcase helpers. */
 static void bs_test_case_prepare(bs_test_t *test_ptr,
@@ -118,6 +204,53 @@ static void bs_test_case_fail_node_destroy(
 static char *bs_test_case_create_full_name(
     const bs_test_set_t *set_ptr,
     const bs_test_case_t *case_ptr);
+static bool bs_test_case_in_shard(void);
+
+/* Helpers for `--jobs`. */
+static int bs_test_worker(const bs_test_set_t *test_sets,
+                          const char *worker_ptr);
+static bool bs_test_parallel(const bs_test_set_t *test_sets,
+                             size_t max_running,
+                             int argc,
+                             const char **argv,
+                             const char **worker_argv,
+                             struct bs_test_report *report_ptr,
+                             bs_dllist_t *failed_tests_ptr);
+static bool bs_test_parallel_init_cpus(struct bs_test_parallel *par_ptr);
+static bool bs_test_job_start(struct bs_test_parallel *par_ptr,
+                              struct bs_test_job *job_ptr);
+static void bs_test_job_terminated(bs_subprocess_t *subprocess_ptr,
+                                   int exit_status,
+                                   int signal_number,
+                                   void *ud_ptr);
+static bool bs_test_job_parse_result(struct bs_test_job *job_ptr,
+                                     const char *data_ptr,
+                                     size_t size);
+static void bs_test_job_fail(struct bs_test_job *job_ptr,
+                             const char *fmt_ptr, ...) __ARG_PRINTF__(2, 3);
+static size_t bs_test_parallel_flush(struct bs_test_parallel *par_ptr,
+                                     size_t job_idx,
+                                     struct bs_test_report *report_ptr,
+                                     bs_dllist_t *failed_tests_ptr);
+
+/* Benchmark helpers. */
+static bool bs_test_bench_with(
+    bs_test_t *test_ptr,
+    const char *name_ptr,
+    bs_test_bench_fn_t fn,
+    void *arg_ptr,
+    unsigned samples,
+    uint64_t sample_nsec,
+    bs_test_bench_stats_t *stats_ptr);
+static uint64_t bs_test_bench_sample(bs_test_bench_fn_t fn,
+                                     void *arg_ptr,
+                                     uint64_t iterations);
+static int bs_test_bench_cmp(const void *a_ptr, const void *b_ptr);
+static double bs_test_bench_sqrt(double value);
+static bool bs_test_bench_write(const char *fname_ptr, int format);
+static void bs_test_bench_write_name(FILE *file_ptr,
+                                     const char *name_ptr,
+                                     int format);
 
 /* == Data ================================================================= */
 
@@ -134,6 +267,31 @@ static const char             *bs_test_report_separator_ptr =
 
 static char                  *bs_test_filter_ptr = NULL;
 static char                  *bs_test_data_dir_ptr = NULL;
+static uint32_t              bs_test_bench_samples = 15;
+static uint32_t              bs_test_bench_sample_msec = 100;
+static char                  *bs_test_bench_output_ptr = NULL;
+static int                   bs_test_bench_format = BS_TEST_BENCH_FORMAT_JSON;
+static uint32_t              bs_test_jobs = 1;
+static uint32_t              bs_test_shard_index = 0;
+static uint32_t              bs_test_shard_count = 1;
+static char                  *bs_test_benchmark_filter_ptr = NULL;
+static char                  *bs_test_worker_ptr = NULL;
+
+/** Ordinal of the next selected test case, for `--test_shard_count`. */
+static uint32_t              bs_test_case_ordinal = 0;
+
+/** Maximum size of a worker's captured output, per stream. */
+static const size_t          bs_test_worker_output_size = 65536;
+
+/** Results of @ref bs_test_bench, for `--benchmark_output`. */
+static bs_dllist_t           bs_test_bench_results;
+
+/** Values for `--benchmark_format`. */
+static const bs_arg_enum_table_t bs_test_bench_formats[] = {
+    { "json", BS_TEST_BENCH_FORMAT_JSON },
+    { "csv", BS_TEST_BENCH_FORMAT_CSV },
+    { NULL, 0 }
+};
 
 static const bs_arg_t        bs_test_args[] = {
     BS_ARG_STRING(
@@ -148,6 +306,58 @@ static const bs_arg_t        bs_test_args[] = {
         "bs_test().",
         NULL,
         &bs_test_data_dir_ptr),
+    BS_ARG_UINT32(
+        "benchmark_samples",
+        "Number of samples to take for each benchmark.",
+        15, 1, 100000,
+        &bs_test_bench_samples),
+    BS_ARG_UINT32(
+        "benchmark_sample_msec",
+        "Duration to calibrate each benchmark sample for, in milliseconds.",
+        100, 1, 3600000,
+        &bs_test_bench_sample_msec),
+    BS_ARG_STRING(
+        "benchmark_output",
+        "File to write benchmark results to, once all tests ran.",
+        NULL,
+        &bs_test_bench_output_ptr),
+    BS_ARG_ENUM(
+        "benchmark_format",
+        "Format of --benchmark_output: \"json\" or \"csv\".",
+        "json",
+        bs_test_bench_formats,
+        &bs_test_bench_format),
+    BS_ARG_UINT32(
+        "jobs",
+        "Number of test cases to run concurrently. Each case then runs in a "
+        "worker process of its own, isolated from crashes of the others. "
+        "0 runs as many as there are online CPUs.",
+        1, 0, 1024,
+        &bs_test_jobs),
+    BS_ARG_UINT32(
+        "test_shard_index",
+        "Index of the shard to run, from 0 to --test_shard_count - 1.",
+        0, 0, UINT32_MAX - 1,
+        &bs_test_shard_index),
+    BS_ARG_UINT32(
+        "test_shard_count",
+        "Number of shards to split the selected test cases into. Each shard "
+        "runs every --test_shard_count-th case, and skips the others.",
+        1, 1, UINT32_MAX,
+        &bs_test_shard_count),
+    BS_ARG_STRING(
+        "test_benchmark_filter",
+        "With --jobs, test cases matching this filter are benchmarks: They "
+        "run one at a time, pinned to a core reserved for them. Uses fnmatch "
+        "on the full name.",
+        "*benchmark*",
+        &bs_test_benchmark_filter_ptr),
+    BS_ARG_STRING(
+        "test_worker",
+        "Internal, for --jobs: Runs only test case <set>.<case> (indices), "
+        "and writes its result to stdout.",
+        NULL,
+        &bs_test_worker_ptr),
     BS_ARG_SENTINEL()
 };
 
@@ -161,13 +371,27 @@ int bs_test(
     const bs_test_param_t *param_ptr)
 {
     struct bs_test_report     report;
-    int                       i;
-    bool                      run_set;
     bs_dllist_t               failed_tests;
 
     if (NULL == test_sets) return 0;
+
+    // The workers for `--jobs` get the same arguments. Parsing re-orders.
+    const char **orig_argv = logged_calloc(argc + 1, sizeof(const char*));
+    if (NULL == orig_argv) return -1;
+    memcpy(orig_argv, argv, argc * sizeof(const char*));
+    int orig_argc = argc;
+
     if (!bs_arg_parse(bs_test_args, BS_ARG_MODE_NO_EXTRA, &argc, argv)) {
         bs_arg_print_usage(stderr, bs_test_args);
+        logged_free(orig_argv);
+        return -1;
+    }
+    if (bs_test_shard_index >= bs_test_shard_count) {
+        bs_log(BS_ERROR, "--test_shard_index %"PRIu32" must be less than "
+               "--test_shard_count %"PRIu32, bs_test_shard_index,
+               bs_test_shard_count);
+        bs_arg_cleanup(bs_test_args);
+        logged_free(orig_argv);
         return -1;
     }
 
@@ -175,37 +399,51 @@ int bs_test(
         NULL != param_ptr &&
         NULL != param_ptr->test_data_dir_ptr) {
         bs_test_data_dir_ptr = logged_strdup(param_ptr->test_data_dir_ptr);
-        if (NULL == bs_test_data_dir_ptr) return -1;
+        if (NULL == bs_test_data_dir_ptr) {
+            logged_free(orig_argv);
+            return -1;
+        }
+    }
+
+    if (NULL != bs_test_worker_ptr) {
+        int rv = bs_test_worker(test_sets, bs_test_worker_ptr);
+        bs_arg_cleanup(bs_test_args);
+        logged_free(orig_argv);
+        return rv;
     }
 
     bs_test_tcode_init();
 
     memset(&report, 0, sizeof(report));
     memset(&failed_tests, 0, sizeof(failed_tests));
+    uint32_t jobs = bs_test_jobs;
+    if (0 == jobs) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = 0 < cpus ? (uint32_t)cpus : 1;
+    }
     /** List of all failed tests. */
-    while (NULL != test_sets->name_ptr) {
-
-        /* If any args are given, check if the name matches. */
-        run_set = 1 >= argc;
-        for (i = 1; i < argc; i++) {
-            if (0 == strcmp(argv[i], test_sets->name_ptr)) {
-                run_set = true;;
-            }
+    if (1 < jobs) {
+        orig_argv[orig_argc] = NULL;
+        if (!bs_test_parallel(test_sets, jobs, argc, argv, orig_argv + 1,
+                              &report, &failed_tests)) {
+            report.failed++;
         }
-
-        if (run_set && test_sets->enabled) {
-            if (bs_test_set(test_sets, bs_test_filter_ptr, &failed_tests)) {
-                report.failed++;
+    } else {
+        for (; NULL != test_sets->name_ptr; ++test_sets) {
+            if (bs_test_set_selected(test_sets, argc, argv)) {
+                if (bs_test_set(test_sets, bs_test_filter_ptr,
+                                &failed_tests)) {
+                    report.failed++;
+                } else {
+                    report.succeeded++;
+                }
             } else {
-                report.succeeded++;
+                report.skipped++;
             }
-        } else {
-            report.skipped++;
+            report.total++;
         }
-
-        report.total++;
-        test_sets++;
     }
+    logged_free(orig_argv);
 
     if (report.failed) {
         bs_test_attr(BS_TEST_ATTR_FAIL);
@@ -233,8 +471,21 @@ int bs_test(
     }
 
     BS_ASSERT(0 == bs_dllist_size(&failed_tests));
+
+    int rv = report.failed;
+    if (NULL != bs_test_bench_output_ptr &&
+        !bs_test_bench_write(bs_test_bench_output_ptr, bs_test_bench_format)) {
+        rv = -1;
+    }
+    struct bs_test_bench_node *bnode_ptr;
+    while (NULL != (bnode_ptr = (struct bs_test_bench_node*)
+                    bs_dllist_pop_front(&bs_test_bench_results))) {
+        logged_free(bnode_ptr->name_ptr);
+        logged_free(bnode_ptr);
+    }
+
     bs_arg_cleanup(bs_test_args);
-    return report.failed;
+    return rv;
 }
 
 
@@ -277,6 +528,42 @@ bool bs_test_failed(bs_test_t *test_ptr)
     return test_ptr->failed;
 }
 
+/* ------------------------------------------------------------------------- */
+bool bs_test_bench(
+    bs_test_t *test_ptr,
+    const char *name_ptr,
+    bs_test_bench_fn_t fn,
+    void *arg_ptr,
+    bs_test_bench_stats_t *stats_ptr)
+{
+    struct bs_test_bench_node *bnode_ptr = logged_calloc(
+        1, sizeof(struct bs_test_bench_node));
+    if (NULL == bnode_ptr) return false;
+
+    if (!bs_test_bench_with(test_ptr, name_ptr, fn, arg_ptr,
+                            bs_test_bench_samples,
+                            bs_test_bench_sample_msec * UINT64_C(1000000),
+                            &bnode_ptr->stats)) {
+        logged_free(bnode_ptr);
+        return false;
+    }
+    if (NULL != stats_ptr) *stats_ptr = bnode_ptr->stats;
+
+    const char *test_name_ptr =
+        NULL != test_ptr->full_name_ptr ? test_ptr->full_name_ptr : "";
+    bnode_ptr->name_ptr = logged_malloc(
+        strlen(test_name_ptr) + strlen(name_ptr) + 2);
+    if (NULL == bnode_ptr->name_ptr) {
+        logged_free(bnode_ptr);
+        return false;
+    }
+    strcpy(bnode_ptr->name_ptr, test_name_ptr);
+    strcat(bnode_ptr->name_ptr, "/");
+    strcat(bnode_ptr->name_ptr, name_ptr);
+    bs_dllist_push_back(&bs_test_bench_results, &bnode_ptr->dlnode);
+    return true;
+}
+
 /* ------------------------------------------------------------------------- */
 void bs_test_verify_streq_at(
     bs_test_t *test_ptr,
@@ -536,12 +823,14 @@ int bs_test_set(const bs_test_set_t *set_ptr,
         bool enabled = case_ptr->enabled;
 
         char *full_name_ptr = bs_test_case_create_full_name(set_ptr, case_ptr);
+        test.full_name_ptr = full_name_ptr;
         if (NULL == full_name_ptr) {
             test.failed = true;
         } else {
             if (fnmatch(pattern_ptr, full_name_ptr, 0)) {
                 enabled = false;
             }
+            if (enabled && !bs_test_case_in_shard()) enabled = false;
             if (enabled) {
                 case_ptr->test_fn(&test);
             }
@@ -560,7 +849,8 @@ int bs_test_set(const bs_test_set_t *set_ptr,
             }
         }
 
-        if (NULL != full_name_ptr) free(full_name_ptr);
+        if (NULL != full_name_ptr) logged_free(full_name_ptr);
+        test.full_name_ptr = NULL;
 
         bs_test_case_report(&test, enabled);
     }
@@ -569,6 +859,27 @@ int bs_test_set(const bs_test_set_t *set_ptr,
     return set_report.failed;
 }
 
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns whether the test set is to run: It must be enabled, and match one
+ * of the extra args, if any.
+ *
+ * @param set_ptr
+ * @param argc
+ * @param argv
+ */
+bool bs_test_set_selected(const bs_test_set_t *set_ptr,
+                          int argc,
+                          const char **argv)
+{
+    if (!set_ptr->enabled) return false;
+    if (1 >= argc) return true;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], set_ptr->name_ptr)) return true;
+    }
+    return false;
+}
+
 /* ------------------------------------------------------------------------- */
 /**
  * Prepares test_ptr for this test case.
@@ -583,6 +894,7 @@ void bs_test_case_prepare(bs_test_t *test_ptr,
 {
     test_ptr->case_idx = case_idx;
     test_ptr->case_ptr = set_ptr->case_ptr + case_idx;
+    test_ptr->full_name_ptr = NULL;
     test_ptr->failed = false;
     memset(test_ptr->report, 0, sizeof(test_ptr->report));
 }
@@ -653,9 +965,9 @@ struct bs_test_fail_node *bs_test_case_fail_node_create(char *full_name_ptr)
 void bs_test_case_fail_node_destroy(struct bs_test_fail_node *fnode_ptr)
 {
     if (NULL != fnode_ptr->full_name_ptr) {
-        free(fnode_ptr->full_name_ptr);
+        logged_free(fnode_ptr->full_name_ptr);
     }
-    free(fnode_ptr);
+    logged_free(fnode_ptr);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -681,15 +993,734 @@ char *bs_test_case_create_full_name(
     return full_name_ptr;
 }
 
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns whether the next selected test case belongs to the shard to run,
+ * and advances the ordinal.
+ */
+bool bs_test_case_in_shard(void)
+{
+    return (bs_test_case_ordinal++ % bs_test_shard_count ==
+            bs_test_shard_index);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs a single test case as worker for `--jobs`, and writes the result to
+ * stdout. Output of the test case is redirected to stderr.
+ *
+ * The result holds one line per benchmark result, in the form of
+ * `B <iterations> <samples> <median> <p99> <mean> <stddev> <min> <name>`.
+ * Then a line with `S` or `F` for success or failure, followed by the
+ * test's report until the end.
+ *
+ * @param test_sets
+ * @param worker_ptr          Indices of the set and the case, `<set>.<case>`.
+ *
+ * @return 0 if the result was written, or -1 on error.
+ */
+int bs_test_worker(const bs_test_set_t *test_sets, const char *worker_ptr)
+{
+    int set_idx, case_idx, pos = 0;
+    if (2 != sscanf(worker_ptr, "%d.%d%n", &set_idx, &case_idx, &pos) ||
+        '\0' != worker_ptr[pos] || 0 > set_idx || 0 > case_idx) {
+        bs_log(BS_ERROR, "Invalid --test_worker \"%s\"", worker_ptr);
+        return -1;
+    }
+    const bs_test_set_t *set_ptr = test_sets;
+    for (int i = 0; i < set_idx && NULL != set_ptr->name_ptr; ++i) ++set_ptr;
+    if (NULL == set_ptr->name_ptr) {
+        bs_log(BS_ERROR, "No test set at index %d", set_idx);
+        return -1;
+    }
+    for (int i = 0; i <= case_idx; ++i) {
+        if (NULL == set_ptr->case_ptr[i].name_ptr) {
+            bs_log(BS_ERROR, "No test case at index %d in set %s",
+                   case_idx, set_ptr->name_ptr);
+            return -1;
+        }
+    }
+
+    // Keeps stdout for the result, and sends the test's output to stderr.
+    int result_fd = dup(1);
+    if (0 > result_fd) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed dup(1)");
+        return -1;
+    }
+    FILE *file_ptr = fdopen(result_fd, "w");
+    if (NULL == file_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed fdopen(%d, \"w\")", result_fd);
+        close(result_fd);
+        return -1;
+    }
+    if (0 > dup2(2, 1)) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed dup2(2, 1)");
+        fclose(file_ptr);
+        return -1;
+    }
+
+    bs_test_t test;
+    bs_test_case_prepare(&test, set_ptr, case_idx);
+    char *full_name_ptr = bs_test_case_create_full_name(set_ptr,
+                                                        test.case_ptr);
+    test.full_name_ptr = full_name_ptr;
+    if (NULL == full_name_ptr) {
+        test.failed = true;
+    } else {
+        test.case_ptr->test_fn(&test);
+        logged_free(full_name_ptr);
+        test.full_name_ptr = NULL;
+    }
+
+    struct bs_test_bench_node *bnode_ptr;
+    while (NULL != (bnode_ptr = (struct bs_test_bench_node*)
+                    bs_dllist_pop_front(&bs_test_bench_results))) {
+        const bs_test_bench_stats_t *s_ptr = &bnode_ptr->stats;
+        fprintf(file_ptr, "B %"PRIu64" %u %.17g %.17g %.17g %.17g %.17g %s\n",
+                s_ptr->iterations, s_ptr->samples, s_ptr->median_nsec,
+                s_ptr->p99_nsec, s_ptr->mean_nsec, s_ptr->stddev_nsec,
+                s_ptr->min_nsec, bnode_ptr->name_ptr);
+        logged_free(bnode_ptr->name_ptr);
+        logged_free(bnode_ptr);
+    }
+    fprintf(file_ptr, "%c\n%s", test.failed ? 'F' : 'S', test.report);
+
+    bool rv = !ferror(file_ptr);
+    if (0 != fclose(file_ptr)) rv = false;
+    return rv ? 0 : -1;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs the selected test sets with `--jobs`: Each test case runs in a worker
+ * process, re-executing this program with `--test_worker`. Up to
+ * `max_running` workers run concurrently, and are supervised by a
+ * @ref bs_subprocess_manager_t. Results are reported in order of the cases,
+ * same as when running sequentially.
+ *
+ * @param test_sets
+ * @param max_running
+ * @param argc
+ * @param argv
+ * @param worker_argv         Arguments for the workers, NULL-terminated.
+ * @param report_ptr          Summary across the test sets. Will be updated.
+ * @param failed_tests_ptr    Failed test cases are appended here.
+ *
+ * @return false on error.
+ */
+bool bs_test_parallel(const bs_test_set_t *test_sets,
+                      size_t max_running,
+                      int argc,
+                      const char **argv,
+                      const char **worker_argv,
+                      struct bs_test_report *report_ptr,
+                      bs_dllist_t *failed_tests_ptr)
+{
+    struct bs_test_parallel   par = { .max_running = max_running };
+    bool                      rv = false;
+
+    for (const bs_test_set_t *set_ptr = test_sets;
+         NULL != set_ptr->name_ptr;
+         ++set_ptr) {
+        if (!bs_test_set_selected(set_ptr, argc, argv)) continue;
+        for (const bs_test_case_t *case_ptr = set_ptr->case_ptr;
+             NULL != case_ptr->name_ptr;
+             ++case_ptr) ++par.jobs;
+    }
+    size_t worker_argc = 0;
+    while (NULL != worker_argv[worker_argc]) ++worker_argc;
+
+    par.jobs_ptr = logged_calloc(BS_MAX(par.jobs, (size_t)1),
+                                 sizeof(struct bs_test_job));
+    par.argv_ptr = logged_calloc(worker_argc + 2, sizeof(const char*));
+    par.manager_ptr = bs_subprocess_manager_create();
+    if (NULL == par.jobs_ptr ||
+        NULL == par.argv_ptr ||
+        NULL == par.manager_ptr) goto cleanup;
+    memcpy(par.argv_ptr, worker_argv, worker_argc * sizeof(const char*));
+    par.worker_arg_idx = worker_argc;
+
+    struct bs_test_job *job_ptr = par.jobs_ptr;
+    for (int set_idx = 0; NULL != test_sets[set_idx].name_ptr; ++set_idx) {
+        const bs_test_set_t *set_ptr = &test_sets[set_idx];
+        report_ptr->total++;
+        if (!bs_test_set_selected(set_ptr, argc, argv)) {
+            report_ptr->skipped++;
+            continue;
+        }
+
+        for (int case_idx = 0;
+             NULL != set_ptr->case_ptr[case_idx].name_ptr;
+             ++case_idx, ++job_ptr) {
+            job_ptr->set_ptr = set_ptr;
+            job_ptr->set_idx = set_idx;
+            job_ptr->parallel_ptr = &par;
+            bs_test_case_prepare(&job_ptr->test, set_ptr, case_idx);
+            job_ptr->enabled = job_ptr->test.case_ptr->enabled;
+            job_ptr->full_name_ptr = bs_test_case_create_full_name(
+                set_ptr, job_ptr->test.case_ptr);
+            if (NULL == job_ptr->full_name_ptr) {
+                job_ptr->test.failed = true;
+                job_ptr->done = true;
+                continue;
+            }
+
+            if (fnmatch(bs_test_filter_ptr, job_ptr->full_name_ptr, 0)) {
+                job_ptr->enabled = false;
+            }
+            if (job_ptr->enabled && !bs_test_case_in_shard()) {
+                job_ptr->enabled = false;
+            }
+            job_ptr->benchmark = 0 == fnmatch(
+                bs_test_benchmark_filter_ptr, job_ptr->full_name_ptr, 0);
+            job_ptr->done = !job_ptr->enabled;
+            if (job_ptr->enabled && job_ptr->benchmark) par.pin = true;
+        }
+    }
+    if (par.pin) par.pin = bs_test_parallel_init_cpus(&par);
+
+    size_t flushed = 0;
+    for (;;) {
+        flushed = bs_test_parallel_flush(
+            &par, flushed, report_ptr, failed_tests_ptr);
+        if (flushed >= par.jobs) break;
+
+        for (size_t i = flushed;
+             i < par.jobs && par.running < par.max_running;
+             ++i) {
+            job_ptr = &par.jobs_ptr[i];
+            if (job_ptr->done || NULL != job_ptr->subprocess_ptr) continue;
+            if (job_ptr->benchmark && 0 < par.benchmarks_running) continue;
+            bs_test_job_start(&par, job_ptr);
+        }
+        if (0 == par.running) continue;
+
+        if (0 > bs_subprocess_manager_dispatch(par.manager_ptr, -1)) {
+            // Stops all workers, and reports their cases as failed.
+            for (size_t i = flushed; i < par.jobs; ++i) {
+                job_ptr = &par.jobs_ptr[i];
+                if (job_ptr->done) continue;
+                if (NULL != job_ptr->subprocess_ptr) {
+                    bs_subprocess_destroy(job_ptr->subprocess_ptr);
+                    job_ptr->subprocess_ptr = NULL;
+                }
+                bs_test_job_fail(job_ptr, "Aborted: Failed dispatching "
+                                 "worker events.");
+            }
+            par.running = 0;
+        }
+    }
+    rv = true;
+
+cleanup:
+    for (size_t i = 0; NULL != par.jobs_ptr && i < par.jobs; ++i) {
+        job_ptr = &par.jobs_ptr[i];
+        if (NULL != job_ptr->subprocess_ptr) {
+            bs_subprocess_destroy(job_ptr->subprocess_ptr);
+        }
+        if (NULL != job_ptr->full_name_ptr) logged_free(job_ptr->full_name_ptr);
+        if (NULL != job_ptr->output_ptr) logged_free(job_ptr->output_ptr);
+        struct bs_test_bench_node *bnode_ptr;
+        while (NULL != (bnode_ptr = (struct bs_test_bench_node*)
+                        bs_dllist_pop_front(&job_ptr->bench_results))) {
+            logged_free(bnode_ptr->name_ptr);
+            logged_free(bnode_ptr);
+        }
+    }
+    if (NULL != par.manager_ptr) {
+        bs_subprocess_manager_destroy(par.manager_ptr);
+    }
+    if (NULL != par.argv_ptr) logged_free(par.argv_ptr);
+    if (NULL != par.jobs_ptr) logged_free(par.jobs_ptr);
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Reserves the highest CPU of this process for benchmarks, and the others
+ * for the remaining test cases.
+ *
+ * @param par_ptr
+ *
+ * @return true if there are at least two CPUs to split.
+ */
+bool bs_test_parallel_init_cpus(struct bs_test_parallel *par_ptr)
+{
+    if (0 != sched_getaffinity(0, sizeof(cpu_set_t), &par_ptr->all_cpus)) {
+        bs_log(BS_WARNING | BS_ERRNO, "Failed sched_getaffinity(0, %zu, %p)",
+               sizeof(cpu_set_t), &par_ptr->all_cpus);
+        return false;
+    }
+    if (2 > CPU_COUNT(&par_ptr->all_cpus)) return false;
+
+    int cpu = CPU_SETSIZE - 1;
+    while (!CPU_ISSET(cpu, &par_ptr->all_cpus)) --cpu;
+    par_ptr->test_cpus = par_ptr->all_cpus;
+    CPU_CLR(cpu, &par_ptr->test_cpus);
+    CPU_ZERO(&par_ptr->benchmark_cpus);
+    CPU_SET(cpu, &par_ptr->benchmark_cpus);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Starts the worker for `job_ptr`, and registers it with the manager. The
+ * worker inherits the CPU affinity from this thread at start. Reports the
+ * case as failed, if the worker cannot be started.
+ *
+ * @param par_ptr
+ * @param job_ptr
+ *
+ * @return true on success.
+ */
+bool bs_test_job_start(struct bs_test_parallel *par_ptr,
+                       struct bs_test_job *job_ptr)
+{
+    char worker_arg[64];
+    snprintf(worker_arg, sizeof(worker_arg), "--test_worker=%d.%d",
+             job_ptr->set_idx, job_ptr->test.case_idx);
+    par_ptr->argv_ptr[par_ptr->worker_arg_idx] = worker_arg;
+
+    job_ptr->subprocess_ptr = bs_subprocess_create(
+        "/proc/self/exe", par_ptr->argv_ptr, NULL);
+    par_ptr->argv_ptr[par_ptr->worker_arg_idx] = NULL;
+    if (NULL == job_ptr->subprocess_ptr) {
+        bs_test_job_fail(job_ptr, "Failed bs_subprocess_create()");
+        return false;
+    }
+
+    bool started = bs_subprocess_set_capture(
+        job_ptr->subprocess_ptr, BS_SUBPROCESS_CAPTURE_TAIL,
+        bs_test_worker_output_size, NULL, NULL);
+    if (started && par_ptr->pin) {
+        sched_setaffinity(0, sizeof(cpu_set_t),
+                          job_ptr->benchmark ?
+                          &par_ptr->benchmark_cpus : &par_ptr->test_cpus);
+    }
+    started = started && bs_subprocess_start(job_ptr->subprocess_ptr);
+    if (par_ptr->pin) {
+        sched_setaffinity(0, sizeof(cpu_set_t), &par_ptr->all_cpus);
+    }
+    if (!started ||
+        !bs_subprocess_manager_add(par_ptr->manager_ptr,
+                                   job_ptr->subprocess_ptr,
+                                   bs_test_job_terminated,
+                                   job_ptr)) {
+        bs_subprocess_destroy(job_ptr->subprocess_ptr);
+        job_ptr->subprocess_ptr = NULL;
+        bs_test_job_fail(job_ptr, "Failed to start worker.");
+        return false;
+    }
+
+    par_ptr->running++;
+    if (job_ptr->benchmark) par_ptr->benchmarks_running++;
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Callback for a terminated worker: Collects the result and the output,
+ * and completes the job.
+ *
+ * @param subprocess_ptr
+ * @param exit_status
+ * @param signal_number
+ * @param ud_ptr              The @ref bs_test_job.
+ */
+void bs_test_job_terminated(bs_subprocess_t *subprocess_ptr,
+                            int exit_status,
+                            int signal_number,
+                            void *ud_ptr)
+{
+    struct bs_test_job *job_ptr = ud_ptr;
+    struct bs_test_parallel *par_ptr = job_ptr->parallel_ptr;
+
+    if (0 != signal_number) {
+        bs_test_job_fail(job_ptr, "Worker terminated by signal %d (%s).",
+                         signal_number, strsignal(signal_number));
+    } else if (!bs_test_job_parse_result(
+                   job_ptr,
+                   bs_subprocess_stdout(subprocess_ptr),
+                   bs_subprocess_stdout_size(subprocess_ptr))) {
+        bs_test_job_fail(job_ptr, "Worker exited with status %d, without "
+                         "a result.", exit_status);
+    } else if (0 != exit_status) {
+        bs_test_job_fail(job_ptr, "Worker exited with status %d.",
+                         exit_status);
+    }
+
+    size_t size = bs_subprocess_stderr_size(subprocess_ptr);
+    if (0 < size) {
+        job_ptr->output_ptr = logged_malloc(size + 1);
+        if (NULL != job_ptr->output_ptr) {
+            memcpy(job_ptr->output_ptr,
+                   bs_subprocess_stderr(subprocess_ptr), size);
+            job_ptr->output_ptr[size] = '\0';
+        }
+    }
+
+    bs_subprocess_destroy(subprocess_ptr);
+    job_ptr->subprocess_ptr = NULL;
+    par_ptr->running--;
+    if (job_ptr->benchmark) par_ptr->benchmarks_running--;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Parses the result written by @ref bs_test_worker into `job_ptr`, and
+ * completes the job.
+ *
+ * @param job_ptr
+ * @param data_ptr
+ * @param size
+ *
+ * @return true on success.
+ */
+bool bs_test_job_parse_result(struct bs_test_job *job_ptr,
+                              const char *data_ptr,
+                              size_t size)
+{
+    while (0 < size) {
+        const char *eol_ptr = memchr(data_ptr, '\n', size);
+        if (NULL == eol_ptr) return false;
+        size_t len = eol_ptr - data_ptr;
+
+        if (1 == len && ('S' == *data_ptr || 'F' == *data_ptr)) {
+            job_ptr->test.failed = 'F' == *data_ptr;
+            size_t report_size = BS_MIN(
+                size - 2, sizeof(job_ptr->test.report) - 1);
+            memcpy(job_ptr->test.report, eol_ptr + 1, report_size);
+            job_ptr->test.report[report_size] = '\0';
+            job_ptr->done = true;
+            return true;
+        }
+        if (0 == len || 'B' != *data_ptr) return false;
+
+        struct bs_test_bench_node *bnode_ptr = logged_calloc(
+            1, sizeof(struct bs_test_bench_node));
+        if (NULL == bnode_ptr) return false;
+        bnode_ptr->name_ptr = logged_malloc(len + 1);
+        if (NULL == bnode_ptr->name_ptr) {
+            logged_free(bnode_ptr);
+            return false;
+        }
+        memcpy(bnode_ptr->name_ptr, data_ptr, len);
+        bnode_ptr->name_ptr[len] = '\0';
+
+        bs_test_bench_stats_t *s_ptr = &bnode_ptr->stats;
+        int pos = 0;
+        if (7 != sscanf(bnode_ptr->name_ptr,
+                        "B %"SCNu64" %u %lf %lf %lf %lf %lf %n",
+                        &s_ptr->iterations, &s_ptr->samples,
+                        &s_ptr->median_nsec, &s_ptr->p99_nsec,
+                        &s_ptr->mean_nsec, &s_ptr->stddev_nsec,
+                        &s_ptr->min_nsec, &pos) || 0 == pos) {
+            logged_free(bnode_ptr->name_ptr);
+            logged_free(bnode_ptr);
+            return false;
+        }
+        memmove(bnode_ptr->name_ptr, bnode_ptr->name_ptr + pos,
+                len + 1 - pos);
+        bs_dllist_push_back(&job_ptr->bench_results, &bnode_ptr->dlnode);
+
+        data_ptr = eol_ptr + 1;
+        size -= len + 1;
+    }
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Reports the job as failed, with the formatted message, and completes it.
+ *
+ * @param job_ptr
+ * @param fmt_ptr
+ * @param ...
+ */
+void bs_test_job_fail(struct bs_test_job *job_ptr, const char *fmt_ptr, ...)
+{
+    va_list                   ap;
+
+    job_ptr->test.failed = true;
+    va_start(ap, fmt_ptr);
+    vsnprintf(job_ptr->test.report, sizeof(job_ptr->test.report),
+              fmt_ptr, ap);
+    va_end(ap);
+    job_ptr->done = true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Reports all completed jobs from `job_idx` on, until the first that has
+ * not completed yet. Prints set headers and summaries as for a sequential
+ * run, and moves benchmark results into the global results.
+ *
+ * @param par_ptr
+ * @param job_idx             Index of the first job not yet reported.
+ * @param report_ptr          Summary across the test sets. Will be updated.
+ * @param failed_tests_ptr    Failed test cases are appended here.
+ *
+ * @return Index of the first job not yet reported.
+ */
+size_t bs_test_parallel_flush(struct bs_test_parallel *par_ptr,
+                              size_t job_idx,
+                              struct bs_test_report *report_ptr,
+                              bs_dllist_t *failed_tests_ptr)
+{
+    for (; job_idx < par_ptr->jobs && par_ptr->jobs_ptr[job_idx].done;
+         ++job_idx) {
+        struct bs_test_job *job_ptr = &par_ptr->jobs_ptr[job_idx];
+        struct bs_test_report *set_report_ptr = &par_ptr->set_report;
+
+        if (0 == job_ptr->test.case_idx) {
+            bs_test_puts("%s\n Set: %-73.73s\n",
+                         bs_test_report_separator_ptr,
+                         job_ptr->set_ptr->name_ptr);
+            memset(set_report_ptr, 0, sizeof(struct bs_test_report));
+        }
+        bs_test_puts("%s\n", bs_test_linesep_ptr);
+        if (NULL != job_ptr->output_ptr) {
+            fputs(job_ptr->output_ptr, stderr);
+            fflush(stderr);
+        }
+
+        if (!job_ptr->enabled) {
+            set_report_ptr->skipped++;
+        } else if (!job_ptr->test.failed) {
+            set_report_ptr->succeeded++;
+        } else {
+            set_report_ptr->failed++;
+            struct bs_test_fail_node *fnode_ptr =
+                bs_test_case_fail_node_create(job_ptr->full_name_ptr);
+            if (NULL != fnode_ptr) {
+                bs_dllist_push_back(failed_tests_ptr, &fnode_ptr->dlnode);
+                job_ptr->full_name_ptr = NULL;
+            }
+        }
+        set_report_ptr->total++;
+        bs_test_case_report(&job_ptr->test, job_ptr->enabled);
+
+        bs_dllist_node_t *dlnode_ptr;
+        while (NULL != (dlnode_ptr = bs_dllist_pop_front(
+                            &job_ptr->bench_results))) {
+            bs_dllist_push_back(&bs_test_bench_results, dlnode_ptr);
+        }
+
+        if (job_idx + 1 >= par_ptr->jobs ||
+            0 == par_ptr->jobs_ptr[job_idx + 1].test.case_idx) {
+            bs_test_set_report(job_ptr->set_ptr, set_report_ptr);
+            if (0 < set_report_ptr->failed) {
+                report_ptr->failed++;
+            } else {
+                report_ptr->succeeded++;
+            }
+        }
+    }
+    return job_idx;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs the benchmark. See @ref bs_test_bench.
+ *
+ * @param test_ptr
+ * @param name_ptr
+ * @param fn
+ * @param arg_ptr
+ * @param samples             Number of samples to take.
+ * @param sample_nsec         Duration to calibrate a sample for.
+ * @param stats_ptr
+ *
+ * @return false on error.
+ */
+bool bs_test_bench_with(
+    bs_test_t *test_ptr,
+    const char *name_ptr,
+    bs_test_bench_fn_t fn,
+    void *arg_ptr,
+    unsigned samples,
+    uint64_t sample_nsec,
+    bs_test_bench_stats_t *stats_ptr)
+{
+    // Calibrates. Samples until one takes an eighth of the target duration,
+    // which also warms up caches, branch predictors and CPU frequency.
+    uint64_t iterations = 1;
+    uint64_t nsec = bs_test_bench_sample(fn, arg_ptr, iterations);
+    while (nsec < sample_nsec / 8 && iterations < UINT64_MAX / 16) {
+        iterations *= nsec < sample_nsec / 100 ? 10 : 2;
+        nsec = bs_test_bench_sample(fn, arg_ptr, iterations);
+    }
+    if (0 < nsec) {
+        double scaled = (double)iterations * sample_nsec / nsec;
+        iterations = 1.0 > scaled ? 1 : (uint64_t)scaled;
+    }
+    bs_test_bench_sample(fn, arg_ptr, iterations);
+
+    double *nsecs_ptr = logged_calloc(samples, sizeof(double));
+    if (NULL == nsecs_ptr) return false;
+    double sum = 0;
+    for (unsigned i = 0; i < samples; ++i) {
+        nsecs_ptr[i] = (double)bs_test_bench_sample(
+            fn, arg_ptr, iterations) / iterations;
+        sum += nsecs_ptr[i];
+    }
+    qsort(nsecs_ptr, samples, sizeof(double), bs_test_bench_cmp);
+
+    stats_ptr->iterations = iterations;
+    stats_ptr->samples = samples;
+    stats_ptr->min_nsec = nsecs_ptr[0];
+    stats_ptr->mean_nsec = sum / samples;
+    stats_ptr->median_nsec = 0 == samples % 2 ?
+        (nsecs_ptr[samples / 2 - 1] + nsecs_ptr[samples / 2]) / 2 :
+        nsecs_ptr[samples / 2];
+    stats_ptr->p99_nsec = nsecs_ptr[(99 * samples + 99) / 100 - 1];
+    double variance = 0;
+    for (unsigned i = 0; i < samples; ++i) {
+        double d = nsecs_ptr[i] - stats_ptr->mean_nsec;
+        variance += d * d;
+    }
+    if (1 < samples) variance /= samples - 1;
+    stats_ptr->stddev_nsec = bs_test_bench_sqrt(variance);
+    logged_free(nsecs_ptr);
+
+    // Appends a summary to the report, on a line of its own.
+    if (!test_ptr->failed) {
+        size_t len = strlen(test_ptr->report);
+        snprintf(&test_ptr->report[len], sizeof(test_ptr->report) - len,
+                 "%s%s: %.3f ns median, %.3f ns p99, %.3f ns stddev "
+                 "(%u x %"PRIu64")",
+                 0 < len ? "\n  " : "", name_ptr, stats_ptr->median_nsec,
+                 stats_ptr->p99_nsec, stats_ptr->stddev_nsec,
+                 stats_ptr->samples, stats_ptr->iterations);
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Runs `iterations` of `fn`, and returns the duration in nanoseconds. */
+uint64_t bs_test_bench_sample(bs_test_bench_fn_t fn,
+                              void *arg_ptr,
+                              uint64_t iterations)
+{
+    uint64_t nsec = bs_mono_nsec();
+    fn(arg_ptr, iterations);
+    return bs_mono_nsec() - nsec;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Compares two doubles, for qsort(3). */
+int bs_test_bench_cmp(const void *a_ptr, const void *b_ptr)
+{
+    double a = *(const double*)a_ptr, b = *(const double*)b_ptr;
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Square root, by Newton's method. Saves us from linking libm. */
+double bs_test_bench_sqrt(double value)
+{
+    if (0 >= value) return 0;
+    // Starts at or above the root, from where the iteration descends.
+    double x = 1 < value ? value : 1;
+    for (int i = 0; i < 128; ++i) {
+        double next = (x + value / x) / 2;
+        if (next >= x) break;
+        x = next;
+    }
+    return x;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Writes all benchmark results to `fname_ptr`.
+ *
+ * @param fname_ptr
+ * @param format              An @ref _bs_test_bench_format.
+ *
+ * @return true on success.
+ */
+bool bs_test_bench_write(const char *fname_ptr, int format)
+{
+    FILE *file_ptr = fopen(fname_ptr, "w");
+    if (NULL == file_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed fopen(%s, \"w\")", fname_ptr);
+        return false;
+    }
+
+    if (BS_TEST_BENCH_FORMAT_JSON == format) {
+        fprintf(file_ptr, "{\"benchmarks\":[");
+    } else {
+        fprintf(file_ptr, "name,iterations,samples,median_ns,p99_ns,"
+                "mean_ns,stddev_ns,min_ns\n");
+    }
+    const char *separator_ptr = "\n";
+    for (bs_dllist_node_t *dlnode_ptr = bs_test_bench_results.head_ptr;
+         NULL != dlnode_ptr;
+         dlnode_ptr = dlnode_ptr->next_ptr) {
+        struct bs_test_bench_node *bnode_ptr =
+            (struct bs_test_bench_node*)dlnode_ptr;
+        const bs_test_bench_stats_t *s_ptr = &bnode_ptr->stats;
+        if (BS_TEST_BENCH_FORMAT_JSON == format) {
+            fprintf(file_ptr, "%s{\"name\":", separator_ptr);
+            bs_test_bench_write_name(file_ptr, bnode_ptr->name_ptr, format);
+            fprintf(file_ptr, ",\"iterations\":%"PRIu64",\"samples\":%u,"
+                    "\"median_ns\":%.3f,\"p99_ns\":%.3f,\"mean_ns\":%.3f,"
+                    "\"stddev_ns\":%.3f,\"min_ns\":%.3f}",
+                    s_ptr->iterations, s_ptr->samples, s_ptr->median_nsec,
+                    s_ptr->p99_nsec, s_ptr->mean_nsec, s_ptr->stddev_nsec,
+                    s_ptr->min_nsec);
+            separator_ptr = ",\n";
+        } else {
+            bs_test_bench_write_name(file_ptr, bnode_ptr->name_ptr, format);
+            fprintf(file_ptr, ",%"PRIu64",%u,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                    s_ptr->iterations, s_ptr->samples, s_ptr->median_nsec,
+                    s_ptr->p99_nsec, s_ptr->mean_nsec, s_ptr->stddev_nsec,
+                    s_ptr->min_nsec);
+        }
+    }
+    if (BS_TEST_BENCH_FORMAT_JSON == format) fprintf(file_ptr, "\n]}\n");
+
+    bool rv = !ferror(file_ptr);
+    if (0 != fclose(file_ptr)) rv = false;
+    if (!rv) bs_log(BS_ERROR | BS_ERRNO, "Failed writing %s", fname_ptr);
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Writes `name_ptr` as quoted JSON string, or quoted CSV field. */
+void bs_test_bench_write_name(FILE *file_ptr,
+                              const char *name_ptr,
+                              int format)
+{
+    fputc('"', file_ptr);
+    for (; '\0' != *name_ptr; ++name_ptr) {
+        if ('"' == *name_ptr) {
+            fputs(BS_TEST_BENCH_FORMAT_JSON == format ? "\\\"" : "\"\"",
+                  file_ptr);
+        } else if ('\\' == *name_ptr && BS_TEST_BENCH_FORMAT_JSON == format) {
+            fputs("\\\\", file_ptr);
+        } else {
+            fputc(*name_ptr, file_ptr);
+        }
+    }
+    fputc('"', file_ptr);
+}
+
 /* == Unit self-tests ====================================================== */
 /** @cond TEST */
 
 static void bs_test_test_report(bs_test_t *test_ptr);
 static void bs_test_eq_neq_tests(bs_test_t *test_ptr);
+static void bs_test_bench_test(bs_test_t *test_ptr);
+static void bs_test_shard_test(bs_test_t *test_ptr);
+static void bs_test_job_parse_test(bs_test_t *test_ptr);
 
 const bs_test_case_t bs_test_test_cases[] = {
     { 1, "succeed/fail reporting", bs_test_test_report },
     { 1, "eq/neq tests", bs_test_eq_neq_tests },
+    { 1, "bench", bs_test_bench_test },
+    { 1, "shard", bs_test_shard_test },
+    { 1, "job_parse", bs_test_job_parse_test },
     { 0, NULL, NULL }  /* sentinel. */
 };
 
@@ -756,5 +1787,119 @@ void bs_test_eq_neq_tests(bs_test_t *test_ptr)
     BS_TEST_VERIFY_MEMEQ(test_ptr, "asdf", "asdf", 4);
 }
 
+/** Benchmark function for @ref bs_test_bench_test: Sums iterations. */
+static void bs_test_bench_test_fn(void *arg_ptr, uint64_t iterations)
+{
+    uint64_t *sum_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        *sum_ptr += i;
+        BS_TEST_DO_NOT_OPTIMIZE(*sum_ptr);
+    }
+}
+
+/**
+ * Tests the statistics of the benchmark harness.
+ */
+void bs_test_bench_test(bs_test_t *test_ptr)
+{
+    bs_test_t                 sub_test;
+    bs_test_bench_stats_t     stats;
+    uint64_t                  sum = 0;
+
+    memset(&sub_test, 0, sizeof(bs_test_t));
+    BS_TEST_VERIFY_TRUE_OR_RETURN(
+        test_ptr,
+        bs_test_bench_with(&sub_test, "sum", bs_test_bench_test_fn, &sum,
+                           5, 1000000, &stats));
+    BS_TEST_VERIFY_EQ(test_ptr, 5, stats.samples);
+    BS_TEST_VERIFY_TRUE(test_ptr, 1 < stats.iterations);
+    BS_TEST_VERIFY_TRUE(test_ptr, stats.min_nsec <= stats.median_nsec);
+    BS_TEST_VERIFY_TRUE(test_ptr, stats.median_nsec <= stats.p99_nsec);
+    BS_TEST_VERIFY_TRUE(test_ptr, stats.min_nsec <= stats.mean_nsec);
+    BS_TEST_VERIFY_TRUE(test_ptr, stats.mean_nsec <= stats.p99_nsec);
+    BS_TEST_VERIFY_TRUE(test_ptr, 0 <= stats.stddev_nsec);
+    BS_TEST_VERIFY_STRMATCH(test_ptr, sub_test.report, "^sum: .* median,");
+
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_test_bench_sqrt(0));
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_test_bench_sqrt(9));
+    BS_TEST_VERIFY_EQ(test_ptr, 0.5, bs_test_bench_sqrt(0.25));
+}
+
+/**
+ * Tests that shards partition the test cases.
+ */
+void bs_test_shard_test(bs_test_t *test_ptr)
+{
+    uint32_t ordinal = bs_test_case_ordinal;
+    uint32_t index = bs_test_shard_index, count = bs_test_shard_count;
+
+    bs_test_case_ordinal = 0;
+    bs_test_shard_count = 3;
+    for (bs_test_shard_index = 0; bs_test_shard_index < 3;
+         ++bs_test_shard_index) {
+        bs_test_case_ordinal = 0;
+        for (uint32_t i = 0; i < 7; ++i) {
+            BS_TEST_VERIFY_EQ(test_ptr, i % 3 == bs_test_shard_index,
+                              bs_test_case_in_shard());
+        }
+    }
+
+    bs_test_case_ordinal = ordinal;
+    bs_test_shard_index = index;
+    bs_test_shard_count = count;
+}
+
+/**
+ * Tests parsing the results of a worker.
+ */
+void bs_test_job_parse_test(bs_test_t *test_ptr)
+{
+    struct bs_test_job        job;
+    const char                *r_ptr;
+
+    memset(&job, 0, sizeof(job));
+    r_ptr = "S\nall good";
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_test_job_parse_result(&job, r_ptr, strlen(r_ptr)));
+    BS_TEST_VERIFY_FALSE(test_ptr, job.test.failed);
+    BS_TEST_VERIFY_TRUE(test_ptr, job.done);
+    BS_TEST_VERIFY_STREQ(test_ptr, "all good", job.test.report);
+
+    memset(&job, 0, sizeof(job));
+    r_ptr = "B 100 5 1.5 2.5 1.75 0.25 1 set.case/a b\nF\nfile(1): bad\n";
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, bs_test_job_parse_result(&job, r_ptr, strlen(r_ptr)));
+    BS_TEST_VERIFY_TRUE(test_ptr, job.test.failed);
+    BS_TEST_VERIFY_STREQ(test_ptr, "file(1): bad\n", job.test.report);
+    struct bs_test_bench_node *bnode_ptr = (struct bs_test_bench_node*)
+        bs_dllist_pop_front(&job.bench_results);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, bnode_ptr);
+    BS_TEST_VERIFY_STREQ(test_ptr, "set.case/a b", bnode_ptr->name_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 100, bnode_ptr->stats.iterations);
+    BS_TEST_VERIFY_EQ(test_ptr, 5, bnode_ptr->stats.samples);
+    BS_TEST_VERIFY_EQ(test_ptr, 2.5, bnode_ptr->stats.p99_nsec);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bnode_ptr->stats.min_nsec);
+    logged_free(bnode_ptr->name_ptr);
+    logged_free(bnode_ptr);
+
+    // Truncated, or garbled results.
+    memset(&job, 0, sizeof(job));
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_test_job_parse_result(&job, "", 0));
+    r_ptr = "B 100 5 1.5 2.5 1.75 0.25 1 set.case/a\n";
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_test_job_parse_result(&job, r_ptr, strlen(r_ptr)));
+    r_ptr = "X\nS\n";
+    BS_TEST_VERIFY_FALSE(
+        test_ptr, bs_test_job_parse_result(&job, r_ptr, strlen(r_ptr)));
+    BS_TEST_VERIFY_FALSE(test_ptr, job.done);
+
+    struct bs_test_bench_node *bn_ptr;
+    while (NULL != (bn_ptr = (struct bs_test_bench_node*)
+                    bs_dllist_pop_front(&job.bench_results))) {
+        logged_free(bn_ptr->name_ptr);
+        logged_free(bn_ptr);
+    }
+}
+
 /** @endcond */
 /* == End of test.c ======================================================== */
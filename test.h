@@ -23,6 +23,7 @@
 
 #include <regex.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -107,6 +108,16 @@ bool bs_test_failed(bs_test_t *test_ptr);
 /**
  * Runs test sets.
  *
+ * By default, all test cases run sequentially in this process. With
+ * `--jobs=N`, up to N test cases run concurrently, each in a worker process
+ * that re-executes this program: A crashing case is reported as failed, and
+ * does not affect the others. Results are reported in the same order as
+ * when running sequentially. Benchmarks, as matched by
+ * `--test_benchmark_filter`, run one at a time on a core reserved for them.
+ *
+ * `--test_shard_index` and `--test_shard_count` split the selected test
+ * cases across machines, eg. for CI.
+ *
  * @param test_sets
  * @param argc
  * @param argv
@@ -202,6 +213,69 @@ void bs_test_verify_memeq_at(
  */
 const char *bs_test_resolve_path(const char *fname_ptr);
 
+/* == Benchmarks =========================================================== */
+
+/**
+ * Method to benchmark: Runs `iterations` iterations of the measured code.
+ *
+ * @param arg_ptr             Argument provided to @ref bs_test_bench.
+ * @param iterations
+ */
+typedef void (*bs_test_bench_fn_t)(void *arg_ptr, uint64_t iterations);
+
+/** Statistics of a benchmark, per iteration. */
+typedef struct {
+    /** Iterations per sample, as calibrated. */
+    uint64_t                  iterations;
+    /** Number of samples taken. */
+    unsigned                  samples;
+    /** Median time of an iteration, in nanoseconds. */
+    double                    median_nsec;
+    /** 99th percentile of the time of an iteration, in nanoseconds. */
+    double                    p99_nsec;
+    /** Mean time of an iteration, in nanoseconds. */
+    double                    mean_nsec;
+    /** Standard deviation of an iteration's time, in nanoseconds. */
+    double                    stddev_nsec;
+    /** Minimum time of an iteration, in nanoseconds. */
+    double                    min_nsec;
+} bs_test_bench_stats_t;
+
+/**
+ * Benchmarks `fn`.
+ *
+ * Warms up, and calibrates the number of iterations for a sample to take
+ * about `--benchmark_sample_msec`. Then takes `--benchmark_samples`
+ * samples, and computes the statistics per iteration. A summary is appended
+ * to the test's report, and the results are written to
+ * `--benchmark_output`, if set, once all tests ran.
+ *
+ * @param test_ptr
+ * @param name_ptr            Name of the benchmark, within the test case.
+ * @param fn
+ * @param arg_ptr             Argument to `fn`.
+ * @param stats_ptr           Optional, is set to the statistics.
+ *
+ * @return false on error.
+ */
+bool bs_test_bench(
+    bs_test_t *test_ptr,
+    const char *name_ptr,
+    bs_test_bench_fn_t fn,
+    void *arg_ptr,
+    bs_test_bench_stats_t *stats_ptr);
+
+/**
+ * Prevents the compiler from optimizing away the computation of `_value`.
+ * Use on results of the benchmarked code. `_value` must be a scalar.
+ */
+#define BS_TEST_DO_NOT_OPTIMIZE(_value)                 \
+    __asm__ volatile ("" : : "g" (_value) : "memory")
+
+/** Prevents the compiler from eliding or reordering memory accesses. */
+#define BS_TEST_CLOBBER_MEMORY()                        \
+    __asm__ volatile ("" : : : "memory")
+
 /* == Verification macros ================================================== */
 
 /**
@@ -114,6 +114,31 @@ void bs_cond_broadcast(pthread_cond_t *condition_ptr)
     }
 }
 
+/* ------------------------------------------------------------------------- */
+void bs_cond_signal(pthread_cond_t *condition_ptr)
+{
+    int rv = pthread_cond_signal(condition_ptr);
+    if (0 != rv) {
+        errno = rv;
+        bs_log(BS_FATAL | BS_ERRNO, "Failed pthread_cond_signal(%p)",
+               condition_ptr);
+        BS_ABORT();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_cond_wait(pthread_cond_t *condition_ptr,
+                  pthread_mutex_t *mutex_ptr)
+{
+    int rv = pthread_cond_wait(condition_ptr, mutex_ptr);
+    if (0 != rv) {
+        errno = rv;
+        bs_log(BS_FATAL | BS_ERRNO, "Failed pthread_cond_wait(%p, %p)",
+               condition_ptr, mutex_ptr);
+        BS_ABORT();
+    }
+}
+
 /* ------------------------------------------------------------------------- */
 bool bs_cond_timedwait(pthread_cond_t *condition_ptr,
                        pthread_mutex_t *mutex_ptr,
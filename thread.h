@@ -46,6 +46,11 @@ void bs_cond_destroy(pthread_cond_t *condition_ptr);
 
 /** Broadcasts the condition. */
 void bs_cond_broadcast(pthread_cond_t *condition_ptr);
+/** Signals the condition, waking up at least one waiter. */
+void bs_cond_signal(pthread_cond_t *condition_ptr);
+/** Waits for condition, with error handling: aborts on error. */
+void bs_cond_wait(pthread_cond_t *condition_ptr,
+                  pthread_mutex_t *mutex_ptr);
 /**
  * Waits for condition, with error handling. Returns true, if the condition
  * was signalled or broadcasted, and false if it timed out.
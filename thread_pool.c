@@ -0,0 +1,926 @@
+/* ========================================================================= */
+/**
+ * @file thread_pool.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread_pool.h"
+
+#include "atomic.h"
+#include "def.h"
+#include "log_wrappers.h"
+#include "mpmc_ring.h"
+#include "pool.h"
+#include "thread.h"
+#include "time.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* == Declarations ========================================================= */
+
+/** Assumed size of a cache line. */
+#define _BS_THREAD_POOL_CACHELINE 64
+/** Capacity of each worker's deque. Must be a power of two. */
+#define _BS_THREAD_POOL_DEQUE_CAPACITY 4096
+/** Capacity of the queue for tasks submitted from outside the pool. */
+#define _BS_THREAD_POOL_QUEUE_CAPACITY 4096
+/** Number of failed attempts to find a task, before a worker parks. */
+#define _BS_THREAD_POOL_SPINS 32
+
+/** Forward declaration: A task. */
+typedef struct _bs_thread_pool_task_t bs_thread_pool_task_t;
+/** Forward declaration: A worker, and its deque. */
+typedef struct _bs_thread_pool_worker_t bs_thread_pool_worker_t;
+
+/** A task. Embedded in the actual task's struct. */
+struct _bs_thread_pool_task_t {
+    /** Runs the task. */
+    void                      (*run_fn)(bs_thread_pool_t *pool_ptr,
+                                        bs_thread_pool_task_t *task_ptr);
+};
+
+/** A task from @ref bs_thread_pool_submit. From the pool's `task_pool_ptr`. */
+typedef struct {
+    /** The task. */
+    bs_thread_pool_task_t     task;
+    /** The submitted method. */
+    bs_thread_pool_fn_t       fn;
+    /** Argument to `fn`. */
+    void                      *arg_ptr;
+} bs_thread_pool_submitted_t;
+
+/** Parameters of a @ref bs_thread_pool_parallel_for. */
+typedef struct {
+    /** The method to call for each chunk. */
+    bs_thread_pool_range_fn_t fn;
+    /** Argument to `fn`. */
+    void                      *arg_ptr;
+    /** Size of chunks not to split further. */
+    size_t                    grain;
+} bs_thread_pool_loop_t;
+
+/** A split-off part of a loop. Lives on the stack of the splitting thread. */
+typedef struct {
+    /** The task. */
+    bs_thread_pool_task_t     task;
+    /** The loop. */
+    const bs_thread_pool_loop_t *loop_ptr;
+    /** First index of the part. */
+    size_t                    begin;
+    /** End of the part, exclusive. */
+    size_t                    end;
+    /** Set to non-zero once the part is done. */
+    bs_atomic_int32_t         done;
+} bs_thread_pool_range_t;
+
+/** A position, padded to own a cache line. Avoids false sharing. */
+typedef struct {
+    /** The position. */
+    bs_atomic_int64_t         value;
+    /** Padding. */
+    uint8_t                   padding[
+        _BS_THREAD_POOL_CACHELINE - sizeof(bs_atomic_int64_t)];
+} bs_thread_pool_position_t;
+
+/** A worker, with its Chase-Lev deque of tasks. */
+struct _bs_thread_pool_worker_t {
+    /** Position to steal from. Advanced by thieves, and for the last task. */
+    bs_thread_pool_position_t top;
+    /** Position to push to. Written by the owner only. */
+    bs_thread_pool_position_t bottom;
+    /** The tasks, as intptr_t. */
+    bs_atomic_int64_t         slots[_BS_THREAD_POOL_DEQUE_CAPACITY];
+
+    /** Back-link to the pool. */
+    bs_thread_pool_t          *pool_ptr;
+    /** State of the random generator for picking whom to steal from. */
+    uint32_t                  random;
+    /** The thread. */
+    pthread_t                 thread;
+};
+
+/** @private State of the pool. */
+struct _bs_thread_pool_t {
+    /** Number of worker threads. */
+    unsigned                  workers;
+    /** Number of worker threads started. */
+    unsigned                  started;
+    /**
+     * The workers. One more than `workers`: The last one is for a thread
+     * outside the pool in @ref bs_thread_pool_parallel_for.
+     */
+    bs_thread_pool_worker_t   *workers_ptr;
+    /** Tasks submitted from outside the pool. */
+    bs_mpmc_ring_t            *queue_ptr;
+    /** Allocator for @ref bs_thread_pool_submitted_t. */
+    bs_pool_t                 *task_pool_ptr;
+
+    /** Number of tasks in the deques and the queue. May briefly be off. */
+    bs_atomic_int64_t         queued;
+    /** Number of submitted tasks, not yet completed. */
+    bs_atomic_int64_t         pending;
+    /** Number of workers parking on `work_cond`. */
+    bs_atomic_int32_t         sleepers;
+    /** Number of threads waiting on `done_cond`. */
+    bs_atomic_int32_t         waiters;
+
+    /** Held by a thread outside the pool, while using the last worker. */
+    pthread_mutex_t           caller_mutex;
+    /** Protects `stop`, and the waits on `work_cond` and `done_cond`. */
+    pthread_mutex_t           mutex;
+    /** Signalled when a task got queued, and there are `sleepers`. */
+    pthread_cond_t            work_cond;
+    /** Broadcasted when `pending` dropped to zero, and there are `waiters`. */
+    pthread_cond_t            done_cond;
+    /** Whether the worker threads shall exit. */
+    bool                      stop;
+};
+
+static void *_bs_thread_pool_worker_thread(void *arg_ptr);
+static bool _bs_thread_pool_park(bs_thread_pool_t *pool_ptr);
+static bs_thread_pool_worker_t *_bs_thread_pool_current(
+    bs_thread_pool_t *pool_ptr);
+static bs_thread_pool_task_t *_bs_thread_pool_find_task(
+    bs_thread_pool_t *pool_ptr,
+    bs_thread_pool_worker_t *worker_ptr);
+static void _bs_thread_pool_queued(bs_thread_pool_t *pool_ptr);
+static void _bs_thread_pool_run_submitted(bs_thread_pool_t *pool_ptr,
+                                          bs_thread_pool_task_t *task_ptr);
+static void _bs_thread_pool_run_range(bs_thread_pool_t *pool_ptr,
+                                      bs_thread_pool_task_t *task_ptr);
+static void _bs_thread_pool_loop(bs_thread_pool_t *pool_ptr,
+                                 bs_thread_pool_worker_t *worker_ptr,
+                                 const bs_thread_pool_loop_t *loop_ptr,
+                                 size_t begin,
+                                 size_t end);
+
+static bool _bs_thread_pool_deque_push(bs_thread_pool_worker_t *worker_ptr,
+                                       bs_thread_pool_task_t *task_ptr);
+static bs_thread_pool_task_t *_bs_thread_pool_deque_pop(
+    bs_thread_pool_worker_t *worker_ptr);
+static bs_thread_pool_task_t *_bs_thread_pool_deque_steal(
+    bs_thread_pool_worker_t *worker_ptr);
+
+/** The worker (or borrowed last worker) of the current thread, if any. */
+static _Thread_local bs_thread_pool_worker_t *_bs_thread_pool_worker_ptr;
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+bs_thread_pool_t *bs_thread_pool_create(unsigned workers)
+{
+    if (0 == workers) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = 0 < cpus ? cpus : 1;
+    }
+
+    bs_thread_pool_t *pool_ptr = logged_calloc(1, sizeof(bs_thread_pool_t));
+    if (NULL == pool_ptr) return NULL;
+
+    if (!bs_mutex_init(&pool_ptr->mutex)) {
+        logged_free(pool_ptr);
+        return NULL;
+    }
+    if (!bs_mutex_init(&pool_ptr->caller_mutex)) {
+        bs_mutex_destroy(&pool_ptr->mutex);
+        logged_free(pool_ptr);
+        return NULL;
+    }
+    if (!bs_cond_init(&pool_ptr->work_cond)) {
+        bs_mutex_destroy(&pool_ptr->caller_mutex);
+        bs_mutex_destroy(&pool_ptr->mutex);
+        logged_free(pool_ptr);
+        return NULL;
+    }
+    if (!bs_cond_init(&pool_ptr->done_cond)) {
+        bs_cond_destroy(&pool_ptr->work_cond);
+        bs_mutex_destroy(&pool_ptr->caller_mutex);
+        bs_mutex_destroy(&pool_ptr->mutex);
+        logged_free(pool_ptr);
+        return NULL;
+    }
+
+    pool_ptr->queue_ptr = bs_mpmc_ring_create(_BS_THREAD_POOL_QUEUE_CAPACITY);
+    pool_ptr->task_pool_ptr = bs_pool_create(
+        sizeof(bs_thread_pool_submitted_t), false);
+    pool_ptr->workers_ptr = logged_calloc(
+        workers + 1, sizeof(bs_thread_pool_worker_t));
+    if (NULL == pool_ptr->queue_ptr ||
+        NULL == pool_ptr->task_pool_ptr ||
+        NULL == pool_ptr->workers_ptr) {
+        bs_thread_pool_destroy(pool_ptr);
+        return NULL;
+    }
+    for (unsigned i = 0; i <= workers; ++i) {
+        pool_ptr->workers_ptr[i].pool_ptr = pool_ptr;
+        pool_ptr->workers_ptr[i].random = 2654435761u * (i + 1);
+    }
+
+    pool_ptr->workers = workers;
+    for (; pool_ptr->started < workers; ++pool_ptr->started) {
+        bs_thread_pool_worker_t *worker_ptr =
+            &pool_ptr->workers_ptr[pool_ptr->started];
+        int rv = pthread_create(&worker_ptr->thread, NULL,
+                                _bs_thread_pool_worker_thread, worker_ptr);
+        if (0 != rv) {
+            errno = rv;
+            bs_log(BS_ERROR | BS_ERRNO, "Failed pthread_create(%p, NULL, %p, "
+                   "%p)", &worker_ptr->thread, _bs_thread_pool_worker_thread,
+                   worker_ptr);
+            bs_thread_pool_destroy(pool_ptr);
+            return NULL;
+        }
+    }
+    return pool_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_thread_pool_destroy(bs_thread_pool_t *pool_ptr)
+{
+    bs_thread_pool_wait(pool_ptr);
+
+    bs_mutex_lock(&pool_ptr->mutex);
+    pool_ptr->stop = true;
+    bs_cond_broadcast(&pool_ptr->work_cond);
+    bs_mutex_unlock(&pool_ptr->mutex);
+
+    for (unsigned i = 0; i < pool_ptr->started; ++i) {
+        int rv = pthread_join(pool_ptr->workers_ptr[i].thread, NULL);
+        if (0 != rv) {
+            errno = rv;
+            bs_log(BS_WARNING | BS_ERRNO, "Failed pthread_join(%p, NULL)",
+                   &pool_ptr->workers_ptr[i].thread);
+        }
+    }
+
+    if (NULL != pool_ptr->workers_ptr) logged_free(pool_ptr->workers_ptr);
+    if (NULL != pool_ptr->task_pool_ptr) {
+        bs_pool_destroy(pool_ptr->task_pool_ptr);
+    }
+    if (NULL != pool_ptr->queue_ptr) bs_mpmc_ring_destroy(pool_ptr->queue_ptr);
+
+    bs_cond_destroy(&pool_ptr->done_cond);
+    bs_cond_destroy(&pool_ptr->work_cond);
+    bs_mutex_destroy(&pool_ptr->caller_mutex);
+    bs_mutex_destroy(&pool_ptr->mutex);
+    logged_free(pool_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+unsigned bs_thread_pool_workers(bs_thread_pool_t *pool_ptr)
+{
+    return pool_ptr->workers;
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_thread_pool_submit(bs_thread_pool_t *pool_ptr,
+                           bs_thread_pool_fn_t fn,
+                           void *arg_ptr)
+{
+    bs_thread_pool_submitted_t *submitted_ptr = bs_pool_alloc(
+        pool_ptr->task_pool_ptr);
+    if (NULL == submitted_ptr) {
+        fn(arg_ptr);
+        return false;
+    }
+    submitted_ptr->task.run_fn = _bs_thread_pool_run_submitted;
+    submitted_ptr->fn = fn;
+    submitted_ptr->arg_ptr = arg_ptr;
+    bs_atomic_int64_add(&pool_ptr->pending, 1);
+
+    bs_thread_pool_worker_t *worker_ptr = _bs_thread_pool_current(pool_ptr);
+    if ((NULL != worker_ptr &&
+         _bs_thread_pool_deque_push(worker_ptr, &submitted_ptr->task)) ||
+        bs_mpmc_ring_push(pool_ptr->queue_ptr, &submitted_ptr->task)) {
+        _bs_thread_pool_queued(pool_ptr);
+        return true;
+    }
+
+    _bs_thread_pool_run_submitted(pool_ptr, &submitted_ptr->task);
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_thread_pool_wait(bs_thread_pool_t *pool_ptr)
+{
+    while (0 < bs_atomic_int64_get(&pool_ptr->pending)) {
+        bs_thread_pool_task_t *task_ptr = _bs_thread_pool_find_task(
+            pool_ptr, _bs_thread_pool_current(pool_ptr));
+        if (NULL != task_ptr) {
+            task_ptr->run_fn(pool_ptr, task_ptr);
+            continue;
+        }
+
+        // Nothing to help with. Wait for the running tasks to complete. The
+        // increment of `waiters` and the decrement of `pending` are both
+        // full barriers: Either we see the decrement, or we get woken up.
+        bs_mutex_lock(&pool_ptr->mutex);
+        bs_atomic_int32_add(&pool_ptr->waiters, 1);
+        if (0 < bs_atomic_int64_get(&pool_ptr->pending)) {
+            bs_cond_wait(&pool_ptr->done_cond, &pool_ptr->mutex);
+        }
+        bs_atomic_int32_add(&pool_ptr->waiters, -1);
+        bs_mutex_unlock(&pool_ptr->mutex);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_thread_pool_parallel_for(bs_thread_pool_t *pool_ptr,
+                                 size_t begin,
+                                 size_t end,
+                                 size_t grain,
+                                 bs_thread_pool_range_fn_t fn,
+                                 void *arg_ptr)
+{
+    if (begin >= end) return;
+    if (0 == grain) {
+        // A few chunks per thread, to balance uneven progress.
+        grain = BS_MAX((size_t)1,
+                       (end - begin) / (4 * (pool_ptr->workers + 1)));
+    }
+    bs_thread_pool_loop_t loop = {
+        .fn = fn, .arg_ptr = arg_ptr, .grain = grain };
+
+    bs_thread_pool_worker_t *worker_ptr = _bs_thread_pool_current(pool_ptr);
+    if (NULL != worker_ptr) {
+        _bs_thread_pool_loop(pool_ptr, worker_ptr, &loop, begin, end);
+        return;
+    }
+
+    // From outside the pool: Borrow the last worker, to take part.
+    bs_mutex_lock(&pool_ptr->caller_mutex);
+    bs_thread_pool_worker_t *prev_worker_ptr = _bs_thread_pool_worker_ptr;
+    worker_ptr = &pool_ptr->workers_ptr[pool_ptr->workers];
+    _bs_thread_pool_worker_ptr = worker_ptr;
+    _bs_thread_pool_loop(pool_ptr, worker_ptr, &loop, begin, end);
+    _bs_thread_pool_worker_ptr = prev_worker_ptr;
+    bs_mutex_unlock(&pool_ptr->caller_mutex);
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Main loop of each worker thread: Runs or steals tasks, until stopped. */
+void *_bs_thread_pool_worker_thread(void *arg_ptr)
+{
+    bs_thread_pool_worker_t *worker_ptr = arg_ptr;
+    bs_thread_pool_t *pool_ptr = worker_ptr->pool_ptr;
+    unsigned spins = 0;
+
+    _bs_thread_pool_worker_ptr = worker_ptr;
+    while (true) {
+        bs_thread_pool_task_t *task_ptr = _bs_thread_pool_find_task(
+            pool_ptr, worker_ptr);
+        if (NULL != task_ptr) {
+            task_ptr->run_fn(pool_ptr, task_ptr);
+            spins = 0;
+        } else if (++spins < _BS_THREAD_POOL_SPINS) {
+            sched_yield();
+        } else {
+            spins = 0;
+            if (_bs_thread_pool_park(pool_ptr)) break;
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Parks the calling worker, until a task got queued or the pool is stopped.
+ *
+ * The increment of `sleepers` and the increment of `queued` are both full
+ * barriers: Either we see the queued task, or the submitter sees us and
+ * signals under the mutex. See @ref _bs_thread_pool_queued.
+ *
+ * @return true if the pool is stopped.
+ */
+bool _bs_thread_pool_park(bs_thread_pool_t *pool_ptr)
+{
+    bs_mutex_lock(&pool_ptr->mutex);
+    bs_atomic_int32_add(&pool_ptr->sleepers, 1);
+    while (0 >= bs_atomic_int64_get(&pool_ptr->queued) && !pool_ptr->stop) {
+        bs_cond_wait(&pool_ptr->work_cond, &pool_ptr->mutex);
+    }
+    bs_atomic_int32_add(&pool_ptr->sleepers, -1);
+    bool stop = pool_ptr->stop;
+    bs_mutex_unlock(&pool_ptr->mutex);
+    return stop;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Returns the calling thread's worker of `pool_ptr`, or NULL. */
+bs_thread_pool_worker_t *_bs_thread_pool_current(bs_thread_pool_t *pool_ptr)
+{
+    bs_thread_pool_worker_t *worker_ptr = _bs_thread_pool_worker_ptr;
+    if (NULL == worker_ptr || worker_ptr->pool_ptr != pool_ptr) return NULL;
+    return worker_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Finds a task: From the own deque, from the queue, or stolen from another
+ * worker, starting at a random one. Threads without a worker only take from
+ * the queue, since they could not split a loop.
+ *
+ * @return The task, or NULL if none was found.
+ */
+bs_thread_pool_task_t *_bs_thread_pool_find_task(
+    bs_thread_pool_t *pool_ptr,
+    bs_thread_pool_worker_t *worker_ptr)
+{
+    bs_thread_pool_task_t *task_ptr = NULL;
+    void                      *element_ptr;
+
+    if (NULL != worker_ptr) task_ptr = _bs_thread_pool_deque_pop(worker_ptr);
+    if (NULL == task_ptr &&
+        bs_mpmc_ring_pop(pool_ptr->queue_ptr, &element_ptr)) {
+        task_ptr = element_ptr;
+    }
+    if (NULL == task_ptr && NULL != worker_ptr) {
+        // xorshift32.
+        uint32_t r = worker_ptr->random;
+        r ^= r << 13;
+        r ^= r >> 17;
+        r ^= r << 5;
+        worker_ptr->random = r;
+
+        unsigned n = pool_ptr->workers + 1;
+        for (unsigned i = 0; i < n && NULL == task_ptr; ++i) {
+            bs_thread_pool_worker_t *victim_ptr =
+                &pool_ptr->workers_ptr[(r + i) % n];
+            if (victim_ptr == worker_ptr) continue;
+            task_ptr = _bs_thread_pool_deque_steal(victim_ptr);
+        }
+    }
+
+    if (NULL != task_ptr) bs_atomic_int64_add(&pool_ptr->queued, -1);
+    return task_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Accounts for a newly queued task, and wakes up a worker if any parks. */
+void _bs_thread_pool_queued(bs_thread_pool_t *pool_ptr)
+{
+    bs_atomic_int64_add(&pool_ptr->queued, 1);
+    if (0 >= bs_atomic_int32_get(&pool_ptr->sleepers)) return;
+    bs_mutex_lock(&pool_ptr->mutex);
+    bs_cond_signal(&pool_ptr->work_cond);
+    bs_mutex_unlock(&pool_ptr->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Runs a task from @ref bs_thread_pool_submit, and releases it. */
+void _bs_thread_pool_run_submitted(bs_thread_pool_t *pool_ptr,
+                                   bs_thread_pool_task_t *task_ptr)
+{
+    bs_thread_pool_submitted_t *submitted_ptr = BS_CONTAINER_OF(
+        task_ptr, bs_thread_pool_submitted_t, task);
+    submitted_ptr->fn(submitted_ptr->arg_ptr);
+    bs_pool_free(pool_ptr->task_pool_ptr, submitted_ptr);
+
+    if (0 == bs_atomic_int64_add(&pool_ptr->pending, -1) &&
+        0 < bs_atomic_int32_get(&pool_ptr->waiters)) {
+        bs_mutex_lock(&pool_ptr->mutex);
+        bs_cond_broadcast(&pool_ptr->done_cond);
+        bs_mutex_unlock(&pool_ptr->mutex);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Runs a split-off part of a loop. Only called from threads with a worker. */
+void _bs_thread_pool_run_range(bs_thread_pool_t *pool_ptr,
+                               bs_thread_pool_task_t *task_ptr)
+{
+    bs_thread_pool_range_t *range_ptr = BS_CONTAINER_OF(
+        task_ptr, bs_thread_pool_range_t, task);
+    _bs_thread_pool_loop(pool_ptr, _bs_thread_pool_current(pool_ptr),
+                         range_ptr->loop_ptr, range_ptr->begin,
+                         range_ptr->end);
+    // The splitting thread may return right after. Don't touch it after.
+    bs_atomic_int32_add(&range_ptr->done, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Processes [begin, end) of the loop: Splits off the upper half as a task,
+ * processes the lower half, and then waits for the upper half. Helps with
+ * other tasks while waiting, which is also how the upper half gets run here
+ * if nobody stole it.
+ */
+void _bs_thread_pool_loop(bs_thread_pool_t *pool_ptr,
+                          bs_thread_pool_worker_t *worker_ptr,
+                          const bs_thread_pool_loop_t *loop_ptr,
+                          size_t begin,
+                          size_t end)
+{
+    if (end - begin <= loop_ptr->grain) {
+        loop_ptr->fn(loop_ptr->arg_ptr, begin, end);
+        return;
+    }
+
+    size_t middle = begin + (end - begin) / 2;
+    bs_thread_pool_range_t range = {
+        .task = { .run_fn = _bs_thread_pool_run_range },
+        .loop_ptr = loop_ptr,
+        .begin = middle,
+        .end = end,
+        .done = BS_ATOMIC_INT32_INIT(0)
+    };
+    if (!_bs_thread_pool_deque_push(worker_ptr, &range.task)) {
+        // Deque is full: Just process both halves here.
+        _bs_thread_pool_loop(pool_ptr, worker_ptr, loop_ptr, begin, middle);
+        _bs_thread_pool_loop(pool_ptr, worker_ptr, loop_ptr, middle, end);
+        return;
+    }
+    _bs_thread_pool_queued(pool_ptr);
+
+    _bs_thread_pool_loop(pool_ptr, worker_ptr, loop_ptr, begin, middle);
+
+    while (0 == bs_atomic_int32_get(&range.done)) {
+        bs_thread_pool_task_t *task_ptr = _bs_thread_pool_find_task(
+            pool_ptr, worker_ptr);
+        if (NULL != task_ptr) {
+            task_ptr->run_fn(pool_ptr, task_ptr);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Pushes to the bottom of the deque. For the owner only. */
+bool _bs_thread_pool_deque_push(bs_thread_pool_worker_t *worker_ptr,
+                                bs_thread_pool_task_t *task_ptr)
+{
+    int64_t b = bs_atomic_int64_get(&worker_ptr->bottom.value);
+    int64_t t = bs_atomic_int64_get(&worker_ptr->top.value);
+    if (_BS_THREAD_POOL_DEQUE_CAPACITY <= b - t) return false;
+
+    bs_atomic_int64_set(
+        &worker_ptr->slots[b & (_BS_THREAD_POOL_DEQUE_CAPACITY - 1)],
+        (intptr_t)task_ptr);
+    bs_atomic_int64_set(&worker_ptr->bottom.value, b + 1);
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Pops from the bottom of the deque. For the owner only.
+ *
+ * Decrements the bottom first, with a full barrier: A thief reading the top
+ * after that will see it. Only for the last task, the owner and thieves
+ * race for it, through a compare-and-swap on the top.
+ */
+bs_thread_pool_task_t *_bs_thread_pool_deque_pop(
+    bs_thread_pool_worker_t *worker_ptr)
+{
+    int64_t b = bs_atomic_int64_add(&worker_ptr->bottom.value, -1);
+    int64_t t = bs_atomic_int64_get(&worker_ptr->top.value);
+    if (t > b) {
+        // Was empty.
+        bs_atomic_int64_set(&worker_ptr->bottom.value, b + 1);
+        return NULL;
+    }
+
+    bs_thread_pool_task_t *task_ptr = (bs_thread_pool_task_t*)(intptr_t)
+        bs_atomic_int64_get(
+            &worker_ptr->slots[b & (_BS_THREAD_POOL_DEQUE_CAPACITY - 1)]);
+    if (t < b) return task_ptr;
+
+    bool taken = t == bs_atomic_int64_cas(&worker_ptr->top.value, t + 1, t);
+    bs_atomic_int64_set(&worker_ptr->bottom.value, b + 1);
+    return taken ? task_ptr : NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Steals from the top of the deque. Thread-safe. */
+bs_thread_pool_task_t *_bs_thread_pool_deque_steal(
+    bs_thread_pool_worker_t *worker_ptr)
+{
+    int64_t t = bs_atomic_int64_get(&worker_ptr->top.value);
+    int64_t b = bs_atomic_int64_get(&worker_ptr->bottom.value);
+    if (t >= b) return NULL;
+
+    // Read before claiming: The owner may re-use the slot right after.
+    bs_thread_pool_task_t *task_ptr = (bs_thread_pool_task_t*)(intptr_t)
+        bs_atomic_int64_get(
+            &worker_ptr->slots[t & (_BS_THREAD_POOL_DEQUE_CAPACITY - 1)]);
+    if (t != bs_atomic_int64_cas(&worker_ptr->top.value, t + 1, t)) {
+        return NULL;
+    }
+    return task_ptr;
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_submit_wait(bs_test_t *test_ptr);
+static void test_parallel_for(bs_test_t *test_ptr);
+static void test_nested(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_thread_pool_test_cases[] = {
+    { 1, "submit_wait", test_submit_wait },
+    { 1, "parallel_for", test_parallel_for },
+    { 1, "nested", test_nested },
+    { 0, NULL, NULL }
+};
+
+/** Argument to the test tasks. */
+typedef struct {
+    /** The pool. */
+    bs_thread_pool_t          *pool_ptr;
+    /** Number of task runs. */
+    bs_atomic_int32_t         runs;
+    /** Number of times each index got processed. */
+    uint8_t                   *counts_ptr;
+    /** Number of indices in `counts_ptr`. */
+    size_t                    size;
+    /** Number of chunks that were out of range. */
+    bs_atomic_int32_t         failures;
+} test_arg_t;
+
+/* ------------------------------------------------------------------------- */
+/** Task: Counts the run. */
+static void _test_count(void *arg_ptr)
+{
+    test_arg_t *targ_ptr = arg_ptr;
+    bs_atomic_int32_add(&targ_ptr->runs, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Task: Counts the run, and submits 10 more counting tasks. */
+static void _test_count_and_submit(void *arg_ptr)
+{
+    test_arg_t *targ_ptr = arg_ptr;
+    bs_atomic_int32_add(&targ_ptr->runs, 1);
+    for (int i = 0; i < 10; ++i) {
+        bs_thread_pool_submit(targ_ptr->pool_ptr, _test_count, targ_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Range method: Counts each index in [begin, end). */
+static void _test_range(void *arg_ptr, size_t begin, size_t end)
+{
+    test_arg_t *targ_ptr = arg_ptr;
+    if (begin >= end || end > targ_ptr->size) {
+        bs_atomic_int32_add(&targ_ptr->failures, 1);
+        return;
+    }
+    bs_atomic_int32_add(&targ_ptr->runs, 1);
+    for (size_t i = begin; i < end; ++i) targ_ptr->counts_ptr[i]++;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies that each of `counts_ptr` was processed once. Resets. */
+static bool _test_verify_counts(test_arg_t *targ_ptr)
+{
+    bool rv = 0 == bs_atomic_int32_get(&targ_ptr->failures);
+    for (size_t i = 0; i < targ_ptr->size; ++i) {
+        if (1 != targ_ptr->counts_ptr[i]) rv = false;
+    }
+    memset(targ_ptr->counts_ptr, 0, targ_ptr->size);
+    bs_atomic_int32_set(&targ_ptr->runs, 0);
+    return rv;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Submits tasks, from outside and from within tasks, and waits for them. */
+void test_submit_wait(bs_test_t *test_ptr)
+{
+    test_arg_t targ = {};
+
+    bs_thread_pool_t *pool_ptr = bs_thread_pool_create(4);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, pool_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 4, bs_thread_pool_workers(pool_ptr));
+    targ.pool_ptr = pool_ptr;
+
+    bs_thread_pool_wait(pool_ptr);
+    for (int i = 0; i < 10000; ++i) {
+        bs_thread_pool_submit(pool_ptr, _test_count, &targ);
+    }
+    bs_thread_pool_wait(pool_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 10000, bs_atomic_int32_get(&targ.runs));
+
+    bs_atomic_int32_set(&targ.runs, 0);
+    for (int i = 0; i < 1000; ++i) {
+        bs_thread_pool_submit(pool_ptr, _test_count_and_submit, &targ);
+    }
+    bs_thread_pool_wait(pool_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 11000, bs_atomic_int32_get(&targ.runs));
+
+    // Tasks still queued at destroy get run, too.
+    bs_atomic_int32_set(&targ.runs, 0);
+    for (int i = 0; i < 100; ++i) {
+        bs_thread_pool_submit(pool_ptr, _test_count_and_submit, &targ);
+    }
+    bs_thread_pool_destroy(pool_ptr);
+    BS_TEST_VERIFY_EQ(test_ptr, 1100, bs_atomic_int32_get(&targ.runs));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies each index gets processed exactly once, for various grains. */
+void test_parallel_for(bs_test_t *test_ptr)
+{
+    uint8_t counts[100000] = {};
+    test_arg_t targ = { .counts_ptr = counts, .size = 100000 };
+
+    bs_thread_pool_t *pool_ptr = bs_thread_pool_create(3);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, pool_ptr);
+
+    bs_thread_pool_parallel_for(pool_ptr, 0, 100000, 0, _test_range, &targ);
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_verify_counts(&targ));
+
+    bs_thread_pool_parallel_for(pool_ptr, 0, 100000, 1, _test_range, &targ);
+    BS_TEST_VERIFY_EQ(test_ptr, 100000, bs_atomic_int32_get(&targ.runs));
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_verify_counts(&targ));
+
+    bs_thread_pool_parallel_for(pool_ptr, 3, 100000, 7, _test_range, &targ);
+    counts[0] = counts[1] = counts[2] = 1;
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_verify_counts(&targ));
+
+    bs_thread_pool_parallel_for(pool_ptr, 0, 100000, 100000, _test_range,
+                                &targ);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, bs_atomic_int32_get(&targ.runs));
+    BS_TEST_VERIFY_TRUE(test_ptr, _test_verify_counts(&targ));
+
+    // An empty range does not call the method.
+    bs_thread_pool_parallel_for(pool_ptr, 42, 42, 0, _test_range, &targ);
+    bs_thread_pool_parallel_for(pool_ptr, 43, 42, 0, _test_range, &targ);
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_atomic_int32_get(&targ.runs));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_atomic_int32_get(&targ.failures));
+
+    bs_thread_pool_destroy(pool_ptr);
+}
+
+/** Number of outer indices in @ref test_nested. */
+#define _TEST_NESTED_OUTER 16
+/** Number of inner indices in @ref test_nested. */
+#define _TEST_NESTED_INNER 1000
+
+/* ------------------------------------------------------------------------- */
+/** Range method: Runs an inner loop for each outer index. */
+static void _test_nested_range(void *arg_ptr, size_t begin, size_t end)
+{
+    test_arg_t *targ_ptr = arg_ptr;
+    for (size_t i = begin; i < end; ++i) {
+        bs_thread_pool_parallel_for(
+            targ_ptr->pool_ptr,
+            i * _TEST_NESTED_INNER, (i + 1) * _TEST_NESTED_INNER, 10,
+            _test_range, targ_ptr);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Task: Runs a nested loop. */
+static void _test_nested_task(void *arg_ptr)
+{
+    test_arg_t *targ_ptr = arg_ptr;
+    bs_thread_pool_parallel_for(targ_ptr->pool_ptr, 0, _TEST_NESTED_OUTER, 1,
+                                _test_nested_range, targ_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies nested loops, from outside the pool and from within a task. */
+void test_nested(bs_test_t *test_ptr)
+{
+    uint8_t counts[_TEST_NESTED_OUTER * _TEST_NESTED_INNER] = {};
+    test_arg_t targ = { .counts_ptr = counts, .size = sizeof(counts) };
+
+    for (unsigned workers = 1; workers <= 4; workers += 3) {
+        targ.pool_ptr = bs_thread_pool_create(workers);
+        BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, targ.pool_ptr);
+
+        _test_nested_task(&targ);
+        BS_TEST_VERIFY_TRUE(test_ptr, _test_verify_counts(&targ));
+
+        bs_thread_pool_submit(targ.pool_ptr, _test_nested_task, &targ);
+        bs_thread_pool_wait(targ.pool_ptr);
+        BS_TEST_VERIFY_TRUE(test_ptr, _test_verify_counts(&targ));
+
+        bs_thread_pool_destroy(targ.pool_ptr);
+    }
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_submit(bs_test_t *test_ptr);
+static void benchmark_parallel_for(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t bs_thread_pool_benchmarks[] = {
+    { 1, "benchmark-submit", benchmark_submit },
+    { 1, "benchmark-parallel_for", benchmark_parallel_for },
+    { 0, NULL, NULL }
+};
+
+/** Number of elements processed by @ref benchmark_parallel_for. */
+#define _BENCHMARK_ELEMENTS (1 << 22)
+
+/* ------------------------------------------------------------------------- */
+/** Task: Does nothing. */
+static void _benchmark_noop(__UNUSED__ void *arg_ptr)
+{
+}
+
+/* ------------------------------------------------------------------------- */
+/** Range method: A few rounds of a linear congruential generator each. */
+static void _benchmark_range(void *arg_ptr, size_t begin, size_t end)
+{
+    uint32_t *data_ptr = arg_ptr;
+    for (size_t i = begin; i < end; ++i) {
+        uint32_t v = data_ptr[i];
+        for (int r = 0; r < 16; ++r) v = v * 1664525u + 1013904223u;
+        data_ptr[i] = v;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Submits batches of empty tasks from outside the pool, and waits. */
+void benchmark_submit(bs_test_t *test_ptr)
+{
+    uint64_t                  tasks = 0;
+
+    bs_thread_pool_t *pool_ptr = bs_thread_pool_create(0);
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, pool_ptr);
+
+    uint64_t usec = bs_usec();
+    while (usec + benchmark_duration >= bs_usec()) {
+        for (int i = 0; i < 1000; ++i) {
+            bs_thread_pool_submit(pool_ptr, _benchmark_noop, NULL);
+        }
+        bs_thread_pool_wait(pool_ptr);
+        tasks += 1000;
+    }
+    usec = bs_usec() - usec;
+    bs_test_succeed(test_ptr, "%.3e tasks/sec at %u workers",
+                    (double)tasks / (usec * 1e-6),
+                    bs_thread_pool_workers(pool_ptr));
+    bs_thread_pool_destroy(pool_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Runs a compute-bound loop on pools of 1, 2, 4, ... workers, up to the
+ * number of online CPUs. Reports the throughput for each.
+ */
+void benchmark_parallel_for(bs_test_t *test_ptr)
+{
+    char                      report[256] = {};
+    size_t                    pos = 0;
+
+    uint32_t *data_ptr = logged_calloc(_BENCHMARK_ELEMENTS, sizeof(uint32_t));
+    BS_TEST_VERIFY_NEQ_OR_RETURN(test_ptr, NULL, data_ptr);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (1 > cpus) cpus = 1;
+    int runs = 1;
+    for (long w = 1; w < cpus; w *= 2) ++runs;
+
+    unsigned workers = 1;
+    for (int run = 0; run < runs; ++run) {
+        if (run == runs - 1) workers = cpus;
+        bs_thread_pool_t *pool_ptr = bs_thread_pool_create(workers);
+        if (NULL == pool_ptr) break;
+
+        uint64_t elements = 0;
+        uint64_t usec = bs_usec();
+        while (usec + benchmark_duration / runs >= bs_usec()) {
+            bs_thread_pool_parallel_for(pool_ptr, 0, _BENCHMARK_ELEMENTS, 0,
+                                        _benchmark_range, data_ptr);
+            elements += _BENCHMARK_ELEMENTS;
+        }
+        usec = bs_usec() - usec;
+        bs_thread_pool_destroy(pool_ptr);
+
+        if (pos < sizeof(report)) {
+            pos += snprintf(&report[pos], sizeof(report) - pos,
+                            "%s%u: %.3e", 0 < run ? ", " : "", workers,
+                            (double)elements / (usec * 1e-6));
+        }
+        workers *= 2;
+    }
+    logged_free(data_ptr);
+    bs_test_succeed(test_ptr, "elements/sec at workers %s", report);
+}
+
+/* == End of thread_pool.c ================================================= */
@@ -0,0 +1,135 @@
+/* ========================================================================= */
+/**
+ * @file thread_pool.h
+ * A work-stealing pool of worker threads, for tasks and data-parallel loops.
+ *
+ * Each worker owns a Chase-Lev deque: It pushes and pops tasks at the
+ * bottom, without contention, while idle workers steal from the top. Tasks
+ * submitted from outside the pool go through a shared @ref bs_mpmc_ring_t.
+ * Workers without anything to run or steal park on a condition variable.
+ *
+ * @ref bs_thread_pool_parallel_for splits an index range recursively into
+ * halves, and keeps the split tasks on the stack of the splitting thread.
+ * The calling thread takes part in the work.
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_THREAD_POOL_H__
+#define __LIBBASE_THREAD_POOL_H__
+
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** Forward declaration: The pool. */
+typedef struct _bs_thread_pool_t bs_thread_pool_t;
+
+/** A task, as submitted by @ref bs_thread_pool_submit. */
+typedef void (*bs_thread_pool_fn_t)(void *arg_ptr);
+
+/** Processes the indices [begin, end), for @ref bs_thread_pool_parallel_for. */
+typedef void (*bs_thread_pool_range_fn_t)(void *arg_ptr,
+                                          size_t begin,
+                                          size_t end);
+
+/**
+ * Creates a pool and starts its worker threads.
+ *
+ * @param workers             Number of worker threads to start. If 0, the
+ *                            number of online CPUs is used.
+ *
+ * @return A pointer to the pool, or NULL on error. Must be destroyed by
+ *     calling @ref bs_thread_pool_destroy.
+ */
+bs_thread_pool_t *bs_thread_pool_create(unsigned workers);
+
+/**
+ * Waits for all submitted tasks, stops the worker threads and destroys the
+ * pool.
+ *
+ * @param pool_ptr
+ */
+void bs_thread_pool_destroy(bs_thread_pool_t *pool_ptr);
+
+/** Returns the number of worker threads of the pool. */
+unsigned bs_thread_pool_workers(bs_thread_pool_t *pool_ptr);
+
+/**
+ * Submits a task, to be run on any of the worker threads. Thread-safe.
+ *
+ * From a worker thread, the task goes to this worker's deque. Otherwise, it
+ * is queued for all workers. If the queue is full, or the task could not be
+ * allocated, the task runs right away, on the calling thread.
+ *
+ * @param pool_ptr
+ * @param fn                  The task's method.
+ * @param arg_ptr             Argument to `fn`.
+ *
+ * @return false if the task was run on the calling thread.
+ */
+bool bs_thread_pool_submit(bs_thread_pool_t *pool_ptr,
+                           bs_thread_pool_fn_t fn,
+                           void *arg_ptr);
+
+/**
+ * Runs submitted tasks on the calling thread, too, until all tasks are done.
+ *
+ * Must not be called from within a submitted task, since it would wait for
+ * that task, too.
+ *
+ * @param pool_ptr
+ */
+void bs_thread_pool_wait(bs_thread_pool_t *pool_ptr);
+
+/**
+ * Calls `fn` for chunks of [begin, end), in parallel, and returns once all
+ * chunks are done.
+ *
+ * May be called from within tasks and from within `fn`, for nested
+ * parallelism. Calls from threads outside the pool are serialized.
+ *
+ * @param pool_ptr
+ * @param begin
+ * @param end
+ * @param grain               Size of chunks not to split any further. If 0,
+ *                            chunks are sized for a few per thread.
+ * @param fn
+ * @param arg_ptr             Argument to `fn`.
+ */
+void bs_thread_pool_parallel_for(bs_thread_pool_t *pool_ptr,
+                                 size_t begin,
+                                 size_t end,
+                                 size_t grain,
+                                 bs_thread_pool_range_fn_t fn,
+                                 void *arg_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_thread_pool_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_thread_pool_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_THREAD_POOL_H__ */
+/* == End of thread_pool.h ================================================= */
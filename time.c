@@ -27,13 +27,31 @@
 #include "time.h"
 #include "test.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <sys/time.h>
 
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif  // defined(__x86_64__)
+
 #undef _XOPEN_SOURCE
 
+/* == Declarations ========================================================= */
+
+/** Duration of calibrating the fast clock, in nanoseconds. */
+#define _BS_FAST_CLOCK_CALIBRATION_NSEC 10000000
+
+static void _bs_fast_clock_calibrate(void);
+static bool _bs_fast_clock_has_counter(void);
+
+bs_fast_clock_t               _bs_fast_clock = {};
+
+/** Guards @ref _bs_fast_clock_calibrate. */
+static pthread_once_t         _bs_fast_clock_once = PTHREAD_ONCE_INIT;
+
 /* == Methods ============================================================== */
 
 /* ------------------------------------------------------------------------- */
@@ -63,14 +81,111 @@ uint64_t bs_mono_nsec(void)
     return timespec.tv_sec * UINT64_C(1000000000) +  + timespec.tv_nsec;
 }
 
+/* ------------------------------------------------------------------------- */
+uint64_t bs_coarse_nsec(void)
+{
+#if defined(CLOCK_MONOTONIC_COARSE)
+    struct timespec timespec;
+    if (0 != clock_gettime(CLOCK_MONOTONIC_COARSE, &timespec)) {
+        bs_log(BS_ERROR | BS_ERRNO,
+               "Failed clock_gettime(CLOCK_MONOTONIC_COARSE, %p)",
+               &timespec);
+        return 0;
+    }
+    return timespec.tv_sec * UINT64_C(1000000000) + timespec.tv_nsec;
+#else  // defined(CLOCK_MONOTONIC_COARSE)
+    return bs_mono_nsec();
+#endif  // defined(CLOCK_MONOTONIC_COARSE)
+}
+
+/* ------------------------------------------------------------------------- */
+bs_fast_clock_source_t bs_fast_clock_source(void)
+{
+    pthread_once(&_bs_fast_clock_once, _bs_fast_clock_calibrate);
+    return __atomic_load_n(&_bs_fast_clock.source, __ATOMIC_ACQUIRE);
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t _bs_fast_nsec_slow(void)
+{
+    pthread_once(&_bs_fast_clock_once, _bs_fast_clock_calibrate);
+#if defined(__x86_64__) || defined(__aarch64__)
+    if (BS_FAST_CLOCK_COUNTER == _bs_fast_clock.source) return bs_fast_nsec();
+#endif  // defined(__x86_64__) || defined(__aarch64__)
+    return bs_mono_nsec();
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Calibrates the CPU's counter against CLOCK_MONOTONIC, by spinning for
+ * @ref _BS_FAST_CLOCK_CALIBRATION_NSEC. Not needed on AArch64, where the
+ * counter's frequency is known.
+ */
+void _bs_fast_clock_calibrate(void)
+{
+    int source = BS_FAST_CLOCK_MONOTONIC;
+    if (_bs_fast_clock_has_counter()) {
+#if defined(__x86_64__)
+        uint64_t nsec0 = bs_mono_nsec();
+        uint64_t ticks0 = _bs_fast_clock_ticks();
+        uint64_t nsec1, ticks1;
+        do {
+            nsec1 = bs_mono_nsec();
+            ticks1 = _bs_fast_clock_ticks();
+        } while (nsec1 < nsec0 + _BS_FAST_CLOCK_CALIBRATION_NSEC);
+        if (ticks1 > ticks0) {
+            _bs_fast_clock.mult = ((nsec1 - nsec0) << 32) / (ticks1 - ticks0);
+            _bs_fast_clock.ticks_base = ticks1;
+            _bs_fast_clock.nsec_base = nsec1;
+            source = BS_FAST_CLOCK_COUNTER;
+        }
+#elif defined(__aarch64__)
+        uint64_t frequency;
+        __asm__ volatile ("mrs %0, cntfrq_el0" : "=r" (frequency));
+        if (0 < frequency) {
+            _bs_fast_clock.mult = (UINT64_C(1000000000) << 32) / frequency;
+            _bs_fast_clock.nsec_base = bs_mono_nsec();
+            _bs_fast_clock.ticks_base = _bs_fast_clock_ticks();
+            source = BS_FAST_CLOCK_COUNTER;
+        }
+#endif
+    }
+    __atomic_store_n(&_bs_fast_clock.source, source, __ATOMIC_RELEASE);
+}
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns whether the CPU has a counter at a constant rate. On x86-64,
+ * that requires an invariant TSC: One that runs at a constant rate across
+ * frequency changes and sleep states.
+ */
+bool _bs_fast_clock_has_counter(void)
+{
+#if defined(__x86_64__)
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return false;
+    return 0 != (edx & (1u << 8));
+#elif defined(__aarch64__)
+    return true;
+#else
+    return false;
+#endif
+}
+
 /* == Unit tests =========================================================== */
 
 static void bs_time_test_usec(bs_test_t *test_ptr);
 static void bs_time_test_nsec(bs_test_t *test_ptr);
+static void bs_time_test_coarse_nsec(bs_test_t *test_ptr);
+static void bs_time_test_fast_nsec(bs_test_t *test_ptr);
 
 const bs_test_case_t          bs_time_test_cases[] = {
     { 1, "time usec", bs_time_test_usec },
     { 1, "time_mono_nsec", bs_time_test_nsec },
+    { 1, "time_coarse_nsec", bs_time_test_coarse_nsec },
+    { 1, "time_fast_nsec", bs_time_test_fast_nsec },
     { 0, NULL, NULL }
 };
 
@@ -89,4 +204,100 @@ void bs_time_test_nsec(bs_test_t *test_ptr)
     BS_TEST_VERIFY_TRUE(test_ptr, v1 <= v2);
 }
 
+/* ------------------------------------------------------------------------- */
+void bs_time_test_coarse_nsec(bs_test_t *test_ptr)
+{
+    uint64_t coarse = bs_coarse_nsec();
+    uint64_t mono = bs_mono_nsec();
+    BS_TEST_VERIFY_NEQ(test_ptr, 0, coarse);
+    // The coarse clock lags by less than a scheduler tick.
+    BS_TEST_VERIFY_TRUE(test_ptr, coarse <= mono);
+    BS_TEST_VERIFY_TRUE(test_ptr, mono - coarse < UINT64_C(100000000));
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_time_test_fast_nsec(bs_test_t *test_ptr)
+{
+    uint64_t v1 = bs_fast_nsec();
+    BS_TEST_VERIFY_NEQ(test_ptr, BS_FAST_CLOCK_UNKNOWN,
+                       bs_fast_clock_source());
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t v2 = bs_fast_nsec();
+        BS_TEST_VERIFY_TRUE(test_ptr, v1 <= v2);
+        v1 = v2;
+    }
+
+    // Tracks CLOCK_MONOTONIC closely, also after a while.
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 20000000 };
+    nanosleep(&ts, NULL);
+    uint64_t mono = bs_mono_nsec();
+    uint64_t fast = bs_fast_nsec();
+    uint64_t diff = fast > mono ? fast - mono : mono - fast;
+    BS_TEST_VERIFY_TRUE(test_ptr, diff < UINT64_C(1000000));
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_usec(bs_test_t *test_ptr);
+static void benchmark_mono_nsec(bs_test_t *test_ptr);
+static void benchmark_coarse_nsec(bs_test_t *test_ptr);
+static void benchmark_fast_nsec(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t          bs_time_benchmarks[] = {
+    { 1, "benchmark-usec", benchmark_usec },
+    { 1, "benchmark-mono_nsec", benchmark_mono_nsec },
+    { 1, "benchmark-coarse_nsec", benchmark_coarse_nsec },
+    { 1, "benchmark-fast_nsec", benchmark_fast_nsec },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Calls `clock_func` for the benchmark duration, and reports the rate. */
+static void _benchmark_clock(bs_test_t *test_ptr, uint64_t (*clock_func)(void))
+{
+    uint64_t usec = bs_usec(), calls = 0, sum = 0;
+    while (usec + benchmark_duration >= bs_usec()) {
+        for (int i = 0; i < 1000; ++i) sum += clock_func();
+        calls += 1000;
+    }
+    usec = bs_usec() - usec;
+    BS_TEST_VERIFY_NEQ(test_ptr, 0, sum);
+    bs_test_succeed(test_ptr, "%.3e calls/sec",
+                    (double)calls / (usec * 1e-6));
+}
+
+/** Wraps @ref bs_fast_nsec, which is inline. */
+static uint64_t _benchmark_fast_nsec(void) { return bs_fast_nsec(); }
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks @ref bs_usec. */
+void benchmark_usec(bs_test_t *test_ptr)
+{
+    _benchmark_clock(test_ptr, bs_usec);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks @ref bs_mono_nsec. */
+void benchmark_mono_nsec(bs_test_t *test_ptr)
+{
+    _benchmark_clock(test_ptr, bs_mono_nsec);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks @ref bs_coarse_nsec. */
+void benchmark_coarse_nsec(bs_test_t *test_ptr)
+{
+    _benchmark_clock(test_ptr, bs_coarse_nsec);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks @ref bs_fast_nsec. */
+void benchmark_fast_nsec(bs_test_t *test_ptr)
+{
+    bs_fast_nsec();  // Calibrates, outside of the measurement.
+    _benchmark_clock(test_ptr, _benchmark_fast_nsec);
+}
+
 /* == End of time.c ======================================================== */
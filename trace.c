@@ -0,0 +1,454 @@
+/* ========================================================================= */
+/**
+ * @file trace.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace.h"
+
+#include "atomic.h"
+#include "gfxbuf.h"
+#include "log.h"
+#include "thread.h"
+#include "time.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* == Declarations ========================================================= */
+
+/** Default capacity of each thread's buffer, in events. */
+#define _BS_TRACE_DEFAULT_EVENTS 65536
+
+/** A recorded span. */
+typedef struct {
+    /** Name of the span. */
+    const char                *name_ptr;
+    /** Begin, from @ref bs_fast_nsec. */
+    uint64_t                  begin_nsec;
+    /** End, from @ref bs_fast_nsec. */
+    uint64_t                  end_nsec;
+} bs_trace_event_t;
+
+/** Per-thread buffer of events. Written only by the owning thread. */
+typedef struct _bs_trace_buffer_t bs_trace_buffer_t;
+/** State of the per-thread buffer. */
+struct _bs_trace_buffer_t {
+    /** Next buffer, in @ref _bs_trace_buffers_ptr. */
+    bs_trace_buffer_t         *next_ptr;
+    /** Thread ID, as reported in the export. */
+    unsigned                  tid;
+    /** Number of events that `events` can hold. */
+    size_t                    capacity;
+    /** Number of events recorded. Published with release semantics. */
+    bs_atomic_int64_t         count;
+    /** The events. */
+    bs_trace_event_t          events[];
+};
+
+static bs_trace_buffer_t *_bs_trace_buffer(void);
+static int _bs_trace_write_string(FILE *stream_ptr, const char *str_ptr);
+
+/** Whether tracing is enabled. */
+static bs_atomic_int32_t      _bs_trace_is_enabled = BS_ATOMIC_INT32_INIT(0);
+/** Incremented on reset, so threads know to allocate a new buffer. */
+static bs_atomic_int32_t      _bs_trace_generation = BS_ATOMIC_INT32_INIT(1);
+/** Number of spans dropped, since buffers were full. */
+static bs_atomic_int64_t      _bs_trace_dropped = BS_ATOMIC_INT64_INIT(0);
+
+/** Protects the buffer list, and the settings below. */
+static pthread_mutex_t        _bs_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+/** All buffers, as a singly-linked list. */
+static bs_trace_buffer_t      *_bs_trace_buffers_ptr = NULL;
+/** Capacity for newly allocated buffers. */
+static size_t                 _bs_trace_events_per_thread =
+    _BS_TRACE_DEFAULT_EVENTS;
+/** Number of buffers allocated since reset. */
+static unsigned               _bs_trace_threads = 0;
+
+/** The calling thread's buffer. Only valid for `_bs_trace_thread_gen`. */
+static _Thread_local bs_trace_buffer_t *_bs_trace_thread_buffer_ptr;
+/** Generation of the calling thread's buffer. 0 if none yet. */
+static _Thread_local int32_t  _bs_trace_thread_gen;
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+void bs_trace_enable(size_t events_per_thread)
+{
+    bs_mutex_lock(&_bs_trace_mutex);
+    _bs_trace_events_per_thread =
+        0 < events_per_thread ? events_per_thread : _BS_TRACE_DEFAULT_EVENTS;
+    bs_mutex_unlock(&_bs_trace_mutex);
+    bs_atomic_int32_set(&_bs_trace_is_enabled, 1);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_trace_disable(void)
+{
+    bs_atomic_int32_set(&_bs_trace_is_enabled, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+bool bs_trace_enabled(void)
+{
+    return 0 != bs_atomic_int32_get_explicit(&_bs_trace_is_enabled,
+                                             BS_ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_trace_reset(void)
+{
+    bs_mutex_lock(&_bs_trace_mutex);
+    while (NULL != _bs_trace_buffers_ptr) {
+        bs_trace_buffer_t *buffer_ptr = _bs_trace_buffers_ptr;
+        _bs_trace_buffers_ptr = buffer_ptr->next_ptr;
+        free(buffer_ptr);
+    }
+    _bs_trace_threads = 0;
+    bs_atomic_int64_set(&_bs_trace_dropped, 0);
+    bs_atomic_int32_add(&_bs_trace_generation, 1);
+    bs_mutex_unlock(&_bs_trace_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t bs_trace_dropped(void)
+{
+    return bs_atomic_int64_get(&_bs_trace_dropped);
+}
+
+/* ------------------------------------------------------------------------- */
+bs_trace_span_t bs_trace_span_begin(const char *name_ptr)
+{
+    bs_trace_span_t span = {};
+    if (bs_trace_enabled()) {
+        span.name_ptr = name_ptr;
+        span.begin_nsec = bs_fast_nsec();
+    }
+    return span;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_trace_span_end(bs_trace_span_t *span_ptr)
+{
+    if (NULL == span_ptr->name_ptr) return;
+    uint64_t end_nsec = bs_fast_nsec();
+
+    bs_trace_buffer_t *buffer_ptr = _bs_trace_buffer();
+    int64_t count = 0;
+    if (NULL != buffer_ptr) {
+        count = bs_atomic_int64_get_explicit(&buffer_ptr->count,
+                                             BS_ATOMIC_RELAXED);
+    }
+    if (NULL == buffer_ptr || (size_t)count >= buffer_ptr->capacity) {
+        bs_atomic_int64_add_explicit(&_bs_trace_dropped, 1,
+                                     BS_ATOMIC_RELAXED);
+        return;
+    }
+
+    buffer_ptr->events[count] = (bs_trace_event_t){
+        .name_ptr = span_ptr->name_ptr,
+        .begin_nsec = span_ptr->begin_nsec,
+        .end_nsec = end_nsec };
+    bs_atomic_int64_set_explicit(&buffer_ptr->count, count + 1,
+                                 BS_ATOMIC_RELEASE);
+}
+
+/* ------------------------------------------------------------------------- */
+int bs_trace_export(FILE *stream_ptr)
+{
+    int                       written_bytes, rv;
+    const char                *separator_ptr = "\n";
+
+    bs_mutex_lock(&_bs_trace_mutex);
+    rv = fprintf(stream_ptr, "{\"traceEvents\":[");
+    written_bytes = rv;
+    for (bs_trace_buffer_t *buffer_ptr = _bs_trace_buffers_ptr;
+         NULL != buffer_ptr && 0 <= rv;
+         buffer_ptr = buffer_ptr->next_ptr) {
+        int64_t count = bs_atomic_int64_get_explicit(&buffer_ptr->count,
+                                                     BS_ATOMIC_ACQUIRE);
+        for (int64_t i = 0; i < count && 0 <= rv; ++i) {
+            bs_trace_event_t *event_ptr = &buffer_ptr->events[i];
+            uint64_t dur_nsec = event_ptr->end_nsec - event_ptr->begin_nsec;
+
+            // Chrome trace timestamps are in microseconds.
+            rv = fprintf(stream_ptr, "%s{\"name\":", separator_ptr);
+            if (0 <= rv) written_bytes += rv;
+            if (0 <= rv) rv = _bs_trace_write_string(
+                    stream_ptr, event_ptr->name_ptr);
+            if (0 <= rv) written_bytes += rv;
+            if (0 <= rv) rv = fprintf(
+                    stream_ptr,
+                    ",\"ph\":\"X\",\"ts\":%"PRIu64".%03u,"
+                    "\"dur\":%"PRIu64".%03u,\"pid\":%d,\"tid\":%u}",
+                    event_ptr->begin_nsec / 1000,
+                    (unsigned)(event_ptr->begin_nsec % 1000),
+                    dur_nsec / 1000, (unsigned)(dur_nsec % 1000),
+                    (int)getpid(), buffer_ptr->tid);
+            if (0 <= rv) written_bytes += rv;
+            separator_ptr = ",\n";
+        }
+    }
+    bs_mutex_unlock(&_bs_trace_mutex);
+    if (0 > rv) return rv;
+
+    rv = fprintf(stream_ptr, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    return 0 <= rv ? written_bytes + rv : rv;
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/**
+ * Returns the calling thread's buffer, and allocates it if needed.
+ *
+ * @return The buffer, or NULL if it could not be allocated. Allocation is
+ *     not retried until the next @ref bs_trace_reset.
+ */
+bs_trace_buffer_t *_bs_trace_buffer(void)
+{
+    int32_t generation = bs_atomic_int32_get(&_bs_trace_generation);
+    if (generation == _bs_trace_thread_gen) {
+        return _bs_trace_thread_buffer_ptr;
+    }
+    // Set before allocating: Logging an error will record a span, too.
+    _bs_trace_thread_gen = generation;
+    _bs_trace_thread_buffer_ptr = NULL;
+
+    bs_mutex_lock(&_bs_trace_mutex);
+    size_t capacity = _bs_trace_events_per_thread;
+    bs_trace_buffer_t *buffer_ptr = malloc(
+        sizeof(bs_trace_buffer_t) + capacity * sizeof(bs_trace_event_t));
+    if (NULL != buffer_ptr) {
+        buffer_ptr->tid = ++_bs_trace_threads;
+        buffer_ptr->capacity = capacity;
+        bs_atomic_int64_set(&buffer_ptr->count, 0);
+        buffer_ptr->next_ptr = _bs_trace_buffers_ptr;
+        _bs_trace_buffers_ptr = buffer_ptr;
+    }
+    bs_mutex_unlock(&_bs_trace_mutex);
+
+    if (NULL == buffer_ptr) {
+        bs_log(BS_ERROR | BS_ERRNO, "Failed malloc(%zu)",
+               sizeof(bs_trace_buffer_t) +
+               capacity * sizeof(bs_trace_event_t));
+        return NULL;
+    }
+    _bs_trace_thread_buffer_ptr = buffer_ptr;
+    return buffer_ptr;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Writes `str_ptr` as a quoted and escaped JSON string. */
+int _bs_trace_write_string(FILE *stream_ptr, const char *str_ptr)
+{
+    int                       written_bytes = 0, rv = 0;
+
+    if (EOF == fputc('"', stream_ptr)) return -1;
+    written_bytes++;
+    for (; '\0' != *str_ptr && 0 <= rv; ++str_ptr) {
+        unsigned char c = *str_ptr;
+        if ('"' == c || '\\' == c) {
+            rv = fprintf(stream_ptr, "\\%c", c);
+        } else if (0x20 > c) {
+            rv = fprintf(stream_ptr, "\\u%04x", c);
+        } else {
+            rv = EOF == fputc(c, stream_ptr) ? -1 : 1;
+        }
+        if (0 <= rv) written_bytes += rv;
+    }
+    if (0 > rv || EOF == fputc('"', stream_ptr)) return -1;
+    return written_bytes + 1;
+}
+
+/* == Unit tests =========================================================== */
+
+static void test_disabled(bs_test_t *test_ptr);
+static void test_spans(bs_test_t *test_ptr);
+static void test_dropped(bs_test_t *test_ptr);
+
+const bs_test_case_t bs_trace_test_cases[] = {
+    { 1, "disabled", test_disabled },
+    { 1, "spans", test_spans },
+    { 1, "dropped", test_dropped },
+    { 0, NULL, NULL }
+};
+
+/** Exports the trace into `buf_ptr`. Returns the number of bytes. */
+static int _test_export(char *buf_ptr, size_t size)
+{
+    FILE *stream_ptr = tmpfile();
+    if (NULL == stream_ptr) return -1;
+    int bytes = bs_trace_export(stream_ptr);
+    rewind(stream_ptr);
+    size_t len = fread(buf_ptr, 1, size - 1, stream_ptr);
+    buf_ptr[len] = '\0';
+    fclose(stream_ptr);
+    return 0 <= bytes && (size_t)bytes == len ? bytes : -1;
+}
+
+/** Counts occurrences of `needle_ptr` in `haystack_ptr`. */
+static int _test_count(const char *haystack_ptr, const char *needle_ptr)
+{
+    int count = 0;
+    while (NULL != (haystack_ptr = strstr(haystack_ptr, needle_ptr))) {
+        ++count;
+        haystack_ptr += strlen(needle_ptr);
+    }
+    return count;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Thread: Records a span. */
+static void *_test_span_thread(__UNUSED__ void *arg_ptr)
+{
+    BS_TRACE_SCOPE("thread");
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies nothing is recorded when disabled. */
+void test_disabled(bs_test_t *test_ptr)
+{
+    char                      buf[256];
+
+    bs_trace_reset();
+    BS_TEST_VERIFY_FALSE(test_ptr, bs_trace_enabled());
+    BS_TRACE_BEGIN(span, "disabled");
+    BS_TEST_VERIFY_EQ(test_ptr, NULL, span.name_ptr);
+    BS_TRACE_END(span);
+
+    BS_TEST_VERIFY_TRUE(test_ptr, 0 < _test_export(buf, sizeof(buf)));
+    BS_TEST_VERIFY_STREQ(
+        test_ptr, "{\"traceEvents\":[\n],\"displayTimeUnit\":\"ns\"}\n", buf);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Records nested spans, from threads and in library paths, and exports. */
+void test_spans(bs_test_t *test_ptr)
+{
+    char                      buf[4096];
+    pthread_t                 thread;
+
+    bs_trace_reset();
+    bs_trace_enable(0);
+    BS_TEST_VERIFY_TRUE(test_ptr, bs_trace_enabled());
+    {
+        BS_TRACE_SCOPE("outer");
+        BS_TRACE_BEGIN(span, "in\"ner");
+        BS_TEST_VERIFY_NEQ(test_ptr, NULL, span.name_ptr);
+        BS_TRACE_END(span);
+    }
+    BS_TEST_VERIFY_EQ_OR_RETURN(
+        test_ptr, 0,
+        pthread_create(&thread, NULL, _test_span_thread, NULL));
+    pthread_join(thread, NULL);
+
+    bs_gfxbuf_t *gfxbuf_ptr = bs_gfxbuf_create(4, 4);
+    if (NULL != gfxbuf_ptr) {
+        bs_gfxbuf_copy_area(gfxbuf_ptr, 0, 0, gfxbuf_ptr, 2, 2, 2, 2);
+        bs_gfxbuf_destroy(gfxbuf_ptr);
+    }
+    bs_trace_disable();
+
+    BS_TEST_VERIFY_TRUE(test_ptr, 0 < _test_export(buf, sizeof(buf)));
+    BS_TEST_VERIFY_EQ(test_ptr, 4, _test_count(buf, "\"ph\":\"X\""));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, _test_count(buf, "\"name\":\"outer\""));
+    BS_TEST_VERIFY_EQ(test_ptr, 1,
+                      _test_count(buf, "\"name\":\"in\\\"ner\""));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, _test_count(buf, "\"name\":\"thread\""));
+    BS_TEST_VERIFY_EQ(test_ptr, 1, _test_count(buf, "\"tid\":2}"));
+    BS_TEST_VERIFY_EQ(
+        test_ptr, 1, _test_count(buf, "\"name\":\"bs_gfxbuf_copy_area\""));
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_trace_dropped());
+    bs_trace_reset();
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies spans beyond the buffer's capacity are dropped. */
+void test_dropped(bs_test_t *test_ptr)
+{
+    char                      buf[1024];
+
+    bs_trace_reset();
+    bs_trace_enable(2);
+    for (int i = 0; i < 5; ++i) {
+        BS_TRACE_SCOPE("span");
+    }
+    bs_trace_disable();
+    BS_TEST_VERIFY_EQ(test_ptr, 3, bs_trace_dropped());
+    BS_TEST_VERIFY_TRUE(test_ptr, 0 < _test_export(buf, sizeof(buf)));
+    BS_TEST_VERIFY_EQ(test_ptr, 2, _test_count(buf, "\"name\":\"span\""));
+    bs_trace_reset();
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_trace_dropped());
+}
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_span_disabled(bs_test_t *test_ptr);
+static void benchmark_span_enabled(bs_test_t *test_ptr);
+
+static const uint64_t benchmark_duration = 2500000;
+
+const bs_test_case_t bs_trace_benchmarks[] = {
+    { 1, "benchmark-span-disabled", benchmark_span_disabled },
+    { 1, "benchmark-span-enabled", benchmark_span_enabled },
+    { 0, NULL, NULL }
+};
+
+/* ------------------------------------------------------------------------- */
+/** Records spans for the benchmark duration. Returns spans per second. */
+static double _benchmark_spans(void)
+{
+    uint64_t usec = bs_usec(), spans = 0;
+    while (usec + benchmark_duration >= bs_usec()) {
+        bs_trace_reset();
+        for (int i = 0; i < 10000; ++i) {
+            BS_TRACE_SCOPE("benchmark");
+        }
+        spans += 10000;
+    }
+    usec = bs_usec() - usec;
+    return (double)spans / (usec * 1e-6);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks the cost of a span, with tracing disabled. */
+void benchmark_span_disabled(bs_test_t *test_ptr)
+{
+    bs_trace_disable();
+    bs_test_succeed(test_ptr, "%.3e spans/sec", _benchmark_spans());
+}
+
+/* ------------------------------------------------------------------------- */
+/** Benchmarks the cost of recording a span. */
+void benchmark_span_enabled(bs_test_t *test_ptr)
+{
+    bs_trace_enable(10000);
+    double rate = _benchmark_spans();
+    bs_trace_disable();
+    BS_TEST_VERIFY_EQ(test_ptr, 0, bs_trace_dropped());
+    bs_trace_reset();
+    bs_test_succeed(test_ptr, "%.3e spans/sec", rate);
+}
+
+/* == End of trace.c ======================================================= */
@@ -0,0 +1,143 @@
+/* ========================================================================= */
+/**
+ * @file trace.h
+ * Lightweight tracing of spans, exported as Chrome trace JSON.
+ *
+ * A span records its name and its begin and end time, from
+ * @ref bs_fast_nsec, into a buffer of the calling thread. Recording takes
+ * no lock, and is skipped unless tracing was enabled with
+ * @ref bs_trace_enable. The recorded spans can be written as Chrome trace
+ * event JSON with @ref bs_trace_export, for viewing in chrome://tracing or
+ * in the Perfetto UI (https://ui.perfetto.dev).
+ *
+ * Example:
+ * ```
+ * void render(void) {
+ *     BS_TRACE_SCOPE("render");
+ *     ...
+ *     BS_TRACE_BEGIN(span, "render.blit");
+ *     blit();
+ *     BS_TRACE_END(span);
+ * }
+ * ```
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBBASE_TRACE_H__
+#define __LIBBASE_TRACE_H__
+
+#include "test.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/** A span, begun by @ref bs_trace_span_begin. */
+typedef struct {
+    /** Name of the span. NULL if tracing was disabled at begin. */
+    const char                *name_ptr;
+    /** Begin of the span, from @ref bs_fast_nsec. */
+    uint64_t                  begin_nsec;
+} bs_trace_span_t;
+
+/**
+ * Begins a span, held in the variable `_span`, named `_name_ptr`.
+ *
+ * `_name_ptr` is not copied, and must remain valid until exported. Best
+ * use a string literal.
+ */
+#define BS_TRACE_BEGIN(_span, _name_ptr)                        \
+    bs_trace_span_t _span = bs_trace_span_begin(_name_ptr)
+
+/** Ends the span `_span`, as begun by @ref BS_TRACE_BEGIN. */
+#define BS_TRACE_END(_span) bs_trace_span_end(&(_span))
+
+/** Helper to @ref BS_TRACE_SCOPE: Expands the line number. */
+#define _BS_TRACE_VARNAME(_line) _BS_TRACE_VARNAME2(_line)
+/** Helper to @ref BS_TRACE_SCOPE: Builds the span's variable name. */
+#define _BS_TRACE_VARNAME2(_line) _bs_trace_span_ ## _line
+
+/** Begins a span named `_name_ptr`, and ends it when leaving the scope. */
+#define BS_TRACE_SCOPE(_name_ptr)                               \
+    bs_trace_span_t _BS_TRACE_VARNAME(__LINE__)                 \
+    __attribute__((cleanup(bs_trace_span_end))) =               \
+        bs_trace_span_begin(_name_ptr)
+
+/**
+ * Enables tracing.
+ *
+ * @param events_per_thread   Capacity of each thread's buffer. Spans beyond
+ *                            that are dropped, and counted in
+ *                            @ref bs_trace_dropped. If 0, a default of 65536
+ *                            is used. Applies to buffers allocated after the
+ *                            next @ref bs_trace_reset.
+ */
+void bs_trace_enable(size_t events_per_thread);
+
+/** Disables tracing. Spans recorded so far are kept. */
+void bs_trace_disable(void);
+
+/** Returns whether tracing is enabled. */
+bool bs_trace_enabled(void);
+
+/**
+ * Discards all recorded spans, and releases the threads' buffers.
+ *
+ * Tracing must be disabled, and no span may be ending concurrently.
+ */
+void bs_trace_reset(void);
+
+/** Returns the number of spans dropped since the last reset. */
+uint64_t bs_trace_dropped(void);
+
+/** Begins a span. Use @ref BS_TRACE_BEGIN or @ref BS_TRACE_SCOPE. */
+bs_trace_span_t bs_trace_span_begin(const char *name_ptr);
+
+/**
+ * Ends the span, and records it in the calling thread's buffer. Use
+ * @ref BS_TRACE_END or @ref BS_TRACE_SCOPE.
+ */
+void bs_trace_span_end(bs_trace_span_t *span_ptr);
+
+/**
+ * Writes all recorded spans to `stream_ptr`, as Chrome trace event JSON.
+ *
+ * May be called while tracing is enabled: Spans that end concurrently may
+ * or may not be included.
+ *
+ * @param stream_ptr
+ *
+ * @return Number of bytes written, or a negative value on error.
+ */
+int bs_trace_export(FILE *stream_ptr);
+
+/** Unit tests. */
+extern const bs_test_case_t   bs_trace_test_cases[];
+
+/** Benchmarks, in the form of an unit test. */
+extern const bs_test_case_t   bs_trace_benchmarks[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif  // __cplusplus
+
+#endif /* __LIBBASE_TRACE_H__ */
+/* == End of trace.h ======================================================= */
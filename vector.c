@@ -0,0 +1,1929 @@
+/* ========================================================================= */
+/**
+ * @file vector.c
+ *
+ * @copyright
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vector.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "def.h"
+#include "log_wrappers.h"
+
+// SSE2 is part of the amd64 baseline, and NEON of aarch64: The methods use
+// these without checking the CPU at runtime. AVX is dispatched at runtime,
+// for the structure-of-arrays kernels.
+#if defined(__x86_64__) || defined(__i386__)
+#define BS_VECTOR_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define BS_VECTOR_NEON
+#include <arm_neon.h>
+#endif
+
+/* == Declarations ========================================================= */
+
+/** Kernels for the structure-of-arrays methods, operating on one array. */
+typedef struct {
+    /** dest[i] = src1[i] + src2[i]. */
+    void (*add_f64)(double *dest_ptr,
+                    const double *src1_ptr,
+                    const double *src2_ptr,
+                    size_t num);
+    /** dest[i] = scale * src[i]. */
+    void (*mul_f64)(double *dest_ptr,
+                    double scale,
+                    const double *src_ptr,
+                    size_t num);
+    /** dest[i] = x1[i] * x2[i] + y1[i] * y2[i]. */
+    void (*dot_f64)(double *dest_ptr,
+                    const double *x1_ptr,
+                    const double *y1_ptr,
+                    const double *x2_ptr,
+                    const double *y2_ptr,
+                    size_t num);
+    /** dest[i] = sqrt(x[i] * x[i] + y[i] * y[i]). */
+    void (*length_f64)(double *dest_ptr,
+                       const double *x_ptr,
+                       const double *y_ptr,
+                       size_t num);
+    /** Applies `affine_ptr` to (x[i], y[i]). */
+    void (*transform_f64)(double *x_dest_ptr,
+                          double *y_dest_ptr,
+                          const bs_affine_2f_t *affine_ptr,
+                          const double *x_ptr,
+                          const double *y_ptr,
+                          size_t num);
+    /** Minimum and maximum of src[i]. */
+    void (*bounds_f64)(const double *src_ptr,
+                       size_t num,
+                       double *min_ptr,
+                       double *max_ptr);
+
+    /** Same as `add_f64`, in single precision. */
+    void (*add_f32)(float *dest_ptr,
+                    const float *src1_ptr,
+                    const float *src2_ptr,
+                    size_t num);
+    /** Same as `mul_f64`, in single precision. */
+    void (*mul_f32)(float *dest_ptr,
+                    float scale,
+                    const float *src_ptr,
+                    size_t num);
+    /** Same as `dot_f64`, in single precision. */
+    void (*dot_f32)(float *dest_ptr,
+                    const float *x1_ptr,
+                    const float *y1_ptr,
+                    const float *x2_ptr,
+                    const float *y2_ptr,
+                    size_t num);
+    /** Same as `length_f64`, in single precision. */
+    void (*length_f32)(float *dest_ptr,
+                       const float *x_ptr,
+                       const float *y_ptr,
+                       size_t num);
+    /** Same as `transform_f64`, in single precision. */
+    void (*transform_f32)(float *x_dest_ptr,
+                          float *y_dest_ptr,
+                          const bs_affine_2f_t *affine_ptr,
+                          const float *x_ptr,
+                          const float *y_ptr,
+                          size_t num);
+    /** Same as `bounds_f64`, in single precision. */
+    void (*bounds_f32)(const float *src_ptr,
+                       size_t num,
+                       float *min_ptr,
+                       float *max_ptr);
+} bs_vector_soa_kernels_t;
+
+static const bs_vector_soa_kernels_t *_bs_vector_soa_dispatch(void);
+
+static void _bs_vector_soa_add_f64(double *dest_ptr,
+                                   const double *src1_ptr,
+                                   const double *src2_ptr,
+                                   size_t num);
+static void _bs_vector_soa_mul_f64(double *dest_ptr,
+                                   double scale,
+                                   const double *src_ptr,
+                                   size_t num);
+static void _bs_vector_soa_dot_f64(double *dest_ptr,
+                                   const double *x1_ptr,
+                                   const double *y1_ptr,
+                                   const double *x2_ptr,
+                                   const double *y2_ptr,
+                                   size_t num);
+static void _bs_vector_soa_length_f64(double *dest_ptr,
+                                      const double *x_ptr,
+                                      const double *y_ptr,
+                                      size_t num);
+static void _bs_vector_soa_transform_f64(double *x_dest_ptr,
+                                         double *y_dest_ptr,
+                                         const bs_affine_2f_t *affine_ptr,
+                                         const double *x_ptr,
+                                         const double *y_ptr,
+                                         size_t num);
+static void _bs_vector_soa_bounds_f64(const double *src_ptr,
+                                      size_t num,
+                                      double *min_ptr,
+                                      double *max_ptr);
+static void _bs_vector_soa_add_f32(float *dest_ptr,
+                                   const float *src1_ptr,
+                                   const float *src2_ptr,
+                                   size_t num);
+static void _bs_vector_soa_mul_f32(float *dest_ptr,
+                                   float scale,
+                                   const float *src_ptr,
+                                   size_t num);
+static void _bs_vector_soa_dot_f32(float *dest_ptr,
+                                   const float *x1_ptr,
+                                   const float *y1_ptr,
+                                   const float *x2_ptr,
+                                   const float *y2_ptr,
+                                   size_t num);
+static void _bs_vector_soa_length_f32(float *dest_ptr,
+                                      const float *x_ptr,
+                                      const float *y_ptr,
+                                      size_t num);
+static void _bs_vector_soa_transform_f32(float *x_dest_ptr,
+                                         float *y_dest_ptr,
+                                         const bs_affine_2f_t *affine_ptr,
+                                         const float *x_ptr,
+                                         const float *y_ptr,
+                                         size_t num);
+static void _bs_vector_soa_bounds_f32(const float *src_ptr,
+                                      size_t num,
+                                      float *min_ptr,
+                                      float *max_ptr);
+
+#if defined(BS_VECTOR_X86)
+static void _bs_vector_soa_add_f64_avx(double *dest_ptr,
+                                       const double *src1_ptr,
+                                       const double *src2_ptr,
+                                       size_t num)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_mul_f64_avx(double *dest_ptr,
+                                       double scale,
+                                       const double *src_ptr,
+                                       size_t num)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_dot_f64_avx(double *dest_ptr,
+                                       const double *x1_ptr,
+                                       const double *y1_ptr,
+                                       const double *x2_ptr,
+                                       const double *y2_ptr,
+                                       size_t num)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_length_f64_avx(double *dest_ptr,
+                                          const double *x_ptr,
+                                          const double *y_ptr,
+                                          size_t num)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_transform_f64_avx(
+    double *x_dest_ptr,
+    double *y_dest_ptr,
+    const bs_affine_2f_t *affine_ptr,
+    const double *x_ptr,
+    const double *y_ptr,
+    size_t num)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_bounds_f64_avx(const double *src_ptr,
+                                          size_t num,
+                                          double *min_ptr,
+                                          double *max_ptr)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_add_f32_avx(float *dest_ptr,
+                                       const float *src1_ptr,
+                                       const float *src2_ptr,
+                                       size_t num)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_mul_f32_avx(float *dest_ptr,
+                                       float scale,
+                                       const float *src_ptr,
+                                       size_t num)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_dot_f32_avx(float *dest_ptr,
+                                       const float *x1_ptr,
+                                       const float *y1_ptr,
+                                       const float *x2_ptr,
+                                       const float *y2_ptr,
+                                       size_t num)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_length_f32_avx(float *dest_ptr,
+                                          const float *x_ptr,
+                                          const float *y_ptr,
+                                          size_t num)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_transform_f32_avx(
+    float *x_dest_ptr,
+    float *y_dest_ptr,
+    const bs_affine_2f_t *affine_ptr,
+    const float *x_ptr,
+    const float *y_ptr,
+    size_t num)
+    __attribute__((target("avx")));
+static void _bs_vector_soa_bounds_f32_avx(const float *src_ptr,
+                                          size_t num,
+                                          float *min_ptr,
+                                          float *max_ptr)
+    __attribute__((target("avx")));
+#endif  // BS_VECTOR_X86
+
+/**
+ * Structure-of-arrays kernels using the architecture's baseline: SSE2 on
+ * amd64, NEON on aarch64, and scalar code elsewhere.
+ */
+static const bs_vector_soa_kernels_t _bs_vector_soa_baseline = {
+    .add_f64 = _bs_vector_soa_add_f64,
+    .mul_f64 = _bs_vector_soa_mul_f64,
+    .dot_f64 = _bs_vector_soa_dot_f64,
+    .length_f64 = _bs_vector_soa_length_f64,
+    .transform_f64 = _bs_vector_soa_transform_f64,
+    .bounds_f64 = _bs_vector_soa_bounds_f64,
+    .add_f32 = _bs_vector_soa_add_f32,
+    .mul_f32 = _bs_vector_soa_mul_f32,
+    .dot_f32 = _bs_vector_soa_dot_f32,
+    .length_f32 = _bs_vector_soa_length_f32,
+    .transform_f32 = _bs_vector_soa_transform_f32,
+    .bounds_f32 = _bs_vector_soa_bounds_f32
+};
+#if defined(BS_VECTOR_X86)
+/** Structure-of-arrays kernels for AVX. */
+static const bs_vector_soa_kernels_t _bs_vector_soa_avx = {
+    .add_f64 = _bs_vector_soa_add_f64_avx,
+    .mul_f64 = _bs_vector_soa_mul_f64_avx,
+    .dot_f64 = _bs_vector_soa_dot_f64_avx,
+    .length_f64 = _bs_vector_soa_length_f64_avx,
+    .transform_f64 = _bs_vector_soa_transform_f64_avx,
+    .bounds_f64 = _bs_vector_soa_bounds_f64_avx,
+    .add_f32 = _bs_vector_soa_add_f32_avx,
+    .mul_f32 = _bs_vector_soa_mul_f32_avx,
+    .dot_f32 = _bs_vector_soa_dot_f32_avx,
+    .length_f32 = _bs_vector_soa_length_f32_avx,
+    .transform_f32 = _bs_vector_soa_transform_f32_avx,
+    .bounds_f32 = _bs_vector_soa_bounds_f32_avx
+};
+#endif  // BS_VECTOR_X86
+
+/* == Exported methods ===================================================== */
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_add_2f_array(bs_vector_2f_t *dest_ptr,
+                         const bs_vector_2f_t *src1_ptr,
+                         const bs_vector_2f_t *src2_ptr,
+                         size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i < num; ++i) {
+        _mm_storeu_pd(&dest_ptr[i].x,
+                      _mm_add_pd(_mm_loadu_pd(&src1_ptr[i].x),
+                                 _mm_loadu_pd(&src2_ptr[i].x)));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i < num; ++i) {
+        vst1q_f64(&dest_ptr[i].x, vaddq_f64(vld1q_f64(&src1_ptr[i].x),
+                                            vld1q_f64(&src2_ptr[i].x)));
+    }
+#endif
+    for (; i < num; ++i) dest_ptr[i] = bs_vec_add_2f(src1_ptr[i], src2_ptr[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_mul_2f_array(bs_vector_2f_t *dest_ptr,
+                         double scale,
+                         const bs_vector_2f_t *src_ptr,
+                         size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128d s = _mm_set1_pd(scale);
+    for (; i < num; ++i) {
+        _mm_storeu_pd(&dest_ptr[i].x,
+                      _mm_mul_pd(s, _mm_loadu_pd(&src_ptr[i].x)));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i < num; ++i) {
+        vst1q_f64(&dest_ptr[i].x, vmulq_n_f64(vld1q_f64(&src_ptr[i].x), scale));
+    }
+#endif
+    for (; i < num; ++i) dest_ptr[i] = bs_vec_mul_2f(scale, src_ptr[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_dot_2f_array(double *dest_ptr,
+                         const bs_vector_2f_t *src1_ptr,
+                         const bs_vector_2f_t *src2_ptr,
+                         size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 2 <= num; i += 2) {
+        __m128d p0 = _mm_mul_pd(_mm_loadu_pd(&src1_ptr[i].x),
+                                _mm_loadu_pd(&src2_ptr[i].x));
+        __m128d p1 = _mm_mul_pd(_mm_loadu_pd(&src1_ptr[i + 1].x),
+                                _mm_loadu_pd(&src2_ptr[i + 1].x));
+        // Transposes to (x0, x1) and (y0, y1), for a vertical add.
+        _mm_storeu_pd(&dest_ptr[i], _mm_add_pd(_mm_unpacklo_pd(p0, p1),
+                                               _mm_unpackhi_pd(p0, p1)));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 2 <= num; i += 2) {
+        // De-interleaves into (x0, x1) and (y0, y1).
+        float64x2x2_t a = vld2q_f64(&src1_ptr[i].x);
+        float64x2x2_t b = vld2q_f64(&src2_ptr[i].x);
+        vst1q_f64(&dest_ptr[i], vaddq_f64(vmulq_f64(a.val[0], b.val[0]),
+                                          vmulq_f64(a.val[1], b.val[1])));
+    }
+#endif
+    for (; i < num; ++i) dest_ptr[i] = bs_vec_dot_2f(src1_ptr[i], src2_ptr[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_length_2f_array(double *dest_ptr,
+                            const bs_vector_2f_t *src_ptr,
+                            size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 2 <= num; i += 2) {
+        __m128d v0 = _mm_loadu_pd(&src_ptr[i].x);
+        __m128d v1 = _mm_loadu_pd(&src_ptr[i + 1].x);
+        v0 = _mm_mul_pd(v0, v0);
+        v1 = _mm_mul_pd(v1, v1);
+        _mm_storeu_pd(&dest_ptr[i], _mm_sqrt_pd(
+                          _mm_add_pd(_mm_unpacklo_pd(v0, v1),
+                                     _mm_unpackhi_pd(v0, v1))));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 2 <= num; i += 2) {
+        float64x2x2_t v = vld2q_f64(&src_ptr[i].x);
+        vst1q_f64(&dest_ptr[i], vsqrtq_f64(
+                      vaddq_f64(vmulq_f64(v.val[0], v.val[0]),
+                                vmulq_f64(v.val[1], v.val[1]))));
+    }
+#endif
+    for (; i < num; ++i) {
+        dest_ptr[i] = sqrt(bs_vec_dot_2f(src_ptr[i], src_ptr[i]));
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_transform_2f_array(bs_vector_2f_t *dest_ptr,
+                               const bs_affine_2f_t *affine_ptr,
+                               const bs_vector_2f_t *src_ptr,
+                               size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Columns of the matrix: (xx, yx) multiplies x, (xy, yy) multiplies y.
+    const __m128d cx = _mm_set_pd(affine_ptr->yx, affine_ptr->xx);
+    const __m128d cy = _mm_set_pd(affine_ptr->yy, affine_ptr->xy);
+    const __m128d c0 = _mm_set_pd(affine_ptr->y0, affine_ptr->x0);
+    for (; i < num; ++i) {
+        __m128d v = _mm_loadu_pd(&src_ptr[i].x);
+        __m128d r = _mm_add_pd(
+            _mm_mul_pd(cx, _mm_unpacklo_pd(v, v)),
+            _mm_mul_pd(cy, _mm_unpackhi_pd(v, v)));
+        _mm_storeu_pd(&dest_ptr[i].x, _mm_add_pd(r, c0));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 2 <= num; i += 2) {
+        float64x2x2_t v = vld2q_f64(&src_ptr[i].x);
+        float64x2x2_t r;
+        r.val[0] = vaddq_f64(
+            vaddq_f64(vmulq_n_f64(v.val[0], affine_ptr->xx),
+                      vmulq_n_f64(v.val[1], affine_ptr->xy)),
+            vdupq_n_f64(affine_ptr->x0));
+        r.val[1] = vaddq_f64(
+            vaddq_f64(vmulq_n_f64(v.val[0], affine_ptr->yx),
+                      vmulq_n_f64(v.val[1], affine_ptr->yy)),
+            vdupq_n_f64(affine_ptr->y0));
+        vst2q_f64(&dest_ptr[i].x, r);
+    }
+#endif
+    for (; i < num; ++i) {
+        dest_ptr[i] = bs_vec_transform_2f(affine_ptr, src_ptr[i]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_bounds_2f_array(const bs_vector_2f_t *src_ptr,
+                            size_t num,
+                            bs_vector_2f_t *min_ptr,
+                            bs_vector_2f_t *max_ptr)
+{
+    bs_vector_2f_t min = BS_VECTOR_2F(INFINITY, INFINITY);
+    bs_vector_2f_t max = BS_VECTOR_2F(-INFINITY, -INFINITY);
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Two accumulators each, to not serialize on the min/max latency.
+    __m128d vmin0 = _mm_loadu_pd(&min.x), vmax0 = _mm_loadu_pd(&max.x);
+    __m128d vmin1 = vmin0, vmax1 = vmax0;
+    for (; i + 2 <= num; i += 2) {
+        __m128d v0 = _mm_loadu_pd(&src_ptr[i].x);
+        __m128d v1 = _mm_loadu_pd(&src_ptr[i + 1].x);
+        vmin0 = _mm_min_pd(vmin0, v0);
+        vmax0 = _mm_max_pd(vmax0, v0);
+        vmin1 = _mm_min_pd(vmin1, v1);
+        vmax1 = _mm_max_pd(vmax1, v1);
+    }
+    _mm_storeu_pd(&min.x, _mm_min_pd(vmin0, vmin1));
+    _mm_storeu_pd(&max.x, _mm_max_pd(vmax0, vmax1));
+#elif defined(BS_VECTOR_NEON)
+    float64x2_t vmin_x = vdupq_n_f64(min.x), vmin_y = vmin_x;
+    float64x2_t vmax_x = vdupq_n_f64(max.x), vmax_y = vmax_x;
+    for (; i + 2 <= num; i += 2) {
+        float64x2x2_t v = vld2q_f64(&src_ptr[i].x);
+        vmin_x = vminq_f64(vmin_x, v.val[0]);
+        vmin_y = vminq_f64(vmin_y, v.val[1]);
+        vmax_x = vmaxq_f64(vmax_x, v.val[0]);
+        vmax_y = vmaxq_f64(vmax_y, v.val[1]);
+    }
+    min = BS_VECTOR_2F(vminvq_f64(vmin_x), vminvq_f64(vmin_y));
+    max = BS_VECTOR_2F(vmaxvq_f64(vmax_x), vmaxvq_f64(vmax_y));
+#endif
+    for (; i < num; ++i) {
+        min.x = BS_MIN(min.x, src_ptr[i].x);
+        min.y = BS_MIN(min.y, src_ptr[i].y);
+        max.x = BS_MAX(max.x, src_ptr[i].x);
+        max.y = BS_MAX(max.y, src_ptr[i].y);
+    }
+    *min_ptr = min;
+    *max_ptr = max;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_add_2f_soa(bs_vector_2f_soa_t dest,
+                       bs_vector_2f_soa_t src1,
+                       bs_vector_2f_soa_t src2,
+                       size_t num)
+{
+    const bs_vector_soa_kernels_t *kernels_ptr = _bs_vector_soa_dispatch();
+    kernels_ptr->add_f64(dest.x_ptr, src1.x_ptr, src2.x_ptr, num);
+    kernels_ptr->add_f64(dest.y_ptr, src1.y_ptr, src2.y_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_mul_2f_soa(bs_vector_2f_soa_t dest,
+                       double scale,
+                       bs_vector_2f_soa_t src,
+                       size_t num)
+{
+    const bs_vector_soa_kernels_t *kernels_ptr = _bs_vector_soa_dispatch();
+    kernels_ptr->mul_f64(dest.x_ptr, scale, src.x_ptr, num);
+    kernels_ptr->mul_f64(dest.y_ptr, scale, src.y_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_dot_2f_soa(double *dest_ptr,
+                       bs_vector_2f_soa_t src1,
+                       bs_vector_2f_soa_t src2,
+                       size_t num)
+{
+    _bs_vector_soa_dispatch()->dot_f64(
+        dest_ptr, src1.x_ptr, src1.y_ptr, src2.x_ptr, src2.y_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_length_2f_soa(double *dest_ptr,
+                          bs_vector_2f_soa_t src,
+                          size_t num)
+{
+    _bs_vector_soa_dispatch()->length_f64(
+        dest_ptr, src.x_ptr, src.y_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_transform_2f_soa(bs_vector_2f_soa_t dest,
+                             const bs_affine_2f_t *affine_ptr,
+                             bs_vector_2f_soa_t src,
+                             size_t num)
+{
+    _bs_vector_soa_dispatch()->transform_f64(
+        dest.x_ptr, dest.y_ptr, affine_ptr, src.x_ptr, src.y_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_bounds_2f_soa(bs_vector_2f_soa_t src,
+                          size_t num,
+                          bs_vector_2f_t *min_ptr,
+                          bs_vector_2f_t *max_ptr)
+{
+    const bs_vector_soa_kernels_t *kernels_ptr = _bs_vector_soa_dispatch();
+    kernels_ptr->bounds_f64(src.x_ptr, num, &min_ptr->x, &max_ptr->x);
+    kernels_ptr->bounds_f64(src.y_ptr, num, &min_ptr->y, &max_ptr->y);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_add_2f32_array(bs_vector_2f32_t *dest_ptr,
+                           const bs_vector_2f32_t *src1_ptr,
+                           const bs_vector_2f32_t *src2_ptr,
+                           size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 2 <= num; i += 2) {
+        _mm_storeu_ps(&dest_ptr[i].x,
+                      _mm_add_ps(_mm_loadu_ps(&src1_ptr[i].x),
+                                 _mm_loadu_ps(&src2_ptr[i].x)));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 2 <= num; i += 2) {
+        vst1q_f32(&dest_ptr[i].x, vaddq_f32(vld1q_f32(&src1_ptr[i].x),
+                                            vld1q_f32(&src2_ptr[i].x)));
+    }
+#endif
+    for (; i < num; ++i) {
+        dest_ptr[i] = BS_VECTOR_2F32(src1_ptr[i].x + src2_ptr[i].x,
+                                     src1_ptr[i].y + src2_ptr[i].y);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_mul_2f32_array(bs_vector_2f32_t *dest_ptr,
+                           float scale,
+                           const bs_vector_2f32_t *src_ptr,
+                           size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 s = _mm_set1_ps(scale);
+    for (; i + 2 <= num; i += 2) {
+        _mm_storeu_ps(&dest_ptr[i].x,
+                      _mm_mul_ps(s, _mm_loadu_ps(&src_ptr[i].x)));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 2 <= num; i += 2) {
+        vst1q_f32(&dest_ptr[i].x, vmulq_n_f32(vld1q_f32(&src_ptr[i].x), scale));
+    }
+#endif
+    for (; i < num; ++i) {
+        dest_ptr[i] = BS_VECTOR_2F32(scale * src_ptr[i].x,
+                                     scale * src_ptr[i].y);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_dot_2f32_array(float *dest_ptr,
+                           const bs_vector_2f32_t *src1_ptr,
+                           const bs_vector_2f32_t *src2_ptr,
+                           size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= num; i += 4) {
+        __m128 p0 = _mm_mul_ps(_mm_loadu_ps(&src1_ptr[i].x),
+                               _mm_loadu_ps(&src2_ptr[i].x));
+        __m128 p1 = _mm_mul_ps(_mm_loadu_ps(&src1_ptr[i + 2].x),
+                               _mm_loadu_ps(&src2_ptr[i + 2].x));
+        // Gathers the x and the y products of the 4 vectors.
+        __m128 px = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 py = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(&dest_ptr[i], _mm_add_ps(px, py));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 4 <= num; i += 4) {
+        float32x4x2_t a = vld2q_f32(&src1_ptr[i].x);
+        float32x4x2_t b = vld2q_f32(&src2_ptr[i].x);
+        vst1q_f32(&dest_ptr[i], vaddq_f32(vmulq_f32(a.val[0], b.val[0]),
+                                          vmulq_f32(a.val[1], b.val[1])));
+    }
+#endif
+    for (; i < num; ++i) {
+        dest_ptr[i] = (src1_ptr[i].x * src2_ptr[i].x +
+                       src1_ptr[i].y * src2_ptr[i].y);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_length_2f32_array(float *dest_ptr,
+                              const bs_vector_2f32_t *src_ptr,
+                              size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= num; i += 4) {
+        __m128 v0 = _mm_loadu_ps(&src_ptr[i].x);
+        __m128 v1 = _mm_loadu_ps(&src_ptr[i + 2].x);
+        v0 = _mm_mul_ps(v0, v0);
+        v1 = _mm_mul_ps(v1, v1);
+        __m128 px = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 py = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(&dest_ptr[i], _mm_sqrt_ps(_mm_add_ps(px, py)));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 4 <= num; i += 4) {
+        float32x4x2_t v = vld2q_f32(&src_ptr[i].x);
+        vst1q_f32(&dest_ptr[i], vsqrtq_f32(
+                      vaddq_f32(vmulq_f32(v.val[0], v.val[0]),
+                                vmulq_f32(v.val[1], v.val[1]))));
+    }
+#endif
+    for (; i < num; ++i) {
+        dest_ptr[i] = sqrtf(src_ptr[i].x * src_ptr[i].x +
+                            src_ptr[i].y * src_ptr[i].y);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_transform_2f32_array(bs_vector_2f32_t *dest_ptr,
+                                 const bs_affine_2f_t *affine_ptr,
+                                 const bs_vector_2f32_t *src_ptr,
+                                 size_t num)
+{
+    const float xx = affine_ptr->xx, yx = affine_ptr->yx;
+    const float xy = affine_ptr->xy, yy = affine_ptr->yy;
+    const float x0 = affine_ptr->x0, y0 = affine_ptr->y0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 cx = _mm_set_ps(yx, xx, yx, xx);
+    const __m128 cy = _mm_set_ps(yy, xy, yy, xy);
+    const __m128 c0 = _mm_set_ps(y0, x0, y0, x0);
+    for (; i + 2 <= num; i += 2) {
+        __m128 v = _mm_loadu_ps(&src_ptr[i].x);
+        // Broadcasts x and y within each of the 2 vectors.
+        __m128 vx = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 vy = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 r = _mm_add_ps(_mm_mul_ps(cx, vx), _mm_mul_ps(cy, vy));
+        _mm_storeu_ps(&dest_ptr[i].x, _mm_add_ps(r, c0));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 4 <= num; i += 4) {
+        float32x4x2_t v = vld2q_f32(&src_ptr[i].x);
+        float32x4x2_t r;
+        r.val[0] = vaddq_f32(vaddq_f32(vmulq_n_f32(v.val[0], xx),
+                                       vmulq_n_f32(v.val[1], xy)),
+                             vdupq_n_f32(x0));
+        r.val[1] = vaddq_f32(vaddq_f32(vmulq_n_f32(v.val[0], yx),
+                                       vmulq_n_f32(v.val[1], yy)),
+                             vdupq_n_f32(y0));
+        vst2q_f32(&dest_ptr[i].x, r);
+    }
+#endif
+    for (; i < num; ++i) {
+        bs_vector_2f32_t v = src_ptr[i];
+        dest_ptr[i] = BS_VECTOR_2F32(xx * v.x + xy * v.y + x0,
+                                     yx * v.x + yy * v.y + y0);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_bounds_2f32_array(const bs_vector_2f32_t *src_ptr,
+                              size_t num,
+                              bs_vector_2f32_t *min_ptr,
+                              bs_vector_2f32_t *max_ptr)
+{
+    bs_vector_2f32_t min = BS_VECTOR_2F32(INFINITY, INFINITY);
+    bs_vector_2f32_t max = BS_VECTOR_2F32(-INFINITY, -INFINITY);
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128 vmin = _mm_set1_ps(INFINITY), vmax = _mm_set1_ps(-INFINITY);
+    for (; i + 2 <= num; i += 2) {
+        __m128 v = _mm_loadu_ps(&src_ptr[i].x);
+        vmin = _mm_min_ps(vmin, v);
+        vmax = _mm_max_ps(vmax, v);
+    }
+    // Folds the 2 vectors' lanes onto the first.
+    vmin = _mm_min_ps(vmin, _mm_movehl_ps(vmin, vmin));
+    vmax = _mm_max_ps(vmax, _mm_movehl_ps(vmax, vmax));
+    _mm_storel_pi((__m64*)&min.x, vmin);
+    _mm_storel_pi((__m64*)&max.x, vmax);
+#elif defined(BS_VECTOR_NEON)
+    float32x4_t vmin_x = vdupq_n_f32(INFINITY), vmin_y = vmin_x;
+    float32x4_t vmax_x = vdupq_n_f32(-INFINITY), vmax_y = vmax_x;
+    for (; i + 4 <= num; i += 4) {
+        float32x4x2_t v = vld2q_f32(&src_ptr[i].x);
+        vmin_x = vminq_f32(vmin_x, v.val[0]);
+        vmin_y = vminq_f32(vmin_y, v.val[1]);
+        vmax_x = vmaxq_f32(vmax_x, v.val[0]);
+        vmax_y = vmaxq_f32(vmax_y, v.val[1]);
+    }
+    min = BS_VECTOR_2F32(vminvq_f32(vmin_x), vminvq_f32(vmin_y));
+    max = BS_VECTOR_2F32(vmaxvq_f32(vmax_x), vmaxvq_f32(vmax_y));
+#endif
+    for (; i < num; ++i) {
+        min.x = BS_MIN(min.x, src_ptr[i].x);
+        min.y = BS_MIN(min.y, src_ptr[i].y);
+        max.x = BS_MAX(max.x, src_ptr[i].x);
+        max.y = BS_MAX(max.y, src_ptr[i].y);
+    }
+    *min_ptr = min;
+    *max_ptr = max;
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_add_2f32_soa(bs_vector_2f32_soa_t dest,
+                         bs_vector_2f32_soa_t src1,
+                         bs_vector_2f32_soa_t src2,
+                         size_t num)
+{
+    const bs_vector_soa_kernels_t *kernels_ptr = _bs_vector_soa_dispatch();
+    kernels_ptr->add_f32(dest.x_ptr, src1.x_ptr, src2.x_ptr, num);
+    kernels_ptr->add_f32(dest.y_ptr, src1.y_ptr, src2.y_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_mul_2f32_soa(bs_vector_2f32_soa_t dest,
+                         float scale,
+                         bs_vector_2f32_soa_t src,
+                         size_t num)
+{
+    const bs_vector_soa_kernels_t *kernels_ptr = _bs_vector_soa_dispatch();
+    kernels_ptr->mul_f32(dest.x_ptr, scale, src.x_ptr, num);
+    kernels_ptr->mul_f32(dest.y_ptr, scale, src.y_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_dot_2f32_soa(float *dest_ptr,
+                         bs_vector_2f32_soa_t src1,
+                         bs_vector_2f32_soa_t src2,
+                         size_t num)
+{
+    _bs_vector_soa_dispatch()->dot_f32(
+        dest_ptr, src1.x_ptr, src1.y_ptr, src2.x_ptr, src2.y_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_length_2f32_soa(float *dest_ptr,
+                            bs_vector_2f32_soa_t src,
+                            size_t num)
+{
+    _bs_vector_soa_dispatch()->length_f32(
+        dest_ptr, src.x_ptr, src.y_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_transform_2f32_soa(bs_vector_2f32_soa_t dest,
+                               const bs_affine_2f_t *affine_ptr,
+                               bs_vector_2f32_soa_t src,
+                               size_t num)
+{
+    _bs_vector_soa_dispatch()->transform_f32(
+        dest.x_ptr, dest.y_ptr, affine_ptr, src.x_ptr, src.y_ptr, num);
+}
+
+/* ------------------------------------------------------------------------- */
+void bs_vec_bounds_2f32_soa(bs_vector_2f32_soa_t src,
+                            size_t num,
+                            bs_vector_2f32_t *min_ptr,
+                            bs_vector_2f32_t *max_ptr)
+{
+    const bs_vector_soa_kernels_t *kernels_ptr = _bs_vector_soa_dispatch();
+    kernels_ptr->bounds_f32(src.x_ptr, num, &min_ptr->x, &max_ptr->x);
+    kernels_ptr->bounds_f32(src.y_ptr, num, &min_ptr->y, &max_ptr->y);
+}
+
+/* == Local (static) methods =============================================== */
+
+/* ------------------------------------------------------------------------- */
+/** Returns the fastest structure-of-arrays kernels supported by the CPU. */
+const bs_vector_soa_kernels_t *_bs_vector_soa_dispatch(void)
+{
+#if defined(BS_VECTOR_X86)
+    if (__builtin_cpu_supports("avx")) return &_bs_vector_soa_avx;
+#endif
+    return &_bs_vector_soa_baseline;
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_add_f64(double *dest_ptr,
+                            const double *src1_ptr,
+                            const double *src2_ptr,
+                            size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 2 <= num; i += 2) {
+        _mm_storeu_pd(&dest_ptr[i], _mm_add_pd(_mm_loadu_pd(&src1_ptr[i]),
+                                               _mm_loadu_pd(&src2_ptr[i])));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 2 <= num; i += 2) {
+        vst1q_f64(&dest_ptr[i], vaddq_f64(vld1q_f64(&src1_ptr[i]),
+                                          vld1q_f64(&src2_ptr[i])));
+    }
+#endif
+    for (; i < num; ++i) dest_ptr[i] = src1_ptr[i] + src2_ptr[i];
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_mul_f64(double *dest_ptr,
+                            double scale,
+                            const double *src_ptr,
+                            size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128d s = _mm_set1_pd(scale);
+    for (; i + 2 <= num; i += 2) {
+        _mm_storeu_pd(&dest_ptr[i], _mm_mul_pd(s, _mm_loadu_pd(&src_ptr[i])));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 2 <= num; i += 2) {
+        vst1q_f64(&dest_ptr[i], vmulq_n_f64(vld1q_f64(&src_ptr[i]), scale));
+    }
+#endif
+    for (; i < num; ++i) dest_ptr[i] = scale * src_ptr[i];
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_dot_f64(double *dest_ptr,
+                            const double *x1_ptr,
+                            const double *y1_ptr,
+                            const double *x2_ptr,
+                            const double *y2_ptr,
+                            size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 2 <= num; i += 2) {
+        _mm_storeu_pd(&dest_ptr[i], _mm_add_pd(
+                          _mm_mul_pd(_mm_loadu_pd(&x1_ptr[i]),
+                                     _mm_loadu_pd(&x2_ptr[i])),
+                          _mm_mul_pd(_mm_loadu_pd(&y1_ptr[i]),
+                                     _mm_loadu_pd(&y2_ptr[i]))));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 2 <= num; i += 2) {
+        vst1q_f64(&dest_ptr[i], vaddq_f64(
+                      vmulq_f64(vld1q_f64(&x1_ptr[i]), vld1q_f64(&x2_ptr[i])),
+                      vmulq_f64(vld1q_f64(&y1_ptr[i]),
+                                vld1q_f64(&y2_ptr[i]))));
+    }
+#endif
+    for (; i < num; ++i) {
+        dest_ptr[i] = x1_ptr[i] * x2_ptr[i] + y1_ptr[i] * y2_ptr[i];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_length_f64(double *dest_ptr,
+                               const double *x_ptr,
+                               const double *y_ptr,
+                               size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 2 <= num; i += 2) {
+        __m128d x = _mm_loadu_pd(&x_ptr[i]), y = _mm_loadu_pd(&y_ptr[i]);
+        _mm_storeu_pd(&dest_ptr[i], _mm_sqrt_pd(
+                          _mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y))));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 2 <= num; i += 2) {
+        float64x2_t x = vld1q_f64(&x_ptr[i]), y = vld1q_f64(&y_ptr[i]);
+        vst1q_f64(&dest_ptr[i], vsqrtq_f64(
+                      vaddq_f64(vmulq_f64(x, x), vmulq_f64(y, y))));
+    }
+#endif
+    for (; i < num; ++i) {
+        dest_ptr[i] = sqrt(x_ptr[i] * x_ptr[i] + y_ptr[i] * y_ptr[i]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_transform_f64(double *x_dest_ptr,
+                                  double *y_dest_ptr,
+                                  const bs_affine_2f_t *affine_ptr,
+                                  const double *x_ptr,
+                                  const double *y_ptr,
+                                  size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128d xx = _mm_set1_pd(affine_ptr->xx);
+    const __m128d yx = _mm_set1_pd(affine_ptr->yx);
+    const __m128d xy = _mm_set1_pd(affine_ptr->xy);
+    const __m128d yy = _mm_set1_pd(affine_ptr->yy);
+    const __m128d x0 = _mm_set1_pd(affine_ptr->x0);
+    const __m128d y0 = _mm_set1_pd(affine_ptr->y0);
+    for (; i + 2 <= num; i += 2) {
+        __m128d x = _mm_loadu_pd(&x_ptr[i]), y = _mm_loadu_pd(&y_ptr[i]);
+        __m128d rx = _mm_add_pd(_mm_mul_pd(xx, x), _mm_mul_pd(xy, y));
+        __m128d ry = _mm_add_pd(_mm_mul_pd(yx, x), _mm_mul_pd(yy, y));
+        _mm_storeu_pd(&x_dest_ptr[i], _mm_add_pd(rx, x0));
+        _mm_storeu_pd(&y_dest_ptr[i], _mm_add_pd(ry, y0));
+    }
+#elif defined(BS_VECTOR_NEON)
+    const float64x2_t x0 = vdupq_n_f64(affine_ptr->x0);
+    const float64x2_t y0 = vdupq_n_f64(affine_ptr->y0);
+    for (; i + 2 <= num; i += 2) {
+        float64x2_t x = vld1q_f64(&x_ptr[i]), y = vld1q_f64(&y_ptr[i]);
+        float64x2_t rx = vaddq_f64(vmulq_n_f64(x, affine_ptr->xx),
+                                   vmulq_n_f64(y, affine_ptr->xy));
+        float64x2_t ry = vaddq_f64(vmulq_n_f64(x, affine_ptr->yx),
+                                   vmulq_n_f64(y, affine_ptr->yy));
+        vst1q_f64(&x_dest_ptr[i], vaddq_f64(rx, x0));
+        vst1q_f64(&y_dest_ptr[i], vaddq_f64(ry, y0));
+    }
+#endif
+    for (; i < num; ++i) {
+        bs_vector_2f_t v = bs_vec_transform_2f(
+            affine_ptr, BS_VECTOR_2F(x_ptr[i], y_ptr[i]));
+        x_dest_ptr[i] = v.x;
+        y_dest_ptr[i] = v.y;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_bounds_f64(const double *src_ptr,
+                               size_t num,
+                               double *min_ptr,
+                               double *max_ptr)
+{
+    double min = INFINITY, max = -INFINITY;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128d vmin = _mm_set1_pd(min), vmax = _mm_set1_pd(max);
+    for (; i + 2 <= num; i += 2) {
+        __m128d v = _mm_loadu_pd(&src_ptr[i]);
+        vmin = _mm_min_pd(vmin, v);
+        vmax = _mm_max_pd(vmax, v);
+    }
+    min = _mm_cvtsd_f64(_mm_min_sd(vmin, _mm_unpackhi_pd(vmin, vmin)));
+    max = _mm_cvtsd_f64(_mm_max_sd(vmax, _mm_unpackhi_pd(vmax, vmax)));
+#elif defined(BS_VECTOR_NEON)
+    float64x2_t vmin = vdupq_n_f64(min), vmax = vdupq_n_f64(max);
+    for (; i + 2 <= num; i += 2) {
+        float64x2_t v = vld1q_f64(&src_ptr[i]);
+        vmin = vminq_f64(vmin, v);
+        vmax = vmaxq_f64(vmax, v);
+    }
+    min = vminvq_f64(vmin);
+    max = vmaxvq_f64(vmax);
+#endif
+    for (; i < num; ++i) {
+        min = BS_MIN(min, src_ptr[i]);
+        max = BS_MAX(max, src_ptr[i]);
+    }
+    *min_ptr = min;
+    *max_ptr = max;
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_add_f32(float *dest_ptr,
+                            const float *src1_ptr,
+                            const float *src2_ptr,
+                            size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= num; i += 4) {
+        _mm_storeu_ps(&dest_ptr[i], _mm_add_ps(_mm_loadu_ps(&src1_ptr[i]),
+                                               _mm_loadu_ps(&src2_ptr[i])));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 4 <= num; i += 4) {
+        vst1q_f32(&dest_ptr[i], vaddq_f32(vld1q_f32(&src1_ptr[i]),
+                                          vld1q_f32(&src2_ptr[i])));
+    }
+#endif
+    for (; i < num; ++i) dest_ptr[i] = src1_ptr[i] + src2_ptr[i];
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_mul_f32(float *dest_ptr,
+                            float scale,
+                            const float *src_ptr,
+                            size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 s = _mm_set1_ps(scale);
+    for (; i + 4 <= num; i += 4) {
+        _mm_storeu_ps(&dest_ptr[i], _mm_mul_ps(s, _mm_loadu_ps(&src_ptr[i])));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 4 <= num; i += 4) {
+        vst1q_f32(&dest_ptr[i], vmulq_n_f32(vld1q_f32(&src_ptr[i]), scale));
+    }
+#endif
+    for (; i < num; ++i) dest_ptr[i] = scale * src_ptr[i];
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_dot_f32(float *dest_ptr,
+                            const float *x1_ptr,
+                            const float *y1_ptr,
+                            const float *x2_ptr,
+                            const float *y2_ptr,
+                            size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= num; i += 4) {
+        _mm_storeu_ps(&dest_ptr[i], _mm_add_ps(
+                          _mm_mul_ps(_mm_loadu_ps(&x1_ptr[i]),
+                                     _mm_loadu_ps(&x2_ptr[i])),
+                          _mm_mul_ps(_mm_loadu_ps(&y1_ptr[i]),
+                                     _mm_loadu_ps(&y2_ptr[i]))));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 4 <= num; i += 4) {
+        vst1q_f32(&dest_ptr[i], vaddq_f32(
+                      vmulq_f32(vld1q_f32(&x1_ptr[i]), vld1q_f32(&x2_ptr[i])),
+                      vmulq_f32(vld1q_f32(&y1_ptr[i]),
+                                vld1q_f32(&y2_ptr[i]))));
+    }
+#endif
+    for (; i < num; ++i) {
+        dest_ptr[i] = x1_ptr[i] * x2_ptr[i] + y1_ptr[i] * y2_ptr[i];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_length_f32(float *dest_ptr,
+                               const float *x_ptr,
+                               const float *y_ptr,
+                               size_t num)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= num; i += 4) {
+        __m128 x = _mm_loadu_ps(&x_ptr[i]), y = _mm_loadu_ps(&y_ptr[i]);
+        _mm_storeu_ps(&dest_ptr[i], _mm_sqrt_ps(
+                          _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 4 <= num; i += 4) {
+        float32x4_t x = vld1q_f32(&x_ptr[i]), y = vld1q_f32(&y_ptr[i]);
+        vst1q_f32(&dest_ptr[i], vsqrtq_f32(
+                      vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y))));
+    }
+#endif
+    for (; i < num; ++i) {
+        dest_ptr[i] = sqrtf(x_ptr[i] * x_ptr[i] + y_ptr[i] * y_ptr[i]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_transform_f32(float *x_dest_ptr,
+                                  float *y_dest_ptr,
+                                  const bs_affine_2f_t *affine_ptr,
+                                  const float *x_ptr,
+                                  const float *y_ptr,
+                                  size_t num)
+{
+    const float xx = affine_ptr->xx, yx = affine_ptr->yx;
+    const float xy = affine_ptr->xy, yy = affine_ptr->yy;
+    const float x0 = affine_ptr->x0, y0 = affine_ptr->y0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= num; i += 4) {
+        __m128 x = _mm_loadu_ps(&x_ptr[i]), y = _mm_loadu_ps(&y_ptr[i]);
+        __m128 rx = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(xx), x),
+                               _mm_mul_ps(_mm_set1_ps(xy), y));
+        __m128 ry = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(yx), x),
+                               _mm_mul_ps(_mm_set1_ps(yy), y));
+        _mm_storeu_ps(&x_dest_ptr[i], _mm_add_ps(rx, _mm_set1_ps(x0)));
+        _mm_storeu_ps(&y_dest_ptr[i], _mm_add_ps(ry, _mm_set1_ps(y0)));
+    }
+#elif defined(BS_VECTOR_NEON)
+    for (; i + 4 <= num; i += 4) {
+        float32x4_t x = vld1q_f32(&x_ptr[i]), y = vld1q_f32(&y_ptr[i]);
+        float32x4_t rx = vaddq_f32(vmulq_n_f32(x, xx), vmulq_n_f32(y, xy));
+        float32x4_t ry = vaddq_f32(vmulq_n_f32(x, yx), vmulq_n_f32(y, yy));
+        vst1q_f32(&x_dest_ptr[i], vaddq_f32(rx, vdupq_n_f32(x0)));
+        vst1q_f32(&y_dest_ptr[i], vaddq_f32(ry, vdupq_n_f32(y0)));
+    }
+#endif
+    for (; i < num; ++i) {
+        float x = x_ptr[i], y = y_ptr[i];
+        x_dest_ptr[i] = xx * x + xy * y + x0;
+        y_dest_ptr[i] = yx * x + yy * y + y0;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_bounds_f32(const float *src_ptr,
+                               size_t num,
+                               float *min_ptr,
+                               float *max_ptr)
+{
+    float min = INFINITY, max = -INFINITY;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128 vmin = _mm_set1_ps(min), vmax = _mm_set1_ps(max);
+    for (; i + 4 <= num; i += 4) {
+        __m128 v = _mm_loadu_ps(&src_ptr[i]);
+        vmin = _mm_min_ps(vmin, v);
+        vmax = _mm_max_ps(vmax, v);
+    }
+    float lanes_min[4], lanes_max[4];
+    _mm_storeu_ps(lanes_min, vmin);
+    _mm_storeu_ps(lanes_max, vmax);
+    for (int l = 0; l < 4; ++l) {
+        min = BS_MIN(min, lanes_min[l]);
+        max = BS_MAX(max, lanes_max[l]);
+    }
+#elif defined(BS_VECTOR_NEON)
+    float32x4_t vmin = vdupq_n_f32(min), vmax = vdupq_n_f32(max);
+    for (; i + 4 <= num; i += 4) {
+        float32x4_t v = vld1q_f32(&src_ptr[i]);
+        vmin = vminq_f32(vmin, v);
+        vmax = vmaxq_f32(vmax, v);
+    }
+    min = vminvq_f32(vmin);
+    max = vmaxvq_f32(vmax);
+#endif
+    for (; i < num; ++i) {
+        min = BS_MIN(min, src_ptr[i]);
+        max = BS_MAX(max, src_ptr[i]);
+    }
+    *min_ptr = min;
+    *max_ptr = max;
+}
+
+#if defined(BS_VECTOR_X86)
+/* ------------------------------------------------------------------------- */
+/** AVX: 4 doubles per register. The remainder goes to the baseline. */
+void _bs_vector_soa_add_f64_avx(double *dest_ptr,
+                                const double *src1_ptr,
+                                const double *src2_ptr,
+                                size_t num)
+{
+    size_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        _mm256_storeu_pd(&dest_ptr[i],
+                         _mm256_add_pd(_mm256_loadu_pd(&src1_ptr[i]),
+                                       _mm256_loadu_pd(&src2_ptr[i])));
+    }
+    _bs_vector_soa_add_f64(dest_ptr + i, src1_ptr + i, src2_ptr + i, num - i);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_mul_f64_avx(double *dest_ptr,
+                                double scale,
+                                const double *src_ptr,
+                                size_t num)
+{
+    const __m256d s = _mm256_set1_pd(scale);
+    size_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        _mm256_storeu_pd(&dest_ptr[i],
+                         _mm256_mul_pd(s, _mm256_loadu_pd(&src_ptr[i])));
+    }
+    _bs_vector_soa_mul_f64(dest_ptr + i, scale, src_ptr + i, num - i);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_dot_f64_avx(double *dest_ptr,
+                                const double *x1_ptr,
+                                const double *y1_ptr,
+                                const double *x2_ptr,
+                                const double *y2_ptr,
+                                size_t num)
+{
+    size_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        _mm256_storeu_pd(&dest_ptr[i], _mm256_add_pd(
+                             _mm256_mul_pd(_mm256_loadu_pd(&x1_ptr[i]),
+                                           _mm256_loadu_pd(&x2_ptr[i])),
+                             _mm256_mul_pd(_mm256_loadu_pd(&y1_ptr[i]),
+                                           _mm256_loadu_pd(&y2_ptr[i]))));
+    }
+    _bs_vector_soa_dot_f64(dest_ptr + i, x1_ptr + i, y1_ptr + i,
+                           x2_ptr + i, y2_ptr + i, num - i);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_length_f64_avx(double *dest_ptr,
+                                   const double *x_ptr,
+                                   const double *y_ptr,
+                                   size_t num)
+{
+    size_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        __m256d x = _mm256_loadu_pd(&x_ptr[i]);
+        __m256d y = _mm256_loadu_pd(&y_ptr[i]);
+        _mm256_storeu_pd(&dest_ptr[i], _mm256_sqrt_pd(
+                             _mm256_add_pd(_mm256_mul_pd(x, x),
+                                           _mm256_mul_pd(y, y))));
+    }
+    _bs_vector_soa_length_f64(dest_ptr + i, x_ptr + i, y_ptr + i, num - i);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_transform_f64_avx(double *x_dest_ptr,
+                                      double *y_dest_ptr,
+                                      const bs_affine_2f_t *affine_ptr,
+                                      const double *x_ptr,
+                                      const double *y_ptr,
+                                      size_t num)
+{
+    const __m256d xx = _mm256_set1_pd(affine_ptr->xx);
+    const __m256d yx = _mm256_set1_pd(affine_ptr->yx);
+    const __m256d xy = _mm256_set1_pd(affine_ptr->xy);
+    const __m256d yy = _mm256_set1_pd(affine_ptr->yy);
+    const __m256d x0 = _mm256_set1_pd(affine_ptr->x0);
+    const __m256d y0 = _mm256_set1_pd(affine_ptr->y0);
+    size_t i = 0;
+    for (; i + 4 <= num; i += 4) {
+        __m256d x = _mm256_loadu_pd(&x_ptr[i]);
+        __m256d y = _mm256_loadu_pd(&y_ptr[i]);
+        __m256d rx = _mm256_add_pd(_mm256_mul_pd(xx, x), _mm256_mul_pd(xy, y));
+        __m256d ry = _mm256_add_pd(_mm256_mul_pd(yx, x), _mm256_mul_pd(yy, y));
+        _mm256_storeu_pd(&x_dest_ptr[i], _mm256_add_pd(rx, x0));
+        _mm256_storeu_pd(&y_dest_ptr[i], _mm256_add_pd(ry, y0));
+    }
+    _bs_vector_soa_transform_f64(x_dest_ptr + i, y_dest_ptr + i, affine_ptr,
+                                 x_ptr + i, y_ptr + i, num - i);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_bounds_f64_avx(const double *src_ptr,
+                                   size_t num,
+                                   double *min_ptr,
+                                   double *max_ptr)
+{
+    __m256d vmin = _mm256_set1_pd(INFINITY), vmax = _mm256_set1_pd(-INFINITY);
+    __m256d vmin1 = vmin, vmax1 = vmax;
+    size_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        __m256d v0 = _mm256_loadu_pd(&src_ptr[i]);
+        __m256d v1 = _mm256_loadu_pd(&src_ptr[i + 4]);
+        vmin = _mm256_min_pd(vmin, v0);
+        vmax = _mm256_max_pd(vmax, v0);
+        vmin1 = _mm256_min_pd(vmin1, v1);
+        vmax1 = _mm256_max_pd(vmax1, v1);
+    }
+    vmin = _mm256_min_pd(vmin, vmin1);
+    vmax = _mm256_max_pd(vmax, vmax1);
+    double lanes_min[4], lanes_max[4];
+    _mm256_storeu_pd(lanes_min, vmin);
+    _mm256_storeu_pd(lanes_max, vmax);
+
+    _bs_vector_soa_bounds_f64(src_ptr + i, num - i, min_ptr, max_ptr);
+    for (int l = 0; l < 4; ++l) {
+        *min_ptr = BS_MIN(*min_ptr, lanes_min[l]);
+        *max_ptr = BS_MAX(*max_ptr, lanes_max[l]);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** AVX: 8 floats per register. The remainder goes to the baseline. */
+void _bs_vector_soa_add_f32_avx(float *dest_ptr,
+                                const float *src1_ptr,
+                                const float *src2_ptr,
+                                size_t num)
+{
+    size_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        _mm256_storeu_ps(&dest_ptr[i],
+                         _mm256_add_ps(_mm256_loadu_ps(&src1_ptr[i]),
+                                       _mm256_loadu_ps(&src2_ptr[i])));
+    }
+    _bs_vector_soa_add_f32(dest_ptr + i, src1_ptr + i, src2_ptr + i, num - i);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_mul_f32_avx(float *dest_ptr,
+                                float scale,
+                                const float *src_ptr,
+                                size_t num)
+{
+    const __m256 s = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        _mm256_storeu_ps(&dest_ptr[i],
+                         _mm256_mul_ps(s, _mm256_loadu_ps(&src_ptr[i])));
+    }
+    _bs_vector_soa_mul_f32(dest_ptr + i, scale, src_ptr + i, num - i);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_dot_f32_avx(float *dest_ptr,
+                                const float *x1_ptr,
+                                const float *y1_ptr,
+                                const float *x2_ptr,
+                                const float *y2_ptr,
+                                size_t num)
+{
+    size_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        _mm256_storeu_ps(&dest_ptr[i], _mm256_add_ps(
+                             _mm256_mul_ps(_mm256_loadu_ps(&x1_ptr[i]),
+                                           _mm256_loadu_ps(&x2_ptr[i])),
+                             _mm256_mul_ps(_mm256_loadu_ps(&y1_ptr[i]),
+                                           _mm256_loadu_ps(&y2_ptr[i]))));
+    }
+    _bs_vector_soa_dot_f32(dest_ptr + i, x1_ptr + i, y1_ptr + i,
+                           x2_ptr + i, y2_ptr + i, num - i);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_length_f32_avx(float *dest_ptr,
+                                   const float *x_ptr,
+                                   const float *y_ptr,
+                                   size_t num)
+{
+    size_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        __m256 x = _mm256_loadu_ps(&x_ptr[i]);
+        __m256 y = _mm256_loadu_ps(&y_ptr[i]);
+        _mm256_storeu_ps(&dest_ptr[i], _mm256_sqrt_ps(
+                             _mm256_add_ps(_mm256_mul_ps(x, x),
+                                           _mm256_mul_ps(y, y))));
+    }
+    _bs_vector_soa_length_f32(dest_ptr + i, x_ptr + i, y_ptr + i, num - i);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_transform_f32_avx(float *x_dest_ptr,
+                                      float *y_dest_ptr,
+                                      const bs_affine_2f_t *affine_ptr,
+                                      const float *x_ptr,
+                                      const float *y_ptr,
+                                      size_t num)
+{
+    const __m256 xx = _mm256_set1_ps(affine_ptr->xx);
+    const __m256 yx = _mm256_set1_ps(affine_ptr->yx);
+    const __m256 xy = _mm256_set1_ps(affine_ptr->xy);
+    const __m256 yy = _mm256_set1_ps(affine_ptr->yy);
+    const __m256 x0 = _mm256_set1_ps(affine_ptr->x0);
+    const __m256 y0 = _mm256_set1_ps(affine_ptr->y0);
+    size_t i = 0;
+    for (; i + 8 <= num; i += 8) {
+        __m256 x = _mm256_loadu_ps(&x_ptr[i]);
+        __m256 y = _mm256_loadu_ps(&y_ptr[i]);
+        __m256 rx = _mm256_add_ps(_mm256_mul_ps(xx, x), _mm256_mul_ps(xy, y));
+        __m256 ry = _mm256_add_ps(_mm256_mul_ps(yx, x), _mm256_mul_ps(yy, y));
+        _mm256_storeu_ps(&x_dest_ptr[i], _mm256_add_ps(rx, x0));
+        _mm256_storeu_ps(&y_dest_ptr[i], _mm256_add_ps(ry, y0));
+    }
+    _bs_vector_soa_transform_f32(x_dest_ptr + i, y_dest_ptr + i, affine_ptr,
+                                 x_ptr + i, y_ptr + i, num - i);
+}
+
+/* ------------------------------------------------------------------------- */
+void _bs_vector_soa_bounds_f32_avx(const float *src_ptr,
+                                   size_t num,
+                                   float *min_ptr,
+                                   float *max_ptr)
+{
+    __m256 vmin = _mm256_set1_ps(INFINITY), vmax = _mm256_set1_ps(-INFINITY);
+    __m256 vmin1 = vmin, vmax1 = vmax;
+    size_t i = 0;
+    for (; i + 16 <= num; i += 16) {
+        __m256 v0 = _mm256_loadu_ps(&src_ptr[i]);
+        __m256 v1 = _mm256_loadu_ps(&src_ptr[i + 8]);
+        vmin = _mm256_min_ps(vmin, v0);
+        vmax = _mm256_max_ps(vmax, v0);
+        vmin1 = _mm256_min_ps(vmin1, v1);
+        vmax1 = _mm256_max_ps(vmax1, v1);
+    }
+    vmin = _mm256_min_ps(vmin, vmin1);
+    vmax = _mm256_max_ps(vmax, vmax1);
+    float lanes_min[8], lanes_max[8];
+    _mm256_storeu_ps(lanes_min, vmin);
+    _mm256_storeu_ps(lanes_max, vmax);
+
+    _bs_vector_soa_bounds_f32(src_ptr + i, num - i, min_ptr, max_ptr);
+    for (int l = 0; l < 8; ++l) {
+        *min_ptr = BS_MIN(*min_ptr, lanes_min[l]);
+        *max_ptr = BS_MAX(*max_ptr, lanes_max[l]);
+    }
+}
+#endif  // BS_VECTOR_X86
+
+/* == Unit tests =========================================================== */
+/** @cond TEST */
+
+static void test_array(bs_test_t *test_ptr);
+static void test_array_f32(bs_test_t *test_ptr);
+static void test_soa(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_vector_test_cases[] = {
+    { 1, "array", test_array },
+    { 1, "array_f32", test_array_f32 },
+    { 1, "soa", test_soa },
+    { 0, NULL, NULL }
+};
+
+/** Upper bound of the number of vectors to test with. Covers all tails. */
+#define _TEST_NUM 37
+
+/* ------------------------------------------------------------------------- */
+/** Returns whether `a` and `b` are within a relative tolerance. */
+static bool _test_near(double a, double b, double tolerance)
+{
+    return fabs(a - b) <= tolerance * BS_MAX(1.0, fabs(b));
+}
+
+/* ------------------------------------------------------------------------- */
+/** Fills `dest_ptr` with `num` pseudo-random values in [-100, 100). */
+static void _test_fill(double *dest_ptr, size_t num, uint32_t seed)
+{
+    for (size_t i = 0; i < num; ++i) {
+        seed = seed * 1664525 + 1013904223;
+        dest_ptr[i] = (seed >> 8) / (double)(1 << 24) * 200.0 - 100.0;
+    }
+}
+
+/** A rotation by 30 degrees, scaled by 2 and translated by (3, -4). */
+static const bs_affine_2f_t   _test_affine = {
+    .xx = 1.7320508075688772, .yx = 1.0,
+    .xy = -1.0, .yy = 1.7320508075688772,
+    .x0 = 3.0, .y0 = -4.0
+};
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the double-precision array-of-structures methods. */
+void test_array(bs_test_t *test_ptr)
+{
+    bs_vector_2f_t a[_TEST_NUM], b[_TEST_NUM], r[_TEST_NUM];
+    double d[_TEST_NUM];
+    _test_fill(&a[0].x, 2 * _TEST_NUM, 1);
+    _test_fill(&b[0].x, 2 * _TEST_NUM, 2);
+
+    for (size_t num = 0; num <= _TEST_NUM; ++num) {
+        bs_vec_add_2f_array(r, a, b, num);
+        for (size_t i = 0; i < num; ++i) {
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, a[i].x + b[i].x, r[i].x);
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, a[i].y + b[i].y, r[i].y);
+        }
+        bs_vec_mul_2f_array(r, 3.0, a, num);
+        for (size_t i = 0; i < num; ++i) {
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 3.0 * a[i].x, r[i].x);
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 3.0 * a[i].y, r[i].y);
+        }
+        bs_vec_dot_2f_array(d, a, b, num);
+        for (size_t i = 0; i < num; ++i) {
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(bs_vec_dot_2f(a[i], b[i]), d[i], 1e-12));
+        }
+        bs_vec_length_2f_array(d, a, num);
+        for (size_t i = 0; i < num; ++i) {
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(hypot(a[i].x, a[i].y), d[i], 1e-12));
+        }
+        bs_vec_transform_2f_array(r, &_test_affine, a, num);
+        for (size_t i = 0; i < num; ++i) {
+            bs_vector_2f_t e = bs_vec_transform_2f(&_test_affine, a[i]);
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(e.x, r[i].x, 1e-12));
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(e.y, r[i].y, 1e-12));
+        }
+
+        bs_vector_2f_t min, max;
+        bs_vec_bounds_2f_array(a, num, &min, &max);
+        bs_vector_2f_t emin = BS_VECTOR_2F(INFINITY, INFINITY);
+        bs_vector_2f_t emax = BS_VECTOR_2F(-INFINITY, -INFINITY);
+        for (size_t i = 0; i < num; ++i) {
+            emin = BS_VECTOR_2F(fmin(emin.x, a[i].x), fmin(emin.y, a[i].y));
+            emax = BS_VECTOR_2F(fmax(emax.x, a[i].x), fmax(emax.y, a[i].y));
+        }
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, emin.x, min.x);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, emin.y, min.y);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, emax.x, max.x);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, emax.y, max.y);
+    }
+
+    // In place.
+    bs_vector_2f_t v[3] = {
+        BS_VECTOR_2F(1, 2), BS_VECTOR_2F(3, 4), BS_VECTOR_2F(-5, 6) };
+    bs_vec_add_2f_array(v, v, v, 3);
+    BS_TEST_VERIFY_EQ(test_ptr, -10, v[2].x);
+    bs_vec_transform_2f_array(v, &BS_AFFINE_2F_IDENTITY, v, 3);
+    BS_TEST_VERIFY_EQ(test_ptr, 8, v[1].y);
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the single-precision array-of-structures methods. */
+void test_array_f32(bs_test_t *test_ptr)
+{
+    bs_vector_2f32_t a[_TEST_NUM], b[_TEST_NUM], r[_TEST_NUM];
+    float d[_TEST_NUM];
+    double values[4 * _TEST_NUM];
+    _test_fill(values, 4 * _TEST_NUM, 3);
+    for (size_t i = 0; i < _TEST_NUM; ++i) {
+        a[i] = BS_VECTOR_2F32(values[4 * i], values[4 * i + 1]);
+        b[i] = BS_VECTOR_2F32(values[4 * i + 2], values[4 * i + 3]);
+    }
+
+    for (size_t num = 0; num <= _TEST_NUM; ++num) {
+        bs_vec_add_2f32_array(r, a, b, num);
+        for (size_t i = 0; i < num; ++i) {
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, a[i].x + b[i].x, r[i].x);
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, a[i].y + b[i].y, r[i].y);
+        }
+        bs_vec_mul_2f32_array(r, 0.5f, a, num);
+        for (size_t i = 0; i < num; ++i) {
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 0.5f * a[i].x, r[i].x);
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 0.5f * a[i].y, r[i].y);
+        }
+        bs_vec_dot_2f32_array(d, a, b, num);
+        for (size_t i = 0; i < num; ++i) {
+            double e = (double)a[i].x * b[i].x + (double)a[i].y * b[i].y;
+            BS_TEST_VERIFY_TRUE_OR_RETURN(test_ptr, _test_near(e, d[i], 1e-3));
+        }
+        bs_vec_length_2f32_array(d, a, num);
+        for (size_t i = 0; i < num; ++i) {
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(hypot(a[i].x, a[i].y), d[i], 1e-5));
+        }
+        bs_vec_transform_2f32_array(r, &_test_affine, a, num);
+        for (size_t i = 0; i < num; ++i) {
+            bs_vector_2f_t e = bs_vec_transform_2f(
+                &_test_affine, BS_VECTOR_2F(a[i].x, a[i].y));
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(e.x, r[i].x, 1e-4));
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(e.y, r[i].y, 1e-4));
+        }
+
+        bs_vector_2f32_t min, max;
+        bs_vec_bounds_2f32_array(a, num, &min, &max);
+        bs_vector_2f32_t emin = BS_VECTOR_2F32(INFINITY, INFINITY);
+        bs_vector_2f32_t emax = BS_VECTOR_2F32(-INFINITY, -INFINITY);
+        for (size_t i = 0; i < num; ++i) {
+            emin = BS_VECTOR_2F32(fminf(emin.x, a[i].x), fminf(emin.y, a[i].y));
+            emax = BS_VECTOR_2F32(fmaxf(emax.x, a[i].x), fmaxf(emax.y, a[i].y));
+        }
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, emin.x, min.x);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, emin.y, min.y);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, emax.x, max.x);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, emax.y, max.y);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the kernels in `k_ptr` against scalar computations. */
+static void _test_soa_kernels(bs_test_t *test_ptr,
+                              const bs_vector_soa_kernels_t *k_ptr)
+{
+    double x1[_TEST_NUM], y1[_TEST_NUM], x2[_TEST_NUM], y2[_TEST_NUM];
+    double rx[_TEST_NUM], ry[_TEST_NUM];
+    float fx1[_TEST_NUM], fy1[_TEST_NUM], fx2[_TEST_NUM], fy2[_TEST_NUM];
+    float frx[_TEST_NUM], fry[_TEST_NUM];
+    _test_fill(x1, _TEST_NUM, 4);
+    _test_fill(y1, _TEST_NUM, 5);
+    _test_fill(x2, _TEST_NUM, 6);
+    _test_fill(y2, _TEST_NUM, 7);
+    for (size_t i = 0; i < _TEST_NUM; ++i) {
+        fx1[i] = x1[i];
+        fy1[i] = y1[i];
+        fx2[i] = x2[i];
+        fy2[i] = y2[i];
+    }
+
+    for (size_t num = 0; num <= _TEST_NUM; ++num) {
+        k_ptr->add_f64(rx, x1, x2, num);
+        k_ptr->mul_f64(ry, 3.0, y1, num);
+        for (size_t i = 0; i < num; ++i) {
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, x1[i] + x2[i], rx[i]);
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 3.0 * y1[i], ry[i]);
+        }
+        k_ptr->dot_f64(rx, x1, y1, x2, y2, num);
+        k_ptr->length_f64(ry, x1, y1, num);
+        for (size_t i = 0; i < num; ++i) {
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(x1[i] * x2[i] + y1[i] * y2[i],
+                                     rx[i], 1e-12));
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(hypot(x1[i], y1[i]), ry[i], 1e-12));
+        }
+        k_ptr->transform_f64(rx, ry, &_test_affine, x1, y1, num);
+        for (size_t i = 0; i < num; ++i) {
+            bs_vector_2f_t e = bs_vec_transform_2f(
+                &_test_affine, BS_VECTOR_2F(x1[i], y1[i]));
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(e.x, rx[i], 1e-12));
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(e.y, ry[i], 1e-12));
+        }
+        double min, max, emin = INFINITY, emax = -INFINITY;
+        k_ptr->bounds_f64(x1, num, &min, &max);
+        for (size_t i = 0; i < num; ++i) {
+            emin = fmin(emin, x1[i]);
+            emax = fmax(emax, x1[i]);
+        }
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, emin, min);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, emax, max);
+
+        k_ptr->add_f32(frx, fx1, fx2, num);
+        k_ptr->mul_f32(fry, 3.0f, fy1, num);
+        for (size_t i = 0; i < num; ++i) {
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, fx1[i] + fx2[i], frx[i]);
+            BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, 3.0f * fy1[i], fry[i]);
+        }
+        k_ptr->dot_f32(frx, fx1, fy1, fx2, fy2, num);
+        k_ptr->length_f32(fry, fx1, fy1, num);
+        for (size_t i = 0; i < num; ++i) {
+            double e = (double)fx1[i] * fx2[i] + (double)fy1[i] * fy2[i];
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(e, frx[i], 1e-3));
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(hypot(fx1[i], fy1[i]), fry[i], 1e-5));
+        }
+        k_ptr->transform_f32(frx, fry, &_test_affine, fx1, fy1, num);
+        for (size_t i = 0; i < num; ++i) {
+            bs_vector_2f_t e = bs_vec_transform_2f(
+                &_test_affine, BS_VECTOR_2F(fx1[i], fy1[i]));
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(e.x, frx[i], 1e-4));
+            BS_TEST_VERIFY_TRUE_OR_RETURN(
+                test_ptr, _test_near(e.y, fry[i], 1e-4));
+        }
+        float fmin_value, fmax_value;
+        k_ptr->bounds_f32(fy1, num, &fmin_value, &fmax_value);
+        float efmin = INFINITY, efmax = -INFINITY;
+        for (size_t i = 0; i < num; ++i) {
+            efmin = fminf(efmin, fy1[i]);
+            efmax = fmaxf(efmax, fy1[i]);
+        }
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, efmin, fmin_value);
+        BS_TEST_VERIFY_EQ_OR_RETURN(test_ptr, efmax, fmax_value);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Verifies the structure-of-arrays methods, and all kernels available. */
+void test_soa(bs_test_t *test_ptr)
+{
+    _test_soa_kernels(test_ptr, &_bs_vector_soa_baseline);
+#if defined(BS_VECTOR_X86)
+    if (__builtin_cpu_supports("avx")) {
+        _test_soa_kernels(test_ptr, &_bs_vector_soa_avx);
+    }
+#endif
+
+    // The exported methods, on both dimensions.
+    double x[5] = { 1, 2, 3, 4, 5 }, y[5] = { -1, -2, -3, -4, -5 };
+    bs_vector_2f_soa_t v = { .x_ptr = x, .y_ptr = y };
+    bs_vec_add_2f_soa(v, v, v, 5);
+    BS_TEST_VERIFY_EQ(test_ptr, 10, x[4]);
+    BS_TEST_VERIFY_EQ(test_ptr, -10, y[4]);
+    bs_vec_mul_2f_soa(v, 0.5, v, 5);
+    BS_TEST_VERIFY_EQ(test_ptr, -3, y[2]);
+    bs_vector_2f_t min, max;
+    bs_vec_bounds_2f_soa(v, 5, &min, &max);
+    BS_TEST_VERIFY_EQ(test_ptr, 1, min.x);
+    BS_TEST_VERIFY_EQ(test_ptr, -5, min.y);
+    BS_TEST_VERIFY_EQ(test_ptr, 5, max.x);
+    BS_TEST_VERIFY_EQ(test_ptr, -1, max.y);
+    bs_vec_transform_2f_soa(v, &_test_affine, v, 5);
+    BS_TEST_VERIFY_TRUE(
+        test_ptr, _test_near(1.7320508075688772 + 1.0 + 3.0, x[0], 1e-12));
+    bs_vec_bounds_2f_soa(v, 0, &min, &max);
+    BS_TEST_VERIFY_TRUE(test_ptr, isinf(min.x) && 0 < min.x);
+    BS_TEST_VERIFY_TRUE(test_ptr, isinf(max.y) && 0 > max.y);
+
+    float fx[3] = { 3, 0, 1 }, fy[3] = { 4, 1, 0 }, d[3];
+    bs_vector_2f32_soa_t fv = { .x_ptr = fx, .y_ptr = fy };
+    bs_vec_length_2f32_soa(d, fv, 3);
+    BS_TEST_VERIFY_EQ(test_ptr, 5, d[0]);
+    bs_vec_dot_2f32_soa(d, fv, fv, 3);
+    BS_TEST_VERIFY_EQ(test_ptr, 25, d[0]);
+}
+
+/** @endcond */
+
+/* == Benchmarks =========================================================== */
+
+static void benchmark_transform(bs_test_t *test_ptr);
+static void benchmark_bounds(bs_test_t *test_ptr);
+
+const bs_test_case_t          bs_vector_benchmarks[] = {
+    { 1, "benchmark-transform", benchmark_transform },
+    { 1, "benchmark-bounds", benchmark_bounds },
+    { 0, NULL, NULL }
+};
+
+/** Number of points transformed per benchmark iteration. */
+#define _BENCHMARK_NUM 16384
+
+/** Points for the benchmarks, in all layouts and precisions. */
+typedef struct {
+    /** Array of structures, double precision. */
+    bs_vector_2f_t            *array_ptr;
+    /** Array of structures, single precision. */
+    bs_vector_2f32_t          *array_f32_ptr;
+    /** Structure of arrays, double precision. */
+    bs_vector_2f_soa_t        soa;
+    /** Structure of arrays, single precision. */
+    bs_vector_2f32_soa_t      soa_f32;
+    /** The transformation to apply. Not a constant, to prevent folding. */
+    bs_affine_2f_t            affine;
+} _benchmark_points_t;
+
+/* ------------------------------------------------------------------------- */
+/** Transforms the points one by one, with the inline helper. */
+static void _benchmark_transform_scalar_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_points_t *p_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        for (size_t j = 0; j < _BENCHMARK_NUM; ++j) {
+            p_ptr->array_ptr[j] = bs_vec_transform_2f(
+                &p_ptr->affine, p_ptr->array_ptr[j]);
+        }
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Transforms the points with @ref bs_vec_transform_2f_array. */
+static void _benchmark_transform_array_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_points_t *p_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_vec_transform_2f_array(p_ptr->array_ptr, &p_ptr->affine,
+                                  p_ptr->array_ptr, _BENCHMARK_NUM);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Transforms the points with @ref bs_vec_transform_2f_soa. */
+static void _benchmark_transform_soa_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_points_t *p_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_vec_transform_2f_soa(p_ptr->soa, &p_ptr->affine,
+                                p_ptr->soa, _BENCHMARK_NUM);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Transforms the points with @ref bs_vec_transform_2f32_array. */
+static void _benchmark_transform_array_f32_fn(
+    void *arg_ptr,
+    uint64_t iterations)
+{
+    _benchmark_points_t *p_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_vec_transform_2f32_array(
+            p_ptr->array_f32_ptr, &p_ptr->affine,
+            p_ptr->array_f32_ptr, _BENCHMARK_NUM);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Transforms the points with @ref bs_vec_transform_2f32_soa. */
+static void _benchmark_transform_soa_f32_fn(
+    void *arg_ptr,
+    uint64_t iterations)
+{
+    _benchmark_points_t *p_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_vec_transform_2f32_soa(p_ptr->soa_f32, &p_ptr->affine,
+                                  p_ptr->soa_f32, _BENCHMARK_NUM);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Computes the bounding box one by one. */
+static void _benchmark_bounds_scalar_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_points_t *p_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_vector_2f_t min = BS_VECTOR_2F(INFINITY, INFINITY);
+        bs_vector_2f_t max = BS_VECTOR_2F(-INFINITY, -INFINITY);
+        for (size_t j = 0; j < _BENCHMARK_NUM; ++j) {
+            const bs_vector_2f_t *v_ptr = &p_ptr->array_ptr[j];
+            min = BS_VECTOR_2F(BS_MIN(min.x, v_ptr->x),
+                               BS_MIN(min.y, v_ptr->y));
+            max = BS_VECTOR_2F(BS_MAX(max.x, v_ptr->x),
+                               BS_MAX(max.y, v_ptr->y));
+        }
+        BS_TEST_DO_NOT_OPTIMIZE(min);
+        BS_TEST_DO_NOT_OPTIMIZE(max);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Computes the bounding box with @ref bs_vec_bounds_2f_array. */
+static void _benchmark_bounds_array_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_points_t *p_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_vector_2f_t min, max;
+        bs_vec_bounds_2f_array(p_ptr->array_ptr, _BENCHMARK_NUM, &min, &max);
+        BS_TEST_DO_NOT_OPTIMIZE(min);
+        BS_TEST_DO_NOT_OPTIMIZE(max);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Computes the bounding box with @ref bs_vec_bounds_2f_soa. */
+static void _benchmark_bounds_soa_fn(void *arg_ptr, uint64_t iterations)
+{
+    _benchmark_points_t *p_ptr = arg_ptr;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bs_vector_2f_t min, max;
+        bs_vec_bounds_2f_soa(p_ptr->soa, _BENCHMARK_NUM, &min, &max);
+        BS_TEST_DO_NOT_OPTIMIZE(min);
+        BS_TEST_DO_NOT_OPTIMIZE(max);
+        BS_TEST_CLOBBER_MEMORY();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/** Allocates and fills points for the benchmarks. */
+static bool _benchmark_points_init(_benchmark_points_t *p_ptr)
+{
+    *p_ptr = (_benchmark_points_t){};
+    p_ptr->array_ptr = logged_calloc(_BENCHMARK_NUM, sizeof(bs_vector_2f_t));
+    p_ptr->array_f32_ptr = logged_calloc(_BENCHMARK_NUM,
+                                         sizeof(bs_vector_2f32_t));
+    p_ptr->soa.x_ptr = logged_calloc(_BENCHMARK_NUM, sizeof(double));
+    p_ptr->soa.y_ptr = logged_calloc(_BENCHMARK_NUM, sizeof(double));
+    p_ptr->soa_f32.x_ptr = logged_calloc(_BENCHMARK_NUM, sizeof(float));
+    p_ptr->soa_f32.y_ptr = logged_calloc(_BENCHMARK_NUM, sizeof(float));
+    if (NULL == p_ptr->array_ptr || NULL == p_ptr->array_f32_ptr ||
+        NULL == p_ptr->soa.x_ptr || NULL == p_ptr->soa.y_ptr ||
+        NULL == p_ptr->soa_f32.x_ptr || NULL == p_ptr->soa_f32.y_ptr) {
+        return false;
+    }
+
+    // A rotation, preserving the points' magnitude across iterations.
+    p_ptr->affine = (bs_affine_2f_t){
+        .xx = 0.6, .yx = 0.8, .xy = -0.8, .yy = 0.6 };
+    _test_fill(&p_ptr->array_ptr[0].x, 2 * _BENCHMARK_NUM, 8);
+    for (size_t i = 0; i < _BENCHMARK_NUM; ++i) {
+        bs_vector_2f_t v = p_ptr->array_ptr[i];
+        p_ptr->array_f32_ptr[i] = BS_VECTOR_2F32(v.x, v.y);
+        p_ptr->soa.x_ptr[i] = v.x;
+        p_ptr->soa.y_ptr[i] = v.y;
+        p_ptr->soa_f32.x_ptr[i] = v.x;
+        p_ptr->soa_f32.y_ptr[i] = v.y;
+    }
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/** Releases what @ref _benchmark_points_init allocated. */
+static void _benchmark_points_fini(_benchmark_points_t *p_ptr)
+{
+    logged_free(p_ptr->array_ptr);
+    logged_free(p_ptr->array_f32_ptr);
+    logged_free(p_ptr->soa.x_ptr);
+    logged_free(p_ptr->soa.y_ptr);
+    logged_free(p_ptr->soa_f32.x_ptr);
+    logged_free(p_ptr->soa_f32.y_ptr);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_transform(bs_test_t *test_ptr)
+{
+    _benchmark_points_t points;
+    if (!_benchmark_points_init(&points)) {
+        BS_TEST_FAIL(test_ptr, "Failed _benchmark_points_init()");
+    } else if (
+        !bs_test_bench(test_ptr, "transform-16384-scalar",
+                       _benchmark_transform_scalar_fn, &points, NULL) ||
+        !bs_test_bench(test_ptr, "transform-16384-array",
+                       _benchmark_transform_array_fn, &points, NULL) ||
+        !bs_test_bench(test_ptr, "transform-16384-soa",
+                       _benchmark_transform_soa_fn, &points, NULL) ||
+        !bs_test_bench(test_ptr, "transform-16384-array-f32",
+                       _benchmark_transform_array_f32_fn, &points, NULL) ||
+        !bs_test_bench(test_ptr, "transform-16384-soa-f32",
+                       _benchmark_transform_soa_f32_fn, &points, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(transform)");
+    }
+    _benchmark_points_fini(&points);
+}
+
+/* ------------------------------------------------------------------------- */
+void benchmark_bounds(bs_test_t *test_ptr)
+{
+    _benchmark_points_t points;
+    if (!_benchmark_points_init(&points)) {
+        BS_TEST_FAIL(test_ptr, "Failed _benchmark_points_init()");
+    } else if (
+        !bs_test_bench(test_ptr, "bounds-16384-scalar",
+                       _benchmark_bounds_scalar_fn, &points, NULL) ||
+        !bs_test_bench(test_ptr, "bounds-16384-array",
+                       _benchmark_bounds_array_fn, &points, NULL) ||
+        !bs_test_bench(test_ptr, "bounds-16384-soa",
+                       _benchmark_bounds_soa_fn, &points, NULL)) {
+        BS_TEST_FAIL(test_ptr, "Failed bs_test_bench(bounds)");
+    }
+    _benchmark_points_fini(&points);
+}
+
+/* == End of vector.c ====================================================== */